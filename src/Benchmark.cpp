@@ -0,0 +1,703 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QEventLoop>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+#include <QtEndian>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <cstring>
+#include <vector>
+
+#if defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+#include "Benchmark.h"
+#include "geomaps/Downloadable.h"
+#include "geomaps/GeoMapProvider.h"
+#include "geomaps/TileServer.h"
+#include "navigation/FlightRoute_Leg.h"
+#include "traffic/CRC16.h"
+#include "traffic/TrafficCaptureRecorder.h"
+#include "traffic/TrafficDataSource_Abstract.h"
+#include "traffic/TrafficDataSource_File.h"
+
+
+namespace {
+
+// Traffic data source that gives access to the parsers
+class BenchmarkDataSource : public Traffic::TrafficDataSource_Abstract {
+public:
+    using Traffic::TrafficDataSource_Abstract::GDLPressureAltitude;
+    using Traffic::TrafficDataSource_Abstract::processFLARMSentence;
+    using Traffic::TrafficDataSource_Abstract::processGDLMessage;
+    using Traffic::TrafficDataSource_Abstract::processXGPSString;
+
+    QString sourceName() const override
+    {
+        return QStringLiteral("Benchmark");
+    }
+    void connectToTrafficReceiver() override {}
+    void disconnectFromTrafficReceiver() override {}
+};
+
+}
+
+
+auto Benchmark::run(const QString& name, const QStringList& arguments) -> int
+{
+    if (name == u"flarmreplay") {
+        return flarmReplay(arguments);
+    }
+    if (name == u"gdl90crc") {
+        return gdl90CRC(arguments);
+    }
+    if (name == u"geomaps") {
+        return geomaps(arguments);
+    }
+    if (name == u"tileserver") {
+        return tileServer(arguments);
+    }
+    if (name == u"traffic") {
+        return traffic(arguments);
+    }
+    if (name == u"units") {
+        return units();
+    }
+
+    QTextStream(stderr) << QStringLiteral("Unknown benchmark '%1'. Known benchmarks: flarmreplay, gdl90crc, geomaps, tileserver, traffic, units").arg(name) << Qt::endl;
+    return 1;
+}
+
+
+auto Benchmark::flarmReplay(const QStringList& fileNames) -> int
+{
+    if (fileNames.isEmpty()) {
+        QTextStream(stderr) << QStringLiteral("Benchmark flarmreplay requires FLARM simulator files as arguments") << Qt::endl;
+        return 1;
+    }
+
+    foreach(auto fileName, fileNames) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            QTextStream(stderr) << QStringLiteral("Cannot read file '%1'").arg(fileName) << Qt::endl;
+            return 1;
+        }
+        file.close();
+
+        // Replay the file as fast as possible. The replay might already be
+        // finished when connectToTrafficReceiver() returns.
+        Traffic::TrafficDataSource_File source(fileName);
+        source.setReplaySpeed(0.0);
+        QEventLoop loop;
+        bool finished = false;
+        QObject::connect(&source, &Traffic::TrafficDataSource_File::replayFinished, &loop, [&]() {
+            finished = true;
+            loop.quit();
+        });
+        QElapsedTimer timer;
+        timer.start();
+        source.connectToTrafficReceiver();
+        if (!finished) {
+            loop.exec();
+        }
+        auto wallTimeMS = timer.elapsed();
+
+        report(QStringLiteral("%1: sentences").arg(fileName), source.processedSentences(), QString());
+        report(QStringLiteral("%1: parser throughput").arg(fileName), source.parseThroughput(), QStringLiteral("sentences/s"));
+        report(QStringLiteral("%1: replay time").arg(fileName), wallTimeMS, QStringLiteral("ms"));
+    }
+    return 0;
+}
+
+
+auto Benchmark::gdl90CRC(const QStringList& fileNames) -> int
+{
+    if (fileNames.isEmpty()) {
+        QTextStream(stderr) << QStringLiteral("Benchmark gdl90crc requires GDL90 receiver captures as arguments") << Qt::endl;
+        return 1;
+    }
+
+    // Read the captures and cut them into unescaped messages, exactly as
+    // TrafficDataSource_Abstract::processGDLMessage() does
+    QVector<QByteArray> messages;
+    qint64 totalBytes = 0;
+    foreach(auto fileName, fileNames) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            QTextStream(stderr) << QStringLiteral("Cannot read file '%1'").arg(fileName) << Qt::endl;
+            return 1;
+        }
+        auto data = file.readAll();
+        foreach(auto rawMessage, data.split(0x7e)) {
+            QByteArray message;
+            message.reserve(rawMessage.size());
+            bool isEscaped = false;
+            foreach(auto character, rawMessage) {
+                if (character == 0x7d) {
+                    isEscaped = true;
+                    continue;
+                }
+                message.append(isEscaped ? static_cast<char>(character ^ 0x20) : character);
+                isEscaped = false;
+            }
+            if (message.size() < 3) {
+                continue;
+            }
+            messages.append(message);
+            totalBytes += message.size()-2;
+        }
+    }
+    if (messages.isEmpty()) {
+        QTextStream(stderr) << QStringLiteral("No GDL90 messages found") << Qt::endl;
+        return 1;
+    }
+
+    // Check that both implementations agree, and count valid messages
+    int validMessages = 0;
+    foreach(const auto& message, messages) {
+        auto data = reinterpret_cast<const quint8*>(message.constData());
+        auto size = message.size()-2;
+        auto crc = Traffic::CRC16::gdl90(data, size);
+        if (crc != Traffic::CRC16::gdl90Reference(data, size)) {
+            QTextStream(stderr) << QStringLiteral("Checksum implementations disagree") << Qt::endl;
+            return 1;
+        }
+        if (crc == ((static_cast<quint8>(message[size+1]) << 8U) | static_cast<quint8>(message[size]))) {
+            validMessages++;
+        }
+    }
+
+    // Time both implementations. The checksums are accumulated, so that the
+    // compiler cannot optimize the calls away.
+    quint16 sink = 0;
+    auto timeImplementation = [&](quint16 (*crcFunction)(const quint8*, int)) {
+        return nsPerCall([&]() {
+            foreach(const auto& message, messages) {
+                sink ^= crcFunction(reinterpret_cast<const quint8*>(message.constData()), message.size()-2);
+            }
+        });
+    };
+    auto nsReference = timeImplementation(Traffic::CRC16::gdl90Reference);
+    auto nsFast = timeImplementation(Traffic::CRC16::gdl90);
+
+    report(QStringLiteral("Messages"), messages.size(), QString());
+    report(QStringLiteral("Messages with valid checksum"), validMessages, QString());
+    report(QStringLiteral("Mean message size"), static_cast<double>(totalBytes)/messages.size(), QStringLiteral("bytes"));
+    report(QStringLiteral("Reference implementation"), nsReference/messages.size(), QStringLiteral("ns/message"));
+    report(QStringLiteral("Reference implementation"), totalBytes*1000.0/nsReference, QStringLiteral("MB/s"));
+    report(QStringLiteral("Slicing-by-8 implementation"), nsFast/messages.size(), QStringLiteral("ns/message"));
+    report(QStringLiteral("Slicing-by-8 implementation"), totalBytes*1000.0/nsFast, QStringLiteral("MB/s"));
+    report(QStringLiteral("Speedup"), nsReference/nsFast, QString());
+    report(QStringLiteral("Checksum of checksums"), sink, QString());
+    return 0;
+}
+
+
+auto Benchmark::geomaps(const QStringList& fileNames) -> int
+{
+    if (fileNames.isEmpty()) {
+        QTextStream(stderr) << QStringLiteral("Benchmark geomaps requires GeoJSON aviation maps as arguments") << Qt::endl;
+        return 1;
+    }
+    foreach(auto fileName, fileNames) {
+        if (!QFile::exists(fileName)) {
+            QTextStream(stderr) << QStringLiteral("Cannot read file '%1'").arg(fileName) << Qt::endl;
+            return 1;
+        }
+    }
+
+    // Keep away from the caches of the app, and start without cache file
+    QStandardPaths::setTestModeEnabled(true);
+    QFile::remove(GeoMaps::GeoMapProvider::aviationDataCacheFileName());
+    GeoMaps::GeoMapProvider provider;
+
+    // Time the generation of aviation data, once with parsing and once with
+    // the parsed maps that are kept in memory
+    QElapsedTimer timer;
+    timer.start();
+    provider.fillAviationDataCache(fileNames, false);
+    report(QStringLiteral("fillAviationDataCache, parsing all maps"), timer.nsecsElapsed()/1.0e6, QStringLiteral("ms"));
+    timer.start();
+    provider.fillAviationDataCache(fileNames, false);
+    report(QStringLiteral("fillAviationDataCache, no map changed"), timer.nsecsElapsed()/1.0e6, QStringLiteral("ms"));
+
+    auto data = provider.aviationData();
+    report(QStringLiteral("Waypoints"), data->waypoints.size(), QString());
+    report(QStringLiteral("Airspaces"), data->airspaces.size(), QString());
+    if (data->waypoints.isEmpty()) {
+        QTextStream(stderr) << QStringLiteral("No waypoints found") << Qt::endl;
+        return 1;
+    }
+
+    // Generate random query sets. Positions are taken from the bounding box
+    // of all waypoints, search strings and ICAO codes from the waypoints
+    // themselves. The generator is seeded, so that runs can be compared.
+    QRandomGenerator generator(1);
+    double minLat = 90.0;
+    double maxLat = -90.0;
+    double minLon = 180.0;
+    double maxLon = -180.0;
+    QStringList ICAOCodes;
+    QStringList names;
+    foreach(const auto& waypoint, data->waypoints) {
+        auto coordinate = waypoint.coordinate();
+        minLat = qMin(minLat, coordinate.latitude());
+        maxLat = qMax(maxLat, coordinate.latitude());
+        minLon = qMin(minLon, coordinate.longitude());
+        maxLon = qMax(maxLon, coordinate.longitude());
+        if (!waypoint.ICAOCode().isEmpty()) {
+            ICAOCodes.append(waypoint.ICAOCode());
+        }
+        if (waypoint.name().size() >= 3) {
+            names.append(waypoint.name());
+        }
+    }
+    constexpr int numQueries = 1000;
+    QVector<QGeoCoordinate> positions;
+    QStringList searchStrings;
+    QStringList IDs;
+    for(int i=0; i<numQueries; i++) {
+        positions.append(QGeoCoordinate(minLat + generator.generateDouble()*(maxLat-minLat), minLon + generator.generateDouble()*(maxLon-minLon)));
+        if (!names.isEmpty()) {
+            searchStrings.append(names[generator.bounded(names.size())].left(3));
+        }
+        if (!ICAOCodes.isEmpty()) {
+            IDs.append(ICAOCodes[generator.bounded(ICAOCodes.size())]);
+        }
+    }
+
+    // Time every query individually. The results are accumulated, so that
+    // the compiler cannot optimize the calls away.
+    qint64 sink = 0;
+    auto benchmarkQuery = [](const QString& label, int count, auto query) {
+        if (count == 0) {
+            return;
+        }
+        QVector<qint64> latencies;
+        latencies.reserve(count);
+        QElapsedTimer queryTimer;
+        for(int i=0; i<count; i++) {
+            queryTimer.start();
+            query(i);
+            latencies.append(queryTimer.nsecsElapsed());
+        }
+        std::sort(latencies.begin(), latencies.end());
+        auto mean = std::accumulate(latencies.begin(), latencies.end(), 0.0)/latencies.size();
+        report(QStringLiteral("%1 mean latency").arg(label), mean/1000.0, QStringLiteral("µs"));
+        report(QStringLiteral("%1 p99 latency").arg(label), latencies[qMin(latencies.size()-1, static_cast<int>(0.99*latencies.size()))]/1000.0, QStringLiteral("µs"));
+    };
+    benchmarkQuery(QStringLiteral("airspaces"), positions.size(), [&](int i) {
+        sink += provider.airspaces(positions[i]).size();
+    });
+    benchmarkQuery(QStringLiteral("nearbyWaypoints"), positions.size(), [&](int i) {
+        sink += provider.nearbyWaypoints(positions[i], QStringLiteral("AD")).size();
+    });
+    benchmarkQuery(QStringLiteral("closestWaypoint"), positions.size(), [&](int i) {
+        sink += provider.closestWaypoint(positions[i], positions[i]).isValid() ? 1 : 0;
+    });
+    timer.start();
+    sink += provider.snapToWaypoints(positions).size();
+    report(QStringLiteral("snapToWaypoints, all positions in one batch"), timer.nsecsElapsed()/1.0e6, QStringLiteral("ms"));
+    benchmarkQuery(QStringLiteral("filteredWaypointObjects"), searchStrings.size(), [&](int i) {
+        sink += provider.filteredWaypointObjects(searchStrings[i]).size();
+    });
+    benchmarkQuery(QStringLiteral("findByID"), IDs.size(), [&](int i) {
+        sink += provider.findByID(IDs[i]).isValid() ? 1 : 0;
+    });
+
+    report(QStringLiteral("Checksum of results"), static_cast<double>(sink), QString());
+    report(QStringLiteral("Peak resident set size"), static_cast<double>(peakRSSInKB()), QStringLiteral("kB"));
+    return 0;
+}
+
+
+auto Benchmark::peakRSSInKB() -> qint64
+{
+#if defined(Q_OS_UNIX)
+    struct rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#if defined(Q_OS_DARWIN)
+    // macOS reports bytes
+    return usage.ru_maxrss/1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+
+auto Benchmark::tileServer(const QStringList& arguments) -> int
+{
+    // Sort arguments into tile files, trace files and concurrency
+    QVector<QPointer<GeoMaps::Downloadable>> tileFiles;
+    QStringList traceFileNames;
+    int concurrency = 4;
+    foreach(auto argument, arguments) {
+        if (argument.startsWith(QLatin1String("concurrency="))) {
+            concurrency = argument.mid(12).toInt();
+            if (concurrency < 1) {
+                QTextStream(stderr) << QStringLiteral("Invalid argument '%1'").arg(argument) << Qt::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (!QFile::exists(argument)) {
+            QTextStream(stderr) << QStringLiteral("Cannot read file '%1'").arg(argument) << Qt::endl;
+            return 1;
+        }
+        if (argument.endsWith(QLatin1String(".mbtiles"), Qt::CaseInsensitive)) {
+            tileFiles.append(new GeoMaps::Downloadable(QUrl(), argument));
+        } else {
+            traceFileNames.append(argument);
+        }
+    }
+    if (tileFiles.isEmpty() || traceFileNames.isEmpty()) {
+        QTextStream(stderr) << QStringLiteral("Benchmark tileserver requires MBTiles files and trace files as arguments") << Qt::endl;
+        qDeleteAll(tileFiles);
+        return 1;
+    }
+
+    // Read the traces, with lines of the form "z x y" or "z/x/y". Empty lines
+    // and lines starting with '#' are ignored.
+    QStringList tilePaths;
+    foreach(auto traceFileName, traceFileNames) {
+        QFile file(traceFileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            QTextStream(stderr) << QStringLiteral("Cannot read file '%1'").arg(traceFileName) << Qt::endl;
+            qDeleteAll(tileFiles);
+            return 1;
+        }
+        foreach(auto line, file.readAll().split('\n')) {
+            line = line.trimmed();
+            if (line.isEmpty() || line.startsWith('#')) {
+                continue;
+            }
+            auto fields = QString::fromLatin1(line).split(QRegularExpression(QStringLiteral("[\\s/]+")));
+            if (fields.size() < 3) {
+                continue;
+            }
+            tilePaths.append(QStringLiteral("%1/%2/%3").arg(fields[0], fields[1], fields[2]));
+        }
+    }
+    if (tilePaths.isEmpty()) {
+        QTextStream(stderr) << QStringLiteral("No tile requests found") << Qt::endl;
+        qDeleteAll(tileFiles);
+        return 1;
+    }
+
+    // Start server. The tile handlers are set up by the workers, so wait
+    // until the server answers requests for the TileJSON file.
+    auto* server = new GeoMaps::TileServer();
+    if (!server->listen(QHostAddress::LocalHost)) {
+        QTextStream(stderr) << QStringLiteral("Tile server cannot listen: %1").arg(server->errorString()) << Qt::endl;
+        delete server;
+        qDeleteAll(tileFiles);
+        return 1;
+    }
+    server->addMbtilesFileSet(tileFiles, QStringLiteral("bench"));
+    auto baseURL = server->serverUrl()+QStringLiteral("/bench/");
+
+    // Probe a limited number of times, with a pause between two attempts
+    const int maxProbes = 50;
+    const int probeInterval_ms = 200;
+    QNetworkAccessManager probeManager;
+    bool ready = false;
+    for(int probe=0; !ready && (probe < maxProbes); probe++) {
+        if (probe > 0) {
+            QEventLoop pause;
+            QTimer::singleShot(probeInterval_ms, &pause, &QEventLoop::quit);
+            pause.exec();
+        }
+        QEventLoop loop;
+        auto* reply = probeManager.get(QNetworkRequest(QUrl(baseURL+QStringLiteral("tiles.json"))));
+        QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+        loop.exec();
+        ready = (reply->error() == QNetworkReply::NoError);
+        reply->deleteLater();
+    }
+    if (!ready) {
+        QTextStream(stderr) << QStringLiteral("Tile server does not answer") << Qt::endl;
+        delete server;
+        qDeleteAll(tileFiles);
+        return 1;
+    }
+
+    // Replay the trace. Each client has its own QNetworkAccessManager, in
+    // order to avoid the limit on connections per host, and sends its next
+    // request as soon as the previous one is answered.
+    auto hitsBefore = server->tileCache()->hits();
+    auto missesBefore = server->tileCache()->misses();
+    QVector<qint64> latencies(tilePaths.size());
+    QVector<QElapsedTimer> requestTimers(tilePaths.size());
+    qint64 bytesReceived = 0;
+    int errors = 0;
+    int notFound = 0;
+    int nextRequest = 0;
+    int activeClients = 0;
+    QEventLoop loop;
+    std::vector<std::unique_ptr<QNetworkAccessManager>> clients;
+    std::function<void(QNetworkAccessManager*)> sendNextRequest = [&](QNetworkAccessManager* client) {
+        if (nextRequest >= tilePaths.size()) {
+            activeClients--;
+            if (activeClients == 0) {
+                loop.quit();
+            }
+            return;
+        }
+        auto index = nextRequest++;
+        requestTimers[index].start();
+        auto* reply = client->get(QNetworkRequest(QUrl(baseURL+tilePaths[index])));
+        QObject::connect(reply, &QNetworkReply::finished, reply, [&, client, reply, index]() {
+            latencies[index] = requestTimers[index].nsecsElapsed();
+            if (reply->error() == QNetworkReply::NoError) {
+                bytesReceived += reply->readAll().size();
+            } else if (reply->error() == QNetworkReply::ContentNotFoundError) {
+                notFound++;
+            } else {
+                errors++;
+            }
+            reply->deleteLater();
+            sendNextRequest(client);
+        });
+    };
+    QElapsedTimer timer;
+    timer.start();
+    for(int i=0; i<qMin(concurrency, tilePaths.size()); i++) {
+        clients.push_back(std::make_unique<QNetworkAccessManager>());
+        activeClients++;
+        sendNextRequest(clients.back().get());
+    }
+    loop.exec();
+    auto totalNs = timer.nsecsElapsed();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[qMin(latencies.size()-1, static_cast<int>(p*latencies.size()))]/1000.0;
+    };
+    report(QStringLiteral("Requests"), tilePaths.size(), QString());
+    report(QStringLiteral("Concurrency"), concurrency, QString());
+    report(QStringLiteral("Throughput"), tilePaths.size()*1.0e9/totalNs, QStringLiteral("requests/s"));
+    report(QStringLiteral("Median latency"), percentile(0.5), QStringLiteral("µs"));
+    report(QStringLiteral("p99 latency"), percentile(0.99), QStringLiteral("µs"));
+    report(QStringLiteral("Data received"), bytesReceived/1024.0, QStringLiteral("kB"));
+    report(QStringLiteral("Tiles not found"), notFound, QString());
+    report(QStringLiteral("Failed requests"), errors, QString());
+    auto hits = server->tileCache()->hits()-hitsBefore;
+    auto misses = server->tileCache()->misses()-missesBefore;
+    if (hits+misses > 0) {
+        report(QStringLiteral("Cache hit rate"), 100.0*static_cast<double>(hits)/static_cast<double>(hits+misses), QStringLiteral("%"));
+    }
+
+    clients.clear();
+    delete server;
+    qDeleteAll(tileFiles);
+    return (errors == 0) ? 0 : 1;
+}
+
+
+auto Benchmark::traffic(const QStringList& fileNames) -> int
+{
+    if (fileNames.isEmpty()) {
+        QTextStream(stderr) << QStringLiteral("Benchmark traffic requires traffic capture files or FLARM simulator files as arguments") << Qt::endl;
+        return 1;
+    }
+
+    // Read the messages, sorted by protocol
+    QVector<QByteArray> FLARMSentences;
+    QVector<QByteArray> GDLMessages;
+    QVector<QByteArray> XGPSStrings;
+    foreach(auto fileName, fileNames) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            QTextStream(stderr) << QStringLiteral("Cannot read file '%1'").arg(fileName) << Qt::endl;
+            return 1;
+        }
+        auto data = file.readAll();
+
+        // Capture file
+        if ((data.size() >= static_cast<int>(sizeof Traffic::TrafficCaptureRecorder::magic))
+                && (memcmp(data.constData(), Traffic::TrafficCaptureRecorder::magic, sizeof Traffic::TrafficCaptureRecorder::magic) == 0)) {
+            int position = sizeof Traffic::TrafficCaptureRecorder::magic;
+            while (position+Traffic::TrafficCaptureRecorder::frameHeaderSize <= data.size()) {
+                auto type = static_cast<quint8>(data[position+8]);
+                auto size = static_cast<qint64>(qFromLittleEndian<quint32>(data.constData()+position+9));
+                position += Traffic::TrafficCaptureRecorder::frameHeaderSize;
+                if (position+size > data.size()) {
+                    break;
+                }
+                auto payload = data.mid(position, static_cast<int>(size));
+                position += static_cast<int>(size);
+                switch(type) {
+                case Traffic::TrafficCaptureRecorder::FLARM:
+                    FLARMSentences.append(payload);
+                    break;
+                case Traffic::TrafficCaptureRecorder::GDL90:
+                    GDLMessages.append(payload);
+                    break;
+                case Traffic::TrafficCaptureRecorder::XGPS:
+                    XGPSStrings.append(payload);
+                    break;
+                }
+            }
+            continue;
+        }
+
+        // FLARM simulator file, with lines of the form "<time> <sentence>"
+        foreach(auto line, data.split('\n')) {
+            auto fields = line.trimmed().split(' ');
+            if (fields.size() >= 2) {
+                FLARMSentences.append(fields[1]);
+            }
+        }
+    }
+
+    // Benchmark the parsers, one protocol at a time
+    BenchmarkDataSource source;
+    auto benchmarkProtocol = [](const QString& protocol, const QVector<QByteArray>& messages, auto processMessage) {
+        if (messages.isEmpty()) {
+            return;
+        }
+
+        auto nsPerPass = nsPerCall([&]() {
+            foreach(const auto& message, messages) {
+                processMessage(message);
+            }
+        });
+
+        // Time every message individually, for at least one second, in
+        // order to find the distribution of processing times. The numbers
+        // include the overhead of QElapsedTimer, typically a few dozen
+        // nanoseconds.
+        QVector<qint64> latencies;
+        QElapsedTimer totalTimer;
+        QElapsedTimer messageTimer;
+        totalTimer.start();
+        do {
+            foreach(const auto& message, messages) {
+                messageTimer.start();
+                processMessage(message);
+                latencies.append(messageTimer.nsecsElapsed());
+            }
+        } while (totalTimer.elapsed() < 1000);
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            return static_cast<double>(latencies[qMin(latencies.size()-1, static_cast<int>(p*latencies.size()))]);
+        };
+
+        report(QStringLiteral("%1 messages").arg(protocol), messages.size(), QString());
+        report(QStringLiteral("%1 throughput").arg(protocol), messages.size()*1.0e9/nsPerPass, QStringLiteral("messages/s"));
+        report(QStringLiteral("%1 median latency").arg(protocol), percentile(0.5), QStringLiteral("ns"));
+        report(QStringLiteral("%1 p99 latency").arg(protocol), percentile(0.99), QStringLiteral("ns"));
+        report(QStringLiteral("%1 maximal latency").arg(protocol), static_cast<double>(latencies.last()), QStringLiteral("ns"));
+    };
+    benchmarkProtocol(QStringLiteral("FLARM"), FLARMSentences, [&](const QByteArray& message) {
+        source.processFLARMSentence(QLatin1String(message.constData(), message.size()));
+    });
+    benchmarkProtocol(QStringLiteral("GDL90"), GDLMessages, [&](const QByteArray& message) {
+        source.processGDLMessage(message.constData(), message.size());
+    });
+    benchmarkProtocol(QStringLiteral("XGPS"), XGPSStrings, [&](const QByteArray& message) {
+        source.processXGPSString(message);
+    });
+
+    if (FLARMSentences.isEmpty() && GDLMessages.isEmpty() && XGPSStrings.isEmpty()) {
+        QTextStream(stderr) << QStringLiteral("No traffic messages found") << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+auto Benchmark::units() -> int
+{
+    // Random inputs, generated before timing
+    const int samples = 4096;
+    QVector<AviationUnits::Angle> courses;
+    QVector<AviationUnits::Speed> windSpeeds;
+    QVector<AviationUnits::Angle> windDirections;
+    QVector<quint32> altitudeCodes;
+    QVector<double> distancesInM;
+    QVector<double> speedsInMPS;
+    auto* generator = QRandomGenerator::global();
+    for(int i=0; i<samples; i++) {
+        courses << AviationUnits::Angle::fromDEG(generator->bounded(360.0));
+        windSpeeds << AviationUnits::Speed::fromKN(generator->bounded(40.0));
+        windDirections << AviationUnits::Angle::fromDEG(generator->bounded(360.0));
+        altitudeCodes << generator->bounded(0x1000U);
+        distancesInM << generator->bounded(20000.0);
+        speedsInMPS << generator->bounded(80.0);
+    }
+    const auto TAS = AviationUnits::Speed::fromKN(100.0);
+    const auto ownPressureAltitude = BenchmarkDataSource::GDLPressureAltitude(0x190);
+
+    double sink = 0.0;
+    auto nsWindTriangle = nsPerCall([&]() {
+        for(int i=0; i<samples; i++) {
+            AviationUnits::Angle WCA;
+            AviationUnits::Speed GS;
+            Navigation::FlightRoute::Leg::solveWindTriangle(courses[i], TAS, windSpeeds[i], windDirections[i], WCA, GS);
+            sink += WCA.toRAD() + GS.toKN();
+        }
+    });
+    auto nsAltitude = nsPerCall([&]() {
+        foreach(auto code, altitudeCodes) {
+            auto vDist = BenchmarkDataSource::GDLPressureAltitude(code) - ownPressureAltitude;
+            if (vDist.isFinite()) {
+                sink += vDist.toFeet();
+            }
+        }
+    });
+    auto nsConversions = nsPerCall([&]() {
+        for(int i=0; i<samples; i++) {
+            auto distance = AviationUnits::Distance::fromM(distancesInM[i]);
+            auto speed = AviationUnits::Speed::fromMPS(speedsInMPS[i]);
+            sink += distance.toNM() + distance.toFeet() + speed.toKN() + speed.toFPM() + (distance/speed).toM();
+        }
+    });
+
+    report(QStringLiteral("Wind triangle"), nsWindTriangle/samples, QStringLiteral("ns/leg"));
+    report(QStringLiteral("GDL90 pressure altitude and vertical distance"), nsAltitude/samples, QStringLiteral("ns/report"));
+    report(QStringLiteral("Conversions of traffic distance and speed"), nsConversions/samples, QStringLiteral("ns/report"));
+    report(QStringLiteral("Checksum of results"), sink, QString());
+    return 0;
+}
+
+
+void Benchmark::report(const QString& label, double value, const QString& unit)
+{
+    QTextStream(stdout) << QStringLiteral("%1: %2 %3").arg(label).arg(value, 0, 'f', 2).arg(unit).trimmed() << Qt::endl;
+}
@@ -0,0 +1,122 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QStringList>
+
+
+/*! \brief Micro-benchmarks for performance-critical code paths
+ *
+ * This class implements a number of benchmarks that can be run from the
+ * command line, using the option "--benchmark <name>". Benchmarks run without
+ * GUI, print their results to stdout and terminate the program. The
+ * positional arguments of the command line are passed on to the benchmark,
+ * typically as a list of input files.
+ *
+ * The following benchmarks exist.
+ *
+ * - gdl90crc: compares the checksum implementations in Traffic::CRC16 on GDL90
+ *   receiver captures, that is, files that contain the raw byte stream sent
+ *   by a GDL90 traffic receiver.
+ *
+ * - flarmreplay: replays FLARM simulator files through
+ *   Traffic::TrafficDataSource_File as fast as possible and reports the
+ *   parser throughput.
+ *
+ * - traffic: feeds the messages of traffic capture files (see
+ *   Traffic::TrafficCaptureRecorder) or FLARM simulator files through the
+ *   parsers of Traffic::TrafficDataSource_Abstract and reports, for each
+ *   protocol, the throughput and the distribution of the time spent per
+ *   message.
+ *
+ * - geomaps: loads GeoJSON aviation maps into a GeoMaps::GeoMapProvider,
+ *   times GeoMapProvider::fillAviationDataCache() with and without parsing,
+ *   and times the queries of the GeoMapProvider over sets of random
+ *   positions, search strings and ICAO codes. For each query, the mean and
+ *   the 99th percentile of the latency are reported, followed by the peak
+ *   resident set size of the process. The benchmark uses
+ *   QStandardPaths::setTestModeEnabled(), so that the caches of the app are
+ *   not touched. The CMake target geomaps_bench runs it on the files listed
+ *   in the cache variable GEOMAPS_BENCH_MAPS.
+ *
+ * - tileserver: starts a GeoMaps::TileServer that serves the MBTiles files
+ *   given as arguments and replays traces of tile requests, as recorded while
+ *   panning and zooming the map. Trace files contain one request per line, in
+ *   the form "z x y" or "z/x/y". The argument "concurrency=N" sets the number
+ *   of clients that send requests in parallel; the default is 4. The
+ *   benchmark reports throughput, median and 99th percentile of the latency,
+ *   and the hit rate of the tile cache. The CMake target tileserver_bench
+ *   runs it with the arguments listed in the cache variable
+ *   TILESERVER_BENCH_ARGS.
+ *
+ * - units: times the numeric code of the legs of flight routes and of
+ *   traffic reports, over random inputs: the wind triangle of
+ *   Navigation::FlightRoute::Leg, the decoding of GDL90 pressure altitudes
+ *   and the unit conversions applied to distances and speeds of traffic.
+ *   The benchmark takes no arguments.
+ */
+
+class Benchmark
+{
+public:
+    /*! \brief Runs a benchmark
+     *
+     * @param name Name of the benchmark
+     *
+     * @param arguments Arguments passed on to the benchmark
+     *
+     * @returns Exit code for the program: 0 on success, 1 on failure
+     */
+    static int run(const QString& name, const QStringList& arguments);
+
+private:
+    // Individual benchmarks
+    static int flarmReplay(const QStringList& fileNames);
+    static int gdl90CRC(const QStringList& fileNames);
+    static int geomaps(const QStringList& fileNames);
+    static int tileServer(const QStringList& arguments);
+    static int traffic(const QStringList& fileNames);
+    static int units();
+
+    // Calls the function repeatedly, for at least minDuration milliseconds,
+    // and returns the mean duration of one call in nanoseconds
+    template<typename F>
+    static double nsPerCall(F function, qint64 minDuration = 1000)
+    {
+        function();
+
+        qint64 calls = 0;
+        QElapsedTimer timer;
+        timer.start();
+        do {
+            function();
+            calls++;
+        } while (timer.elapsed() < minDuration);
+        return static_cast<double>(timer.nsecsElapsed())/static_cast<double>(calls);
+    }
+
+    // Peak resident set size of the process in kilobytes, or -1 if unknown
+    static qint64 peakRSSInKB();
+
+    // Prints one line of output, in the form "label: value unit"
+    static void report(const QString& label, double value, const QString& unit);
+};
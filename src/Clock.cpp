@@ -21,8 +21,11 @@
 #include "Clock.h"
 #include "positioning/PositionProvider.h"
 
+#include <QAbstractEventDispatcher>
 #include <QDate>
+#include <QElapsedTimer>
 #include <QGuiApplication>
+#include <QThread>
 #include <QTimer>
 #include <chrono>
 
@@ -35,18 +38,25 @@ QPointer<Clock> clockStatic {};
 #endif
 
 
+// Cache used by Clock::currentDateTimeUtc(). These variables are only
+// accessed from the main thread.
+namespace {
+QDateTime cachedDateTimeUtc;
+QElapsedTimer cachedDateTimeUtcAge;
+bool cachedDateTimeUtcInvalidationConnected {false};
+constexpr qint64 cachedDateTimeUtcMaxAgeMS = 50;
+}
+
+
 Clock::Clock(QObject *parent) : QObject(parent)
 {
     // We need to update the time regularly. I do not use a simple timer here that emits "timeChanged" once per minute, because I
-    // want the signal to be emitted right after the full minute. So, I use a timer that once a minute set a single-shot time
-    // that is set to fire up 500ms after the full minute. This design will also work reliably if "timer" get out of sync,
-    // for instance because the app was sleeping for a while.
-    auto *timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, &Clock::setSingleShotTimer);
-    timer->setInterval(1min);
-    timer->start();
-
-    // Start the single shot timer once manually
+    // want the signal to be emitted right after the full minute. So, I use a single-shot timer that is set to fire 500ms after
+    // the full minute, and that is set again every time it fires. This design will also work reliably if the timer gets out of
+    // sync, for instance because the app was sleeping for a while. The timer is aligned with the other periodic work of the app
+    // by the Scheduler.
+    m_minuteTimer.setSingleShot(true);
+    connect(&m_minuteTimer, &Scheduler::Timer::timeout, this, &Clock::onMinuteTimer);
     setSingleShotTimer();
 
     // There are a few other events where we want to update the clock
@@ -111,6 +121,33 @@ auto Clock::describePointInTime(QDateTime pointInTime) -> QString
 }
 
 
+auto Clock::currentDateTimeUtc() -> QDateTime
+{
+    auto* application = QCoreApplication::instance();
+    if ((application == nullptr) || (QThread::currentThread() != application->thread())) {
+        return QDateTime::currentDateTimeUtc();
+    }
+
+    // Invalidate the cache whenever the main event loop goes to sleep or
+    // wakes up
+    if (!cachedDateTimeUtcInvalidationConnected) {
+        auto* dispatcher = QAbstractEventDispatcher::instance();
+        if (dispatcher != nullptr) {
+            auto invalidate = []() { cachedDateTimeUtcAge.invalidate(); };
+            QObject::connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, invalidate);
+            QObject::connect(dispatcher, &QAbstractEventDispatcher::awake, invalidate);
+            cachedDateTimeUtcInvalidationConnected = true;
+        }
+    }
+
+    if (!cachedDateTimeUtcAge.isValid() || cachedDateTimeUtcAge.hasExpired(cachedDateTimeUtcMaxAgeMS)) {
+        cachedDateTimeUtc = QDateTime::currentDateTimeUtc();
+        cachedDateTimeUtcAge.start();
+    }
+    return cachedDateTimeUtc;
+}
+
+
 auto Clock::globalInstance() -> Clock *
 {
 #ifndef __clang_analyzer__
@@ -128,10 +165,17 @@ void Clock::setSingleShotTimer()
 {
     QTime current = QDateTime::currentDateTime().time();
     int msecsToNextMinute = 60*1000 - (current.msecsSinceStartOfDay() % (60*1000));
-    QTimer::singleShot(msecsToNextMinute+500, this, &Clock::timeChanged);
-    if (current.msecsSinceStartOfDay() < 1000*60) {
+    m_minuteTimer.start(msecsToNextMinute+500);
+}
+
+
+void Clock::onMinuteTimer()
+{
+    emit timeChanged();
+    if (QDateTime::currentDateTime().time().msecsSinceStartOfDay() < 1000*60) {
         emit dateChanged();
     }
+    setSingleShotTimer();
 }
 
 
@@ -24,6 +24,8 @@
 #include <QGeoCoordinate>
 #include <QObject>
 
+#include "Scheduler.h"
+
 
 /*! \brief This extremely simple class give accss to time and offers a few time-related functions
  *
@@ -83,6 +85,26 @@ public:
      */
     Q_INVOKABLE static QString describePointInTime(QDateTime pointInTime);
 
+    /*! \brief Current time in UTC, cached
+     *
+     * This method is a cheap replacement for QDateTime::currentDateTimeUtc(),
+     * meant for code that handles many messages in a row, such as the traffic
+     * data sources. The time is read from the system once per iteration of the
+     * main event loop and then cached, so that all messages handled in the
+     * same batch share one time stamp. The cache is also refreshed if it is
+     * older than 50ms, as measured by a monotonic clock, so that long batches
+     * or a missing event loop do not lead to stale time stamps.
+     *
+     * The precision is therefore the duration of one event loop iteration,
+     * typically a few milliseconds and never worse than 50ms. This is good
+     * enough for heartbeats, timeouts and staleness checks, but not for
+     * measuring durations. When called from a thread other than the main
+     * thread, this method simply returns QDateTime::currentDateTimeUtc().
+     *
+     * @returns Current time in UTC
+     */
+    static QDateTime currentDateTimeUtc();
+
     /*! \brief Pointer to static instance
      *
      * This method returns a pointer to a static instance of this class. In rare
@@ -131,4 +153,10 @@ signals:
 private:
     // Sets a single shot timer to emit timeChanged just after the full minute
     void setSingleShotTimer();
+
+    // Emits timeChanged, and dateChanged after midnight. Connected to
+    // m_minuteTimer.
+    void onMinuteTimer();
+
+    Scheduler::Timer m_minuteTimer {Scheduler::Time};
 };
@@ -19,19 +19,37 @@
  ***************************************************************************/
 
 #include <QApplication>
+#include <QDateTime>
 #include <QDebug>
 #include <QEventLoop>
+#include <QFile>
+#include <QGeoCoordinate>
+#include <QJsonArray>
+#include <QJsonDocument>
 #include <QQmlApplicationEngine>
 #include <QQuickItem>
 #include <QQuickWindow>
+#include <QSysInfo>
 #include <QTimer>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
 
 #include "DemoRunner.h"
 #include "Global.h"
+#include "MemoryBudget.h"
+#include "Metrics.h"
+#include "Scheduler.h"
 #include "Settings.h"
 #include "geomaps/GeoMapProvider.h"
+#include "navigation/FlightRoute.h"
+#include "navigation/Navigator.h"
 #include "traffic/TrafficDataProvider.h"
+#include "traffic/TrafficDataSource_File.h"
 #include "traffic/TrafficDataSource_Simulate.h"
 
 using namespace std::chrono_literals;
@@ -67,7 +85,24 @@ auto findQQuickItem(const QString &objectName, QQmlApplicationEngine* engine) ->
 }
 
 
+void DemoRunner::setPerformanceReport(const QString& reportFileName, const QString& captureFileName)
+{
+    m_reportFileName = reportFileName;
+    m_captureFileName = captureFileName;
+}
+
+
 void DemoRunner::run()
+{
+    if (m_reportFileName.isEmpty()) {
+        runScreenshots();
+    } else {
+        runPerformanceScenario();
+    }
+}
+
+
+void DemoRunner::runScreenshots()
 {
     auto *engine = qobject_cast<QQmlApplicationEngine*>(parent());
     Q_ASSERT(engine != nullptr);
@@ -134,3 +169,251 @@ void DemoRunner::run()
 }
 
 
+
+
+// Resident set size of the process in bytes, or -1 if unknown
+auto residentSetSize() -> qint64
+{
+#if defined(Q_OS_LINUX)
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    auto fields = statm.readAll().split(' ');
+    if (fields.size() < 2) {
+        return -1;
+    }
+    return fields[1].toLongLong()*sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+
+// Number of calls and total duration of all probes, as parsed from Metrics::toJSON()
+auto metricsProbes() -> QJsonObject
+{
+    return QJsonDocument::fromJson(Metrics::toJSON()).object().value(QStringLiteral("probes")).toObject();
+}
+
+
+auto DemoRunner::takeFrameStatistics() -> QJsonObject
+{
+    QVector<qint64> intervals;
+    {
+        QMutexLocker locker(&m_frameMutex);
+        intervals.swap(m_frameIntervals_ns);
+        m_lastFrame_ns = -1;
+    }
+    std::sort(intervals.begin(), intervals.end());
+
+    QJsonObject result;
+    result.insert(QStringLiteral("count"), intervals.size());
+    if (intervals.isEmpty()) {
+        return result;
+    }
+    auto percentile = [&intervals](double p) {
+        auto index = qBound(0, static_cast<int>(std::ceil(p*intervals.size()))-1, intervals.size()-1);
+        return static_cast<double>(intervals[index])/1e6;
+    };
+    qint64 total_ns = 0;
+    int slowFrames = 0;
+    foreach(auto interval, intervals) {
+        total_ns += interval;
+        if (interval > slowFrame_ns) {
+            slowFrames++;
+        }
+    }
+    result.insert(QStringLiteral("mean_ms"), static_cast<double>(total_ns)/intervals.size()/1e6);
+    result.insert(QStringLiteral("p50_ms"), percentile(0.50));
+    result.insert(QStringLiteral("p95_ms"), percentile(0.95));
+    result.insert(QStringLiteral("p99_ms"), percentile(0.99));
+    result.insert(QStringLiteral("max_ms"), static_cast<double>(intervals.last())/1e6);
+    result.insert(QStringLiteral("slowFrames"), slowFrames);
+    return result;
+}
+
+
+auto DemoRunner::measure(const QString& name, QQuickWindow* window, const std::function<void()>& step) -> QJsonObject
+{
+    qWarning() << "Performance Scenario" << name;
+
+    auto probesBefore = metricsProbes();
+    auto wakeupsBefore = Scheduler::wakeupsBySubsystem();
+    auto ticksBefore = Scheduler::ticks();
+    takeFrameStatistics();
+    QElapsedTimer timer;
+    timer.start();
+
+    // Make sure that frames are rendered continuously during the step, even
+    // if nothing changes on the screen
+    auto connection = connect(window, &QQuickWindow::frameSwapped, window, &QQuickWindow::update);
+    step();
+    disconnect(connection);
+
+    QJsonObject result;
+    result.insert(QStringLiteral("name"), name);
+    result.insert(QStringLiteral("duration_ms"), timer.elapsed());
+    result.insert(QStringLiteral("frames"), takeFrameStatistics());
+
+    // Calls and time spent in the probes during the step
+    QJsonObject probes;
+    auto probesAfter = metricsProbes();
+    for(auto iterator = probesAfter.constBegin(); iterator != probesAfter.constEnd(); ++iterator) {
+        auto after = iterator.value().toObject();
+        auto before = probesBefore.value(iterator.key()).toObject();
+        QJsonObject probe;
+        for(const auto& key : {QStringLiteral("count"), QStringLiteral("total_us")}) {
+            probe.insert(key, static_cast<qint64>(after.value(key).toDouble()-before.value(key).toDouble()));
+        }
+        probes.insert(iterator.key(), probe);
+    }
+    result.insert(QStringLiteral("metrics"), probes);
+
+    // Shared ticks of the Scheduler, and timers fired per subsystem
+    QJsonObject wakeups;
+    wakeups.insert(QStringLiteral("ticks"), Scheduler::ticks()-ticksBefore);
+    auto wakeupsAfter = Scheduler::wakeupsBySubsystem();
+    for(auto iterator = wakeupsAfter.constBegin(); iterator != wakeupsAfter.constEnd(); ++iterator) {
+        wakeups.insert(iterator.key(), iterator.value().toLongLong()-wakeupsBefore.value(iterator.key()).toLongLong());
+    }
+    result.insert(QStringLiteral("wakeups"), wakeups);
+
+    // Memory usage at the end of the step
+    auto memory = QJsonObject::fromVariantMap(MemoryBudget::usageBySubsystem());
+    memory.insert(QStringLiteral("residentSetSize"), residentSetSize());
+    result.insert(QStringLiteral("memory"), memory);
+    return result;
+}
+
+
+void DemoRunner::runPerformanceScenario()
+{
+    auto *engine = qobject_cast<QQmlApplicationEngine*>(parent());
+    Q_ASSERT(engine != nullptr);
+
+    // Obtain pointers to QML items
+    auto* applicationWindow =  qobject_cast<QQuickWindow*>(findQQuickItem("applicationWindow", engine));
+    Q_ASSERT(applicationWindow != nullptr);
+    auto* flightMap = findQQuickItem("flightMap", engine);
+    Q_ASSERT(flightMap != nullptr);
+
+    qWarning() << "Performance Scenario" << "Running Scenario";
+
+    // Use a fixed window size and language, so that reports are comparable
+    applicationWindow->setProperty("width", 400);
+    applicationWindow->setProperty("height", 600);
+    Global::settings()->installTranslators("en");
+    engine->retranslate();
+    Global::settings()->setMapBearingPolicy(Settings::NUp);
+    flightMap->setProperty("followGPS", false);
+
+    // Record the intervals between frames. The signal is emitted in the
+    // render thread, so the connection must be direct.
+    m_frameClock.start();
+    connect(applicationWindow, &QQuickWindow::frameSwapped, this, [this]() {
+        QMutexLocker locker(&m_frameMutex);
+        auto now_ns = m_frameClock.nsecsElapsed();
+        if (m_lastFrame_ns >= 0) {
+            m_frameIntervals_ns.append(now_ns-m_lastFrame_ns);
+        }
+        m_lastFrame_ns = now_ns;
+    }, Qt::DirectConnection);
+
+    // Route along which the map is panned. If the current flight route is
+    // too short, use a fixed route through south-west Germany.
+    auto route = Global::navigator()->flightRoute()->coordinates();
+    if (route.size() < 2) {
+        route = {{48.02197, 7.83451}, {49.2146, 7.1095}, {48.6899, 9.2220}};
+    }
+
+    QJsonArray steps;
+
+    // Pan along the route, at fixed zoom
+    steps.append(measure(QStringLiteral("pan"), applicationWindow, [&]() {
+        flightMap->setProperty("zoomLevel", 11);
+        for(int leg=0; leg+1<route.size(); leg++) {
+            for(int i=0; i<panStepsPerLeg; i++) {
+                auto fraction = static_cast<double>(i)/panStepsPerLeg;
+                auto center = route[leg].atDistanceAndAzimuth(fraction*route[leg].distanceTo(route[leg+1]), route[leg].azimuthTo(route[leg+1]));
+                flightMap->setProperty("center", QVariant::fromValue(center));
+                delay(100ms);
+            }
+        }
+    }));
+
+    // Zoom out and in again, at the start of the route
+    steps.append(measure(QStringLiteral("zoom"), applicationWindow, [&]() {
+        flightMap->setProperty("center", QVariant::fromValue(route[0]));
+        for(double zoom=13.0; zoom>=7.0; zoom -= 0.5) {
+            flightMap->setProperty("zoomLevel", zoom);
+            delay(200ms);
+        }
+        for(double zoom=7.0; zoom<=13.0; zoom += 0.5) {
+            flightMap->setProperty("zoomLevel", zoom);
+            delay(200ms);
+        }
+    }));
+
+    // Search for a waypoint, one key stroke at a time, as the search dialog
+    // does when the user types
+    steps.append(measure(QStringLiteral("search"), applicationWindow, [&]() {
+        const QString query = QStringLiteral("Freiburg");
+        for(int length=1; length<=query.size(); length++) {
+            Global::geoMapProvider()->filteredWaypointObjects(query.left(length));
+            delay(100ms);
+        }
+    }));
+
+    // Replay traffic, with ownship at the start of the route
+    steps.append(measure(QStringLiteral("traffic"), applicationWindow, [&]() {
+        flightMap->setProperty("zoomLevel", 11);
+        if (m_captureFileName.isEmpty()) {
+            auto* trafficSimulator = new Traffic::TrafficDataSource_Simulate();
+            auto coordinate = route[0];
+            coordinate.setAltitude(1000.0);
+            trafficSimulator->setCoordinate(coordinate);
+            trafficSimulator->setBarometricHeight( AviationUnits::Distance::fromM(1000.0) );
+            trafficSimulator->setTT( AviationUnits::Angle::fromDEG(0.0) );
+            trafficSimulator->setGS( AviationUnits::Speed::fromKN(0.0) );
+            Traffic::TrafficDataSource_Simulate::Scenario scenario;
+            scenario.numberOfTargets = 50;
+            scenario.motionPattern = Traffic::TrafficDataSource_Simulate::Circling;
+            trafficSimulator->setScenario(scenario);
+            Global::trafficDataProvider()->addDataSource(trafficSimulator);
+            trafficSimulator->connectToTrafficReceiver();
+            delay(trafficDuration);
+            trafficSimulator->disconnectFromTrafficReceiver();
+            return;
+        }
+
+        auto* fileSource = new Traffic::TrafficDataSource_File(m_captureFileName);
+        Global::trafficDataProvider()->addDataSource(fileSource);
+        QEventLoop loop;
+        connect(fileSource, &Traffic::TrafficDataSource_File::replayFinished, &loop, &QEventLoop::quit);
+        QTimer::singleShot(trafficDuration, &loop, &QEventLoop::quit);
+        fileSource->connectToTrafficReceiver();
+        loop.exec();
+        fileSource->disconnectFromTrafficReceiver();
+    }));
+
+    // Write report
+    QJsonObject report;
+    report.insert(QStringLiteral("version"), QStringLiteral(PROJECT_VERSION));
+    report.insert(QStringLiteral("qtVersion"), QString::fromLatin1(qVersion()));
+    report.insert(QStringLiteral("product"), QSysInfo::prettyProductName());
+    report.insert(QStringLiteral("cpuArchitecture"), QSysInfo::currentCpuArchitecture());
+    report.insert(QStringLiteral("date"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    report.insert(QStringLiteral("steps"), steps);
+
+    QFile file(m_reportFileName);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(report).toJson());
+        qWarning() << "Performance Scenario" << "Report written to" << m_reportFileName;
+    } else {
+        qWarning() << "Performance Scenario" << "Cannot write report to" << m_reportFileName;
+    }
+
+    // Done. Terminate the program.
+    QApplication::exit();
+}
@@ -20,12 +20,29 @@
 
 #pragma once
 
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+#include <chrono>
+#include <functional>
+
+class QQuickWindow;
+
 
 /*! \brief Remote controls the app and takes screenshot images
  *
  * This class remote controls the app.  It sets up a traffic data receiver simulator,
  * feeds it with data and controls the GUI, in order to generate a sequence of screenshots,
  * which can then be used in the manual and as propaganda material.
+ *
+ * Alternatively, the class runs a fixed performance scenario: it pans and
+ * zooms the map along the current flight route, searches for waypoints and
+ * replays traffic data. For every step, it records frame times, the data of
+ * the Metrics probes and the memory usage, and writes everything to a JSON
+ * report, see setPerformanceReport(). Reports made with the same scenario on
+ * the same device can be compared between releases.
  */
 
 class DemoRunner : public QObject {
@@ -43,10 +60,58 @@ public:
     // Standard destructor
     ~DemoRunner() override = default;
 
+    /*! \brief Run the performance scenario instead of taking screenshots
+     *
+     * This method must be called before the DemoRunner begins to remote
+     * control the app, that is, right after construction.
+     *
+     * @param reportFileName Name of the JSON file that the report is written to
+     *
+     * @param captureFileName Name of a traffic capture or simulator file, as
+     * read by Traffic::TrafficDataSource_File. If empty, simulated traffic is
+     * used instead.
+     */
+    void setPerformanceReport(const QString& reportFileName, const QString& captureFileName = QString());
+
 private slots:
     // Begin to remote-control the app
     void run();
 
 private:
     Q_DISABLE_COPY_MOVE(DemoRunner)
+
+    // Takes the screenshots for the manual
+    void runScreenshots();
+
+    // Runs the performance scenario and writes the report
+    void runPerformanceScenario();
+
+    // Runs one step of the performance scenario, and returns the frame
+    // times, the Metrics data collected during the step, and the memory usage
+    // at its end
+    QJsonObject measure(const QString& name, QQuickWindow* window, const std::function<void()>& step);
+
+    // Statistics of the frame times recorded since the last call, in
+    // milliseconds
+    QJsonObject takeFrameStatistics();
+
+    // Number of map positions per leg of the route, when panning
+    static constexpr int panStepsPerLeg = 40;
+
+    // Maximal duration of the traffic replay
+    static constexpr std::chrono::seconds trafficDuration {30};
+
+    // Frames that take longer than this are counted as slow (60 fps)
+    static constexpr qint64 slowFrame_ns = 16666667;
+
+    // File names, as set by setPerformanceReport()
+    QString m_reportFileName;
+    QString m_captureFileName;
+
+    // Intervals between frames, in nanoseconds. The intervals are recorded
+    // in the render thread and are protected by m_frameMutex.
+    QMutex m_frameMutex;
+    QElapsedTimer m_frameClock;
+    qint64 m_lastFrame_ns {-1};
+    QVector<qint64> m_frameIntervals_ns;
 };
@@ -20,10 +20,13 @@
 
 #include <QCoreApplication>
 #include <QNetworkAccessManager>
+#include <QNetworkRequest>
 #include <QQmlEngine>
 
 #include "DemoRunner.h"
 #include "Global.h"
+#include "MemoryBudget.h"
+#include "Metrics.h"
 #include "MobileAdaptor.h"
 #include "Settings.h"
 #include "geomaps/GeoMapProvider.h"
@@ -35,6 +38,7 @@ bool isConstructing {false};
 
 QPointer<GeoMaps::GeoMapProvider> g_geoMapProvider {};
 QPointer<GeoMaps::MapManager> g_mapManager {};
+QPointer<MemoryBudget> g_memoryBudget {};
 QPointer<MobileAdaptor> g_mobileAdaptor {};
 QPointer<Navigation::Navigator> g_navigator {};
 QPointer<QNetworkAccessManager> g_networkAccessManager {};
@@ -75,12 +79,24 @@ auto Global::mapManager() -> GeoMaps::MapManager*
 }
 
 
+auto Global::memoryBudget() -> MemoryBudget*
+{
+    return allocateInternal<MemoryBudget>(g_memoryBudget);
+}
+
+
 auto Global::mobileAdaptor() -> MobileAdaptor*
 {
     return allocateInternal<MobileAdaptor>(g_mobileAdaptor);
 }
 
 
+auto Global::metrics() -> QString
+{
+    return QString::fromUtf8(Metrics::toJSON());
+}
+
+
 auto Global::navigator() -> Navigation::Navigator*
 {
     return allocateInternal<Navigation::Navigator>(g_navigator);
@@ -93,6 +109,15 @@ auto Global::networkAccessManager() -> QNetworkAccessManager*
 }
 
 
+auto Global::networkRequest(const QUrl& url) -> QNetworkRequest
+{
+    QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+    return request;
+}
+
+
 auto Global::settings() -> Settings*
 {
     return allocateInternal<Settings>(g_settings);
@@ -23,8 +23,11 @@
 #include <QObject>
 
 class DemoRunner;
+class MemoryBudget;
 class MobileAdaptor;
 class QNetworkAccessManager;
+class QNetworkRequest;
+class QUrl;
 class Settings;
 
 namespace GeoMaps {
@@ -93,12 +96,25 @@ public:
      */
     Q_INVOKABLE static GeoMaps::MapManager* mapManager();
 
+    /*! \brief Pointer to appplication-wide static MemoryBudget instance
+     *
+     * @returns Pointer to appplication-wide static instance.
+     */
+    Q_INVOKABLE static MemoryBudget* memoryBudget();
+
     /*! \brief Pointer to appplication-wide static MobileAdaptor instance
      *
      * @returns Pointer to appplication-wide static instance.
      */
     Q_INVOKABLE static MobileAdaptor* mobileAdaptor();
 
+    /*! \brief Performance metrics
+     *
+     * @returns Counters and latency histograms of the performance-critical
+     * code paths, in the JSON format described in Metrics::toJSON()
+     */
+    Q_INVOKABLE static QString metrics();
+
     /*! \brief Pointer to appplication-wide static Navigation::Navigator instance
      *
      * @returns Pointer to appplication-wide static instance.
@@ -111,6 +127,21 @@ public:
      */
     Q_INVOKABLE static QNetworkAccessManager* networkAccessManager();
 
+    /*! \brief Network request for use with networkAccessManager()
+     *
+     * All requests of the app should be constructed with this method. The
+     * requests allow HTTP/2, so that all requests to one server, such as the
+     * downloads of maps and their update checks, are multiplexed over a
+     * single connection. Servers that only speak HTTP/1.1 get pipelined
+     * requests over the persistent connections kept by the
+     * networkAccessManager().
+     *
+     * @param url URL of the request
+     *
+     * @returns Network request
+     */
+    static QNetworkRequest networkRequest(const QUrl& url);
+
     /*! \brief Pointer to appplication-wide static Settings instance
      *
      * @returns Pointer to appplication-wide static instance.
@@ -18,7 +18,11 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include "Global.h"
 #include "Librarian.h"
+#include "Settings.h"
+#include "geomaps/WaypointSearchIndex.h"
+#include "units/Distance.h"
 
 #include <QNetworkAccessManager>
 #include <QStandardPaths>
@@ -50,6 +54,9 @@ Librarian::Librarian(QObject *parent) : QObject(parent)
         }
     }
     d.rmdir(oldlibraryPath);
+
+    flightRouteIndex = new Navigation::FlightRouteIndex(libraryPath, this);
+    connect(flightRouteIndex, &Navigation::FlightRouteIndex::changed, this, &Librarian::flightRoutesChanged);
 }
 
 
@@ -540,28 +547,48 @@ auto Librarian::flightRouteFullPath(const QString &baseName) const -> QString
 
 void Librarian::flightRouteRemove(const QString &baseName) const
 {
-    QFile::remove(flightRouteFullPath(baseName));
+    if (QFile::remove(flightRouteFullPath(baseName))) {
+        flightRouteIndex->remove(baseName);
+    }
 }
 
 
 void Librarian::flightRouteRename(const QString &oldName, const QString &newName) const
 {
-    QFile::rename(flightRouteFullPath(oldName), flightRouteFullPath(newName));
+    if (QFile::rename(flightRouteFullPath(oldName), flightRouteFullPath(newName))) {
+        flightRouteIndex->rename(oldName, newName);
+    }
 }
 
 
 auto Librarian::flightRoutes(const QString &filter) -> QStringList
 {
-    QStringList filterList;
-    filterList << "*.geojson";
+    // The simplified names in the index are in lower case, so this is the
+    // same test as in permissiveFilter()
+    auto simplifiedFilter = GeoMaps::WaypointSearchIndex::simplify(filter);
+
+    QStringList result;
+    foreach(const auto& entry, flightRouteIndex->entries()) {
+        if (entry.simplifiedName.contains(simplifiedFilter)) {
+            result << entry.name;
+        }
+    }
+    return result;
+}
 
-    auto fileNames = flightRouteLibraryDir.entryList(filterList);
 
-    QStringList fileBaseNames;
-    foreach(auto fileName, fileNames)
-        fileBaseNames << fileName.section('.', 0, -2);
+auto Librarian::flightRouteSummary(const QString &baseName) const -> QString
+{
+    auto entry = flightRouteIndex->entry(baseName);
+    if (entry.name.isEmpty()) {
+        return {};
+    }
 
-    return permissiveFilter(fileBaseNames, filter);
+    auto distance = AviationUnits::Distance::fromM(entry.distanceM);
+    if (Global::settings()->useMetricUnits()) {
+        return tr("%n waypoint(s)", nullptr, entry.waypointCount) + QStringLiteral(" • %1&nbsp;km").arg(distance.toKM(), 0, 'f', 1);
+    }
+    return tr("%n waypoint(s)", nullptr, entry.waypointCount) + QStringLiteral(" • %1&nbsp;nm").arg(distance.toNM(), 0, 'f', 1);
 }
 
 
@@ -581,12 +608,14 @@ auto Librarian::globalInstance() -> Librarian*
 auto Librarian::permissiveFilter(const QStringList &inputStrings, const QString &filter) -> QStringList
 {
     QString simplifiedFilter = simplifySpecialChars(filter);
+    auto simplifiedStrings = simplifySpecialChars(inputStrings);
 
     QStringList result;
-    foreach(auto inputString, inputStrings)
-        if (simplifySpecialChars(inputString).contains(simplifiedFilter, Qt::CaseInsensitive)) {
-            result << inputString;
+    for(int i=0; i<inputStrings.size(); i++) {
+        if (simplifiedStrings[i].contains(simplifiedFilter, Qt::CaseInsensitive)) {
+            result << inputStrings[i];
         }
+    }
 
     return result;
 }
@@ -594,11 +623,98 @@ auto Librarian::permissiveFilter(const QStringList &inputStrings, const QString
 
 auto Librarian::simplifySpecialChars(const QString &string) -> QString
 {
-    QString cacheString = simplifySpecialChars_cache[string];
-    if (!cacheString.isEmpty()) {
-        return cacheString;
+    if (isSimple(string)) {
+        return string;
+    }
+
+    {
+        QMutexLocker locker(&simplifySpecialChars_mutex);
+        auto iterator = simplifySpecialChars_cache.constFind(string);
+        if (iterator != simplifySpecialChars_cache.constEnd()) {
+            return iterator.value();
+        }
     }
 
-    QString normalizedString = string.normalized(QString::NormalizationForm_KD);
-    return normalizedString.remove(specialChars);
+    // Compute the result without holding the lock
+    auto result = simplifySpecialCharsUncached(string);
+    QMutexLocker locker(&simplifySpecialChars_mutex);
+    if (simplifySpecialChars_cache.size() >= maxSimplifySpecialCharsCacheSize) {
+        simplifySpecialChars_cache.clear();
+    }
+    simplifySpecialChars_cache.insert(string, result);
+    return result;
+}
+
+
+auto Librarian::simplifySpecialChars(const QStringList &strings) -> QStringList
+{
+    // Look up all strings in the cache, and remember those that are missing
+    QStringList result;
+    result.reserve(strings.size());
+    QVector<int> missing;
+    {
+        QMutexLocker locker(&simplifySpecialChars_mutex);
+        for(int i=0; i<strings.size(); i++) {
+            const auto& string = strings[i];
+            if (isSimple(string)) {
+                result << string;
+                continue;
+            }
+            auto iterator = simplifySpecialChars_cache.constFind(string);
+            if (iterator != simplifySpecialChars_cache.constEnd()) {
+                result << iterator.value();
+                continue;
+            }
+            result << QString();
+            missing << i;
+        }
+    }
+    if (missing.isEmpty()) {
+        return result;
+    }
+
+    // Compute the missing results without holding the lock
+    foreach(auto index, missing) {
+        result[index] = simplifySpecialCharsUncached(strings[index]);
+    }
+    QMutexLocker locker(&simplifySpecialChars_mutex);
+    if (simplifySpecialChars_cache.size()+missing.size() > maxSimplifySpecialCharsCacheSize) {
+        simplifySpecialChars_cache.clear();
+    }
+    foreach(auto index, missing) {
+        if (simplifySpecialChars_cache.size() >= maxSimplifySpecialCharsCacheSize) {
+            break;
+        }
+        simplifySpecialChars_cache.insert(strings[index], result[index]);
+    }
+    return result;
+}
+
+
+auto Librarian::isSimple(const QString &string) -> bool
+{
+    foreach(auto character, string) {
+        auto unicode = character.unicode();
+        if (((unicode < 'a') || (unicode > 'z')) && ((unicode < 'A') || (unicode > 'Z')) && ((unicode < '0') || (unicode > '9'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+auto Librarian::simplifySpecialCharsUncached(const QString &string) -> QString
+{
+    // Remove every character that is not an ASCII letter or digit, as the
+    // regular expression "[^a-zA-Z0-9]" would
+    QString result;
+    auto normalizedString = string.normalized(QString::NormalizationForm_KD);
+    result.reserve(normalizedString.size());
+    foreach(auto character, normalizedString) {
+        auto unicode = character.unicode();
+        if (((unicode >= 'a') && (unicode <= 'z')) || ((unicode >= 'A') && (unicode <= 'Z')) || ((unicode >= '0') && (unicode <= '9'))) {
+            result += character;
+        }
+    }
+    return result;
 }
@@ -15,10 +15,11 @@
 #pragma once
 
 #include <QDir>
-#include <QRegularExpression>
+#include <QMutex>
 #include <QSettings>
 
 #include "navigation/FlightRoute.h"
+#include "navigation/FlightRouteIndex.h"
 
 /*! \brief Manage libraries of flight routes and text assets
 
@@ -133,7 +134,9 @@ public:
 
     /*! \brief Lists all flight routes in the library whose name contains the string 'filter'
      *
-     * The check for string containment is done in a fuzzy way.
+     * The check for string containment is done in a fuzzy way. The list is
+     * taken from the index of the library and does not access the route
+     * files.
      *
      * @param filter String used to filter the list
      *
@@ -143,6 +146,18 @@ public:
      */
     Q_INVOKABLE QStringList flightRoutes(const QString &filter=QString());
 
+    /*! \brief Short description of a flight route in the library
+     *
+     * The description is taken from the index of the library and does not
+     * access the route file.
+     *
+     * @param baseName File name, without path and without extension
+     *
+     * @returns Human-readable summary, with number of waypoints and length of
+     * the route, or an empty string if the route is not known
+     */
+    Q_INVOKABLE QString flightRouteSummary(const QString &baseName) const;
+
     /*! \brief Pointer to static instance of this class
      *
      *  @returns Pointer to global instance
@@ -167,7 +182,9 @@ public:
      *
      * This helper method simplifies a unicode string, by transforming it to
      * QString::NormalizationForm_KD and then removing all 'special' character.
-     * The results are cached for better performance.
+     * Strings that consist of ASCII letters and digits only are returned
+     * unchanged. All other results are cached for better performance. This
+     * method is thread-safe.
      *
      * @param string Input string
      *
@@ -175,13 +192,41 @@ public:
      */
     QString simplifySpecialChars(const QString &string);
 
+    /*! \brief Simplifies a list of strings
+     *
+     * This method does the same as simplifySpecialChars(const QString&) for
+     * every string of the list, but locks the cache only twice.
+     *
+     * @param strings Input strings
+     *
+     * @return Simplified strings, in the same order
+     */
+    QStringList simplifySpecialChars(const QStringList &strings);
+
+signals:
+    /*! \brief Emitted whenever flight routes are added to, removed from or changed in the library */
+    void flightRoutesChanged();
+
 private:
     Q_DISABLE_COPY_MOVE(Librarian)
 
     QDir flightRouteLibraryDir;
 
-    // Caches used to speed up the method simplifySpecialChars
-    QRegularExpression specialChars {"[^a-zA-Z0-9]"};
+    // Index of the flight route library
+    Navigation::FlightRouteIndex* flightRouteIndex {nullptr};
+
+    // Returns true if the string consists of ASCII letters and digits only,
+    // so that simplifySpecialChars() would not change it
+    static bool isSimple(const QString &string);
+
+    // Computes the result of simplifySpecialChars(), without using the cache
+    static QString simplifySpecialCharsUncached(const QString &string);
+
+    // Cache used to speed up the method simplifySpecialChars. The cache is
+    // cleared when it reaches its maximal size, and must only be accessed
+    // with simplifySpecialChars_mutex locked.
     QHash<QString, QString> simplifySpecialChars_cache;
+    QMutex simplifySpecialChars_mutex;
+    static constexpr int maxSimplifySpecialCharsCacheSize = 4096;
 
 };
@@ -0,0 +1,72 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QMetaEnum>
+
+#include "Global.h"
+#include "MemoryBudget.h"
+#include "geomaps/GeoMapProvider.h"
+#include "traffic/TrafficDataProvider.h"
+#include "weather/WeatherDataProvider.h"
+
+
+MemoryBudget::MemoryBudget(QObject *parent)
+    : QObject(parent)
+{
+}
+
+
+auto MemoryBudget::usage(Subsystem subsystem) -> qint64
+{
+    switch(subsystem) {
+    case AviationData:
+        return Global::geoMapProvider()->aviationDataMemoryUsage();
+    case Tiles:
+        return Global::geoMapProvider()->tileCacheMemoryUsage();
+    case Weather:
+        return Weather::WeatherDataProvider::globalInstance()->memoryUsage();
+    case Traffic:
+        return Global::trafficDataProvider()->memoryUsage();
+    case SubsystemCount:
+        break;
+    }
+    return 0;
+}
+
+
+auto MemoryBudget::usageBySubsystem() -> QVariantMap
+{
+    QVariantMap result;
+    auto metaEnum = QMetaEnum::fromType<Subsystem>();
+    for(int i=0; i<SubsystemCount; i++) {
+        result.insert(QString::fromLatin1(metaEnum.valueToKey(i)), usage(static_cast<Subsystem>(i)));
+    }
+    return result;
+}
+
+
+void MemoryBudget::onTrimMemory(int level)
+{
+    if ((level >= TrimMemoryRunningLow) && !m_lowMemoryMode) {
+        m_lowMemoryMode = true;
+        emit lowMemoryModeChanged();
+    }
+    emit trimCaches();
+}
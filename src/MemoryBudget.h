@@ -0,0 +1,152 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QObject>
+#include <QVariantMap>
+
+
+/*! \brief Memory accounting and low-memory mode
+ *
+ * This class collects estimates of the memory used by the large subsystems of
+ * the app: aviation data, map tiles, weather and traffic. The estimates are
+ * computed on demand, from the sizes of the data held by the
+ * GeoMaps::GeoMapProvider, the Weather::WeatherDataProvider and the
+ * Traffic::TrafficDataProvider. They are shown on the diagnostics page of the
+ * GUI.
+ *
+ * On Android, the operating system asks running apps to free memory before it
+ * kills them. These requests are passed on to onTrimMemory(). If the request
+ * is urgent, the app enters low-memory mode, in which it trades speed for
+ * memory: the subsystems drop their caches whenever trimCaches() is emitted,
+ * and keep smaller caches from then on. Low-memory mode is never left while
+ * the app runs.
+ *
+ * The instance of this class is managed by Global. Subsystems connect to its
+ * signals in their deferred initialisation.
+ */
+
+class MemoryBudget : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*! \brief Subsystems whose memory usage is accounted for */
+    enum Subsystem
+    {
+        /*! \brief Parsed aviation maps and the indices built from them */
+        AviationData,
+
+        /*! \brief Tile data held in the cache of the tile server */
+        Tiles,
+
+        /*! \brief Weather stations, METARs and TAFs */
+        Weather,
+
+        /*! \brief Traffic factors and data sources */
+        Traffic,
+
+        /*! \brief Number of subsystems; not a subsystem */
+        SubsystemCount
+    };
+    Q_ENUM(Subsystem)
+
+    /*! \brief Trim levels, as defined by Android's ComponentCallbacks2
+     *
+     * Requests at level TrimMemoryRunningLow or above make the app enter
+     * low-memory mode.
+     */
+    enum TrimLevel
+    {
+        TrimMemoryRunningModerate = 5,
+        TrimMemoryRunningLow = 10,
+        TrimMemoryRunningCritical = 15,
+        TrimMemoryUIHidden = 20,
+        TrimMemoryBackground = 40,
+        TrimMemoryModerate = 60,
+        TrimMemoryComplete = 80
+    };
+    Q_ENUM(TrimLevel)
+
+    /*! \brief Standard constructor
+     *
+     * @param parent The standard QObject parent pointer
+     */
+    explicit MemoryBudget(QObject *parent = nullptr);
+
+    // Standard destructor
+    ~MemoryBudget() override = default;
+
+    /*! \brief Indicates if the app runs in low-memory mode */
+    Q_PROPERTY(bool lowMemoryMode READ lowMemoryMode NOTIFY lowMemoryModeChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property lowMemoryMode
+     */
+    bool lowMemoryMode() const { return m_lowMemoryMode; }
+
+    /*! \brief Estimated memory usage of a subsystem
+     *
+     * The estimate counts the payload of the data held by the subsystem,
+     * together with the size of the objects that hold it. Allocator overhead
+     * is not counted.
+     *
+     * @param subsystem Subsystem
+     *
+     * @returns Estimated memory usage in bytes
+     */
+    static qint64 usage(Subsystem subsystem);
+
+    /*! \brief Estimated memory usage of all subsystems
+     *
+     * @returns Map whose keys are the names of the subsystems, as in the enum
+     * Subsystem, and whose values are the estimated memory usage in bytes
+     */
+    Q_INVOKABLE static QVariantMap usageBySubsystem();
+
+public slots:
+    /*! \brief Handles requests from the operating system to free memory
+     *
+     * This slot emits trimCaches(). If level is TrimMemoryRunningLow or
+     * above, the app also enters low-memory mode. On Android, the slot is
+     * called from Java; it can also be used from QML, for testing.
+     *
+     * @param level Trim level, as in the enum TrimLevel
+     */
+    void onTrimMemory(int level);
+
+signals:
+    /*! \brief Notifier signal */
+    void lowMemoryModeChanged();
+
+    /*! \brief Emitted when subsystems should drop their caches
+     *
+     * Receivers should free all memory that can be recomputed, or read from
+     * disk, when needed.
+     */
+    void trimCaches();
+
+private:
+    Q_DISABLE_COPY_MOVE(MemoryBudget)
+
+    bool m_lowMemoryMode {false};
+};
@@ -0,0 +1,103 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+
+#include "Metrics.h"
+
+
+std::array<Metrics::ProbeData, Metrics::ProbeCount> Metrics::s_probes {};
+
+
+void Metrics::record(Probe probe, qint64 duration_ns)
+{
+    if ((probe < 0) || (probe >= ProbeCount)) {
+        return;
+    }
+    auto& data = s_probes[probe];
+    auto duration = static_cast<quint64>(qMax(static_cast<qint64>(0), duration_ns));
+
+    data.count.fetch_add(1, std::memory_order_relaxed);
+    data.total_ns.fetch_add(duration, std::memory_order_relaxed);
+    auto max = data.max_ns.load(std::memory_order_relaxed);
+    while ((duration > max) && !data.max_ns.compare_exchange_weak(max, duration, std::memory_order_relaxed)) {
+    }
+
+    auto bucket = std::lower_bound(bucketBounds_us.begin(), bucketBounds_us.end(), static_cast<qint64>((duration+999)/1000)) - bucketBounds_us.begin();
+    data.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+auto Metrics::toJSON() -> QByteArray
+{
+    QJsonArray bounds;
+    for(auto bound : bucketBounds_us) {
+        bounds.append(bound);
+    }
+
+    QJsonObject probes;
+    for(int i=0; i<ProbeCount; i++) {
+        const auto& data = s_probes[i];
+
+        QJsonArray histogram;
+        for(const auto& bucket : data.buckets) {
+            histogram.append(static_cast<qint64>(bucket.load(std::memory_order_relaxed)));
+        }
+
+        QJsonObject probe;
+        probe.insert(QStringLiteral("count"), static_cast<qint64>(data.count.load(std::memory_order_relaxed)));
+        probe.insert(QStringLiteral("total_us"), static_cast<qint64>(data.total_ns.load(std::memory_order_relaxed)/1000));
+        probe.insert(QStringLiteral("max_us"), static_cast<qint64>(data.max_ns.load(std::memory_order_relaxed)/1000));
+        probe.insert(QStringLiteral("histogram"), histogram);
+        probes.insert(QString::fromLatin1(probeName(static_cast<Probe>(i))), probe);
+    }
+
+    QJsonObject result;
+    result.insert(QStringLiteral("bucketBounds_us"), bounds);
+    result.insert(QStringLiteral("probes"), probes);
+    return QJsonDocument(result).toJson(QJsonDocument::Compact);
+}
+
+
+auto Metrics::probeName(Probe probe) -> const char*
+{
+    switch(probe) {
+    case TileRequest:
+        return "tileRequest";
+    case GDL90Message:
+        return "GDL90Message";
+    case FLARMSentence:
+        return "FLARMSentence";
+    case AviationDataCache:
+        return "aviationDataCache";
+    case AirspaceQuery:
+        return "airspaceQuery";
+    case WeatherDownload:
+        return "weatherDownload";
+    case WeatherDownloadFinished:
+        return "weatherDownloadFinished";
+    case ProbeCount:
+        break;
+    }
+    return "";
+}
@@ -0,0 +1,145 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <array>
+#include <atomic>
+
+
+/*! \brief Counters and latency histograms for performance-critical code paths
+ *
+ * This class holds, for every probe, the number of calls, the total and the
+ * maximal duration, and a histogram of durations with fixed buckets. All data
+ * is kept in atomic variables with static storage, so that recording is
+ * lock-free and can be done from any thread without allocating memory.
+ *
+ * The data can be read in JSON format with toJSON(). It is shown on the
+ * diagnostics page of the GUI and served by the TileServer under the path
+ * "/metrics.json".
+ *
+ * Typical use:
+ *
+ * ~~~
+ * Metrics::Timer timer(Metrics::TileRequest);
+ * ~~~
+ */
+
+class Metrics
+{
+public:
+    /*! \brief Probes */
+    enum Probe
+    {
+        /*! \brief Tile or TileJSON request answered by a TileHandler */
+        TileRequest,
+
+        /*! \brief GDL90 message processed by a traffic data source */
+        GDL90Message,
+
+        /*! \brief FLARM/NMEA sentence processed by a traffic data source */
+        FLARMSentence,
+
+        /*! \brief Aviation data generated by GeoMapProvider::fillAviationDataCache() */
+        AviationDataCache,
+
+        /*! \brief Airspace query by AviationDataQuery::airspaces() */
+        AirspaceQuery,
+
+        /*! \brief Weather download, from the request to the last reply read */
+        WeatherDownload,
+
+        /*! \brief Call of WeatherDataProvider::downloadFinished() */
+        WeatherDownloadFinished,
+
+        /*! \brief Number of probes; not a probe */
+        ProbeCount
+    };
+
+    /*! \brief Measures the time between construction and destruction
+     *
+     * The duration is recorded for the probe when the object is destructed.
+     */
+    class Timer
+    {
+    public:
+        /*! \brief Starts the measurement
+         *
+         * @param probe Probe for which the duration is recorded
+         */
+        explicit Timer(Probe probe) : m_probe(probe)
+        {
+            m_timer.start();
+        }
+
+        /*! \brief Records the duration */
+        ~Timer()
+        {
+            record(m_probe, m_timer.nsecsElapsed());
+        }
+
+    private:
+        Q_DISABLE_COPY_MOVE(Timer)
+
+        Probe m_probe;
+        QElapsedTimer m_timer;
+    };
+
+    /*! \brief Records one call
+     *
+     * This method is thread-safe and lock-free.
+     *
+     * @param probe Probe
+     *
+     * @param duration_ns Duration of the call in nanoseconds
+     */
+    static void record(Probe probe, qint64 duration_ns);
+
+    /*! \brief Current data, in JSON format
+     *
+     * The document contains one object for every probe, with the number of
+     * calls, total and maximal duration, the upper bounds of the histogram
+     * buckets and the number of calls in each bucket. Durations are given in
+     * microseconds. The last bucket has no upper bound.
+     *
+     * @returns JSON document
+     */
+    static QByteArray toJSON();
+
+    /*! \brief Upper bounds of the histogram buckets, in microseconds */
+    static constexpr std::array<qint64, 19> bucketBounds_us {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000};
+
+private:
+    // Data of one probe
+    struct ProbeData
+    {
+        std::atomic<quint64> count {0};
+        std::atomic<quint64> total_ns {0};
+        std::atomic<quint64> max_ns {0};
+        std::array<std::atomic<quint64>, bucketBounds_us.size()+1> buckets {};
+    };
+
+    // Name of the probe, as used in the JSON document
+    static const char* probeName(Probe probe);
+
+    static std::array<ProbeData, ProbeCount> s_probes;
+};
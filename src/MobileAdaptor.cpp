@@ -25,6 +25,7 @@
 #include <QTimer>
 
 #include "Global.h"
+#include "MemoryBudget.h"
 #include "MobileAdaptor.h"
 #include "geomaps/GeoMapProvider.h"
 
@@ -213,5 +214,20 @@ JNIEXPORT void JNICALL Java_de_akaflieg_1freiburg_enroute_MobileAdaptor_onWifiCo
 }
 
 
+JNIEXPORT void JNICALL Java_de_akaflieg_1freiburg_enroute_MobileAdaptor_onTrimMemoryRequested(JNIEnv* /*unused*/, jobject /*unused*/, jint level)
+{
+
+    // See above
+    if (QCoreApplication::instance() == nullptr) {
+        return;
+    }
+
+    // This method is called from the Android UI thread. Hand the request over
+    // to the Qt main thread.
+    QMetaObject::invokeMethod(Global::memoryBudget(), "onTrimMemory", Qt::QueuedConnection, Q_ARG(int, static_cast<int>(level)));
+
+}
+
+
 }
 #endif
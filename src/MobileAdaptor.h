@@ -27,7 +27,14 @@
 #include <KNotification>
 #endif
 
+#include <QIODevice>
 #include <QObject>
+#include <functional>
+
+namespace Navigation {
+class FlightRecorder;
+class FlightRoute;
+}
 
 /*! \brief Interface to platform-specific capabilities of mobile devices
  *
@@ -94,9 +101,85 @@ public:
      * file name is visible to the user. It appears for instance as the name of
      * the attachment when sending files by e-mail.
      *
+     * @param title Title of the file dialog on desktop systems. If empty, a
+     * generic title is used.
+     *
      * @returns Empty string on success, the string "abort" on abort, and a translated error message otherwise
      */
-    Q_INVOKABLE QString exportContent(const QByteArray& content, const QString& mimeType, const QString& fileNameTemplate);
+    Q_INVOKABLE QString exportContent(const QByteArray& content, const QString& mimeType, const QString& fileNameTemplate, const QString& title = QString());
+
+    /*! \brief Function that writes content to a device
+     *
+     * Functions of this type are used by the streaming variants of
+     * exportContent() and viewContent(). They write the content to the
+     * device, piece by piece, and return true on success.
+     */
+    using ContentWriter = std::function<bool(QIODevice&)>;
+
+    /*! \brief Export content to file or to file sending app, streaming variant
+     *
+     * This method works like the method with the same name that takes a
+     * QByteArray, but the content is written by a function. The document
+     * never needs to be held in memory as a whole. On desktop systems, the
+     * writer writes directly into the file chosen by the user, which is
+     * replaced only if the writer succeeds. On Android, the writer writes
+     * directly into the file in the app's private cache that is handed to
+     * the file sending app.
+     *
+     * @param writer Function that writes the content
+     *
+     * @param mimeType the mimeType of the content
+     *
+     * @param fileNameTemplate As in the method that takes a QByteArray
+     *
+     * @param title As in the method that takes a QByteArray
+     *
+     * @param suffix File name suffix, used if the MIME database does not know
+     * a suffix for mimeType. If neither is known, the file name has no
+     * suffix.
+     *
+     * @returns Empty string on success, the string "abort" on abort, and a translated error message otherwise
+     */
+    QString exportContent(const ContentWriter& writer, const QString& mimeType, const QString& fileNameTemplate, const QString& title, const QString& suffix = QString());
+
+    /*! \brief Export flight route in GPX format
+     *
+     * This method calls exportContent() with FlightRoute::writeGpx() as a
+     * writer, so that the GPX document is streamed into the file.
+     *
+     * @param route Flight route
+     *
+     * @param fileNameTemplate As in exportContent()
+     *
+     * @returns As in exportContent()
+     */
+    Q_INVOKABLE QString exportFlightRouteGpx(Navigation::FlightRoute* route, const QString& fileNameTemplate);
+
+    /*! \brief Export recorded flight track in GPX format
+     *
+     * This method calls exportContent() with FlightRecorder::writeGpx() as a
+     * writer, so that the GPX document is streamed into the file.
+     *
+     * @param recorder Flight recorder
+     *
+     * @param fileNameTemplate As in exportContent()
+     *
+     * @returns As in exportContent()
+     */
+    Q_INVOKABLE QString exportFlightTrackGpx(Navigation::FlightRecorder* recorder, const QString& fileNameTemplate);
+
+    /*! \brief Export recorded flight track in IGC format
+     *
+     * This method calls exportContent() with FlightRecorder::writeIGC() as a
+     * writer, so that the IGC document is streamed into the file.
+     *
+     * @param recorder Flight recorder
+     *
+     * @param fileNameTemplate As in exportContent()
+     *
+     * @returns As in exportContent()
+     */
+    Q_INVOKABLE QString exportFlightTrackIGC(Navigation::FlightRecorder* recorder, const QString& fileNameTemplate);
 
     /*! \brief Lock connection to Wi-Fi network
      *
@@ -142,6 +225,35 @@ public:
      */
     Q_INVOKABLE QString viewContent(const QByteArray& content, const QString& mimeType, const QString& fileNameTemplate);
 
+    /*! \brief View content in other app, streaming variant
+     *
+     * This method works like the method with the same name that takes a
+     * QByteArray, but the content is written by a function, directly into the
+     * temporary file that is handed to the other app.
+     *
+     * @param writer Function that writes the content
+     *
+     * @param mimeType the mimeType of the content
+     *
+     * @param fileNameTemplate As in the method that takes a QByteArray
+     *
+     * @returns Empty string on success, a translated error message otherwise
+     */
+    QString viewContent(const ContentWriter& writer, const QString& mimeType, const QString& fileNameTemplate);
+
+    /*! \brief View flight route in GPX format in other app
+     *
+     * This method calls viewContent() with FlightRoute::writeGpx() as a
+     * writer, so that the GPX document is streamed into the temporary file.
+     *
+     * @param route Flight route
+     *
+     * @param fileNameTemplate As in viewContent()
+     *
+     * @returns As in viewContent()
+     */
+    Q_INVOKABLE QString viewFlightRouteGpx(Navigation::FlightRoute* route, const QString& fileNameTemplate);
+
     /*! \brief Start receiving "open file" requests from platform
      *
      * This method should be called to indicate that the GUI is set up and ready
@@ -241,8 +353,9 @@ private:
     Q_DISABLE_COPY_MOVE(MobileAdaptor)
   
     // Helper function. Saves content to a file in a directory from where
-    // sharing to other android apps is possible
-    QString contentToTempFile(const QByteArray& content, const QString& fileNameTemplate);
+    // sharing to other android apps is possible. Returns the path of the file,
+    // or an empty string on failure.
+    QString contentToTempFile(const ContentWriter& writer, const QString& fileNameTemplate);
 
     // Name of a subdirectory within the AppDataLocation for sending and
     // receiving files.
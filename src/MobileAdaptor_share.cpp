@@ -21,6 +21,7 @@
 
 #include "Global.h"
 #include "MobileAdaptor.h"
+#include "navigation/FlightRecorder.h"
 #include "navigation/FlightRoute.h"
 #include "traffic/TrafficDataProvider.h"
 #include "traffic/TrafficDataSource_File.h"
@@ -30,6 +31,7 @@
 #include <QDesktopServices>
 #include <QFile>
 #include <QMimeDatabase>
+#include <QSaveFile>
 #include <QUrl>
 
 #if defined(Q_OS_ANDROID)
@@ -57,54 +59,111 @@ void MobileAdaptor::importContent()
 }
 
 
-auto MobileAdaptor::exportContent(const QByteArray& content, const QString& mimeType, const QString& fileNameTemplate) -> QString
+namespace {
+
+// Writer that writes a QByteArray in one piece
+auto byteArrayWriter(const QByteArray& content) -> MobileAdaptor::ContentWriter
 {
-    //#warning Need to handle user abort!
+    return [content](QIODevice& device) {
+        return device.write(content) == content.size();
+    };
+}
+
+}
 
-    Q_UNUSED(content)
-    Q_UNUSED(mimeType)
-    Q_UNUSED(fileNameTemplate)
+
+auto MobileAdaptor::exportContent(const QByteArray& content, const QString& mimeType, const QString& fileNameTemplate, const QString& title) -> QString
+{
+    return exportContent(byteArrayWriter(content), mimeType, fileNameTemplate, title);
+}
+
+
+auto MobileAdaptor::exportContent(const ContentWriter& writer, const QString& mimeType, const QString& fileNameTemplate, const QString& title, const QString& suffix) -> QString
+{
+    //#warning Need to handle user abort!
 
     QMimeDatabase db;
     QMimeType mime = db.mimeTypeForName(mimeType);
+    auto fileSuffix = mime.preferredSuffix().isEmpty() ? suffix : mime.preferredSuffix();
+    auto dotSuffix = fileSuffix.isEmpty() ? QString() : "."+fileSuffix;
 
 #if defined(Q_OS_ANDROID)
-    auto tmpPath = contentToTempFile(content, fileNameTemplate+"-%1"+mime.preferredSuffix());
+    Q_UNUSED(title)
+    auto tmpPath = contentToTempFile(writer, fileNameTemplate+"-%1"+dotSuffix);
+    if (tmpPath.isEmpty()) {
+        return tr("Unable to write data to the file exchange directory.");
+    }
     bool success = outgoingIntent("sendFile", tmpPath, mimeType);
     if (success) {
         return QString();
     }
     return tr("No suitable file sharing app could be found.");
 #else
+    auto filter = fileSuffix.isEmpty() ? tr("All files (*)") : tr("%1 (*.%2);;All files (*)").arg(mime.comment(), fileSuffix);
     auto fileNameX = QFileDialog::getSaveFileName(nullptr,
-                                                  tr("Export flight route"),
-                                                  QDir::homePath()+"/"+fileNameTemplate+"."+mime.preferredSuffix(),
-                                                  tr("%1 (*.%2);;All files (*)").arg(mime.comment(), mime.preferredSuffix())
+                                                  title.isEmpty() ? tr("Export data") : title,
+                                                  QDir::homePath()+"/"+fileNameTemplate+dotSuffix,
+                                                  filter
                                                   );
     if (fileNameX.isEmpty()) {
         return "abort";
     }
-    QFile file(fileNameX);
+
+    // The writer streams directly into the file. QSaveFile makes sure that an
+    // existing file is only replaced if all content could be written.
+    QSaveFile file(fileNameX);
     if (!file.open(QIODevice::WriteOnly)) {
         return tr("Unable to open file <strong>%1</strong>.").arg(fileNameX);
     }
-
-    if (file.write(content) != content.size()) {
+    if (!writer(file) || !file.commit()) {
         return tr("Unable to write to file <strong>%1</strong>.").arg(fileNameX);
     }
-    file.close();
     return QString();
 #endif
 }
 
 
+auto MobileAdaptor::exportFlightRouteGpx(Navigation::FlightRoute* route, const QString& fileNameTemplate) -> QString
+{
+    if (route == nullptr) {
+        return tr("No flight route to export.");
+    }
+    return exportContent([route](QIODevice& device) { return route->writeGpx(device); }, "application/gpx+xml", fileNameTemplate, tr("Export flight route"));
+}
+
+
+auto MobileAdaptor::exportFlightTrackGpx(Navigation::FlightRecorder* recorder, const QString& fileNameTemplate) -> QString
+{
+    if (recorder == nullptr) {
+        return tr("No flight track to export.");
+    }
+    return exportContent([recorder](QIODevice& device) { return recorder->writeGpx(device); }, "application/gpx+xml", fileNameTemplate, tr("Export flight track"));
+}
+
+
+auto MobileAdaptor::exportFlightTrackIGC(Navigation::FlightRecorder* recorder, const QString& fileNameTemplate) -> QString
+{
+    if (recorder == nullptr) {
+        return tr("No flight track to export.");
+    }
+    return exportContent([recorder](QIODevice& device) { return recorder->writeIGC(device); }, "application/vnd.fai.igc", fileNameTemplate, tr("Export flight track"), "igc");
+}
+
+
 auto MobileAdaptor::viewContent(const QByteArray& content, const QString& mimeType, const QString& fileNameTemplate) -> QString
 {
-    Q_UNUSED(content)
+    return viewContent(byteArrayWriter(content), mimeType, fileNameTemplate);
+}
+
+
+auto MobileAdaptor::viewContent(const ContentWriter& writer, const QString& mimeType, const QString& fileNameTemplate) -> QString
+{
     Q_UNUSED(mimeType)
-    Q_UNUSED(fileNameTemplate)
 
-    QString tmpPath = contentToTempFile(content, fileNameTemplate);
+    QString tmpPath = contentToTempFile(writer, fileNameTemplate);
+    if (tmpPath.isEmpty()) {
+        return tr("Unable to write data to the file exchange directory.");
+    }
 #if defined(Q_OS_ANDROID)
     bool success = outgoingIntent("viewFile", tmpPath, mimeType);
     if (success) {
@@ -121,7 +180,16 @@ auto MobileAdaptor::viewContent(const QByteArray& content, const QString& mimeTy
 }
 
 
-auto MobileAdaptor::contentToTempFile(const QByteArray& content, const QString& fileNameTemplate) -> QString
+auto MobileAdaptor::viewFlightRouteGpx(Navigation::FlightRoute* route, const QString& fileNameTemplate) -> QString
+{
+    if (route == nullptr) {
+        return tr("No flight route to open.");
+    }
+    return viewContent([route](QIODevice& device) { return route->writeGpx(device); }, "application/gpx+xml", fileNameTemplate);
+}
+
+
+auto MobileAdaptor::contentToTempFile(const ContentWriter& writer, const QString& fileNameTemplate) -> QString
 {
     QDateTime now = QDateTime::currentDateTimeUtc();
     QString fname = fileNameTemplate.arg(now.toString(QStringLiteral("yyyy-MM-dd_hh.mm.ss")));
@@ -130,15 +198,18 @@ auto MobileAdaptor::contentToTempFile(const QByteArray& content, const QString&
     // share the content we save it to disk. We save these temporary files
     // when creating new Share objects.
     //
+    // The writer streams directly into the file, which is the only copy of
+    // the content on disk.
+    //
     auto filePath = fileExchangeDirectoryName + fname;
 
-    QFile file(filePath);
+    QSaveFile file(filePath);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
         return QString();
     }
-
-    file.write(content);
-    file.close();
+    if (!writer(file) || !file.commit()) {
+        return QString();
+    }
 
     return filePath;
 }
@@ -222,8 +293,8 @@ void MobileAdaptor::processFileOpenRequest(const QString &path)
     }
 
 #if !defined(Q_OS_ANDROID)
-    // FLARM Simulator file
-    if (myPath.endsWith(u".txt", Qt::CaseInsensitive)) {
+    // FLARM Simulator file, or traffic capture file
+    if (myPath.endsWith(u".txt", Qt::CaseInsensitive) || myPath.endsWith(u".trafficcapture", Qt::CaseInsensitive)) {
         auto *source = new Traffic::TrafficDataSource_File(myPath);
         Global::trafficDataProvider()->addDataSource(source); // Will take ownership of source
         source->connectToTrafficReceiver();
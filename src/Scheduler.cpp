@@ -0,0 +1,200 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QDateTime>
+#include <QGuiApplication>
+#include <QMetaEnum>
+
+#include "Scheduler.h"
+
+
+// Static instance of this class. Do not analyze, because of many unwanted warnings.
+#ifndef __clang_analyzer__
+QPointer<Scheduler> schedulerStatic {};
+#endif
+
+
+Scheduler::Scheduler(QObject *parent)
+    : QObject(parent)
+{
+    m_clock.start();
+    m_tickTimer.setSingleShot(true);
+    connect(&m_tickTimer, &QTimer::timeout, this, &Scheduler::tick);
+
+    // The grid of ticks depends on the application state
+    connect(qGuiApp, &QGuiApplication::applicationStateChanged, this, &Scheduler::reschedule);
+}
+
+
+auto Scheduler::globalInstance() -> Scheduler*
+{
+#ifndef __clang_analyzer__
+    if (schedulerStatic.isNull()) {
+        schedulerStatic = new Scheduler();
+    }
+    return schedulerStatic;
+#else
+    return nullptr;
+#endif
+}
+
+
+auto Scheduler::ticks() -> qint64
+{
+    auto* scheduler = globalInstance();
+    if (scheduler == nullptr) {
+        return 0;
+    }
+    return scheduler->m_ticks;
+}
+
+
+auto Scheduler::wakeupsBySubsystem() -> QVariantMap
+{
+    QVariantMap result;
+    auto* scheduler = globalInstance();
+    if (scheduler == nullptr) {
+        return result;
+    }
+    auto metaEnum = QMetaEnum::fromType<Subsystem>();
+    for(int i=0; i<SubsystemCount; i++) {
+        result.insert(QString::fromLatin1(metaEnum.valueToKey(i)), scheduler->m_wakeups[i]);
+    }
+    return result;
+}
+
+
+void Scheduler::add(Timer* timer)
+{
+    if (!m_timers.contains(timer)) {
+        m_timers.append(timer);
+    }
+    reschedule();
+}
+
+
+void Scheduler::reschedule()
+{
+    m_timers.removeAll(nullptr);
+
+    qint64 earliestDue_ms = -1;
+    foreach(auto timer, m_timers) {
+        if (!timer->isActive()) {
+            continue;
+        }
+        if ((earliestDue_ms < 0) || (timer->m_due_ms < earliestDue_ms)) {
+            earliestDue_ms = timer->m_due_ms;
+        }
+    }
+    if (earliestDue_ms < 0) {
+        m_tickTimer.stop();
+        return;
+    }
+
+    // Round the due time up to the grid of ticks. In the foreground, ticks
+    // are precise, so that they stay aligned to the full seconds. In the
+    // background, the operating system may shift them by up to a second.
+    auto foreground = (qGuiApp == nullptr) || (qGuiApp->applicationState() == Qt::ApplicationActive);
+    auto tick_ms = static_cast<qint64>(foreground ? foregroundTick.count() : backgroundTick.count());
+
+    // The grid is taken from the system clock, the delay from the monotonic
+    // clock, so that a step of the system clock shifts the grid by at most
+    // one tick.
+    auto now = now_ms();
+    auto offset_ms = QDateTime::currentMSecsSinceEpoch()-now;
+    auto tickTime_ms = ((earliestDue_ms+offset_ms+tick_ms-1)/tick_ms)*tick_ms-offset_ms;
+    m_tickTimer.setTimerType((foreground || m_preciseNextTick) ? Qt::PreciseTimer : Qt::VeryCoarseTimer);
+    m_tickTimer.start(static_cast<int>(qMax(static_cast<qint64>(0), tickTime_ms-now)));
+}
+
+
+void Scheduler::tick()
+{
+    m_ticks++;
+
+    // Timers fire late, but never early. Work on a copy, because the timeout
+    // handlers may start or stop timers.
+    auto now = now_ms();
+    auto fired = false;
+    auto timers = m_timers;
+    foreach(auto timer, timers) {
+        if (timer.isNull() || !timer->isActive() || (timer->m_due_ms > now)) {
+            continue;
+        }
+        fired = true;
+        m_wakeups[timer->m_subsystem]++;
+        timer->m_due_ms = timer->m_singleShot ? -1 : now+timer->m_interval_ms;
+        emit timer->timeout();
+    }
+
+    // A very coarse tick may come before the earliest due time. In that
+    // case, wait for the remainder with a precise timer, so that the next
+    // tick is not early again.
+    m_preciseNextTick = !fired;
+    reschedule();
+}
+
+
+Scheduler::Timer::Timer(Scheduler::Subsystem subsystem, QObject *parent)
+    : QObject(parent),
+      m_subsystem(subsystem)
+{
+}
+
+
+void Scheduler::Timer::start(int msec)
+{
+    m_interval_ms = msec;
+    start();
+}
+
+
+void Scheduler::Timer::start()
+{
+    auto* scheduler = Scheduler::globalInstance();
+    if (scheduler == nullptr) {
+        return;
+    }
+    m_due_ms = scheduler->now_ms()+m_interval_ms;
+    scheduler->add(this);
+}
+
+
+void Scheduler::Timer::setInterval(int msec)
+{
+    m_interval_ms = msec;
+    if (isActive()) {
+        start();
+    }
+}
+
+
+void Scheduler::Timer::stop()
+{
+    if (!isActive()) {
+        return;
+    }
+    m_due_ms = -1;
+#ifndef __clang_analyzer__
+    if (!schedulerStatic.isNull()) {
+        schedulerStatic->reschedule();
+    }
+#endif
+}
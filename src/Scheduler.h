@@ -0,0 +1,251 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVariantMap>
+#include <array>
+#include <chrono>
+
+
+/*! \brief Central scheduler for periodic work
+ *
+ * Many subsystems of the app do some work every few seconds or minutes:
+ * update the clock, probe for traffic receivers, download weather data,
+ * measure download throughput, … If every subsystem used a QTimer of its own,
+ * every one of these timers would wake the CPU at its own moment. This class
+ * aligns the wakeups instead. Subsystems use instances of Scheduler::Timer,
+ * which behave like single-purpose QTimers. The scheduler runs one QTimer
+ * that fires on a coarse grid of shared ticks, and every tick handles all
+ * Scheduler::Timer instances that have become due. A timer therefore fires at
+ * the first tick after its interval has elapsed.
+ *
+ * While the app is in the foreground, ticks are aligned to the full seconds of
+ * the system clock, so that clock updates appear right after the full minute.
+ * In the background, the grid is coarser, and the operating system is allowed
+ * to shift the ticks further.
+ *
+ * Scheduler::Timer is meant for periodic or delayed work that tolerates a
+ * delay of one tick. Timers never fire before their interval has elapsed.
+ * Work that drives the display at frame rate, timers whose interval is always
+ * shorter than backgroundTick, and timeouts that decide about the validity of
+ * safety-relevant data, such as traffic warnings, continue to use QTimer. This class and Scheduler::Timer must only
+ * be used from the GUI thread.
+ *
+ * The number of wakeups is counted per subsystem, so that the effect on
+ * battery life can be measured.
+ */
+
+class Scheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    class Timer;
+
+    /*! \brief Subsystems whose wakeups are counted */
+    enum Subsystem
+    {
+        /*! \brief Clock and date notifications */
+        Time,
+
+        /*! \brief Map downloads and update checks */
+        Maps,
+
+        /*! \brief Traffic data receivers */
+        Traffic,
+
+        /*! \brief Weather downloads */
+        Weather,
+
+        /*! \brief Number of subsystems; not a subsystem */
+        SubsystemCount
+    };
+    Q_ENUM(Subsystem)
+
+    /*! \brief Standard constructor
+     *
+     * @param parent The standard QObject parent pointer
+     */
+    explicit Scheduler(QObject *parent = nullptr);
+
+    // Standard destructor
+    ~Scheduler() override = default;
+
+    /*! \brief Pointer to static instance
+     *
+     * This method returns a pointer to a static instance of this class. In rare
+     * situations, during shutdown of the app, a nullptr might be returned.
+     *
+     * @returns A pointer to a static instance of this class
+     */
+    static Scheduler* globalInstance();
+
+    /*! \brief Distance between two ticks while the app is in the foreground */
+    static constexpr auto foregroundTick = std::chrono::milliseconds(1000);
+
+    /*! \brief Distance between two ticks while the app is in the background */
+    static constexpr auto backgroundTick = std::chrono::milliseconds(10000);
+
+    /*! \brief Number of ticks so far
+     *
+     * Every tick corresponds to one wakeup of the CPU, shared by all timers
+     * that fire in the tick.
+     *
+     * @returns Number of ticks since the start of the app
+     */
+    static qint64 ticks();
+
+    /*! \brief Number of timers fired so far, by subsystem
+     *
+     * @returns Map whose keys are the names of the subsystems, as in the enum
+     * Subsystem, and whose values are the number of times a timer of the
+     * subsystem has fired since the start of the app
+     */
+    Q_INVOKABLE static QVariantMap wakeupsBySubsystem();
+
+private:
+    Q_DISABLE_COPY_MOVE(Scheduler)
+
+    // Handles one tick: fires all timers that are due and sets up the next
+    // tick
+    void tick();
+
+    // Sets up m_tickTimer for the first tick at or after the earliest due time
+    // of all active timers. Stops m_tickTimer if no timer is active.
+    void reschedule();
+
+    // Adds a timer to m_timers, if not yet present, and calls reschedule()
+    void add(Timer* timer);
+
+    // Current time on the monotonic clock, in milliseconds. Due times are
+    // kept on this clock, so that steps of the system clock, for instance
+    // when the time is set from NTP or GNSS, do not delay the timers. The
+    // system clock is only used to align the grid of ticks.
+    qint64 now_ms() const { return m_clock.elapsed(); }
+
+    QElapsedTimer m_clock;
+    QTimer m_tickTimer;
+    QVector<QPointer<Timer>> m_timers;
+
+    // Set by tick() if no timer was due, which happens if a very coarse tick
+    // comes early. The next tick then uses a precise timer.
+    bool m_preciseNextTick {false};
+    qint64 m_ticks {0};
+    std::array<qint64, SubsystemCount> m_wakeups {};
+};
+
+
+/*! \brief Timer whose wakeups are aligned by the Scheduler
+ *
+ * This class has the same interface as the parts of QTimer that are used in
+ * this app. The timer fires at the first tick of the Scheduler after its
+ * interval has elapsed.
+ */
+
+class Scheduler::Timer : public QObject
+{
+    Q_OBJECT
+
+    friend class Scheduler;
+
+public:
+    /*! \brief Standard constructor
+     *
+     * @param subsystem Subsystem to which wakeups of this timer are
+     * attributed
+     *
+     * @param parent The standard QObject parent pointer
+     */
+    explicit Timer(Scheduler::Subsystem subsystem, QObject *parent = nullptr);
+
+    // Standard destructor
+    ~Timer() override = default;
+
+    /*! \brief Interval of the timer
+     *
+     * @returns Interval in milliseconds
+     */
+    int interval() const { return m_interval_ms; }
+
+    /*! \brief Indicates if the timer is running
+     *
+     * @returns True if the timer is running
+     */
+    bool isActive() const { return m_due_ms >= 0; }
+
+    /*! \brief Sets the interval of the timer
+     *
+     * As with QTimer, a running timer is restarted with the new interval.
+     *
+     * @param msec Interval in milliseconds
+     */
+    void setInterval(int msec);
+
+    /*! \brief Sets the interval of the timer
+     *
+     * @param value Interval
+     */
+    void setInterval(std::chrono::milliseconds value) { setInterval(static_cast<int>(value.count())); }
+
+    /*! \brief Sets whether the timer fires only once
+     *
+     * @param singleShot If true, the timer stops after firing once
+     */
+    void setSingleShot(bool singleShot) { m_singleShot = singleShot; }
+
+    /*! \brief Starts or restarts the timer with a new interval
+     *
+     * @param msec Interval in milliseconds
+     */
+    void start(int msec);
+
+    /*! \brief Starts or restarts the timer with a new interval
+     *
+     * @param value Interval
+     */
+    void start(std::chrono::milliseconds value) { start(static_cast<int>(value.count())); }
+
+public slots:
+    /*! \brief Starts or restarts the timer with the current interval */
+    void start();
+
+    /*! \brief Stops the timer */
+    void stop();
+
+signals:
+    /*! \brief Emitted when the timer fires */
+    void timeout();
+
+private:
+    Q_DISABLE_COPY_MOVE(Timer)
+
+    Scheduler::Subsystem m_subsystem;
+    int m_interval_ms {0};
+    bool m_singleShot {false};
+
+    // Time when the timer is due, in milliseconds on the monotonic clock of
+    // the scheduler, or -1 if the timer is not running
+    qint64 m_due_ms {-1};
+};
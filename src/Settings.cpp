@@ -22,20 +22,48 @@
 #include <QLibraryInfo>
 #include <QLocale>
 #include <QSettings>
+#include <QtConcurrent>
 
-#include "Global.h"
 #include "Settings.h"
 
 
+Settings::Values::Values()
+{
+    QSettings settings;
+    acceptedTerms = settings.value(QStringLiteral("acceptedTerms"), 0).toInt();
+    acceptedWeatherTerms = settings.value(QStringLiteral("acceptedWeatherTerms"), false).toBool();
+    hideUpperAirspaces = settings.value(QStringLiteral("Map/hideUpperAirspaces"), false).toBool();
+    lastWhatsNewHash = settings.value(QStringLiteral("lastWhatsNewHash"), 0).toUInt();
+    loadAviationDataByRegion = settings.value(QStringLiteral("Map/loadAviationDataByRegion"), false).toBool();
+    mapBearingPolicy = settings.value(QStringLiteral("Map/bearingPolicy"), 0).toInt();
+    maxParallelDownloads = settings.value(QStringLiteral("Maps/maxParallelDownloads"), 2).toInt();
+    nightMode = settings.value(QStringLiteral("Map/nightMode"), false).toBool();
+    recordFlightTrack = settings.value(QStringLiteral("Navigation/recordFlightTrack"), false).toBool();
+    tileCacheSize = settings.value(QStringLiteral("Map/tileCacheSize"), 32).toInt();
+    trafficDataFusion = settings.value(QStringLiteral("Traffic/dataFusion"), false).toBool();
+    useMetricUnits = settings.value(QStringLiteral("System/useMetricUnits"), false).toBool();
+}
+
+
 Settings::Settings(QObject *parent)
     : QObject(parent)
 {
+    m_writeTimer.setSingleShot(true);
+    m_writeTimer.setInterval(writeDelayMS);
+    connect(&m_writeTimer, &QTimer::timeout, this, &Settings::writePendingValues);
+
     installTranslators();
 }
 
 
 Settings::~Settings()
 {
+    // Write pending values synchronously
+    m_writeFuture.waitForFinished();
+    for(auto iterator = m_pendingValues.constBegin(); iterator != m_pendingValues.constEnd(); ++iterator) {
+        settings.setValue(iterator.key(), iterator.value());
+    }
+
     // Save some values
     settings.setValue("lastVersion", PROJECT_VERSION);
 }
@@ -43,13 +71,13 @@ Settings::~Settings()
 
 auto Settings::acceptedWeatherTermsStatic() -> bool
 {
-    return Global::settings()->acceptedWeatherTerms();
+    return values().acceptedWeatherTerms;
 }
 
 
 auto Settings::hideUpperAirspacesStatic() -> bool
 {
-    return Global::settings()->hideUpperAirspaces();
+    return values().hideUpperAirspaces;
 }
 
 
@@ -58,7 +86,8 @@ void Settings::setAcceptedTerms(int terms)
     if (terms == acceptedTerms()) {
         return;
     }
-    settings.setValue("acceptedTerms", terms);
+    values().acceptedTerms = terms;
+    write(QStringLiteral("acceptedTerms"), terms);
     emit acceptedTermsChanged();
 }
 
@@ -68,7 +97,8 @@ void Settings::setAcceptedWeatherTerms(bool terms)
     if (terms == acceptedWeatherTerms()) {
         return;
     }
-    settings.setValue("acceptedWeatherTerms", terms);
+    values().acceptedWeatherTerms = terms;
+    write(QStringLiteral("acceptedWeatherTerms"), terms);
     emit acceptedWeatherTermsChanged();
 }
 
@@ -78,7 +108,8 @@ void Settings::setHideUpperAirspaces(bool hide)
     if (hide == hideUpperAirspaces()) {
         return;
     }
-    settings.setValue("Map/hideUpperAirspaces", hide);
+    values().hideUpperAirspaces = hide;
+    write(QStringLiteral("Map/hideUpperAirspaces"), hide);
     emit hideUpperAirspacesChanged();
 }
 
@@ -88,14 +119,26 @@ void Settings::setLastWhatsNewHash(uint lwnh)
     if (lwnh == lastWhatsNewHash()) {
         return;
     }
-    settings.setValue("lastWhatsNewHash", lwnh);
+    values().lastWhatsNewHash = lwnh;
+    write(QStringLiteral("lastWhatsNewHash"), lwnh);
     emit lastWhatsNewHashChanged();
 }
 
 
+void Settings::setLoadAviationDataByRegion(bool byRegion)
+{
+    if (byRegion == loadAviationDataByRegion()) {
+        return;
+    }
+    values().loadAviationDataByRegion = byRegion;
+    write(QStringLiteral("Map/loadAviationDataByRegion"), byRegion);
+    emit loadAviationDataByRegionChanged();
+}
+
+
 auto Settings::mapBearingPolicy() const -> Settings::MapBearingPolicyValues
 {
-    auto intVal = settings.value("Map/bearingPolicy", 0).toInt();
+    auto intVal = values().mapBearingPolicy.load();
     if (intVal == 0) {
         return NUp;
     }
@@ -114,22 +157,34 @@ void Settings::setMapBearingPolicy(MapBearingPolicyValues policy)
 
     switch(policy){
     case NUp:
-        settings.setValue("Map/bearingPolicy", 0);
+        values().mapBearingPolicy = 0;
         break;
     case TTUp:
-        settings.setValue("Map/bearingPolicy", 1);
+        values().mapBearingPolicy = 1;
         break;
     default:
-        settings.setValue("Map/bearingPolicy", 2);
+        values().mapBearingPolicy = 2;
         break;
     }
+    write(QStringLiteral("Map/bearingPolicy"), values().mapBearingPolicy.load());
     emit mapBearingPolicyChanged();
 }
 
 
+void Settings::setMaxParallelDownloads(int number)
+{
+    if (number == maxParallelDownloads()) {
+        return;
+    }
+    values().maxParallelDownloads = number;
+    write(QStringLiteral("Maps/maxParallelDownloads"), number);
+    emit maxParallelDownloadsChanged();
+}
+
+
 auto Settings::nightMode() const -> bool
 {
-    return settings.value("Map/nightMode", false).toBool();
+    return values().nightMode;
 }
 
 
@@ -139,25 +194,140 @@ void Settings::setNightMode(bool newNightMode)
         return;
     }
 
-    settings.setValue("Map/nightMode", newNightMode);
+    values().nightMode = newNightMode;
+    write(QStringLiteral("Map/nightMode"), newNightMode);
     emit nightModeChanged();
 }
 
 
+void Settings::setRecordFlightTrack(bool record)
+{
+    if (record == recordFlightTrack()) {
+        return;
+    }
+    values().recordFlightTrack = record;
+    write(QStringLiteral("Navigation/recordFlightTrack"), record);
+    emit recordFlightTrackChanged();
+}
+
+
+void Settings::setTileCacheSize(int sizeInMB)
+{
+    if (sizeInMB == tileCacheSize()) {
+        return;
+    }
+    values().tileCacheSize = sizeInMB;
+    write(QStringLiteral("Map/tileCacheSize"), sizeInMB);
+    emit tileCacheSizeChanged();
+}
+
+
+void Settings::setTrafficDataFusion(bool newTrafficDataFusion)
+{
+    if (newTrafficDataFusion == trafficDataFusion()) {
+        return;
+    }
+    values().trafficDataFusion = newTrafficDataFusion;
+    write(QStringLiteral("Traffic/dataFusion"), newTrafficDataFusion);
+    emit trafficDataFusionChanged();
+}
+
+
+auto Settings::trafficDataSources() const -> QStringList
+{
+    static const QStringList defaultTrafficDataSources {
+        QStringLiteral("tcp:192.168.1.1:2000"),
+        QStringLiteral("tcp:192.168.10.1:2000"),
+        QStringLiteral("udp:4000"),
+        QStringLiteral("udp:49002")
+    };
+    return settings.value(QStringLiteral("Traffic/dataSources"), defaultTrafficDataSources).toStringList();
+}
+
+
+void Settings::setTrafficDataSources(const QStringList& newTrafficDataSources)
+{
+    if (newTrafficDataSources == trafficDataSources()) {
+        return;
+    }
+    settings.setValue(QStringLiteral("Traffic/dataSources"), newTrafficDataSources);
+    emit trafficDataSourcesChanged();
+}
+
+
+auto Settings::lastTrafficDataSource(const QString& ssid) const -> QString
+{
+    if (ssid.isEmpty()) {
+        return {};
+    }
+    return settings.value(QStringLiteral("Traffic/lastDataSources")).toMap().value(ssid).toString();
+}
+
+
+void Settings::setLastTrafficDataSource(const QString& ssid, const QString& sourceName)
+{
+    if (ssid.isEmpty() || (sourceName == lastTrafficDataSource(ssid))) {
+        return;
+    }
+    auto lastDataSources = settings.value(QStringLiteral("Traffic/lastDataSources")).toMap();
+    lastDataSources.insert(ssid, sourceName);
+    settings.setValue(QStringLiteral("Traffic/lastDataSources"), lastDataSources);
+}
+
+
 void Settings::setUseMetricUnits(bool unitHorizKmh)
 {
     if (unitHorizKmh == useMetricUnits()) {
         return;
     }
 
-    settings.setValue("System/useMetricUnits", unitHorizKmh);
+    values().useMetricUnits = unitHorizKmh;
+    write(QStringLiteral("System/useMetricUnits"), unitHorizKmh);
     emit useMetricUnitsChanged();
 }
 
 
 auto Settings::useMetricUnitsStatic() -> bool
 {
-    return Global::settings()->useMetricUnits();
+    return values().useMetricUnits;
+}
+
+
+auto Settings::values() -> Settings::Values&
+{
+    static Values values;
+    return values;
+}
+
+
+void Settings::write(const QString& key, const QVariant& value)
+{
+    m_pendingValues.insert(key, value);
+    if (!m_writeTimer.isActive()) {
+        m_writeTimer.start();
+    }
+}
+
+
+void Settings::writePendingValues()
+{
+    if (m_pendingValues.isEmpty()) {
+        return;
+    }
+    if (m_writeFuture.isRunning()) {
+        m_writeTimer.start();
+        return;
+    }
+
+    auto pendingValues = m_pendingValues;
+    m_pendingValues.clear();
+    m_writeFuture = QtConcurrent::run([pendingValues]() {
+        QSettings settings;
+        for(auto iterator = pendingValues.constBegin(); iterator != pendingValues.constEnd(); ++iterator) {
+            settings.setValue(iterator.key(), iterator.value());
+        }
+        settings.sync();
+    });
 }
 
 
@@ -21,23 +21,38 @@
 #pragma once
 
 #include <QFile>
+#include <QFuture>
+#include <QHash>
 #include <QLocale>
 #include <QObject>
 #include <QPointer>
 #include <QSettings>
+#include <QStringList>
+#include <QTimer>
 #include <QTranslator>
+#include <QVariant>
+#include <atomic>
 
 
 /*! \brief Global Settings Manager
  *
  * This class holds a few data items and exposes them via QObject properties, so
  * that they can be used in QML.  All data stored in this class is saved via
- * QSettings on destruction.
+ * QSettings.
+ *
+ * The values of all properties, except for the lists, are kept in an
+ * in-memory copy that is loaded from QSettings once and shared by all
+ * instances of this class.  Reading these properties never accesses
+ * QSettings.  Changes are written to the in-memory copy immediately, and to
+ * QSettings in batches, in a background thread.  Pending changes are written
+ * on destruction.
  *
  * There exists one static instance of this class, which can be accessed via the
  * method globalInstance().  No other instance of this class should be used.
  *
- * The methods in this class are reentrant, but not thread safe.
+ * The methods in this class are reentrant, but not thread safe.  The static
+ * methods acceptedWeatherTermsStatic(), hideUpperAirspacesStatic() and
+ * useMetricUnitsStatic() are thread safe.
  */
 
 class Settings : public QObject
@@ -76,7 +91,7 @@ public:
      *
      * @returns Property acceptedTerms
      */
-    int acceptedTerms() const { return settings.value(QStringLiteral("acceptedTerms"), 0).toInt(); }
+    int acceptedTerms() const { return values().acceptedTerms; }
 
     /*! \brief Setter function for property of the same name
      *
@@ -96,12 +111,12 @@ public:
      *
      * @returns Property acceptedWeatherTerms
      */
-    bool acceptedWeatherTerms() const { return settings.value(QStringLiteral("acceptedWeatherTerms"), false).toBool(); }
+    bool acceptedWeatherTerms() const { return values().acceptedWeatherTerms; }
 
     /*! \brief Getter function for property of the same name
      *
-     * This function differs from acceptedWeatherTerms() only in that it is static.
-     * It uses the globalInstance() to retrieve data.
+     * This function differs from acceptedWeatherTerms() only in that it is static
+     * and thread safe.
      *
      * @returns Property acceptedWeatherTerms
      */
@@ -129,12 +144,12 @@ public:
      *
      * @returns Property hideUpperAirspaces
      */
-    bool hideUpperAirspaces() const { return settings.value(QStringLiteral("Map/hideUpperAirspaces"), false).toBool(); }
+    bool hideUpperAirspaces() const { return values().hideUpperAirspaces; }
 
     /*! \brief Getter function for property of the same name
      *
-     * This function differs from hideUpperAirspaces() only in that it is static.
-     * It uses the globalInstance() to retrieve data.
+     * This function differs from hideUpperAirspaces() only in that it is static
+     * and thread safe.
      *
      * @returns Property hideUpperAirspaces
      */
@@ -157,7 +172,7 @@ public:
      *
      * @returns Property lastWhatsNewHash
      */
-    uint lastWhatsNewHash() const { return settings.value(QStringLiteral("lastWhatsNewHash"), 0).toUInt(); }
+    uint lastWhatsNewHash() const { return values().lastWhatsNewHash; }
 
     /*! \brief Getter function for property of the same name
      *
@@ -165,6 +180,26 @@ public:
      */
     void setLastWhatsNewHash(uint lwnh);
 
+    /*! \brief Load aviation data only near the current position and route
+     *
+     * If set, the GeoMapProvider keeps only the bounds of every aviation map
+     * in memory, together with the features near the last known position and
+     * the current flight route.
+     */
+    Q_PROPERTY(bool loadAviationDataByRegion READ loadAviationDataByRegion WRITE setLoadAviationDataByRegion NOTIFY loadAviationDataByRegionChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property loadAviationDataByRegion
+     */
+    bool loadAviationDataByRegion() const { return values().loadAviationDataByRegion; }
+
+    /*! \brief Setter function for property of the same name
+     *
+     * @param byRegion Property loadAviationDataByRegion
+     */
+    void setLoadAviationDataByRegion(bool byRegion);
+
     /*! \brief Map bearing policy */
     Q_PROPERTY(MapBearingPolicyValues mapBearingPolicy READ mapBearingPolicy WRITE setMapBearingPolicy NOTIFY mapBearingPolicyChanged)
 
@@ -180,6 +215,25 @@ public:
      */
     void setMapBearingPolicy(MapBearingPolicyValues policy);
 
+    /*! \brief Maximal number of map downloads that run at the same time
+     *
+     * This property is used when several maps are updated at once. The
+     * default is 2.
+     */
+    Q_PROPERTY(int maxParallelDownloads READ maxParallelDownloads WRITE setMaxParallelDownloads NOTIFY maxParallelDownloadsChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property maxParallelDownloads
+     */
+    int maxParallelDownloads() const { return qMax(1, values().maxParallelDownloads.load()); }
+
+    /*! \brief Setter function for property of the same name
+     *
+     * @param number Property maxParallelDownloads
+     */
+    void setMaxParallelDownloads(int number);
+
     /*! \brief Night mode */
     Q_PROPERTY(bool nightMode READ nightMode WRITE setNightMode NOTIFY nightModeChanged)
 
@@ -195,6 +249,83 @@ public:
      */
     void setNightMode(bool newNightMode);
 
+    /*! \brief Record the flight track
+     *
+     * If set, the Navigator records all positions in its FlightRecorder. The
+     * recording is off by default, because the track is personal data that
+     * the app keeps on the device.
+     */
+    Q_PROPERTY(bool recordFlightTrack READ recordFlightTrack WRITE setRecordFlightTrack NOTIFY recordFlightTrackChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property recordFlightTrack
+     */
+    bool recordFlightTrack() const { return values().recordFlightTrack; }
+
+    /*! \brief Setter function for property of the same name
+     *
+     * @param record Property recordFlightTrack
+     */
+    void setRecordFlightTrack(bool record);
+
+    /*! \brief Size of the in-memory tile cache, in megabytes */
+    Q_PROPERTY(int tileCacheSize READ tileCacheSize WRITE setTileCacheSize NOTIFY tileCacheSizeChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property tileCacheSize
+     */
+    int tileCacheSize() const { return values().tileCacheSize; }
+
+    /*! \brief Setter function for property of the same name
+     *
+     * @param sizeInMB Property tileCacheSize
+     */
+    void setTileCacheSize(int sizeInMB);
+
+    /*! \brief Fuse traffic data from all traffic receivers
+     *
+     * If set to false, which is the default, the app uses only one traffic
+     * receiver at a time.  If set to true, traffic reported by all receivers
+     * that send heartbeat messages is combined, which is useful for aircraft
+     * that carry both a FLARM and an ADS-B receiver.
+     */
+    Q_PROPERTY(bool trafficDataFusion READ trafficDataFusion WRITE setTrafficDataFusion NOTIFY trafficDataFusionChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property trafficDataFusion
+     */
+    bool trafficDataFusion() const { return values().trafficDataFusion; }
+
+    /*! \brief Setter function for property of the same name
+     *
+     * @param newTrafficDataFusion Property trafficDataFusion
+     */
+    void setTrafficDataFusion(bool newTrafficDataFusion);
+
+    /*! \brief Network endpoints used to receive traffic data
+     *
+     * This property holds the list of endpoints that the app uses to look for
+     * traffic receivers, in order of preference, preferred endpoints first.
+     * Entries are of the form "tcp:host:port" or "udp:port". By default, the
+     * list contains the endpoints of the most common traffic receivers.
+     */
+    Q_PROPERTY(QStringList trafficDataSources READ trafficDataSources WRITE setTrafficDataSources NOTIFY trafficDataSourcesChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property trafficDataSources
+     */
+    QStringList trafficDataSources() const;
+
+    /*! \brief Setter function for property of the same name
+     *
+     * @param newTrafficDataSources Property trafficDataSources
+     */
+    void setTrafficDataSources(const QStringList& newTrafficDataSources);
+
     /*! \brief Set to true is app should be shown in English rather than the
      * system language */
     Q_PROPERTY(bool useMetricUnits READ useMetricUnits WRITE setUseMetricUnits NOTIFY useMetricUnitsChanged)
@@ -203,12 +334,12 @@ public:
      *
      * @returns Property useMetricUnits
      */
-    bool useMetricUnits() const { return settings.value(QStringLiteral("System/useMetricUnits"), false).toBool(); }
+    bool useMetricUnits() const { return values().useMetricUnits; }
 
     /*! \brief Getter function for property of the same name
      *
-     * This function differs from useMetricUnits() only in that it is static.
-     * It uses the globalInstance() to retrieve data.
+     * This function differs from useMetricUnits() only in that it is static
+     * and thread safe.
      *
      * @returns Property useMetricUnits
      */
@@ -232,6 +363,24 @@ public:
      */
     void installTranslators(const QString &localeName={});
 
+    /*! \brief Traffic data source last used in a given Wi-Fi network
+     *
+     * @param ssid SSID of the Wi-Fi network
+     *
+     * @returns Name of the traffic data source that last received heartbeat
+     * messages in this network, or an empty string if no such source is known
+     */
+    QString lastTrafficDataSource(const QString& ssid) const;
+
+    /*! \brief Sets the traffic data source last used in a given Wi-Fi network
+     *
+     * @param ssid SSID of the Wi-Fi network. If the SSID is empty, this method
+     * does nothing.
+     *
+     * @param sourceName Name of the traffic data source
+     */
+    void setLastTrafficDataSource(const QString& ssid, const QString& sourceName);
+
 signals:
     /*! Notifier signal */
     void acceptedTermsChanged();
@@ -245,18 +394,71 @@ signals:
     /*! Notifier signal */
     void lastWhatsNewHashChanged();
 
+    /*! Notifier signal */
+    void loadAviationDataByRegionChanged();
+
     /*! Notifier signal */
     void mapBearingPolicyChanged();
 
+    /*! Notifier signal */
+    void maxParallelDownloadsChanged();
+
     /*! Notifier signal */
     void nightModeChanged();
 
+    /*! Notifier signal */
+    void recordFlightTrackChanged();
+
+    /*! Notifier signal */
+    void tileCacheSizeChanged();
+
+    /*! Notifier signal */
+    void trafficDataFusionChanged();
+
+    /*! Notifier signal */
+    void trafficDataSourcesChanged();
+
     /*! Notifier signal */
     void useMetricUnitsChanged();
 
 private:
     Q_DISABLE_COPY_MOVE(Settings)
 
+    // In-memory copy of the settings, shared by all instances of this class.
+    // It is loaded from QSettings when first used, and updated by the setter
+    // methods. The members are atomic, so that they can be read from any
+    // thread.
+    struct Values {
+        Values();
+
+        std::atomic<int> acceptedTerms;
+        std::atomic<bool> acceptedWeatherTerms;
+        std::atomic<bool> hideUpperAirspaces;
+        std::atomic<uint> lastWhatsNewHash;
+        std::atomic<bool> loadAviationDataByRegion;
+        std::atomic<int> mapBearingPolicy;
+        std::atomic<int> maxParallelDownloads;
+        std::atomic<bool> nightMode;
+        std::atomic<bool> recordFlightTrack;
+        std::atomic<int> tileCacheSize;
+        std::atomic<bool> trafficDataFusion;
+        std::atomic<bool> useMetricUnits;
+    };
+    static Values& values();
+
+    // Schedules a value to be written to QSettings. Writes are collected for
+    // writeDelayMS milliseconds, and then written by writePendingValues().
+    void write(const QString& key, const QVariant& value);
+
+    // Writes the scheduled values to QSettings, in a background thread. If
+    // the previous batch is still being written, the writes are postponed.
+    void writePendingValues();
+
+    QHash<QString, QVariant> m_pendingValues;
+    QTimer m_writeTimer;
+    QFuture<void> m_writeFuture;
+    static constexpr int writeDelayMS = 1000;
+
     QPointer<QTranslator> enrouteTranslator {nullptr};
 
     QSettings settings;
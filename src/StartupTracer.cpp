@@ -0,0 +1,101 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+
+#include "StartupTracer.h"
+
+
+namespace {
+
+// State of the tracer, initialised on first use
+struct TracerState
+{
+    TracerState()
+    {
+        timer.start();
+    }
+
+    QElapsedTimer timer;
+    QThread* mainThread {nullptr};
+    QMutex mutex;
+};
+
+auto state() -> TracerState&
+{
+    static TracerState tracerState;
+    return tracerState;
+}
+
+}
+
+
+StartupTracer::Phase::Phase(const char* name)
+    : m_name(name), m_begin_ns(elapsed_ns())
+{
+}
+
+
+StartupTracer::Phase::~Phase()
+{
+    record(m_name, m_begin_ns, elapsed_ns());
+}
+
+
+void StartupTracer::start()
+{
+    auto& tracerState = state();
+    QMutexLocker locker(&tracerState.mutex);
+    tracerState.mainThread = QThread::currentThread();
+    tracerState.timer.restart();
+}
+
+
+void StartupTracer::mark(const char* name)
+{
+    auto now = elapsed_ns();
+    record(name, now, now);
+}
+
+
+auto StartupTracer::elapsed_ns() -> qint64
+{
+    return state().timer.nsecsElapsed();
+}
+
+
+void StartupTracer::record(const char* name, qint64 begin_ns, qint64 end_ns)
+{
+    if (begin_ns > maxStartupDuration_ms*1000000) {
+        return;
+    }
+
+    auto& tracerState = state();
+    QMutexLocker locker(&tracerState.mutex);
+    auto thread = (QThread::currentThread() == tracerState.mainThread) ? QStringLiteral("main thread") : QStringLiteral("worker thread");
+    if (begin_ns == end_ns) {
+        qDebug().noquote() << QStringLiteral("Startup %1 ms, %2: %3").arg(begin_ns/1000000, 6).arg(thread, QString::fromUtf8(name));
+        return;
+    }
+    qDebug().noquote() << QStringLiteral("Startup %1 ms … %2 ms, %3: %4").arg(begin_ns/1000000, 6).arg(end_ns/1000000, 6).arg(thread, QString::fromUtf8(name));
+}
@@ -0,0 +1,95 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QtGlobal>
+
+
+/*! \brief Timestamps for the phases of the program start
+ *
+ * This class records when the phases of the program start begin and end, and
+ * in which thread they run. Each phase is written to the debug log as soon as
+ * it ends, with times given in milliseconds since start() was called. This
+ * makes it possible to see which phases lie on the critical path and which
+ * ones run in parallel.
+ *
+ * Phases are recorded only during the first maxStartupDuration_ms
+ * milliseconds, so that code that also runs later (for instance, when maps are
+ * updated) does not fill the log. All methods are thread-safe.
+ *
+ * Typical use:
+ *
+ * ~~~
+ * StartupTracer::Phase phase("GeoJSON parsing");
+ * ~~~
+ */
+
+class StartupTracer
+{
+public:
+    /*! \brief Phase of the program start
+     *
+     * The phase begins when the object is constructed and ends when it is
+     * destructed.
+     */
+    class Phase
+    {
+    public:
+        /*! \brief Begins a phase
+         *
+         * @param name Name of the phase. The string must remain valid until
+         * the phase ends; string literals are the typical choice.
+         */
+        explicit Phase(const char* name);
+
+        /*! \brief Ends the phase and writes it to the log */
+        ~Phase();
+
+    private:
+        Q_DISABLE_COPY_MOVE(Phase)
+
+        const char* m_name;
+        qint64 m_begin_ns;
+    };
+
+    /*! \brief Starts the clock
+     *
+     * This method should be called at the very beginning of main(). The
+     * thread in which it is called is taken as the main thread.
+     */
+    static void start();
+
+    /*! \brief Records an event without duration
+     *
+     * @param name Name of the event
+     */
+    static void mark(const char* name);
+
+    /*! \brief Phases are recorded only this long after start() */
+    static constexpr qint64 maxStartupDuration_ms = 60000;
+
+private:
+    // Writes a phase to the log
+    static void record(const char* name, qint64 begin_ns, qint64 end_ns);
+
+    // Time since start(), in nanoseconds
+    static qint64 elapsed_ns();
+};
@@ -45,6 +45,7 @@ import android.util.Log;
 public class MobileAdaptor extends de.akaflieg_freiburg.enroute.ShareActivity
 {
     public static native void onWifiConnected();
+    public static native void onTrimMemoryRequested(int level);
 
     private static MobileAdaptor        m_instance;
 
@@ -100,6 +101,20 @@ public class MobileAdaptor extends de.akaflieg_freiburg.enroute.ShareActivity
     }
     
     
+    /* Pass requests to free memory on to the app */
+    @Override
+    public void onTrimMemory(int level) {
+        super.onTrimMemory(level);
+        onTrimMemoryRequested(level);
+    }
+
+    @Override
+    public void onLowMemory() {
+        super.onLowMemory();
+        onTrimMemoryRequested(TRIM_MEMORY_COMPLETE);
+    }
+    
+    
     /* Vibrate once, very briefly */
     public static void vibrateBrief()
     {
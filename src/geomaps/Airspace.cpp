@@ -18,14 +18,71 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QHash>
 #include <QJsonArray>
+#include <QScopeGuard>
+#include <QtMath>
+#include <cmath>
+#include <limits>
 
 //#include "AviationUnits.h"
 
 #include "Airspace.h"
+#include "StringPool.h"
 
 
-GeoMaps::Airspace::Airspace(const QJsonObject &geoJSONObject) {
+// Static Helper functions
+
+namespace {
+
+// Distance between a point p and the segment from a to b, in plain
+// longitude/latitude coordinates
+auto segmentDistanceInDEG(const QGeoCoordinate& p, const QGeoCoordinate& a, const QGeoCoordinate& b) -> double
+{
+    auto dx = b.longitude()-a.longitude();
+    auto dy = b.latitude()-a.latitude();
+    auto px = p.longitude()-a.longitude();
+    auto py = p.latitude()-a.latitude();
+    auto lengthSquared = dx*dx + dy*dy;
+    if (lengthSquared > 0.0) {
+        auto t = qBound(0.0, (px*dx + py*dy)/lengthSquared, 1.0);
+        px -= t*dx;
+        py -= t*dy;
+    }
+    return std::sqrt(px*px + py*py);
+}
+
+// Even-odd test for a point in a polygon, in plain longitude/latitude
+// coordinates. If minDistance is not nullptr, it is set to the distance
+// between the point and the boundary.
+auto pathContains(const QList<QGeoCoordinate>& path, const QGeoCoordinate& p, double* minDistance = nullptr) -> bool
+{
+    bool inside = false;
+    auto x = p.longitude();
+    auto y = p.latitude();
+    double distance = std::numeric_limits<double>::infinity();
+    for(int i=0, j=path.size()-1; i<path.size(); j=i++) {
+        const auto& a = path[i];
+        const auto& b = path[j];
+        if (((a.latitude() > y) != (b.latitude() > y)) &&
+                (x < (b.longitude()-a.longitude())*(y-a.latitude())/(b.latitude()-a.latitude())+a.longitude())) {
+            inside = !inside;
+        }
+        if (minDistance != nullptr) {
+            distance = qMin(distance, segmentDistanceInDEG(p, a, b));
+        }
+    }
+    if (minDistance != nullptr) {
+        *minDistance = distance;
+    }
+    return inside;
+}
+
+}
+
+
+
+GeoMaps::Airspace::Airspace(const QJsonObject &geoJSONObject, StringPool* pool) {
     // Paranoid safety checks
     if (geoJSONObject["type"] != "Feature") {
         return;
@@ -46,15 +103,22 @@ GeoMaps::Airspace::Airspace(const QJsonObject &geoJSONObject) {
     if (polygonArray.size() != 1) {
         return;
     }
+    // Collect the coordinates first and set the path at once, so that the
+    // polygon is allocated only once
     auto polygonCoordinates = polygonArray[0].toArray();
+    QList<QGeoCoordinate> path;
+    path.reserve(polygonCoordinates.size());
     foreach (auto coordinate, polygonCoordinates) {
         auto coordinateArray = coordinate.toArray();
-        auto geoCoordinate =
-                QGeoCoordinate(coordinateArray[1].toDouble(), coordinateArray[0].toDouble());
-        _polygon.addCoordinate(geoCoordinate);
+        path.append(QGeoCoordinate(coordinateArray[1].toDouble(), coordinateArray[0].toDouble()));
     }
+    _polygon.setPath(path);
+    computeBoundingBox();
+    computeCoarsePath();
 
-    // Get properties
+    // Get properties. Whatever properties are found, they are interpreted
+    // when the constructor returns.
+    auto interpretPropertiesOnReturn = qScopeGuard([this, pool]() { interpretProperties(pool); });
     if (!geoJSONObject.contains("properties")) {
         return;
     }
@@ -80,15 +144,224 @@ GeoMaps::Airspace::Airspace(const QJsonObject &geoJSONObject) {
     _lowerBound = properties["BOT"].toString();
 }
 
-auto GeoMaps::Airspace::estimatedLowerBoundInFtMSL() const -> double {
+GeoMaps::Airspace::Airspace(QDataStream &inputStream, StringPool* pool) {
+    QList<QGeoCoordinate> path;
+
+    inputStream >> _name;
+    inputStream >> _CAT;
+    inputStream >> _upperBound;
+    inputStream >> _lowerBound;
+    inputStream >> path;
+    _polygon.setPath(path);
+    computeBoundingBox();
+    computeCoarsePath();
+    interpretProperties(pool);
+}
+
+void GeoMaps::Airspace::computeBoundingBox() {
+    const auto path = _polygon.path();
+    if (path.isEmpty()) {
+        return;
+    }
+    _minLat = _maxLat = path[0].latitude();
+    _minLon = _maxLon = path[0].longitude();
+    for(const auto& coordinate : path) {
+        _minLat = qMin(_minLat, coordinate.latitude());
+        _maxLat = qMax(_maxLat, coordinate.latitude());
+        _minLon = qMin(_minLon, coordinate.longitude());
+        _maxLon = qMax(_maxLon, coordinate.longitude());
+    }
+}
+
+void GeoMaps::Airspace::computeCoarsePath() {
+    const auto path = _polygon.path();
+    auto coarsePath = simplifiedPath(path, coarseToleranceInDEG);
+
+    // A closed path needs at least three distinct points
+    if ((coarsePath.size() < path.size()) && (coarsePath.size() >= 4)) {
+        _coarsePath = coarsePath;
+    }
+}
+
+auto GeoMaps::Airspace::contains(const QGeoCoordinate& position) const -> bool {
+    if (!isValid() || !position.isValid()) {
+        return false;
+    }
+    auto lat = position.latitude();
+    auto lon = position.longitude();
+    if ((lat < _minLat) || (lat > _maxLat) || (lon < _minLon) || (lon > _maxLon)) {
+        return false;
+    }
+
+    // Every point of the full boundary is within coarseToleranceInDEG of the
+    // coarse boundary, and vice versa. Positions that are further away from
+    // the coarse boundary therefore lie on the same side of both.
+    if (!_coarsePath.isEmpty()) {
+        double distance = 0.0;
+        auto inside = pathContains(_coarsePath, position, &distance);
+        if (distance > coarseToleranceInDEG) {
+            return inside;
+        }
+    }
+    return pathContains(_polygon.path(), position);
+}
+
+auto GeoMaps::Airspace::meetsCircle(const QGeoCoordinate& position, double radiusM) const -> bool {
+    if (!isValid() || !position.isValid()) {
+        return false;
+    }
+
+    // One degree of latitude is 60 nautical miles. Degrees of longitude are
+    // shorter, so converting to degrees of longitude gives the larger radius.
+    auto cosLat = qMax(0.01, std::cos(qDegreesToRadians(position.latitude())));
+    auto radiusDEG = radiusM/(60.0*1852.0)/cosLat;
+    auto lat = position.latitude();
+    auto lon = position.longitude();
+    if ((lat < _minLat-radiusDEG) || (lat > _maxLat+radiusDEG) || (lon < _minLon-radiusDEG) || (lon > _maxLon+radiusDEG)) {
+        return false;
+    }
+
+    // As in contains(), test against the coarse boundary first
+    double distance = 0.0;
+    if (!_coarsePath.isEmpty()) {
+        auto inside = pathContains(_coarsePath, position, &distance);
+        if (inside && (distance > coarseToleranceInDEG)) {
+            return true;
+        }
+        if (!inside && (distance > radiusDEG+coarseToleranceInDEG)) {
+            return false;
+        }
+    }
+    auto inside = pathContains(_polygon.path(), position, &distance);
+    return inside || (distance <= radiusDEG);
+}
+
+void GeoMaps::Airspace::interpretProperties(StringPool* pool) {
+    // Share the data of the strings that appear over and over again
+    if (pool != nullptr) {
+        _CAT = pool->intern(_CAT);
+        _upperBound = pool->intern(_upperBound);
+        _lowerBound = pool->intern(_lowerBound);
+    } else {
+        _CAT = StringPool::interned(_CAT);
+    }
+
+    // Vertical limits
+    double flightLevel = qQNaN();
+    _upperBoundFtMSL = static_cast<float>(estimateFtMSL(_upperBound, flightLevel));
+    _lowerBoundFtMSL = static_cast<float>(estimateFtMSL(_lowerBound, flightLevel));
+    _isUpper = !qIsNaN(flightLevel) && (flightLevel >= 100.0);
+
+    // Category
+    static const QHash<QString, Category> categories {
+        {QStringLiteral("A"), Category::A},
+        {QStringLiteral("B"), Category::B},
+        {QStringLiteral("C"), Category::C},
+        {QStringLiteral("D"), Category::D},
+        {QStringLiteral("E"), Category::E},
+        {QStringLiteral("F"), Category::F},
+        {QStringLiteral("G"), Category::G},
+        {QStringLiteral("CTR"), Category::CTR},
+        {QStringLiteral("DNG"), Category::DNG},
+        {QStringLiteral("GLD"), Category::GLD},
+        {QStringLiteral("NRA"), Category::NRA},
+        {QStringLiteral("P"), Category::P},
+        {QStringLiteral("PJE"), Category::PJE},
+        {QStringLiteral("R"), Category::R},
+        {QStringLiteral("RMZ"), Category::RMZ},
+        {QStringLiteral("TMZ"), Category::TMZ},
+        {QStringLiteral("TRA"), Category::TRA},
+        {QStringLiteral("TSA"), Category::TSA}
+    };
+    _category = categories.value(_CAT, Category::Other);
+}
+
+auto GeoMaps::Airspace::entryFractionAlong(const QGeoCoordinate& start, const QGeoCoordinate& end) const -> double {
+    if (!start.isValid() || !end.isValid()) {
+        return -1.0;
+    }
+    if (contains(start)) {
+        return 0.0;
+    }
+
+    // Intersect the segment with every edge of the polygon, using longitude as
+    // x and latitude as y. The parameters of the intersection points do not
+    // depend on the scale of the axes.
+    const auto path = _polygon.path();
+    auto px = start.longitude();
+    auto py = start.latitude();
+    auto rx = end.longitude()-px;
+    auto ry = end.latitude()-py;
+    double result = 2.0;
+    for(int i=0; i<path.size(); i++) {
+        const auto& a = path[i];
+        const auto& b = path[(i+1)%path.size()];
+        auto qx = a.longitude();
+        auto qy = a.latitude();
+        auto sx = b.longitude()-qx;
+        auto sy = b.latitude()-qy;
+
+        auto denominator = rx*sy - ry*sx;
+        if (qFuzzyIsNull(denominator)) {
+            continue;
+        }
+        auto t = ((qx-px)*sy - (qy-py)*sx)/denominator;
+        auto u = ((qx-px)*ry - (qy-py)*rx)/denominator;
+        if ((t >= 0.0) && (t <= 1.0) && (u >= 0.0) && (u <= 1.0)) {
+            result = qMin(result, t);
+        }
+    }
+    return (result <= 1.0) ? result : -1.0;
+}
+
+auto GeoMaps::Airspace::simplifiedPath(const QList<QGeoCoordinate>& path, double toleranceInDEG) -> QList<QGeoCoordinate> {
+    if (path.size() < 3) {
+        return path;
+    }
+
+    // Iterative Douglas-Peucker, with a stack of index ranges
+    QVector<bool> keep(path.size(), false);
+    keep.first() = true;
+    keep.last() = true;
+    QVector<QPair<int,int>> ranges {{0, path.size()-1}};
+    while (!ranges.isEmpty()) {
+        auto range = ranges.takeLast();
+        double maxDistance = 0.0;
+        int maxIndex = -1;
+        for(int i=range.first+1; i<range.second; i++) {
+            auto distance = segmentDistanceInDEG(path[i], path[range.first], path[range.second]);
+            if (distance > maxDistance) {
+                maxDistance = distance;
+                maxIndex = i;
+            }
+        }
+        if (maxDistance > toleranceInDEG) {
+            keep[maxIndex] = true;
+            ranges.append({range.first, maxIndex});
+            ranges.append({maxIndex, range.second});
+        }
+    }
+
+    QList<QGeoCoordinate> result;
+    for(int i=0; i<path.size(); i++) {
+        if (keep[i]) {
+            result.append(path[i]);
+        }
+    }
+    return result;
+}
+
+auto GeoMaps::Airspace::estimateFtMSL(const QString& bound, double& flightLevel) -> double {
     double result = 0.0;
     bool ok = false;
+    flightLevel = qQNaN();
 
-    QString AL = _lowerBound.simplified();
+    QString AL = bound.simplified();
 
     if (AL.startsWith("FL", Qt::CaseInsensitive)) {
         result = AL.remove(0, 2).toDouble(&ok);
         if (ok) {
+            flightLevel = result;
             return 100 * result;
         }
         return 0.0;
@@ -114,18 +387,10 @@ auto GeoMaps::Airspace::estimatedLowerBoundInFtMSL() const -> double {
     return 0.0;
 }
 
-auto GeoMaps::Airspace::isUpper() const -> bool {
-    QString AL = _lowerBound.simplified();
-
-    if (!AL.startsWith("FL", Qt::CaseInsensitive)) {
-        return false;
-    }
-
-    bool ok = false;
-    double fl = AL.remove(0, 2).toDouble(&ok);
-    if (!ok) {
-        return false;
-    }
-
-    return fl >= 100.0;
+void GeoMaps::Airspace::write(QDataStream &out) const {
+    out << _name;
+    out << _CAT;
+    out << _upperBound;
+    out << _lowerBound;
+    out << _polygon.path();
 }
@@ -20,12 +20,22 @@
 
 #pragma once
 
+#include <QDataStream>
 #include <QGeoPolygon>
+#include <QGeoRectangle>
 #include <QJsonObject>
 
 namespace GeoMaps {
 
-/*! \brief A very simple class that describes an airspace */
+class StringPool;
+
+/*! \brief A very simple class that describes an airspace
+ *
+ * The strings that describe the category and the vertical limits are
+ * interpreted once, on construction. Numeric data such as
+ * estimatedLowerBoundInFtMSL(), isUpper(), category() and boundingBox() are
+ * therefore cheap, and can be used in sort comparators and filters.
+ */
 
 class Airspace {
     Q_GADGET
@@ -41,8 +51,118 @@ public:
      * [here](https://github.com/Akaflieg-Freiburg/enrouteServer/wiki/GeoJSON-files-used-in-enroute-flight-navigation).
      *
      * @param geoJSONObject GeoJSON Object that describes the airspace.
+     *
+     * @param pool If not nullptr, the strings of the airspace are interned
+     * with this pool
+     */
+    explicit Airspace(const QJsonObject &geoJSONObject, StringPool* pool = nullptr);
+
+    /*! \brief Constructs an airspace from a data stream
+     *
+     * This method reads an airspace that has been serialized with the method
+     * write().
+     *
+     * @param inputStream Data stream
+     *
+     * @param pool If not nullptr, the strings of the airspace are interned
+     * with this pool
+     */
+    explicit Airspace(QDataStream &inputStream, StringPool* pool = nullptr);
+
+    /*! \brief Airspace categories
+     *
+     * Categories as described in the GeoJSON file specification. Categories
+     * not listed here are mapped to Other.
+     */
+    enum class Category : quint8 {
+        Other, /*!< Any other category */
+        A, /*!< Airspace A */
+        B, /*!< Airspace B */
+        C, /*!< Airspace C */
+        D, /*!< Airspace D */
+        E, /*!< Airspace E */
+        F, /*!< Airspace F */
+        G, /*!< Airspace G */
+        CTR, /*!< Control zone */
+        DNG, /*!< Danger area */
+        GLD, /*!< Glider sector */
+        NRA, /*!< Nature reserve area */
+        P, /*!< Prohibited area */
+        PJE, /*!< Parachute jumping exercise */
+        R, /*!< Restricted area */
+        RMZ, /*!< Radio mandatory zone */
+        TMZ, /*!< Transponder mandatory zone */
+        TRA, /*!< Temporary reserved area */
+        TSA /*!< Temporary segregated area */
+    };
+
+    /*! \brief Bounding box of the lateral limits
+     *
+     * The bounding box is computed in plain latitude/longitude coordinates.
+     *
+     * @returns Bounding box, or an invalid rectangle if the airspace is invalid
+     */
+    QGeoRectangle boundingBox() const
+    {
+        if (!isValid()) {
+            return {};
+        }
+        return {QGeoCoordinate(_maxLat, _minLon), QGeoCoordinate(_minLat, _maxLon)};
+    }
+
+    /*! \brief Category of the airspace, as an enum
+     *
+     * @returns Category of the airspace
+     *
+     * @see CAT
+     */
+    Category category() const { return _category; }
+
+    /*! \brief Checks if a position lies within the lateral limits
+     *
+     * The boundary of the airspace is treated as a sequence of straight lines
+     * in latitude/longitude coordinates, as in entryFractionAlong(). As a
+     * first pass, the position is tested against coarsePath(). If the
+     * position is further than coarseToleranceInDEG away from the boundary of
+     * the coarse path, the result of this test is returned. Only positions
+     * near the boundary are tested against the full polygon.
+     *
+     * @param position Position
+     *
+     * @returns True if the position lies within the lateral limits
+     */
+    bool contains(const QGeoCoordinate& position) const;
+
+    /*! \brief Checks if the lateral limits meet a circle
+     *
+     * This method works like contains(), but also accepts positions outside
+     * of the airspace whose distance to the boundary is at most the radius.
+     * Distances are computed in latitude/longitude coordinates, with the
+     * radius converted to degrees of longitude. For circles of the size
+     * used for airspace warnings, this slightly overestimates the circle,
+     * so no airspace that meets the circle is missed.
+     *
+     * @param position Center of the circle
+     *
+     * @param radiusM Radius of the circle, in meters
+     *
+     * @returns True if the circle and the lateral limits have a point in
+     * common
      */
-    explicit Airspace(const QJsonObject &geoJSONObject);
+    bool meetsCircle(const QGeoCoordinate& position, double radiusM) const;
+
+    /*! \brief Tolerance used to compute coarsePath(), in degrees */
+    static constexpr double coarseToleranceInDEG = 0.002;
+
+    /*! \brief Simplified boundary of the airspace
+     *
+     * This is the boundary of the polygon, simplified with the tolerance
+     * coarseToleranceInDEG, as computed by simplifiedPath(). The path is
+     * empty if simplification does not remove any point.
+     *
+     * @returns Simplified boundary
+     */
+    QList<QGeoCoordinate> coarsePath() const { return _coarsePath; }
 
     /*! \brief Estimates the lower limit of the airspace, in feet above MSL
      *
@@ -53,7 +173,33 @@ public:
      * @returns Estimated lower bound of the airspace, in feet above main sea
      * level
      */
-    double estimatedLowerBoundInFtMSL() const;
+    double estimatedLowerBoundInFtMSL() const { return _lowerBoundFtMSL; }
+
+    /*! \brief Estimates the upper limit of the airspace, in feet above MSL
+     *
+     * This method works like estimatedLowerBoundInFtMSL(), but for the upper
+     * limit.
+     *
+     * @returns Estimated upper bound of the airspace, in feet above main sea
+     * level
+     */
+    double estimatedUpperBoundInFtMSL() const { return _upperBoundFtMSL; }
+
+    /*! \brief Finds the point where a line segment first meets the airspace
+     *
+     * The segment and the boundary of the airspace are treated as straight
+     * lines in latitude/longitude coordinates. For segments of the length
+     * found in VFR flight routes, this is a good approximation.
+     *
+     * @param start Start point of the segment
+     *
+     * @param end End point of the segment
+     *
+     * @returns Fraction of the segment, between 0 and 1, at which the segment
+     * enters the airspace. If the start point lies within the airspace, 0 is
+     * returned. If the segment does not meet the airspace, -1 is returned.
+     */
+    double entryFractionAlong(const QGeoCoordinate& start, const QGeoCoordinate& end) const;
 
     /*! \brief Estimates if the airspace begins at FL100 or above
      *
@@ -66,7 +212,7 @@ public:
      *
      * @returns Property isUpper
      */
-    bool isUpper() const;
+    bool isUpper() const { return _isUpper; }
 
     /*! \brief Validity */
     Q_PROPERTY(bool isValid READ isValid CONSTANT)
@@ -100,6 +246,21 @@ public:
      */
     QString name() const { return _name; }
 
+    /*! \brief Simplifies a path with the Douglas-Peucker algorithm
+     *
+     * The method removes points of the path, such that every removed point is
+     * within the tolerance of the simplified path. First and last point are
+     * always kept, so that closed paths remain closed. Distances are computed
+     * in plain latitude/longitude coordinates.
+     *
+     * @param path Path
+     *
+     * @param toleranceInDEG Tolerance, in degrees
+     *
+     * @returns Simplified path
+     */
+    static QList<QGeoCoordinate> simplifiedPath(const QList<QGeoCoordinate>& path, double toleranceInDEG);
+
     /*! \brief QGeoPolygon that describes the lateral limits of the airspace */
     Q_PROPERTY(QGeoPolygon polygon READ polygon CONSTANT)
 
@@ -137,12 +298,44 @@ public:
      */
     QString upperBound() const { return _upperBound; }
 
+    /*! \brief Serialization to data stream
+     *
+     * The airspace can be restored with the obvious constructor.
+     *
+     * @param out Data stream
+     */
+    void write(QDataStream &out) const;
+
 private:
+    // Compute the numeric data below, from the polygon and from the strings
+    // that describe category and vertical limits. If pool is not nullptr,
+    // interpretProperties() also interns these strings.
+    void computeBoundingBox();
+    void computeCoarsePath();
+    void interpretProperties(StringPool* pool);
+
+    // Interprets a string that describes a vertical limit. Returns a rough
+    // estimate in feet above MSL, or 0.0 if the string cannot be interpreted.
+    // If the limit is given as a flight level, the flight level is stored in
+    // flightLevel. Otherwise, flightLevel is set to NaN.
+    static double estimateFtMSL(const QString& bound, double& flightLevel);
+
     QString _name{};
     QString _CAT{};
     QString _upperBound{};
     QString _lowerBound{};
     QGeoPolygon _polygon{};
+    QList<QGeoCoordinate> _coarsePath{};
+
+    // Numeric data, computed once on construction
+    double _minLat {0.0};
+    double _minLon {0.0};
+    double _maxLat {0.0};
+    double _maxLon {0.0};
+    float _lowerBoundFtMSL {0.0F};
+    float _upperBoundFtMSL {0.0F};
+    Category _category {Category::Other};
+    bool _isUpper {false};
 };
 
 }
@@ -0,0 +1,295 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QVarLengthArray>
+#include <QtMath>
+#include <algorithm>
+#include <array>
+#include <limits>
+
+#include "AirspaceIndex.h"
+
+
+namespace {
+
+// Conservative vertical extent of an airspace, in feet above MSL. The
+// estimates of Airspace are rough. Lower limits given relative to the ground
+// are underestimated, which is safe. Upper limits given relative to the
+// ground, and upper limits that could not be interpreted, are replaced by
+// infinity.
+auto verticalExtent(const GeoMaps::Airspace& airspace) -> QPair<float,float>
+{
+    auto lower = static_cast<float>(airspace.estimatedLowerBoundInFtMSL());
+    auto upper = static_cast<float>(airspace.estimatedUpperBoundInFtMSL());
+    if ((upper <= lower) || airspace.upperBound().contains(QLatin1String("AGL"), Qt::CaseInsensitive) ||
+            airspace.upperBound().contains(QLatin1String("GND"), Qt::CaseInsensitive)) {
+        upper = std::numeric_limits<float>::infinity();
+    }
+    return {lower, upper};
+}
+
+}
+
+
+template<typename T> void GeoMaps::AirspaceIndex::strSort(QVector<T>& items)
+{
+    auto numGroups = (items.size()+maxChildren-1)/maxChildren;
+    auto numSlices = qCeil(qSqrt(numGroups));
+    auto sliceSize = numSlices*maxChildren;
+
+    // Sort by longitude of the box center, then cut into vertical slices and
+    // sort each slice by latitude of the box center
+    std::sort(items.begin(), items.end(), [](const T& a, const T& b) {
+        return (a.box.minLon+a.box.maxLon) < (b.box.minLon+b.box.maxLon);
+    });
+    for(int start=0; start<items.size(); start+=sliceSize) {
+        auto end = qMin(start+sliceSize, items.size());
+        std::sort(items.begin()+start, items.begin()+end, [](const T& a, const T& b) {
+            return (a.box.minLat+a.box.maxLat) < (b.box.minLat+b.box.maxLat);
+        });
+    }
+}
+
+
+GeoMaps::AirspaceIndex::AirspaceIndex(const QVector<Airspace>& airspaces)
+{
+    // Compute bounding boxes
+    m_entries.reserve(airspaces.size());
+    for(int i=0; i<airspaces.size(); i++) {
+        const auto& airspace = airspaces[i];
+        if (!airspace.isValid()) {
+            continue;
+        }
+        // The bounding box is precomputed by the airspace
+        auto boundingBox = airspace.boundingBox();
+        Entry entry;
+        entry.airspaceIndex = i;
+        entry.box.minLat = boundingBox.bottomLeft().latitude();
+        entry.box.minLon = boundingBox.bottomLeft().longitude();
+        entry.box.maxLat = boundingBox.topRight().latitude();
+        entry.box.maxLon = boundingBox.topRight().longitude();
+        auto extent = verticalExtent(airspace);
+        entry.box.minAltFt = extent.first;
+        entry.box.maxAltFt = extent.second;
+        m_entries.append(entry);
+    }
+    if (m_entries.isEmpty()) {
+        return;
+    }
+
+    // Generate leaves
+    strSort(m_entries);
+    QVector<Node> level;
+    for(int i=0; i<m_entries.size(); i+=maxChildren) {
+        Node node;
+        node.firstChild = i;
+        node.numChildren = qMin(maxChildren, m_entries.size()-i);
+        node.isLeaf = true;
+        node.box = m_entries[i].box;
+        for(int j=i+1; j<i+node.numChildren; j++) {
+            node.box.unite(m_entries[j].box);
+        }
+        level.append(node);
+    }
+
+    // Generate inner nodes, level by level, until only the root is left
+    while(level.size() > 1) {
+        strSort(level);
+        auto offset = m_nodes.size();
+        m_nodes += level;
+
+        QVector<Node> parents;
+        for(int i=0; i<level.size(); i+=maxChildren) {
+            Node node;
+            node.firstChild = offset+i;
+            node.numChildren = qMin(maxChildren, level.size()-i);
+            node.isLeaf = false;
+            node.box = level[i].box;
+            for(int j=i+1; j<i+node.numChildren; j++) {
+                node.box.unite(level[j].box);
+            }
+            parents.append(node);
+        }
+        level = parents;
+    }
+    m_root = m_nodes.size();
+    m_nodes += level;
+}
+
+
+auto GeoMaps::AirspaceIndex::Box::intersects(double lat0, double lon0, double lat1, double lon1) const -> bool
+{
+    // Liang-Barsky clipping of the segment against the box. The segment is
+    // parametrized as p0 + t*(p1-p0), and [t0, t1] is the part of the segment
+    // within the box.
+    const std::array<double, 4> directions {-(lon1-lon0), lon1-lon0, -(lat1-lat0), lat1-lat0};
+    const std::array<double, 4> distances {lon0-minLon, maxLon-lon0, lat0-minLat, maxLat-lat0};
+    double t0 = 0.0;
+    double t1 = 1.0;
+    for(int i=0; i<4; i++) {
+        if (qFuzzyIsNull(directions[i])) {
+            if (distances[i] < 0.0) {
+                return false;
+            }
+            continue;
+        }
+        auto t = distances[i]/directions[i];
+        if (directions[i] < 0.0) {
+            t0 = qMax(t0, t);
+        } else {
+            t1 = qMin(t1, t);
+        }
+        if (t0 > t1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+auto GeoMaps::AirspaceIndex::candidates(const QGeoCoordinate& start, const QGeoCoordinate& end) const -> QVector<int>
+{
+    QVector<int> result;
+    if ((m_root < 0) || !start.isValid() || !end.isValid()) {
+        return result;
+    }
+
+    auto lat0 = start.latitude();
+    auto lon0 = start.longitude();
+    auto lat1 = end.latitude();
+    auto lon1 = end.longitude();
+
+    // Bounding box of the segment, used to reject boxes cheaply before the
+    // clipping test
+    Box segmentBox {qMin(lat0, lat1), qMin(lon0, lon1), qMax(lat0, lat1), qMax(lon0, lon1)};
+    auto overlaps = [&segmentBox](const Box& box) {
+        return (box.minLat <= segmentBox.maxLat) && (box.maxLat >= segmentBox.minLat) &&
+                (box.minLon <= segmentBox.maxLon) && (box.maxLon >= segmentBox.minLon);
+    };
+
+    QVarLengthArray<int, 64> stack;
+    stack.append(m_root);
+    while(!stack.isEmpty()) {
+        const auto& node = m_nodes[stack.last()];
+        stack.removeLast();
+        if (!overlaps(node.box) || !node.box.intersects(lat0, lon0, lat1, lon1)) {
+            continue;
+        }
+
+        if (node.isLeaf) {
+            for(int i=node.firstChild; i<node.firstChild+node.numChildren; i++) {
+                const auto& box = m_entries[i].box;
+                if (overlaps(box) && box.intersects(lat0, lon0, lat1, lon1)) {
+                    result.append(m_entries[i].airspaceIndex);
+                }
+            }
+        } else {
+            for(int i=node.firstChild; i<node.firstChild+node.numChildren; i++) {
+                stack.append(i);
+            }
+        }
+    }
+
+    return result;
+}
+
+
+auto GeoMaps::AirspaceIndex::candidates(const QGeoCoordinate& position) const -> QVector<int>
+{
+    QVector<int> result;
+    if ((m_root < 0) || !position.isValid()) {
+        return result;
+    }
+
+    auto lat = position.latitude();
+    auto lon = position.longitude();
+
+    QVarLengthArray<int, 64> stack;
+    stack.append(m_root);
+    while(!stack.isEmpty()) {
+        const auto& node = m_nodes[stack.last()];
+        stack.removeLast();
+        if (!node.box.contains(lat, lon)) {
+            continue;
+        }
+
+        if (node.isLeaf) {
+            for(int i=node.firstChild; i<node.firstChild+node.numChildren; i++) {
+                if (m_entries[i].box.contains(lat, lon)) {
+                    result.append(m_entries[i].airspaceIndex);
+                }
+            }
+        } else {
+            for(int i=node.firstChild; i<node.firstChild+node.numChildren; i++) {
+                stack.append(i);
+            }
+        }
+    }
+
+    return result;
+}
+
+
+auto GeoMaps::AirspaceIndex::candidates(const QGeoCoordinate& position, double radiusM, double minAltitudeFtMSL, double maxAltitudeFtMSL) const -> QVector<int>
+{
+    QVector<int> result;
+    if ((m_root < 0) || !position.isValid() || (minAltitudeFtMSL > maxAltitudeFtMSL)) {
+        return result;
+    }
+
+    // Bounding box of the cylinder. One degree of latitude is 60 nautical
+    // miles.
+    auto radiusLat = qMax(0.0, radiusM)/(60.0*1852.0);
+    auto radiusLon = radiusLat/qMax(0.01, qCos(qDegreesToRadians(position.latitude())));
+    Box query;
+    query.minLat = position.latitude()-radiusLat;
+    query.maxLat = position.latitude()+radiusLat;
+    query.minLon = position.longitude()-radiusLon;
+    query.maxLon = position.longitude()+radiusLon;
+    auto overlaps = [&query, minAltitudeFtMSL, maxAltitudeFtMSL](const Box& box) {
+        return (box.minLat <= query.maxLat) && (box.maxLat >= query.minLat) &&
+                (box.minLon <= query.maxLon) && (box.maxLon >= query.minLon) &&
+                (box.minAltFt <= maxAltitudeFtMSL) && (box.maxAltFt >= minAltitudeFtMSL);
+    };
+
+    QVarLengthArray<int, 64> stack;
+    stack.append(m_root);
+    while(!stack.isEmpty()) {
+        const auto& node = m_nodes[stack.last()];
+        stack.removeLast();
+        if (!overlaps(node.box)) {
+            continue;
+        }
+
+        if (node.isLeaf) {
+            for(int i=node.firstChild; i<node.firstChild+node.numChildren; i++) {
+                if (overlaps(m_entries[i].box)) {
+                    result.append(m_entries[i].airspaceIndex);
+                }
+            }
+        } else {
+            for(int i=node.firstChild; i<node.firstChild+node.numChildren; i++) {
+                stack.append(i);
+            }
+        }
+    }
+
+    return result;
+}
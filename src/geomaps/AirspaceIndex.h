@@ -0,0 +1,176 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QGeoCoordinate>
+#include <QVector>
+
+#include "Airspace.h"
+
+
+namespace GeoMaps {
+
+/*! \brief Spatial index for airspaces
+ *
+ * This class implements a static R-tree over the bounding boxes of a list of
+ * airspaces. The tree is constructed once, using sort-tile-recursive packing,
+ * and cannot be modified afterwards. Queries return indices into the list of
+ * airspaces that was used to construct the index. These are candidates only:
+ * the bounding box of every airspace returned contains the query point, but
+ * callers still need to check if the point is contained in the polygon.
+ *
+ * Every entry and every node of the tree also stores a vertical extent, in
+ * feet above MSL. For nodes, this is the union of the vertical extents of the
+ * subtree, so that queries with an altitude interval reject whole subtrees
+ * above or below the interval, just as they reject subtrees to the side.
+ *
+ * Bounding boxes are computed in plain latitude/longitude coordinates.
+ * Airspaces that cross the antimeridian are therefore not handled correctly.
+ * This is not an issue for the maps used in this program.
+ *
+ * This class is reentrant. Const methods can be called from several threads
+ * simultaneously.
+ */
+
+class AirspaceIndex
+{
+public:
+    /*! \brief Constructs an empty index */
+    AirspaceIndex() = default;
+
+    /*! \brief Constructs an index
+     *
+     * @param airspaces List of airspaces to be indexed. Invalid airspaces are
+     * ignored.
+     */
+    explicit AirspaceIndex(const QVector<Airspace>& airspaces);
+
+    /*! \brief Find candidate airspaces at a given position
+     *
+     * @param position Position over which the airspaces are searched for
+     *
+     * @returns Indices of all airspaces whose bounding box contains the
+     * position, in no particular order
+     */
+    QVector<int> candidates(const QGeoCoordinate& position) const;
+
+    /*! \brief Find candidate airspaces along a line segment
+     *
+     * The segment is treated as a straight line in latitude/longitude
+     * coordinates. Subtrees whose bounding box does not meet the segment are
+     * rejected early, by clipping the segment against the box.
+     *
+     * @param start Start point of the segment
+     *
+     * @param end End point of the segment
+     *
+     * @returns Indices of all airspaces whose bounding box meets the segment,
+     * in no particular order
+     */
+    QVector<int> candidates(const QGeoCoordinate& start, const QGeoCoordinate& end) const;
+
+    /*! \brief Find candidate airspaces in a vertical cylinder
+     *
+     * The cylinder is replaced by its bounding box in latitude/longitude
+     * coordinates. The vertical extents of the airspaces in the index are
+     * conservative estimates, computed from
+     * Airspace::estimatedLowerBoundInFtMSL() and
+     * Airspace::estimatedUpperBoundInFtMSL(): upper limits given relative to
+     * the ground, or that cannot be interpreted, such as "UNL", count as
+     * unlimited. Flight levels are compared as if they were altitudes above
+     * MSL, so callers should widen the altitude interval by a margin.
+     *
+     * @param position Center of the cylinder
+     *
+     * @param radiusM Radius of the cylinder, in meters. If zero, the query is
+     * a query for a vertical line.
+     *
+     * @param minAltitudeFtMSL Lower end of the cylinder, in feet above MSL
+     *
+     * @param maxAltitudeFtMSL Upper end of the cylinder, in feet above MSL
+     *
+     * @returns Indices of all airspaces whose bounding box meets the bounding
+     * box of the cylinder, and whose vertical extent meets the altitude
+     * interval, in no particular order
+     */
+    QVector<int> candidates(const QGeoCoordinate& position, double radiusM, double minAltitudeFtMSL, double maxAltitudeFtMSL) const;
+
+private:
+    // Axis-aligned bounding box, in degrees
+    struct Box {
+        double minLat {0.0};
+        double minLon {0.0};
+        double maxLat {0.0};
+        double maxLon {0.0};
+
+        // Vertical extent, in feet above MSL
+        float minAltFt {0.0F};
+        float maxAltFt {0.0F};
+
+        bool contains(double lat, double lon) const
+        {
+            return (lat >= minLat) && (lat <= maxLat) && (lon >= minLon) && (lon <= maxLon);
+        }
+
+        // Checks if the segment from (lat0, lon0) to (lat1, lon1) meets the
+        // box
+        bool intersects(double lat0, double lon0, double lat1, double lon1) const;
+
+        void unite(const Box& other)
+        {
+            minLat = qMin(minLat, other.minLat);
+            minLon = qMin(minLon, other.minLon);
+            maxLat = qMax(maxLat, other.maxLat);
+            maxLon = qMax(maxLon, other.maxLon);
+            minAltFt = qMin(minAltFt, other.minAltFt);
+            maxAltFt = qMax(maxAltFt, other.maxAltFt);
+        }
+    };
+
+    // Node of the R-tree. The children of a node are stored contiguously,
+    // either in m_nodes (for inner nodes) or in m_entries (for leaves).
+    struct Node {
+        Box box;
+        int firstChild {0};
+        int numChildren {0};
+        bool isLeaf {true};
+    };
+
+    // Entry of a leaf: bounding box plus index of the airspace
+    struct Entry {
+        Box box;
+        int airspaceIndex {0};
+    };
+
+    // Maximal number of children per node
+    static constexpr int maxChildren = 16;
+
+    // Sort-tile-recursive packing of a range of boxes. Reorders the range in
+    // place, so that consecutive groups of maxChildren elements are spatially
+    // close.
+    template<typename T> static void strSort(QVector<T>& items);
+
+    QVector<Entry> m_entries;
+    QVector<Node> m_nodes;
+    int m_root {-1};
+};
+
+};
@@ -0,0 +1,326 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include "AviationData.h"
+#include "JSONScanner.h"
+#include "StringPool.h"
+
+
+void GeoMaps::AviationData::buildIndices()
+{
+    featureIndicesByChunk.clear();
+    for(int i=0; i<featureBoundingBoxes.size(); i++) {
+        const auto& box = featureBoundingBoxes[i];
+        auto chunks = chunksCovering(QGeoRectangle(QGeoCoordinate(box.bottom(), box.left()), QGeoCoordinate(box.top(), box.right())));
+        for(int row=chunks.top(); row<=chunks.bottom(); row++) {
+            for(int column=chunks.left(); column<=chunks.right(); column++) {
+                featureIndicesByChunk[row*allChunks().width()+column].append(i);
+            }
+        }
+    }
+
+    airspaceIndex = AirspaceIndex(airspaces);
+    waypointTable = WaypointTable(waypoints);
+    waypointIndex = WaypointIndex(waypointTable);
+    waypointIndicesByType.clear();
+    foreach(auto type, QStringList({"AD", "NAV", "WP"})) {
+        waypointIndicesByType[type] = WaypointIndex(waypointTable, WaypointTable::typeFromString(type));
+    }
+    waypointSearchIndex = WaypointSearchIndex(waypoints);
+    waypointIndicesByICAOCode.clear();
+    for(int i=waypoints.size()-1; i>=0; i--) {
+        // Iterate backwards, so that the first waypoint with a given code wins
+        const auto& wp = waypoints[i];
+        if (wp.isValid() && !wp.ICAOCode().isEmpty()) {
+            waypointIndicesByICAOCode[wp.ICAOCode()] = i;
+        }
+    }
+}
+
+
+auto GeoMaps::AviationData::chunksCovering(const QGeoRectangle& region) -> QRect
+{
+    if (!region.isValid() || (region.topLeft().longitude() > region.bottomRight().longitude())) {
+        return allChunks();
+    }
+
+    // Longitude 180° and latitude 90° belong to the last column and row
+    auto column = [](double longitude) { return qBound(0, static_cast<int>(std::floor((longitude+180.0)/chunkSizeInDegrees)), allChunks().width()-1); };
+    auto row = [](double latitude) { return qBound(0, static_cast<int>(std::floor((latitude+90.0)/chunkSizeInDegrees)), allChunks().height()-1); };
+    return QRect(QPoint(column(region.topLeft().longitude()), row(region.bottomRight().latitude())),
+                 QPoint(column(region.bottomRight().longitude()), row(region.topLeft().latitude()))).intersected(allChunks());
+}
+
+
+void GeoMaps::AviationData::buildSimplifiedFeatures(const QVector<const Airspace*>& featureAirspaces)
+{
+    // Generate the simplified features into one buffer, and remember their
+    // byte ranges. Views into the buffer are taken once it is complete.
+    simplifiedFeatureBuffer.clear();
+    std::array<QVector<QPair<int,int>>, levelsOfDetail-1> ranges;
+    for(int i=0; i<features.size(); i++) {
+        const Airspace* airspace = (i < featureAirspaces.size()) ? featureAirspaces[i] : nullptr;
+        QByteArray feature;
+        QPair<int,int> properties {0, 0};
+        if ((airspace != nullptr) && airspace->isValid()) {
+            feature = QByteArray::fromRawData(features[i].data(), static_cast<int>(features[i].size()));
+            properties = JSONScanner::valueRange(feature, "properties");
+        }
+
+        for(int level=0; level<levelsOfDetail-1; level++) {
+            if (properties.second == 0) {
+                ranges[level].append({-1, 0});
+                continue;
+            }
+            const auto path = airspace->polygon().path();
+            auto simplifiedPath = (level == 0) ? airspace->coarsePath() : Airspace::simplifiedPath(path, simplificationTolerancesInDEG[level]);
+            if ((simplifiedPath.size() < 4) || (simplifiedPath.size() >= path.size())) {
+                ranges[level].append({-1, 0});
+                continue;
+            }
+
+            auto offset = simplifiedFeatureBuffer.size();
+            simplifiedFeatureBuffer += R"({"type":"Feature","properties":)";
+            simplifiedFeatureBuffer.append(feature.constData()+properties.first, properties.second);
+            simplifiedFeatureBuffer += R"(,"geometry":{"type":"Polygon","coordinates":[[)";
+            bool first = true;
+            for(const auto& coordinate : simplifiedPath) {
+                if (!first) {
+                    simplifiedFeatureBuffer += ',';
+                }
+                first = false;
+                simplifiedFeatureBuffer += '[';
+                simplifiedFeatureBuffer += QByteArray::number(coordinate.longitude(), 'f', 6);
+                simplifiedFeatureBuffer += ',';
+                simplifiedFeatureBuffer += QByteArray::number(coordinate.latitude(), 'f', 6);
+                simplifiedFeatureBuffer += ']';
+            }
+            simplifiedFeatureBuffer += "]]}}";
+            ranges[level].append({offset, simplifiedFeatureBuffer.size()-offset});
+        }
+    }
+    simplifiedFeatureBuffer.squeeze();
+
+    for(int level=0; level<levelsOfDetail-1; level++) {
+        auto& list = simplifiedFeatures[level];
+        list.clear();
+        list.reserve(features.size());
+        for(int i=0; i<features.size(); i++) {
+            const auto& range = ranges[level][i];
+            if (range.first < 0) {
+                list.append(features[i]);
+            } else {
+                list.append(std::string_view(simplifiedFeatureBuffer.constData()+range.first, range.second));
+            }
+        }
+    }
+}
+
+
+auto GeoMaps::AviationData::levelOfDetail(double zoomLevel) -> int
+{
+    // Size of one pixel in degrees of longitude, for tiles of 512 pixels
+    auto pixelSizeInDEG = 360.0/(512.0*std::pow(2.0, zoomLevel));
+    for(int level=0; level<levelsOfDetail-1; level++) {
+        if (simplificationTolerancesInDEG[level] <= pixelSizeInDEG) {
+            return level;
+        }
+    }
+    return levelsOfDetail-1;
+}
+
+
+auto GeoMaps::AviationData::geoJSON(const QRect& chunks, int levelOfDetail) const -> QByteArray
+{
+    // Features at the requested level of detail
+    const auto& features = ((levelOfDetail >= 0) && (levelOfDetail < levelsOfDetail-1) && (simplifiedFeatures[levelOfDetail].size() == this->features.size()))
+            ? simplifiedFeatures[levelOfDetail] : this->features;
+
+    // Collect the features of all chunks. Features that meet several chunks
+    // are listed only once, in their original order.
+    QVector<int> indices;
+    if (chunks.contains(allChunks())) {
+        indices.reserve(features.size());
+        for(int i=0; i<features.size(); i++) {
+            indices.append(i);
+        }
+    } else {
+        for(int row=chunks.top(); row<=chunks.bottom(); row++) {
+            for(int column=chunks.left(); column<=chunks.right(); column++) {
+                indices += featureIndicesByChunk.value(row*allChunks().width()+column);
+            }
+        }
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    }
+
+    int size = 0;
+    foreach(auto index, indices) {
+        size += static_cast<int>(features[index].size())+1;
+    }
+    QByteArray result = R"({"type":"FeatureCollection","features":[)";
+    result.reserve(result.size()+size+2);
+    bool first = true;
+    foreach(auto index, indices) {
+        if (!first) {
+            result += ',';
+        }
+        first = false;
+        result.append(features[index].data(), static_cast<int>(features[index].size()));
+    }
+    result += "]}";
+    return result;
+}
+
+
+auto GeoMaps::AviationData::memoryUsage() const -> qint64
+{
+    qint64 result = sizeof(AviationData);
+    result += features.size()*static_cast<qint64>(sizeof(std::string_view));
+    foreach(const auto& buffer, featureBuffers) {
+        result += buffer.size();
+    }
+    result += featureBoundingBoxes.size()*static_cast<qint64>(sizeof(QRectF));
+    result += simplifiedFeatureBuffer.size();
+    for(const auto& list : simplifiedFeatures) {
+        result += list.size()*static_cast<qint64>(sizeof(std::string_view));
+    }
+    foreach(const auto& indices, featureIndicesByChunk) {
+        result += indices.size()*static_cast<qint64>(sizeof(int));
+    }
+    result += waypoints.size()*static_cast<qint64>(sizeof(Waypoint));
+    foreach(const auto& airspace, airspaces) {
+        result += sizeof(Airspace) + (airspace.polygon().size()+airspace.coarsePath().size())*static_cast<qint64>(sizeof(QGeoCoordinate));
+    }
+    result += waypointIndicesByICAOCode.size()*static_cast<qint64>(sizeof(QString)+sizeof(int));
+    return result;
+}
+
+
+auto GeoMaps::AviationMapFragment::memoryUsage() const -> qint64
+{
+    qint64 result = sizeof(AviationMapFragment) + buffer.size();
+    for(const auto& feature : features) {
+        result += sizeof(Feature) + feature.key.size();
+        if (feature.airspace.isValid()) {
+            result += (feature.airspace.polygon().size()+feature.airspace.coarsePath().size())*static_cast<qint64>(sizeof(QGeoCoordinate));
+        }
+    }
+    return result;
+}
+
+
+auto GeoMaps::AviationMapFragment::read(QDataStream &inputStream, const QRectF& region) -> bool
+{
+    inputStream >> fileKey;
+    inputStream >> bounds;
+    inputStream >> buffer;
+
+    qint32 numFeatures = 0;
+    inputStream >> numFeatures;
+    if ((inputStream.status() != QDataStream::Ok) || (numFeatures < 0)) {
+        return false;
+    }
+    features.clear();
+    features.reserve(numFeatures);
+    StringPool pool;
+    for(int i=0; i<numFeatures; i++) {
+        Feature feature;
+        quint8 kind = 0;
+        inputStream >> feature.key;
+        inputStream >> feature.jsonOffset;
+        inputStream >> feature.jsonSize;
+        inputStream >> feature.boundingBox;
+        inputStream >> kind;
+        if (kind == 1) {
+            feature.waypoint = Waypoint(inputStream);
+        }
+        if (kind == 2) {
+            feature.airspace = Airspace(inputStream, &pool);
+        }
+        if ((inputStream.status() != QDataStream::Ok) || (feature.jsonOffset < 0) || (feature.jsonSize < 0)
+                || (feature.jsonOffset > buffer.size()-feature.jsonSize)) {
+            return false;
+        }
+        features.append(feature);
+    }
+
+    if (region.isValid()) {
+        restrictTo(region);
+    }
+    return true;
+}
+
+
+void GeoMaps::AviationMapFragment::restrictTo(const QRectF& region)
+{
+    // Most maps of a large installation lie entirely outside of the region
+    if (!meets(bounds, region)) {
+        features.clear();
+        features.squeeze();
+        buffer.clear();
+        return;
+    }
+
+    QVector<Feature> newFeatures;
+    QByteArray newBuffer;
+    for(const auto& feature : features) {
+        if (!meets(feature.boundingBox, region)) {
+            continue;
+        }
+        newFeatures.append(feature);
+        newFeatures.last().jsonOffset = newBuffer.size();
+        newBuffer.append(buffer.constData()+feature.jsonOffset, feature.jsonSize);
+    }
+    newFeatures.squeeze();
+    newBuffer.squeeze();
+    features = newFeatures;
+    buffer = newBuffer;
+}
+
+
+void GeoMaps::AviationMapFragment::write(QDataStream &out) const
+{
+    out << fileKey;
+    out << bounds;
+    out << buffer;
+
+    out << static_cast<qint32>(features.size());
+    for(const auto& feature : features) {
+        out << feature.key;
+        out << feature.jsonOffset;
+        out << feature.jsonSize;
+        out << feature.boundingBox;
+        if (feature.waypoint.isValid()) {
+            out << static_cast<quint8>(1);
+            feature.waypoint.write(out);
+            continue;
+        }
+        if (feature.airspace.isValid()) {
+            out << static_cast<quint8>(2);
+            feature.airspace.write(out);
+            continue;
+        }
+        out << static_cast<quint8>(0);
+    }
+}
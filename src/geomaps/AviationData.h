@@ -0,0 +1,324 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QGeoRectangle>
+#include <QHash>
+#include <QRect>
+#include <QRectF>
+#include <QString>
+#include <QVector>
+#include <array>
+#include <string_view>
+
+#include "Airspace.h"
+#include "AirspaceIndex.h"
+#include "Waypoint.h"
+#include "WaypointIndex.h"
+#include "WaypointSearchIndex.h"
+#include "WaypointTable.h"
+
+
+namespace GeoMaps {
+
+/*! \brief Parsed content of a single aviation map
+ *
+ * This structure holds all features of a single GeoJSON file, in the order in
+ * which they appear in the file. The GeoMapProvider keeps one fragment per
+ * installed aviation map, so that changes to one map only require to parse
+ * that map again. Settings such as hideUpperAirspaces are applied when the
+ * fragments are merged into an AviationData snapshot.
+ */
+
+struct AviationMapFragment
+{
+    /*! \brief Single feature of a GeoJSON file */
+    struct Feature
+    {
+        /*! \brief Key used to detect features that appear in several maps */
+        QByteArray key;
+
+        /*! \brief Position of the feature object in buffer
+         *
+         * The feature object is stored in compact JSON format, in the bytes
+         * [jsonOffset, jsonOffset+jsonSize) of the buffer.
+         */
+        int jsonOffset {0};
+
+        /*! \brief Size of the feature object in buffer, in bytes */
+        int jsonSize {0};
+
+        /*! \brief Bounding box of the feature geometry
+         *
+         * The x coordinate is the longitude, the y coordinate the latitude,
+         * both in degrees.
+         */
+        QRectF boundingBox;
+
+        /*! \brief Waypoint described by the feature, if any */
+        Waypoint waypoint;
+
+        /*! \brief Airspace described by the feature, if any */
+        Airspace airspace;
+    };
+
+    /*! \brief Reads data from a data stream
+     *
+     * @param inputStream Data stream
+     *
+     * @param region If valid, only the features in this region are kept, as
+     * with restrictTo()
+     *
+     * @returns True on success
+     */
+    bool read(QDataStream &inputStream, const QRectF& region = QRectF());
+
+    /*! \brief Removes all features outside of a region
+     *
+     * This method removes all features whose bounding box does not meet the
+     * region, and compacts the buffer. The members fileKey and bounds are
+     * left untouched.
+     *
+     * @param region Region, in the coordinates used for bounding boxes
+     */
+    void restrictTo(const QRectF& region);
+
+    /*! \brief Checks if a bounding box meets a region
+     *
+     * Unlike QRectF::intersects(), this method also works for boxes of zero
+     * width or height, such as the bounding boxes of waypoints.
+     *
+     * @param box Bounding box, as in Feature
+     *
+     * @param region Region, in the same coordinates
+     *
+     * @returns True if box and region have a point in common
+     */
+    static bool meets(const QRectF& box, const QRectF& region)
+    {
+        return (box.left() <= region.right()) && (box.right() >= region.left()) &&
+               (box.top() <= region.bottom()) && (box.bottom() >= region.top());
+    }
+
+    /*! \brief Writes data to a data stream
+     *
+     * @param out Data stream
+     */
+    void write(QDataStream &out) const;
+
+    /*! \brief Estimated memory usage
+     *
+     * @returns Estimated size of the features in memory, in bytes
+     */
+    qint64 memoryUsage() const;
+
+    /*! \brief Size and modification time of the file at the time of parsing */
+    QString fileKey;
+
+    /*! \brief Union of the bounding boxes of all features of the file
+     *
+     * The bounds are computed when the file is parsed. They remain valid if
+     * the features are later restricted to a region.
+     */
+    QRectF bounds;
+
+    /*! \brief Features of the file */
+    QVector<Feature> features;
+
+    /*! \brief Feature objects of the file, in compact JSON format
+     *
+     * The JSON of all features is stored in one buffer, in the order of
+     * features. Compared to one QByteArray per feature, this replaces tens of
+     * thousands of small allocations by a single large one, so constructing
+     * and freeing a fragment is cheap and does not fragment the heap. The
+     * buffer is never modified once the fragment is complete, so that the
+     * AviationData snapshots can share it.
+     */
+    QByteArray buffer;
+};
+
+
+/*! \brief Snapshot of the aviation data
+ *
+ * This structure holds all aviation data known to the GeoMapProvider, together
+ * with the indices used to access these data. Instances are generated by
+ * GeoMapProvider::fillAviationDataCache() and published as
+ * std::shared_ptr<const AviationData>. Once published, a snapshot is never
+ * modified. Readers in any thread can therefore keep a pointer to a snapshot
+ * and access it without locking, for as long as they need it.
+ *
+ * The indices refer to the positions of the airspaces and waypoints in the
+ * lists of the same snapshot.
+ */
+
+struct AviationData
+{
+    /*! \brief Computes all indices
+     *
+     * This method computes the indices from the lists of waypoints and
+     * airspaces. It must be called whenever these lists change.
+     */
+    void buildIndices();
+
+    /*! \brief Size of the chunks used by geoJSON(), in degrees */
+    static constexpr int chunkSizeInDegrees = 2;
+
+    /*! \brief Rectangle of all chunks
+     *
+     * Chunks are numbered by column and row. Column 0 starts at longitude
+     * -180°, row 0 starts at latitude -90°.
+     */
+    static constexpr QRect allChunks() { return {0, 0, 360/chunkSizeInDegrees, 180/chunkSizeInDegrees}; }
+
+    /*! \brief Chunks that intersect a region
+     *
+     * @param region Region on the earth's surface
+     *
+     * @returns Rectangle of chunks that intersect the region, or allChunks()
+     * if the region is invalid or crosses the date line.
+     */
+    static QRect chunksCovering(const QGeoRectangle& region);
+
+    /*! \brief Number of levels of detail used by geoJSON()
+     *
+     * Level 0 is the coarsest. The highest level, levelsOfDetail-1, contains
+     * the features at full resolution.
+     */
+    static constexpr int levelsOfDetail = 3;
+
+    /*! \brief Tolerances used to simplify airspace boundaries, in degrees
+     *
+     * The entries correspond to the levels of detail below the highest. The
+     * coarsest level uses Airspace::coarseToleranceInDEG, so that the coarse
+     * paths of the airspaces can be reused.
+     */
+    static constexpr std::array<double, levelsOfDetail-1> simplificationTolerancesInDEG {Airspace::coarseToleranceInDEG, 0.0005};
+
+    /*! \brief Level of detail suitable for a zoom level of the map
+     *
+     * The level is chosen such that simplification removes details of at
+     * most one pixel on screen, assuming tiles of 512 pixels.
+     *
+     * @param zoomLevel Zoom level of the map
+     *
+     * @returns Level of detail, between 0 and levelsOfDetail-1
+     */
+    static int levelOfDetail(double zoomLevel);
+
+    /*! \brief Features of all aviation maps near a region, in GeoJSON format
+     *
+     * This method generates a GeoJSON document that contains those features
+     * whose bounding box meets one of the given chunks. The features appear
+     * in the same order as in the union of all aviation maps.
+     *
+     * @param chunks Rectangle of chunks
+     *
+     * @param levelOfDetail Level of detail. Below the highest level, the
+     * boundaries of the airspaces are simplified.
+     *
+     * @returns GeoJSON document
+     */
+    QByteArray geoJSON(const QRect& chunks, int levelOfDetail = levelsOfDetail-1) const;
+
+    /*! \brief Computes simplifiedFeatures
+     *
+     * For every airspace feature, this method generates one GeoJSON feature
+     * with simplified boundary for every level of detail below the highest.
+     * The properties of the feature are copied verbatim. Other features, and
+     * airspaces where simplification removes no point, are not copied. This
+     * method must be called whenever the list of features changes.
+     *
+     * @param featureAirspaces List with the same indices as features. The
+     * entries point to the airspaces described by the features, or are
+     * nullptr for features that do not describe airspaces.
+     */
+    void buildSimplifiedFeatures(const QVector<const Airspace*>& featureAirspaces);
+
+    /*! \brief Estimated memory usage
+     *
+     * The estimate counts the features, waypoints and airspaces, together
+     * with the entries of the indices. The internal structure of the indices
+     * is not counted.
+     *
+     * @returns Estimated size of the snapshot in memory, in bytes
+     */
+    qint64 memoryUsage() const;
+
+    /*! \brief Features of all aviation maps, in compact JSON format
+     *
+     * The features point into the buffers of the AviationMapFragment
+     * instances that the snapshot was merged from. The snapshot holds a
+     * shallow copy of these buffers in featureBuffers, so that the features
+     * remain valid for the lifetime of the snapshot.
+     */
+    QVector<std::string_view> features;
+
+    /*! \brief Buffers that hold the data of features */
+    QVector<QByteArray> featureBuffers;
+
+    /*! \brief Features with simplified airspace boundaries, by level of detail
+     *
+     * The lists have the same indices as features. Entries that are not
+     * simplified refer to the original data in featureBuffers. Simplified
+     * entries refer to simplifiedFeatureBuffer.
+     */
+    std::array<QVector<std::string_view>, levelsOfDetail-1> simplifiedFeatures;
+
+    /*! \brief Buffer that holds the data of simplified features */
+    QByteArray simplifiedFeatureBuffer;
+
+    /*! \brief Bounding boxes of the features, as in AviationMapFragment::Feature */
+    QVector<QRectF> featureBoundingBoxes;
+
+    /*! \brief Indices of features, by chunk
+     *
+     * The key is computed as row*allChunks().width()+column.
+     */
+    QHash<int, QVector<int>> featureIndicesByChunk;
+
+    /*! \brief List of all waypoints, sorted by name */
+    QVector<Waypoint> waypoints;
+
+    /*! \brief Columnar table of all waypoints, with the same indices as waypoints */
+    WaypointTable waypointTable;
+
+    /*! \brief List of all airspaces */
+    QVector<Airspace> airspaces;
+
+    /*! \brief Spatial index for airspaces */
+    AirspaceIndex airspaceIndex;
+
+    /*! \brief Spatial index for all valid waypoints */
+    WaypointIndex waypointIndex;
+
+    /*! \brief Spatial indices for waypoints, by waypoint type */
+    QHash<QString, WaypointIndex> waypointIndicesByType;
+
+    /*! \brief Full-text search index for waypoints */
+    WaypointSearchIndex waypointSearchIndex;
+
+    /*! \brief Indices of waypoints, by ICAO code */
+    QHash<QString, int> waypointIndicesByICAOCode;
+};
+
+};
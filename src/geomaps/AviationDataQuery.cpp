@@ -0,0 +1,186 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include "AviationDataQuery.h"
+#include "Metrics.h"
+#include "navigation/Geodesy.h"
+
+
+GeoMaps::AviationDataQuery::AviationDataQuery(std::shared_ptr<const AviationData> data)
+    : m_data(std::move(data))
+{
+    if (m_data == nullptr) {
+        m_data = std::make_shared<const AviationData>();
+    }
+}
+
+
+auto GeoMaps::AviationDataQuery::airspaces(const QGeoCoordinate& position) const -> QVector<Airspace>
+{
+    Metrics::Timer timer(Metrics::AirspaceQuery);
+
+    // Use the spatial index to find candidates, then check polygons
+    QVector<Airspace> result;
+    result.reserve(10);
+    foreach(auto index, m_data->airspaceIndex.candidates(position)) {
+        const auto& airspace = m_data->airspaces[index];
+        if (airspace.contains(position)) {
+            result.append(airspace);
+        }
+    }
+
+    // Sort airspaces according to lower boundary
+    std::sort(result.begin(), result.end(), [](const Airspace& a, const Airspace& b) {return (a.estimatedLowerBoundInFtMSL() > b.estimatedLowerBoundInFtMSL()); });
+    return result;
+}
+
+
+auto GeoMaps::AviationDataQuery::airspaces(const QGeoCoordinate& position, double radiusM, double minAltitudeFtMSL, double maxAltitudeFtMSL) const -> QVector<Airspace>
+{
+    Metrics::Timer timer(Metrics::AirspaceQuery);
+
+    // Use the spatial index to find candidates, then check polygons
+    QVector<Airspace> result;
+    foreach(auto index, m_data->airspaceIndex.candidates(position, radiusM, minAltitudeFtMSL, maxAltitudeFtMSL)) {
+        const auto& airspace = m_data->airspaces[index];
+        if (airspace.meetsCircle(position, radiusM)) {
+            result.append(airspace);
+        }
+    }
+
+    // Sort airspaces according to lower boundary
+    std::sort(result.begin(), result.end(), [](const Airspace& a, const Airspace& b) {return (a.estimatedLowerBoundInFtMSL() > b.estimatedLowerBoundInFtMSL()); });
+    return result;
+}
+
+
+auto GeoMaps::AviationDataQuery::airspaceIndicesAlong(const QGeoCoordinate& start, const QGeoCoordinate& end) const -> QVector<int>
+{
+    // Use the spatial index to find candidates, then check polygons
+    QVector<QPair<double,int>> hits;
+    foreach(auto index, m_data->airspaceIndex.candidates(start, end)) {
+        auto fraction = m_data->airspaces[index].entryFractionAlong(start, end);
+        if (fraction >= 0.0) {
+            hits.append({fraction, index});
+        }
+    }
+
+    // Sort airspaces in the order in which they are met
+    std::sort(hits.begin(), hits.end());
+    QVector<int> result;
+    result.reserve(hits.size());
+    for(const auto& hit : hits) {
+        result.append(hit.second);
+    }
+    return result;
+}
+
+
+auto GeoMaps::AviationDataQuery::closestWaypoint(QGeoCoordinate position, const QGeoCoordinate& distPosition, const QVector<Waypoint>& additionalWaypoints) const -> Waypoint
+{
+    position.setAltitude(qQNaN());
+
+    Waypoint result;
+    auto indices = m_data->waypointIndex.nearest(position, 1);
+    if (!indices.isEmpty()) {
+        result = m_data->waypoints[indices[0]];
+    }
+    auto resultDistance = position.distanceTo(result.coordinate());
+
+    QVector<Waypoint> midFieldWaypoints;
+    QVector<QGeoCoordinate> midFieldCoordinates;
+    for(const auto& wp : additionalWaypoints) {
+        if (!wp.isValid() || (wp.category() != "WP")) {
+            continue;
+        }
+        midFieldWaypoints.append(wp);
+        midFieldCoordinates.append(wp.coordinate());
+    }
+    auto distances = Navigation::Geodesy::distances(position, Navigation::Geodesy::Points(midFieldCoordinates));
+    for(int i=0; i<distances.size(); i++) {
+        if (!result.isValid() || (distances[i] < resultDistance)) {
+            result = midFieldWaypoints[i];
+            resultDistance = distances[i];
+        }
+    }
+
+    if (resultDistance > position.distanceTo(distPosition)) {
+        return Waypoint(position);
+    }
+
+    return result;
+}
+
+
+auto GeoMaps::AviationDataQuery::snapToWaypoints(const QVector<QGeoCoordinate>& positions, double snapRadiusM) const -> QVector<Waypoint>
+{
+    QVector<Waypoint> result;
+    result.reserve(positions.size());
+    foreach(auto position, positions) {
+        position.setAltitude(qQNaN());
+        auto indices = m_data->waypointIndex.nearest(position, 1);
+        if (!indices.isEmpty()) {
+            const auto& waypoint = m_data->waypoints[indices[0]];
+            if (position.distanceTo(waypoint.coordinate()) <= snapRadiusM) {
+                result.append(waypoint);
+                continue;
+            }
+        }
+        result.append(Waypoint(position));
+    }
+    return result;
+}
+
+
+auto GeoMaps::AviationDataQuery::findByID(const QString& id) const -> Waypoint
+{
+    auto index = m_data->waypointIndicesByICAOCode.value(id, -1);
+    if (index < 0) {
+        return {};
+    }
+    return m_data->waypoints[index];
+}
+
+
+auto GeoMaps::AviationDataQuery::findByIDs(const QStringList& ids) const -> QVector<Waypoint>
+{
+    QVector<Waypoint> result;
+    result.reserve(ids.size());
+    foreach(auto id, ids) {
+        result.append(findByID(id));
+    }
+    return result;
+}
+
+
+auto GeoMaps::AviationDataQuery::nearbyWaypoints(const QGeoCoordinate& position, const QString& type, int count) const -> QVector<Waypoint>
+{
+    QVector<Waypoint> result;
+    auto iterator = m_data->waypointIndicesByType.constFind(type);
+    if (iterator == m_data->waypointIndicesByType.constEnd()) {
+        return result;
+    }
+    foreach(auto index, iterator->nearest(position, count)) {
+        result.append(m_data->waypoints[index]);
+    }
+    return result;
+}
@@ -0,0 +1,179 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QGeoCoordinate>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+
+#include "AviationData.h"
+
+
+namespace GeoMaps {
+
+/*! \brief Read-only queries on a snapshot of the aviation data
+ *
+ * This class answers the typical questions about the aviation data, such as
+ * "which airspaces lie over this point" or "which waypoint has this ICAO
+ * code", using the indices of one AviationData snapshot. It holds a pointer to
+ * the snapshot, which is never modified, and does not access any other
+ * object. All methods are const and thread-safe, so that instances can be
+ * constructed and used in any thread, without locking and without round-trips
+ * to the GUI thread. Instances are cheap to copy.
+ *
+ * A query object keeps answering from the snapshot it was constructed with,
+ * even after the GeoMapProvider has published newer data. Long-running
+ * consumers should therefore obtain a new object from
+ * GeoMapProvider::aviationDataQuery() from time to time.
+ */
+
+class AviationDataQuery
+{
+public:
+    /*! \brief Constructs a query object for a snapshot
+     *
+     * @param data Snapshot of the aviation data. If this is nullptr, the
+     * queries work on an empty snapshot.
+     */
+    explicit AviationDataQuery(std::shared_ptr<const AviationData> data);
+
+    /*! \brief Snapshot used by this object
+     *
+     * @returns Pointer to the snapshot. The pointer is guaranteed to be valid.
+     */
+    const std::shared_ptr<const AviationData>& data() const
+    {
+        return m_data;
+    }
+
+    /*! \brief Airspaces at a given location
+     *
+     * @param position Position over which airspaces are searched for
+     *
+     * @returns All airspaces that exist over the position, sorted by
+     * decreasing lower boundary
+     */
+    QVector<Airspace> airspaces(const QGeoCoordinate& position) const;
+
+    /*! \brief Airspaces that meet a vertical cylinder
+     *
+     * This method is meant to be evaluated on every position fix, to find the
+     * airspaces that the own aircraft is in or about to enter at its present
+     * altitude. The spatial index rejects airspaces that lie to the side of,
+     * above or below the cylinder before any polygon is tested.
+     *
+     * @param position Center of the cylinder
+     *
+     * @param radiusM Radius of the cylinder, in meters
+     *
+     * @param minAltitudeFtMSL Lower end of the cylinder, in feet above MSL
+     *
+     * @param maxAltitudeFtMSL Upper end of the cylinder, in feet above MSL
+     *
+     * @returns All airspaces whose lateral limits meet the cylinder and whose
+     * estimated vertical limits meet the altitude interval, sorted by
+     * decreasing lower boundary
+     *
+     * @see AirspaceIndex::candidates, Airspace::meetsCircle
+     */
+    QVector<Airspace> airspaces(const QGeoCoordinate& position, double radiusM, double minAltitudeFtMSL, double maxAltitudeFtMSL) const;
+
+    /*! \brief Indices of the airspaces along a line segment
+     *
+     * @param start Start point of the segment
+     *
+     * @param end End point of the segment
+     *
+     * @returns Indices into data()->airspaces of the airspaces met by the
+     * segment, in the order in which they are met
+     *
+     * @see Airspace::entryFractionAlong
+     */
+    QVector<int> airspaceIndicesAlong(const QGeoCoordinate& start, const QGeoCoordinate& end) const;
+
+    /*! \brief Find closest waypoint to a given position
+     *
+     * @param position Position near which waypoints are searched for. The
+     * altitude is ignored.
+     *
+     * @param distPosition Reference position
+     *
+     * @param additionalWaypoints Waypoints that are considered in addition to
+     * the waypoints of the snapshot, such as the waypoints of the current
+     * flight route. Only valid waypoints of category "WP" are considered.
+     *
+     * @returns The Waypoint that is closest to the given position, provided
+     * that the distance is not bigger than that to distPosition. If no
+     * sufficiently close waypoint is found, a generic Waypoint with the
+     * appropriate coordinate is returned.
+     */
+    Waypoint closestWaypoint(QGeoCoordinate position, const QGeoCoordinate& distPosition, const QVector<Waypoint>& additionalWaypoints = {}) const;
+
+    /*! \brief Snap positions to known waypoints
+     *
+     * @param positions Positions that are to be snapped
+     *
+     * @param snapRadiusM Maximal distance between a position and the waypoint
+     * it is snapped to, in meters
+     *
+     * @returns List with one entry for every position: the closest known
+     * waypoint if it lies within snapRadiusM, and a generic Waypoint with the
+     * appropriate coordinate otherwise
+     */
+    QVector<Waypoint> snapToWaypoints(const QVector<QGeoCoordinate>& positions, double snapRadiusM) const;
+
+    /*! \brief Find a waypoint by its ICAO code
+     *
+     * @param id ICAO code of the waypoint, such as "EDDF" for Frankfurt
+     *
+     * @returns The waypoint, or an invalid waypoint if none has been found
+     */
+    Waypoint findByID(const QString& id) const;
+
+    /*! \brief Find waypoints by their ICAO codes
+     *
+     * @param ids List of ICAO codes
+     *
+     * @returns List of waypoints, of the same length as ids. The list contains
+     * invalid waypoints for those codes where no waypoint has been found.
+     */
+    QVector<Waypoint> findByIDs(const QStringList& ids) const;
+
+    /*! \brief Nearby waypoints of a given type
+     *
+     * @param position Position near which waypoints are searched for
+     *
+     * @param type Type of waypoints (AD, NAV, WP)
+     *
+     * @param count Maximal number of waypoints
+     *
+     * @returns The waypoints of requested type that are closest to the
+     * position, sorted by distance. The list may be empty or contain fewer
+     * than count items.
+     */
+    QVector<Waypoint> nearbyWaypoints(const QGeoCoordinate& position, const QString& type, int count) const;
+
+private:
+    std::shared_ptr<const AviationData> m_data;
+};
+
+};
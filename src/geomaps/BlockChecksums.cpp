@@ -0,0 +1,208 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QLockFile>
+
+#include "BlockChecksums.h"
+
+
+GeoMaps::BlockChecksums::BlockChecksums(const QByteArray& data)
+{
+    QDataStream inputStream(data);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint64 fileSize = 0;
+    quint32 blockSize = 0;
+    inputStream >> magic;
+    inputStream >> version;
+    inputStream >> fileSize;
+    inputStream >> blockSize;
+    if ((inputStream.status() != QDataStream::Ok) || (magic != 0x454E4243) || (version != 1) || (blockSize == 0)) {
+        return;
+    }
+
+    // Check that the data contains all block checksums, before allocating
+    // memory for them
+    auto numBlocks = (fileSize+blockSize-1)/blockSize;
+    if (static_cast<quint64>(data.size()) != 20+32+12*numBlocks) {
+        return;
+    }
+    QByteArray fileHash(32, 0);
+    inputStream.readRawData(fileHash.data(), 32);
+    QVector<quint32> weakChecksums;
+    QVector<QByteArray> strongChecksums;
+    weakChecksums.reserve(static_cast<int>(numBlocks));
+    strongChecksums.reserve(static_cast<int>(numBlocks));
+    for(quint64 i=0; i<numBlocks; i++) {
+        quint32 weak = 0;
+        QByteArray strong(8, 0);
+        inputStream >> weak;
+        inputStream.readRawData(strong.data(), 8);
+        weakChecksums.append(weak);
+        strongChecksums.append(strong);
+    }
+    if (inputStream.status() != QDataStream::Ok) {
+        return;
+    }
+
+    m_fileSize = static_cast<qint64>(fileSize);
+    m_blockSize = static_cast<int>(blockSize);
+    m_fileHash = fileHash;
+    m_weakChecksums = weakChecksums;
+    m_strongChecksums = strongChecksums;
+}
+
+
+auto GeoMaps::BlockChecksums::assemble(const QString& oldFileName, const QString& newFileName, QVector<QPair<qint64,qint64>>& missingRanges) const -> bool
+{
+    missingRanges.clear();
+    if (!isValid()) {
+        return false;
+    }
+
+    // Map the old file into memory, honoring the lock file
+    QLockFile lockFile(oldFileName+".lock");
+    lockFile.lock();
+    QFile oldFile(oldFileName);
+    if (!oldFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const auto size = oldFile.size();
+    uchar* data = (size > 0) ? oldFile.map(0, size) : nullptr;
+    if ((size > 0) && (data == nullptr)) {
+        return false;
+    }
+
+    // Content of the old file at a given position, padded with zeros
+    const qint64 blockSize = m_blockSize;
+    auto byteAt = [data, size](qint64 position) -> quint32 { return (position < size) ? data[position] : 0; };
+    auto window = [data, size, blockSize](qint64 position) {
+        if (position+blockSize <= size) {
+            return QByteArray::fromRawData(reinterpret_cast<const char*>(data+position), static_cast<int>(blockSize));
+        }
+        QByteArray result(reinterpret_cast<const char*>(data+position), static_cast<int>(size-position));
+        result.append(static_cast<int>(blockSize-result.size()), 0);
+        return result;
+    };
+
+    // Find blocks of the new file in the old file. Every position of the old
+    // file is checked, with the help of the rolling checksum. After a match,
+    // the search continues behind the matching block.
+    QHash<quint32, QVector<int>> blocksByWeakChecksum;
+    for(int i=0; i<m_weakChecksums.size(); i++) {
+        blocksByWeakChecksum[m_weakChecksums[i]].append(i);
+    }
+    QVector<qint64> oldPositions(m_weakChecksums.size(), -1);
+    qint64 position = 0;
+    quint32 a = 0;
+    quint32 b = 0;
+    auto startWindow = [&]() {
+        a = 0;
+        b = 0;
+        for(qint64 i=0; i<blockSize; i++) {
+            a += byteAt(position+i);
+            b += static_cast<quint32>(blockSize-i)*byteAt(position+i);
+        }
+    };
+    startWindow();
+    while (position < size) {
+        bool matched = false;
+        auto iterator = blocksByWeakChecksum.constFind((a & 0xFFFF) | (b << 16));
+        if (iterator != blocksByWeakChecksum.constEnd()) {
+            auto strong = strongChecksum(window(position));
+            foreach(auto index, iterator.value()) {
+                if (m_strongChecksums[index] == strong) {
+                    if (oldPositions[index] < 0) {
+                        oldPositions[index] = position;
+                    }
+                    matched = true;
+                }
+            }
+        }
+        if (matched) {
+            position += blockSize;
+            startWindow();
+            continue;
+        }
+
+        auto outgoing = byteAt(position);
+        auto incoming = byteAt(position+blockSize);
+        a = a - outgoing + incoming;
+        b = b - static_cast<quint32>(blockSize)*outgoing + a;
+        position++;
+    }
+
+    // Write all blocks found to the new file
+    QFile newFile(newFileName);
+    if (!newFile.open(QIODevice::WriteOnly) || !newFile.resize(m_fileSize)) {
+        return false;
+    }
+    for(int i=0; i<oldPositions.size(); i++) {
+        if (oldPositions[i] < 0) {
+            continue;
+        }
+        auto start = i*blockSize;
+        newFile.seek(start);
+        if (newFile.write(window(oldPositions[i]).left(static_cast<int>(qMin(blockSize, m_fileSize-start)))) < 0) {
+            return false;
+        }
+    }
+    oldFile.unmap(data);
+
+    // List missing ranges, merging ranges that are separated by small gaps
+    int gap = minGapInBlocks;
+    for(int i=0; i<oldPositions.size(); i++) {
+        if (oldPositions[i] >= 0) {
+            gap++;
+            continue;
+        }
+        auto first = i*blockSize;
+        auto last = qMin((i+1)*blockSize, m_fileSize)-1;
+        if (!missingRanges.isEmpty() && (gap < minGapInBlocks)) {
+            missingRanges.last().second = last;
+        } else {
+            missingRanges.append({first, last});
+        }
+        gap = 0;
+    }
+    return true;
+}
+
+
+auto GeoMaps::BlockChecksums::verify(const QString& fileName) const -> bool
+{
+    QFile file(fileName);
+    if (!isValid() || !file.open(QIODevice::ReadOnly) || (file.size() != m_fileSize)) {
+        return false;
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    return hash.addData(&file) && (hash.result() == m_fileHash);
+}
+
+
+auto GeoMaps::BlockChecksums::strongChecksum(const QByteArray& block) -> QByteArray
+{
+    return QCryptographicHash::hash(block, QCryptographicHash::Md5).left(8);
+}
@@ -0,0 +1,132 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+
+namespace GeoMaps {
+
+/*! \brief Block checksums of a remote file, for delta updates
+ *
+ * This class holds the block checksums of a file on the server, in the spirit
+ * of zsync. Given an older version of the file, it finds those blocks of the
+ * new file that already exist somewhere in the old file, so that only the
+ * remaining blocks need to be downloaded.
+ *
+ * The server publishes the checksums in a binary file. All numbers are
+ * unsigned and big-endian.
+ *
+ * - Magic number 0x454E4243 ("ENBC"), 32 bit
+ * - Format version, presently 1, 32 bit
+ * - Size of the file in bytes, 64 bit
+ * - Block size in bytes, 32 bit
+ * - SHA-256 hash of the file, 32 bytes
+ * - For every block of the file, in order: the weak checksum (32 bit) and the
+ *   first 8 bytes of the MD5 hash of the block. The last block is padded with
+ *   zeros to the full block size.
+ *
+ * The weak checksum of a block x_0, …, x_{L-1} is a + 2^16·b, where a is the sum
+ * of all x_i and b is the sum of all (L-i)·x_i, both modulo 2^16. This is the
+ * rolling checksum used by rsync and zsync.
+ */
+
+class BlockChecksums
+{
+public:
+    /*! \brief Constructs an invalid object */
+    BlockChecksums() = default;
+
+    /*! \brief Reads block checksums
+     *
+     * @param data Content of a block checksum file, as described above. If the
+     * data cannot be read, an invalid object is constructed.
+     */
+    explicit BlockChecksums(const QByteArray& data);
+
+    /*! \brief Validity
+     *
+     * @returns True if the object holds block checksums
+     */
+    bool isValid() const
+    {
+        return m_blockSize > 0;
+    }
+
+    /*! \brief Size of the remote file
+     *
+     * @returns Size of the remote file in bytes
+     */
+    qint64 fileSize() const
+    {
+        return m_fileSize;
+    }
+
+    /*! \brief Assembles the new file from the blocks of an older version
+     *
+     * This method searches the old file for blocks of the new file. It writes
+     * a file of size fileSize() that contains all blocks found at their proper
+     * places, and lists the ranges of the new file that still need to be
+     * downloaded. This method is reentrant and meant to run in a separate
+     * thread. It may take a few seconds for large files.
+     *
+     * @param oldFileName Name of the older version of the file
+     *
+     * @param newFileName Name of the file to be written
+     *
+     * @param missingRanges List of byte ranges that are missing in the new
+     * file, as pairs of first and last byte. Ranges that are separated by only
+     * a few blocks are merged, in order to keep the number of requests small.
+     *
+     * @returns True on success, false if one of the files could not be
+     * accessed
+     */
+    bool assemble(const QString& oldFileName, const QString& newFileName, QVector<QPair<qint64,qint64>>& missingRanges) const;
+
+    /*! \brief Checks if a file agrees with the remote file
+     *
+     * This method is reentrant and meant to run in a separate thread.
+     *
+     * @param fileName Name of a file
+     *
+     * @returns True if size and SHA-256 hash of the file agree with those of
+     * the remote file
+     */
+    bool verify(const QString& fileName) const;
+
+private:
+    // Strong checksum of a block, as described above
+    static QByteArray strongChecksum(const QByteArray& block);
+
+    // Ranges that are separated by fewer blocks than this are merged
+    static constexpr int minGapInBlocks = 8;
+
+    qint64 m_fileSize {0};
+    int m_blockSize {0};
+    QByteArray m_fileHash;
+    QVector<quint32> m_weakChecksums;
+    QVector<QByteArray> m_strongChecksums;
+};
+
+};
@@ -0,0 +1,230 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QtConcurrent/QtConcurrent>
+#include <utility>
+
+#include "DeltaDownload.h"
+#include "Global.h"
+
+
+GeoMaps::DeltaDownload::DeltaDownload(QUrl url, QUrl blockChecksumsURL, QString oldFileName, QString newFileName, QObject *parent)
+    : QObject(parent),
+      m_url(std::move(url)),
+      m_blockChecksumsURL(std::move(blockChecksumsURL)),
+      m_oldFileName(std::move(oldFileName)),
+      m_newFileName(std::move(newFileName))
+{
+    connect(&m_assembleWatcher, &QFutureWatcher<std::optional<QVector<QPair<qint64,qint64>>>>::finished, this, &DeltaDownload::assembleFinished);
+    connect(&m_verifyWatcher, &QFutureWatcher<bool>::finished, this, &DeltaDownload::verifyFinished);
+}
+
+
+GeoMaps::DeltaDownload::~DeltaDownload()
+{
+    delete m_reply;
+    m_assembleWatcher.waitForFinished();
+    m_verifyWatcher.waitForFinished();
+}
+
+
+void GeoMaps::DeltaDownload::start()
+{
+    m_reply = Global::networkAccessManager()->get(Global::networkRequest(m_blockChecksumsURL));
+    connect(m_reply, &QNetworkReply::finished, this, &DeltaDownload::blockChecksumsFinished);
+}
+
+
+void GeoMaps::DeltaDownload::blockChecksumsFinished()
+{
+    if (m_reply.isNull() || (m_reply->error() != QNetworkReply::NoError)) {
+        end(false);
+        return;
+    }
+    m_blockChecksums = BlockChecksums(m_reply->readAll());
+    m_reply->deleteLater();
+    m_reply = nullptr;
+    if (!m_blockChecksums.isValid()) {
+        end(false);
+        return;
+    }
+
+    auto blockChecksums = m_blockChecksums;
+    auto oldFileName = m_oldFileName;
+    auto newFileName = m_newFileName;
+    m_assembleWatcher.setFuture(QtConcurrent::run([blockChecksums, oldFileName, newFileName]() -> std::optional<QVector<QPair<qint64,qint64>>> {
+        QVector<QPair<qint64,qint64>> missingRanges;
+        if (!blockChecksums.assemble(oldFileName, newFileName, missingRanges)) {
+            return {};
+        }
+        return missingRanges;
+    }));
+}
+
+
+void GeoMaps::DeltaDownload::assembleFinished()
+{
+    auto result = m_assembleWatcher.result();
+    if (!result.has_value()) {
+        end(false);
+        return;
+    }
+    m_missingRanges = result.value();
+
+    // Give up if most of the file is missing. A full, compressed download is
+    // then cheaper than many range requests.
+    qint64 bytesMissing = 0;
+    for(const auto& range : qAsConst(m_missingRanges)) {
+        bytesMissing += range.second-range.first+1;
+    }
+    if (bytesMissing > maxMissingFraction*m_blockChecksums.fileSize()) {
+        end(false);
+        return;
+    }
+    m_bytesAvailable = m_blockChecksums.fileSize()-bytesMissing;
+    updateProgress();
+
+    m_newFile.setFileName(m_newFileName);
+    if (!m_newFile.open(QIODevice::ReadWrite)) {
+        end(false);
+        return;
+    }
+    downloadNextRange();
+}
+
+
+void GeoMaps::DeltaDownload::downloadNextRange()
+{
+    // If all ranges have been downloaded, check the new file
+    if (m_missingRanges.isEmpty()) {
+        m_newFile.close();
+        auto blockChecksums = m_blockChecksums;
+        auto newFileName = m_newFileName;
+        m_verifyWatcher.setFuture(QtConcurrent::run([blockChecksums, newFileName]() { return blockChecksums.verify(newFileName); }));
+        return;
+    }
+
+    const auto& range = m_missingRanges.first();
+    m_writePosition = range.first;
+    auto request = Global::networkRequest(m_url);
+    request.setRawHeader("Range", "bytes=" + QByteArray::number(range.first) + "-" + QByteArray::number(range.second));
+    request.setRawHeader("Accept-Encoding", "identity");
+    m_reply = Global::networkAccessManager()->get(request);
+    connect(m_reply, &QNetworkReply::metaDataChanged, this, &DeltaDownload::rangeMetaDataReceived);
+    connect(m_reply, &QNetworkReply::readyRead, this, &DeltaDownload::rangeDataReceived);
+    connect(m_reply, &QNetworkReply::finished, this, &DeltaDownload::rangeFinished);
+}
+
+
+void GeoMaps::DeltaDownload::rangeMetaDataReceived()
+{
+    if (m_reply.isNull() || m_missingRanges.isEmpty()) {
+        return;
+    }
+
+    // The server must send exactly the range requested, as in "bytes
+    // 1000-1999/2000"
+    auto statusCode = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    auto contentRange = m_reply->rawHeader("Content-Range");
+    auto expected = "bytes " + QByteArray::number(m_missingRanges.first().first) + "-" + QByteArray::number(m_missingRanges.first().second) + "/";
+    if ((statusCode != 206) || !contentRange.startsWith(expected)) {
+        end(false);
+    }
+}
+
+
+void GeoMaps::DeltaDownload::rangeDataReceived()
+{
+    if (m_reply.isNull() || m_missingRanges.isEmpty()) {
+        return;
+    }
+
+    auto data = m_reply->readAll();
+    if (m_writePosition+data.size() > m_missingRanges.first().second+1) {
+        end(false);
+        return;
+    }
+    m_newFile.seek(m_writePosition);
+    if (m_newFile.write(data) != data.size()) {
+        end(false);
+        return;
+    }
+    m_writePosition += data.size();
+    m_bytesAvailable += data.size();
+    emit dataReceived(data.size());
+    updateProgress();
+}
+
+
+void GeoMaps::DeltaDownload::rangeFinished()
+{
+    if (m_reply.isNull() || (m_reply->error() != QNetworkReply::NoError)) {
+        end(false);
+        return;
+    }
+    rangeDataReceived();
+    if (m_ended) {
+        return;
+    }
+    if (m_writePosition != m_missingRanges.first().second+1) {
+        end(false);
+        return;
+    }
+    m_reply->deleteLater();
+    m_reply = nullptr;
+    m_missingRanges.removeFirst();
+    downloadNextRange();
+}
+
+
+void GeoMaps::DeltaDownload::verifyFinished()
+{
+    end(m_verifyWatcher.result());
+}
+
+
+void GeoMaps::DeltaDownload::updateProgress()
+{
+    auto fileSize = m_blockChecksums.fileSize();
+    auto progress = (fileSize > 0) ? qBound(0, qRound((100.0*m_bytesAvailable)/fileSize), 100) : 0;
+    if (progress == m_downloadProgress) {
+        return;
+    }
+    m_downloadProgress = progress;
+    emit downloadProgressChanged(m_downloadProgress);
+}
+
+
+void GeoMaps::DeltaDownload::end(bool success)
+{
+    if (m_ended) {
+        return;
+    }
+    m_ended = true;
+
+    if (!m_reply.isNull()) {
+        disconnect(m_reply, nullptr, this, nullptr);
+        m_reply->abort();
+        m_reply->deleteLater();
+        m_reply = nullptr;
+    }
+    m_newFile.close();
+    emit finished(success);
+}
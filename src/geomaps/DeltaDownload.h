@@ -0,0 +1,156 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QFile>
+#include <QFutureWatcher>
+#include <QNetworkReply>
+#include <QPointer>
+#include <optional>
+
+#include "BlockChecksums.h"
+
+
+namespace GeoMaps {
+
+/*! \brief Delta update of a downloaded file
+ *
+ * This class updates a file that has been downloaded earlier, by downloading
+ * only those parts of the remote file that are not found in the old version.
+ * It works as follows.
+ *
+ * -# The block checksums of the remote file are downloaded, see
+ *    BlockChecksums for the format.
+ *
+ * -# The old file is searched for blocks of the new file, in a separate
+ *    thread. The blocks found are written to the new file.
+ *
+ * -# The missing ranges are downloaded from the remote file with HTTP range
+ *    requests, one after the other, and written to the new file.
+ *
+ * -# The new file is checked against the SHA-256 hash of the remote file, in
+ *    a separate thread.
+ *
+ * If any of these steps fails, or if most of the file would have to be
+ * downloaded anyway, the signal finished() reports failure and the caller is
+ * expected to download the whole file instead. This class does not touch the
+ * old file.
+ */
+
+class DeltaDownload : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*! \brief Standard constructor
+     *
+     * @param url URL of the remote file
+     *
+     * @param blockChecksumsURL URL of the block checksums of the remote file
+     *
+     * @param oldFileName Name of the older version of the file
+     *
+     * @param newFileName Name of the file where the new version is written
+     *
+     * @param parent The standard QObject parent pointer
+     */
+    explicit DeltaDownload(QUrl url, QUrl blockChecksumsURL, QString oldFileName, QString newFileName, QObject *parent = nullptr);
+
+    /*! \brief Standard destructor
+     *
+     * This destructor stops all downloads and waits for the threads to
+     * finish. The new file might be left incomplete.
+     */
+    ~DeltaDownload() override;
+
+    /*! \brief Starts the update
+     *
+     * The update runs asynchronously and ends with the signal finished().
+     */
+    void start();
+
+signals:
+    /*! \brief Progress of the update
+     *
+     * @param percentage Percentage of the new file that is available, between 0
+     * and 100
+     */
+    void downloadProgressChanged(int percentage);
+
+    /*! \brief Data of the remote file has been received
+     *
+     * @param bytes Number of bytes received
+     */
+    void dataReceived(qint64 bytes);
+
+    /*! \brief The update has ended
+     *
+     * This signal is emitted exactly once.
+     *
+     * @param success True if the new file agrees with the remote file
+     */
+    void finished(bool success);
+
+private:
+    Q_DISABLE_COPY_MOVE(DeltaDownload)
+
+    // Handlers for the steps described above
+    void blockChecksumsFinished();
+    void assembleFinished();
+    void downloadNextRange();
+    void rangeMetaDataReceived();
+    void rangeDataReceived();
+    void rangeFinished();
+    void verifyFinished();
+
+    // Emits the appropriate signal, if the percentage has changed
+    void updateProgress();
+
+    // Stops running downloads and emits finished(success)
+    void end(bool success);
+
+    // Fraction of the file that may be missing, before the delta update is
+    // given up in favour of a full download
+    static constexpr double maxMissingFraction = 0.5;
+
+    QUrl m_url;
+    QUrl m_blockChecksumsURL;
+    QString m_oldFileName;
+    QString m_newFileName;
+
+    BlockChecksums m_blockChecksums;
+    QPointer<QNetworkReply> m_reply;
+    QFutureWatcher<std::optional<QVector<QPair<qint64,qint64>>>> m_assembleWatcher;
+    QFutureWatcher<bool> m_verifyWatcher;
+
+    // Ranges that still need to be downloaded, the new file and the position
+    // where the next data of the current range is written
+    QVector<QPair<qint64,qint64>> m_missingRanges;
+    QFile m_newFile;
+    qint64 m_writePosition {0};
+
+    // Number of bytes of the new file that are available
+    qint64 m_bytesAvailable {0};
+    int m_downloadProgress {0};
+    bool m_ended {false};
+};
+
+};
@@ -18,13 +18,16 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QDataStream>
 #include <QDir>
 #include <QFileInfo>
 #include <QLocale>
 #include <QLockFile>
 #include <utility>
 
+#include "DeltaDownload.h"
 #include "Downloadable.h"
+#include "FileWriter.h"
 #include "Global.h"
 
 GeoMaps::Downloadable::Downloadable(QUrl url, const QString &fileName, QObject *parent)
@@ -35,6 +38,10 @@ GeoMaps::Downloadable::Downloadable(QUrl url, const QString &fileName, QObject *
     QFileInfo info(fileName);
     _fileName = info.absoluteFilePath();
 
+    // The cache of infoText must be cleared before any other slot connected to
+    // infoTextChanged() reads the property. This connection is therefore made
+    // first.
+    connect(this, &Downloadable::infoTextChanged, this, [this]() { _infoText = QString(); });
     connect(this, &Downloadable::remoteFileDateChanged, this, &Downloadable::infoTextChanged);
     connect(this, &Downloadable::remoteFileSizeChanged, this, &Downloadable::infoTextChanged);
     connect(this, &Downloadable::hasFileChanged, this, &Downloadable::infoTextChanged);
@@ -45,14 +52,23 @@ GeoMaps::Downloadable::Downloadable(QUrl url, const QString &fileName, QObject *
 
 
 GeoMaps::Downloadable::~Downloadable() {
-    // Free all ressources
+    // Free all ressources. The partial file is kept, so that the download can
+    // be resumed later.
     delete _networkReplyDownloadFile;
     delete _networkReplyDownloadHeader;
-    delete _saveFile;
+    stopWriter();
 }
 
 
 auto GeoMaps::Downloadable::infoText() const -> QString {
+    if (_infoText.isNull()) {
+        _infoText = infoTextUncached();
+    }
+    return _infoText;
+}
+
+
+auto GeoMaps::Downloadable::infoTextUncached() const -> QString {
     if (downloading()) {
         return tr("downloading … %1% complete").arg(_downloadProgress);
     }
@@ -147,6 +163,16 @@ void GeoMaps::Downloadable::setRemoteFileSize(qint64 size) {
 }
 
 
+void GeoMaps::Downloadable::setBlockChecksumsURL(const QUrl& url) {
+    _blockChecksumsURL = url;
+}
+
+
+void GeoMaps::Downloadable::setRemoteFileHash(const QByteArray& hash) {
+    _remoteFileHash = hash;
+}
+
+
 void GeoMaps::Downloadable::setSection(const QString& sectionName)
 {
     if (sectionName == _section) {
@@ -183,7 +209,9 @@ void GeoMaps::Downloadable::deleteFile() {
     QLockFile lockFile(_fileName + ".lock");
     lockFile.lock();
     QFile::remove(_fileName);
+    QFile::remove(fileInfoName());
     lockFile.unlock();
+    deletePartialFile();
     emit hasFileChanged();
     emit fileContentChanged();
 
@@ -202,7 +230,7 @@ void GeoMaps::Downloadable::startInfoDownload() {
     }
 
     // Start the download process for the remote file info
-    _networkReplyDownloadHeader = Global::networkAccessManager()->head(QNetworkRequest(_url));
+    _networkReplyDownloadHeader = Global::networkAccessManager()->head(Global::networkRequest(_url));
     connect(_networkReplyDownloadHeader, &QNetworkReply::finished, this,
             &Downloadable::downloadHeaderFinished);
 
@@ -221,30 +249,20 @@ void GeoMaps::Downloadable::startFileDownload() {
     auto oldDownloadProgress =_downloadProgress;
     auto oldIsDownloading = downloading();
 
-    // Clear temporary file
-    delete _saveFile;
-
     // Create directory that will hold the local file, if it does not yet exist
     QDir dir(QFileInfo(_fileName).dir());
     if (!dir.exists()) {
         dir.mkpath(".");
     }
 
-    // Copy the temporary file to the local file
-    _saveFile = new QSaveFile(_fileName, this);
-    _saveFile->open(QIODevice::WriteOnly);
-
-    // Start download
-    QNetworkRequest request(_url);
-    _networkReplyDownloadFile = Global::networkAccessManager()->get(request);
-    connect(_networkReplyDownloadFile, &QNetworkReply::finished, this, &Downloadable::downloadFileFinished);
-    connect(_networkReplyDownloadFile, &QNetworkReply::readyRead, this, &Downloadable::downloadFilePartialDataReceiver);
-    connect(_networkReplyDownloadFile, &QNetworkReply::downloadProgress, this, &Downloadable::downloadFileProgressReceiver);
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
-    connect(_networkReplyDownloadFile, &QNetworkReply::errorOccurred, this, &Downloadable::downloadFileErrorReceiver);
-#else
-    connect(_networkReplyDownloadFile, static_cast<void (QNetworkReply::*)(QNetworkReply::NetworkError)>(&QNetworkReply::error), this, &Downloadable::downloadFileErrorReceiver);
-#endif
+    // If an older version of the file exists and the server provides block
+    // checksums, download only the parts of the file that have changed.
+    // Otherwise, download the whole file.
+    if (hasFile() && _blockChecksumsURL.isValid() && !partialFileDate().isValid()) {
+        startDeltaDownload();
+    } else {
+        startFullFileDownload();
+    }
     _downloadProgress = 0;
 
     // Emit signals as appropriate
@@ -260,7 +278,83 @@ void GeoMaps::Downloadable::startFileDownload() {
 }
 
 
+void GeoMaps::Downloadable::startDeltaDownload() {
+    deletePartialFile();
+    _deltaDownload = new DeltaDownload(_url, _blockChecksumsURL, _fileName, partialFileName(), this);
+    connect(_deltaDownload, &DeltaDownload::downloadProgressChanged, this, [this](int percentage) {
+        _downloadProgress = percentage;
+        emit downloadProgressChanged(_downloadProgress);
+    });
+    connect(_deltaDownload, &DeltaDownload::dataReceived, this, [this](qint64 bytes) { _bytesDownloaded += bytes; });
+    connect(_deltaDownload, &DeltaDownload::finished, this, &Downloadable::deltaDownloadFinished);
+    _deltaDownload->start();
+}
+
+
+void GeoMaps::Downloadable::startFullFileDownload() {
+    // Clear temporary file
+    stopWriter();
+
+    // Open the partial file. If it holds data of the current remote file,
+    // resume the download from there. Otherwise, start from scratch.
+    auto request = Global::networkRequest(_url);
+    _resumeOffset = 0;
+    auto date = partialFileDate();
+    auto partialFileSize = QFileInfo(partialFileName()).size();
+    if (date.isValid() && (partialFileSize > 0) &&
+            (!_remoteFileDate.isValid() || (_remoteFileDate == date)) &&
+            ((_remoteFileSize < 0) || (partialFileSize < _remoteFileSize))) {
+        _resumeOffset = partialFileSize;
+
+        // Ranges refer to the encoded content, so compression cannot be used
+        // when resuming. The If-Range header makes the server send the whole
+        // file if it has changed since the partial file was written.
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(_resumeOffset) + "-");
+        request.setRawHeader("If-Range", QLocale::c().toString(date.toUTC(), QStringLiteral("ddd, dd MMM yyyy hh:mm:ss 'GMT'")).toLatin1());
+        request.setRawHeader("Accept-Encoding", "identity");
+    } else {
+        deletePartialFile();
+
+        // If a local file exists and the server has sent validators with it,
+        // ask the server to send the file only if it has changed. Otherwise,
+        // the server answers with "304 Not Modified", see
+        // downloadFileFinished(). The modification time of the local file is
+        // not used, because it records when the file was written here, not
+        // when it changed on the server.
+        if (hasFile()) {
+            auto validators = fileValidators();
+            if (!validators.first.isEmpty()) {
+                request.setRawHeader("If-None-Match", validators.first);
+            }
+            if (!validators.second.isEmpty()) {
+                request.setRawHeader("If-Modified-Since", validators.second);
+            }
+        }
+    }
+    startWriter();
+
+    // Start download. The read buffer of the reply is limited, so that the
+    // download pauses if data arrives faster than it can be written.
+    _networkReplyDownloadFile = Global::networkAccessManager()->get(request);
+    _networkReplyDownloadFile->setReadBufferSize(readBufferSize);
+    connect(_networkReplyDownloadFile, &QNetworkReply::finished, this, &Downloadable::downloadFileFinished);
+    connect(_networkReplyDownloadFile, &QNetworkReply::metaDataChanged, this, &Downloadable::downloadFileMetaDataReceiver);
+    connect(_networkReplyDownloadFile, &QNetworkReply::readyRead, this, &Downloadable::downloadFilePartialDataReceiver);
+    connect(_networkReplyDownloadFile, &QNetworkReply::downloadProgress, this, &Downloadable::downloadFileProgressReceiver);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    connect(_networkReplyDownloadFile, &QNetworkReply::errorOccurred, this, &Downloadable::downloadFileErrorReceiver);
+#else
+    connect(_networkReplyDownloadFile, static_cast<void (QNetworkReply::*)(QNetworkReply::NetworkError)>(&QNetworkReply::error), this, &Downloadable::downloadFileErrorReceiver);
+#endif
+}
+
+
 void GeoMaps::Downloadable::stopFileDownload() {
+    endFileDownload(false);
+}
+
+
+void GeoMaps::Downloadable::endFileDownload(bool keepPartialFile) {
 
     // Do stop a new download if none is already running
     if (!downloading()) {
@@ -271,9 +365,15 @@ void GeoMaps::Downloadable::stopFileDownload() {
     bool oldUpdatable = updatable();
 
     // Stop the download
-    _networkReplyDownloadFile->deleteLater();
-    _networkReplyDownloadFile = nullptr;
-    delete _saveFile;
+    if (!_networkReplyDownloadFile.isNull()) {
+        _networkReplyDownloadFile->deleteLater();
+        _networkReplyDownloadFile = nullptr;
+    }
+    delete _deltaDownload;
+    stopWriter();
+    if (!keepPartialFile) {
+        deletePartialFile();
+    }
 
     // Emit signals as appropriate
     if (oldUpdatable != updatable()) {
@@ -291,8 +391,10 @@ void GeoMaps::Downloadable::downloadFileErrorReceiver(QNetworkReply::NetworkErro
         return;
     }
 
-    // Stop the download
-    stopFileDownload();
+    // Stop the download. If the connection failed, keep the data received so
+    // far, so that the next download can resume. Errors reported by the
+    // server, such as an unsatisfiable range, discard the data.
+    endFileDownload(code < QNetworkReply::ContentAccessDenied);
 
     // Come up with a message…
     QString message;
@@ -459,17 +561,67 @@ void GeoMaps::Downloadable::downloadFileErrorReceiver(QNetworkReply::NetworkErro
 void GeoMaps::Downloadable::downloadFileFinished() {
     // Paranoid safety checks
     //  Q_ASSERT(!_networkReplyDownloadFile.isNull() && !_tmpFile.isNull());
-    if (_networkReplyDownloadFile.isNull() || _saveFile.isNull()) {
+    if (_networkReplyDownloadFile.isNull() || _writer.isNull()) {
         stopFileDownload();
         return;
     }
     if (_networkReplyDownloadFile->error() != QNetworkReply::NoError) {
-        stopFileDownload();
+        endFileDownload(true);
         return;
     }
 
-    // Read the last remaining bits of data, then close the temporary file
+    // The local file is still current
+    if (_networkReplyDownloadFile->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304) {
+        endFileDownload(false);
+        emit fileContentConfirmed();
+        return;
+    }
+
+    // Hand the last remaining bits of data over to the writer. The file is
+    // installed once all data has been written, see fileDataWritten().
     downloadFilePartialDataReceiver();
+    if ((_bytesPendingWrite == 0) && (_networkReplyDownloadFile->bytesAvailable() == 0)) {
+        installPartialFile();
+    }
+}
+
+
+void GeoMaps::Downloadable::deltaDownloadFinished(bool success) {
+    // Paranoid safety checks
+    if (_deltaDownload.isNull()) {
+        return;
+    }
+
+    // If the delta update failed, download the whole file instead. The
+    // DeltaDownload cannot be deleted immediately, because it is currently
+    // emitting a signal.
+    if (!success) {
+        _deltaDownload->deleteLater();
+        _deltaDownload = nullptr;
+        startFullFileDownload();
+        return;
+    }
+    installPartialFile();
+}
+
+
+void GeoMaps::Downloadable::installPartialFile() {
+    // Close the partial file. If the writer failed, or if the hash of the
+    // data does not agree with the hash of the remote file, reject the file
+    // before anything else happens. Delta updates are verified by the
+    // DeltaDownload.
+    bool writerFailed = false;
+    auto hash = stopWriter(&writerFailed);
+    if (writerFailed) {
+        endFileDownload(false);
+        emit error(objectName(), tr("the downloaded data could not be written to the device"));
+        return;
+    }
+    if (_deltaDownload.isNull() && !_remoteFileHash.isEmpty() && (hash != _remoteFileHash)) {
+        endFileDownload(false);
+        emit error(objectName(), tr("the downloaded file is corrupt"));
+        return;
+    }
 
     // Download is now finished to 100%
     if (_downloadProgress != 100) {
@@ -481,18 +633,52 @@ void GeoMaps::Downloadable::downloadFileFinished() {
     bool oldIsUpdatable = updatable();
     bool oldHasLocalFile = hasFile();
 
-    // Copy the temporary file to the local file
+    // Move the temporary file into place. The old local file is kept as a
+    // backup until the new file is in place, and restored if that fails, so
+    // that the user never loses the installed file.
     emit aboutToChangeFile(_fileName);
     QLockFile lockFile(_fileName + ".lock");
     lockFile.lock();
-    _saveFile->commit();
+    auto backupFileName = _fileName + ".bak";
+    QFile::remove(backupFileName);
+    auto hadLocalFile = QFile::exists(_fileName);
+    auto success = !hadLocalFile || QFile::rename(_fileName, backupFileName);
+    if (success) {
+        success = QFile::rename(partialFileName(), _fileName);
+        if (!success && hadLocalFile) {
+            QFile::rename(backupFileName, _fileName);
+        }
+    }
+    if (success) {
+        QFile::remove(backupFileName);
+
+        // Delta updates do not come with validators of the complete file
+        if (!_networkReplyDownloadFile.isNull()) {
+            writeFileInfo(_networkReplyDownloadFile->rawHeader("ETag"), _networkReplyDownloadFile->rawHeader("Last-Modified"));
+        } else {
+            writeFileInfo({}, {});
+        }
+    }
     lockFile.unlock();
+    if (!success) {
+        // The partial file is complete and verified, so it is kept. A later
+        // download can install it without downloading the data again.
+        endFileDownload(true);
+        emit error(objectName(), tr("the downloaded file could not be installed"));
+        return;
+    }
+    deletePartialFile();
     emit fileContentChanged();
 
     // Delete the data structures for the download
-    delete _saveFile;
-    _networkReplyDownloadFile->deleteLater();
-    _networkReplyDownloadFile = nullptr;
+    if (!_networkReplyDownloadFile.isNull()) {
+        _networkReplyDownloadFile->deleteLater();
+        _networkReplyDownloadFile = nullptr;
+    }
+    if (!_deltaDownload.isNull()) {
+        _deltaDownload->deleteLater();
+        _deltaDownload = nullptr;
+    }
 
     // Emit signals as appropriate
     if (oldIsUpdatable != updatable()) {
@@ -508,6 +694,12 @@ void GeoMaps::Downloadable::downloadFileFinished() {
 void GeoMaps::Downloadable::downloadFileProgressReceiver(qint64 bytesReceived, qint64 bytesTotal) {
     auto oldDownloadProgress = _downloadProgress;
 
+    // When resuming, the reply only counts the bytes of the missing range
+    bytesReceived += _resumeOffset;
+    if (bytesTotal >= 0) {
+        bytesTotal += _resumeOffset;
+    }
+
     // If the content is compressed, then Qt does not know the total size and will set 'bytesTotal' to -1. In that case, the number _remoteFileSize might be a better estimate.
     if ((bytesTotal < 0) && (_remoteFileSize > 0)) {
         bytesTotal = _remoteFileSize;
@@ -529,7 +721,7 @@ void GeoMaps::Downloadable::downloadFileProgressReceiver(qint64 bytesReceived, q
 
 void GeoMaps::Downloadable::downloadFilePartialDataReceiver() {
     // Paranoid safety checks
-    if (_networkReplyDownloadFile.isNull() || _saveFile.isNull()) {
+    if (_networkReplyDownloadFile.isNull() || _writer.isNull()) {
         stopFileDownload();
         return;
     }
@@ -537,8 +729,196 @@ void GeoMaps::Downloadable::downloadFilePartialDataReceiver() {
         return;
     }
 
-    // Write all available data to the temporary file
-    _saveFile->write(_networkReplyDownloadFile->readAll());
+    // Hand the data over to the writer in blocks, as long as not too much data
+    // is waiting to be written. The rest stays in the reply until the writer
+    // has caught up.
+    FileWriter* writer = _writer;
+    while ((_bytesPendingWrite < maxBytesPendingWrite) && (_networkReplyDownloadFile->bytesAvailable() > 0)) {
+        auto data = _networkReplyDownloadFile->read(writeBlockSize);
+        _bytesDownloaded += data.size();
+        _bytesPendingWrite += data.size();
+        QMetaObject::invokeMethod(writer, [writer, data]() { writer->write(data); }, Qt::QueuedConnection);
+    }
+}
+
+
+void GeoMaps::Downloadable::fileDataWritten(qint64 bytes) {
+    _bytesPendingWrite -= bytes;
+    if (_networkReplyDownloadFile.isNull()) {
+        return;
+    }
+
+    // Continue with the data that has arrived in the meantime. If the
+    // download is complete and all data has been written, install the file.
+    downloadFilePartialDataReceiver();
+    if (_networkReplyDownloadFile.isNull()) {
+        return;
+    }
+    if (_networkReplyDownloadFile->isFinished() && (_networkReplyDownloadFile->error() == QNetworkReply::NoError) &&
+            (_bytesPendingWrite == 0) && (_networkReplyDownloadFile->bytesAvailable() == 0)) {
+        installPartialFile();
+    }
+}
+
+
+void GeoMaps::Downloadable::startWriter() {
+    stopWriter();
+
+    _writerThread = new QThread(this);
+    _writer = new FileWriter(partialFileName(), !_remoteFileHash.isEmpty());
+    _writer->moveToThread(_writerThread);
+    connect(_writerThread, &QThread::finished, _writer, &QObject::deleteLater);
+
+    // Signals of an earlier writer might still be queued; they are ignored
+    FileWriter* writer = _writer;
+    connect(writer, &FileWriter::written, this, [this, writer](qint64 bytes) {
+        if (writer == _writer) {
+            fileDataWritten(bytes);
+        }
+    });
+    connect(writer, &FileWriter::failed, this, [this, writer]() {
+        if (writer == _writer) {
+            stopFileDownload();
+            emit error(objectName(), tr("the downloaded data could not be written to the device"));
+        }
+    });
+    _writerThread->start();
+    QMetaObject::invokeMethod(writer, &FileWriter::open, Qt::QueuedConnection);
+}
+
+
+auto GeoMaps::Downloadable::stopWriter(bool* failed) -> QByteArray {
+    if (failed != nullptr) {
+        *failed = false;
+    }
+    if (_writerThread.isNull()) {
+        return {};
+    }
+
+    // Closing the file waits until all data queued before has been written
+    QByteArray hash;
+    if (!_writer.isNull()) {
+        FileWriter* writer = _writer;
+        QMetaObject::invokeMethod(writer, [writer]() { writer->close(); }, Qt::BlockingQueuedConnection);
+        hash = writer->hash();
+        if (failed != nullptr) {
+            *failed = writer->hasFailed();
+        }
+    }
+    _writerThread->quit();
+    _writerThread->wait();
+    delete _writerThread;
+    _bytesPendingWrite = 0;
+    return hash;
+}
+
+
+void GeoMaps::Downloadable::downloadFileMetaDataReceiver() {
+    // Paranoid safety checks
+    if (_networkReplyDownloadFile.isNull() || _writer.isNull()) {
+        return;
+    }
+    auto statusCode = _networkReplyDownloadFile->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    // The server sends the requested range, as in "bytes 1000-1999/2000". If
+    // the range does not start where the partial file ends, restart from
+    // scratch.
+    if ((_resumeOffset > 0) && (statusCode == 206)) {
+        auto contentRange = _networkReplyDownloadFile->rawHeader("Content-Range");
+        auto start = contentRange.mid(6, contentRange.indexOf('-')-6).trimmed();
+        if (!contentRange.startsWith("bytes ") || (start.toLongLong() != _resumeOffset)) {
+            stopFileDownload();
+            startFileDownload();
+        }
+        return;
+    }
+
+    // The server sends the whole file. This happens if the server does not
+    // support ranges, or if the file has changed.
+    if (statusCode == 200) {
+        FileWriter* writer = _writer;
+        QMetaObject::invokeMethod(writer, &FileWriter::truncate, Qt::QueuedConnection);
+        _resumeOffset = 0;
+        writePartialFileInfo(_networkReplyDownloadFile->header(QNetworkRequest::LastModifiedHeader).toDateTime());
+    }
+}
+
+
+auto GeoMaps::Downloadable::partialFileDate() const -> QDateTime {
+    QFile file(partialFileInfoName());
+    if (!QFile::exists(partialFileName()) || !file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    QDataStream inputStream(&file);
+    inputStream.setVersion(QDataStream::Qt_5_15);
+    QUrl url;
+    QDateTime date;
+    inputStream >> url;
+    inputStream >> date;
+    if ((inputStream.status() != QDataStream::Ok) || (url != _url)) {
+        return {};
+    }
+    return date;
+}
+
+
+void GeoMaps::Downloadable::writePartialFileInfo(const QDateTime& date) const {
+    QFile file(partialFileInfoName());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << _url;
+    out << date;
+}
+
+
+void GeoMaps::Downloadable::deletePartialFile() const {
+    QFile::remove(partialFileName());
+    QFile::remove(partialFileInfoName());
+}
+
+
+auto GeoMaps::Downloadable::fileValidators() const -> QPair<QByteArray, QByteArray> {
+    QFile file(fileInfoName());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    QDataStream inputStream(&file);
+    inputStream.setVersion(QDataStream::Qt_5_15);
+    QUrl url;
+    QByteArray eTag;
+    QByteArray lastModified;
+    inputStream >> url;
+    inputStream >> eTag;
+    inputStream >> lastModified;
+    if ((inputStream.status() != QDataStream::Ok) || (url != _url)) {
+        return {};
+    }
+    return {eTag, lastModified};
+}
+
+
+void GeoMaps::Downloadable::writeFileInfo(const QByteArray& eTag, const QByteArray& lastModified) const {
+    if (eTag.isEmpty() && lastModified.isEmpty()) {
+        QFile::remove(fileInfoName());
+        return;
+    }
+
+    QFile file(fileInfoName());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << _url;
+    out << eTag;
+    out << lastModified;
 }
 
 
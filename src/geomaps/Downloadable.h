@@ -24,12 +24,16 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QNetworkReply>
+#include <QPair>
 #include <QPointer>
-#include <QSaveFile>
+#include <QThread>
 
 
 namespace GeoMaps {
 
+class DeltaDownload;
+class FileWriter;
+
 /*! \brief Base class for all downloadable objects
 
   This class represents a downloadable item, such as an aviation map file.  The
@@ -43,6 +47,15 @@ namespace GeoMaps {
   The URL and the name of the local file are given in the constructor and cannot
   be changed. See the description of the method startFileDownload() to see how
   downloads work.
+
+  Downloads that fail, for instance because the connection drops, leave the
+  data received so far in the file fileName()+".part". The next download
+  resumes from there, using an HTTP range request, as long as the file on the
+  server has not changed in the meantime.
+
+  If the server provides block checksums for the file, see
+  setBlockChecksumsURL(), updates of a downloaded file only retrieve those
+  parts of the file that have changed.
 */
 
 class Downloadable : public QObject {
@@ -76,8 +89,9 @@ public:
 
     /*! \brief Standard destructor
      *
-     * This destructor will stop all running downloads and delete all temporary
-     * files.  It will not delete the local file.
+     * This destructor will stop all running downloads. It will not delete the
+     * local file, and keeps partially downloaded data so that the download can
+     * be resumed later.
      */
     ~Downloadable() override;
 
@@ -93,7 +107,16 @@ public:
      *
      * @returns Property downloading
      */
-    bool downloading() const { return !_networkReplyDownloadFile.isNull(); }
+    bool downloading() const { return !_networkReplyDownloadFile.isNull() || !_deltaDownload.isNull(); }
+
+    /*! \brief Number of bytes received from the network
+     *
+     * This is the total number of bytes of file data that this Downloadable has
+     * received since construction, meant for throughput statistics.
+     *
+     * @returns Number of bytes received
+     */
+    qint64 bytesDownloaded() const { return _bytesDownloaded; }
 
     /*! \brief Download progress
      *
@@ -202,6 +225,28 @@ public:
      */
     void setRemoteFileSize(qint64 size);
 
+    /*! \brief Set URL of the block checksums of the remote file
+     *
+     * If this URL is valid and an older version of the file has been
+     * downloaded, startFileDownload() tries a delta update first, using the
+     * block checksums found at this URL. See BlockChecksums for the format.
+     *
+     * @param url URL of the block checksums, or an invalid URL if the server
+     * does not provide block checksums
+     */
+    void setBlockChecksumsURL(const QUrl& url);
+
+    /*! \brief Set SHA-256 hash of the remote file
+     *
+     * If a hash is set, the hash of the downloaded data is computed while the
+     * data is written. Files whose hash does not agree are rejected before
+     * they replace the local file, and the signal error() is emitted.
+     *
+     * @param hash SHA-256 hash of the remote file, or an empty array if the
+     * hash is not known
+     */
+    void setRemoteFileHash(const QByteArray& hash);
+
     /*! \brief Headline name for the Downloadable
      *
      * This property is a convenience storing one string along with the
@@ -269,11 +314,19 @@ public slots:
      * already in progress, nothing will happen.  Otherwise, the following will
      * take place.
      *
-     * -# Data is retrieved from the remote server and stored in temporary
-     *    file. The signal downloadProgress() will be emitted regularly.
+     * -# If an older version of the file exists and block checksums are
+     *    available, only the changed parts of the file are retrieved, see
+     *    DeltaDownload. If this fails, the whole file is downloaded as
+     *    described below.
+     *
+     * -# Data is retrieved from the remote server and stored in the temporary
+     *    file fileName()+".part". If that file holds data of an earlier,
+     *    failed download of the same remote file, then only the missing data
+     *    is retrieved. The signal downloadProgress() will be emitted
+     *    regularly; the progress includes the data of the earlier download.
      *
      * -# In case of an error, the signal error() is emitted and the download
-     *    stops.
+     *    stops. The data received so far is kept.
      *
      * -# Optionally, the download can be stopped using the method
      *    stopFileDownload().
@@ -313,7 +366,8 @@ public slots:
     /*! \brief Stops download process
      *
      * This method stops the currenly running download process gracefully and
-     * deletes any partially downloaded data. No signal will be emitted.  If no
+     * deletes any partially downloaded data, so that the next download starts
+     * from scratch. No signal will be emitted.  If no
      * download is in progress, nothing will happen.
      */
     void stopFileDownload();
@@ -373,6 +427,15 @@ signals:
      */
     void fileContentChanged();
 
+    /*! \brief Indicates that the local file is current
+     *
+     * This signal is emitted if a download started with startFileDownload()
+     * ends because the server reports that the remote file has not changed
+     * since the local file was written. The local file is not touched in
+     * this case, and the signal fileContentChanged() is not emitted.
+     */
+    void fileContentConfirmed();
+
     /*! \brief Notifier signal for the properties remoteFileDate and remoteFileSize
      *
      * This signal is emitted once one of the property remoteFileDate changes,
@@ -417,11 +480,24 @@ private slots:
     void downloadFileProgressReceiver(qint64 bytesReceived, qint64 bytesTotal);
 
     // Called during the download of the remote file, this method reads all the
-    // data that has been downloaded so far and stores it in the QTemporaryFile
-    // _tmpFile.  Connected to &QNetworkReply::readyRead of
+    // data that has been downloaded so far and hands it over to the writer of
+    // the partial file.  Connected to &QNetworkReply::readyRead of
     // _networkReplyDownload.
     void downloadFilePartialDataReceiver();
 
+    // Called when the headers of the reply to the file download have arrived,
+    // this method checks whether the server honours a range request. If the
+    // server sends the whole file instead, the partial file is emptied. If the
+    // server sends an unexpected range, the download is restarted from
+    // scratch. Connected to &QNetworkReply::metaDataChanged of
+    // _networkReplyDownload.
+    void downloadFileMetaDataReceiver();
+
+    // Called once a delta update of the file has ended. On success, this
+    // method overwrites the local file. Otherwise, it starts a download of the
+    // whole file. Connected to &DeltaDownload::finished of _deltaDownload.
+    void deltaDownloadFinished(bool success);
+
     // Called once download of the remote file header data is finished, this
     // method updates the properties remoteFileDate and remoteFileSize, and
     // _networkReplyDownloadHeader by calling deleteLater. Connected to
@@ -434,6 +510,18 @@ private:
     // This member holds the download progress.
     int _downloadProgress{0};
 
+    // Cached value of the property infoText, or a null string if the text
+    // needs to be computed. Computing the text requires several file system
+    // calls, and QML reads the property often. The cache is cleared whenever
+    // infoTextChanged() is emitted.
+    mutable QString _infoText;
+
+    // Computes the property infoText
+    QString infoTextUncached() const;
+
+    // Number of bytes received, see bytesDownloaded()
+    qint64 _bytesDownloaded{0};
+
     // NetworkReply for downloading of remote file data. Set to nullptr when no
     // download is in progress.
     QPointer<QNetworkReply> _networkReplyDownloadFile;
@@ -442,9 +530,90 @@ private:
     // no download is in progress.
     QPointer<QNetworkReply> _networkReplyDownloadHeader;
 
-    // Temporary file for storing partiall data when downloading the remote
-    // file. Set to nullptr when no download is in progress.
-    QPointer<QSaveFile> _saveFile{};
+    // Start a delta update, or a download of the whole file, resuming earlier
+    // downloads if possible. These methods do not emit any signals.
+    void startDeltaDownload();
+    void startFullFileDownload();
+
+    // Overwrites the local file with the partial file, once the download is
+    // complete, and deletes the data structures for the download
+    void installPartialFile();
+
+    // Stops the download. If keepPartialFile is false, the partially
+    // downloaded data is deleted as well.
+    void endFileDownload(bool keepPartialFile);
+
+    // Temporary file for storing partial data when downloading the remote
+    // file, and file that holds URL and modification date of the remote file
+    // that the data belongs to
+    QString partialFileName() const { return _fileName+".part"; }
+    QString partialFileInfoName() const { return _fileName+".part.info"; }
+
+    // Modification date of the remote file that the data in the partial file
+    // belongs to. Returns an invalid QDateTime if there is no partial file, or
+    // if the data cannot be resumed.
+    QDateTime partialFileDate() const;
+
+    // Records URL and modification date of the remote file whose data is
+    // written to the partial file. This method fails silently on error.
+    void writePartialFileInfo(const QDateTime& date) const;
+
+    // Deletes the partial file and its info file
+    void deletePartialFile() const;
+
+    // File that holds the URL of the local file, together with the validators
+    // (ETag and Last-Modified header) that the server sent with it
+    QString fileInfoName() const { return _fileName+".info"; }
+
+    // Validators that the server sent with the local file, as raw header
+    // values. Returns empty arrays if they are not known, or if they belong to
+    // a different URL.
+    QPair<QByteArray, QByteArray> fileValidators() const;
+
+    // Records URL and validators of the local file. If both validators are
+    // empty, the info file is deleted instead. This method fails silently on
+    // error.
+    void writeFileInfo(const QByteArray& eTag, const QByteArray& lastModified) const;
+
+    // Start and stop the writer for the partial file. Stopping waits until all
+    // data has been written and the file is closed, and returns the SHA-256
+    // hash of the file if the writer has computed one, or an empty array. If
+    // failed is not nullptr, it is set to true if the writer could not write
+    // all data, and to false otherwise.
+    void startWriter();
+    QByteArray stopWriter(bool* failed = nullptr);
+
+    // Called whenever the writer has written a block of data. This method
+    // hands more data over to the writer, and installs the file once the
+    // download is complete.
+    void fileDataWritten(qint64 bytes);
+
+    // Writer for the partial file, living in its own thread, and number of
+    // bytes handed over to the writer that have not been written yet. The
+    // writer is set to nullptr when no download is in progress.
+    QPointer<QThread> _writerThread;
+    QPointer<FileWriter> _writer;
+    qint64 _bytesPendingWrite{0};
+
+    // Size of the read buffer of the network reply, size of the blocks handed
+    // over to the writer, and maximal amount of data waiting to be written
+    static constexpr qint64 readBufferSize = 1024*1024;
+    static constexpr qint64 writeBlockSize = 256*1024;
+    static constexpr qint64 maxBytesPendingWrite = 4*1024*1024;
+
+    // Delta update of the file. Set to nullptr when no delta update is in
+    // progress.
+    QPointer<DeltaDownload> _deltaDownload;
+
+    // URL of the block checksums of the remote file, or an invalid URL
+    QUrl _blockChecksumsURL;
+
+    // SHA-256 hash of the remote file, or an empty array
+    QByteArray _remoteFileHash;
+
+    // Number of bytes that were already present in the partial file when the
+    // download started, or 0 if the download started from scratch
+    qint64 _resumeOffset{0};
 
     // URL of the remote file, as set in the constructor
     QUrl _url;
@@ -40,8 +40,11 @@ void GeoMaps::DownloadableGroup::addToGroup(Downloadable *downloadable)
     connect(downloadable, &Downloadable::downloadingChanged, this, &DownloadableGroup::checkAndEmitSignals);
     connect(downloadable, &Downloadable::updatableChanged, this, &DownloadableGroup::checkAndEmitSignals);
     connect(downloadable, &Downloadable::hasFileChanged, this, &DownloadableGroup::checkAndEmitSignals);
-    connect(downloadable, &Downloadable::fileContentChanged, this, &DownloadableGroup::localFileContentChanged);
+    connect(downloadable, &Downloadable::fileContentChanged, this, [this, downloadable]() { registerFileContentChange(downloadable); });
     connect(downloadable, &QObject::destroyed, this, &DownloadableGroup::cleanUp);
+    connect(downloadable, &Downloadable::downloadingChanged, this, &DownloadableGroup::processDownloadQueue, Qt::QueuedConnection);
+    connect(downloadable, &Downloadable::fileContentChanged, this, [this, downloadable]() { downloadEnded(downloadable, true); });
+    connect(downloadable, &Downloadable::error, this, [this, downloadable]() { downloadEnded(downloadable, false); });
     checkAndEmitSignals();
 
     emit downloadablesChanged();
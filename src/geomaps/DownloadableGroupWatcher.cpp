@@ -21,6 +21,8 @@
 #include <QLocale>
 
 #include "DownloadableGroupWatcher.h"
+#include "Global.h"
+#include "Settings.h"
 #include <chrono>
 
 using namespace std::chrono_literals;
@@ -32,6 +34,9 @@ GeoMaps::DownloadableGroupWatcher::DownloadableGroupWatcher(QObject *parent)
     emitLocalFileContentChanged_delayedTimer.setInterval(2s);
     connect(this, &DownloadableGroupWatcher::localFileContentChanged, &emitLocalFileContentChanged_delayedTimer, qOverload<>(&QTimer::start));
     connect(&emitLocalFileContentChanged_delayedTimer, &QTimer::timeout, this, &DownloadableGroupWatcher::emitLocalFileContentChanged_delayed);
+
+    _throughputTimer.setInterval(1s);
+    connect(&_throughputTimer, &QTimer::timeout, this, &DownloadableGroupWatcher::measureThroughput);
 }
 
 
@@ -41,7 +46,24 @@ void GeoMaps::DownloadableGroupWatcher::emitLocalFileContentChanged_delayed()
         return;
     }
     emitLocalFileContentChanged_delayedTimer.stop();
-    emit localFileContentChanged_delayed();
+
+    QVector<QPointer<Downloadable>> changedDownloadables;
+    foreach(auto downloadable, _changedDownloadables) {
+        if (!downloadable.isNull()) {
+            changedDownloadables.append(downloadable);
+        }
+    }
+    _changedDownloadables.clear();
+    emit localFileContentChanged_delayed(changedDownloadables);
+}
+
+
+void GeoMaps::DownloadableGroupWatcher::registerFileContentChange(Downloadable* downloadable)
+{
+    if (!_changedDownloadables.contains(downloadable)) {
+        _changedDownloadables.append(downloadable);
+    }
+    emit localFileContentChanged();
 }
 
 
@@ -133,11 +155,21 @@ void GeoMaps::DownloadableGroupWatcher::checkAndEmitSignals()
     if (newDownloading != _cachedDownloading) {
         _cachedDownloading = newDownloading;
         emit downloadingChanged(newDownloading);
-    }
 
-    if (newDownloading != _cachedDownloading) {
-        _cachedDownloading = newDownloading;
-        emit downloadingChanged(newDownloading);
+        // Start or stop measuring the throughput
+        if (newDownloading) {
+            _lastBytesDownloaded = 0;
+            foreach(auto downloadable, _downloadables) {
+                if (!downloadable.isNull()) {
+                    _lastBytesDownloaded += downloadable->bytesDownloaded();
+                }
+            }
+            _throughputTimer.start();
+        } else {
+            _throughputTimer.stop();
+            _throughputBytesPerSecond = -1.0;
+            emit throughputChanged();
+        }
     }
 
     if (newFiles != _cachedFiles) {
@@ -228,10 +260,102 @@ void GeoMaps::DownloadableGroupWatcher::updateAll()
         if (downloadablePtr.isNull()) {
             continue;
         }
-        if (downloadablePtr->updatable()) {
-            downloadablePtr->startFileDownload();
+        if (downloadablePtr->updatable() && !_downloadQueue.contains(downloadablePtr)) {
+            _downloadQueue.append(downloadablePtr);
+            _retryCounts[downloadablePtr] = 0;
+        }
+    }
+
+    // Download small files first. Files of unknown size go last.
+    std::stable_sort(_downloadQueue.begin(), _downloadQueue.end(), [](const QPointer<Downloadable>& a, const QPointer<Downloadable>& b)
+    {
+        auto sizeA = a.isNull() ? -1 : a->remoteFileSize();
+        auto sizeB = b.isNull() ? -1 : b->remoteFileSize();
+        if ((sizeA < 0) || (sizeB < 0)) {
+            return sizeB < 0 && sizeA >= 0;
+        }
+        return sizeA < sizeB;
+    }
+    );
+
+    processDownloadQueue();
+}
+
+
+void GeoMaps::DownloadableGroupWatcher::processDownloadQueue()
+{
+    int numDownloading = 0;
+    foreach(auto downloadable, _downloadables) {
+        if (!downloadable.isNull() && downloadable->downloading()) {
+            numDownloading++;
         }
     }
+
+    while ((numDownloading < Global::settings()->maxParallelDownloads()) && !_downloadQueue.isEmpty()) {
+        auto downloadable = _downloadQueue.takeFirst();
+        if (downloadable.isNull() || !_downloadables.contains(downloadable) || downloadable->downloading()) {
+            continue;
+        }
+        downloadable->startFileDownload();
+        numDownloading++;
+    }
+}
+
+
+void GeoMaps::DownloadableGroupWatcher::downloadEnded(GeoMaps::Downloadable* downloadable, bool success)
+{
+    auto iterator = _retryCounts.find(downloadable);
+    if (iterator == _retryCounts.end()) {
+        return;
+    }
+    if (success || (iterator.value() >= maxRetries)) {
+        _retryCounts.erase(iterator);
+        return;
+    }
+
+    // Queue the download again, with exponential backoff
+    auto delay = firstRetryDelayMS << iterator.value();
+    iterator.value()++;
+    QPointer<Downloadable> downloadablePtr(downloadable);
+    QTimer::singleShot(delay, this, [this, downloadablePtr]() {
+        if (downloadablePtr.isNull() || _downloadQueue.contains(downloadablePtr)) {
+            return;
+        }
+        _downloadQueue.prepend(downloadablePtr);
+        processDownloadQueue();
+    });
+}
+
+
+void GeoMaps::DownloadableGroupWatcher::measureThroughput()
+{
+    qint64 bytesDownloaded = 0;
+    foreach(auto downloadable, _downloadables) {
+        if (!downloadable.isNull()) {
+            bytesDownloaded += downloadable->bytesDownloaded();
+        }
+    }
+    auto bytesPerSecond = static_cast<double>(qMax(static_cast<qint64>(0), bytesDownloaded-_lastBytesDownloaded))*1000.0/_throughputTimer.interval();
+    _lastBytesDownloaded = bytesDownloaded;
+
+    auto oldThroughput = throughput();
+    if (_throughputBytesPerSecond < 0.0) {
+        _throughputBytesPerSecond = bytesPerSecond;
+    } else {
+        _throughputBytesPerSecond = 0.7*_throughputBytesPerSecond + 0.3*bytesPerSecond;
+    }
+    if (throughput() != oldThroughput) {
+        emit throughputChanged();
+    }
+}
+
+
+auto GeoMaps::DownloadableGroupWatcher::throughput() const -> QString
+{
+    if (_throughputBytesPerSecond < 0.0) {
+        return {};
+    }
+    return tr("%1/s").arg(QLocale::system().formattedDataSize(qRound64(_throughputBytesPerSecond), 1, QLocale::DataSizeSIFormat));
 }
 
 
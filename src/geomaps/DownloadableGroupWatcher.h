@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <QHash>
 #include <QTimer>
 
 #include "Downloadable.h"
@@ -31,6 +32,12 @@ namespace GeoMaps {
   
   This convenience class collects signals and properties from a set of
   Downloadable objects, and forwards summarized information.
+
+  Updates started with updateAll() are queued. At most
+  Settings::maxParallelDownloads() Downloadables of the group download at the
+  same time, the smallest files first, so that small aviation maps become
+  usable before large base maps are complete. Queued downloads that fail are
+  retried a few times, with increasing delays.
 */
 
 class DownloadableGroupWatcher : public QObject
@@ -136,6 +143,19 @@ public:
     */
     QString updateSize() const;
 
+    /*! \brief Download throughput of all Downloadables in this group, as a localized string
+
+    The string returned is typically of the form "1.2 MB/s". It is empty if no
+    download is running.
+    */
+    Q_PROPERTY(QString throughput READ throughput NOTIFY throughputChanged)
+
+    /*! \brief Getter function for the property with the same name
+
+    @returns Property throughput
+    */
+    QString throughput() const;
+
     /*! \brief total number of files that are either downloaded or currently downloading.
 
       @returns int nFilesTotal
@@ -165,6 +185,9 @@ signals:
     /*! \brief Notifier signal for the property updatable */
     void updateSizeChanged(QString);
 
+    /*! \brief Notifier signal for the property throughput */
+    void throughputChanged();
+
     /*! \brief Emitted if the content of one of the local files changes.
 
       This signal is emitted if one of the downloadables in this group emits
@@ -178,8 +201,12 @@ signals:
       emitted with a delay.  The DownloadableGroupWatch waits with the emission
       of this signal for two seconds. In addition it waits until there are no
       running download processes anymore.
+
+      @param changedDownloadables Downloadables whose files have changed since
+      the last emission of this signal. Receivers can use this list to reload
+      only those files.
      */
-    void localFileContentChanged_delayed();
+    void localFileContentChanged_delayed(QVector<QPointer<GeoMaps::Downloadable>> changedDownloadables);
 
     /*! \brief Notifier signal for the property downloadables */
     void downloadablesChanged();
@@ -193,6 +220,16 @@ protected slots:
     // Remove all instances of nullptr from _downloadables
     void cleanUp();
 
+    // Starts queued downloads, as long as fewer than
+    // Settings::maxParallelDownloads() Downloadables in this group are
+    // downloading
+    void processDownloadQueue();
+
+    // This slot is called whenever a download of a Downloadable in this group
+    // ends. If a queued download failed, it is queued again after some delay,
+    // unless it has failed too often.
+    void downloadEnded(GeoMaps::Downloadable* downloadable, bool success);
+
 protected:
     /*! \brief Constructs an empty group
 
@@ -203,12 +240,32 @@ protected:
     // List of QPointers to the Downloadable objects in this group
     QList<QPointer<Downloadable>> _downloadables;
 
+    // This method is called whenever the file of a Downloadable in this group
+    // changes. It remembers the Downloadable for the signal
+    // localFileContentChanged_delayed and emits localFileContentChanged.
+    void registerFileContentChange(GeoMaps::Downloadable* downloadable);
+
 private:
      Q_DISABLE_COPY_MOVE(DownloadableGroupWatcher)
 
     // Provisions to provide the signal localFileContentChanged_delayed
     void emitLocalFileContentChanged_delayed();
     QTimer emitLocalFileContentChanged_delayedTimer;
+    QVector<QPointer<Downloadable>> _changedDownloadables;
+
+    // Queued downloads, and the number of retries for the downloads started
+    // from the queue
+    QList<QPointer<Downloadable>> _downloadQueue;
+    QHash<Downloadable*, int> _retryCounts;
+    static constexpr int maxRetries = 3;
+    static constexpr int firstRetryDelayMS = 5*1000;
+
+    // Provisions to measure the throughput. The timer runs while downloads are
+    // running, the throughput is smoothed over a few seconds.
+    void measureThroughput();
+    QTimer _throughputTimer;
+    qint64 _lastBytesDownloaded {0};
+    double _throughputBytesPerSecond {-1.0};
 
     bool                          _cachedDownloading {false};        // Cached value for the 'downloading' property
     QVector<QPointer<Downloadable>> _cachedDownloadablesWithFile {};   // Cached value for the 'downloadablesWithFiles' property
@@ -0,0 +1,101 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <utility>
+
+#include "FileWriter.h"
+
+
+GeoMaps::FileWriter::FileWriter(QString fileName, bool computeHash)
+    : m_fileName(std::move(fileName)), m_computeHash(computeHash)
+{
+}
+
+
+void GeoMaps::FileWriter::open()
+{
+    // The file is created here, so that it lives in the thread of the writer
+    delete m_file;
+    m_result.clear();
+
+    // If data is already present, include it in the hash
+    m_hash.reset();
+    if (m_computeHash) {
+        QFile existingFile(m_fileName);
+        if (existingFile.open(QIODevice::ReadOnly)) {
+            m_hash.addData(&existingFile);
+        }
+    }
+
+    m_file = new QFile(m_fileName, this);
+    if (!m_file->open(QIODevice::WriteOnly|QIODevice::Append)) {
+        fail();
+    }
+}
+
+
+void GeoMaps::FileWriter::write(const QByteArray& data)
+{
+    // After a failure, the file is useless and the data is dropped
+    if (m_failed) {
+        return;
+    }
+    if (m_file.isNull() || (m_file->write(data) != data.size())) {
+        fail();
+        return;
+    }
+    if (m_computeHash) {
+        m_hash.addData(data);
+    }
+    emit written(data.size());
+}
+
+
+void GeoMaps::FileWriter::truncate()
+{
+    if (m_file.isNull() || !m_file->resize(0)) {
+        fail();
+        return;
+    }
+    m_hash.reset();
+}
+
+
+void GeoMaps::FileWriter::close()
+{
+    if (m_file.isNull()) {
+        return;
+    }
+    m_file->close();
+    delete m_file;
+    if (m_computeHash && !m_failed) {
+        m_result = m_hash.result();
+    }
+}
+
+
+void GeoMaps::FileWriter::fail()
+{
+    if (m_failed) {
+        return;
+    }
+    m_failed = true;
+    emit failed();
+}
@@ -0,0 +1,122 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QPointer>
+
+
+namespace GeoMaps {
+
+/*! \brief Writes data to a file in a worker thread
+
+  This class appends data to a file. It is meant to live in a worker thread,
+  so that slow writes do not block the GUI thread. The slots of this class
+  are meant to be called through queued connections, in order. Every block of
+  data that has been written is acknowledged with the signal written(), so
+  that the caller can limit the amount of data that is in flight. Errors are
+  reported with the signal failed(). Optionally, the writer computes
+  the SHA-256 hash of the file content while writing.
+*/
+
+class FileWriter : public QObject
+{
+  Q_OBJECT
+
+public:
+  /*! \brief Create a new file writer
+
+    @param fileName Name of the file. The file is created if it does not yet
+    exist.
+
+    @param computeHash If true, the writer computes the SHA-256 hash of the
+    file content, including data that is already present when the file is
+    opened.
+  */
+  explicit FileWriter(QString fileName, bool computeHash=false);
+
+  // Standard destructor
+  ~FileWriter() override = default;
+
+public slots:
+  /*! \brief Open the file for appending */
+  void open();
+
+  /*! \brief Append data to the file
+
+    @param data Data to be appended
+  */
+  void write(const QByteArray& data);
+
+  /*! \brief Remove all data from the file */
+  void truncate();
+
+  /*! \brief Flush all data and close the file */
+  void close();
+
+public:
+  /*! \brief SHA-256 hash of the file content
+
+    @returns Hash of the file content at the time of close(), or an empty
+    array if no hash was computed or if the file has not been closed yet
+  */
+  QByteArray hash() const { return m_result; }
+
+  /*! \brief Failure state
+
+    @returns True if some data could not be written
+  */
+  bool hasFailed() const { return m_failed; }
+
+signals:
+  /*! \brief A block of data has been handled
+
+    This signal is emitted for every block that has been written
+    successfully. Once the writer has failed, it is no longer emitted; the
+    caller is expected to stop on the signal failed().
+
+    @param bytes Size of the block
+  */
+  void written(qint64 bytes);
+
+  /*! \brief Data could not be written
+
+    This signal is emitted once, after the first error.
+  */
+  void failed();
+
+private:
+  Q_DISABLE_COPY_MOVE(FileWriter)
+
+  // Emits failed(), unless this has been done before
+  void fail();
+
+  QString m_fileName;
+  QPointer<QFile> m_file;
+  bool m_failed {false};
+
+  bool m_computeHash;
+  QCryptographicHash m_hash {QCryptographicHash::Sha256};
+  QByteArray m_result;
+};
+
+};
@@ -19,105 +19,250 @@
  ***************************************************************************/
 
 #include <QApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
 #include <QGeoCoordinate>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QQmlEngine>
-#include <QRandomGenerator>
+#include <QSaveFile>
 #include <QSqlDatabase>
 #include <QSqlQuery>
+#include <QStandardPaths>
 #include <QtConcurrent/QtConcurrent>
 #include <chrono>
+#include <cmath>
+#include <limits>
 
 #include "Clock.h"
 #include "GeoMapProvider.h"
 #include "Global.h"
+#include "JSONScanner.h"
+#include "MemoryBudget.h"
+#include "Metrics.h"
+#include "StartupTracer.h"
+#include "StringPool.h"
 #include "navigation/Navigator.h"
+#include "positioning/PositionProvider.h"
 
 using namespace std::chrono_literals;
 
+QMutex GeoMaps::GeoMapProvider::describeMapFileCacheMutex;
+QHash<QString, QPair<QString,QString>> GeoMaps::GeoMapProvider::describeMapFileCache;
+
 
 GeoMaps::GeoMapProvider::GeoMapProvider(QObject *parent)
     : QObject(parent),
-      _tileServer(QUrl()),
-      _styleFile(nullptr)
+      _tileServer(QUrl())
 {
-    // Initialize _combinedGeoJSON_ with an empty document
-    QJsonObject resultObject;
-    resultObject.insert(QStringLiteral("type"), "FeatureCollection");
-    resultObject.insert(QStringLiteral("features"), QJsonArray());
-    QJsonDocument geoDoc(resultObject);
-    _combinedGeoJSON_ = geoDoc.toJson(QJsonDocument::JsonFormat::Compact);
+    // Initialize aviation data with an empty snapshot
+    std::atomic_store(&_aviationData_, std::shared_ptr<const AviationData>(std::make_shared<AviationData>()));
 
-    _tileServer.listen(QHostAddress(QStringLiteral("127.0.0.1")));
+    if (!_tileServer.listen(QHostAddress(QStringLiteral("127.0.0.1")), preferredTileServerPort)) {
+        _tileServer.listen(QHostAddress(QStringLiteral("127.0.0.1")));
+    }
 
     // Deferred initializsation
     QTimer::singleShot(0, this, &GeoMaps::GeoMapProvider::deferredInitialization);
 }
 
 
-auto GeoMaps::GeoMapProvider::airspaces(const QGeoCoordinate& position) -> QVariantList
+auto GeoMaps::GeoMapProvider::airspaceList(const AviationData& data, const QVector<int>& indices) -> QVariantList
 {
-    // Lock data
-    QMutexLocker lock(&_aviationDataMutex);
+    QVariantList result;
+    result.reserve(indices.size());
+    foreach(auto index, indices) {
+        result.append( QVariant::fromValue(data.airspaces[index]) );
+    }
+    return result;
+}
 
-    QVector<Airspace> result;
-    result.reserve(10);
-    foreach(auto airspace, _airspaces_) {
-        if (airspace.polygon().contains(position)) {
-            result.append(airspace);
-        }
+
+auto GeoMaps::GeoMapProvider::airspacesAhead(int minutes) -> QVariantList
+{
+    auto data = aviationData();
+    ensureAirspaceCacheIsCurrent(data);
+
+    auto info = Positioning::PositionProvider::globalInstance()->positionInfo();
+    auto TT = info.trueTrack();
+    auto GS = info.groundSpeed();
+    if (!info.isValid() || !TT.isFinite() || !GS.isFinite() || (minutes <= 0)) {
+        return {};
+    }
+    auto start = info.coordinate();
+    auto distanceM = GS.toMPS()*minutes*60.0;
+
+    // Recompute the predicted path if the track changed by more than 5°, if
+    // the ground speed changed by more than 10%, or if the aircraft has
+    // covered more than 10% of the path
+    auto trackChange = qAbs(std::remainder(TT.toDEG()-_aheadTrackDeg, 360.0));
+    bool recompute = !_aheadStart.isValid()
+            || (trackChange > 5.0)
+            || (qAbs(distanceM-_aheadDistanceM) > 0.1*_aheadDistanceM)
+            || (_aheadStart.distanceTo(start) > 0.1*_aheadDistanceM);
+    if (recompute) {
+        _aheadStart = start;
+        _aheadEnd = start.atDistanceAndAzimuth(distanceM, TT.toDEG());
+        _aheadTrackDeg = TT.toDEG();
+        _aheadDistanceM = distanceM;
+        _aheadIndices = AviationDataQuery(data).airspaceIndicesAlong(_aheadStart, _aheadEnd);
+    }
+    return airspaceList(*data, _aheadIndices);
+}
+
+
+auto GeoMaps::GeoMapProvider::airspacesAroundOwnship(double radiusM, double verticalMarginFt) -> QVariantList
+{
+    auto* positionProvider = Positioning::PositionProvider::globalInstance();
+    auto info = positionProvider->positionInfo();
+    if (!info.isValid()) {
+        return {};
+    }
+
+    auto altitude = positionProvider->pressureAltitude();
+    if (!altitude.isFinite()) {
+        altitude = info.trueAltitude();
+    }
+    auto minAltitudeFtMSL = -std::numeric_limits<double>::infinity();
+    auto maxAltitudeFtMSL = std::numeric_limits<double>::infinity();
+    if (altitude.isFinite()) {
+        minAltitudeFtMSL = altitude.toFeet()-verticalMarginFt;
+        maxAltitudeFtMSL = altitude.toFeet()+verticalMarginFt;
+    }
+
+    QVariantList result;
+    foreach(auto airspace, aviationDataQuery().airspaces(info.coordinate(), radiusM, minAltitudeFtMSL, maxAltitudeFtMSL)) {
+        result.append( QVariant::fromValue(airspace) );
+    }
+    return result;
+}
+
+
+auto GeoMaps::GeoMapProvider::airspacesAlong(const QGeoCoordinate& start, const QGeoCoordinate& end) -> QVariantList
+{
+    auto data = aviationData();
+    ensureAirspaceCacheIsCurrent(data);
+
+    auto key = QStringLiteral("%1 %2 %3 %4")
+            .arg(start.latitude(), 0, 'g', 12).arg(start.longitude(), 0, 'g', 12)
+            .arg(end.latitude(), 0, 'g', 12).arg(end.longitude(), 0, 'g', 12);
+    auto iterator = _airspacesAlongCache.constFind(key);
+    if (iterator != _airspacesAlongCache.constEnd()) {
+        return airspaceList(*data, iterator.value());
+    }
+
+    auto indices = AviationDataQuery(data).airspaceIndicesAlong(start, end);
+    if (_airspacesAlongCache.size() >= maxAirspacesAlongCacheSize) {
+        _airspacesAlongCache.clear();
+    }
+    _airspacesAlongCache.insert(key, indices);
+    return airspaceList(*data, indices);
+}
+
+
+auto GeoMaps::GeoMapProvider::geoJSON() -> QByteArray
+{
+    auto data = aviationData();
+    if ((data != _geoJSONData) || (_viewportChunks != _geoJSONChunks) || (_viewportLevelOfDetail != _geoJSONLevelOfDetail)) {
+        _geoJSONData = data;
+        _geoJSONChunks = _viewportChunks;
+        _geoJSONLevelOfDetail = _viewportLevelOfDetail;
+        _geoJSON = data->geoJSON(_viewportChunks, _viewportLevelOfDetail);
+    }
+    return _geoJSON;
+}
+
+
+void GeoMaps::GeoMapProvider::setMapZoomLevel(double zoomLevel)
+{
+    _tilePrefetcher.setZoomLevel(zoomLevel);
+
+    auto levelOfDetail = AviationData::levelOfDetail(zoomLevel);
+    if (levelOfDetail == _viewportLevelOfDetail) {
+        return;
+    }
+    _viewportLevelOfDetail = levelOfDetail;
+    emit geoJSONChanged();
+}
+
+
+void GeoMaps::GeoMapProvider::setMapViewport(const QGeoShape& region)
+{
+    if (!region.isValid()) {
+        return;
+    }
+
+    // Keep the current chunks as long as they cover the region and are not
+    // much larger than needed. Otherwise, take the chunks that cover the
+    // region, with a margin of one chunk in every direction.
+    auto visibleChunks = AviationData::chunksCovering(region.boundingGeoRectangle());
+    auto wantedChunks = visibleChunks.adjusted(-1, -1, 1, 1).intersected(AviationData::allChunks());
+    if (_viewportChunks.contains(visibleChunks) &&
+            (_viewportChunks.width()*_viewportChunks.height() <= 4*wantedChunks.width()*wantedChunks.height())) {
+        return;
     }
+    _viewportChunks = wantedChunks;
+    emit geoJSONChanged();
+}
+
+
+void GeoMaps::GeoMapProvider::ensureAirspaceCacheIsCurrent(const std::shared_ptr<const AviationData>& data)
+{
+    if (data == _airspaceCacheData) {
+        return;
+    }
+    _airspaceCacheData = data;
+    _airspacesAlongCache.clear();
+    _aheadStart = {};
+    _aheadIndices.clear();
+}
 
-    // Sort airspaces according to lower boundary
-    std::sort(result.begin(), result.end(), [](const Airspace& a, const Airspace& b) {return (a.estimatedLowerBoundInFtMSL() > b.estimatedLowerBoundInFtMSL()); });
 
+auto GeoMaps::GeoMapProvider::airspaces(const QGeoCoordinate& position) -> QVariantList
+{
     QVariantList final;
-    foreach(auto airspace, result)
+    foreach(auto airspace, aviationDataQuery().airspaces(position))
         final.append( QVariant::fromValue(airspace) );
 
     return final;
 }
 
 
+auto GeoMaps::GeoMapProvider::snapToWaypoints(const QVector<QGeoCoordinate>& positions, double snapRadiusM) const -> QVector<Waypoint>
+{
+    return aviationDataQuery().snapToWaypoints(positions, snapRadiusM);
+}
+
+
 auto GeoMaps::GeoMapProvider::closestWaypoint(QGeoCoordinate position, const QGeoCoordinate& distPosition) -> Waypoint
 {
-    position.setAltitude(qQNaN());
+    // The flight route lives in the GUI thread. Its waypoints are therefore
+    // collected here and handed to the query as additional waypoints.
+    return aviationDataQuery().closestWaypoint(position, distPosition, Global::navigator()->flightRoute()->waypointVector());
+}
 
-    Waypoint result;
-    const auto wpts = waypoints();
-    for(const auto& wp : wpts) {
-        if (!wp.isValid()) {
-            continue;
-        }
-        if (!result.isValid()) {
-            result = wp;
-        }
-        if (position.distanceTo(wp.coordinate()) < position.distanceTo(result.coordinate())) {
-            result = wp;
-        }
-    }
 
-    for(auto& variant : Global::navigator()->flightRoute()->midFieldWaypoints() ) {
-        auto wp = variant.value<GeoMaps::Waypoint>();
-        if (!wp.isValid()) {
-            continue;
-        }
-        if (position.distanceTo(wp.coordinate()) < position.distanceTo(result.coordinate())) {
-            result = wp;
+auto GeoMaps::GeoMapProvider::describeMapFile(const QString& fileName) -> QString
+{
+    auto key = aviationMapFileKey(fileName);
+    {
+        QMutexLocker locker(&describeMapFileCacheMutex);
+        auto iterator = describeMapFileCache.constFind(fileName);
+        if ((iterator != describeMapFileCache.constEnd()) && (iterator->first == key)) {
+            return iterator->second;
         }
     }
 
-    if (position.distanceTo(result.coordinate()) > position.distanceTo(distPosition)) {
-        return Waypoint(position);
-    }
-
+    auto result = describeMapFileUncached(fileName);
+    QMutexLocker locker(&describeMapFileCacheMutex);
+    describeMapFileCache.insert(fileName, {key, result});
     return result;
 }
 
 
-auto GeoMaps::GeoMapProvider::describeMapFile(const QString& fileName) -> QString
+auto GeoMaps::GeoMapProvider::describeMapFileUncached(const QString& fileName) -> QString
 {
     QFileInfo fi(fileName);
     if (!fi.exists()) {
@@ -131,14 +276,7 @@ auto GeoMaps::GeoMapProvider::describeMapFile(const QString& fileName) -> QStrin
 
     // Extract infomation from GeoJSON
     if (fileName.endsWith(u".geojson")) {
-        QLockFile lockFile(fileName+".lock");
-        lockFile.lock();
-        QFile file(fileName);
-        file.open(QIODevice::ReadOnly);
-        auto document = QJsonDocument::fromJson(file.readAll());
-        file.close();
-        lockFile.unlock();
-        QString concatInfoString = document.object()[QStringLiteral("info")].toString();
+        QString concatInfoString = readMapInfo(fileName);
         if (!concatInfoString.isEmpty()) {
             result += "<p>"+tr("The map data was compiled from the following sources.")+"</p><ul>";
             auto infoStrings = concatInfoString.split(QStringLiteral(";"));
@@ -150,68 +288,87 @@ auto GeoMaps::GeoMapProvider::describeMapFile(const QString& fileName) -> QStrin
 
     // Extract infomation from MBTILES
     if (fileName.endsWith(u".mbtiles")) {
-        // Open database
-        auto databaseConnectionName = "GeoMapProvider::describeMapFile "+fileName;
-        auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), databaseConnectionName);
-        db.setDatabaseName(fileName);
-        db.open();
-        if (!db.isOpenError()) {
-            // Read metadata from database
-            QSqlQuery query(db);
-            QString intResult;
-            if (query.exec(QStringLiteral("select name, value from metadata;"))) {
-                while(query.next()) {
-                    QString key = query.value(0).toString();
-                    if (key == u"json") {
-                        continue;
+        // Open database. This method can run in several threads, so the name
+        // of the connection contains the thread ID.
+        auto databaseConnectionName = QStringLiteral("GeoMapProvider::describeMapFile %1 %2").arg(reinterpret_cast<quintptr>(QThread::currentThreadId())).arg(fileName);
+        {
+            auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), databaseConnectionName);
+            db.setDatabaseName(fileName);
+            db.open();
+            if (!db.isOpenError()) {
+                // Read metadata from database
+                QSqlQuery query(db);
+                QString intResult;
+                if (query.exec(QStringLiteral("select name, value from metadata;"))) {
+                    while(query.next()) {
+                        QString key = query.value(0).toString();
+                        if (key == u"json") {
+                            continue;
+                        }
+                        intResult += QStringLiteral("<tr><td><strong>%1 :&nbsp;&nbsp;</strong></td><td>%2</td></tr>")
+                                .arg(key, query.value(1).toString());
                     }
-                    intResult += QStringLiteral("<tr><td><strong>%1 :&nbsp;&nbsp;</strong></td><td>%2</td></tr>")
-                            .arg(key, query.value(1).toString());
                 }
+                if (!intResult.isEmpty()) {
+                    result += QStringLiteral("<h4>%1</h4><table>%2</table>").arg(tr("Internal Map Data"), intResult);
+                }
+                db.close();
             }
-            if (!intResult.isEmpty()) {
-                result += QStringLiteral("<h4>%1</h4><table>%2</table>").arg(tr("Internal Map Data"), intResult);
-            }
-            db.close();
         }
+        // All copies of db are out of scope now, so the connection can be removed
+        QSqlDatabase::removeDatabase(databaseConnectionName);
     }
 
     return result;
 }
 
 
-auto GeoMaps::GeoMapProvider::filteredWaypointObjects(const QString &filter) -> QVariantList
+auto GeoMaps::GeoMapProvider::readMapInfo(const QString& fileName) -> QString
 {
-    auto wps = waypoints();
+    QLockFile lockFile(fileName+".lock");
+    lockFile.lock();
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    // The member "info" usually precedes the features. Read the file in
+    // blocks of doubling size, and stop as soon as the scanner finds a
+    // complete value. A truncated document never yields a value.
+    QByteArray fileData;
+    qint64 blockSize = 64*1024;
+    while (!file.atEnd()) {
+        auto block = file.read(blockSize);
+        if (block.isEmpty()) {
+            break;
+        }
+        fileData += block;
+        auto info = JSONScanner::value(fileData, QByteArrayLiteral("info"));
+        if (!info.isUndefined()) {
+            return info.toString();
+        }
+        blockSize *= 2;
+    }
+    return {};
+}
 
+
+auto GeoMaps::GeoMapProvider::filteredWaypointObjects(const QString &filter) -> QVariantList
+{
     QStringList filterWords;
     foreach(auto word, filter.simplified().split(' ', Qt::SkipEmptyParts)) {
-        QString simplifiedWord = Librarian::globalInstance()->simplifySpecialChars(word);
+        QString simplifiedWord = WaypointSearchIndex::simplify(word);
         if (simplifiedWord.isEmpty()) {
             continue;
         }
         filterWords.append(simplifiedWord);
     }
 
+    auto data = aviationData();
+
     QVariantList result;
-    foreach(auto wp, wps) {
-        if (!wp.isValid()) {
-            continue;
-        }
-        bool allWordsFound = true;
-        foreach(auto word, filterWords) {
-            QString fullName = Librarian::globalInstance()->simplifySpecialChars(wp.name());
-            QString codeName = Librarian::globalInstance()->simplifySpecialChars(wp.ICAOCode());
-            QString wordx = Librarian::globalInstance()->simplifySpecialChars(word);
-
-            if (!fullName.contains(wordx, Qt::CaseInsensitive) && !codeName.contains(wordx, Qt::CaseInsensitive)) {
-                allWordsFound = false;
-                break;
-            }
-        }
-        if (allWordsFound) {
-            result.append( QVariant::fromValue(wp) );
-        }
+    foreach(auto index, data->waypointSearchIndex.find(filterWords)) {
+        result.append( QVariant::fromValue(data->waypoints[index]) );
     }
 
     return result;
@@ -220,45 +377,21 @@ auto GeoMaps::GeoMapProvider::filteredWaypointObjects(const QString &filter) ->
 
 auto GeoMaps::GeoMapProvider::findByID(const QString &id) -> Waypoint
 {
-    auto wps = waypoints();
-
-    foreach(auto wp, wps) {
-        if (!wp.isValid()) {
-            continue;
-        }
-        if (wp.ICAOCode() == id) {
-            return wp;
-        }
-    }
-    return {};
+    return aviationDataQuery().findByID(id);
 }
 
 
-auto GeoMaps::GeoMapProvider::nearbyWaypoints(const QGeoCoordinate& position, const QString& type) -> QVariantList
+auto GeoMaps::GeoMapProvider::findByIDs(const QStringList& ids) -> QVector<Waypoint>
 {
-    auto wps = waypoints();
-
-    QVector<Waypoint> tWps;
-    foreach(auto wp, wps) {
-        if (!wp.isValid()) {
-            continue;
-        }
-        if (wp.type() != type) {
-            continue;
-        }
-        tWps.append(wp);
-    }
+    return aviationDataQuery().findByIDs(ids);
+}
 
-    std::sort(tWps.begin(), tWps.end(), [position](const Waypoint &a, const Waypoint &b) {return position.distanceTo(a.coordinate()) < position.distanceTo(b.coordinate()); });
 
+auto GeoMaps::GeoMapProvider::nearbyWaypoints(const QGeoCoordinate& position, const QString& type) -> QVariantList
+{
     QVariantList result;
-    int sz = 0;
-    foreach(auto ad, tWps) {
-        result.append( QVariant::fromValue(ad) );
-        sz++;
-        if (sz == 20) {
-            break;
-        }
+    foreach(auto waypoint, aviationDataQuery().nearbyWaypoints(position, type, 20)) {
+        result.append( QVariant::fromValue(waypoint) );
     }
 
     return result;
@@ -267,10 +400,10 @@ auto GeoMaps::GeoMapProvider::nearbyWaypoints(const QGeoCoordinate& position, co
 
 auto GeoMaps::GeoMapProvider::styleFileURL() const -> QString
 {
-    if (_styleFile.isNull()) {
+    if (_styleFileName.isEmpty()) {
         return QStringLiteral(":/flightMap/empty.json");
     }
-    return "file://"+_styleFile->fileName();
+    return "file://"+_styleFileName;
 }
 
 
@@ -297,121 +430,577 @@ void GeoMaps::GeoMapProvider::aviationMapsChanged()
         JSONFileNames += geoMapPtr->fileName();
     }
 
-    _aviationDataCacheFuture = QtConcurrent::run(this, &GeoMaps::GeoMapProvider::fillAviationDataCache, JSONFileNames, Settings::hideUpperAirspacesStatic());
+    _aviationDataRegion = aviationDataRegion();
+    _aviationDataCacheFuture = QtConcurrent::run(this, &GeoMaps::GeoMapProvider::fillAviationDataCache, JSONFileNames, Settings::hideUpperAirspacesStatic(), _aviationDataRegion);
+}
+
+
+auto GeoMaps::GeoMapProvider::aviationDataRegion() -> QRectF
+{
+    if (!Global::settings()->loadAviationDataByRegion()) {
+        return {};
+    }
+
+    QGeoRectangle bbox = Global::navigator()->flightRoute()->boundingRectangle();
+    auto position = Positioning::PositionProvider::lastValidCoordinate();
+    if (position.isValid()) {
+        if (bbox.isValid()) {
+            bbox.extendRectangle(position);
+        } else {
+            bbox = QGeoRectangle(position, position);
+        }
+    }
+    if (!bbox.isValid() || (bbox.topLeft().longitude() > bbox.bottomRight().longitude())) {
+        return {};
+    }
+
+    // Extend by the margin and round outward to whole chunks, so that the
+    // region changes only rarely while flying
+    auto roundDown = [](double degrees) { return std::floor(degrees/AviationData::chunkSizeInDegrees)*AviationData::chunkSizeInDegrees; };
+    auto roundUp = [](double degrees) { return std::ceil(degrees/AviationData::chunkSizeInDegrees)*AviationData::chunkSizeInDegrees; };
+    QPointF minimum(qMax(-180.0, roundDown(bbox.topLeft().longitude()-regionMarginInDegrees)),
+                    qMax(-90.0, roundDown(bbox.bottomRight().latitude()-regionMarginInDegrees)));
+    QPointF maximum(qMin(180.0, roundUp(bbox.bottomRight().longitude()+regionMarginInDegrees)),
+                    qMin(90.0, roundUp(bbox.topLeft().latitude()+regionMarginInDegrees)));
+    return {minimum, maximum};
 }
 
 
-void GeoMaps::GeoMapProvider::baseMapsChanged()
+void GeoMaps::GeoMapProvider::updateAviationDataRegion()
 {
+    if (aviationDataRegion() != _aviationDataRegion) {
+        aviationMapsChanged();
+    }
+}
+
+
+auto GeoMaps::GeoMapProvider::tileSetPath(const QVector<QPointer<Downloadable>>& baseMaps) -> QString
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach(auto baseMap, baseMaps) {
+        if (baseMap.isNull()) {
+            continue;
+        }
+        QFileInfo info(baseMap->fileName());
+        hash.addData(info.absoluteFilePath().toUtf8());
+        hash.addData(QByteArray::number(info.size()));
+        hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    }
+    return QString::fromLatin1(hash.result().toHex().left(16));
+}
 
-    // Delete old style file, stop serving tiles
-    delete _styleFile;
+
+void GeoMaps::GeoMapProvider::baseMapsChanged(const QVector<QPointer<Downloadable>>& changedBaseMaps)
+{
+    // The path is derived from the files, and changes whenever the content of
+    // a file changes. The map renderer therefore never mixes tiles of old and
+    // new files that it has cached under the old path. Only if the same files
+    // are installed as before and the path is unchanged, reopen the files
+    // that have changed and keep tile set and style file.
+    auto baseMaps = Global::mapManager()->baseMaps()->downloadablesWithFile();
+    auto path = tileSetPath(baseMaps);
+    if (!_styleFileName.isEmpty() && !changedBaseMaps.isEmpty() && (baseMaps == _currentBaseMaps) && (path == _currentPath)) {
+        _tileServer.reopenMbtilesFiles(changedBaseMaps);
+        return;
+    }
+
+    // Stop serving tiles
     _tileServer.removeMbtilesFileSet(_currentPath);
 
-    // Serve new tile set under new name
-    _currentPath = QString::number(QRandomGenerator::global()->bounded(static_cast<quint32>(1000000000)));
-    _tileServer.addMbtilesFileSet(Global::mapManager()->baseMaps()->downloadablesWithFile(), _currentPath);
+    // Serve new tile set under a name derived from the files
+    _currentPath = path;
+    _currentBaseMaps = baseMaps;
+    _tileServer.addMbtilesFileSet(baseMaps, _currentPath);
 
-    // Generate new mapbox style file
-    _styleFile = new QTemporaryFile(this);
+    // Generate mapbox style file
     QFile file(QStringLiteral(":/flightMap/osm-liberty.json"));
     file.open(QIODevice::ReadOnly);
     QByteArray data = file.readAll();
     data.replace("%URL%", (_tileServer.serverUrl()+"/"+_currentPath).toLatin1());
     data.replace("%URL2%", _tileServer.serverUrl().toLatin1());
-    _styleFile->open();
-    _styleFile->write(data);
-    _styleFile->close();
 
+    // Reuse the style file if one with the same content exists. Otherwise,
+    // write a new one and delete style files that are no longer used.
+    QDir styleDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)+"/styles");
+    styleDirectory.mkpath(QStringLiteral("."));
+    auto styleFileName = styleDirectory.absoluteFilePath(QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex().left(16))+".json");
+    if (!QFile::exists(styleFileName)) {
+        foreach(auto entry, styleDirectory.entryList({QStringLiteral("*.json")}, QDir::Files)) {
+            styleDirectory.remove(entry);
+        }
+        QSaveFile styleFile(styleFileName);
+        if (!styleFile.open(QIODevice::WriteOnly) || (styleFile.write(data) != data.size()) || !styleFile.commit()) {
+            _styleFileName.clear();
+            emit styleFileURLChanged();
+            return;
+        }
+    }
+    if (styleFileName == _styleFileName) {
+        return;
+    }
+    _styleFileName = styleFileName;
     emit styleFileURLChanged();
 
 }
 
 
-void GeoMaps::GeoMapProvider::fillAviationDataCache(const QStringList& JSONFileNames, bool hideUpperAirspaces)
+void GeoMaps::GeoMapProvider::fillAviationDataCache(const QStringList& JSONFileNames, bool hideUpperAirspaces, const QRectF& region)
 {
-    //
-    // Generate new GeoJSON array and new list of waypoints
-    //
+    StartupTracer::Phase phase("Aviation data");
+    Metrics::Timer timer(Metrics::AviationDataCache);
+
+    // Reads the parsed aviation maps from the cache file, restricted to a
+    // region
+    auto readFragments = [this](const QRectF& fragmentsRegion) {
+        _aviationMapFragmentsRead = true;
+        _aviationMapFragments.clear();
+        if (!readAviationDataCache(_aviationMapFragments, fragmentsRegion)) {
+            _aviationMapFragments.clear();
+        }
+        _aviationMapFragmentsRegion = fragmentsRegion;
+    };
+
+    // On first run, or if the region has changed, read the parsed aviation
+    // maps from the cache file
+    if (!_aviationMapFragmentsRead || (region != _aviationMapFragmentsRegion)) {
+        readFragments(region);
+    }
+
+    // If files have been removed or changed, the cache file needs to be
+    // written. This requires the complete maps, so read them again if only a
+    // region is in memory.
+    auto fragmentIsCurrent = [this](const QString& JSONFileName) {
+        auto iterator = _aviationMapFragments.constFind(JSONFileName);
+        return (iterator != _aviationMapFragments.constEnd()) && (iterator->fileKey == aviationMapFileKey(JSONFileName));
+    };
+    if (_aviationMapFragmentsRegion.isValid()) {
+        auto fragmentsAreCurrent = (_aviationMapFragments.size() == JSONFileNames.size());
+        foreach(auto JSONFileName, JSONFileNames) {
+            fragmentsAreCurrent = fragmentsAreCurrent && fragmentIsCurrent(JSONFileName);
+        }
+        if (!fragmentsAreCurrent) {
+            readFragments(QRectF());
+        }
+    }
 
-    // First, create a set of JSON objects, in order to avoid duplicated entries
-    QSet<QJsonObject> objectSet;
+    // Forget about files that are no longer installed
+    bool fragmentsChanged = false;
+    foreach(auto fileName, _aviationMapFragments.keys()) {
+        if (!JSONFileNames.contains(fileName)) {
+            _aviationMapFragments.remove(fileName);
+            fragmentsChanged = true;
+        }
+    }
+
+    // Parse all files that are new or have changed since they were last
+    // parsed, concurrently, one task per file
+    QMap<QString, QFuture<AviationMapFragment>> futures;
     foreach(auto JSONFileName, JSONFileNames) {
-        // Read the lock file
-        QLockFile lockFile(JSONFileName+".lock");
-        lockFile.lock();
-        QFile file(JSONFileName);
-        file.open(QIODevice::ReadOnly);
-        auto document = QJsonDocument::fromJson(file.readAll());
-        file.close();
-        lockFile.unlock();
-
-        foreach(auto value, document.object()["features"].toArray()) {
-            auto object = value.toObject();
+        if (!fragmentIsCurrent(JSONFileName)) {
+            futures.insert(JSONFileName, QtConcurrent::run(&GeoMaps::GeoMapProvider::parseAviationMap, JSONFileName));
+        }
+    }
+    for(auto iterator = futures.begin(); iterator != futures.end(); ++iterator) {
+        iterator.value().waitForFinished();
+        _aviationMapFragments.insert(iterator.key(), iterator.value().result());
+        fragmentsChanged = true;
+    }
+    if (fragmentsChanged) {
+        writeAviationDataCache(_aviationMapFragments);
+    }
+
+    // Keep only the features in the region
+    if (region.isValid() && !_aviationMapFragmentsRegion.isValid()) {
+        for(auto& fragment : _aviationMapFragments) {
+            fragment.restrictTo(region);
+        }
+        _aviationMapFragmentsRegion = region;
+    }
+
+    // Merge parsed maps into a new snapshot, and generate spatial, search and
+    // hash indices for airspaces and waypoints
+    auto newData = std::make_shared<AviationData>();
+    mergeAviationMaps(JSONFileNames, _aviationMapFragments, hideUpperAirspaces, *newData);
+    newData->buildIndices();
+
+    // Publish new snapshot. Readers that still hold the old snapshot can
+    // continue to use it; it is deleted once the last reader lets go.
+    std::atomic_store(&_aviationData_, std::shared_ptr<const AviationData>(newData));
+
+    // In low-memory mode, do not keep the parsed maps. They are read from the
+    // cache file on the next run.
+    if (!_keepAviationMapFragments) {
+        _aviationMapFragments.clear();
+        _aviationMapFragmentsRead = false;
+    }
+    qint64 fragmentsMemoryUsage = 0;
+    foreach(const auto& fragment, _aviationMapFragments) {
+        fragmentsMemoryUsage += fragment.memoryUsage();
+    }
+    _aviationMapFragmentsMemoryUsage = fragmentsMemoryUsage;
+
+    emit geoJSONChanged();
+}
+
 
+void GeoMaps::GeoMapProvider::mergeAviationMaps(const QStringList& JSONFileNames, const QHash<QString, AviationMapFragment>& fragments, bool hideUpperAirspaces, AviationData& data)
+{
+    // Collect the features of all maps, and generate new lists of waypoints
+    // and airspaces, ignoring duplicated entries. Features with the same key
+    // are compared in full, so that distinct features whose keys happen to
+    // agree are all kept.
+    QHash<QByteArray, QVector<std::string_view>> featuresByKey;
+    QVector<const Airspace*> featureAirspaces;
+    foreach(auto JSONFileName, JSONFileNames) {
+        auto iterator = fragments.constFind(JSONFileName);
+        if (iterator == fragments.constEnd()) {
+            continue;
+        }
+        data.featureBuffers.append(iterator->buffer);
+        const char* buffer = data.featureBuffers.last().constData();
+        for(const auto& feature : iterator->features) {
             // If 'hideUpperAirspaces' is set, ignore all objects that are airspaces
             // and that begin at FL100 or above.
-            if (hideUpperAirspaces) {
-                Airspace airspaceTest(object);
-                if (airspaceTest.isUpper()) {
-                    continue;
-                }
+            if (hideUpperAirspaces && feature.airspace.isValid() && feature.airspace.isUpper()) {
+                continue;
+            }
+            std::string_view json(buffer+feature.jsonOffset, feature.jsonSize);
+            auto& featuresWithKey = featuresByKey[feature.key];
+            if (featuresWithKey.contains(json)) {
+                continue;
+            }
+            featuresWithKey.append(json);
+
+            data.features.append(json);
+            data.featureBoundingBoxes.append(feature.boundingBox);
+            featureAirspaces.append(feature.airspace.isValid() ? &feature.airspace : nullptr);
+
+            if (feature.waypoint.isValid()) {
+                data.waypoints.append(feature.waypoint);
+                continue;
+            }
+            if (feature.airspace.isValid()) {
+                data.airspaces.append(feature.airspace);
+                continue;
             }
-            objectSet += object;
         }
     }
 
+    // Simplify airspace boundaries for the lower levels of detail
+    data.buildSimplifiedFeatures(featureAirspaces);
+
+    // Sort waypoints by name
+    std::sort(data.waypoints.begin(), data.waypoints.end(), [](const Waypoint &a, const Waypoint &b) {return a.name() < b.name(); });
+}
+
+
+auto GeoMaps::GeoMapProvider::aviationMapFileKey(const QString& fileName) -> QString
+{
+    QFileInfo info(fileName);
+    return QStringLiteral("%1|%2").arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+}
+
+
+auto GeoMaps::GeoMapProvider::aviationDataCacheFileName() -> QString
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)+"/aviationData.dat";
+}
+
+
+auto GeoMaps::GeoMapProvider::readAviationDataCache(QHash<QString, AviationMapFragment>& fragments, const QRectF& region) -> bool
+{
+    auto fileName = aviationDataCacheFileName();
+    QLockFile lockFile(fileName+".lock");
+    lockFile.lock();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // Map the file into memory, in order to avoid copying
+    auto *fileData = file.map(0, file.size());
+    if (fileData == nullptr) {
+        return false;
+    }
+    auto bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(fileData), static_cast<int>(file.size()));
+    QDataStream inputStream(bytes);
+    inputStream.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 numFragments = 0;
+    inputStream >> magic;
+    inputStream >> version;
+    inputStream >> numFragments;
+    auto success = (inputStream.status() == QDataStream::Ok) &&
+            (magic == aviationDataCacheMagic) && (version == aviationDataCacheVersion) &&
+            (numFragments >= 0);
+    for(int i=0; success && (i<numFragments); i++) {
+        QString JSONFileName;
+        AviationMapFragment fragment;
+        inputStream >> JSONFileName;
+        success = fragment.read(inputStream, region);
+        fragments.insert(JSONFileName, fragment);
+    }
+
+    file.unmap(fileData);
+    return success;
+}
 
-    // Then, create a new JSONArray of features and a new list of waypoints
-    QJsonArray newFeatures;
-    QVector<Airspace> newAirspaces;
-    QVector<Waypoint> newWaypoints;
-    foreach(auto object, objectSet) {
-        newFeatures += object;
 
-        // Check if the current object is a waypoint. If so, add it to the list of waypoints.
-        Waypoint wp(object);
-        if (wp.isValid()) {
-            newWaypoints.append(wp);
+void GeoMaps::GeoMapProvider::writeAviationDataCache(const QHash<QString, AviationMapFragment>& fragments)
+{
+    auto fileName = aviationDataCacheFileName();
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QLockFile lockFile(fileName+".lock");
+    if (!lockFile.tryLock()) {
+        return;
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << aviationDataCacheMagic;
+    out << aviationDataCacheVersion;
+    out << static_cast<qint32>(fragments.size());
+    for(auto iterator = fragments.constBegin(); iterator != fragments.constEnd(); ++iterator) {
+        out << iterator.key();
+        iterator.value().write(out);
+    }
+    file.commit();
+}
+
+
+auto GeoMaps::GeoMapProvider::parseAviationMap(const QString& fileName) -> AviationMapFragment
+{
+    AviationMapFragment result;
+    result.fileKey = aviationMapFileKey(fileName);
+
+    // Read the file, honoring the lock file
+    QLockFile lockFile(fileName+".lock");
+    lockFile.lock();
+    QFile file(fileName);
+    file.open(QIODevice::ReadOnly);
+    auto fileData = file.readAll();
+    file.close();
+    lockFile.unlock();
+
+    // Find the features without building a DOM of the whole file, and parse
+    // them in parallel, in blocks of consecutive features. Each block has its
+    // own string pool and buffer.
+    const auto ranges = JSONScanner::arrayElements(fileData, QByteArrayLiteral("features"));
+    QVector<QPair<int,int>> blocks;
+    for(int first=0; first<ranges.size(); first += featuresPerBlock) {
+        blocks.append({first, qMin(first+featuresPerBlock, ranges.size())});
+    }
+    auto parseBlock = [&fileData, &ranges](const QPair<int,int>& block) {
+        AviationMapFragment blockResult;
+        blockResult.features.reserve(block.second-block.first);
+        blockResult.buffer.reserve(ranges[block.second-1].first+ranges[block.second-1].second-ranges[block.first].first);
+        StringPool pool;
+        for(int i=block.first; i<block.second; i++) {
+            auto object = QJsonDocument::fromJson(QByteArray::fromRawData(fileData.constData()+ranges[i].first, ranges[i].second)).object();
+
+            // Check if the current object is a waypoint or an airspace
+            AviationMapFragment::Feature feature;
+            feature.waypoint = Waypoint(object);
+            if (!feature.waypoint.isValid()) {
+                feature.airspace = Airspace(object, &pool);
+            }
+
+            // Features without coordinates cannot be shown or found, and
+            // would otherwise end up in the chunk at the origin
+            auto boundingBox = featureBoundingBox(object);
+            if (!boundingBox) {
+                continue;
+            }
+
+            feature.key = featureKey(object);
+            feature.boundingBox = *boundingBox;
+            auto json = QJsonDocument(object).toJson(QJsonDocument::JsonFormat::Compact);
+            feature.jsonOffset = blockResult.buffer.size();
+            feature.jsonSize = json.size();
+            blockResult.buffer += json;
+            blockResult.features.append(std::move(feature));
+        }
+        return blockResult;
+    };
+    const auto blockResults = QtConcurrent::blockingMapped<QVector<AviationMapFragment>>(blocks, parseBlock);
+
+    // Concatenate the blocks, and compute the bounds of the file. The compact
+    // JSON of the features is at most as large as the file.
+    result.features.reserve(ranges.size());
+    result.buffer.reserve(fileData.size());
+    QPointF minimum(180.0, 90.0);
+    QPointF maximum(-180.0, -90.0);
+    for(const auto& blockResult : blockResults) {
+        auto offset = result.buffer.size();
+        for(auto feature : blockResult.features) {
+            minimum = QPointF(qMin(minimum.x(), feature.boundingBox.left()), qMin(minimum.y(), feature.boundingBox.top()));
+            maximum = QPointF(qMax(maximum.x(), feature.boundingBox.right()), qMax(maximum.y(), feature.boundingBox.bottom()));
+            feature.jsonOffset += offset;
+            result.features.append(std::move(feature));
+        }
+        result.buffer += blockResult.buffer;
+    }
+    result.buffer.squeeze();
+    if ((minimum.x() <= maximum.x()) && (minimum.y() <= maximum.y())) {
+        result.bounds = QRectF(minimum, maximum);
+    }
+    return result;
+}
+
+
+auto GeoMaps::GeoMapProvider::featureKey(const QJsonObject& object) -> QByteArray
+{
+    const auto properties = object[QStringLiteral("properties")].toObject();
+    const auto geometry = object[QStringLiteral("geometry")].toObject();
+
+    QByteArray key = geometry[QStringLiteral("type")].toString().toUtf8();
+    for(const auto* propertyName : {"TYP", "CAT", "NAM", "COD", "BOT", "TOP"}) {
+        key += '|';
+        key += properties[QLatin1String(propertyName)].toString().toUtf8();
+    }
+
+    // Descend into the coordinate arrays, recording their sizes, until the
+    // first coordinate pair is found
+    auto coordinates = geometry[QStringLiteral("coordinates")];
+    while (coordinates.isArray()) {
+        const auto array = coordinates.toArray();
+        key += '|';
+        key += QByteArray::number(array.size());
+        if (array.isEmpty()) {
+            break;
+        }
+        if (array[0].isArray()) {
+            coordinates = array[0];
             continue;
         }
+        for(const auto& number : array) {
+            key += '|';
+            key += QByteArray::number(number.toDouble(), 'f', 7);
+        }
+        break;
+    }
 
-        // Check if the current object is an airspace. If so, add it to the list of airspaces.
-        Airspace as(object);
-        if (as.isValid()) {
-            newAirspaces.append(as);
+    return key;
+}
+
+
+auto GeoMaps::GeoMapProvider::featureBoundingBox(const QJsonObject& object) -> std::optional<QRectF>
+{
+    double minLongitude = 180.0;
+    double maxLongitude = -180.0;
+    double minLatitude = 90.0;
+    double maxLatitude = -90.0;
+
+    // Walk through the nested coordinate arrays, and look at all coordinate
+    // pairs
+    QVector<QJsonArray> stack;
+    stack.append(object[QStringLiteral("geometry")].toObject()[QStringLiteral("coordinates")].toArray());
+    while (!stack.isEmpty()) {
+        const auto array = stack.takeLast();
+        if (array.isEmpty()) {
+            continue;
+        }
+        if (array[0].isArray()) {
+            for(const auto& value : array) {
+                stack.append(value.toArray());
+            }
+            continue;
+        }
+        if (array.size() < 2) {
             continue;
         }
+        minLongitude = qMin(minLongitude, array[0].toDouble());
+        maxLongitude = qMax(maxLongitude, array[0].toDouble());
+        minLatitude = qMin(minLatitude, array[1].toDouble());
+        maxLatitude = qMax(maxLatitude, array[1].toDouble());
     }
-    QJsonObject resultObject;
-    resultObject.insert(QStringLiteral("type"), "FeatureCollection");
-    resultObject.insert(QStringLiteral("features"), newFeatures);
-    QJsonDocument geoDoc(resultObject);
 
-    // Sort waypoints by name
-    std::sort(newWaypoints.begin(), newWaypoints.end(), [](const Waypoint &a, const Waypoint &b) {return a.name() < b.name(); });
+    if ((minLongitude > maxLongitude) || (minLatitude > maxLatitude)) {
+        return {};
+    }
+    return QRectF(QPointF(minLongitude, minLatitude), QPointF(maxLongitude, maxLatitude));
+}
 
-    _aviationDataMutex.lock();
-    _airspaces_ = newAirspaces;
-    _waypoints_ = newWaypoints;
-    _combinedGeoJSON_ = geoDoc.toJson(QJsonDocument::JsonFormat::Compact);
-    _aviationDataMutex.unlock();
 
-    emit geoJSONChanged();
+void GeoMaps::GeoMapProvider::tileCacheSizeChanged()
+{
+    auto maxSize = static_cast<qint64>(Global::settings()->tileCacheSize())*1024*1024;
+    if (Global::memoryBudget()->lowMemoryMode()) {
+        maxSize /= 4;
+    }
+    _tileServer.tileCache()->setMaxSize(maxSize);
+}
+
+
+void GeoMaps::GeoMapProvider::trimCaches()
+{
+    _keepAviationMapFragments = !Global::memoryBudget()->lowMemoryMode();
+
+    // Empty the tile cache
+    _tileServer.tileCache()->setMaxSize(0);
+    tileCacheSizeChanged();
+
+    // Let go of airspace caches, which might hold an old snapshot
+    ensureAirspaceCacheIsCurrent(nullptr);
+
+    // Drop the parsed aviation maps. If fillAviationDataCache() is running,
+    // it will drop them when done, provided that we are in low-memory mode.
+    if (!_aviationDataCacheFuture.isRunning()) {
+        _aviationMapFragments.clear();
+        _aviationMapFragmentsRead = false;
+        _aviationMapFragmentsMemoryUsage = 0;
+    }
 }
 
 
 void GeoMaps::GeoMapProvider::deferredInitialization()
 {
+    StartupTracer::Phase phase("GeoMapProvider initialization");
+
     // Connect the WeatherProvider, so aviation maps will be generated
     connect(Global::mapManager()->aviationMaps(), &DownloadableGroup::localFileContentChanged_delayed, this, &GeoMaps::GeoMapProvider::aviationMapsChanged);
     connect(Global::mapManager()->baseMaps(), &DownloadableGroup::localFileContentChanged_delayed, this, &GeoMaps::GeoMapProvider::baseMapsChanged);
     connect(Global::settings(), &Settings::hideUpperAirspacesChanged, this, &GeoMaps::GeoMapProvider::aviationMapsChanged);
 
+    // Set size of the tile cache, and keep it in sync with the settings
+    connect(Global::settings(), &Settings::tileCacheSizeChanged, this, &GeoMaps::GeoMapProvider::tileCacheSizeChanged);
+    connect(Global::memoryBudget(), &MemoryBudget::lowMemoryModeChanged, this, &GeoMaps::GeoMapProvider::tileCacheSizeChanged);
+    tileCacheSizeChanged();
+
+    // Drop caches when memory is low
+    connect(Global::memoryBudget(), &MemoryBudget::trimCaches, this, &GeoMaps::GeoMapProvider::trimCaches);
+
     _aviationDataCacheTimer.setSingleShot(true);
     _aviationDataCacheTimer.setInterval(3s);
     connect(&_aviationDataCacheTimer, &QTimer::timeout, this, &GeoMaps::GeoMapProvider::aviationMapsChanged);
 
+    // In regional mode, load the aviation data near the position and the route
+    connect(Global::settings(), &Settings::loadAviationDataByRegionChanged, this, &GeoMaps::GeoMapProvider::updateAviationDataRegion);
+    connect(Positioning::PositionProvider::globalInstance(), &Positioning::PositionProvider::lastValidCoordinateChanged, this, &GeoMaps::GeoMapProvider::updateAviationDataRegion);
+    connect(Global::navigator()->flightRoute(), &Navigation::FlightRoute::waypointsChanged, this, &GeoMaps::GeoMapProvider::updateAviationDataRegion);
+
+    // Describe new maps in the background, so the info dialog opens without delay
+    connect(Global::mapManager()->aviationMaps(), &DownloadableGroup::localFileContentChanged_delayed, this, &GeoMaps::GeoMapProvider::precomputeMapDescriptions);
+    connect(Global::mapManager()->baseMaps(), &DownloadableGroup::localFileContentChanged_delayed, this, &GeoMaps::GeoMapProvider::precomputeMapDescriptions);
+
     aviationMapsChanged();
     baseMapsChanged();
 }
+
+
+void GeoMaps::GeoMapProvider::precomputeMapDescriptions()
+{
+    auto fileNames = Global::mapManager()->aviationMaps()->files()+Global::mapManager()->baseMaps()->files();
+    QtConcurrent::run([fileNames]() {
+        foreach(auto fileName, fileNames) {
+            describeMapFile(fileName);
+        }
+    });
+}
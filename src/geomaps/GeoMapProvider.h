@@ -22,21 +22,24 @@
 
 #include <QFuture>
 #include <QGeoCoordinate>
+#include <QGeoShape>
 #include <QJsonArray>
 #include <QMutex>
-#include <QMutexLocker>
 #include <QPointer>
-#include <QRegularExpression>
-#include <QTemporaryFile>
+#include <atomic>
+#include <memory>
+#include <optional>
 
-#include "Airspace.h"
+#include "AviationData.h"
+#include "AviationDataQuery.h"
 #include "Librarian.h"
 #include "MapManager.h"
 #include "Settings.h"
-#include "Waypoint.h"
+#include "TilePrefetcher.h"
 #include "TileServer.h"
 
 
+class Benchmark;
 class Librarian;
 class SatNav;
 class Waypoint;
@@ -54,16 +57,19 @@ namespace GeoMaps {
  * MapManager and provides them for use in MapBoxGL powered maps. The data is
  * served via two channels.
  *
- * - All files in GeoJSON format are concatenated, and the resulting compound
- *   GeoJSON is served via the geoJSON property of this class.
+ * - All files in GeoJSON format are concatenated. The features near the
+ *   region shown on the map are served as a compound GeoJSON via the geoJSON
+ *   property of this class.
  *
  * - A list of waypoints is generated and available via the waypoints property
  *
  * - All files in MBTiles format are served via an embedded TileServer that
- *   listens to a free port on address 127.0.0.1. The GeoMapProvider generates a
- *   mapbox style file whose source element points to the URL of that
- *   TileServer. The URL of the style file is served via the property
- *   styleFileURL property of this class.
+ *   listens to address 127.0.0.1, preferably on port preferredTileServerPort.
+ *   The GeoMapProvider generates a mapbox style file whose source element
+ *   points to the URL of that TileServer. The URL of the style file is served
+ *   via the property styleFileURL property of this class. Tile paths and
+ *   style files only change if the set of MBTiles files changes, so that the
+ *   caches of the map renderer remain valid after a restart.
  */
 
 class GeoMapProvider : public QObject
@@ -100,6 +106,27 @@ public:
         return {};
     }
 
+    /*! \brief Inform the GeoMapProvider about the zoom level of the map
+     *
+     *  The zoom level is used to prefetch tiles along the flight path, and to
+     *  choose the level of detail of the airspace boundaries in the property
+     *  geoJSON, see AviationData::levelOfDetail().
+     *
+     *  @param zoomLevel Current zoom level of the map
+     */
+    Q_INVOKABLE void setMapZoomLevel(double zoomLevel);
+
+    /*! \brief Inform the GeoMapProvider about the region shown on the map
+     *
+     *  The property geoJSON contains only features near this region. The
+     *  region is rounded up to chunks of AviationData::chunkSizeInDegrees, so
+     *  that the property changes only if the map has moved by a substantial
+     *  distance.
+     *
+     *  @param region Region currently shown on the map
+     */
+    Q_INVOKABLE void setMapViewport(const QGeoShape& region);
+
 
     //
     // Properties
@@ -115,7 +142,65 @@ public:
      */
     Q_INVOKABLE QVariantList airspaces(const QGeoCoordinate& position);
 
+    /*! \brief List of airspaces ahead of the own aircraft
+     *
+     * This method extrapolates the present position of the own aircraft along
+     * the present true track, at the present ground speed, and lists all
+     * airspaces that the aircraft will meet within the given time. The result
+     * is only recomputed if the track or the ground speed change, or if the
+     * aircraft has covered a good part of the predicted path.
+     *
+     * @param minutes Look-ahead time, in minutes
+     *
+     * @returns Airspaces ahead, in the order in which they will be met. If no
+     * track or ground speed is known, the list is empty.
+     */
+    Q_INVOKABLE QVariantList airspacesAhead(int minutes);
+
+    /*! \brief List of airspaces around the own aircraft, at its altitude
+     *
+     * This method lists the airspaces that meet a vertical cylinder around
+     * the present position of the own aircraft. The cylinder reaches from
+     * verticalMarginFt below to verticalMarginFt above the pressure altitude,
+     * or the true altitude if no pressure altitude is known. The margin
+     * covers the difference between pressure altitude and altitude above
+     * MSL. If no altitude is known at all, the vertical limits are ignored.
+     * The query is cheap enough to be evaluated on every position fix.
+     *
+     * @param radiusM Radius of the cylinder, in meters
+     *
+     * @param verticalMarginFt Vertical margin, in feet
+     *
+     * @returns Airspaces around the own aircraft, sorted by decreasing lower
+     * boundary. If no position is known, the list is empty.
+     *
+     * @see AviationDataQuery::airspaces
+     */
+    Q_INVOKABLE QVariantList airspacesAroundOwnship(double radiusM, double verticalMarginFt);
+
+    /*! \brief List of airspaces along a line segment
+     *
+     * This method is typically used with the legs of a flight route. Results
+     * are cached by segment, so that repeated calls for the legs of a route
+     * are cheap.
+     *
+     * @param start Start point of the segment
+     *
+     * @param end End point of the segment
+     *
+     * @returns Airspaces met by the segment, in the order in which they are
+     * met
+     *
+     * @see Airspace::entryFractionAlong
+     */
+    Q_INVOKABLE QVariantList airspacesAlong(const QGeoCoordinate& start, const QGeoCoordinate& end);
+
     /*! \brief Find closest waypoint to a given position
+     *
+     * Besides the waypoints of the aviation maps, this method considers the
+     * waypoints of the current flight route. It must therefore only be called
+     * from the GUI thread. Other threads can use
+     * AviationDataQuery::closestWaypoint() instead.
      *
      * @param position Position near which waypoints are searched for
      *
@@ -128,6 +213,30 @@ public:
      */
     Q_INVOKABLE GeoMaps::Waypoint closestWaypoint(QGeoCoordinate position, const QGeoCoordinate& distPosition);
 
+    /*! \brief Snap positions to known waypoints
+     *
+     * This method is meant for the import of routes and tracks. It looks up
+     * the closest known waypoint for every position, using the spatial index
+     * of the current aviation data. Unlike closestWaypoint(), it does not
+     * consider the waypoints of the current flight route. The method is
+     * thread-safe.
+     *
+     * @see AviationDataQuery::snapToWaypoints
+     *
+     * @param positions Positions that are to be snapped
+     *
+     * @param snapRadiusM Maximal distance between a position and the waypoint
+     * it is snapped to, in meters
+     *
+     * @returns List with one entry for every position: the closest known
+     * waypoint if it lies within snapRadiusM, and a generic Waypoint with the
+     * appropriate coordinate otherwise
+     */
+    QVector<GeoMaps::Waypoint> snapToWaypoints(const QVector<QGeoCoordinate>& positions, double snapRadiusM = defaultSnapRadiusM) const;
+
+    /*! \brief Default snap radius for snapToWaypoints(), in meters */
+    static constexpr double defaultSnapRadiusM = 1100.0;
+
     /*! \brief Copyright notice for the map
      *
      * This property holds the copyright notice for the installed aviation
@@ -146,14 +255,12 @@ public:
 
     /*! \brief Describe installed map
      *
-     * This method describes installed GeoJSON map files.
+     * This method describes installed map files, in GeoJSON or MBTILES
+     * format. Descriptions are cached by file name, together with size and
+     * modification time of the file, and are computed in the background
+     * whenever maps are installed. This method is thread-safe.
      *
-     * @warning The data is only updated
-     * after the maps have been parsed in the GeoJSON parsing process. It is
-     * therefore possible that the method returns wrong information if it is
-     * called directly after a new map has been installed.
-     *
-     * @param fileName Name of a GeoJSON file.
+     * @param fileName Name of a map file.
      *
      * @returns A human-readable HTML string, or an empty string if no data is available
      */
@@ -164,9 +271,10 @@ public:
      * @param filter List of words
      *
      * @returns all those waypoints whose fullName or codeName contains each of
-     * the words in filter.  In order to make the result accessible to QML, the
-     * list is returned as QList<QObject*>. It can thus be used as a data model
-     * in QML.
+     * the words in filter.  Exact matches of the codeName come first, followed
+     * by prefix matches and then by all other matches. In order to make the
+     * result accessible to QML, the list is returned as QList<QObject*>. It can
+     * thus be used as a data model in QML.
      */
     Q_INVOKABLE QVariantList filteredWaypointObjects(const QString &filter);
 
@@ -181,10 +289,24 @@ public:
      */
     Waypoint findByID(const QString& id);
 
-    /*! \brief Union of all aviation maps in GeoJSON format
+    /*! Find waypoints by their ICAO codes
+     *
+     * This method is equivalent to calling findByID() for every element of the
+     * list, but accesses the aviation data only once.
+     *
+     * @param ids List of ICAO codes
      *
-     * This property holds all installed aviation maps in GeoJSON format,
-     * combined into one GeoJSON document.
+     * @returns List of waypoints, of the same length as ids. The list contains
+     * invalid waypoints for those codes where no waypoint has been found.
+     */
+    QVector<Waypoint> findByIDs(const QStringList& ids);
+
+    /*! \brief Union of all aviation maps in GeoJSON format, near the map
+     *
+     * This property holds those features of the installed aviation maps that
+     * are near the region set with setMapViewport(), combined into one GeoJSON
+     * document. As long as no region has been set, the property holds all
+     * features. The property must only be accessed from the GUI thread.
      */
     Q_PROPERTY(QByteArray geoJSON READ geoJSON NOTIFY geoJSONChanged)
 
@@ -192,10 +314,7 @@ public:
      *
      * @returns Property geoJSON
      */
-    QByteArray geoJSON() {
-        QMutexLocker lock(&_aviationDataMutex);
-        return _combinedGeoJSON_;
-    }
+    QByteArray geoJSON();
 
     /*! List of nearby waypoints
      *
@@ -231,9 +350,59 @@ public:
      * @returns a list of all waypoints known to this GeoMapProvider (that is,
      * the union of all waypoints in any of the installed maps)
      */
-    QVector<Waypoint> waypoints() {
-        QMutexLocker locker(&_aviationDataMutex);
-        return _waypoints_;
+    QVector<Waypoint> waypoints() const
+    {
+        return aviationData()->waypoints;
+    }
+
+    /*! \brief Snapshot of the aviation data
+     *
+     * This method is thread-safe. The snapshot returned is never modified and
+     * can be used from any thread, for as long as the caller holds the
+     * pointer. Newer data is published as a new snapshot, together with the
+     * signal geoJSONChanged().
+     *
+     * @returns Pointer to the current snapshot of the aviation data. The
+     * pointer is guaranteed to be valid.
+     */
+    std::shared_ptr<const AviationData> aviationData() const
+    {
+        return std::atomic_load(&_aviationData_);
+    }
+
+    /*! \brief Query object for the current snapshot of the aviation data
+     *
+     * This method is thread-safe. It is meant for background pipelines, such
+     * as traffic or weather processing, that need to look up airspaces or
+     * waypoints without going through the GUI thread.
+     *
+     * @returns Query object for the snapshot returned by aviationData()
+     */
+    AviationDataQuery aviationDataQuery() const
+    {
+        return AviationDataQuery(aviationData());
+    }
+
+    /*! \brief Estimated memory used by the aviation data
+     *
+     * The estimate counts the current snapshot of the aviation data and the
+     * parsed aviation maps kept by fillAviationDataCache(). It is used by
+     * MemoryBudget.
+     *
+     * @returns Estimated memory usage in bytes
+     */
+    qint64 aviationDataMemoryUsage() const
+    {
+        return aviationData()->memoryUsage() + _aviationMapFragmentsMemoryUsage;
+    }
+
+    /*! \brief Memory used by the tile cache of the tile server
+     *
+     * @returns Total size of the tile data in the cache, in bytes
+     */
+    qint64 tileCacheMemoryUsage()
+    {
+        return _tileServer.tileCache()->size();
     }
 
 signals:
@@ -252,9 +421,8 @@ private slots:
 private:
     Q_DISABLE_COPY_MOVE(GeoMapProvider)
 
-    // Caches used to speed up the method simplifySpecialChars
-    QRegularExpression specialChars {QStringLiteral("[^a-zA-Z0-9]")};
-    QHash<QString, QString> simplifySpecialChars_cache;
+    // The benchmark "geomaps" calls fillAviationDataCache() directly
+    friend class ::Benchmark;
 
     // This slot is called every time the the set of GeoJSON files changes. It
     // fills the aviation data cache.
@@ -262,23 +430,138 @@ private:
 
     // Interal function that does most of the work for aviationMapsChanged() emits
     // geoJSONChanged() when done. This function is meant to be run in a separate
-    // thread.
-    void fillAviationDataCache(const QStringList& JSONFileNames, bool hideUpperAirspaces);
+    // thread. It parses only those files that have changed since they were last
+    // parsed, and merges the parsed maps into a new snapshot. If region is
+    // valid, only the features in that region are kept in memory and merged;
+    // the cache file always holds the complete maps.
+    void fillAviationDataCache(const QStringList& JSONFileNames, bool hideUpperAirspaces, const QRectF& region = QRectF());
+
+    // Region of the aviation data that should be loaded, in the coordinates of
+    // AviationMapFragment::Feature::boundingBox. If the setting
+    // loadAviationDataByRegion is set, this is the region around the last
+    // valid position and the current flight route, extended by
+    // regionMarginInDegrees and rounded outward to whole chunks. Otherwise,
+    // or if neither position nor route are known, an invalid rectangle is
+    // returned, which stands for all data.
+    static QRectF aviationDataRegion();
+    static constexpr double regionMarginInDegrees = 3.0;
+
+    // Key that identifies the content of a GeoJSON file, computed from file
+    // size and modification time
+    static QString aviationMapFileKey(const QString& fileName);
+
+    // Computes the description returned by describeMapFile(), without using
+    // the cache
+    static QString describeMapFileUncached(const QString& fileName);
+
+    // Reads the member "info" of a GeoJSON file. The file is read in blocks,
+    // and reading stops as soon as the member has been found. Returns an
+    // empty string on error.
+    static QString readMapInfo(const QString& fileName);
+
+    // Computes the descriptions of all installed maps in a separate thread,
+    // so that describeMapFile() can later answer from the cache
+    void precomputeMapDescriptions();
+
+    // Cache for describeMapFile(). The key is the file name, the value a pair
+    // of aviationMapFileKey() and description. Must only be accessed with
+    // describeMapFileCacheMutex locked.
+    static QMutex describeMapFileCacheMutex;
+    static QHash<QString, QPair<QString,QString>> describeMapFileCache;
+
+    // Magic number and format version of the cache file
+    static constexpr quint32 aviationDataCacheMagic = 0x41564941;
+    static constexpr quint32 aviationDataCacheVersion = 6;
+
+    // Name of the file that caches the parsed aviation maps
+    static QString aviationDataCacheFileName();
+
+    // Reads parsed aviation maps from the cache file. If region is valid, only
+    // the features in that region are kept. Returns true on success, and false
+    // if the file cannot be read or is corrupt.
+    static bool readAviationDataCache(QHash<QString, AviationMapFragment>& fragments, const QRectF& region = QRectF());
+
+    // Writes parsed aviation maps to the cache file. This method fails
+    // silently on error.
+    static void writeAviationDataCache(const QHash<QString, AviationMapFragment>& fragments);
+
+    // Merges parsed aviation maps, in the order given by JSONFileNames, and
+    // fills the GeoJSON document and the lists of waypoints and airspaces in
+    // data. Features that appear in more than one file are added only once. If
+    // hideUpperAirspaces is set, airspaces that begin at FL100 or above are
+    // ignored.
+    static void mergeAviationMaps(const QStringList& JSONFileNames, const QHash<QString, AviationMapFragment>& fragments, bool hideUpperAirspaces, AviationData& data);
+
+    // Reads and parses a single GeoJSON file. This method is reentrant;
+    // fillAviationDataCache() runs it concurrently for all changed files. The
+    // features are located with JSONScanner and parsed in parallel, in blocks
+    // of featuresPerBlock features.
+    static AviationMapFragment parseAviationMap(const QString& fileName);
+    static constexpr int featuresPerBlock = 512;
+
+    // Computes a key for a GeoJSON feature, from its type, the main properties
+    // and the first coordinate of its geometry. Features that appear in more
+    // than one map file have identical keys. This is much cheaper than hashing
+    // the whole object. Distinct features may also have identical keys, so
+    // mergeAviationMaps() compares features with the same key in full.
+    static QByteArray featureKey(const QJsonObject& object);
+
+    // Computes the bounding box of the geometry of a GeoJSON feature, as
+    // described in AviationMapFragment::Feature. Returns std::nullopt if the
+    // feature has no coordinates.
+    static std::optional<QRectF> featureBoundingBox(const QJsonObject& object);
 
     // This slot is called every time the the set of MBTile files changes. It
-    // sets up the tile server to and generates a new style file.
-    void baseMapsChanged();
+    // sets up the tile server to and generates a new style file. If the set of
+    // installed files is unchanged, only the content of changedBaseMaps has
+    // changed and the path computed by tileSetPath() is still the same, the
+    // tile server merely reopens these files.
+    void baseMapsChanged(const QVector<QPointer<GeoMaps::Downloadable>>& changedBaseMaps = {});
+
+    // This slot is called every time the tile cache size changes in the
+    // settings, and when the app enters low-memory mode. It sets the size of
+    // the tile server's cache. In low-memory mode, the cache is a quarter of
+    // the size set in the settings.
+    void tileCacheSizeChanged();
+
+    // This slot is connected to MemoryBudget::trimCaches(). It empties the
+    // tile cache, the caches of airspacesAlong() and airspacesAhead(), and
+    // drops the parsed aviation maps, which are read again from the cache
+    // file when needed.
+    void trimCaches();
+
+    // This slot is called when the position, the flight route or the setting
+    // loadAviationDataByRegion change. If the region returned by
+    // aviationDataRegion() differs from the region of the current aviation
+    // data, new aviation data is generated.
+    void updateAviationDataRegion();
 
     // This is the path under which is tiles are available on the
-    // _tileServer. This is set to a random number that changes every time the
-    // set of MBTile files changes
+    // _tileServer. This is computed from the names, sizes and modification
+    // times of the MBTile files, so that it remains the same for as long as
+    // these files do not change, even after a restart.
     QString _currentPath;
 
+    // Returns the path for a set of MBTile files, as described for _currentPath
+    static QString tileSetPath(const QVector<QPointer<Downloadable>>& baseMaps);
+
+    // Port at which the tile server listens, if available. Using the same
+    // port on every start keeps the URLs of the tiles stable.
+    static constexpr quint16 preferredTileServerPort = 3470;
+
+    // Base maps served under _currentPath
+    QVector<QPointer<Downloadable>> _currentBaseMaps;
+
     // Tile Server
     TileServer _tileServer;
 
-    // Temporary file that holds the current style file
-    QPointer<QTemporaryFile> _styleFile;
+    // Prefetches tiles along the flight path into the cache of _tileServer
+    TilePrefetcher _tilePrefetcher {&_tileServer};
+
+    // Name of the file that holds the current style file, or an empty string
+    // if there is none. The file is kept in the cache directory, and its name
+    // is derived from its content, so that an unchanged style file is reused.
+    QString _styleFileName;
 
     //
     // Aviation Data Cache
@@ -286,13 +569,63 @@ private:
     QFuture<void>    _aviationDataCacheFuture; // Future; indicates if fillAviationDataCache() is currently running
     QTimer           _aviationDataCacheTimer;  // Timer used to start another run of fillAviationDataCache()
 
-    // The data in this group is accessed by several threads. The following classes
-    // (whose names ends in an underscore) are therefore
-    // protected by this mutex.
-    QMutex           _aviationDataMutex;
-    QByteArray       _combinedGeoJSON_; // Cache: GeoJSON
-    QVector<Waypoint> _waypoints_;       // Cache: Waypoints
-    QVector<Airspace> _airspaces_;       // Cache: Airspaces
+    // Parsed aviation maps, by file name. These members are only accessed from
+    // within fillAviationDataCache(), which never runs twice at the same time.
+    QHash<QString, AviationMapFragment> _aviationMapFragments;
+    bool _aviationMapFragmentsRead {false};
+
+    // Region to which the features of _aviationMapFragments are restricted,
+    // or an invalid rectangle if the fragments are complete. This member is
+    // only accessed from within fillAviationDataCache().
+    QRectF _aviationMapFragmentsRegion;
+
+    // Region passed to the last run of fillAviationDataCache(). This member
+    // is only accessed from the GUI thread.
+    QRectF _aviationDataRegion;
+
+    // Estimated memory usage of _aviationMapFragments, as computed at the end
+    // of fillAviationDataCache()
+    std::atomic<qint64> _aviationMapFragmentsMemoryUsage {0};
+
+    // If false, fillAviationDataCache() drops _aviationMapFragments when
+    // done. This is the case in low-memory mode.
+    std::atomic<bool> _keepAviationMapFragments {true};
+
+    // Converts indices into a list of airspaces, as expected by QML
+    static QVariantList airspaceList(const AviationData& data, const QVector<int>& indices);
+
+    // Clears the caches used by airspacesAlong() and airspacesAhead() if they
+    // refer to an older snapshot than data
+    void ensureAirspaceCacheIsCurrent(const std::shared_ptr<const AviationData>& data);
+
+    // Caches for airspacesAlong() and airspacesAhead(). They hold indices into
+    // the airspaces of _airspaceCacheData, and are only accessed from the GUI
+    // thread. Results of airspacesAlong() are stored by segment. For
+    // airspacesAhead(), the predicted path and the associated parameters are
+    // stored.
+    std::shared_ptr<const AviationData> _airspaceCacheData;
+    QHash<QString, QVector<int>> _airspacesAlongCache;
+    static constexpr int maxAirspacesAlongCacheSize = 256;
+    QGeoCoordinate _aheadStart;
+    QGeoCoordinate _aheadEnd;
+    double _aheadTrackDeg {0.0};
+    double _aheadDistanceM {0.0};
+    QVector<int> _aheadIndices;
+
+    // Chunks and level of detail of aviation data shown on the map, as set by
+    // setMapViewport() and setMapZoomLevel(), and cache for geoJSON(). These
+    // members are only accessed from the GUI thread.
+    QRect _viewportChunks {AviationData::allChunks()};
+    int _viewportLevelOfDetail {AviationData::levelsOfDetail-1};
+    std::shared_ptr<const AviationData> _geoJSONData;
+    QRect _geoJSONChunks;
+    int _geoJSONLevelOfDetail {AviationData::levelsOfDetail-1};
+    QByteArray _geoJSON;
+
+    // Current snapshot of the aviation data. This pointer is accessed by
+    // several threads and must only be read and written with std::atomic_load
+    // and std::atomic_store.
+    std::shared_ptr<const AviationData> _aviationData_;
 };
 
 };
@@ -0,0 +1,225 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <cstring>
+
+#include "JSONScanner.h"
+
+
+auto GeoMaps::JSONScanner::arrayElements(const QByteArray& json, const QByteArray& key) -> QVector<QPair<int,int>>
+{
+    QVector<QPair<int,int>> result;
+    int begin = 0;
+    int end = 0;
+    if (!findMember(json, key, begin, end) || (json[begin] != '[')) {
+        return {};
+    }
+
+    auto position = skipWhitespace(json, begin+1);
+    if ((position < end) && (json[position] == ']')) {
+        return {};
+    }
+    while (position < end) {
+        auto elementEnd = skipValue(json, position);
+        if (elementEnd < 0) {
+            return {};
+        }
+        result.append({position, elementEnd-position});
+        position = skipWhitespace(json, elementEnd);
+        if ((position >= end) || (json[position] == ']')) {
+            break;
+        }
+        if (json[position] != ',') {
+            return {};
+        }
+        position = skipWhitespace(json, position+1);
+    }
+    return result;
+}
+
+
+auto GeoMaps::JSONScanner::value(const QByteArray& json, const QByteArray& key) -> QJsonValue
+{
+    int begin = 0;
+    int end = 0;
+    if (!findMember(json, key, begin, end)) {
+        return {QJsonValue::Undefined};
+    }
+
+    // QJsonDocument only parses objects and arrays, so wrap the value into an
+    // array
+    QByteArray wrapped;
+    wrapped.reserve(end-begin+2);
+    wrapped += '[';
+    wrapped.append(json.constData()+begin, end-begin);
+    wrapped += ']';
+    auto document = QJsonDocument::fromJson(wrapped);
+    if (!document.isArray() || document.array().isEmpty()) {
+        return {QJsonValue::Undefined};
+    }
+    return document.array().first();
+}
+
+
+auto GeoMaps::JSONScanner::valueRange(const QByteArray& json, const QByteArray& key) -> QPair<int,int>
+{
+    int begin = 0;
+    int end = 0;
+    if (!findMember(json, key, begin, end)) {
+        return {0, 0};
+    }
+    return {begin, end-begin};
+}
+
+
+auto GeoMaps::JSONScanner::findMember(const QByteArray& json, const QByteArray& key, int& begin, int& end) -> bool
+{
+    auto position = skipWhitespace(json, 0);
+    if ((position >= json.size()) || (json[position] != '{')) {
+        return false;
+    }
+    position = skipWhitespace(json, position+1);
+    while ((position < json.size()) && (json[position] == '"')) {
+        // Read key
+        auto keyEnd = skipString(json, position);
+        if (keyEnd < 0) {
+            return false;
+        }
+        auto keyMatches = (keyEnd-position-2 == key.size()) && (memcmp(json.constData()+position+1, key.constData(), key.size()) == 0);
+
+        // Read colon and value
+        position = skipWhitespace(json, keyEnd);
+        if ((position >= json.size()) || (json[position] != ':')) {
+            return false;
+        }
+        position = skipWhitespace(json, position+1);
+        auto valueEnd = skipValue(json, position);
+        if (valueEnd < 0) {
+            return false;
+        }
+        if (keyMatches) {
+            begin = position;
+            end = valueEnd;
+            return true;
+        }
+
+        // Go to next member
+        position = skipWhitespace(json, valueEnd);
+        if ((position >= json.size()) || (json[position] != ',')) {
+            return false;
+        }
+        position = skipWhitespace(json, position+1);
+    }
+    return false;
+}
+
+
+auto GeoMaps::JSONScanner::skipWhitespace(const QByteArray& json, int position) -> int
+{
+    while (position < json.size()) {
+        auto character = json[position];
+        if ((character != ' ') && (character != '\n') && (character != '\r') && (character != '\t')) {
+            break;
+        }
+        position++;
+    }
+    return position;
+}
+
+
+auto GeoMaps::JSONScanner::skipString(const QByteArray& json, int position) -> int
+{
+    // Search for the closing quote with memchr, which is much faster than
+    // looking at every character. A quote is escaped if it is preceded by an
+    // odd number of backslashes.
+    const char* data = json.constData();
+    auto searchFrom = position+1;
+    while (searchFrom < json.size()) {
+        const auto* quote = static_cast<const char*>(memchr(data+searchFrom, '"', json.size()-searchFrom));
+        if (quote == nullptr) {
+            return -1;
+        }
+        auto quotePosition = static_cast<int>(quote-data);
+        int backslashes = 0;
+        while ((quotePosition-backslashes-1 > position) && (data[quotePosition-backslashes-1] == '\\')) {
+            backslashes++;
+        }
+        if (backslashes % 2 == 0) {
+            return quotePosition+1;
+        }
+        searchFrom = quotePosition+1;
+    }
+    return -1;
+}
+
+
+auto GeoMaps::JSONScanner::skipValue(const QByteArray& json, int position) -> int
+{
+    if (position >= json.size()) {
+        return -1;
+    }
+
+    auto character = json[position];
+
+    // Strings
+    if (character == '"') {
+        return skipString(json, position);
+    }
+
+    // Objects and arrays. Brackets inside of strings are skipped along with
+    // the strings.
+    if ((character == '{') || (character == '[')) {
+        int depth = 0;
+        while (position < json.size()) {
+            character = json[position];
+            if (character == '"') {
+                position = skipString(json, position);
+                if (position < 0) {
+                    return -1;
+                }
+                continue;
+            }
+            if ((character == '{') || (character == '[')) {
+                depth++;
+            } else if ((character == '}') || (character == ']')) {
+                depth--;
+                if (depth == 0) {
+                    return position+1;
+                }
+            }
+            position++;
+        }
+        return -1;
+    }
+
+    // Numbers, true, false and null
+    auto begin = position;
+    while (position < json.size()) {
+        character = json[position];
+        if ((character == ',') || (character == '}') || (character == ']') ||
+                (character == ' ') || (character == '\n') || (character == '\r') || (character == '\t')) {
+            break;
+        }
+        position++;
+    }
+    return (position > begin) ? position : -1;
+}
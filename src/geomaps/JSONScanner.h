@@ -0,0 +1,111 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QJsonValue>
+#include <QPair>
+#include <QVector>
+
+
+namespace GeoMaps {
+
+/*! \brief Lightweight scanner for large JSON documents
+ *
+ * QJsonDocument::fromJson() parses a document in one thread and builds the
+ * complete DOM, which is slow and memory-hungry for GeoJSON files of several
+ * megabytes, when only a single member is needed, or when the elements of a
+ * large array could be parsed independently. This class scans the raw bytes
+ * of a document, without building a DOM, and finds the byte ranges of the
+ * members of the top-level object and of the elements of top-level arrays.
+ * The ranges can then be parsed on demand with QJsonDocument::fromJson(), in
+ * parallel if desired.
+ *
+ * The scanner assumes that the document is valid JSON. It does not validate
+ * the content of the values it skips, and might therefore accept some
+ * documents that QJsonDocument rejects. Malformed documents never lead to
+ * reads beyond the end of the data.
+ *
+ * All methods are reentrant.
+ */
+
+class JSONScanner
+{
+public:
+    /*! \brief Byte ranges of the elements of an array
+     *
+     * @param json JSON document whose top-level value is an object
+     *
+     * @param key Key of a member of the top-level object, whose value is an
+     * array. Escape sequences in keys are not supported.
+     *
+     * @returns Byte ranges of the array elements, as pairs (offset, size), in
+     * order. An empty list is returned if the array is empty, if the member
+     * does not exist or is not an array, or if the document is malformed.
+     */
+    static QVector<QPair<int,int>> arrayElements(const QByteArray& json, const QByteArray& key);
+
+    /*! \brief Value of a member of the top-level object
+     *
+     * Only the bytes of the value are parsed, with QJsonDocument::fromJson().
+     *
+     * @param json JSON document whose top-level value is an object
+     *
+     * @param key Key of a member of the top-level object. Escape sequences in
+     * keys are not supported.
+     *
+     * @returns Value of the member, or an undefined QJsonValue if the member
+     * does not exist or if the document is malformed
+     */
+    static QJsonValue value(const QByteArray& json, const QByteArray& key);
+
+    /*! \brief Byte range of the value of a member of the top-level object
+     *
+     * @param json JSON document whose top-level value is an object
+     *
+     * @param key Key of a member of the top-level object. Escape sequences in
+     * keys are not supported.
+     *
+     * @returns Byte range of the value, as a pair (offset, size). The size is
+     * zero if the member does not exist or if the document is malformed.
+     */
+    static QPair<int,int> valueRange(const QByteArray& json, const QByteArray& key);
+
+private:
+    // Finds the member of the top-level object with the given key. On
+    // success, returns true and sets begin and end to the byte range
+    // [begin, end) of its value.
+    static bool findMember(const QByteArray& json, const QByteArray& key, int& begin, int& end);
+
+    // Returns the position of the first non-whitespace character at or after
+    // position
+    static int skipWhitespace(const QByteArray& json, int position);
+
+    // Returns the position after the string that starts at position, or -1
+    // if the string does not end
+    static int skipString(const QByteArray& json, int position);
+
+    // Returns the position after the value that starts at position, or -1 if
+    // the value does not end
+    static int skipValue(const QByteArray& json, int position);
+};
+
+};
@@ -59,6 +59,7 @@ GeoMaps::MapManager::MapManager(QObject *parent) :
     connect(&_maps_json, &Downloadable::downloadingChanged, this, &MapManager::downloadingGeoMapListChanged);
     connect(&_maps_json, &Downloadable::fileContentChanged, this, &MapManager::readGeoMapListFromJSONFile);
     connect(&_maps_json, &Downloadable::fileContentChanged, this, &MapManager::setTimeOfLastUpdateToNow);
+    connect(&_maps_json, &Downloadable::fileContentConfirmed, this, &MapManager::setTimeOfLastUpdateToNow);
     connect(&_maps_json, &Downloadable::error, this, &MapManager::errorReceiver);
 
     // Wire up the DownloadableGroup _geoMaps
@@ -68,7 +69,7 @@ GeoMaps::MapManager::MapManager(QObject *parent) :
     // Wire up the automatic update timer and check if automatic updates are
     // due. The method "autoUpdateGeoMapList" will also set a reasonable timeout
     // value for the timer and start it.
-    connect(&_autoUpdateTimer, &QTimer::timeout, this, &MapManager::autoUpdateGeoMapList);
+    connect(&_autoUpdateTimer, &Scheduler::Timer::timeout, this, &MapManager::autoUpdateGeoMapList);
     QTimer::singleShot(0, this, &GeoMaps::MapManager::autoUpdateGeoMapList); // Cannot call autoUpdateGeoMapList immediately, or else Global::allocateInternal will crash
 
     // If there is a downloaded maps.json file, we read it. Otherwise, we start a download.
@@ -175,6 +176,11 @@ void GeoMaps::MapManager::readGeoMapListFromJSONFile()
         auto mapUrlName = baseURL + "/"+ obj.value("path").toString();
         auto fileModificationDateTime = QDateTime::fromString(obj.value("time").toString(), "yyyyMMdd");
         auto fileSize = obj.value("size").toInt();
+        QUrl blockChecksumsURL;
+        if (obj.contains("blocks")) {
+            blockChecksumsURL = QUrl(baseURL + "/" + obj.value("blocks").toString());
+        }
+        auto fileHash = QByteArray::fromHex(obj.value("sha256").toString().toLatin1());
 
         // If a map with the given name already exists, update that element, delete its entry in oldMaps
         Downloadable *mapPtr = nullptr;
@@ -190,6 +196,8 @@ void GeoMaps::MapManager::readGeoMapListFromJSONFile()
             oldMaps.removeAll(mapPtr);
             mapPtr->setRemoteFileDate(fileModificationDateTime);
             mapPtr->setRemoteFileSize(fileSize);
+            mapPtr->setBlockChecksumsURL(blockChecksumsURL);
+            mapPtr->setRemoteFileHash(fileHash);
         } else {
             // Construct local file name
             auto localFileName = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/aviation_maps/"+mapFileName;
@@ -200,6 +208,8 @@ void GeoMaps::MapManager::readGeoMapListFromJSONFile()
             downloadable->setSection(mapName.section("/", -2, -2));
             downloadable->setRemoteFileDate(fileModificationDateTime);
             downloadable->setRemoteFileSize(fileSize);
+            downloadable->setBlockChecksumsURL(blockChecksumsURL);
+            downloadable->setRemoteFileHash(fileHash);
             _geoMaps.addToGroup(downloadable);
             if (localFileName.endsWith("geojson")) {
                 _aviationMaps.addToGroup(downloadable);
@@ -282,10 +292,12 @@ auto GeoMaps::MapManager::unattachedFiles() const -> QList<QString>
     while (fileIterator.hasNext()) {
         fileIterator.next();
 
-        // Now check if this file exists as the local file of some geographic map
+        // Now check if this file exists as the local file of some geographic
+        // map, or holds the data of a download that can be resumed
         bool isAttachedToAviationMap = false;
+        auto path = QFileInfo(fileIterator.filePath()).absoluteFilePath();
         foreach(auto geoMapPtr, _geoMaps.downloadables()) {
-            if (geoMapPtr->fileName() == QFileInfo(fileIterator.filePath()).absoluteFilePath()) {
+            if ((geoMapPtr->fileName() == path) || (geoMapPtr->fileName()+".part" == path) || (geoMapPtr->fileName()+".part.info" == path)) {
                 isAttachedToAviationMap = true;
                 break;
             }
@@ -22,6 +22,7 @@
 
 #include <QTimer> 
 
+#include "Scheduler.h"
 #include "geomaps/DownloadableGroup.h"
 
 
@@ -191,9 +192,9 @@ private:
   // corresponding entry in _aviationMaps.
   QList<QString> unattachedFiles() const;
 
-  // This timer is used to trigger automatic updates. Its signal QTimer::timeout
+  // This timer is used to trigger automatic updates. Its signal Scheduler::Timer::timeout
   // is connected to the slot autoUpdateGeoMapList.
-  QTimer _autoUpdateTimer;
+  Scheduler::Timer _autoUpdateTimer {Scheduler::Maps};
 
   // This Downloadable object manages the central text file that describes the
   // remotely available aviation maps. It is set in the constructor to point to
@@ -18,45 +18,24 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
-import QtLocation 5.15
-import QtPositioning 5.15
-import QtQuick 2.15
-
-
-MapQuickItem {
-    id: traffic1MapItem
-
-    property var trafficInfo: ({})
-
-    anchorPoint.x: image.width/2
-    anchorPoint.y: image.height/2
-
-    coordinate: trafficInfo.coordinate
-    Behavior on coordinate {
-        CoordinateAnimation { duration: 1000 }
-        enabled: trafficInfo.animate
-    }
-
-    visible: trafficInfo.valid
-
-    Connections {
-        // This is a workaround against a bug in Qt 5.15.2.  The position of the MapQuickItem
-        // is not updated when the height of the map changes. It does get updated when the
-        // width of the map changes. We use the undocumented method polishAndUpdate() here.
-        target: flightMap
-        function onHeightChanged() { traffic1MapItem.polishAndUpdate() }
-    }
-
-    sourceItem: Item {
-        Image {
-            id: image
-
-            rotation: isFinite(trafficInfo.TT) ? trafficInfo.TT-flightMap.bearing : 0
-
-            source: trafficInfo.icon
-
-            sourceSize.width: 30
-            sourceSize.height: 30
-        }
-    }
+#include "StringPool.h"
+
+
+auto GeoMaps::StringPool::interned(const QString& string) -> QString
+{
+    static const QSet<QString> strings {
+        // Property keys
+        "BOT", "CAT", "COD", "COM", "ELE", "ICA", "INF", "MOR", "NAM", "NAV", "OTH", "RWY", "SCO", "TOP", "TYP",
+
+        // Waypoint types and categories
+        "AD", "AD-GLD", "AD-GRASS", "AD-INOP", "AD-MIL", "AD-MIL-GRASS", "AD-MIL-PAVED", "AD-PAVED", "AD-UL", "AD-WATER",
+        "DVOR", "DVOR-DME", "DVORTAC", "NDB", "VOR", "VOR-DME", "VORTAC",
+        "MRP", "RP", "WP",
+
+        // Airspace categories and frequent vertical limits
+        "A", "B", "C", "D", "E", "F", "G", "CTR", "DNG", "GLD", "NRA", "P", "PJE", "R", "RMZ", "TMZ", "TRA", "TSA",
+        "GND", "SFC", "UNL"
+    };
+    auto iterator = strings.constFind(string);
+    return (iterator == strings.constEnd()) ? string : *iterator;
 }
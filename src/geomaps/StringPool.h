@@ -0,0 +1,83 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QSet>
+#include <QString>
+
+
+namespace GeoMaps {
+
+/*! \brief Pool of interned strings
+ *
+ * Aviation maps contain many strings that appear over and over again, such as
+ * the categories and vertical limits of airspaces. This class returns, for
+ * every string, a copy that shares its data with all equal strings returned
+ * earlier, so that the parsed data holds one copy of every distinct string.
+ *
+ * Property keys, waypoint types and categories and airspace categories are
+ * interned in a global table that is fixed at compile time, see the static
+ * method interned(). These strings share their data across all pools, maps
+ * and generations of aviation data. All other strings are interned in a pool.
+ * A pool is meant to live for one run of a parser. The strings returned
+ * remain valid after the pool is destructed. Pools are not thread safe;
+ * parsers that run concurrently use one pool each. The static method
+ * interned() is thread safe.
+ */
+
+class StringPool
+{
+public:
+    /*! \brief Interned copy of a string, from the global table
+     *
+     * @param string Any string
+     *
+     * @returns If string is in the global table, then the string from the
+     * table. Otherwise, string.
+     */
+    static QString interned(const QString& string);
+
+    /*! \brief Interned copy of a string
+     *
+     * @param string Any string
+     *
+     * @returns String equal to string, that shares its data with all equal
+     * strings returned by this pool and with the global table
+     */
+    QString intern(const QString& string)
+    {
+        auto globalString = interned(string);
+        if (globalString.constData() != string.constData()) {
+            return globalString;
+        }
+        auto iterator = m_strings.constFind(string);
+        if (iterator != m_strings.constEnd()) {
+            return *iterator;
+        }
+        m_strings.insert(string);
+        return string;
+    }
+
+private:
+    QSet<QString> m_strings;
+};
+
+};
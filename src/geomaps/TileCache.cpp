@@ -0,0 +1,134 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QMutexLocker>
+#include <limits>
+
+#include "TileCache.h"
+
+
+GeoMaps::TileCache::TileCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+
+auto GeoMaps::TileCache::hits() const -> qint64
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hits;
+}
+
+
+auto GeoMaps::TileCache::maxSize() const -> qint64
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cache.maxCost();
+}
+
+
+void GeoMaps::TileCache::setMaxSize(qint64 newMaxSize)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto newMaxCost = static_cast<int>(qBound(static_cast<qint64>(0), newMaxSize, static_cast<qint64>(std::numeric_limits<int>::max())));
+        if (newMaxCost == m_cache.maxCost()) {
+            return;
+        }
+        m_cache.setMaxCost(newMaxCost);
+    }
+    scheduleStatisticsChanged();
+}
+
+
+auto GeoMaps::TileCache::misses() const -> qint64
+{
+    QMutexLocker locker(&m_mutex);
+    return m_misses;
+}
+
+
+auto GeoMaps::TileCache::size() const -> qint64
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cache.totalCost();
+}
+
+
+auto GeoMaps::TileCache::contains(const QString& tileSet, int z, int x, int y) const -> bool
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cache.contains(key(tileSet, z, x, y));
+}
+
+
+void GeoMaps::TileCache::insert(const QString& tileSet, int z, int x, int y, const QByteArray& data)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_cache.insert(key(tileSet, z, x, y), new QByteArray(data), data.size());
+    }
+    scheduleStatisticsChanged();
+}
+
+
+void GeoMaps::TileCache::removeTileSet(const QString& tileSet)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto prefix = tileSet+"/";
+        foreach(auto key, m_cache.keys()) {
+            if (key.startsWith(prefix)) {
+                m_cache.remove(key);
+            }
+        }
+    }
+    scheduleStatisticsChanged();
+}
+
+
+auto GeoMaps::TileCache::tile(const QString& tileSet, int z, int x, int y) -> QByteArray
+{
+    QByteArray result;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto *data = m_cache.object(key(tileSet, z, x, y));
+        if (data != nullptr) {
+            result = *data;
+            m_hits++;
+        } else {
+            m_misses++;
+        }
+    }
+    scheduleStatisticsChanged();
+    return result;
+}
+
+
+void GeoMaps::TileCache::scheduleStatisticsChanged()
+{
+    if (m_statisticsChangedPending.exchange(true)) {
+        return;
+    }
+    QMetaObject::invokeMethod(this, [this]() {
+        m_statisticsChangedPending = false;
+        emit statisticsChanged();
+    }, Qt::QueuedConnection);
+}
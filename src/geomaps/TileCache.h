@@ -0,0 +1,184 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+#include <QObject>
+#include <atomic>
+
+
+namespace GeoMaps {
+
+/*! \brief In-memory cache for map tiles
+ *
+ * This class implements a least-recently-used cache that maps tile
+ * coordinates to tile data, for use by the TileHandlers of a TileServer. The
+ * total size of the cached tile data is bounded by the property maxSize.
+ * Tiles are identified by the name of their tile set and by their coordinates
+ * in XYZ scheme.
+ *
+ * The methods of this class are thread safe. The signal statisticsChanged()
+ * is always emitted in the thread of this object, typically the GUI thread,
+ * even if the cache is used from the workers of the TileServer.
+ */
+
+class TileCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*! \brief Standard constructor
+     *
+     * @param parent The standard QObject parent pointer
+     */
+    explicit TileCache(QObject *parent = nullptr);
+
+    // Standard destructor
+    ~TileCache() override = default;
+
+    /*! \brief Number of successful lookups since construction */
+    Q_PROPERTY(qint64 hits READ hits NOTIFY statisticsChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property hits
+     */
+    qint64 hits() const;
+
+    /*! \brief Maximal total size of tile data held in the cache, in bytes */
+    Q_PROPERTY(qint64 maxSize READ maxSize WRITE setMaxSize NOTIFY statisticsChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property maxSize
+     */
+    qint64 maxSize() const;
+
+    /*! \brief Setter function for property of the same name
+     *
+     * If the new value is smaller than the current size, least recently used
+     * tiles are removed from the cache.
+     *
+     * @param newMaxSize Property maxSize
+     */
+    void setMaxSize(qint64 newMaxSize);
+
+    /*! \brief Number of unsuccessful lookups since construction */
+    Q_PROPERTY(qint64 misses READ misses NOTIFY statisticsChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property misses
+     */
+    qint64 misses() const;
+
+    /*! \brief Total size of tile data currently held in the cache, in bytes */
+    Q_PROPERTY(qint64 size READ size NOTIFY statisticsChanged)
+
+    /*! \brief Getter function for property of the same name
+     *
+     * @returns Property size
+     */
+    qint64 size() const;
+
+    /*! \brief Checks if a tile is in the cache
+     *
+     * Unlike tile(), this method does not change the statistics or the order
+     * of eviction.
+     *
+     * @param tileSet Name of the tile set
+     *
+     * @param z Zoom level
+     *
+     * @param x Tile column
+     *
+     * @param y Tile row, in XYZ scheme
+     *
+     * @returns True if the tile is in the cache
+     */
+    bool contains(const QString& tileSet, int z, int x, int y) const;
+
+    /*! \brief Adds a tile to the cache
+     *
+     * @param tileSet Name of the tile set
+     *
+     * @param z Zoom level
+     *
+     * @param x Tile column
+     *
+     * @param y Tile row, in XYZ scheme
+     *
+     * @param data Tile data
+     */
+    void insert(const QString& tileSet, int z, int x, int y, const QByteArray& data);
+
+    /*! \brief Removes all tiles of a given tile set from the cache
+     *
+     * @param tileSet Name of the tile set
+     */
+    void removeTileSet(const QString& tileSet);
+
+    /*! \brief Looks up a tile
+     *
+     * @param tileSet Name of the tile set
+     *
+     * @param z Zoom level
+     *
+     * @param x Tile column
+     *
+     * @param y Tile row, in XYZ scheme
+     *
+     * @returns Tile data, or a null QByteArray if the tile is not in the cache
+     */
+    QByteArray tile(const QString& tileSet, int z, int x, int y);
+
+signals:
+    /*! \brief Notifier signal
+     *
+     * Changes that happen in quick succession are reported by a single
+     * signal.
+     */
+    void statisticsChanged();
+
+private:
+    Q_DISABLE_COPY_MOVE(TileCache)
+
+    // Cache key for a tile
+    static QString key(const QString& tileSet, int z, int x, int y)
+    {
+        return QStringLiteral("%1/%2/%3/%4").arg(tileSet).arg(z).arg(x).arg(y);
+    }
+
+    // Queues an emission of statisticsChanged() in the thread of this object,
+    // unless one is already pending. This method can be called from any
+    // thread.
+    void scheduleStatisticsChanged();
+    std::atomic<bool> m_statisticsChangedPending {false};
+
+    mutable QMutex m_mutex;
+    QCache<QString, QByteArray> m_cache;
+    qint64 m_hits {0};
+    qint64 m_misses {0};
+};
+
+};
@@ -18,21 +18,42 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QBuffer>
 #include <QFile>
+#include <QFileInfo>
+#include <QImage>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutex>
 #include <QRegularExpression>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QThread>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
 
 #include <qhttpengine/socket.h>
 
+#include "Metrics.h"
 #include "TileHandler.h"
 #include "geomaps/Downloadable.h"
 
-GeoMaps::TileHandler::TileHandler(const QVector<QPointer<Downloadable>>& mbtileFiles, const QString& baseURL, QObject *parent)
-    : Handler(parent)
+auto GeoMaps::TileHandler::fromDownloadables(const QVector<QPointer<Downloadable>>& downloadables) -> QVector<MbtilesFile>
+{
+    QVector<MbtilesFile> result;
+    foreach(auto downloadable, downloadables) {
+        if (!downloadable.isNull()) {
+            result.append({downloadable, downloadable->fileName()});
+        }
+    }
+    return result;
+}
+
+
+GeoMaps::TileHandler::TileHandler(const QVector<MbtilesFile>& mbtileFiles, const QString& baseURL, TileCache* tileCache, QObject *parent)
+    : Handler(parent), _tileCache(tileCache), _tileCacheName(baseURL)
 {
     // Initialize with default values
     _name        = "empty";
@@ -43,145 +64,489 @@ GeoMaps::TileHandler::TileHandler(const QVector<QPointer<Downloadable>>& mbtileF
     _maxzoom     = 10;
     _minzoom     = 0;
     _tiles       = baseURL+"/{z}/{x}/{y}."+_format;
+    updateTileJSON();
 
     // Go through mbtile files and find real values
+    _mbtileFiles = mbtileFiles;
     foreach (auto mbtileFile, mbtileFiles) {
-        // Check that file really exists
-        if (!QFile::exists(mbtileFile->fileName())) {
+        if (!addFile(mbtileFile)) {
             hasDBError = true;
             return;
         }
-        connect(mbtileFile, &Downloadable::aboutToChangeFile, this, &TileHandler::removeFile);
-
-        // Open database
-        auto databaseConnectionName = baseURL+"-"+mbtileFile->fileName();
-        auto db = QSqlDatabase::addDatabase("QSQLITE", databaseConnectionName);
-        db.setDatabaseName(mbtileFile->fileName());
-        db.open();
-        if (db.isOpenError()) {
-            hasDBError = true;
-            return;
-        }
-        databaseConnections += databaseConnectionName;
+    }
+}
 
-        // Read metadata from database
-        QSqlQuery query(db);
-        if (!query.exec("select name, value from metadata;")) {
-            hasDBError = true;
-            return;
-        }
-        while(query.next()) {
-            QString key = query.value(0).toString();
-            if (key == "name") {
-                _name = query.value(1).toString();
-            }
-            if (key == "format") {
-                _format= query.value(1).toString();
-            }
-            if (key == "description") {
-                _description = query.value(1).toString();
-            }
-            if (key == "version") {
-                _version = query.value(1).toString();
-            }
-            if (key == "attribution") {
-                _attribution = query.value(1).toString();
-            }
-            if (key == "maxzoom") {
-               _maxzoom = query.value(1).toInt();
-            }
-            if (key == "minzoom") {
-                _minzoom = query.value(1).toInt();
-            }
-        }
-        _tiles = baseURL+"/{z}/{x}/{y}."+_format;
 
-        // Safety check
-        if (_minzoom > _maxzoom) {
-            _maxzoom = -1;
-            _minzoom = -1;
-        }
+auto GeoMaps::TileHandler::addFile(const MbtilesFile& mbtileFile) -> bool
+{
+    // Check that file really exists
+    if (mbtileFile.downloadable.isNull() || !QFile::exists(mbtileFile.fileName)) {
+        return false;
+    }
+    // The database must be closed before the file changes. If the handler
+    // lives in a worker thread, wait for the worker to close it.
+    auto connectionType = (mbtileFile.downloadable->thread() == QThread::currentThread()) ? Qt::DirectConnection : Qt::BlockingQueuedConnection;
+    connect(mbtileFile.downloadable, &Downloadable::aboutToChangeFile, this, &TileHandler::removeFile, static_cast<Qt::ConnectionType>(connectionType|Qt::UniqueConnection));
+
+    // Open database
+    // Database connections can only be used in the thread where they
+    // were created, so the name must be unique per thread
+    auto databaseConnectionName = _tileCacheName+"-"+mbtileFile.fileName+"-"+QString::number(reinterpret_cast<quintptr>(QThread::currentThread()));
+    auto db = QSqlDatabase::addDatabase("QSQLITE", databaseConnectionName);
+    db.setDatabaseName(mbtileFile.fileName);
+    db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
+    db.open();
+    if (db.isOpenError()) {
+        return false;
+    }
+
+    // Let SQLite access the file through memory-mapped I/O, so that tile
+    // data is copied directly from the page cache of the operating
+    // system. On 32 bit systems, the mapping is kept small to save address
+    // space.
+    QSqlQuery(db).exec(QStringLiteral("PRAGMA mmap_size=%1;").arg(mmapSize));
+
+    Tileset tileset;
+    tileset.connectionName = databaseConnectionName;
+    tileset.fileName = mbtileFile.fileName;
+
+    // Read metadata from database, or re-use the metadata that another
+    // worker has read
+    tileset.metadata = fileMetadata(db, tileset.fileName);
+    if (tileset.metadata == nullptr) {
+        return false;
+    }
+    const auto& values = tileset.metadata->values;
+    if (values.contains("name")) {
+        _name = values.value("name");
+    }
+    if (values.contains("format")) {
+        _format = values.value("format");
+    }
+    if (values.contains("description")) {
+        _description = values.value("description");
+    }
+    if (values.contains("version")) {
+        _version = values.value("version");
+    }
+    if (values.contains("attribution")) {
+        _attribution = values.value("attribution");
+    }
+    // If the files disagree about the maximal zoom level, use the largest, so
+    // that no detail is lost. Regions covered only by files with fewer zoom
+    // levels are filled by overzoomedTile().
+    if (values.contains("maxzoom")) {
+        _maxzoom = tilesets.isEmpty() ? tileset.metadata->maxzoom : qMax(_maxzoom, tileset.metadata->maxzoom);
+    }
+    if (values.contains("minzoom")) {
+        _minzoom = tileset.metadata->minzoom;
+    }
+
+    // Prepare query for tile data
+    tileset.tileQuery = QSqlQuery(db);
+    tileset.tileQuery.setForwardOnly(true);
+    if (!tileset.tileQuery.prepare("select tile_data from tiles where zoom_level=? and tile_column=? and tile_row=?;")) {
+        return false;
+    }
+    tilesets.append(tileset);
+    _tiles = _tileCacheName+"/{z}/{x}/{y}."+_format;
+
+    // Safety check
+    if (_minzoom > _maxzoom) {
+        _maxzoom = -1;
+        _minzoom = -1;
+    }
+    updateTileJSON();
+    return true;
+}
+
+
+auto GeoMaps::TileHandler::fileMetadata(QSqlDatabase& db, const QString& fileName) -> std::shared_ptr<const FileMetadata>
+{
+    // Metadata known so far, by file name. The key also records size and
+    // modification time, so that files which have changed are read again.
+    static QMutex mutex;
+    static QHash<QString, QPair<QString, std::shared_ptr<const FileMetadata>>> metadataByFileName;
+
+    QFileInfo info(fileName);
+    auto key = QString::number(info.size())+"-"+QString::number(info.lastModified().toMSecsSinceEpoch());
+
+    // The mutex is held while the file is read, so that workers that set up
+    // their handlers at the same time wait for the first one, rather than
+    // reading the same file again
+    QMutexLocker locker(&mutex);
+    auto iterator = metadataByFileName.constFind(fileName);
+    if ((iterator != metadataByFileName.constEnd()) && (iterator->first == key)) {
+        return iterator->second;
+    }
+
+    auto metadata = std::make_shared<FileMetadata>();
+    QSqlQuery query(db);
+    if (!query.exec("select name, value from metadata;")) {
+        return nullptr;
+    }
+    while(query.next()) {
+        metadata->values.insert(query.value(0).toString(), query.value(1).toString());
+    }
+    if (metadata->values.contains("maxzoom")) {
+        metadata->maxzoom = metadata->values.value("maxzoom").toInt();
+    }
+    if (metadata->values.contains("minzoom")) {
+        metadata->minzoom = metadata->values.value("minzoom").toInt();
+    }
+    auto bounds = metadata->values.value("bounds").split(',');
+    if (bounds.size() == 4) {
+        metadata->west  = bounds[0].toDouble();
+        metadata->south = bounds[1].toDouble();
+        metadata->east  = bounds[2].toDouble();
+        metadata->north = bounds[3].toDouble();
+    }
+
+    // Find out which tiles are contained in the file
+    metadata->readCoverage(db);
+
+    metadataByFileName.insert(fileName, {key, metadata});
+    return metadata;
+}
+
+
+auto GeoMaps::TileHandler::hasFile(const Downloadable* downloadable) const -> bool
+{
+    return std::any_of(_mbtileFiles.cbegin(), _mbtileFiles.cend(), [downloadable](const MbtilesFile& file) { return file.downloadable == downloadable; });
+}
+
+
+void GeoMaps::TileHandler::reopenFile(const MbtilesFile& mbtileFile)
+{
+    if (!hasFile(mbtileFile.downloadable)) {
+        return;
+    }
+    removeFile(mbtileFile.fileName);
+    if (!addFile(mbtileFile)) {
+        hasDBError = true;
     }
 }
 
 
 GeoMaps::TileHandler::~TileHandler()
 {
-    foreach(auto databaseConnectionName, databaseConnections)
+    if (_tileCache != nullptr) {
+        _tileCache->removeTileSet(_tileCacheName);
+    }
+
+    // Delete the prepared queries before removing the database connections
+    QStringList connectionNames;
+    foreach(auto tileset, tilesets)
+        connectionNames += tileset.connectionName;
+    tilesets.clear();
+    foreach(auto databaseConnectionName, connectionNames)
         QSqlDatabase::removeDatabase(databaseConnectionName);
 }
 
 
+auto GeoMaps::TileHandler::FileMetadata::covers(int z, int x, int y) const -> bool
+{
+    // Check zoom range
+    if ((minzoom >= 0) && (z < minzoom)) {
+        return false;
+    }
+    if ((maxzoom >= 0) && (z > maxzoom)) {
+        return false;
+    }
+
+    // Check list of tiles
+    if (coverageZoom >= 0) {
+        if (z >= coverageZoom) {
+            return coverage[coverageZoom].contains(coverageKey(x >> (z-coverageZoom), y >> (z-coverageZoom)));
+        }
+        return coverage[z].contains(coverageKey(x, y));
+    }
+
+    // Check bounding box
+    auto n = static_cast<double>(quint32(1) << z);
+    auto tileWest = x/n*360.0-180.0;
+    auto tileEast = (x+1)/n*360.0-180.0;
+    auto tileNorth = qRadiansToDegrees(qAtan(std::sinh(M_PI*(1.0-2.0*y/n))));
+    auto tileSouth = qRadiansToDegrees(qAtan(std::sinh(M_PI*(1.0-2.0*(y+1)/n))));
+    return (tileEast >= west) && (tileWest <= east) && (tileNorth >= south) && (tileSouth <= north);
+}
+
+
+void GeoMaps::TileHandler::FileMetadata::readCoverage(QSqlDatabase& db)
+{
+    auto zoom = qMax(minzoom, 0);
+    if (maxzoom >= 0) {
+        zoom = qMax(zoom, qMin(maxCoverageZoom, maxzoom));
+    } else {
+        zoom = qMax(zoom, maxCoverageZoom);
+    }
+    if (zoom > maxCoverageZoom) {
+        return;
+    }
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.prepare("select tile_column, tile_row from tiles where zoom_level=?;")) {
+        return;
+    }
+    query.bindValue(0, zoom);
+    if (!query.exec()) {
+        return;
+    }
+    QSet<quint32> tiles;
+    int n = 1 << zoom;
+    while(query.next()) {
+        tiles.insert(coverageKey(query.value(0).toInt(), (n-1)-query.value(1).toInt()));
+    }
+    if (tiles.isEmpty()) {
+        return;
+    }
+
+    // Derive coverage at smaller zoom levels
+    coverage.resize(zoom+1);
+    coverage[zoom] = tiles;
+    for(int z=zoom-1; z>=0; z--) {
+        foreach(auto key, coverage[z+1]) {
+            coverage[z].insert(coverageKey(static_cast<int>(key >> 16) >> 1, static_cast<int>(key & 0xFFFF) >> 1));
+        }
+    }
+    coverageZoom = zoom;
+}
+
+
 void GeoMaps::TileHandler::removeFile(const QString& localFileName)
 {
-    QString connectionToRemove;
-    foreach(auto databaseConnectionName, databaseConnections) {
-        if (!databaseConnectionName.endsWith(localFileName)) {
+    // Tiles from the file might be in the cache
+    if (_tileCache != nullptr) {
+        _tileCache->removeTileSet(_tileCacheName);
+    }
+
+    for(int i=0; i<tilesets.size(); i++) {
+        if (tilesets[i].fileName != localFileName) {
             continue;
         }
-        connectionToRemove = databaseConnectionName;
+        auto connectionToRemove = tilesets[i].connectionName;
+        tilesets.remove(i);
+        QSqlDatabase::removeDatabase(connectionToRemove);
         break;
     }
-
-    QSqlDatabase::removeDatabase(connectionToRemove);
-    databaseConnections.remove(connectionToRemove);
 }
 
 
 void GeoMaps::TileHandler::process(QHttpEngine::Socket *socket, const QString &path)
 {
-    // Serve tileJSON file, if requested
-    if (path.isEmpty() || path.endsWith("json", Qt::CaseInsensitive)) {
-        socket->setHeader("Content-Type", "application/json");
-        QByteArray json = tileJSON();
-        socket->setHeader("Content-Length", QByteArray::number(json.length()));
-        socket->write(json);
+    auto response = respond(path);
+    if (response.statusCode != QHttpEngine::Socket::OK) {
+        socket->writeError(response.statusCode);
         socket->close();
         return;
     }
 
+    socket->setHeader("Content-Type", response.contentType);
+    if (!response.contentEncoding.isEmpty()) {
+        socket->setHeader("Content-Encoding", response.contentEncoding);
+    }
+    socket->setHeader("Content-Length", QByteArray::number(response.data.length()));
+    socket->write(response.data);
+    socket->close();
+}
+
+
+auto GeoMaps::TileHandler::respond(const QString &path) -> Response
+{
+    Metrics::Timer timer(Metrics::TileRequest);
+    Response response;
+
+    // Serve tileJSON file, if requested
+    if (path.isEmpty() || path.endsWith("json", Qt::CaseInsensitive)) {
+        response.statusCode = 200;
+        response.contentType = "application/json";
+        response.data = tileJSON();
+        return response;
+    }
+
     // Serve tile, if requested
-    QRegularExpression tileQueryPattern("[0-9]{1,2}/[0-9]{1,4}/[0-9]{1,4}");
+    static const QRegularExpression tileQueryPattern("([0-9]{1,2})/([0-9]{1,4})/([0-9]{1,4})");
     QRegularExpressionMatch match = tileQueryPattern.match(path);
-    if (match.hasMatch()) {
-        // Retrieve tile data from the database
-        quint32 z       = path.section('/', 1, 1).toInt();
-        QString x       = path.section('/', 2, 2);
-        quint32 y       = path.section('/', 3, 3).section('.', 0, 0).toInt();
-        quint32 yflipped = ((quint32(1) <<z)-1)-y;
-        QString queryString = QString("select zoom_level, tile_column, tile_row, tile_data from tiles where zoom_level=%1 and tile_column=%2 and tile_row=%3;").arg(z).arg(x).arg(yflipped);
-
-        foreach(auto databaseConnection, databaseConnections) {
-            auto db = QSqlDatabase::database(databaseConnection);
-
-            QSqlQuery query(db);
-            query.exec(queryString);
-
-            // Error handling
-            if (!query.first()) {
-                continue;
-            }
-
-            // Get data
-            QByteArray tileData = query.value(3).toByteArray();
-
-            // Set the headers and write the content
-            socket->setHeader("Content-Type", "application/octet-stream");
-            socket->setHeader("Content-Encoding", "gzip");
-            socket->setHeader("Content-Length", QByteArray::number(tileData.length()));
-            socket->write(tileData);
-            socket->close();
-            return;
+    int z = match.captured(1).toInt();
+    if (!match.hasMatch() || (z > 30)) {
+        return response;
+    }
+    int x = match.captured(2).toInt();
+    int y = match.captured(3).toInt();
+
+    response.data = tile(z, x, y);
+    if (response.data.isNull()) {
+        return response;
+    }
+
+    response.statusCode = 200;
+    if (isRaster()) {
+        response.contentType = "image/"+_format.toLatin1().replace("jpg", "jpeg");
+        return response;
+    }
+    response.contentType = "application/octet-stream";
+    response.contentEncoding = "gzip";
+    return response;
+}
+
+
+auto GeoMaps::TileHandler::tile(int z, int x, int y) -> QByteArray
+{
+    // Serve tile from the cache, if possible
+    QByteArray tileData;
+    if (_tileCache != nullptr) {
+        tileData = _tileCache->tile(_tileCacheName, z, x, y);
+        if (!tileData.isNull()) {
+            return tileData;
         }
     }
 
-    // Unknown request, responding with 'not found'
-    socket->writeError(QHttpEngine::Socket::NotFound);
-    socket->close();
+    // Otherwise, retrieve tile data from the database. Raster tiles that the
+    // files do not contain, for instance beyond the maximal zoom level of the
+    // file that covers the region, are computed from a tile of lower zoom
+    // level.
+    if ((_maxzoom < 0) || (z <= _maxzoom)) {
+        tileData = readTile(z, x, y);
+    }
+    if (tileData.isNull()) {
+        tileData = overzoomedTile(z, x, y);
+    }
+    if (!tileData.isNull() && (_tileCache != nullptr)) {
+        _tileCache->insert(_tileCacheName, z, x, y, tileData);
+    }
+    return tileData;
+}
+
+
+auto GeoMaps::TileHandler::overzoomedTile(int z, int x, int y) -> QByteArray
+{
+    if (!isRaster()) {
+        return {};
+    }
+
+    // Find the file that covers the requested tile and has the largest
+    // maximal zoom level below z. The metadata held in memory decides, so
+    // that at most one tile is read from the files, and none if no file
+    // covers the region.
+    auto parentZ = -1;
+    for(const auto& tileset : tilesets) {
+        auto fileMaxzoom = tileset.metadata->maxzoom;
+        if ((fileMaxzoom < 0) || (fileMaxzoom >= z) || (fileMaxzoom <= parentZ) || (z-fileMaxzoom > maxOverzoom)) {
+            continue;
+        }
+        if (tileset.metadata->covers(fileMaxzoom, x >> (z-fileMaxzoom), y >> (z-fileMaxzoom))) {
+            parentZ = fileMaxzoom;
+        }
+    }
+    if (parentZ < 0) {
+        return {};
+    }
+
+    // Get the tile at the maximal zoom level of that file
+    auto deltaZ = z-parentZ;
+    auto parentX = x >> deltaZ;
+    auto parentY = y >> deltaZ;
+    QByteArray parentData;
+    if (_tileCache != nullptr) {
+        parentData = _tileCache->tile(_tileCacheName, parentZ, parentX, parentY);
+    }
+    if (parentData.isNull()) {
+        parentData = readTile(parentZ, parentX, parentY);
+        if (!parentData.isNull() && (_tileCache != nullptr)) {
+            _tileCache->insert(_tileCacheName, parentZ, parentX, parentY, parentData);
+        }
+    }
+
+    // Decode the tile
+    QImage image;
+    if (parentData.isNull() || !image.loadFromData(parentData)) {
+        return {};
+    }
+
+    // Cut out the part that covers the requested tile, and scale it to the
+    // size of the original tile
+    auto scale = 1 << deltaZ;
+    auto partWidth = image.width()/scale;
+    auto partHeight = image.height()/scale;
+    if ((partWidth < 1) || (partHeight < 1)) {
+        return {};
+    }
+    auto part = image.copy((x % scale)*partWidth, (y % scale)*partHeight, partWidth, partHeight)
+            .scaled(image.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    QByteArray result;
+    QBuffer buffer(&result);
+    buffer.open(QIODevice::WriteOnly);
+    if (!part.save(&buffer, _format.toLatin1().constData())) {
+        return {};
+    }
+    return result;
+}
+
+
+auto GeoMaps::TileHandler::isRaster() const -> bool
+{
+    return (_format == u"png") || (_format == u"jpg") || (_format == u"jpeg") || (_format == u"webp");
+}
+
+
+void GeoMaps::TileHandler::prefetch(int z, int x, int y)
+{
+    if ((_tileCache == nullptr) || (z < 0) || (z > 30)) {
+        return;
+    }
+
+    // Beyond the maximal zoom level, the map uses tiles of the maximal zoom
+    // level. Raster tiles beyond that level are computed from these tiles
+    // when they are requested.
+    if ((_maxzoom >= 0) && (z > _maxzoom)) {
+        x >>= (z-_maxzoom);
+        y >>= (z-_maxzoom);
+        z = _maxzoom;
+    }
+    if (_tileCache->contains(_tileCacheName, z, x, y)) {
+        return;
+    }
+    auto tileData = readTile(z, x, y);
+    if (!tileData.isNull()) {
+        _tileCache->insert(_tileCacheName, z, x, y, tileData);
+    }
+}
+
+
+auto GeoMaps::TileHandler::readTile(int z, int x, int y) -> QByteArray
+{
+    int yflipped = ((1 << z)-1)-y;
+
+    for(auto& tileset : tilesets) {
+        // Do not query files that cannot contain the tile
+        if (!tileset.metadata->covers(z, x, y)) {
+            continue;
+        }
+
+        tileset.tileQuery.bindValue(0, z);
+        tileset.tileQuery.bindValue(1, x);
+        tileset.tileQuery.bindValue(2, yflipped);
+        tileset.tileQuery.exec();
+
+        // Error handling
+        if (!tileset.tileQuery.next()) {
+            tileset.tileQuery.finish();
+            continue;
+        }
+
+        // Get data. The QByteArray is implicitly shared between the query
+        // result, the cache and the reply, so no further copies are made.
+        auto tileData = tileset.tileQuery.value(0).toByteArray();
+        tileset.tileQuery.finish();
+        return tileData;
+    }
+    return {};
 }
 
 
-auto GeoMaps::TileHandler::tileJSON() const -> QByteArray
+void GeoMaps::TileHandler::updateTileJSON()
 {
     QJsonObject result;
     result.insert("tilejson", "2.2.0");
@@ -203,8 +568,11 @@ auto GeoMaps::TileHandler::tileJSON() const -> QByteArray
     if (!_attribution.isEmpty()) {
         result.insert("attribution", _attribution);
     }
+    // Raster tiles are computed up to maxOverzoom levels beyond the maximal
+    // zoom level of the files. The map renderer only requests tiles up to the
+    // advertised maxzoom, so these levels must be included.
     if (_maxzoom >= 0) {
-        result.insert("maxzoom", _maxzoom);
+        result.insert("maxzoom", isRaster() ? _maxzoom+maxOverzoom : _maxzoom);
     }
     if (_minzoom >= 0) {
         result.insert("minzoom", _minzoom);
@@ -212,5 +580,5 @@ auto GeoMaps::TileHandler::tileJSON() const -> QByteArray
 
     QJsonDocument tileJSONDocument;
     tileJSONDocument.setObject(result);
-    return tileJSONDocument.toJson();
+    _tileJSON = tileJSONDocument.toJson();
 }
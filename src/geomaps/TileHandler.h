@@ -20,11 +20,18 @@
 
 #pragma once
 
-#include <QSet>
+#include <QHash>
+#include <QPointer>
 #include <QSqlDatabase>
+#include <QSet>
+#include <QSqlQuery>
+#include <QVector>
+#include <memory>
 
 #include <qhttpengine/handler.h>
 
+#include "TileCache.h"
+
 
 namespace GeoMaps {
 
@@ -46,11 +53,38 @@ class TileHandler : public QHttpEngine::Handler
   Q_OBJECT
   
 public:
+  /*! \brief An mbtiles file, together with its file name
+
+    Downloadables live in the GUI thread, while tile handlers typically live
+    in the worker threads of the TileServer. The file name is therefore read
+    in the GUI thread, see fromDownloadables(), and handed to the handler by
+    value.
+  */
+  struct MbtilesFile {
+    /*! \brief Downloadable that manages the file */
+    QPointer<GeoMaps::Downloadable> downloadable;
+
+    /*! \brief Name of the file, as returned by Downloadable::fileName() */
+    QString fileName;
+  };
+
+  /*! \brief Captures the file names of Downloadables
+
+    This method must be called in the thread of the Downloadables, typically
+    the GUI thread. Null pointers are skipped.
+
+    @param downloadables Downloadables
+
+    @returns List of files, in the same order
+  */
+  static QVector<MbtilesFile> fromDownloadables(const QVector<QPointer<GeoMaps::Downloadable>>& downloadables);
+
   /*! \brief Create a new  tile handler
    
     This constructor sets up a new tile handler.
     
-    @param mbtileFiles A list of Downloadable whose files are expected to
+    @param mbtileFiles A list of files, as obtained from fromDownloadables(),
+    which are expected to
     conform to the MBTiles Specification 1.3
     (https://github.com/mapbox/mbtiles-spec/blob/master/1.3/spec.md).  Whenever
     the Downloadble emits the signal aboutToChange to indicate that the file
@@ -65,10 +99,13 @@ public:
     @param baseURLName The name of the URL under which the tile server allows
     access to this tile. Typically a string of the form
     "http://localhost:8080/osm"
+
+    @param tileCache Cache used to hold tiles in memory. The cache must
+    outlive the handler. If nullptr, tiles are always read from the files.
     
     @param parent The standard QObject parent
   */
-  explicit TileHandler(const QVector<QPointer<GeoMaps::Downloadable>>& mbtileFiles, const QString& baseURLName, QObject *parent = nullptr);
+  explicit TileHandler(const QVector<GeoMaps::TileHandler::MbtilesFile>& mbtileFiles, const QString& baseURLName, GeoMaps::TileCache* tileCache = nullptr, QObject *parent = nullptr);
   
   // Destructor
   ~TileHandler() override;
@@ -143,7 +180,8 @@ public:
     
     This property holds a TileJSON file that describes the source. The file
     complies with specification 2.2.0
-    (https://github.com/mapbox/tilejson-spec/tree/master/2.2.0).
+    (https://github.com/mapbox/tilejson-spec/tree/master/2.2.0). The document
+    is generated whenever a file is added, and not for every request.
   */
   Q_PROPERTY(QByteArray tileJSON READ tileJSON CONSTANT)
   
@@ -151,7 +189,7 @@ public:
 
      @returns Property tileJSON
   */
-  QByteArray tileJSON() const;
+  QByteArray tileJSON() const {return _tileJSON;}
   
   /*! \brief Tile URL endpoints
     
@@ -167,6 +205,47 @@ public:
   */
   QString tiles() const {return _tiles;}
   
+  /*! \brief Reply to an HTTP request */
+  struct Response {
+    /*! \brief HTTP status code */
+    int statusCode {404};
+
+    /*! \brief Value of the Content-Type header */
+    QByteArray contentType;
+
+    /*! \brief Value of the Content-Encoding header, or an empty string */
+    QByteArray contentEncoding;
+
+    /*! \brief Body of the reply */
+    QByteArray data;
+  };
+
+  /*! \brief Compute the reply to a request
+
+    This method does the work for process(), but does not access any socket.
+    It is used by the TileServer, which holds connections open for several
+    requests.
+
+    @param path Path of the request, relative to the base URL of this handler
+
+    @returns Reply to the request. If nothing is found, the status code is
+    404.
+  */
+  Response respond(const QString &path);
+
+  /*! \brief Load a tile into the cache
+
+    If the tile is not yet in the cache, this method reads it from the files
+    and adds it to the cache. It does nothing if the handler has no cache.
+
+    @param z Zoom level
+
+    @param x Tile column
+
+    @param y Tile row, in XYZ scheme
+  */
+  void prefetch(int z, int x, int y);
+
   /*! \brief Version property, as found in the metadata table of the mbtile file
     
     This property is empty if no version is found.
@@ -178,6 +257,16 @@ public:
     @returns Property version
   */
   QString version() const {return _version;}
+
+  /*! \brief Reopen an mbtiles file after its content has changed
+
+    This method closes the database connection to the file, if it is still
+    open, and opens the file again. Other files of the tile set are not
+    touched. Nothing happens if the file does not belong to this handler.
+
+    @param mbtileFile File that has changed
+  */
+  void reopenFile(const GeoMaps::TileHandler::MbtilesFile& mbtileFile);
   
 protected:
   /*
@@ -194,7 +283,109 @@ private slots:
 private:
   Q_DISABLE_COPY_MOVE(TileHandler)
 
-  QSet<QString> databaseConnections;
+  // Metadata of a single mbtiles file, together with the part of the world
+  // covered by the file. The coverage is known precisely from the list of
+  // tiles at coverageZoom, or, if that list could not be read, approximately
+  // from the zoom range and bounding box found in the metadata table. The
+  // data is read once per file and shared by the handlers of all
+  // TileServerWorkers, see fileMetadata().
+  struct FileMetadata {
+    // Checks if the tile with the given coordinates (in XYZ scheme) might be
+    // contained in the file
+    bool covers(int z, int x, int y) const;
+
+    // Reads the list of tiles at coverageZoom and fills coverage
+    void readCoverage(QSqlDatabase& db);
+
+    // Key for a tile in coverage
+    static quint32 coverageKey(int x, int y) { return (static_cast<quint32>(x) << 16) | static_cast<quint32>(y); }
+
+    // Coverage is read at this zoom level, or at minzoom if that is larger
+    static constexpr int maxCoverageZoom = 8;
+
+    // For every zoom level up to coverageZoom, the set of tiles that contain
+    // data. Empty if coverageZoom is -1.
+    int coverageZoom {-1};
+    QVector<QSet<quint32>> coverage;
+
+    // Content of the metadata table, by key
+    QHash<QString, QString> values;
+
+    int minzoom {-1};
+    int maxzoom {-1};
+    double west {-180.0};
+    double south {-90.0};
+    double east {180.0};
+    double north {90.0};
+  };
+
+  // Returns the metadata of the file. The metadata is read from the open
+  // database db only if no other handler has read it for the same file,
+  // size and modification time before. This method is thread-safe. Returns
+  // nullptr if the metadata cannot be read.
+  static std::shared_ptr<const FileMetadata> fileMetadata(QSqlDatabase& db, const QString& fileName);
+
+  // Database connection to a single mbtiles file, together with a prepared
+  // query for tile data and the metadata of the file
+  struct Tileset {
+    QString connectionName;
+    QString fileName;
+    QSqlQuery tileQuery;
+    std::shared_ptr<const FileMetadata> metadata;
+  };
+  QVector<Tileset> tilesets;
+
+  // Opens an mbtiles file, reads its metadata and appends it to tilesets.
+  // Returns false if the file cannot be opened or read.
+  bool addFile(const GeoMaps::TileHandler::MbtilesFile& mbtileFile);
+
+  // Checks if the Downloadable manages one of the files in _mbtileFiles
+  bool hasFile(const GeoMaps::Downloadable* downloadable) const;
+
+  // Files of this tile set, as given in the constructor
+  QVector<MbtilesFile> _mbtileFiles;
+
+  // Computes _tileJSON from the properties
+  void updateTileJSON();
+
+  // Reads a tile from the files. Returns a null QByteArray if the tile is not
+  // found.
+  QByteArray readTile(int z, int x, int y);
+
+  // Returns a tile from the cache, or reads it from the files and adds it to
+  // the cache. Raster tiles that the files do not contain are computed by
+  // overzoomedTile(). Returns a null QByteArray if the tile is not found.
+  QByteArray tile(int z, int x, int y);
+
+  // Computes a raster tile from the tile at the maximal zoom level of the
+  // file that covers the region, at most maxOverzoom levels up: the part of
+  // that tile that covers the requested tile is cut out and scaled to full
+  // size. Returns a null QByteArray if the tile set does not hold raster
+  // tiles, or if the tile cannot be computed.
+  QByteArray overzoomedTile(int z, int x, int y);
+
+  // Checks if _format is an image format, rather than vector tiles
+  bool isRaster() const;
+
+  // Maximal number of zoom levels between a computed raster tile and the
+  // tile it is computed from. The TileJSON of raster tile sets advertises
+  // this many levels beyond _maxzoom. Vector tiles are overzoomed by the map
+  // renderer, which learns the maximal zoom level from the TileJSON.
+  //
+  // Known limitation: a TileJSON document has only one maxzoom. If the files
+  // of a vector tile set have different maximal zoom levels, for instance 10
+  // and 12, the largest one is advertised. The renderer then requests tiles
+  // of levels 11 and 12 in the region of the level-10 file, and these
+  // requests are answered with 404, so that the map shows no data there at
+  // these levels.
+  static constexpr int maxOverzoom = 6;
+
+  // Maximal number of bytes of each file that SQLite maps into memory
+  static constexpr qint64 mmapSize = (sizeof(void*) == 8) ? (qint64(1) << 30) : (qint64(64) << 20);
+
+  // Tile cache, and name of this tile set in the cache
+  QPointer<TileCache> _tileCache;
+  QString _tileCacheName;
   
   QString _name;
   QString _format;
@@ -204,6 +395,9 @@ private:
   QString _version;
   
   QString _attribution;
+
+  // TileJSON document, as computed by updateTileJSON()
+  QByteArray _tileJSON;
   
   int _maxzoom {-1};
   int _minzoom {-1};
@@ -0,0 +1,180 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QtMath>
+#include <chrono>
+#include <cmath>
+
+#include "Global.h"
+#include "TilePrefetcher.h"
+#include "navigation/Geodesy.h"
+#include "navigation/Navigator.h"
+#include "positioning/PositionProvider.h"
+
+using namespace std::chrono_literals;
+
+
+GeoMaps::TilePrefetcher::TilePrefetcher(TileServer *tileServer, QObject *parent)
+    : QObject(parent), m_tileServer(tileServer)
+{
+    m_updateTimer.setInterval(30s);
+    connect(&m_updateTimer, &QTimer::timeout, this, &GeoMaps::TilePrefetcher::updateQueue);
+
+    m_processTimer.setInterval(50ms);
+    connect(&m_processTimer, &QTimer::timeout, this, &GeoMaps::TilePrefetcher::processQueue);
+
+    // Deferred initialization
+    QTimer::singleShot(0, this, &GeoMaps::TilePrefetcher::deferredInitialization);
+}
+
+
+void GeoMaps::TilePrefetcher::deferredInitialization()
+{
+    connect(Global::navigator(), &Navigation::Navigator::isInFlightChanged, this, &GeoMaps::TilePrefetcher::updateQueue);
+    connect(Global::navigator()->flightRoute(), &Navigation::FlightRoute::waypointsChanged, this, &GeoMaps::TilePrefetcher::updateQueue);
+    m_updateTimer.start();
+}
+
+
+void GeoMaps::TilePrefetcher::setZoomLevel(double zoomLevel)
+{
+    auto newZoomLevel = qFloor(zoomLevel);
+    if (newZoomLevel == m_zoomLevel) {
+        return;
+    }
+    m_zoomLevel = newZoomLevel;
+    updateQueue();
+}
+
+
+void GeoMaps::TilePrefetcher::updateQueue()
+{
+    m_queue.clear();
+    m_processTimer.stop();
+
+    if (!Global::navigator()->isInFlight()) {
+        return;
+    }
+    auto info = Positioning::PositionProvider::globalInstance()->positionInfo();
+    if (!info.isValid()) {
+        return;
+    }
+    auto position = info.coordinate();
+    position.setAltitude(qQNaN());
+
+    auto speedInKT = minLookAheadSpeedInKT;
+    if (info.groundSpeed().isFinite()) {
+        speedInKT = qMax(speedInKT, info.groundSpeed().toKN());
+    }
+    auto lookAheadDistanceInM = speedInKT*1852.0*lookAheadInMinutes/60.0;
+
+    // Find the path ahead of the aircraft. If there is a flight route, follow
+    // the route from the next waypoint on. Otherwise, extrapolate the current
+    // track.
+    QVector<QGeoCoordinate> path;
+    path << position;
+    auto route = Global::navigator()->flightRoute()->coordinates();
+    if (route.size() >= 2) {
+        auto nearest = Navigation::Geodesy::nearest(position, Navigation::Geodesy::Points(route));
+        // If the aircraft is already past the nearest waypoint, continue with
+        // the one after it
+        if ((nearest+1 < route.size()) && (position.distanceTo(route[nearest+1]) < route[nearest].distanceTo(route[nearest+1]))) {
+            nearest++;
+        }
+        for(int i=nearest; i<route.size(); i++) {
+            path << route[i];
+        }
+    }
+    if ((path.size() == 1) && info.trueTrack().isFinite()) {
+        path << position.atDistanceAndAzimuth(lookAheadDistanceInM, info.trueTrack().toDEG());
+    }
+
+    // Walk along the path and add tiles. The step size is half the width of a
+    // tile at the larger zoom level.
+    auto stepInM = 0.5*40075016.686*qCos(qDegreesToRadians(position.latitude()))/static_cast<double>(quint32(1) << qBound(0, m_zoomLevel, 30));
+    stepInM = qMax(stepInM, 100.0);
+    QSet<quint64> queuedTiles;
+    auto remainingInM = lookAheadDistanceInM;
+    for(int i=0; (i+1<path.size()) && (remainingInM > 0); i++) {
+        auto segmentLengthInM = path[i].distanceTo(path[i+1]);
+        auto azimuth = path[i].azimuthTo(path[i+1]);
+        for(double d=0.0; (d<=segmentLengthInM) && (d<=remainingInM); d += stepInM) {
+            auto sample = path[i].atDistanceAndAzimuth(d, azimuth);
+            addTilesAround(sample, m_zoomLevel, queuedTiles);
+            addTilesAround(sample, m_zoomLevel-1, queuedTiles);
+        }
+        remainingInM -= segmentLengthInM;
+    }
+
+    if (!m_queue.isEmpty()) {
+        m_processTimer.start();
+    }
+}
+
+
+void GeoMaps::TilePrefetcher::processQueue()
+{
+    if (m_queue.isEmpty() || m_tileServer.isNull()) {
+        m_processTimer.stop();
+        return;
+    }
+
+    // Requests from the map have priority
+    auto msecs = m_tileServer->msecsSinceLastRequest();
+    if ((msecs >= 0) && (msecs < idleTimeInMSecs)) {
+        return;
+    }
+
+    auto tile = m_queue.takeFirst();
+    m_tileServer->prefetchTile(tile.z, tile.x, tile.y);
+}
+
+
+void GeoMaps::TilePrefetcher::addTilesAround(const QGeoCoordinate& coordinate, int z, QSet<quint64>& queuedTiles)
+{
+    if ((z < 0) || (z > 30)) {
+        return;
+    }
+
+    auto n = static_cast<int>(quint32(1) << z);
+    auto lat = qDegreesToRadians(qBound(-85.0511, coordinate.latitude(), 85.0511));
+    auto centerX = qFloor((coordinate.longitude()+180.0)/360.0*n);
+    auto centerY = qFloor((1.0-std::asinh(qTan(lat))/M_PI)/2.0*n);
+
+    for(int x=centerX-1; x<=centerX+1; x++) {
+        for(int y=centerY-1; y<=centerY+1; y++) {
+            if ((y < 0) || (y >= n)) {
+                continue;
+            }
+            auto wrappedX = (x+n) % n;
+            auto key = (static_cast<quint64>(z) << 58) | (static_cast<quint64>(wrappedX) << 29) | static_cast<quint64>(y);
+            if (queuedTiles.contains(key)) {
+                continue;
+            }
+            queuedTiles.insert(key);
+
+            Tile tile;
+            tile.z = z;
+            tile.x = wrappedX;
+            tile.y = y;
+            m_queue.append(tile);
+        }
+    }
+}
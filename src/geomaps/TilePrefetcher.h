@@ -0,0 +1,109 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QGeoCoordinate>
+#include <QPointer>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+
+#include "TileServer.h"
+
+
+namespace GeoMaps {
+
+/*! \brief Prefetches map tiles along the flight path
+ *
+ * While the aircraft is flying, this class loads the tiles that the map will
+ * most likely show in the next minutes into the cache of the TileServer. The
+ * class follows the current flight route, if there is one, and extrapolates
+ * the current track otherwise. Tiles are loaded one at a time, and only while
+ * the TileServer is not busy answering requests from the map.
+ */
+
+class TilePrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*! \brief Standard constructor
+     *
+     * @param tileServer Tile server whose cache is filled
+     *
+     * @param parent The standard QObject parent pointer
+     */
+    explicit TilePrefetcher(TileServer *tileServer, QObject *parent = nullptr);
+
+    // Standard destructor
+    ~TilePrefetcher() override = default;
+
+    /*! \brief Set zoom level of the map
+     *
+     * Tiles are prefetched for this zoom level and the next smaller one.
+     *
+     * @param zoomLevel Zoom level of the map
+     */
+    void setZoomLevel(double zoomLevel);
+
+private slots:
+    // Intializations that are moved out of the constructor, in order to avoid
+    // nested uses of constructors in Global.
+    void deferredInitialization();
+
+    // Computes the list of tiles to prefetch
+    void updateQueue();
+
+    // Prefetches the next tile in the queue, unless the tile server is busy
+    void processQueue();
+
+private:
+    Q_DISABLE_COPY_MOVE(TilePrefetcher)
+
+    // Coordinates of a tile, in XYZ scheme
+    struct Tile {
+        int z {0};
+        int x {0};
+        int y {0};
+    };
+
+    // Adds the tiles around coordinate to the queue, unless they are already
+    // contained
+    void addTilesAround(const QGeoCoordinate& coordinate, int z, QSet<quint64>& queuedTiles);
+
+    // Prefetch tiles for the next minutes of flight
+    static constexpr double lookAheadInMinutes = 10.0;
+
+    // Speed assumed for look-ahead if the aircraft is slower
+    static constexpr double minLookAheadSpeedInKT = 60.0;
+
+    // Number of milliseconds after a request from a client during which no
+    // tiles are prefetched
+    static constexpr qint64 idleTimeInMSecs = 500;
+
+    QPointer<TileServer> m_tileServer;
+    int m_zoomLevel {9};
+    QVector<Tile> m_queue;
+    QTimer m_updateTimer;
+    QTimer m_processTimer;
+};
+
+};
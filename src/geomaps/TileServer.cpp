@@ -23,16 +23,37 @@
 
 #include "TileHandler.h"
 #include "TileServer.h"
+#include "TileServerWorker.h"
 #include "geomaps/Downloadable.h"
 
 
 GeoMaps::TileServer::TileServer(QUrl baseUrl, QObject *parent)
     : QHttpEngine::Server(parent), _baseUrl(std::move(baseUrl))
 {
+    clock.start();
+
+    auto numRequestWorkers = qBound(1, QThread::idealThreadCount()-1, 4);
+    for(int i=0; i<numRequestWorkers; i++) {
+        requestWorkers.append(startWorker(QThread::NormalPriority));
+    }
+    prefetchWorker = startWorker(QThread::LowestPriority);
+
     setUpTileHandlers();
 }
 
 
+GeoMaps::TileServer::~TileServer()
+{
+    // Workers are deleted when their threads finish
+    foreach(auto thread, workerThreads) {
+        thread->quit();
+    }
+    foreach(auto thread, workerThreads) {
+        thread->wait();
+    }
+}
+
+
 auto GeoMaps::TileServer::serverUrl() const -> QString
 {
     if (isListening()) {
@@ -56,30 +77,87 @@ void GeoMaps::TileServer::removeMbtilesFileSet(const QString& path)
 }
 
 
+void GeoMaps::TileServer::reopenMbtilesFiles(const QVector<QPointer<Downloadable>>& mbtileFiles)
+{
+    auto files = TileHandler::fromDownloadables(mbtileFiles);
+    auto workers = requestWorkers;
+    workers.append(prefetchWorker);
+    foreach(auto worker, workers) {
+        if (worker.isNull()) {
+            continue;
+        }
+        QMetaObject::invokeMethod(worker, [worker, files]() { worker->reopenFiles(files); }, Qt::QueuedConnection);
+    }
+}
+
+
+void GeoMaps::TileServer::incomingConnection(qintptr socketDescriptor)
+{
+    auto worker = requestWorkers[nextRequestWorker];
+    nextRequestWorker = (nextRequestWorker+1) % requestWorkers.size();
+    if (worker.isNull()) {
+        return;
+    }
+    QMetaObject::invokeMethod(worker, [worker, socketDescriptor]() { worker->addConnection(socketDescriptor); }, Qt::QueuedConnection);
+}
+
+
+auto GeoMaps::TileServer::msecsSinceLastRequest() const -> qint64
+{
+    auto last = lastRequestMSecs.load();
+    if (last < 0) {
+        return -1;
+    }
+    return clock.elapsed()-last;
+}
+
+
+void GeoMaps::TileServer::prefetchTile(int z, int x, int y)
+{
+    auto worker = prefetchWorker;
+    if (worker.isNull()) {
+        return;
+    }
+    QMetaObject::invokeMethod(worker, [worker, z, x, y]() { worker->prefetchTile(z, x, y); }, Qt::QueuedConnection);
+}
+
+
+auto GeoMaps::TileServer::startWorker(QThread::Priority priority) -> QPointer<TileServerWorker>
+{
+    auto *thread = new QThread(this);
+    auto *worker = new TileServerWorker(this, &_tileCache);
+    worker->moveToThread(thread);
+    connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+    thread->start(priority);
+    workerThreads.append(thread);
+    return worker;
+}
+
+
 void GeoMaps::TileServer::setUpTileHandlers()
 {
-    // Create new file system handler and delete old one
-    auto *newFileSystemHandler = new QHttpEngine::FilesystemHandler(":", this);
-    newFileSystemHandler->addRedirect(QRegExp("^$"), "/index.html");
-    setHandler(newFileSystemHandler);
-    delete currentFileSystemHandler;
-    currentFileSystemHandler = newFileSystemHandler;
-
-    // Now add subhandlers for each tile
-    QMapIterator<QString, QVector<QPointer<Downloadable>>> iterator(mbtileFileNameSets);
-    while (iterator.hasNext()) {
-        iterator.next();
-
-        // Find base name of the file
-        QString URL;
+    // Compute URLs of the tile sets
+    QMap<QString, QString> URLs;
+    foreach(auto baseName, mbtileFileNameSets.keys()) {
         if (_baseUrl.isEmpty()) {
-            URL = serverUrl()+"/"+iterator.key();
+            URLs[baseName] = serverUrl()+"/"+baseName;
         } else {
-            URL = _baseUrl.toString()+"/"+iterator.key();
+            URLs[baseName] = _baseUrl.toString()+"/"+baseName;
         }
-
-        auto *handler = new TileHandler(iterator.value(), URL, newFileSystemHandler);
-        newFileSystemHandler->addSubHandler(QRegExp("^"+iterator.key()), handler);
     }
 
+    // Set up tile handlers in all workers. The file names are read here, in
+    // the thread of the Downloadables, and handed to the workers by value.
+    QMap<QString, QVector<TileHandler::MbtilesFile>> sets;
+    for(auto iterator = mbtileFileNameSets.constBegin(); iterator != mbtileFileNameSets.constEnd(); ++iterator) {
+        sets.insert(iterator.key(), TileHandler::fromDownloadables(iterator.value()));
+    }
+    auto workers = requestWorkers;
+    workers.append(prefetchWorker);
+    foreach(auto worker, workers) {
+        if (worker.isNull()) {
+            continue;
+        }
+        QMetaObject::invokeMethod(worker, [worker, sets, URLs]() { worker->setTileSets(sets, URLs); }, Qt::QueuedConnection);
+    }
 }
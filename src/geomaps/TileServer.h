@@ -20,14 +20,22 @@
 
 #pragma once
 
-#include <qhttpengine/filesystemhandler.h>
 #include <qhttpengine/server.h>
 
+#include <QElapsedTimer>
 #include <QPointer>
+#include <QThread>
+#include <atomic>
+
+#include "TileCache.h"
+#include "TileHandler.h"
 
 
 namespace GeoMaps {
 
+class TileServerWorker;
+
+
 /*! \brief HTTP server for mapbox' MBTiles files
   
   This class features an HTTP server that is able to serve MBTiles, for use in
@@ -47,6 +55,18 @@ namespace GeoMaps {
   containing openstreetmap data and one set with raster data used for
   hillshading. Each set contains two MBTiles files, one for Africa and one for
   Europe.
+
+  Unlike QHttpEngine::Server, which closes the connection after every request,
+  this server implements persistent connections following HTTP/1.1. Clients
+  can send several requests over the same connection, also without waiting
+  for the replies (pipelining). The replies are sent in the order in which the
+  requests arrived. Connections that have been idle for some time are closed.
+
+  The server accepts connections in the thread in which it lives, but reading
+  requests and databases is done by a small pool of TileServerWorkers, each
+  running in a dedicated thread with its own database connections. This keeps
+  slow database reads away from the GUI thread. Prefetching is done by another
+  worker, whose thread runs with low priority.
 */
 
 class TileServer : public QHttpEngine::Server
@@ -73,7 +93,7 @@ public:
   explicit TileServer(QUrl baseUrl=QUrl(), QObject *parent = nullptr);
   
   // Standard destructor
-  ~TileServer() override = default;
+  ~TileServer() override;
   
   /*! \brief URL under which this server is presently reachable
     
@@ -85,6 +105,42 @@ public:
     @returns URL under which this server is presently reachable
   */
   QString serverUrl() const;
+
+  /*! \brief In-memory cache for tiles served by this server
+
+    The cache is shared by all sets of tile files. Its size can be set via the
+    property TileCache::maxSize.
+
+    @returns Pointer to the tile cache
+  */
+  TileCache* tileCache() { return &_tileCache; }
+
+  /*! \brief Time since the last request from a client
+
+    @returns Number of milliseconds since the last request arrived, or -1 if
+    no request has arrived yet
+  */
+  qint64 msecsSinceLastRequest() const;
+
+  /*! \brief Note that a request from a client has arrived
+
+    This method is called by the TileServerWorkers. It is thread safe.
+  */
+  void registerRequest() { lastRequestMSecs = clock.elapsed(); }
+
+  /*! \brief Load a tile from all tile sets into the cache
+
+    This method is meant for prefetching. It does not count as a request from a
+    client. It returns immediately; the tile is loaded by a worker thread of
+    low priority.
+
+    @param z Zoom level
+
+    @param x Tile column
+
+    @param y Tile row, in XYZ scheme
+  */
+  void prefetchTile(int z, int x, int y);
 			   
 public slots:
   /*! \brief Add a new set of tile files
@@ -113,17 +169,48 @@ public slots:
     @param path Path of tiles to remove
    */
   void removeMbtilesFileSet(const QString& path);
-  
+
+  /*! \brief Reopen mbtile files whose content has changed
+
+    This method is much cheaper than removing and adding the file sets that
+    contain the files: the tile handlers are kept, and only the database
+    connections to the given files are opened again. Tiles of the affected
+    file sets are removed from the tileCache().
+
+    @param mbtileFiles Files that have changed
+   */
+  void reopenMbtilesFiles(const QVector<QPointer<GeoMaps::Downloadable>>& mbtileFiles);
+
+protected:
+  // Reimplementation of QTcpServer::incomingConnection(). Hands the
+  // connection over to one of the workers.
+  void incomingConnection(qintptr socketDescriptor) override;
+
 private:
   Q_DISABLE_COPY_MOVE(TileServer)
 
+  // Starts a worker in a new thread of the given priority
+  QPointer<TileServerWorker> startWorker(QThread::Priority priority);
+
   void setUpTileHandlers();
-  
-  QPointer<QHttpEngine::FilesystemHandler> currentFileSystemHandler;
+
+  // Worker threads, workers answering requests and worker used for
+  // prefetching
+  QVector<QThread*> workerThreads;
+  QVector<QPointer<TileServerWorker>> requestWorkers;
+  QPointer<TileServerWorker> prefetchWorker;
+  int nextRequestWorker {0};
+
   
   QMap<QString,QVector<QPointer<Downloadable>>> mbtileFileNameSets;
   
   QUrl _baseUrl;
+
+  TileCache _tileCache;
+
+  // Time of the last request, in milliseconds of clock, or -1
+  QElapsedTimer clock;
+  std::atomic<qint64> lastRequestMSecs {-1};
 };
 
 };
@@ -0,0 +1,217 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMimeDatabase>
+#include <QTimer>
+#include <QUrl>
+
+#include "Metrics.h"
+#include "TileServer.h"
+#include "TileServerWorker.h"
+
+
+GeoMaps::TileServerWorker::TileServerWorker(TileServer *server, TileCache *tileCache)
+    : m_server(server), m_tileCache(tileCache)
+{
+}
+
+
+void GeoMaps::TileServerWorker::addConnection(qintptr socketDescriptor)
+{
+    auto *socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        delete socket;
+        return;
+    }
+
+    // Close connections that have been idle for some time
+    auto *idleTimer = new QTimer(socket);
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(30*1000);
+    connect(idleTimer, &QTimer::timeout, socket, &QTcpSocket::disconnectFromHost);
+    idleTimer->start();
+
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket, idleTimer]() {
+        idleTimer->start();
+        readRequests(socket);
+    });
+    connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+}
+
+
+void GeoMaps::TileServerWorker::prefetchTile(int z, int x, int y)
+{
+    foreach(auto handler, m_tileHandlers) {
+        if (!handler.isNull()) {
+            handler->prefetch(z, x, y);
+        }
+    }
+}
+
+
+void GeoMaps::TileServerWorker::setTileSets(const QMap<QString, QVector<TileHandler::MbtilesFile>>& mbtileFileNameSets, const QMap<QString, QString>& URLs)
+{
+    // Delete old tile handlers
+    delete m_handlerParent;
+    m_handlerParent = new QObject(this);
+    m_tileHandlers.clear();
+
+    // Now add handlers for each tile set
+    QMapIterator<QString, QVector<TileHandler::MbtilesFile>> iterator(mbtileFileNameSets);
+    while (iterator.hasNext()) {
+        iterator.next();
+        m_tileHandlers[iterator.key()] = new TileHandler(iterator.value(), URLs.value(iterator.key()), m_tileCache, m_handlerParent);
+    }
+}
+
+
+void GeoMaps::TileServerWorker::reopenFiles(const QVector<TileHandler::MbtilesFile>& mbtileFiles)
+{
+    foreach(auto tileHandler, m_tileHandlers) {
+        if (tileHandler.isNull()) {
+            continue;
+        }
+        foreach(const auto& mbtileFile, mbtileFiles) {
+            tileHandler->reopenFile(mbtileFile);
+        }
+    }
+}
+
+
+void GeoMaps::TileServerWorker::readRequests(QTcpSocket *socket)
+{
+    while (socket->state() == QAbstractSocket::ConnectedState) {
+        // Check if a complete request header is available. Requests with
+        // body are not supported.
+        auto buffer = socket->peek(socket->bytesAvailable());
+        auto headerEnd = buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            if (buffer.size() > 16*1024) {
+                socket->disconnectFromHost();
+            }
+            return;
+        }
+        auto header = socket->read(headerEnd+4);
+        m_server->registerRequest();
+
+        // Parse request line and headers
+        auto lines = header.split('\n');
+        auto requestLine = lines.takeFirst().trimmed().split(' ');
+        if (requestLine.size() != 3) {
+            socket->write("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            socket->disconnectFromHost();
+            return;
+        }
+        const auto& method = requestLine[0];
+        const auto& version = requestLine[2];
+        QByteArray connectionHeader;
+        foreach(auto line, lines) {
+            auto colon = line.indexOf(':');
+            if ((colon > 0) && (line.left(colon).trimmed().toLower() == "connection")) {
+                connectionHeader = line.mid(colon+1).trimmed().toLower();
+            }
+        }
+        bool keepAlive = (version == "HTTP/1.1") ? (connectionHeader != "close") : (connectionHeader == "keep-alive");
+
+        // Compute reply
+        TileHandler::Response response;
+        if ((method == "GET") || (method == "HEAD")) {
+            auto path = QUrl::fromPercentEncoding(requestLine[1].split('?').first());
+            while (path.startsWith('/')) {
+                path = path.mid(1);
+            }
+            response = respond(path);
+        } else {
+            response.statusCode = 405;
+        }
+
+        // Write reply
+        QByteArray reply = "HTTP/1.1 " + QByteArray::number(response.statusCode);
+        switch(response.statusCode) {
+        case 200:
+            reply += " OK\r\n";
+            break;
+        case 405:
+            reply += " Method Not Allowed\r\n";
+            break;
+        default:
+            reply += " Not Found\r\n";
+            break;
+        }
+        if (!response.contentType.isEmpty()) {
+            reply += "Content-Type: " + response.contentType + "\r\n";
+        }
+        if (!response.contentEncoding.isEmpty()) {
+            reply += "Content-Encoding: " + response.contentEncoding + "\r\n";
+        }
+        reply += "Content-Length: " + QByteArray::number(response.data.size()) + "\r\n";
+        reply += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        socket->write(reply);
+        if (method != "HEAD") {
+            socket->write(response.data);
+        }
+
+        if (!keepAlive) {
+            socket->disconnectFromHost();
+            return;
+        }
+    }
+}
+
+
+auto GeoMaps::TileServerWorker::respond(const QString& path) -> TileHandler::Response
+{
+    // Tiles and TileJSON
+    for(auto iterator = m_tileHandlers.constBegin(); iterator != m_tileHandlers.constEnd(); ++iterator) {
+        if (!path.startsWith(iterator.key()) || iterator.value().isNull()) {
+            continue;
+        }
+        auto subPath = path.mid(iterator.key().size());
+        if (!subPath.isEmpty() && !subPath.startsWith('/') && !subPath.startsWith('.')) {
+            continue;
+        }
+        return iterator.value()->respond(subPath);
+    }
+
+    // Diagnostics
+    TileHandler::Response response;
+    if (path == QLatin1String("metrics.json")) {
+        response.statusCode = 200;
+        response.contentType = "application/json";
+        response.data = Metrics::toJSON();
+        return response;
+    }
+
+    // Static content from the Qt resource system
+    auto fileName = ":/" + (path.isEmpty() ? QStringLiteral("index.html") : path);
+    if (path.contains(QLatin1String("..")) || QFileInfo(fileName).isDir()) {
+        return response;
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return response;
+    }
+    response.statusCode = 200;
+    response.contentType = QMimeDatabase().mimeTypeForFile(fileName, QMimeDatabase::MatchExtension).name().toLatin1();
+    response.data = file.readAll();
+    return response;
+}
@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QMap>
+#include <QObject>
+#include <QPointer>
+#include <QTcpSocket>
+
+#include "TileCache.h"
+#include "TileHandler.h"
+
+
+namespace GeoMaps {
+
+class TileServer;
+
+
+/*! \brief Worker that answers requests to the TileServer
+
+  Instances of this class live in worker threads owned by the TileServer. Each
+  worker owns its own set of TileHandlers, and therefore its own connections to
+  the mbtiles databases, as required by Qt SQL. The worker handles persistent
+  connections following HTTP/1.1: clients can send several requests over the
+  same connection, also without waiting for the replies (pipelining). The
+  replies are sent in the order in which the requests arrived. Connections that
+  have been idle for some time are closed.
+
+  The slots of this class are meant to be called through queued connections
+  from the thread of the TileServer.
+*/
+
+class TileServerWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  /*! \brief Create a new worker
+
+    @param server TileServer that owns this worker. The server is informed
+    about every request, see TileServer::registerRequest().
+
+    @param tileCache Cache shared by all workers
+  */
+  explicit TileServerWorker(TileServer *server, TileCache *tileCache);
+
+  // Standard destructor
+  ~TileServerWorker() override = default;
+
+public slots:
+  /*! \brief Take over a new connection
+
+    @param socketDescriptor Socket descriptor, as passed to
+    QTcpServer::incomingConnection()
+  */
+  void addConnection(qintptr socketDescriptor);
+
+  /*! \brief Load a tile from all tile sets into the cache
+
+    @param z Zoom level
+
+    @param x Tile column
+
+    @param y Tile row, in XYZ scheme
+  */
+  void prefetchTile(int z, int x, int y);
+
+  /*! \brief Set up tile handlers
+
+    This method deletes all existing tile handlers and creates new ones.
+
+    @param mbtileFileNameSets Sets of mbtile files, by base name
+
+    @param URLs URLs under which the tile sets are available, by base name
+  */
+  void setTileSets(const QMap<QString, QVector<GeoMaps::TileHandler::MbtilesFile>>& mbtileFileNameSets, const QMap<QString, QString>& URLs);
+
+  /*! \brief Reopen mbtile files whose content has changed
+
+    The tile handlers are kept; only their connections to the given files are
+    opened again.
+
+    @param mbtileFiles Files that have changed
+  */
+  void reopenFiles(const QVector<GeoMaps::TileHandler::MbtilesFile>& mbtileFiles);
+
+private:
+  Q_DISABLE_COPY_MOVE(TileServerWorker)
+
+  // Reads and answers all complete requests that are available on the
+  // socket, in order
+  void readRequests(QTcpSocket *socket);
+
+  // Computes the reply to a GET or HEAD request for the given path, which
+  // does not start with a slash
+  TileHandler::Response respond(const QString& path);
+
+  TileServer *m_server;
+  TileCache *m_tileCache;
+
+  // Parent of the tile handlers. This object is deleted and re-created every
+  // time the tile handlers are set up.
+  QPointer<QObject> m_handlerParent;
+
+  // Tile handlers, by base name
+  QMap<QString, QPointer<TileHandler>> m_tileHandlers;
+};
+
+};
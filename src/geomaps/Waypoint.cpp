@@ -21,15 +21,32 @@
 
 #include <QJsonArray>
 
+#include "StringPool.h"
 #include "Waypoint.h"
 #include "units/Distance.h"
 
 
+namespace {
+
+// Property values that are strings are interned, so that tens of thousands
+// of waypoints share the data of their keys and of frequent values, instead of
+// holding one copy each
+auto interned(const QVariant& variant) -> QVariant
+{
+    if (variant.type() != QVariant::String) {
+        return variant;
+    }
+    return GeoMaps::StringPool::interned(variant.toString());
+}
+
+}
+
+
 GeoMaps::Waypoint::Waypoint()
 {
-    m_properties.insert("CAT", QString("WP"));
-    m_properties.insert("NAM", QString("Waypoint"));
-    m_properties.insert("TYP", QString("WP"));
+    m_properties.insert(QStringLiteral("CAT"), QString("WP"));
+    m_properties.insert(QStringLiteral("NAM"), QString("Waypoint"));
+    m_properties.insert(QStringLiteral("TYP"), QString("WP"));
 
     // Set cached property
     m_isValid = computeIsValid();
@@ -39,9 +56,9 @@ GeoMaps::Waypoint::Waypoint()
 GeoMaps::Waypoint::Waypoint(const QGeoCoordinate& coordinate)
     : m_coordinate(coordinate)
 {
-    m_properties.insert("CAT", QString("WP"));
-    m_properties.insert("NAM", QString("Waypoint"));
-    m_properties.insert("TYP", QString("WP"));
+    m_properties.insert(QStringLiteral("CAT"), QString("WP"));
+    m_properties.insert(QStringLiteral("NAM"), QString("Waypoint"));
+    m_properties.insert(QStringLiteral("TYP"), QString("WP"));
 
     // Set cached property
     m_isValid = computeIsValid();
@@ -60,8 +77,9 @@ GeoMaps::Waypoint::Waypoint(const QJsonObject &geoJSONObject)
         return;
     }
     auto properties = geoJSONObject["properties"].toObject();
-    foreach(auto propertyName, properties.keys())
-        m_properties.insert(propertyName, properties[propertyName].toVariant());
+    for(auto iterator = properties.constBegin(); iterator != properties.constEnd(); ++iterator) {
+        m_properties.insert(GeoMaps::StringPool::interned(iterator.key()), interned(iterator.value().toVariant()));
+    }
 
     // Get geometry
     if (!geoJSONObject.contains("geometry")) {
@@ -79,7 +97,7 @@ GeoMaps::Waypoint::Waypoint(const QJsonObject &geoJSONObject)
         return;
     }
     m_coordinate = QGeoCoordinate(coordinateArray[1].toDouble(), coordinateArray[0].toDouble() );
-    if (m_properties.contains("ELE")) {
+    if (m_properties.contains(QStringLiteral("ELE"))) {
         m_coordinate.setAltitude(properties["ELE"].toDouble());
     }
 
@@ -88,6 +106,20 @@ GeoMaps::Waypoint::Waypoint(const QJsonObject &geoJSONObject)
 }
 
 
+GeoMaps::Waypoint::Waypoint(QDataStream &inputStream)
+{
+    QMultiMap<QString, QVariant> properties;
+    inputStream >> m_coordinate;
+    inputStream >> properties;
+    for(auto iterator = properties.constBegin(); iterator != properties.constEnd(); ++iterator) {
+        m_properties.insert(GeoMaps::StringPool::interned(iterator.key()), interned(iterator.value()));
+    }
+
+    // Set cached property
+    m_isValid = computeIsValid();
+}
+
+
 //
 // METHODS
 //
@@ -97,72 +129,72 @@ auto GeoMaps::Waypoint::computeIsValid() const -> bool
     if (!m_coordinate.isValid()) {
         return false;
     }
-    if (!m_properties.contains("TYP")) {
+    if (!m_properties.contains(QStringLiteral("TYP"))) {
         return false;
     }
-    auto TYP = m_properties.value("TYP").toString();
+    auto TYP = m_properties.value(QStringLiteral("TYP")).toString();
 
     // Handle airfields
-    if (TYP == "AD") {
+    if (TYP == QLatin1String("AD")) {
         // Property CAT
-        if (!m_properties.contains("CAT")) {
+        if (!m_properties.contains(QStringLiteral("CAT"))) {
             return false;
         }
-        auto CAT = m_properties.value("CAT").toString();
-        if ((CAT != "AD") && (CAT != "AD-GRASS") && (CAT != "AD-PAVED") &&
-                (CAT != "AD-INOP") && (CAT != "AD-GLD") && (CAT != "AD-MIL") &&
-                (CAT != "AD-MIL-GRASS") && (CAT != "AD-MIL-PAVED") && (CAT != "AD-UL") &&
-                (CAT != "AD-WATER")) {
+        auto CAT = m_properties.value(QStringLiteral("CAT")).toString();
+        if ((CAT != QLatin1String("AD")) && (CAT != QLatin1String("AD-GRASS")) && (CAT != QLatin1String("AD-PAVED")) &&
+                (CAT != QLatin1String("AD-INOP")) && (CAT != QLatin1String("AD-GLD")) && (CAT != QLatin1String("AD-MIL")) &&
+                (CAT != QLatin1String("AD-MIL-GRASS")) && (CAT != QLatin1String("AD-MIL-PAVED")) && (CAT != QLatin1String("AD-UL")) &&
+                (CAT != QLatin1String("AD-WATER"))) {
             return false;
         }
 
         // Property ELE
-        if (!m_properties.contains("ELE")) {
+        if (!m_properties.contains(QStringLiteral("ELE"))) {
             return false;
         }
         bool ok = false;
-        m_properties.value("ELE").toInt(&ok);
+        m_properties.value(QStringLiteral("ELE")).toInt(&ok);
         if (!ok) {
             return false;
         }
 
         // Property NAM
-        if (!m_properties.contains("NAM")) {
+        if (!m_properties.contains(QStringLiteral("NAM"))) {
             return false;
         }
         return true;
     }
 
     // Handle NavAids
-    if (TYP == "NAV") {
+    if (TYP == QLatin1String("NAV")) {
         // Property CAT
-        if (!m_properties.contains("CAT")) {
+        if (!m_properties.contains(QStringLiteral("CAT"))) {
             return false;
         }
-        auto CAT = m_properties.value("CAT").toString();
-        if ((CAT != "NDB") && (CAT != "VOR") && (CAT != "VOR-DME") &&
-                (CAT != "VORTAC") && (CAT != "DVOR") && (CAT != "DVOR-DME") &&
-                (CAT != "DVORTAC")) {
+        auto CAT = m_properties.value(QStringLiteral("CAT")).toString();
+        if ((CAT != QLatin1String("NDB")) && (CAT != QLatin1String("VOR")) && (CAT != QLatin1String("VOR-DME")) &&
+                (CAT != QLatin1String("VORTAC")) && (CAT != QLatin1String("DVOR")) && (CAT != QLatin1String("DVOR-DME")) &&
+                (CAT != QLatin1String("DVORTAC"))) {
             return false;
         }
 
         // Property COD
-        if (!m_properties.contains("COD")) {
+        if (!m_properties.contains(QStringLiteral("COD"))) {
             return false;
         }
 
         // Property NAM
-        if (!m_properties.contains("NAM")) {
+        if (!m_properties.contains(QStringLiteral("NAM"))) {
             return false;
         }
 
         // Property NAV
-        if (!m_properties.contains("NAV")) {
+        if (!m_properties.contains(QStringLiteral("NAV"))) {
             return false;
         }
 
         // Property MOR
-        if (!m_properties.contains("MOR")) {
+        if (!m_properties.contains(QStringLiteral("MOR"))) {
             return false;
         }
 
@@ -170,31 +202,31 @@ auto GeoMaps::Waypoint::computeIsValid() const -> bool
     }
 
     // Handle waypoints
-    if (TYP == "WP") {
+    if (TYP == QLatin1String("WP")) {
         // Property CAT
-        if (!m_properties.contains("CAT")) {
+        if (!m_properties.contains(QStringLiteral("CAT"))) {
             return false;
         }
-        auto CAT = m_properties.value("CAT").toString();
-        if ((CAT != "MRP") && (CAT != "RP") && (CAT != "WP")) {
+        auto CAT = m_properties.value(QStringLiteral("CAT")).toString();
+        if ((CAT != QLatin1String("MRP")) && (CAT != QLatin1String("RP")) && (CAT != QLatin1String("WP"))) {
             return false;
         }
 
         // Property COD
-        if ((CAT == "MRP") || (CAT == "RP")) {
-            if (!m_properties.contains("COD")) {
+        if ((CAT == QLatin1String("MRP")) || (CAT == QLatin1String("RP"))) {
+            if (!m_properties.contains(QStringLiteral("COD"))) {
                 return false;
             }
         }
 
         // Property NAM
-        if (!m_properties.contains("NAM")) {
+        if (!m_properties.contains(QStringLiteral("NAM"))) {
             return false;
         }
 
         // Property SCO
-        if ((CAT == "MRP") || (CAT == "RP")) {
-            if (!m_properties.contains("SCO")) {
+        if ((CAT == QLatin1String("MRP")) || (CAT == QLatin1String("RP"))) {
+            if (!m_properties.contains(QStringLiteral("SCO"))) {
                 return false;
             }
         }
@@ -223,7 +255,8 @@ auto GeoMaps::Waypoint::isNear(const Waypoint& other) const -> bool
 auto GeoMaps::Waypoint::renamed(const QString &newName) const -> GeoMaps::Waypoint
 {
     Waypoint copy(*this);
-    copy.m_properties.replace("NAM", newName);
+    copy.m_properties.replace(QStringLiteral("NAM"), newName);
+    copy.m_derivedStrings = std::make_shared<DerivedStrings>();
     return copy;
 }
 
@@ -245,29 +278,74 @@ auto GeoMaps::Waypoint::toJSON() const -> QJsonObject
 }
 
 
+void GeoMaps::Waypoint::write(QDataStream &out) const
+{
+    out << m_coordinate;
+    out << m_properties;
+}
+
+
 //
 // PROPERTIES
 //
 
 
+auto GeoMaps::Waypoint::derivedStrings() const -> const DerivedStrings&
+{
+    // All copies that share the cache have the same properties, so it does
+    // not matter which of them computes the strings
+    std::call_once(m_derivedStrings->computed, [this]() {
+        m_derivedStrings->extendedName = computeExtendedName();
+        m_derivedStrings->icon = computeIcon();
+        m_derivedStrings->tabularDescription = computeTabularDescription();
+        m_derivedStrings->twoLineTitle = computeTwoLineTitle(m_derivedStrings->extendedName);
+    });
+    return *m_derivedStrings;
+}
+
+
 auto GeoMaps::Waypoint::extendedName() const -> QString
 {
-    if (m_properties.value("TYP").toString() == "NAV") {
-        return QString("%1 (%2)").arg(m_properties.value("NAM").toString(), m_properties.value("CAT").toString());
+    return derivedStrings().extendedName;
+}
+
+
+auto GeoMaps::Waypoint::icon() const -> QString
+{
+    return derivedStrings().icon;
+}
+
+
+auto GeoMaps::Waypoint::tabularDescription() const -> QList<QString>
+{
+    return derivedStrings().tabularDescription;
+}
+
+
+auto GeoMaps::Waypoint::twoLineTitle() const -> QString
+{
+    return derivedStrings().twoLineTitle;
+}
+
+
+auto GeoMaps::Waypoint::computeExtendedName() const -> QString
+{
+    if (m_properties.value(QStringLiteral("TYP")).toString() == QLatin1String("NAV")) {
+        return QString("%1 (%2)").arg(m_properties.value(QStringLiteral("NAM")).toString(), m_properties.value(QStringLiteral("CAT")).toString());
     }
 
-    return m_properties.value("NAM").toString();
+    return m_properties.value(QStringLiteral("NAM")).toString();
 }
 
 
-auto GeoMaps::Waypoint::icon() const -> QString
+auto GeoMaps::Waypoint::computeIcon() const -> QString
 {
     auto CAT = category();
 
     // We prefer SVG icons. There are, however, a few icons that cannot be
     // rendered by Qt's tinySVG renderer. We have generated PNGs for those
     // and treat them separately here.
-    if ((CAT == "AD-GLD") || (CAT == "AD-GRASS") || (CAT == "AD-MIL-GRASS") || (CAT == "AD-UL")) {
+    if ((CAT == QLatin1String("AD-GLD")) || (CAT == QLatin1String("AD-GRASS")) || (CAT == QLatin1String("AD-MIL-GRASS")) || (CAT == QLatin1String("AD-UL"))) {
         return QStringLiteral("/icons/waypoints/%1.png").arg(CAT);
     }
 
@@ -275,47 +353,47 @@ auto GeoMaps::Waypoint::icon() const -> QString
 }
 
 
-auto GeoMaps::Waypoint::tabularDescription() const -> QList<QString>
+auto GeoMaps::Waypoint::computeTabularDescription() const -> QList<QString>
 {
     QList<QString> result;
 
-    if (m_properties.value("TYP").toString() == "NAV") {
-        result.append("ID  " + m_properties.value("COD").toString() + " " + m_properties.value("MOR").toString());
-        result.append("NAV " + m_properties.value("NAV").toString());
-        if (m_properties.contains("ELE")) {
-            result.append(QString("ELEV%1 ft AMSL").arg(qRound(AviationUnits::Distance::fromM(m_properties.value("ELE").toDouble()).toFeet())));
+    if (m_properties.value(QStringLiteral("TYP")).toString() == QLatin1String("NAV")) {
+        result.append("ID  " + m_properties.value(QStringLiteral("COD")).toString() + " " + m_properties.value(QStringLiteral("MOR")).toString());
+        result.append("NAV " + m_properties.value(QStringLiteral("NAV")).toString());
+        if (m_properties.contains(QStringLiteral("ELE"))) {
+            result.append(QString("ELEV%1 ft AMSL").arg(qRound(AviationUnits::Distance::fromM(m_properties.value(QStringLiteral("ELE")).toDouble()).toFeet())));
         }
     }
 
-    if (m_properties.value("TYP").toString() == "AD") {
-        if (m_properties.contains("COD")) {
-            result.append("ID  " + m_properties.value("COD").toString());
+    if (m_properties.value(QStringLiteral("TYP")).toString() == QLatin1String("AD")) {
+        if (m_properties.contains(QStringLiteral("COD"))) {
+            result.append("ID  " + m_properties.value(QStringLiteral("COD")).toString());
         }
-        if (m_properties.contains("INF")) {
-            result.append("INF " + m_properties.value("INF").toString().replace("\n", "<br>"));
+        if (m_properties.contains(QStringLiteral("INF"))) {
+            result.append("INF " + m_properties.value(QStringLiteral("INF")).toString().replace("\n", "<br>"));
         }
-        if (m_properties.contains("COM")) {
-            result.append("COM " + m_properties.value("COM").toString().replace("\n", "<br>"));
+        if (m_properties.contains(QStringLiteral("COM"))) {
+            result.append("COM " + m_properties.value(QStringLiteral("COM")).toString().replace("\n", "<br>"));
         }
-        if (m_properties.contains("NAV")) {
-            result.append("NAV " + m_properties.value("NAV").toString().replace("\n", "<br>"));
+        if (m_properties.contains(QStringLiteral("NAV"))) {
+            result.append("NAV " + m_properties.value(QStringLiteral("NAV")).toString().replace("\n", "<br>"));
         }
-        if (m_properties.contains("OTH")) {
-            result.append("OTH " + m_properties.value("OTH").toString().replace("\n", "<br>"));
+        if (m_properties.contains(QStringLiteral("OTH"))) {
+            result.append("OTH " + m_properties.value(QStringLiteral("OTH")).toString().replace("\n", "<br>"));
         }
-        if (m_properties.contains("RWY")) {
-            result.append("RWY " + m_properties.value("RWY").toString().replace("\n", "<br>"));
+        if (m_properties.contains(QStringLiteral("RWY"))) {
+            result.append("RWY " + m_properties.value(QStringLiteral("RWY")).toString().replace("\n", "<br>"));
         }
 
-        result.append( QString("ELEV%1 ft AMSL").arg(qRound(AviationUnits::Distance::fromM(m_properties.value("ELE").toDouble()).toFeet())));
+        result.append( QString("ELEV%1 ft AMSL").arg(qRound(AviationUnits::Distance::fromM(m_properties.value(QStringLiteral("ELE")).toDouble()).toFeet())));
     }
 
-    if (m_properties.value("TYP").toString() == "WP") {
-        if (m_properties.contains("ICA")) {
-            result.append("ID  " + m_properties.value("COD").toString());
+    if (m_properties.value(QStringLiteral("TYP")).toString() == QLatin1String("WP")) {
+        if (m_properties.contains(QStringLiteral("ICA"))) {
+            result.append("ID  " + m_properties.value(QStringLiteral("COD")).toString());
         }
-        if (m_properties.contains("COM")) {
-            result.append("COM " + m_properties.value("COM").toString());
+        if (m_properties.contains(QStringLiteral("COM"))) {
+            result.append("COM " + m_properties.value(QStringLiteral("COM")).toString());
         }
     }
 
@@ -323,19 +401,19 @@ auto GeoMaps::Waypoint::tabularDescription() const -> QList<QString>
 }
 
 
-auto GeoMaps::Waypoint::twoLineTitle() const -> QString
+auto GeoMaps::Waypoint::computeTwoLineTitle(const QString& extendedName) const -> QString
 {
     QString codeName;
-    if (m_properties.contains("COD")) {
-        codeName += m_properties.value("COD").toString();
+    if (m_properties.contains(QStringLiteral("COD"))) {
+        codeName += m_properties.value(QStringLiteral("COD")).toString();
     }
-    if (m_properties.contains("MOR")) {
-        codeName += " " + m_properties.value("MOR").toString();
+    if (m_properties.contains(QStringLiteral("MOR"))) {
+        codeName += " " + m_properties.value(QStringLiteral("MOR")).toString();
     }
 
     if (!codeName.isEmpty()) {
-        return QString("<strong>%1</strong><br><font size='2'>%2</font>").arg(codeName, extendedName());
+        return QString("<strong>%1</strong><br><font size='2'>%2</font>").arg(codeName, extendedName);
     }
 
-    return extendedName();
+    return extendedName;
 }
@@ -20,9 +20,12 @@
 
 #pragma once
 
+#include <QDataStream>
 #include <QGeoCoordinate>
 #include <QMap>
 #include <QJsonObject>
+#include <memory>
+#include <mutex>
 
 
 namespace GeoMaps {
@@ -71,6 +74,15 @@ public:
      */
     explicit Waypoint(const QJsonObject &geoJSONObject);
 
+    /*! \brief Constructs a waypoint from a data stream
+     *
+     * This method reads a waypoint that has been serialized with the method
+     * write().
+     *
+     * @param inputStream Data stream
+     */
+    explicit Waypoint(QDataStream &inputStream);
+
 
     //
     // METHODS
@@ -127,6 +139,14 @@ public:
      */
     QJsonObject toJSON() const;
 
+    /*! \brief Serialization to data stream
+     *
+     * The waypoint can be restored with the obvious constructor.
+     *
+     * @param out Data stream
+     */
+    void write(QDataStream &out) const;
+
 
     //
     // PROPERTIES
@@ -146,7 +166,7 @@ public:
      */
     QString category() const
     {
-        return m_properties.value("CAT").toString();
+        return m_properties.value(QStringLiteral("CAT")).toString();
     }
 
     /*! \brief Coordinate of the waypoint
@@ -189,7 +209,7 @@ public:
      */
     QString ICAOCode() const
     {
-        return m_properties.value("COD").toString();
+        return m_properties.value(QStringLiteral("COD")).toString();
     }
 
     /*! \brief Suggested icon for use in GUI
@@ -233,7 +253,7 @@ public:
      */
     QString name() const
     {
-        return m_properties.value("NAM").toString();
+        return m_properties.value(QStringLiteral("NAM")).toString();
     }
 
     /* \brief Verbose description of waypoint properties
@@ -245,7 +265,7 @@ public:
      * abbreviation that will be understood by pilots ("RWY ", "ELEV",
      * etc.). The rest of the string will then contain the actual data.
      */
-    Q_PROPERTY(QList<QString> tabularDescription READ tabularDescription)
+    Q_PROPERTY(QList<QString> tabularDescription READ tabularDescription CONSTANT)
 
     /*! \brief Getter function for property with the same name
      *
@@ -282,17 +302,44 @@ public:
      */
     QString type() const
     {
-        return m_properties.value("TYP").toString();
+        return m_properties.value(QStringLiteral("TYP")).toString();
     }
 
 private:
     // Computes the property isValid; this is used by the constructors to set the cached value
     bool computeIsValid() const;
 
+    // Strings derived from the properties, for use in the GUI. They are
+    // computed on first use and shared by all copies of the waypoint, so that
+    // list views, popups and weather stations do not recompute them from the
+    // property map over and over again.
+    struct DerivedStrings
+    {
+        std::once_flag computed;
+        QString extendedName;
+        QString icon;
+        QList<QString> tabularDescription;
+        QString twoLineTitle;
+    };
+
+    // Returns the derived strings, computing them if necessary. This method
+    // can be called from several threads simultaneously.
+    const DerivedStrings& derivedStrings() const;
+
+    // Compute the derived strings; these are used by derivedStrings()
+    QString computeExtendedName() const;
+    QString computeIcon() const;
+    QList<QString> computeTabularDescription() const;
+    QString computeTwoLineTitle(const QString& extendedName) const;
+
 protected:
     bool m_isValid {false};
     QGeoCoordinate m_coordinate;
     QMultiMap<QString, QVariant> m_properties;
+
+    // Cache for derivedStrings(). Whenever m_properties changes, this must be
+    // replaced by a new, empty cache.
+    std::shared_ptr<DerivedStrings> m_derivedStrings {std::make_shared<DerivedStrings>()};
 };
 
 }
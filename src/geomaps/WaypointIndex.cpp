@@ -0,0 +1,164 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QtMath>
+#include <algorithm>
+
+#include "WaypointIndex.h"
+
+
+GeoMaps::WaypointIndex::WaypointIndex(const WaypointTable& table, std::optional<WaypointTable::Type> type)
+{
+    m_points.reserve(table.size());
+    for(int i=0; i<table.size(); i++) {
+        auto waypointType = table.type(i);
+        if (waypointType == WaypointTable::Type::Invalid) {
+            continue;
+        }
+        if (type.has_value() && (waypointType != type.value())) {
+            continue;
+        }
+        auto point = toPoint(table.latitude(i), table.longitude(i));
+        point.waypointIndex = i;
+        m_points.append(point);
+    }
+
+    build(0, m_points.size(), 0);
+
+    m_columns.reserve(m_points.size());
+    for(const auto& point : m_points) {
+        m_columns.append({point.coord[0], point.coord[1], point.coord[2]});
+    }
+}
+
+
+auto GeoMaps::WaypointIndex::nearest(const QGeoCoordinate& position, int k) const -> QVector<int>
+{
+    QVector<int> result;
+    if (!position.isValid() || (k <= 0) || m_points.isEmpty()) {
+        return result;
+    }
+
+    QVector<Candidate> candidates;
+    candidates.reserve(k+1);
+    search(toPoint(position.latitude(), position.longitude()), 0, m_points.size(), 0, k, candidates);
+
+    result.reserve(candidates.size());
+    for(const auto& candidate : candidates) {
+        result.append(m_points[candidate.pointIndex].waypointIndex);
+    }
+    return result;
+}
+
+
+auto GeoMaps::WaypointIndex::toPoint(double latitude, double longitude) -> Point
+{
+    auto lat = qDegreesToRadians(latitude);
+    auto lon = qDegreesToRadians(longitude);
+
+    Point result;
+    result.coord[0] = qCos(lat)*qCos(lon);
+    result.coord[1] = qCos(lat)*qSin(lon);
+    result.coord[2] = qSin(lat);
+    return result;
+}
+
+
+void GeoMaps::WaypointIndex::build(int begin, int end, int depth)
+{
+    if (end-begin <= leafSize) {
+        return;
+    }
+
+    auto axis = depth % 3;
+    auto mid = begin + (end-begin)/2;
+    std::nth_element(m_points.begin()+begin, m_points.begin()+mid, m_points.begin()+end, [axis](const Point& a, const Point& b) {
+        return a.coord[axis] < b.coord[axis];
+    });
+
+    build(begin, mid, depth+1);
+    build(mid+1, end, depth+1);
+}
+
+
+void GeoMaps::WaypointIndex::search(const Point& query, int begin, int end, int depth, int k, QVector<Candidate>& candidates) const
+{
+    if (begin >= end) {
+        return;
+    }
+
+    // Scan small ranges as a whole
+    if (end-begin <= leafSize) {
+        double distSquared[leafSize];
+        Navigation::Geodesy::chordsSquared({query.coord[0], query.coord[1], query.coord[2]}, m_columns, begin, end, distSquared);
+        for(int i=begin; i<end; i++) {
+            addCandidate(distSquared[i-begin], i, k, candidates);
+        }
+        return;
+    }
+
+    auto mid = begin + (end-begin)/2;
+    const auto& point = m_points[mid];
+
+    // Check the point at the center of the range
+    double distSquared = 0.0;
+    for(int i=0; i<3; i++) {
+        auto delta = query.coord[i]-point.coord[i];
+        distSquared += delta*delta;
+    }
+    addCandidate(distSquared, mid, k, candidates);
+
+    // Search the subtree on the side of the query point first; search the
+    // other side only if it might contain closer points
+    auto axis = depth % 3;
+    auto delta = query.coord[axis]-point.coord[axis];
+    if (delta < 0) {
+        search(query, begin, mid, depth+1, k, candidates);
+        if ((candidates.size() < k) || (delta*delta < candidates.last().distSquared)) {
+            search(query, mid+1, end, depth+1, k, candidates);
+        }
+    } else {
+        search(query, mid+1, end, depth+1, k, candidates);
+        if ((candidates.size() < k) || (delta*delta < candidates.last().distSquared)) {
+            search(query, begin, mid, depth+1, k, candidates);
+        }
+    }
+}
+
+
+void GeoMaps::WaypointIndex::addCandidate(double distSquared, int pointIndex, int k, QVector<Candidate>& candidates)
+{
+    // The list of candidates is kept sorted by distance and never contains
+    // more than k elements.
+    if ((candidates.size() >= k) && (distSquared >= candidates.last().distSquared)) {
+        return;
+    }
+
+    Candidate candidate;
+    candidate.distSquared = distSquared;
+    candidate.pointIndex = pointIndex;
+    auto pos = std::upper_bound(candidates.begin(), candidates.end(), distSquared, [](double d, const Candidate& c) {
+        return d < c.distSquared;
+    });
+    candidates.insert(pos, candidate);
+    if (candidates.size() > k) {
+        candidates.removeLast();
+    }
+}
@@ -0,0 +1,112 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QGeoCoordinate>
+#include <QVector>
+#include <optional>
+
+#include "WaypointTable.h"
+#include "navigation/Geodesy.h"
+
+
+namespace GeoMaps {
+
+/*! \brief Spatial index for k-nearest-neighbour queries on waypoints
+ *
+ * This class implements a static k-d tree over a table of waypoints. The
+ * waypoints are mapped to points on the unit sphere in three-dimensional
+ * space. The Euclidean (chordal) distance between two such points is a
+ * monotonic function of the great-circle distance, so that nearest neighbours
+ * can be found without trigonometric functions in the inner loop. Ranges of
+ * at most leafSize points are not subdivided further; they are scanned with
+ * the batch kernel of Navigation::Geodesy.
+ *
+ * Queries return indices into the table of waypoints that was used to
+ * construct the index.
+ *
+ * This class is reentrant. Const methods can be called from several threads
+ * simultaneously.
+ */
+
+class WaypointIndex
+{
+public:
+    /*! \brief Constructs an empty index */
+    WaypointIndex() = default;
+
+    /*! \brief Constructs an index
+     *
+     * @param table Table of waypoints. Invalid waypoints are ignored.
+     *
+     * @param type If set, only waypoints of this type are indexed.
+     */
+    explicit WaypointIndex(const WaypointTable& table, std::optional<WaypointTable::Type> type = std::nullopt);
+
+    /*! \brief Find nearest waypoints
+     *
+     * @param position Position near which waypoints are searched for
+     *
+     * @param k Maximal number of waypoints to return
+     *
+     * @returns Indices of the (up to) k waypoints closest to position, sorted
+     * by increasing distance
+     */
+    QVector<int> nearest(const QGeoCoordinate& position, int k) const;
+
+private:
+    // Point on the unit sphere, plus index of the waypoint
+    struct Point {
+        double coord[3] {0.0, 0.0, 0.0};
+        int waypointIndex {0};
+    };
+
+    // Candidate found during a search; squared chordal distance and index into
+    // m_points
+    struct Candidate {
+        double distSquared {0.0};
+        int pointIndex {0};
+    };
+
+    // Converts a coordinate, in degrees, to a point on the unit sphere
+    static Point toPoint(double latitude, double longitude);
+
+    // Recursively arranges m_points[begin, end) into a k-d tree. The median
+    // element is stored at the center of the range, the subtrees left and
+    // right of it. Ranges of at most leafSize points are left as they are.
+    void build(int begin, int end, int depth);
+    static constexpr int leafSize = 16;
+
+    // Adds the point m_points[pointIndex] to the list of candidates, if it is
+    // among the k closest points found so far
+    static void addCandidate(double distSquared, int pointIndex, int k, QVector<Candidate>& candidates);
+
+    // Recursive k-nearest-neighbour search in m_points[begin, end)
+    void search(const Point& query, int begin, int end, int depth, int k, QVector<Candidate>& candidates) const;
+
+    QVector<Point> m_points;
+
+    // Same points as in m_points, in the same order, stored by column for
+    // the batch kernel
+    Navigation::Geodesy::Points m_columns;
+};
+
+};
@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include "WaypointSearchIndex.h"
+
+
+GeoMaps::WaypointSearchIndex::WaypointSearchIndex(const QVector<Waypoint>& waypoints)
+{
+    m_names.resize(waypoints.size());
+    m_codes.resize(waypoints.size());
+
+    for(int i=0; i<waypoints.size(); i++) {
+        const auto& waypoint = waypoints[i];
+        if (!waypoint.isValid()) {
+            continue;
+        }
+        m_validIndices.append(i);
+        m_names[i] = simplify(waypoint.name());
+        m_codes[i] = simplify(waypoint.ICAOCode());
+
+        // Add waypoint to trigram index. Since waypoints are processed in
+        // order, duplicates can only appear at the end of the list.
+        for(const auto& string : {m_names[i], m_codes[i]}) {
+            for(int pos=0; pos+2<string.size(); pos++) {
+                auto& list = m_trigrams[trigram(string, pos)];
+                if (list.isEmpty() || (list.last() != i)) {
+                    list.append(i);
+                }
+            }
+        }
+    }
+}
+
+
+auto GeoMaps::WaypointSearchIndex::find(const QStringList& words) const -> QVector<int>
+{
+    // Find the shortest list of candidates. If some word is long enough, the
+    // candidates are the waypoints that contain the rarest of its trigrams.
+    const QVector<int>* candidates = &m_validIndices;
+    foreach(auto word, words) {
+        for(int pos=0; pos+2<word.size(); pos++) {
+            auto iterator = m_trigrams.constFind(trigram(word, pos));
+            if (iterator == m_trigrams.constEnd()) {
+                return {};
+            }
+            if (iterator->size() < candidates->size()) {
+                candidates = &iterator.value();
+            }
+        }
+    }
+
+    // Check candidates and rank them by match quality
+    QVector<QPair<int,int>> matches;
+    foreach(auto index, *candidates) {
+        const auto& name = m_names[index];
+        const auto& code = m_codes[index];
+
+        bool allWordsFound = true;
+        int rank = 2;
+        foreach(auto word, words) {
+            if (code == word) {
+                rank = qMin(rank, 0);
+                continue;
+            }
+            if (code.startsWith(word) || name.startsWith(word)) {
+                rank = qMin(rank, 1);
+                continue;
+            }
+            if (!code.contains(word) && !name.contains(word)) {
+                allWordsFound = false;
+                break;
+            }
+        }
+        if (allWordsFound) {
+            matches.append({rank, index});
+        }
+    }
+    std::stable_sort(matches.begin(), matches.end(), [](const QPair<int,int>& a, const QPair<int,int>& b) {return a.first < b.first; });
+
+    QVector<int> result;
+    result.reserve(matches.size());
+    for(const auto& match : matches) {
+        result.append(match.second);
+    }
+    return result;
+}
+
+
+auto GeoMaps::WaypointSearchIndex::simplify(const QString& string) -> QString
+{
+    QString result;
+    auto normalizedString = string.normalized(QString::NormalizationForm_KD);
+    result.reserve(normalizedString.size());
+    foreach(auto character, normalizedString) {
+        auto unicode = character.unicode();
+        if ((unicode >= 'a') && (unicode <= 'z')) {
+            result += character;
+            continue;
+        }
+        if ((unicode >= 'A') && (unicode <= 'Z')) {
+            result += QChar(unicode - 'A' + 'a');
+            continue;
+        }
+        if ((unicode >= '0') && (unicode <= '9')) {
+            result += character;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,99 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QVector>
+
+#include "Waypoint.h"
+
+
+namespace GeoMaps {
+
+/*! \brief Full-text search index for waypoints
+ *
+ * This class holds the simplified names and ICAO codes of a list of waypoints,
+ * together with a trigram index that maps every sequence of three characters
+ * to the list of waypoints whose name or code contain that sequence. This
+ * allows to search the list for waypoints whose name or code contain given
+ * words, without normalizing any strings at query time.
+ *
+ * This class is reentrant. Const methods and the static method simplify() can
+ * be called from several threads simultaneously.
+ */
+
+class WaypointSearchIndex
+{
+public:
+    /*! \brief Constructs an empty index */
+    WaypointSearchIndex() = default;
+
+    /*! \brief Constructs an index
+     *
+     * @param waypoints List of waypoints. Invalid waypoints are ignored.
+     */
+    explicit WaypointSearchIndex(const QVector<Waypoint>& waypoints);
+
+    /*! \brief Find waypoints that match a list of words
+     *
+     * @param words List of words, simplified with the method simplify()
+     *
+     * @returns Indices of all valid waypoints whose simplified name or code
+     * contain each of the words. Waypoints whose code is equal to a word come
+     * first, followed by those where one of the words is a prefix of name or
+     * code. Within each group, the order of the original list is preserved.
+     */
+    QVector<int> find(const QStringList& words) const;
+
+    /*! \brief Simplifies string for use with this class
+     *
+     * This method does the same as Librarian::simplifySpecialChars(), and
+     * converts the result to lower case. Unlike the method in Librarian, it
+     * does not use any shared state and can be called from any thread.
+     *
+     * @param string Input string
+     *
+     * @returns Simplified string
+     */
+    static QString simplify(const QString& string);
+
+private:
+    // Key for a sequence of three ASCII characters
+    static quint32 trigram(const QString& string, int position)
+    {
+        return (static_cast<quint32>(string[position].unicode()) << 16) |
+                (static_cast<quint32>(string[position+1].unicode()) << 8) |
+                static_cast<quint32>(string[position+2].unicode());
+    }
+
+    // Simplified names and codes, one entry per waypoint. Entries for invalid
+    // waypoints are empty.
+    QVector<QString> m_names;
+    QVector<QString> m_codes;
+
+    // Indices of all valid waypoints
+    QVector<int> m_validIndices;
+
+    // Trigram index. The lists are sorted and do not contain duplicates.
+    QHash<quint32, QVector<int>> m_trigrams;
+};
+
+};
@@ -0,0 +1,66 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QHash>
+
+#include "WaypointTable.h"
+
+
+GeoMaps::WaypointTable::WaypointTable(const QVector<Waypoint>& waypoints)
+{
+    m_latitudes.reserve(waypoints.size());
+    m_longitudes.reserve(waypoints.size());
+    m_types.reserve(waypoints.size());
+    m_categoryIndices.reserve(waypoints.size());
+    m_names.reserve(waypoints.size());
+
+    QHash<QString, quint16> categoryIndices;
+    for(const auto& waypoint : waypoints) {
+        auto coordinate = waypoint.coordinate();
+        m_latitudes.append(static_cast<float>(coordinate.latitude()));
+        m_longitudes.append(static_cast<float>(coordinate.longitude()));
+        m_types.append(waypoint.isValid() ? typeFromString(waypoint.type()) : Type::Invalid);
+        m_names.append(waypoint.name());
+
+        // Intern category. There are only a few dozen different categories.
+        auto category = waypoint.category();
+        auto iterator = categoryIndices.constFind(category);
+        if (iterator == categoryIndices.constEnd()) {
+            iterator = categoryIndices.insert(category, static_cast<quint16>(m_categories.size()));
+            m_categories.append(category);
+        }
+        m_categoryIndices.append(iterator.value());
+    }
+}
+
+
+auto GeoMaps::WaypointTable::typeFromString(const QString& type) -> Type
+{
+    if (type == u"AD") {
+        return Type::AD;
+    }
+    if (type == u"NAV") {
+        return Type::NAV;
+    }
+    if (type == u"WP") {
+        return Type::WP;
+    }
+    return Type::Other;
+}
@@ -0,0 +1,150 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QStringList>
+#include <QVector>
+
+#include "Waypoint.h"
+
+
+namespace GeoMaps {
+
+/*! \brief Columnar table of waypoints
+ *
+ * This class holds the data of a list of waypoints that is needed when
+ * scanning large numbers of waypoints, in compact arrays with one entry per
+ * waypoint: coordinates as floats, type as an enum, category as an index into
+ * a small table of interned strings, and name. The names share their data
+ * with the Waypoint objects, and take no extra memory.
+ *
+ * The indices of the table are the indices of the list of waypoints that was
+ * used to construct it. Scans over the table touch only a few bytes per
+ * waypoint, instead of the property maps of the Waypoint objects.
+ *
+ * This class is reentrant. Const methods can be called from several threads
+ * simultaneously.
+ */
+
+class WaypointTable
+{
+public:
+    /*! \brief Waypoint types */
+    enum class Type : quint8 {
+        Invalid, /*!< Invalid waypoint */
+        AD, /*!< Airfield */
+        NAV, /*!< Navaid */
+        WP, /*!< Waypoint or reporting point */
+        Other /*!< Valid waypoint of some other type */
+    };
+
+    /*! \brief Constructs an empty table */
+    WaypointTable() = default;
+
+    /*! \brief Constructs a table
+     *
+     * @param waypoints List of waypoints. Invalid waypoints are included, with
+     * type Invalid.
+     */
+    explicit WaypointTable(const QVector<Waypoint>& waypoints);
+
+    /*! \brief Category of a waypoint
+     *
+     * @param index Index of the waypoint
+     *
+     * @returns Category of the waypoint
+     */
+    QString category(int index) const
+    {
+        return m_categories[m_categoryIndices[index]];
+    }
+
+    /*! \brief Latitude of a waypoint
+     *
+     * @param index Index of the waypoint
+     *
+     * @returns Latitude, in degrees
+     */
+    float latitude(int index) const
+    {
+        return m_latitudes[index];
+    }
+
+    /*! \brief Longitude of a waypoint
+     *
+     * @param index Index of the waypoint
+     *
+     * @returns Longitude, in degrees
+     */
+    float longitude(int index) const
+    {
+        return m_longitudes[index];
+    }
+
+    /*! \brief Name of a waypoint
+     *
+     * @param index Index of the waypoint
+     *
+     * @returns Name of the waypoint
+     */
+    QString name(int index) const
+    {
+        return m_names[index];
+    }
+
+    /*! \brief Number of waypoints
+     *
+     * @returns Number of waypoints in the table
+     */
+    int size() const
+    {
+        return m_types.size();
+    }
+
+    /*! \brief Type of a waypoint
+     *
+     * @param index Index of the waypoint
+     *
+     * @returns Type of the waypoint
+     */
+    Type type(int index) const
+    {
+        return m_types[index];
+    }
+
+    /*! \brief Converts a type string, as used in the GeoJSON files
+     *
+     * @param type Type string, such as "AD", "NAV" or "WP"
+     *
+     * @returns Type. If the string is not recognized, Other is returned.
+     */
+    static Type typeFromString(const QString& type);
+
+private:
+    QVector<float> m_latitudes;
+    QVector<float> m_longitudes;
+    QVector<Type> m_types;
+    QVector<quint16> m_categoryIndices;
+    QStringList m_categories;
+    QVector<QString> m_names;
+};
+
+};
@@ -36,20 +36,26 @@
 #endif
 
 #include "Aircraft.h"
+#include "Benchmark.h"
 #include "Clock.h"
 #include "DemoRunner.h"
 #include "Global.h"
 #include "Librarian.h"
+#include "MemoryBudget.h"
 #include "MobileAdaptor.h"
 #include "Settings.h"
+#include "StartupTracer.h"
 #include "geomaps/Airspace.h"
 #include "geomaps/GeoMapProvider.h"
 #include "geomaps/MapManager.h"
 #include "navigation/Navigator.h"
+#include "positioning/Geoid.h"
 #include "positioning/PositionProvider.h"
 #include "traffic/TrafficDataProvider.h"
+#include "traffic/TrafficDataSource_Simulate.h"
 #include "traffic/TrafficFactor.h"
 #include "ui/ScaleQuickItem.h"
+#include "ui/TrafficQuickItem.h"
 #include "units/Angle.h"
 #include "units/Distance.h"
 #include "units/Speed.h"
@@ -62,6 +68,8 @@ using namespace std::chrono_literals;
 
 auto main(int argc, char *argv[]) -> int
 {
+    StartupTracer::start();
+
     // It seems that MapBoxGL does not work well with threaded rendering, so we disallow that.
     qputenv("QSG_RENDER_LOOP", "basic");
 
@@ -83,12 +91,14 @@ auto main(int argc, char *argv[]) -> int
     qmlRegisterUncreatableType<GeoMaps::GeoMapProvider>("enroute", 1, 0, "GeoMapProvider", "GeoMapProvider objects cannot be created in QML");
     qmlRegisterUncreatableType<GeoMaps::MapManager>("enroute", 1, 0, "MapManager", "MapManager objects cannot be created in QML");
     qmlRegisterType<Settings>("enroute", 1, 0, "GlobalSettings");
+    qmlRegisterUncreatableType<MemoryBudget>("enroute", 1, 0, "MemoryBudget", "MemoryBudget objects cannot be created in QML");
     qmlRegisterUncreatableType<MobileAdaptor>("enroute", 1, 0, "MobileAdaptor", "MobileAdaptor objects cannot be created in QML");
     qmlRegisterUncreatableType<Navigation::Navigator>("enroute", 1, 0, "Navigator", "Navigator objects cannot be created in QML");
     qmlRegisterUncreatableType<Traffic::TrafficDataProvider>("enroute", 1, 0, "FLARMAdaptor", "FLARMAdaptor objects cannot be created in QML");
     qmlRegisterUncreatableType<Positioning::PositionProvider>("enroute", 1, 0, "SatNav", "SatNav objects cannot be created in QML");
     qmlRegisterUncreatableType<Traffic::TrafficFactor>("enroute", 1, 0, "TrafficFactor", "TrafficFactor objects cannot be created in QML");
     qmlRegisterType<Ui::ScaleQuickItem>("enroute", 1, 0, "Scale");
+    qmlRegisterType<Ui::TrafficQuickItem>("enroute", 1, 0, "TrafficOverlay");
     qmlRegisterUncreatableType<Weather::WeatherDataProvider>("enroute", 1, 0, "WeatherProvider", "Weather::WeatherProvider objects cannot be created in QML");
     qmlRegisterType<Weather::Station>("enroute", 1, 0, "WeatherStation");
 
@@ -107,6 +117,7 @@ auto main(int argc, char *argv[]) -> int
 #if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
     QGuiApplication::setDesktopFileName("de.akaflieg_freiburg.enroute");
 #endif
+    StartupTracer::mark("Application constructed");
 
     // Command line parsing
     QCommandLineParser parser;
@@ -115,12 +126,27 @@ auto main(int argc, char *argv[]) -> int
     parser.addVersionOption();
     QCommandLineOption screenshotOption("s", QCoreApplication::translate("main", "Run simulator and generate screenshots for manual"));
     parser.addOption(screenshotOption);
+    QCommandLineOption benchmarkOption("benchmark", QCoreApplication::translate("main", "Run benchmark and exit"), QCoreApplication::translate("main", "name"));
+    parser.addOption(benchmarkOption);
+    QCommandLineOption trafficScenarioOption("traffic-scenario", QCoreApplication::translate("main", "Simulate traffic around the map center, for load testing. Example: targets=200,protocol=gdl90,pattern=circling,rate=2"), QCoreApplication::translate("main", "scenario"));
+    parser.addOption(trafficScenarioOption);
+    QCommandLineOption performanceReportOption("performance-report", QCoreApplication::translate("main", "Run performance scenario, write report and exit"), QCoreApplication::translate("main", "report file"));
+    parser.addOption(performanceReportOption);
+    QCommandLineOption performanceCaptureOption("performance-capture", QCoreApplication::translate("main", "Traffic capture file replayed by the performance scenario"), QCoreApplication::translate("main", "capture file"));
+    parser.addOption(performanceCaptureOption);
     parser.addPositionalArgument("[fileName]", QCoreApplication::translate("main", "File to import."));
     parser.process(app);
     auto positionalArguments = parser.positionalArguments();
+    if (parser.isSet(benchmarkOption)) {
+        return Benchmark::run(parser.value(benchmarkOption), positionalArguments);
+    }
     if (positionalArguments.length() > 1) {
         parser.showHelp();
     }
+    Traffic::TrafficDataSource_Simulate::Scenario trafficScenario;
+    if (parser.isSet(trafficScenarioOption) && !Traffic::TrafficDataSource_Simulate::parseScenario(parser.value(trafficScenarioOption), trafficScenario)) {
+        parser.showHelp(1);
+    }
 
 #if !defined(Q_OS_ANDROID)
     // Single application on desktops
@@ -135,6 +161,10 @@ auto main(int argc, char *argv[]) -> int
     }
 #endif
 
+    // Read the geoid data in the background, so that the first position fix
+    // does not have to wait for it
+    Positioning::Geoid::preload();
+
     // Create mobile platform adaptor. We do this before creating the application engine because this also asks for permissions
     if (positionalArguments.length() == 1) {
         Global::mobileAdaptor()->processFileOpenRequest(positionalArguments[0]);
@@ -151,6 +181,10 @@ auto main(int argc, char *argv[]) -> int
     QObject* demoRunner = nullptr;
     if (parser.isSet(screenshotOption)) {
         demoRunner = new DemoRunner(engine);
+    } else if (parser.isSet(performanceReportOption)) {
+        auto* performanceRunner = new DemoRunner(engine);
+        performanceRunner->setPerformanceReport(parser.value(performanceReportOption), parser.value(performanceCaptureOption));
+        demoRunner = performanceRunner;
     }
 
     // Make global objects available to QML engine
@@ -180,8 +214,40 @@ auto main(int argc, char *argv[]) -> int
     engine->rootContext()->setContextProperty("savedBearing", settings.value("Map/bearing", 0.0));
     engine->rootContext()->setContextProperty("savedZoomLevel", settings.value("Map/zoomLevel", 9));
 
+    // Create the global objects and run their deferred initialisation now,
+    // rather than after the GUI has been loaded. This starts the background
+    // tasks that read aviation maps and weather reports, so that they run in
+    // parallel with the loading of the GUI.
+    Global::memoryBudget();
+    Global::geoMapProvider();
+    Global::navigator();
+    Global::trafficDataProvider();
+    {
+        StartupTracer::Phase phase("Deferred initialization");
+        QCoreApplication::sendPostedEvents();
+    }
+
+    // Set up traffic simulator, if a scenario was given. Ownship stands at
+    // the saved map center, at 1000m.
+    if (trafficScenario.numberOfTargets > 0) {
+        auto* trafficSimulator = new Traffic::TrafficDataSource_Simulate();
+        auto center = settings.value("Map/center", QVariant::fromValue(QGeoCoordinate(48.022653, 7.832583))).value<QGeoCoordinate>();
+        center.setAltitude(1000.0);
+        trafficSimulator->setCoordinate(center);
+        trafficSimulator->setBarometricHeight( AviationUnits::Distance::fromM(1000.0) );
+        trafficSimulator->setTT( AviationUnits::Angle::fromDEG(0.0) );
+        trafficSimulator->setGS( AviationUnits::Speed::fromKN(0.0) );
+        trafficSimulator->setScenario(trafficScenario);
+        Global::trafficDataProvider()->addDataSource(trafficSimulator);
+        trafficSimulator->connectToTrafficReceiver();
+    }
+
     // Load GUI and enter event loop
-    engine->load(QUrl(QStringLiteral("qrc:/qml/main.qml")));
+    {
+        StartupTracer::Phase phase("Loading GUI");
+        engine->load(QUrl(QStringLiteral("qrc:/qml/main.qml")));
+    }
+    QTimer::singleShot(0, []() { StartupTracer::mark("Event loop started"); });
     QGuiApplication::exec();
 
     // Save settings
@@ -0,0 +1,249 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QBuffer>
+#include <QDir>
+#include <QStandardPaths>
+#include <QXmlStreamWriter>
+#include <QtMath>
+
+#include "navigation/FlightRecorder.h"
+
+
+Navigation::FlightRecorder::FlightRecorder(QObject *parent) : QObject(parent)
+{
+    auto path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(path);
+    auto fileSize = static_cast<qint64>(sizeof(Header)) + static_cast<qint64>(capacity)*static_cast<qint64>(sizeof(Record));
+
+    // Map the ring buffer file into memory. If that fails, use a buffer in
+    // memory instead.
+    uchar* data = nullptr;
+    m_file.setFileName(path+"/flight recorder.dat");
+    if (m_file.open(QIODevice::ReadWrite)) {
+        if (m_file.size() != fileSize) {
+            m_file.resize(0);
+            m_file.resize(fileSize);
+        }
+        data = m_file.map(0, fileSize);
+    }
+    if (data == nullptr) {
+        m_file.close();
+        m_fallbackBuffer = QByteArray(static_cast<int>(fileSize), 0);
+        data = reinterpret_cast<uchar*>(m_fallbackBuffer.data());
+    }
+    m_header = reinterpret_cast<Header*>(data);
+    m_records = reinterpret_cast<Record*>(data+sizeof(Header));
+
+    // Start afresh if the file was not written by this version
+    if ((m_header->magic != magic) || (m_header->version != version) || (m_header->capacity != capacity)
+            || (m_header->recordSize != sizeof(Record)) || (m_header->next >= capacity) || (m_header->count > capacity)) {
+        clear();
+    }
+    if (m_header->count > 0) {
+        m_lastRecord_ms = recordAt(size()-1).timestamp_ms;
+    }
+}
+
+
+Navigation::FlightRecorder::~FlightRecorder() = default;
+
+
+void Navigation::FlightRecorder::clear()
+{
+    m_header->magic = magic;
+    m_header->version = version;
+    m_header->capacity = capacity;
+    m_header->recordSize = sizeof(Record);
+    m_header->next = 0;
+    m_header->count = 0;
+    m_lastRecord_ms = 0;
+    emit sizeChanged();
+}
+
+
+void Navigation::FlightRecorder::record(const Positioning::PositionInfo& info)
+{
+    if (!info.isValid()) {
+        return;
+    }
+    auto coordinate = info.coordinate();
+    if (!coordinate.isValid()) {
+        return;
+    }
+    auto timestamp = info.timestamp();
+    auto timestamp_ms = timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : QDateTime::currentMSecsSinceEpoch();
+    if ((timestamp_ms >= m_lastRecord_ms) && (timestamp_ms-m_lastRecord_ms < minRecordInterval_ms)) {
+        return;
+    }
+    m_lastRecord_ms = timestamp_ms;
+
+    // Write the record directly into the ring buffer
+    auto& record = m_records[m_header->next];
+    record.timestamp_ms = timestamp_ms;
+    record.latitude = static_cast<qint32>(qRound(coordinate.latitude()*1e7));
+    record.longitude = static_cast<qint32>(qRound(coordinate.longitude()*1e7));
+    record.altitude_m = static_cast<float>(info.trueAltitude().toM());
+    record.groundSpeed_mps = static_cast<float>(info.groundSpeed().toMPS());
+    record.track_deg = static_cast<float>(info.trueTrack().toDEG());
+    record.reserved = 0;
+    m_header->next = (m_header->next+1) % capacity;
+    if (m_header->count < capacity) {
+        m_header->count++;
+    }
+
+    if (timestamp_ms-m_lastSizeChanged_ms >= 1000) {
+        m_lastSizeChanged_ms = timestamp_ms;
+        emit sizeChanged();
+    }
+}
+
+
+auto Navigation::FlightRecorder::recordAt(int i) const -> const Record&
+{
+    auto index = (m_header->next + capacity - m_header->count + static_cast<quint64>(i)) % capacity;
+    return m_records[index];
+}
+
+
+auto Navigation::FlightRecorder::size() const -> int
+{
+    return static_cast<int>(m_header->count);
+}
+
+
+auto Navigation::FlightRecorder::toGpx() const -> QByteArray
+{
+    QByteArray gpx;
+    QBuffer buffer(&gpx);
+    buffer.open(QIODevice::WriteOnly);
+    writeGpx(buffer);
+    return gpx;
+}
+
+
+auto Navigation::FlightRecorder::writeGpx(QIODevice& device) const -> bool
+{
+    QXmlStreamWriter writer(&device);
+    writer.setAutoFormatting(true);
+    writer.setAutoFormattingIndent(2);
+    writer.writeStartDocument();
+
+    writer.writeStartElement("gpx");
+    writer.writeAttribute("version", "1.1");
+    writer.writeAttribute("creator", "Enroute - https://akaflieg-freiburg.github.io/enroute");
+    writer.writeDefaultNamespace("http://www.topografix.com/GPX/1/1");
+    writer.writeStartElement("trk");
+    writer.writeTextElement("name", "Enroute "+QDateTime::currentDateTimeUtc().toString("yyyy-MM-dd HH:mm:ssZ"));
+
+    bool segmentOpen = false;
+    qint64 previous_ms = 0;
+    for(int i=0; i<size(); i++) {
+        const auto& record = recordAt(i);
+        if (!segmentOpen || (record.timestamp_ms-previous_ms > segmentGap_ms)) {
+            if (segmentOpen) {
+                writer.writeEndElement(); // trkseg
+            }
+            writer.writeStartElement("trkseg");
+            segmentOpen = true;
+        }
+        previous_ms = record.timestamp_ms;
+
+        writer.writeStartElement("trkpt");
+        writer.writeAttribute("lat", QString::number(record.latitude*1e-7, 'f', 7));
+        writer.writeAttribute("lon", QString::number(record.longitude*1e-7, 'f', 7));
+        if (qIsFinite(record.altitude_m)) {
+            writer.writeTextElement("ele", QString::number(record.altitude_m, 'f', 1));
+        }
+        writer.writeTextElement("time", QDateTime::fromMSecsSinceEpoch(record.timestamp_ms, Qt::UTC).toString(Qt::ISODateWithMs));
+        writer.writeEndElement(); // trkpt
+    }
+    if (segmentOpen) {
+        writer.writeEndElement(); // trkseg
+    }
+
+    writer.writeEndElement(); // trk
+    writer.writeEndElement(); // gpx
+    writer.writeEndDocument();
+    return !writer.hasError();
+}
+
+
+auto Navigation::FlightRecorder::toIGC() const -> QByteArray
+{
+    QByteArray igc;
+    igc.reserve(64*size()+256);
+    QBuffer buffer(&igc);
+    buffer.open(QIODevice::WriteOnly);
+    writeIGC(buffer);
+    return igc;
+}
+
+
+auto Navigation::FlightRecorder::writeIGC(QIODevice& device) const -> bool
+{
+    // Formats a latitude or longitude as degrees, minutes and thousandths of
+    // minutes, followed by the hemisphere
+    auto angle = [](qint32 value, int degreeDigits, char positive, char negative) {
+        auto milliMinutes = (qAbs(static_cast<qint64>(value))*60000+5000000)/10000000;
+        return QStringLiteral("%1%2%3")
+                .arg(milliMinutes/60000, degreeDigits, 10, QChar('0'))
+                .arg(milliMinutes%60000, 5, 10, QChar('0'))
+                .arg(QChar((value < 0) ? negative : positive))
+                .toLatin1();
+    };
+
+    // The header and every B record are assembled in a small buffer and
+    // written as one piece
+    QByteArray igc;
+    igc += "AXXXEnroute flight navigation\r\n";
+    if (size() > 0) {
+        auto date = QDateTime::fromMSecsSinceEpoch(recordAt(0).timestamp_ms, Qt::UTC).date();
+        igc += "HFDTEDATE:" + date.toString("ddMMyy").toLatin1() + ",01\r\n";
+    }
+    igc += "HFFTYFRTYPE:Enroute flight navigation\r\n";
+    igc += "HFDTM100GPSDATUM:WGS-1984\r\n";
+    if (device.write(igc) != igc.size()) {
+        return false;
+    }
+
+    // Reserving capacity keeps the buffer allocated when it is resized to zero
+    igc.reserve(64);
+    for(int i=0; i<size(); i++) {
+        const auto& record = recordAt(i);
+        igc.resize(0);
+        auto time = QDateTime::fromMSecsSinceEpoch(record.timestamp_ms, Qt::UTC).time();
+        auto hasAltitude = qIsFinite(record.altitude_m);
+        auto altitude = hasAltitude ? qBound(-9999, qRound(record.altitude_m), 99999) : 0;
+        auto altitudeString = (altitude < 0) ? "-"+QByteArray::number(-altitude).rightJustified(4, '0') : QByteArray::number(altitude).rightJustified(5, '0');
+        igc += 'B';
+        igc += time.toString("HHmmss").toLatin1();
+        igc += angle(record.latitude, 2, 'N', 'S');
+        igc += angle(record.longitude, 3, 'E', 'W');
+        igc += hasAltitude ? 'A' : 'V';
+        igc += "00000";
+        igc += altitudeString;
+        igc += "\r\n";
+        if (device.write(igc) != igc.size()) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,192 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QFile>
+#include <QObject>
+
+#include "positioning/PositionInfo.h"
+
+
+namespace Navigation {
+
+/*! \brief Flight recorder
+ *
+ * This class records the positions reported by the PositionProvider. Every
+ * position is stored as a record of fixed size in a ring buffer. The ring
+ * buffer is a file of fixed size in QStandardPaths::AppDataLocation that is
+ * mapped into memory, so that recording a position amounts to copying a few
+ * bytes, without memory allocation or explicit file access. The operating
+ * system writes the data to disk, and the track survives if the app is
+ * killed. Once the buffer is full, the oldest positions are overwritten.
+ *
+ * Positions that arrive less than minRecordInterval_ms after the last recorded
+ * one are ignored. At the highest rate, the buffer holds the last few hours of
+ * flight.
+ *
+ * The track can be exported in GPX and IGC format, for use with
+ * MobileAdaptor::exportContent, either as a QByteArray or streamed with
+ * writeGpx() and writeIGC().
+ */
+
+class FlightRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*! \brief Standard constructor
+     *
+     * @param parent The standard QObject parent pointer
+     */
+    explicit FlightRecorder(QObject *parent = nullptr);
+
+    // Standard destructor
+    ~FlightRecorder() override;
+
+    //
+    // METHODS
+    //
+
+    /*! \brief Recorded track in GPX format
+     *
+     * @returns GPX document that contains one track, with a new track segment
+     * wherever the recording was interrupted for more than a minute
+     */
+    Q_INVOKABLE QByteArray toGpx() const;
+
+    /*! \brief Recorded track in IGC format
+     *
+     * The IGC file contains B records with the GNSS altitude. Pressure
+     * altitude is not known and recorded as zero. The file is not signed.
+     *
+     * @returns IGC document
+     */
+    Q_INVOKABLE QByteArray toIGC() const;
+
+    /*! \brief Writes the recorded track in GPX format
+     *
+     * The document is written piece by piece, so that long tracks never need
+     * to be held in memory as a whole. This method can be used as a
+     * MobileAdaptor::ContentWriter.
+     *
+     * @param device Device that the document is written to
+     *
+     * @returns True on success
+     */
+    bool writeGpx(QIODevice& device) const;
+
+    /*! \brief Writes the recorded track in IGC format
+     *
+     * As writeGpx(), but for the document returned by toIGC().
+     *
+     * @param device Device that the document is written to
+     *
+     * @returns True on success
+     */
+    bool writeIGC(QIODevice& device) const;
+
+    //
+    // PROPERTIES
+    //
+
+    /*! \brief Number of recorded positions */
+    Q_PROPERTY(int size READ size NOTIFY sizeChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property size
+     */
+    int size() const;
+
+public slots:
+    /*! \brief Deletes all recorded positions */
+    void clear();
+
+    /*! \brief Records a position
+     *
+     * Invalid positions, and positions that arrive too soon after the last
+     * recorded one, are ignored.
+     *
+     * @param info Position info
+     */
+    void record(const Positioning::PositionInfo& info);
+
+signals:
+    /*! \brief Notifier signal
+     *
+     * This signal is emitted at most once per second while recording, in
+     * order to keep the cost of recording low.
+     */
+    void sizeChanged();
+
+private:
+    Q_DISABLE_COPY_MOVE(FlightRecorder)
+
+    // Header of the ring buffer file
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint32 capacity;
+        quint32 recordSize;
+        quint64 next; // Index of the slot where the next record is written
+        quint64 count; // Number of valid records, at most capacity
+    };
+
+    // Record of a single position. Coordinates are stored in units of 1e-7
+    // degrees, NaN marks unknown values.
+    struct Record {
+        qint64 timestamp_ms;
+        qint32 latitude;
+        qint32 longitude;
+        float altitude_m;
+        float groundSpeed_mps;
+        float track_deg;
+        quint32 reserved;
+    };
+
+    // Returns the i-th record, counting from the oldest one
+    const Record& recordAt(int i) const;
+
+    // Ring buffer file, its mapped content, and the header and the records
+    // within it. If the file cannot be mapped, the buffer is held in
+    // m_fallbackBuffer instead, and the track is not kept across restarts.
+    QFile m_file;
+    QByteArray m_fallbackBuffer;
+    Header* m_header {nullptr};
+    Record* m_records {nullptr};
+
+    // Time of the last recorded position, and of the last sizeChanged signal
+    qint64 m_lastRecord_ms {0};
+    qint64 m_lastSizeChanged_ms {0};
+
+    // Parameters of the ring buffer file. At 10 positions per second, the
+    // buffer holds about seven hours of flight.
+    static constexpr quint32 magic = 0x46524543;
+    static constexpr quint32 version = 1;
+    static constexpr quint32 capacity = 1U << 18;
+    static constexpr qint64 minRecordInterval_ms = 100;
+
+    // Recordings that are interrupted for longer than this start a new track
+    // segment in the GPX export
+    static constexpr qint64 segmentGap_ms = 60*1000;
+};
+
+}
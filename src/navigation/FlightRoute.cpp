@@ -22,8 +22,10 @@
 #include <QJsonArray>
 #include <QQmlEngine>
 #include <QStandardPaths>
+#include <QtConcurrent/QtConcurrent>
 
 #include "FlightRoute.h"
+#include "FlightRoute_Model.h"
 #include "Global.h"
 #include "Settings.h"
 
@@ -31,6 +33,10 @@
 Navigation::FlightRoute::FlightRoute(QObject *parent)
     : QObject(parent)
 {
+    // This connection comes first, so that the caches are invalidated before
+    // anyone else learns about the change
+    connect(this, &FlightRoute::waypointsChanged, this, [this]() { m_variantCachesValid = false; });
+    m_model = new Model(this);
 
     stdFileName = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+"/flight route.geojson";
 
@@ -42,6 +48,17 @@ Navigation::FlightRoute::FlightRoute(QObject *parent)
 
     connect(Aircraft::globalInstance(), &Aircraft::valChanged, this, &Navigation::FlightRoute::summaryChanged);
     connect(Weather::Wind::globalInstance(), &Weather::Wind::valChanged, this, &Navigation::FlightRoute::summaryChanged);
+
+    // Swap in the waypoints parsed by loadFromGeoJSONAsync()
+    connect(&m_loadWatcher, &QFutureWatcher<GeoJSONContent>::finished, this, [this]() {
+        auto content = m_loadWatcher.result();
+        if (content.error.isEmpty()) {
+            m_waypoints = content.waypoints;
+            updateLegs();
+            emit waypointsChanged();
+        }
+        emit loadFinished(content.error);
+    });
 }
 
 
@@ -132,81 +149,107 @@ auto Navigation::FlightRoute::lastIndexOf(const GeoMaps::Waypoint& waypoint) con
 }
 
 
-auto Navigation::FlightRoute::geoPath() const -> QVariantList
+auto Navigation::FlightRoute::coordinates() const -> QVector<QGeoCoordinate>
 {
     // Paranoid safety checks
     if (m_waypoints.size() < 2) {
-        return QVariantList();
+        return {};
     }
 
-    QVariantList result;
+    QVector<QGeoCoordinate> result;
+    result.reserve(m_waypoints.size());
     for(const auto& _waypoint : m_waypoints) {
         if (!_waypoint.isValid()) {
-            return QVariantList();
+            return {};
         }
-        result.append(QVariant::fromValue(_waypoint.coordinate()));
+        result.append(_waypoint.coordinate());
     }
 
     return result;
 }
 
 
+auto Navigation::FlightRoute::geoPath() const -> QVariantList
+{
+    updateVariantCaches();
+    return m_geoPathCache;
+}
+
+
 auto Navigation::FlightRoute::loadFromGeoJSON(QString fileName) -> QString
 {
     if (fileName.isEmpty()) {
         fileName = stdFileName;
     }
 
+    auto content = readGeoJSON(fileName);
+    if (!content.error.isEmpty()) {
+        return content.error;
+    }
+
+    m_waypoints = content.waypoints;
+    updateLegs();
+    emit waypointsChanged();
+
+    return QString();
+}
+
+
+void Navigation::FlightRoute::loadFromGeoJSONAsync(const QString& fileName)
+{
+    m_loadWatcher.setFuture(QtConcurrent::run(&Navigation::FlightRoute::readGeoJSON, fileName.isEmpty() ? stdFileName : fileName));
+}
+
+
+auto Navigation::FlightRoute::readGeoJSON(const QString& fileName) -> GeoJSONContent
+{
+    GeoJSONContent result;
+
     QFile file(fileName);
     auto success = file.open(QIODevice::ReadOnly);
     if (!success) {
-        return tr("Cannot open file '%1' for reading.").arg(fileName);
+        result.error = tr("Cannot open file '%1' for reading.").arg(fileName);
+        return result;
     }
     auto fileContent = file.readAll();
     if (fileContent.isEmpty()) {
-        return tr("Cannot read data from file '%1'.").arg(fileName);
+        result.error = tr("Cannot read data from file '%1'.").arg(fileName);
+        return result;
     }
     file.close();
 
     QJsonParseError parseError{};
     auto document = QJsonDocument::fromJson(fileContent, &parseError);
     if (parseError.error != QJsonParseError::NoError) {
-        return tr("Cannot parse file '%1'. Reason: %2.").arg(fileName, parseError.errorString());
+        result.error = tr("Cannot parse file '%1'. Reason: %2.").arg(fileName, parseError.errorString());
+        return result;
     }
 
-    QVector<GeoMaps::Waypoint> newWaypoints;
     foreach(auto value, document.object()["features"].toArray()) {
         auto wp = GeoMaps::Waypoint(value.toObject());
         if (!wp.isValid()) {
-            return tr("Cannot parse content of file '%1'.").arg(fileName);
+            result.error = tr("Cannot parse content of file '%1'.").arg(fileName);
+            result.waypoints.clear();
+            return result;
         }
 
-        newWaypoints.append(wp);
+        result.waypoints.append(wp);
     }
 
-    m_waypoints = newWaypoints;
-    updateLegs();
-    emit waypointsChanged();
-
-    return QString();
+    return result;
 }
 
 
 auto Navigation::FlightRoute::midFieldWaypoints() const -> QVariantList
 {
-    QVariantList result;
-
-    if (m_waypoints.isEmpty()) {
-        return result;
-    }
+    updateVariantCaches();
+    return m_midFieldWaypointsCache;
+}
 
-    foreach(auto wpt, m_waypoints) {
-        if (wpt.category() == "WP") {
-            result << QVariant::fromValue(wpt);
-        }
-    }
 
-    return result;
+auto Navigation::FlightRoute::model() const -> QAbstractListModel*
+{
+    return m_model;
 }
 
 
@@ -446,24 +489,70 @@ auto Navigation::FlightRoute::toGeoJSON() const -> QByteArray
 
 void Navigation::FlightRoute::updateLegs()
 {
-    foreach(auto _leg, m_legs)
-        _leg->deleteLater();
-    m_legs.clear();
-
-    for(int i=0; i<m_waypoints.size()-1; i++) {
-        m_legs.append(new Leg(m_waypoints.at(i), m_waypoints.at(i+1), Aircraft::globalInstance(), Weather::Wind::globalInstance(), this));
+    auto numLegs = qMax(m_waypoints.size()-1, 0);
+    auto legMatches = [this](Leg* leg, int i) {
+        return (leg->startPoint() == m_waypoints.at(i)) && (leg->endPoint() == m_waypoints.at(i+1));
+    };
+
+    // Legs at the beginning and at the end of the route that have not
+    // changed are kept as they are, together with their cached values
+    int numPrefix = 0;
+    while ((numPrefix < numLegs) && (numPrefix < m_legs.size()) && legMatches(m_legs.at(numPrefix), numPrefix)) {
+        numPrefix++;
+    }
+    int numSuffix = 0;
+    while ((numSuffix < numLegs-numPrefix) && (numSuffix < m_legs.size()-numPrefix)
+           && legMatches(m_legs.at(m_legs.size()-1-numSuffix), numLegs-1-numSuffix)) {
+        numSuffix++;
+    }
+
+    // The legs in between are reused for the new legs in between. Missing
+    // legs are constructed, superfluous legs are deleted.
+    QVector<Leg*> newLegs = m_legs.mid(0, numPrefix);
+    int oldIndex = numPrefix;
+    for(int i=numPrefix; i<numLegs-numSuffix; i++) {
+        if (oldIndex < m_legs.size()-numSuffix) {
+            auto *_leg = m_legs.at(oldIndex++);
+            _leg->setEndPoints(m_waypoints.at(i), m_waypoints.at(i+1));
+            newLegs.append(_leg);
+        } else {
+            newLegs.append(new Leg(m_waypoints.at(i), m_waypoints.at(i+1), Aircraft::globalInstance(), Weather::Wind::globalInstance(), this));
+        }
     }
+    for(; oldIndex < m_legs.size()-numSuffix; oldIndex++) {
+        m_legs.at(oldIndex)->deleteLater();
+    }
+    newLegs += m_legs.mid(m_legs.size()-numSuffix);
+    m_legs = newLegs;
 }
 
 
-auto Navigation::FlightRoute::waypoints() const -> QVariantList
+void Navigation::FlightRoute::updateVariantCaches() const
 {
-    QVariantList result;
+    if (m_variantCachesValid) {
+        return;
+    }
 
-    foreach(auto wpt, m_waypoints) {
-        result << QVariant::fromValue(wpt);
+    m_geoPathCache.clear();
+    foreach(auto coordinate, coordinates()) {
+        m_geoPathCache.append(QVariant::fromValue(coordinate));
+    }
+    m_midFieldWaypointsCache.clear();
+    m_waypointsCache.clear();
+    m_waypointsCache.reserve(m_waypoints.size());
+    for(const auto& wpt : m_waypoints) {
+        if (wpt.category() == "WP") {
+            m_midFieldWaypointsCache << QVariant::fromValue(wpt);
+        }
+        m_waypointsCache << QVariant::fromValue(wpt);
     }
+    m_variantCachesValid = true;
+}
 
-    return result;
+
+auto Navigation::FlightRoute::waypoints() const -> QVariantList
+{
+    updateVariantCaches();
+    return m_waypointsCache;
 }
 
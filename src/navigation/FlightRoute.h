@@ -20,12 +20,15 @@
 
 #pragma once
 
+#include <QAbstractListModel>
 #include <QGeoRectangle>
 #include <QJsonDocument>
 #include <QFile>
+#include <QFutureWatcher>
 #include <QLocale>
 #include <QPointer>
 #include <QXmlStreamReader>
+#include <QXmlStreamWriter>
 
 #include "Aircraft.h"
 
@@ -58,6 +61,8 @@ class FlightRoute : public QObject
 {
     Q_OBJECT
 
+    class Model;
+
     class Leg;
 
 public:
@@ -146,6 +151,19 @@ public:
      */
     Q_INVOKABLE QString loadFromGeoJSON(QString fileName);
 
+    /*! \brief Loads the route from a GeoJSON document, without blocking
+     *
+     * This method does the same as loadFromGeoJSON(), but reads and parses the
+     * file in a separate thread, so that large routes do not block the GUI.
+     * Once the file is parsed, the waypoints are replaced in one step, and
+     * waypointsChanged() is emitted once. The signal loadFinished() reports
+     * the result. If this method is called again before a load has finished,
+     * the earlier load is discarded.
+     *
+     * @param fileName File name, needs to include path and extension
+     */
+    Q_INVOKABLE void loadFromGeoJSONAsync(const QString& fileName);
+
     /*! \brief Loads the route from a GPX document
      *
      * This method loads the flight route from a GPX. This method can optionally use a GeoMapProvider to detect waypoints (such as airfields) by looking at the coordinates
@@ -239,6 +257,17 @@ public:
      */
     Q_INVOKABLE QByteArray toGpx() const;
 
+    /*! \brief Writes the route in GPX format
+     *
+     * This method writes the document returned by toGpx() directly to a
+     * device. It can be used as a MobileAdaptor::ContentWriter.
+     *
+     * @param device Device that the document is written to
+     *
+     * @returns True on success
+     */
+    bool writeGpx(QIODevice& device) const;
+
 
     //
     // PROPERTIES
@@ -259,6 +288,16 @@ public:
      */
     QVariantList geoPath() const;
 
+    /*! \brief List of coordinates for the waypoints
+     *
+     * This method is the C++ counterpart of the property geoPath, without
+     * QVariant boxing.
+     *
+     * @returns Coordinates of the waypoints, or an empty list if the route has
+     * fewer than two waypoints or contains invalid waypoints
+     */
+    QVector<QGeoCoordinate> coordinates() const;
+
     /*! \brief List of waypoints in the flight route that are not airfields
      *
      * This property lists all the waypoints in the route that are not airfields,
@@ -272,6 +311,21 @@ public:
      */
     QVariantList midFieldWaypoints() const;
 
+    /*! \brief Model of the flight route
+     *
+     * This property holds a list model with one row per waypoint, for use
+     * in QML views. The roles "waypoint" and "leg" give the waypoint and the
+     * leg that ends at the waypoint, or null for the first waypoint. The
+     * model is owned by this class.
+     */
+    Q_PROPERTY(QAbstractListModel* model READ model CONSTANT)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     * @returns Property model
+     */
+    QAbstractListModel* model() const;
+
     /*! \brief List of legs
      *
      * This property returns a list of all legs in the route.
@@ -318,6 +372,18 @@ public:
      */
     QVariantList waypoints() const;
 
+    /*! \brief List of waypoints
+     *
+     * This method is the C++ counterpart of the property waypoints, without
+     * QVariant boxing.
+     *
+     * @returns Waypoints of the route
+     */
+    const QVector<GeoMaps::Waypoint>& waypointVector() const
+    {
+        return m_waypoints;
+    }
+
 public slots:
     /*! \brief Deletes all waypoints in the current route */
     void clear();
@@ -356,19 +422,45 @@ signals:
     /*! \brief Notification signal for the property with the same name */
     void summaryChanged();
 
+    /*! \brief Emitted when loadFromGeoJSONAsync() has finished
+     *
+     * @param errorString Empty string in case of success, human-readable,
+     * translated error message otherwise.
+     */
+    void loadFinished(QString errorString);
+
 private slots:
     // Saves the route into the file stdFileName. This slot is called whenever
     // the route changes, so that the file will always contain the current
     // route.
     void saveToStdLocation() { save(stdFileName); };
 
+    // Brings m_legs in line with m_waypoints. Leg objects are reused, and
+    // legs whose end points did not change keep their cached values.
     void updateLegs();
 
 private:
     Q_DISABLE_COPY_MOVE(FlightRoute)
 
+    // Fills the caches for the QVariantList properties, if they are not valid
+    void updateVariantCaches() const;
+
     // Helper function for method toGPX
-    QString gpxElements(const QString& indent, const QString& tag) const;
+    void gpxElements(QXmlStreamWriter& writer, const QString& tag) const;
+
+    // Result of readGeoJSON(). If error is empty, waypoints holds the route.
+    struct GeoJSONContent
+    {
+        QString error;
+        QVector<GeoMaps::Waypoint> waypoints;
+    };
+
+    // Reads and parses a GeoJSON document, as written by save(). This method
+    // is reentrant and does not touch any FlightRoute.
+    static GeoJSONContent readGeoJSON(const QString& fileName);
+
+    // Watcher for the parse started by loadFromGeoJSONAsync()
+    QFutureWatcher<GeoJSONContent> m_loadWatcher;
 
     // File name where the flight route is loaded upon startup are stored.  This
     // member is filled in in the constructor to
@@ -380,6 +472,16 @@ private:
 
     QVector<Leg*> m_legs;
 
+    // Caches for the QVariantList properties, so that QML bindings do not box
+    // all waypoints again on every evaluation. The caches are invalidated
+    // whenever the waypoints change.
+    mutable QVariantList m_geoPathCache;
+    mutable QVariantList m_midFieldWaypointsCache;
+    mutable QVariantList m_waypointsCache;
+    mutable bool m_variantCachesValid {false};
+
+    QPointer<Model> m_model;
+
     QLocale myLocale;
 };
 
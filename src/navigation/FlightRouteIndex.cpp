@@ -0,0 +1,257 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+
+#include "geomaps/Waypoint.h"
+#include "geomaps/WaypointSearchIndex.h"
+#include "navigation/FlightRouteIndex.h"
+
+
+Navigation::FlightRouteIndex::FlightRouteIndex(const QString& directory, QObject *parent)
+    : QObject(parent),
+      m_directory(directory)
+{
+    m_indexFileName = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)+"/flightRouteIndex.dat";
+    readIndexFile();
+
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &Navigation::FlightRouteIndex::scan);
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &Navigation::FlightRouteIndex::scan);
+    connect(&m_scanWatcher, &QFutureWatcher<QHash<QString, Entry>>::finished, this, &Navigation::FlightRouteIndex::scanFinished);
+    m_watcher.addPath(m_directory);
+
+    // The index file might be outdated, or might not exist
+    scan();
+}
+
+
+Navigation::FlightRouteIndex::~FlightRouteIndex()
+{
+    m_scanWatcher.waitForFinished();
+}
+
+
+auto Navigation::FlightRouteIndex::entries() const -> QVector<Entry>
+{
+    QVector<Entry> result;
+    result.reserve(m_entries.size());
+    foreach(const auto& entry, m_entries) {
+        result.append(entry);
+    }
+    std::sort(result.begin(), result.end(), [](const Entry& a, const Entry& b) { return a.name < b.name; });
+    return result;
+}
+
+
+void Navigation::FlightRouteIndex::remove(const QString& name)
+{
+    if (m_entries.remove(name) == 0) {
+        return;
+    }
+    writeIndexFile();
+    emit changed();
+}
+
+
+void Navigation::FlightRouteIndex::rename(const QString& oldName, const QString& newName)
+{
+    if (!m_entries.contains(oldName)) {
+        return;
+    }
+    auto entry = m_entries.take(oldName);
+    entry.name = newName;
+    entry.simplifiedName = GeoMaps::WaypointSearchIndex::simplify(newName);
+    m_entries.insert(newName, entry);
+    writeIndexFile();
+    emit changed();
+}
+
+
+void Navigation::FlightRouteIndex::scan()
+{
+    if (m_scanWatcher.isRunning()) {
+        m_scanRequested = true;
+        return;
+    }
+    m_scanWatcher.setFuture(QtConcurrent::run(&Navigation::FlightRouteIndex::scanDirectory, m_directory, m_entries));
+}
+
+
+void Navigation::FlightRouteIndex::scanFinished()
+{
+    auto newEntries = m_scanWatcher.result();
+
+    // Watch all route files, so that modifications of existing files are
+    // noticed
+    if (!m_watcher.files().isEmpty()) {
+        m_watcher.removePaths(m_watcher.files());
+    }
+    QStringList fileNames;
+    foreach(const auto& entry, newEntries) {
+        fileNames << m_directory+"/"+entry.name+".geojson";
+    }
+    if (!fileNames.isEmpty()) {
+        m_watcher.addPaths(fileNames);
+    }
+
+    if (newEntries != m_entries) {
+        m_entries = newEntries;
+        writeIndexFile();
+        emit changed();
+    }
+
+    if (m_scanRequested) {
+        m_scanRequested = false;
+        scan();
+    }
+}
+
+
+auto Navigation::FlightRouteIndex::scanDirectory(const QString& directory, const QHash<QString, Entry>& oldEntries) -> QHash<QString, Entry>
+{
+    QHash<QString, Entry> result;
+    foreach(auto fileInfo, QDir(directory).entryInfoList(QStringList(QStringLiteral("*.geojson")), QDir::Files)) {
+        auto name = fileInfo.completeBaseName();
+        auto modified = fileInfo.lastModified().toMSecsSinceEpoch();
+        auto iterator = oldEntries.constFind(name);
+        if ((iterator != oldEntries.constEnd()) && (iterator->modified == modified)) {
+            result.insert(name, iterator.value());
+            continue;
+        }
+
+        // Files that cannot be parsed are still listed, so that the user
+        // sees them and can remove them
+        auto entry = readEntry(fileInfo.filePath());
+        entry.name = name;
+        entry.simplifiedName = GeoMaps::WaypointSearchIndex::simplify(name);
+        entry.modified = modified;
+        result.insert(name, entry);
+    }
+    return result;
+}
+
+
+auto Navigation::FlightRouteIndex::readEntry(const QString& fileName) -> Entry
+{
+    Entry result;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return result;
+    }
+    auto document = QJsonDocument::fromJson(file.readAll());
+    file.close();
+
+    QGeoCoordinate previous;
+    foreach(auto value, document.object()[QStringLiteral("features")].toArray()) {
+        GeoMaps::Waypoint waypoint(value.toObject());
+        if (!waypoint.isValid()) {
+            continue;
+        }
+        auto coordinate = waypoint.coordinate();
+        if (result.boundingBox.isValid()) {
+            result.boundingBox.extendRectangle(coordinate);
+        } else {
+            result.boundingBox = QGeoRectangle(coordinate, coordinate);
+        }
+        if (previous.isValid()) {
+            result.distanceM += previous.distanceTo(coordinate);
+        }
+        previous = coordinate;
+        result.waypointCount++;
+    }
+    return result;
+}
+
+
+void Navigation::FlightRouteIndex::readIndexFile()
+{
+    QFile file(m_indexFileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QDataStream inputStream(&file);
+    inputStream.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 numEntries = 0;
+    inputStream >> magic;
+    inputStream >> version;
+    inputStream >> numEntries;
+    if ((inputStream.status() != QDataStream::Ok) || (magic != indexFileMagic) || (version != indexFileVersion) || (numEntries < 0)) {
+        return;
+    }
+
+    QHash<QString, Entry> entries;
+    for(int i=0; i<numEntries; i++) {
+        Entry entry;
+        inputStream >> entry.name;
+        inputStream >> entry.simplifiedName;
+        QGeoCoordinate topLeft;
+        QGeoCoordinate bottomRight;
+        inputStream >> topLeft;
+        inputStream >> bottomRight;
+        entry.boundingBox = QGeoRectangle(topLeft, bottomRight);
+        inputStream >> entry.distanceM;
+        inputStream >> entry.waypointCount;
+        inputStream >> entry.modified;
+        if (inputStream.status() != QDataStream::Ok) {
+            return;
+        }
+        entries.insert(entry.name, entry);
+    }
+    m_entries = entries;
+}
+
+
+void Navigation::FlightRouteIndex::writeIndexFile() const
+{
+    QDir().mkpath(QFileInfo(m_indexFileName).absolutePath());
+    QSaveFile file(m_indexFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << indexFileMagic;
+    out << indexFileVersion;
+    out << static_cast<qint32>(m_entries.size());
+    foreach(const auto& entry, m_entries) {
+        out << entry.name;
+        out << entry.simplifiedName;
+        out << entry.boundingBox.topLeft();
+        out << entry.boundingBox.bottomRight();
+        out << entry.distanceM;
+        out << entry.waypointCount;
+        out << entry.modified;
+    }
+    file.commit();
+}
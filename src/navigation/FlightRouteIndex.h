@@ -0,0 +1,165 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QGeoRectangle>
+#include <QHash>
+#include <QObject>
+#include <QVector>
+
+
+namespace Navigation {
+
+/*! \brief Index of the flight route library
+ *
+ * This class keeps name, bounding box, length and number of waypoints of every
+ * flight route in a directory, so that the library can be listed, searched and
+ * previewed without reading the route files. The index is stored in a file in
+ * QStandardPaths::CacheLocation and read on construction, so that it is
+ * available right after startup.
+ *
+ * A QFileSystemWatcher observes the directory. Whenever files are added,
+ * removed or modified, the directory is scanned in a separate thread. Only
+ * files whose modification time has changed are read; all other entries are
+ * taken from the existing index. The signal changed() is emitted whenever the
+ * index has changed.
+ */
+
+class FlightRouteIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*! \brief Metadata of a single flight route */
+    struct Entry
+    {
+        /*! \brief Name of the route, that is, the file name without path and extension */
+        QString name;
+
+        /*! \brief Name, simplified with GeoMaps::WaypointSearchIndex::simplify() */
+        QString simplifiedName;
+
+        /*! \brief Bounding box of the waypoints */
+        QGeoRectangle boundingBox;
+
+        /*! \brief Length of the route, in meters */
+        double distanceM {0.0};
+
+        /*! \brief Number of waypoints */
+        int waypointCount {0};
+
+        /*! \brief Modification time of the file, in milliseconds since the epoch */
+        qint64 modified {0};
+
+        /*! \brief Comparison */
+        bool operator==(const Entry& other) const = default;
+    };
+
+    /*! \brief Standard constructor
+     *
+     * @param directory Directory of the flight route library
+     *
+     * @param parent The standard QObject parent pointer
+     */
+    explicit FlightRouteIndex(const QString& directory, QObject *parent = nullptr);
+
+    // Standard destructor
+    ~FlightRouteIndex() override;
+
+    /*! \brief All entries of the index
+     *
+     * @returns Entries, sorted by name
+     */
+    QVector<Entry> entries() const;
+
+    /*! \brief Entry for a given flight route
+     *
+     * @param name Name of the flight route
+     *
+     * @returns Entry, or an entry with empty name if the route is not in the
+     * index
+     */
+    Entry entry(const QString& name) const { return m_entries.value(name); }
+
+    /*! \brief Removes an entry
+     *
+     * This method is called when a route is removed from the library, so that
+     * the index is current before the file system watcher reacts.
+     *
+     * @param name Name of the flight route
+     */
+    void remove(const QString& name);
+
+    /*! \brief Renames an entry
+     *
+     * This method is called when a route is renamed in the library, so that
+     * the index is current before the file system watcher reacts.
+     *
+     * @param oldName Old name of the flight route
+     *
+     * @param newName New name of the flight route
+     */
+    void rename(const QString& oldName, const QString& newName);
+
+signals:
+    /*! \brief Emitted whenever the index changes */
+    void changed();
+
+private slots:
+    // Starts a scan of the directory in a separate thread. If a scan is
+    // already running, another one is started once it is finished.
+    void scan();
+
+    // Takes the result of the scan, writes the index file and emits changed()
+    // if the index has changed
+    void scanFinished();
+
+private:
+    Q_DISABLE_COPY_MOVE(FlightRouteIndex)
+
+    // Scans the directory and returns the new index. Entries of oldEntries
+    // are reused if the modification time of the file is unchanged. This
+    // method is reentrant.
+    static QHash<QString, Entry> scanDirectory(const QString& directory, const QHash<QString, Entry>& oldEntries);
+
+    // Reads the metadata of a single route file. Returns an entry with empty
+    // name if the file cannot be read or parsed.
+    static Entry readEntry(const QString& fileName);
+
+    // Reads and writes the index file. Both methods fail silently on error.
+    void readIndexFile();
+    void writeIndexFile() const;
+
+    // Magic number and format version of the index file
+    static constexpr quint32 indexFileMagic = 0x46524958;
+    static constexpr quint32 indexFileVersion = 1;
+
+    QString m_directory;
+    QString m_indexFileName;
+    QHash<QString, Entry> m_entries;
+    QFileSystemWatcher m_watcher;
+    QFutureWatcher<QHash<QString, Entry>> m_scanWatcher;
+    bool m_scanRequested {false};
+};
+
+};
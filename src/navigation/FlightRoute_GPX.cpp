@@ -18,6 +18,7 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QBuffer>
 #include <QDateTime>
 #include <QQmlEngine>
 
@@ -26,49 +27,60 @@
 
 
 auto Navigation::FlightRoute::toGpx() const -> QByteArray
+{
+    // The writer appends to a single buffer, so that the document is
+    // generated in linear time
+    //
+    QByteArray gpx;
+    QBuffer buffer(&gpx);
+    buffer.open(QIODevice::WriteOnly);
+    writeGpx(buffer);
+    return gpx;
+}
+
+
+auto Navigation::FlightRoute::writeGpx(QIODevice& device) const -> bool
 {
     // now in UTC, ISO 8601 alike
     //
     QString now = QDateTime::currentDateTimeUtc().toString("yyyy-MM-dd HH:mm:ssZ");
 
+    QXmlStreamWriter writer(&device);
+    writer.setAutoFormatting(true);
+    writer.setAutoFormattingIndent(2);
+    writer.writeStartDocument();
+
     // gpx header
     //
-    QString gpx = QString("<?xml version='1.0' encoding='UTF-8'?>\n"
-                          "<gpx version='1.1' creator='Enroute - https://akaflieg-freiburg.github.io/enroute'\n"
-                          "     xmlns='http://www.topografix.com/GPX/1/1'\n"
-                          "     xmlns:xsi='http://www.w3.org/2001/XMLSchema-instance'>\n"
-                          "  <metadata>\n"
-                          "    <name>Enroute " + now + "</name>\n"
-                                                       "    <time>" + now + "</time>\n");
+    writer.writeStartElement("gpx");
+    writer.writeAttribute("version", "1.1");
+    writer.writeAttribute("creator", "Enroute - https://akaflieg-freiburg.github.io/enroute");
+    writer.writeDefaultNamespace("http://www.topografix.com/GPX/1/1");
+    writer.writeNamespace("http://www.w3.org/2001/XMLSchema-instance", "xsi");
+    writer.writeStartElement("metadata");
+    writer.writeTextElement("name", "Enroute " + now);
+    writer.writeTextElement("time", now);
 
     auto bbox = boundingRectangle();
     if (bbox.isValid()) {
-        gpx += "    <bounds"
-               " minlat='" + QString::number(bbox.bottomLeft().latitude(), 'f', 8) + "'"
-                                                                                     " minlon='" + QString::number(bbox.topLeft().longitude(), 'f', 8) + "'"
-                                                                                                                                                         " maxlat='" + QString::number(bbox.topLeft().latitude(), 'f', 8) + "'"
-                                                                                                                                                                                                                            " maxlon='" + QString::number(bbox.topRight().longitude(), 'f', 8) + "'/>\n";
+        writer.writeEmptyElement("bounds");
+        writer.writeAttribute("minlat", QString::number(bbox.bottomLeft().latitude(), 'f', 8));
+        writer.writeAttribute("minlon", QString::number(bbox.topLeft().longitude(), 'f', 8));
+        writer.writeAttribute("maxlat", QString::number(bbox.topLeft().latitude(), 'f', 8));
+        writer.writeAttribute("maxlon", QString::number(bbox.topRight().longitude(), 'f', 8));
     }
 
-    gpx += "  </metadata>\n";
+    writer.writeEndElement(); // metadata
 
-    // 2 spaces additional indent
-    //
-    gpx += gpxElements(QString("  "), "wpt");
+    gpxElements(writer, "wpt");
 
     // start gpx rte
     // rte does _not_ contain segments
     //
-    gpx += "  <rte>\n"
-           "    <name>Enroute " + now + "</name>\n";
-
-    // 4 spaces additional indent
-    //
-    gpx += gpxElements(QString("    "), "rtept");
-
-    // close gpx
-    //
-    gpx += "  </rte>\n";
+    writer.writeStartElement("rte");
+    writer.writeTextElement("name", "Enroute " + now);
+    gpxElements(writer, "rtept");
+    writer.writeEndElement(); // rte
 
     // the next few lines export the route as gpx track.
     // We leave this disabled right now. If we discover later
@@ -80,30 +92,23 @@ auto Navigation::FlightRoute::toGpx() const -> QByteArray
     // start gpx trk
     // trk does contains segments <trkseg>
     //
-    gpx += "  <trk>\n"
-           "    <name>Enroute " + now + "</name>\n"
-                                        "    <trkseg>\n";
-
-    // 6 spaces additional indent
-    //
-    gpx += gpxElements(QString("      "), "trkpt");
-
-    // close gpx
-    //
-    gpx += "    </trkseg>\n"
-           "  </trk>\n";
+    writer.writeStartElement("trk");
+    writer.writeTextElement("name", "Enroute " + now);
+    writer.writeStartElement("trkseg");
+    gpxElements(writer, "trkpt");
+    writer.writeEndElement(); // trkseg
+    writer.writeEndElement(); // trk
 #endif
 
-    gpx += "</gpx>\n";
+    writer.writeEndElement(); // gpx
+    writer.writeEndDocument();
 
-    return gpx.toUtf8();
+    return !writer.hasError();
 }
 
 
-auto Navigation::FlightRoute::gpxElements(const QString& indent, const QString& tag) const -> QString
+void Navigation::FlightRoute::gpxElements(QXmlStreamWriter& writer, const QString& tag) const
 {
-    QString gpx = "";
-
     // waypoints
     //
     for(const auto& _waypoint : m_waypoints) {
@@ -120,25 +125,22 @@ auto Navigation::FlightRoute::gpxElements(const QString& indent, const QString&
             code = name;
         }
 
-        auto lat = QString::number(position.latitude(), 'f', 8);
-        auto lon = QString::number(position.longitude(), 'f', 8);
-        gpx += indent + "<" + tag + " lat='" + lat + "' lon='" + lon + "'>\n";
+        writer.writeStartElement(tag);
+        writer.writeAttribute("lat", QString::number(position.latitude(), 'f', 8));
+        writer.writeAttribute("lon", QString::number(position.longitude(), 'f', 8));
 
-        if (_waypoint.coordinate().type() == QGeoCoordinate::Coordinate3D) {
+        if (position.type() == QGeoCoordinate::Coordinate3D) {
 
             // elevation in meters always for gpx
             //
-            auto elevation = QString::number(_waypoint.coordinate().altitude(), 'f', 2);
-            gpx += indent + "  <ele>" + elevation + "</ele>\n";
+            writer.writeTextElement("ele", QString::number(position.altitude(), 'f', 2));
         }
 
-        gpx += indent + "  <name>" + code + "</name>\n" +
-                indent + "  <cmt>" + name + "</cmt>\n" +
-                indent + "  <desc>" + name + "</desc>\n" +
-                indent + "</" + tag + ">\n";
+        writer.writeTextElement("name", code);
+        writer.writeTextElement("cmt", name);
+        writer.writeTextElement("desc", name);
+        writer.writeEndElement();
     }
-
-    return gpx;
 }
 
 
@@ -239,24 +241,10 @@ auto Navigation::FlightRoute::loadFromGpx(QXmlStreamReader& xml, GeoMaps::GeoMap
             }
         }
 
-        // If a GeoMapProvider is available, check if there's a known waypoint like for example an airfield nearby.
-        // If we find a waypoint within the distance of 1/100° we use it instead
-        // of the coordinate which was just imported from gpx.
-        GeoMaps::Waypoint nearest;
-        if (geoMapProvider != nullptr) {
-            QGeoCoordinate distant_pos(lat + 0.01 /* about 1.11 km */, lon);
-            nearest = geoMapProvider->closestWaypoint(pos, distant_pos);
-        }
-
-        // Now create a waypoint, owned by this, and set its name
-        GeoMaps::Waypoint wpt;
-        if (!nearest.isValid()) {
-            wpt = GeoMaps::Waypoint(pos);
-        } else {
-            wpt = nearest;
-        }
-
-        if (wpt.type() == "WP" && wpt.category() == "WP" && name.length() > 0) {
+        // Create a generic waypoint and set its name. Known waypoints nearby
+        // are looked up once the route has been read.
+        GeoMaps::Waypoint wpt(pos);
+        if (name.length() > 0) {
             wpt = wpt.renamed(name);
         }
 
@@ -295,6 +283,24 @@ auto Navigation::FlightRoute::loadFromGpx(QXmlStreamReader& xml, GeoMaps::GeoMap
         return tr("Error interpreting GPX file: no valid route found.");
     }
 
+    // If a GeoMapProvider is available, check if there are known waypoints
+    // like for example airfields nearby. Waypoints within the snap radius
+    // are used instead of the coordinates which were just imported from gpx.
+    // All points are looked up in one batch, using the spatial index.
+    if (geoMapProvider != nullptr) {
+        QVector<QGeoCoordinate> positions;
+        positions.reserve(source.size());
+        for(const auto& waypoint : source) {
+            positions.append(waypoint.coordinate());
+        }
+        auto snapped = geoMapProvider->snapToWaypoints(positions);
+        for(int i=0; i<source.size(); i++) {
+            if ((snapped[i].type() != "WP") || (snapped[i].category() != "WP")) {
+                source[i] = snapped[i];
+            }
+        }
+    }
+
     m_waypoints = source;
 
     updateLegs();
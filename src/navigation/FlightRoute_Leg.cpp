@@ -31,78 +31,128 @@ Navigation::FlightRoute::Leg::Leg(const GeoMaps::Waypoint& start, const GeoMaps:
     _start = start;
     _end   = end;
 
-    connect(_aircraft, &Aircraft::valChanged, this, &FlightRoute::Leg::valChanged);
-    connect(_wind, &Weather::Wind::valChanged, this, &FlightRoute::Leg::valChanged);
+    connect(_aircraft, &Aircraft::valChanged, this, &FlightRoute::Leg::invalidateWindTriangle);
+    connect(_wind, &Weather::Wind::valChanged, this, &FlightRoute::Leg::invalidateWindTriangle);
 }
 
 
-auto Navigation::FlightRoute::Leg::distance() const -> AviationUnits::Distance
+void Navigation::FlightRoute::Leg::setEndPoints(const GeoMaps::Waypoint& start, const GeoMaps::Waypoint& end)
+{
+    if ((start == _start) && (end == _end)) {
+        return;
+    }
+
+    _start = start;
+    _end   = end;
+    _geometryValid = false;
+    _windTriangleValid = false;
+    emit valChanged();
+}
+
+
+void Navigation::FlightRoute::Leg::invalidateWindTriangle()
 {
+    _windTriangleValid = false;
+    emit valChanged();
+}
+
+
+void Navigation::FlightRoute::Leg::computeGeometry() const
+{
+    if (_geometryValid) {
+        return;
+    }
+    _geometryValid = true;
+    _distance = {};
+    _TC = {};
+
     // Paranoid safety checks
     if (!isValid()) {
-        return {};
+        return;
     }
 
-    return AviationUnits::Distance::fromM( _start.coordinate().distanceTo( _end.coordinate() ));
+    auto distanceInM = _start.coordinate().distanceTo( _end.coordinate() );
+    _distance = AviationUnits::Distance::fromM(distanceInM);
+    if (distanceInM >= minLegLength) {
+        _TC = AviationUnits::Angle::fromDEG( _start.coordinate().azimuthTo(_end.coordinate()) );
+    }
 }
 
 
-auto Navigation::FlightRoute::Leg::Fuel() const -> double
+void Navigation::FlightRoute::Leg::computeWindTriangle() const
 {
+    if (_windTriangleValid) {
+        return;
+    }
+    _windTriangleValid = true;
+    _WCA = {};
+    _GS = {};
+
     // This also checks for _aircraft and _wind to be non-nullptr
     if (!hasDataForWindTriangle()) {
-        return qQNaN();
+        return;
     }
 
-    return _aircraft->fuelConsumptionInLPH()*Time().toH();
+    solveWindTriangle(TC(),
+                      AviationUnits::Speed::fromKN(_aircraft->cruiseSpeedInKT()),
+                      AviationUnits::Speed::fromKN(_wind->windSpeedInKT()),
+                      AviationUnits::Angle::fromDEG(_wind->windDirectionInDEG()),
+                      _WCA, _GS);
 }
 
 
-auto Navigation::FlightRoute::Leg::GS() const -> AviationUnits::Speed
+void Navigation::FlightRoute::Leg::solveWindTriangle(AviationUnits::Angle TC, AviationUnits::Speed TAS, AviationUnits::Speed WS, AviationUnits::Angle WD, AviationUnits::Angle& WCA, AviationUnits::Speed& GS)
 {
-    // This also checks for _aircraft and _wind to be non-nullptr
-    if (!hasDataForWindTriangle()) {
-        return {};
-    }
+    // The triangle is solved in meters per second, so that no unit
+    // conversions take place
+    auto TASInMPS = TAS.toMPS();
+    auto WSInMPS  = WS.toMPS();
 
-    auto TASInKT = _aircraft->cruiseSpeedInKT();
-    auto WSInKT  = _wind->windSpeedInKT();
-    auto WD      = AviationUnits::Angle::fromDEG( _wind->windDirectionInDEG() );
+    // Law of sine for wind triangle
+    WCA = AviationUnits::Angle::asin(-(TC-WD).sin() *(WSInMPS/TASInMPS));
 
     // Law of cosine for wind triangle
-    auto GSInKT = qSqrt( TASInKT*TASInKT + WSInKT*WSInKT - 2.0*TASInKT*WSInKT*(WD-TH()).cos() );
-
-    return AviationUnits::Speed::fromKN(GSInKT);
+    auto GSInMPS = qSqrt( TASInMPS*TASInMPS + WSInMPS*WSInMPS - 2.0*TASInMPS*WSInMPS*(WD-(TC+WCA)).cos() );
+    GS = AviationUnits::Speed::fromMPS(GSInMPS);
 }
 
 
-auto Navigation::FlightRoute::Leg::TC() const -> AviationUnits::Angle
+auto Navigation::FlightRoute::Leg::distance() const -> AviationUnits::Distance
 {
-    // Paranoid safety checks
-    if (!isValid()) {
-        return {};
-    }
-    if( _start.coordinate().distanceTo( _end.coordinate() ) < minLegLength ) {
-        return {};
-    }
-
-    return AviationUnits::Angle::fromDEG( _start.coordinate().azimuthTo(_end.coordinate()) );
+    computeGeometry();
+    return _distance;
 }
 
 
-auto Navigation::FlightRoute::Leg::WCA() const -> AviationUnits::Angle
+auto Navigation::FlightRoute::Leg::Fuel() const -> double
 {
     // This also checks for _aircraft and _wind to be non-nullptr
     if (!hasDataForWindTriangle()) {
-        return {};
+        return qQNaN();
     }
 
-    AviationUnits::Speed TAS = AviationUnits::Speed::fromKN( _aircraft->cruiseSpeedInKT() );
-    AviationUnits::Speed WS  = AviationUnits::Speed::fromKN( _wind->windSpeedInKT() );
-    AviationUnits::Angle WD  = AviationUnits::Angle::fromDEG( _wind->windDirectionInDEG() );
+    return _aircraft->fuelConsumptionInLPH()*Time().toH();
+}
 
-    // Law of sine for wind triangle
-    return AviationUnits::Angle::asin(-(TC()-WD).sin() *(WS/TAS));
+
+auto Navigation::FlightRoute::Leg::GS() const -> AviationUnits::Speed
+{
+    computeWindTriangle();
+    return _GS;
+}
+
+
+auto Navigation::FlightRoute::Leg::TC() const -> AviationUnits::Angle
+{
+    computeGeometry();
+    return _TC;
+}
+
+
+auto Navigation::FlightRoute::Leg::WCA() const -> AviationUnits::Angle
+{
+    computeWindTriangle();
+    return _WCA;
 }
 
 
@@ -54,8 +54,20 @@ public:
     // Standard destructor
     ~Leg() override = default;
 
+    /*! \brief Change start and end point of the leg
+     *
+     * This method is used by the FlightRoute to reuse leg objects when the
+     * route changes. If the points differ from the present ones, the cached
+     * values are recomputed and valChanged() is emitted.
+     *
+     * @param start New start point
+     *
+     * @param end New end point
+     */
+    void setEndPoints(const GeoMaps::Waypoint& start, const GeoMaps::Waypoint& end);
+
     /*! \brief Start point of the leg */
-    Q_PROPERTY(GeoMaps::Waypoint startPoint READ startPoint CONSTANT)
+    Q_PROPERTY(GeoMaps::Waypoint startPoint READ startPoint NOTIFY valChanged)
 
     /*! \brief Getter function for property of the same name
      *
@@ -67,7 +79,7 @@ public:
     }
 
     /*! \brief End point of the leg */
-    Q_PROPERTY(GeoMaps::Waypoint endPoint READ endPoint CONSTANT)
+    Q_PROPERTY(GeoMaps::Waypoint endPoint READ endPoint NOTIFY valChanged)
 
     /*! \brief Getter function for property of the same name
      *
@@ -79,7 +91,7 @@ public:
     }
 
     /*! \brief Length of the leg */
-    Q_PROPERTY(AviationUnits::Distance distance READ distance CONSTANT)
+    Q_PROPERTY(AviationUnits::Distance distance READ distance NOTIFY valChanged)
 
     /*! \brief Getter function for property of the same name
    *
@@ -142,7 +154,7 @@ public:
    *
    * Set to NaN if a TH cannot be computed.
    */
-    Q_PROPERTY(AviationUnits::Angle TH READ TH CONSTANT)
+    Q_PROPERTY(AviationUnits::Angle TH READ TH NOTIFY valChanged)
 
     /*! \brief Getter function for property of the same name
    *
@@ -177,13 +189,44 @@ public:
    */
     AviationUnits::Angle WCA() const;
 
+    /*! \brief Solves the wind triangle
+   *
+   * This method contains the computation behind WCA() and GS(). It does not
+   * depend on any leg and can be used on its own.
+   *
+   * @param TC True course
+   *
+   * @param TAS True air speed
+   *
+   * @param WS Wind speed
+   *
+   * @param WD Direction from which the wind blows
+   *
+   * @param WCA On return, wind correction angle
+   *
+   * @param GS On return, ground speed
+   */
+    static void solveWindTriangle(AviationUnits::Angle TC, AviationUnits::Speed TAS, AviationUnits::Speed WS, AviationUnits::Angle WD, AviationUnits::Angle& WCA, AviationUnits::Speed& GS);
+
 signals:
     /*! \brief Notification signal */
     void valChanged();
 
+private slots:
+    // Marks the cached wind triangle as outdated and emits valChanged(). This
+    // slot is called whenever aircraft or wind data changes.
+    void invalidateWindTriangle();
+
 private:
     Q_DISABLE_COPY_MOVE(Leg)
 
+    // Computes distance and true course, if they are not cached already
+    void computeGeometry() const;
+
+    // Computes wind correction angle and ground speed, if they are not
+    // cached already
+    void computeWindTriangle() const;
+
     // Necessary data for computation of wind triangle?
     bool hasDataForWindTriangle() const;
 
@@ -197,6 +240,15 @@ private:
     GeoMaps::Waypoint _end;
     QPointer<Aircraft> _aircraft {nullptr};
     QPointer<Weather::Wind> _wind {nullptr};
+
+    // Cached values. Distance and true course depend only on the end points,
+    // wind correction angle and ground speed also on aircraft and wind.
+    mutable bool _geometryValid {false};
+    mutable AviationUnits::Distance _distance;
+    mutable AviationUnits::Angle _TC;
+    mutable bool _windTriangleValid {false};
+    mutable AviationUnits::Angle _WCA;
+    mutable AviationUnits::Speed _GS;
 };
 
 }
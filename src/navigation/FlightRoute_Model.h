@@ -0,0 +1,87 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QAbstractListModel>
+
+#include "FlightRoute.h"
+
+namespace Navigation {
+
+/*! \brief List model of a flight route
+ *
+ * This model has one row per waypoint of the flight route. It gives QML views
+ * typed access to the waypoints and legs, without generating a QVariantList of
+ * all waypoints whenever the route changes. The model is reset whenever the
+ * waypoints of the route change.
+ */
+
+class FlightRoute::Model : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    /*! \brief Roles of the model */
+    enum Roles {
+        WaypointRole = Qt::UserRole+1, /*!< Waypoint, as a GeoMaps::Waypoint */
+        LegRole /*!< Leg that ends at the waypoint, or nullptr for the first waypoint */
+    };
+
+    /*! \brief Constructs a model
+     *
+     * @param route Flight route, which is also the parent of the model
+     */
+    explicit Model(FlightRoute* route);
+
+    // Standard destructor
+    ~Model() override = default;
+
+    /*! \brief Implementation of pure virtual method from QAbstractListModel
+     *
+     * @param parent Parent index, must be invalid
+     *
+     * @returns Number of waypoints in the route
+     */
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+
+    /*! \brief Implementation of pure virtual method from QAbstractListModel
+     *
+     * @param index Index of a waypoint
+     *
+     * @param role Role, one of the values in Roles
+     *
+     * @returns Data
+     */
+    QVariant data(const QModelIndex& index, int role) const override;
+
+    /*! \brief Implementation of virtual method from QAbstractListModel
+     *
+     * @returns Role names "waypoint" and "leg"
+     */
+    QHash<int, QByteArray> roleNames() const override;
+
+private:
+    Q_DISABLE_COPY_MOVE(Model)
+
+    QPointer<FlightRoute> m_route;
+};
+
+}
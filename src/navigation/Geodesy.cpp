@@ -0,0 +1,148 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QtMath>
+
+#include "Geodesy.h"
+
+
+Navigation::Geodesy::Points::Points(const QVector<QGeoCoordinate>& coordinates)
+{
+    reserve(coordinates.size());
+    foreach(auto coordinate, coordinates) {
+        append(coordinate.latitude(), coordinate.longitude());
+    }
+}
+
+
+void Navigation::Geodesy::Points::append(double latitude, double longitude)
+{
+    auto lat = qDegreesToRadians(latitude);
+    auto lon = qDegreesToRadians(longitude);
+    m_x.append(qCos(lat)*qCos(lon));
+    m_y.append(qCos(lat)*qSin(lon));
+    m_z.append(qSin(lat));
+}
+
+
+void Navigation::Geodesy::Points::append(const std::array<double,3>& unitVector)
+{
+    m_x.append(unitVector[0]);
+    m_y.append(unitVector[1]);
+    m_z.append(unitVector[2]);
+}
+
+
+void Navigation::Geodesy::Points::reserve(int size)
+{
+    m_x.reserve(size);
+    m_y.reserve(size);
+    m_z.reserve(size);
+}
+
+
+auto Navigation::Geodesy::toUnitVector(const QGeoCoordinate& coordinate) -> std::array<double,3>
+{
+    auto lat = qDegreesToRadians(coordinate.latitude());
+    auto lon = qDegreesToRadians(coordinate.longitude());
+    return {qCos(lat)*qCos(lon), qCos(lat)*qSin(lon), qSin(lat)};
+}
+
+
+void Navigation::Geodesy::chordsSquared(const std::array<double,3>& origin, const Points& points, int begin, int end, double* result)
+{
+    // Plain loop over contiguous arrays, without branches, so that the
+    // compiler can vectorize it
+    const auto ox = origin[0];
+    const auto oy = origin[1];
+    const auto oz = origin[2];
+    const double* x = points.m_x.constData();
+    const double* y = points.m_y.constData();
+    const double* z = points.m_z.constData();
+    auto count = end-begin;
+    for(int i=0; i<count; i++) {
+        auto dx = x[begin+i]-ox;
+        auto dy = y[begin+i]-oy;
+        auto dz = z[begin+i]-oz;
+        result[i] = dx*dx + dy*dy + dz*dz;
+    }
+}
+
+
+auto Navigation::Geodesy::chordSquaredToDistance(double chordSquared) -> double
+{
+    return 2.0*earthRadiusInM*qAsin(qMin(1.0, 0.5*qSqrt(chordSquared)));
+}
+
+
+auto Navigation::Geodesy::distances(const QGeoCoordinate& origin, const Points& points) -> QVector<double>
+{
+    QVector<double> result(points.size());
+    chordsSquared(toUnitVector(origin), points, 0, points.size(), result.data());
+    for(auto& value : result) {
+        value = chordSquaredToDistance(value);
+    }
+    return result;
+}
+
+
+auto Navigation::Geodesy::azimuths(const QGeoCoordinate& origin, const Points& points) -> QVector<double>
+{
+    // Components of the points in the directions east and north of the origin
+    auto lat = qDegreesToRadians(origin.latitude());
+    auto lon = qDegreesToRadians(origin.longitude());
+    const double east[2] = {-qSin(lon), qCos(lon)};
+    const double north[3] = {-qSin(lat)*qCos(lon), -qSin(lat)*qSin(lon), qCos(lat)};
+
+    auto count = points.size();
+    QVector<double> eastComponents(count);
+    QVector<double> northComponents(count);
+    const double* x = points.m_x.constData();
+    const double* y = points.m_y.constData();
+    const double* z = points.m_z.constData();
+    double* e = eastComponents.data();
+    double* n = northComponents.data();
+    for(int i=0; i<count; i++) {
+        e[i] = x[i]*east[0] + y[i]*east[1];
+        n[i] = x[i]*north[0] + y[i]*north[1] + z[i]*north[2];
+    }
+
+    QVector<double> result(count);
+    for(int i=0; i<count; i++) {
+        auto azimuth = qRadiansToDegrees(qAtan2(e[i], n[i]));
+        result[i] = (azimuth < 0.0) ? azimuth+360.0 : azimuth;
+    }
+    return result;
+}
+
+
+auto Navigation::Geodesy::nearest(const QGeoCoordinate& origin, const Points& points) -> int
+{
+    QVector<double> chords(points.size());
+    chordsSquared(toUnitVector(origin), points, 0, points.size(), chords.data());
+
+    int result = -1;
+    for(int i=0; i<chords.size(); i++) {
+        if ((result < 0) || (chords[i] < chords[result])) {
+            result = i;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,172 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QGeoCoordinate>
+#include <QVector>
+#include <array>
+
+
+namespace Navigation {
+
+/*! \brief Batch computation of distances and azimuths
+ *
+ * This class computes great-circle distances and azimuths from one origin to
+ * many points at once. The points are stored as unit vectors in three
+ * separate arrays, one per axis. The inner loops then consist of plain
+ * multiplications and additions over contiguous arrays, which the compiler
+ * turns into SIMD instructions on all platforms, without platform-specific
+ * code. Trigonometric functions are evaluated once per point, and only for
+ * the results that are actually needed.
+ *
+ * Distances are computed on a sphere whose radius is the earth's mean radius,
+ * as in QGeoCoordinate::distanceTo().
+ *
+ * This class is reentrant.
+ */
+
+class Geodesy
+{
+public:
+    /*! \brief Columnar array of points on the unit sphere */
+    class Points
+    {
+    public:
+        /*! \brief Constructs an empty array */
+        Points() = default;
+
+        /*! \brief Constructs an array from a list of coordinates
+         *
+         * @param coordinates List of coordinates. The coordinates must be valid.
+         */
+        explicit Points(const QVector<QGeoCoordinate>& coordinates);
+
+        /*! \brief Appends a point
+         *
+         * @param latitude Latitude in degrees
+         *
+         * @param longitude Longitude in degrees
+         */
+        void append(double latitude, double longitude);
+
+        /*! \brief Appends a point
+         *
+         * @param unitVector Point on the unit sphere, as returned by
+         * toUnitVector()
+         */
+        void append(const std::array<double,3>& unitVector);
+
+        /*! \brief Reserves space in the arrays
+         *
+         * @param size Number of points
+         */
+        void reserve(int size);
+
+        /*! \brief Number of points
+         *
+         * @returns Number of points
+         */
+        int size() const
+        {
+            return m_x.size();
+        }
+
+    private:
+        friend class Geodesy;
+
+        QVector<double> m_x;
+        QVector<double> m_y;
+        QVector<double> m_z;
+    };
+
+    /*! \brief Point on the unit sphere
+     *
+     * @param coordinate Valid coordinate
+     *
+     * @returns Unit vector, as an array of three numbers
+     */
+    static std::array<double,3> toUnitVector(const QGeoCoordinate& coordinate);
+
+    /*! \brief Squared chordal distances between origin and points
+     *
+     * The chordal distance is the length of the straight line between two
+     * points on the unit sphere. It is a monotonic function of the
+     * great-circle distance, so that comparisons between chordal distances
+     * give the same result as comparisons between great-circle distances.
+     *
+     * @param origin Unit vector, as returned by toUnitVector()
+     *
+     * @param points Points
+     *
+     * @param begin Index of the first point
+     *
+     * @param end Index after the last point
+     *
+     * @param result Array of at least end-begin numbers, where the squared
+     * chordal distances of the points begin, …, end-1 are stored
+     */
+    static void chordsSquared(const std::array<double,3>& origin, const Points& points, int begin, int end, double* result);
+
+    /*! \brief Great-circle distances between origin and points
+     *
+     * @param origin Valid coordinate
+     *
+     * @param points Points
+     *
+     * @returns Distances in meters, in the order of points
+     */
+    static QVector<double> distances(const QGeoCoordinate& origin, const Points& points);
+
+    /*! \brief Azimuths from origin to points
+     *
+     * @param origin Valid coordinate
+     *
+     * @param points Points
+     *
+     * @returns Initial bearing of the great circles from the origin to the
+     * points, in degrees from 0 to 360, in the order of points
+     */
+    static QVector<double> azimuths(const QGeoCoordinate& origin, const Points& points);
+
+    /*! \brief Point nearest to origin
+     *
+     * @param origin Valid coordinate
+     *
+     * @param points Points
+     *
+     * @returns Index of the point nearest to the origin, or -1 if there are no
+     * points
+     */
+    static int nearest(const QGeoCoordinate& origin, const Points& points);
+
+    /*! \brief Converts a squared chordal distance into a great-circle distance
+     *
+     * @param chordSquared Squared chordal distance on the unit sphere
+     *
+     * @returns Great-circle distance in meters
+     */
+    static double chordSquaredToDistance(double chordSquared);
+
+    /*! \brief Mean radius of the earth, in meters, as used by QGeoCoordinate */
+    static constexpr double earthRadiusInM = 6371007.2;
+};
+
+};
@@ -26,7 +26,9 @@
 
 Navigation::Navigator::Navigator(QObject *parent) : QObject(parent)
 {
+    m_flightRecorder = new FlightRecorder(this);
     m_flightRoute = new FlightRoute(this);
+    m_routeGuidance = new RouteGuidance(m_flightRoute, this);
 
     QTimer::singleShot(0, this, &Navigation::Navigator::deferredInitialization);
 }
@@ -60,6 +62,11 @@ void Navigation::Navigator::deferredInitialization() const
 
 void Navigation::Navigator::onPositionUpdated(const Positioning::PositionInfo& info)
 {
+    if (Global::settings()->recordFlightTrack()) {
+        m_flightRecorder->record(info);
+    }
+    m_routeGuidance->update(info);
+
     AviationUnits::Speed GS;
 
     if (info.isValid()) {
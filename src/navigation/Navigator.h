@@ -20,7 +20,9 @@
 
 #pragma once
 
+#include "FlightRecorder.h"
 #include "FlightRoute.h"
+#include "RouteGuidance.h"
 #include "positioning/PositionInfo.h"
 
 
@@ -79,6 +81,39 @@ public:
         return m_flightRoute;
     }
 
+    /*! \brief Flight recorder
+     *
+     *  The flight recorder returned here is owned by this class and must not
+     *  be deleted. It records every position update while the setting
+     *  Settings::recordFlightTrack is on.
+     */
+    Q_PROPERTY(FlightRecorder* flightRecorder READ flightRecorder CONSTANT)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property flightRecorder
+     */
+    FlightRecorder* flightRecorder() const
+    {
+        return m_flightRecorder;
+    }
+
+    /*! \brief Guidance along the current flight route
+     *
+     *  The object returned here is owned by this class and must not be
+     *  deleted. It is updated with every position update.
+     */
+    Q_PROPERTY(RouteGuidance* routeGuidance READ routeGuidance CONSTANT)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property routeGuidance
+     */
+    RouteGuidance* routeGuidance() const
+    {
+        return m_routeGuidance;
+    }
+
     /*! \brief Estimate whether the device is flying or on the ground
      *
      *  This property holds an estimate, as to whether the device is flying or
@@ -120,7 +155,9 @@ private:
     static constexpr double flightSpeedHysteresisInKn = 5.0;
 
     bool m_isInFlight {false};
+    QPointer<FlightRecorder> m_flightRecorder {nullptr};
     QPointer<FlightRoute> m_flightRoute {nullptr};
+    QPointer<RouteGuidance> m_routeGuidance {nullptr};
 };
 
 }
@@ -0,0 +1,194 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QtMath>
+
+#include "Aircraft.h"
+#include "navigation/FlightRoute.h"
+#include "navigation/Geodesy.h"
+#include "navigation/RouteGuidance.h"
+
+
+namespace {
+
+auto dot(const std::array<double,3>& a, const std::array<double,3>& b) -> double
+{
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+
+auto cross(const std::array<double,3>& a, const std::array<double,3>& b) -> std::array<double,3>
+{
+    return {a[1]*b[2]-a[2]*b[1], a[2]*b[0]-a[0]*b[2], a[0]*b[1]-a[1]*b[0]};
+}
+
+
+auto normalized(const std::array<double,3>& a) -> std::array<double,3>
+{
+    auto length = qSqrt(dot(a, a));
+    if (qFuzzyIsNull(length)) {
+        return {0.0, 0.0, 0.0};
+    }
+    return {a[0]/length, a[1]/length, a[2]/length};
+}
+
+}
+
+
+Navigation::RouteGuidance::RouteGuidance(FlightRoute* flightRoute, QObject *parent)
+    : QObject(parent), m_flightRoute(flightRoute)
+{
+    connect(m_flightRoute, &FlightRoute::waypointsChanged, this, &Navigation::RouteGuidance::readRoute);
+    readRoute();
+}
+
+
+void Navigation::RouteGuidance::readRoute()
+{
+    m_legs.clear();
+    m_waypoints.clear();
+    if (!m_flightRoute.isNull()) {
+        m_waypoints = m_flightRoute->waypointVector();
+    }
+
+    for(int i=0; i+1<m_waypoints.size(); i++) {
+        if (!m_waypoints[i].isValid() || !m_waypoints[i+1].isValid()) {
+            m_legs.clear();
+            break;
+        }
+        LegGeometry leg;
+        leg.start = Geodesy::toUnitVector(m_waypoints[i].coordinate());
+        leg.end = Geodesy::toUnitVector(m_waypoints[i+1].coordinate());
+        leg.normal = normalized(cross(leg.start, leg.end));
+        leg.tangent = cross(leg.normal, leg.start);
+        leg.length = angleBetween(leg.start, leg.end);
+        m_legs.append(leg);
+    }
+    double remaining_m = 0.0;
+    for(int i=m_legs.size()-1; i>=0; i--) {
+        m_legs[i].remainingAfter_m = remaining_m;
+        remaining_m += m_legs[i].length*Geodesy::earthRadiusInM;
+    }
+
+    // The active leg is determined anew with the next position update
+    clear();
+    emit guidanceChanged();
+}
+
+
+void Navigation::RouteGuidance::update(const Positioning::PositionInfo& info)
+{
+    if (m_legs.isEmpty() || !info.isValid()) {
+        if (m_activeLeg >= 0) {
+            clear();
+            emit guidanceChanged();
+        }
+        return;
+    }
+    auto position = Geodesy::toUnitVector(info.coordinate());
+
+    // Determine the active leg anew if there is none, or if the aircraft has
+    // left the active leg
+    if ((m_activeLeg >= 0) && (distanceFromLeg(m_legs[m_activeLeg], position)*Geodesy::earthRadiusInM > reacquireDistanceInM)) {
+        m_activeLeg = -1;
+    }
+    if (m_activeLeg < 0) {
+        double minDistance = 0.0;
+        for(int i=0; i<m_legs.size(); i++) {
+            auto distance = distanceFromLeg(m_legs[i], position);
+            if ((m_activeLeg < 0) || (distance < minDistance)) {
+                m_activeLeg = i;
+                minDistance = distance;
+            }
+        }
+    }
+
+    // Once the aircraft has passed the end of a leg, continue with the next
+    while ((m_activeLeg+1 < m_legs.size()) && (alongTrack(m_legs[m_activeLeg], position) >= m_legs[m_activeLeg].length)) {
+        m_activeLeg++;
+    }
+
+    const auto& leg = m_legs[m_activeLeg];
+    m_nextWaypoint = m_waypoints[m_activeLeg+1];
+    m_crossTrackError = AviationUnits::Distance::fromM(-crossTrack(leg, position)*Geodesy::earthRadiusInM);
+    m_distanceToNext = AviationUnits::Distance::fromM(angleBetween(position, leg.end)*Geodesy::earthRadiusInM);
+    m_distanceToDestination = AviationUnits::Distance::fromM(m_distanceToNext.toM()+leg.remainingAfter_m);
+
+    // Times and fuel are only meaningful while the aircraft is moving
+    auto GS = info.groundSpeed();
+    if (GS.isFinite() && (GS.toKN() >= minSpeedInKN)) {
+        m_timeToNext = m_distanceToNext/GS;
+        m_timeToDestination = m_distanceToDestination/GS;
+        m_ETADestination = QDateTime::currentDateTimeUtc().addSecs(qRound64(m_timeToDestination.toS()));
+        m_fuelToDestination = Aircraft::globalInstance()->fuelConsumptionInLPH()*m_timeToDestination.toH();
+    } else {
+        m_timeToNext = {};
+        m_timeToDestination = {};
+        m_ETADestination = {};
+        m_fuelToDestination = qQNaN();
+    }
+
+    emit guidanceChanged();
+}
+
+
+void Navigation::RouteGuidance::clear()
+{
+    m_activeLeg = -1;
+    m_crossTrackError = {};
+    m_nextWaypoint = {};
+    m_distanceToNext = {};
+    m_timeToNext = {};
+    m_distanceToDestination = {};
+    m_timeToDestination = {};
+    m_ETADestination = {};
+    m_fuelToDestination = qQNaN();
+}
+
+
+auto Navigation::RouteGuidance::alongTrack(const LegGeometry& leg, const std::array<double,3>& position) -> double
+{
+    return qAtan2(dot(position, leg.tangent), dot(position, leg.start));
+}
+
+
+auto Navigation::RouteGuidance::crossTrack(const LegGeometry& leg, const std::array<double,3>& position) -> double
+{
+    return qAsin(qBound(-1.0, dot(position, leg.normal), 1.0));
+}
+
+
+auto Navigation::RouteGuidance::distanceFromLeg(const LegGeometry& leg, const std::array<double,3>& position) -> double
+{
+    auto along = alongTrack(leg, position);
+    if ((along >= 0.0) && (along <= leg.length)) {
+        return qAbs(crossTrack(leg, position));
+    }
+    return qMin(angleBetween(position, leg.start), angleBetween(position, leg.end));
+}
+
+
+auto Navigation::RouteGuidance::angleBetween(const std::array<double,3>& a, const std::array<double,3>& b) -> double
+{
+    auto dx = a[0]-b[0];
+    auto dy = a[1]-b[1];
+    auto dz = a[2]-b[2];
+    return 2.0*qAsin(qMin(1.0, 0.5*qSqrt(dx*dx + dy*dy + dz*dz)));
+}
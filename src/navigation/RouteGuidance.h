@@ -0,0 +1,275 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QDateTime>
+#include <QPointer>
+#include <array>
+
+#include "geomaps/Waypoint.h"
+#include "positioning/PositionInfo.h"
+#include "units/Distance.h"
+#include "units/Time.h"
+
+
+namespace Navigation {
+
+class FlightRoute;
+
+/*! \brief Guidance along the current flight route
+ *
+ * This class determines, on every position update, the leg of the flight route
+ * that is currently flown, and computes the cross-track error, the distance
+ * and time to the next waypoint, as well as the remaining distance, time,
+ * fuel and the ETA at the destination.
+ *
+ * The geometry of the route is precomputed whenever the route changes: every
+ * leg is stored as a pair of unit vectors on the sphere, together with the
+ * normal of its great circle. For a position update, the position is
+ * converted to a unit vector once; everything else amounts to a few dot
+ * products per leg.
+ *
+ * All properties share the notifier signal guidanceChanged(), which is
+ * emitted at most once per position update.
+ */
+
+class RouteGuidance : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*! \brief Standard constructor
+     *
+     * @param flightRoute Flight route that is followed
+     *
+     * @param parent The standard QObject parent pointer
+     */
+    explicit RouteGuidance(FlightRoute* flightRoute, QObject *parent = nullptr);
+
+    // Standard destructor
+    ~RouteGuidance() override = default;
+
+    //
+    // PROPERTIES
+    //
+
+    /*! \brief Index of the leg currently flown, or -1 if there is none */
+    Q_PROPERTY(int activeLeg READ activeLeg NOTIFY guidanceChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property activeLeg
+     */
+    int activeLeg() const
+    {
+        return m_activeLeg;
+    }
+
+    /*! \brief Cross-track error
+     *
+     * Distance from the great circle of the active leg. Positive values mean
+     * that the aircraft is right of course, negative values that it is left
+     * of course. NaN if there is no active leg.
+     */
+    Q_PROPERTY(AviationUnits::Distance crossTrackError READ crossTrackError NOTIFY guidanceChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property crossTrackError
+     */
+    AviationUnits::Distance crossTrackError() const
+    {
+        return m_crossTrackError;
+    }
+
+    /*! \brief Next waypoint, the end point of the active leg */
+    Q_PROPERTY(GeoMaps::Waypoint nextWaypoint READ nextWaypoint NOTIFY guidanceChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property nextWaypoint
+     */
+    GeoMaps::Waypoint nextWaypoint() const
+    {
+        return m_nextWaypoint;
+    }
+
+    /*! \brief Distance to the next waypoint, NaN if there is no active leg */
+    Q_PROPERTY(AviationUnits::Distance distanceToNext READ distanceToNext NOTIFY guidanceChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property distanceToNext
+     */
+    AviationUnits::Distance distanceToNext() const
+    {
+        return m_distanceToNext;
+    }
+
+    /*! \brief Time to the next waypoint at the current ground speed
+     *
+     * NaN if there is no active leg or if the ground speed is unknown.
+     */
+    Q_PROPERTY(AviationUnits::Time timeToNext READ timeToNext NOTIFY guidanceChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property timeToNext
+     */
+    AviationUnits::Time timeToNext() const
+    {
+        return m_timeToNext;
+    }
+
+    /*! \brief Remaining distance to the destination along the route */
+    Q_PROPERTY(AviationUnits::Distance distanceToDestination READ distanceToDestination NOTIFY guidanceChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property distanceToDestination
+     */
+    AviationUnits::Distance distanceToDestination() const
+    {
+        return m_distanceToDestination;
+    }
+
+    /*! \brief Remaining time to the destination at the current ground speed */
+    Q_PROPERTY(AviationUnits::Time timeToDestination READ timeToDestination NOTIFY guidanceChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property timeToDestination
+     */
+    AviationUnits::Time timeToDestination() const
+    {
+        return m_timeToDestination;
+    }
+
+    /*! \brief Estimated time of arrival at the destination, in UTC
+     *
+     * Invalid if the time to the destination cannot be computed.
+     */
+    Q_PROPERTY(QDateTime ETADestination READ ETADestination NOTIFY guidanceChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property ETADestination
+     */
+    QDateTime ETADestination() const
+    {
+        return m_ETADestination;
+    }
+
+    /*! \brief Fuel required to the destination, in liters
+     *
+     * This property is computed from the time to the destination and the
+     * fuel consumption of the aircraft. It holds NaN if it cannot be
+     * computed.
+     */
+    Q_PROPERTY(double fuelToDestination READ fuelToDestination NOTIFY guidanceChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property fuelToDestination
+     */
+    double fuelToDestination() const
+    {
+        return m_fuelToDestination;
+    }
+
+public slots:
+    /*! \brief Updates the guidance for a new position
+     *
+     * @param info Position info
+     */
+    void update(const Positioning::PositionInfo& info);
+
+signals:
+    /*! \brief Notifier signal */
+    void guidanceChanged();
+
+private slots:
+    // Precomputes the geometry of the legs. This slot is called whenever the
+    // waypoints of the flight route change.
+    void readRoute();
+
+private:
+    Q_DISABLE_COPY_MOVE(RouteGuidance)
+
+    // Sets all computed values to NaN and the active leg to -1
+    void clear();
+
+    // Precomputed geometry of a leg. All vectors have unit length.
+    struct LegGeometry {
+        std::array<double,3> start {};
+        std::array<double,3> end {};
+
+        // Normal of the great circle through start and end, pointing to the
+        // left of the direction of flight
+        std::array<double,3> normal {};
+
+        // Tangent of the great circle at start, in the direction of flight
+        std::array<double,3> tangent {};
+
+        // Length of the leg, in radians
+        double length {0.0};
+
+        // Length of all following legs, in meters
+        double remainingAfter_m {0.0};
+    };
+    QVector<LegGeometry> m_legs;
+    QVector<GeoMaps::Waypoint> m_waypoints;
+
+    // Position along the leg, in radians from the start, and distance from
+    // the great circle, in radians, with positive values left of course
+    static double alongTrack(const LegGeometry& leg, const std::array<double,3>& position);
+    static double crossTrack(const LegGeometry& leg, const std::array<double,3>& position);
+
+    // Distance of the position from the leg, in radians: the cross-track
+    // distance if the position lies alongside the leg, the distance to the
+    // nearer end point otherwise
+    static double distanceFromLeg(const LegGeometry& leg, const std::array<double,3>& position);
+
+    // Angle between two unit vectors, in radians
+    static double angleBetween(const std::array<double,3>& a, const std::array<double,3>& b);
+
+    // If the distance from the active leg grows beyond this value, the active
+    // leg is determined anew
+    static constexpr double reacquireDistanceInM = 10.0*1852.0;
+
+    // Times and fuel are computed only if the ground speed is at least this
+    // high
+    static constexpr double minSpeedInKN = 10.0;
+
+    QPointer<FlightRoute> m_flightRoute;
+
+    int m_activeLeg {-1};
+    AviationUnits::Distance m_crossTrackError;
+    GeoMaps::Waypoint m_nextWaypoint;
+    AviationUnits::Distance m_distanceToNext;
+    AviationUnits::Time m_timeToNext;
+    AviationUnits::Distance m_distanceToDestination;
+    AviationUnits::Time m_timeToDestination;
+    QDateTime m_ETADestination;
+    double m_fuelToDestination {qQNaN()};
+};
+
+}
@@ -18,15 +18,14 @@
 
 #include <QDebug>
 #include <QFile>
+#include <QtConcurrent>
 #include <QtEndian>
 #include <QtMath>
+#include <cmath>
 
+#include "StartupTracer.h"
 #include "positioning/Geoid.h"
 
-// Static member variable
-
-QVector<qint16> Positioning::Geoid::egm {};
-
 
 // reading binary geoid data was carefully optimized for speed. We read the
 // binary content at once and do the byte order conversion afterwards.  This
@@ -35,7 +34,7 @@ QVector<qint16> Positioning::Geoid::egm {};
 // other with the QDataStream >> operator.
 
 
-void Positioning::Geoid::readEGM()
+auto Positioning::Geoid::readEGM() -> QVector<float>
 {
     QFile file(QStringLiteral(":/WW15MGH.DAC"));
 
@@ -44,10 +43,10 @@ void Positioning::Geoid::readEGM()
     if (!file.open(QIODevice::ReadOnly) || file.size() != (egm96_size_2))
     {
         qDebug() << "Geoid::Geoid failed to open " << file.fileName();
-        return;
+        return {};
     }
 
-    egm.resize(egm96_size);
+    QVector<qint16> egm(egm96_size);
 
     qint64 nread = file.read(static_cast<char*>(static_cast<void*>(egm.data())), egm96_size_2);
 
@@ -57,82 +56,112 @@ void Positioning::Geoid::readEGM()
     {
         qDebug() << "Geoid::Geoid expected " << egm96_size_2
                  << " bytes from " << file.fileName() << " but got " << nread;
-        egm.clear();
-        return;
+        return {};
     }
 
-    if (QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+    // The data file is big endian. The byte order of the target is known at
+    // compile time, so there is no check at runtime.
+    if constexpr (Q_BYTE_ORDER == Q_LITTLE_ENDIAN) {
         qFromBigEndian<qint16>(egm.data(), egm96_size, egm.data());
     }
 
+    // Convert to meters once, so that lookups need no conversion
+    QVector<float> result(egm96_size);
+    for(int i=0; i<egm96_size; i++) {
+        result[i] = static_cast<float>(egm[i]) * 0.01F;
+    }
+    return result;
+}
+
+
+auto Positioning::Geoid::grid() -> const QVector<float>&
+{
+    static const QVector<float> data = readEGM();
+    return data;
+}
+
+
+void Positioning::Geoid::preload()
+{
+    // The result is not needed here; grid() keeps the data
+    QtConcurrent::run([]() {
+        StartupTracer::Phase phase("Geoid");
+        grid();
+    });
 }
 
+
 // 90 >= latitude >= -90
 //
 // we do a simple bilinear interpolation between the four surrounding data
 // points according to Numerical Recipies in C++ 3.6 "Interpolation in Two or
 // More Dimensions".
 //
-auto Positioning::Geoid::separation(const QGeoCoordinate& coord) -> AviationUnits::Distance
+auto Positioning::Geoid::interpolate(const QVector<float>& grid, double latitude, double longitude) -> double
 {
-    // Paranoid safety checks
-    if (!coord.isValid()) {
-        return AviationUnits::Distance::fromM( qQNaN() );
-    }
-
-    // Read EGM vector if this has not been done already
-    if (egm.empty()) {
-        readEGM();
-        if (egm.empty()) {
-            return AviationUnits::Distance::fromM( qQNaN() );
-        }
-    }
-
-    // Get lat/long
-    auto latitude = coord.latitude();
-    auto longitude = coord.longitude();
-    while (longitude < 0) {
-        longitude += 360.;
+    // Normalize longitude to [0; 360[ without looping
+    longitude = std::fmod(longitude, 360.0);
+    if (longitude < 0) {
+        longitude += 360.0;
     }
 
     // coordinate transformation from lat/lon to the data file coordinate
-    // system.  The returning row and col are still reals (_not_ data index
-    // integers).  We do not care about cyclic overflows yet, col might > 1400.
+    // system.  The row and col are still reals (_not_ data index integers).
     //
-    auto row = []  (double lat) -> double { return (90 - lat) * 4; }; // [0; 720] from north to south
-    auto col = []  (double lon) -> double { return    lon     * 4; }; // [0; 1440[
+    double row = (90 - latitude) * 4; // [0; 720] from north to south
+    double col = longitude * 4;       // [0; 1440[
 
     // integer row north and south of latitude
     //
-    int north = qFloor(row(latitude));
+    int north = qBound(0, qFloor(row), egm96_rows-1);
     int south = (north + 1) < egm96_rows? (north + 1) : north;
 
     // integer column west and east of latitude
     //
-    int west = qFloor(col(longitude)) % egm96_cols;
+    int west = qFloor(col) % egm96_cols;
     int east = (west + 1) % egm96_cols;
 
-    auto geoid = [&] (int row, int col) -> qreal
-    {
-        int idx = row * egm96_cols + col;
-        return idx >=0 && idx < egm96_size ? egm.at(idx) * 0.01 : 0.0;
-    };
-
     // here we do a bilinear interpolation between the 4 neighbouring data
     // points of the requested location.
     //
-    double interpolated = 0;
-    double row_dist = row(latitude) - north;
-    double col_dist = col(longitude) - qFloor(col(longitude));
-    for (int irow : {north, south})
-    {
-        for (int icol : {west, east})
-        {
-            interpolated += geoid(irow, icol) * (1 - row_dist) * (1 - col_dist);
-            col_dist = 1 - col_dist;
-        }
-        row_dist = 1 - row_dist;
+    double row_dist = row - north;
+    double col_dist = col - qFloor(col);
+    const float* northRow = grid.constData() + north*egm96_cols;
+    const float* southRow = grid.constData() + south*egm96_cols;
+    return (northRow[west] * (1 - col_dist) + northRow[east] * col_dist) * (1 - row_dist)
+            + (southRow[west] * (1 - col_dist) + southRow[east] * col_dist) * row_dist;
+}
+
+
+auto Positioning::Geoid::separation(const QGeoCoordinate& coord) -> AviationUnits::Distance
+{
+    // Paranoid safety checks
+    if (!coord.isValid()) {
+        return AviationUnits::Distance::fromM( qQNaN() );
+    }
+
+    const auto& data = grid();
+    if (data.isEmpty()) {
+        return AviationUnits::Distance::fromM( qQNaN() );
     }
 
-    return AviationUnits::Distance::fromM( interpolated );
+    return AviationUnits::Distance::fromM( interpolate(data, coord.latitude(), coord.longitude()) );
+}
+
+
+auto Positioning::Geoid::separation(const QVector<QGeoCoordinate>& coords) -> QVector<AviationUnits::Distance>
+{
+    QVector<AviationUnits::Distance> result(coords.size(), AviationUnits::Distance::fromM( qQNaN() ));
+
+    const auto& data = grid();
+    if (data.isEmpty()) {
+        return result;
+    }
+
+    for(int i=0; i<coords.size(); i++) {
+        if (coords[i].isValid()) {
+            result[i] = AviationUnits::Distance::fromM( interpolate(data, coords[i].latitude(), coords[i].longitude()) );
+        }
+    }
+    return result;
 }
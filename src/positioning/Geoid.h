@@ -19,6 +19,7 @@
 #pragma once
 
 #include <QGeoCoordinate>
+#include <QVector>
 
 #include "units/Distance.h"
 
@@ -44,6 +45,10 @@ namespace Positioning {
  * implementations yield the same numbers (within numerical precision).  The
  * comparison of the bilinear implementation here with the python's bicubic
  * interpolation showed a worldwide max deviation of about 1 m.
+ *
+ * The data is converted once into a grid of floats, in meters. Call preload()
+ * early, so that this happens in a background thread before the first
+ * position fix arrives. All methods are thread-safe.
  */
 
 class Geoid
@@ -63,11 +68,38 @@ public:
      */
     static AviationUnits::Distance separation(const QGeoCoordinate& coord);
 
+    /*! \brief Geoidal separation for a list of locations
+     *
+     * This method is equivalent to calling separation() for every location,
+     * but accesses the grid only once. It is meant for processing tracks.
+     *
+     * @param coords Locations for which the geoidal separation should be
+     * calculated
+     *
+     * @returns Geoidal separations, in the order of coords. For invalid
+     * locations, or if the data cannot be read, NAN is returned.
+     */
+    static QVector<AviationUnits::Distance> separation(const QVector<QGeoCoordinate>& coords);
+
+    /*! \brief Reads the geoid data in a background thread
+     *
+     * This method returns immediately. Calls to separation() that happen
+     * before the data is read wait until it is available.
+     */
+    static void preload();
+
 private:
-    // Reads data into the vector egm
-    static void readEGM();
+    // Returns the grid of geoidal separations, in meters, with egm96_cols
+    // columns and egm96_rows rows, starting at latitude 90° and longitude 0°.
+    // The grid is read from the binary data file WW15MGH.DAC on the first
+    // call, which is thread-safe. If reading fails, the grid is empty.
+    static const QVector<float>& grid();
+
+    // Reads the data file and converts it into a grid
+    static QVector<float> readEGM();
 
-    static QVector<qint16> egm; // holds the data read from the binaray data file WW15MGH.DAC
+    // Bilinear interpolation in the grid, which must not be empty
+    static double interpolate(const QVector<float>& grid, double latitude, double longitude);
 
     // https://earth-info.nga.mil/GandG/wgs84/gravitymod/egm96/binary/readme.txt
     // https://earth-info.nga.mil/GandG/wgs84/gravitymod/egm96/binary/binarygeoid.html
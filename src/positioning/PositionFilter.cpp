@@ -0,0 +1,267 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QtMath>
+#include <cmath>
+
+#include "positioning/PositionFilter.h"
+
+
+void Positioning::PositionFilter::Axis::initialize(double z, double sigma, double v, double sigmaV)
+{
+    position = z;
+    velocity = v;
+    P00 = sigma*sigma;
+    P01 = 0.0;
+    P11 = sigmaV*sigmaV;
+}
+
+
+void Positioning::PositionFilter::Axis::predict(double dt, double accelerationNoise)
+{
+    auto q = accelerationNoise*accelerationNoise;
+
+    position += velocity*dt;
+    P00 += dt*(2.0*P01 + dt*P11) + q*dt*dt*dt*dt/4.0;
+    P01 += dt*P11 + q*dt*dt*dt/2.0;
+    P11 += q*dt*dt;
+}
+
+
+void Positioning::PositionFilter::Axis::updatePosition(double z, double sigma)
+{
+    auto S = P00 + sigma*sigma;
+    auto K0 = P00/S;
+    auto K1 = P01/S;
+    auto y = z - position;
+
+    position += K0*y;
+    velocity += K1*y;
+    P11 -= K1*P01;
+    P01 *= 1.0-K0;
+    P00 *= 1.0-K0;
+}
+
+
+void Positioning::PositionFilter::Axis::updateVelocity(double z, double sigma)
+{
+    auto S = P11 + sigma*sigma;
+    auto K0 = P01/S;
+    auto K1 = P11/S;
+    auto y = z - velocity;
+
+    position += K0*y;
+    velocity += K1*y;
+    P00 -= K0*P01;
+    P01 *= 1.0-K1;
+    P11 *= 1.0-K1;
+}
+
+
+void Positioning::PositionFilter::addMeasurement(const Positioning::PositionInfo& info, qint64 time_ms)
+{
+    if (!info.isValid()) {
+        return;
+    }
+    auto coordinate = info.coordinate();
+    if (!coordinate.isValid()) {
+        return;
+    }
+
+    // Measurement errors
+    double sigma = defaultHorizontalAccuracy;
+    auto errorEstimate = info.positionErrorEstimate();
+    if (errorEstimate.isFinite() && (errorEstimate.toM() > 0.0)) {
+        sigma = errorEstimate.toM();
+    }
+    double sigmaAltitude = defaultVerticalAccuracy;
+    auto altitudeErrorEstimate = info.trueAltitudeErrorEstimate();
+    if (altitudeErrorEstimate.isFinite() && (altitudeErrorEstimate.toM() > 0.0)) {
+        sigmaAltitude = altitudeErrorEstimate.toM();
+    }
+
+    // Velocity measurement. The true track is unknown at very low speeds, and
+    // we take the velocity to be zero then.
+    bool hasVelocity = false;
+    double velocityEast = 0.0;
+    double velocityNorth = 0.0;
+    auto GS = info.groundSpeed();
+    if (GS.isFinite()) {
+        auto TT = info.trueTrack();
+        if (TT.isFinite()) {
+            hasVelocity = true;
+            velocityEast = GS.toMPS()*qSin(TT.toRAD());
+            velocityNorth = GS.toMPS()*qCos(TT.toRAD());
+        } else if (GS.toKN() < 4.0) {
+            hasVelocity = true;
+        }
+    }
+    auto altitude = info.trueAltitude();
+    auto verticalSpeed = info.verticalSpeed();
+
+    auto variation = info.variation();
+    if (variation.isFinite()) {
+        m_magneticVariation = variation.toDEG();
+    }
+
+    // Initialize filter, if necessary
+    if (!m_initialized) {
+        m_initialized = true;
+        m_time_ms = time_ms;
+        m_origin = QGeoCoordinate(coordinate.latitude(), coordinate.longitude());
+        m_metersPerDegreeLongitude = qDegreesToRadians(earthRadiusInM)*qMax(0.01, qCos(qDegreesToRadians(coordinate.latitude())));
+
+        auto sigmaV = hasVelocity ? velocityAccuracy : initialVelocityUncertainty;
+        m_east.initialize(0.0, sigma, velocityEast, sigmaV);
+        m_north.initialize(0.0, sigma, velocityNorth, sigmaV);
+        m_hasAltitude = altitude.isFinite();
+        if (m_hasAltitude) {
+            if (verticalSpeed.isFinite()) {
+                m_up.initialize(altitude.toM(), sigmaAltitude, verticalSpeed.toMPS(), velocityAccuracy);
+            } else {
+                m_up.initialize(altitude.toM(), sigmaAltitude, 0.0, initialVelocityUncertainty);
+            }
+        }
+        return;
+    }
+
+    // Propagate state to the time of the measurement
+    if (time_ms > m_time_ms) {
+        auto dt = static_cast<double>(time_ms-m_time_ms)/1000.0;
+        m_east.predict(dt, horizontalAccelerationNoise);
+        m_north.predict(dt, horizontalAccelerationNoise);
+        m_up.predict(dt, verticalAccelerationNoise);
+        m_time_ms = time_ms;
+    }
+
+    // Reset the filter if the source jumped
+    double east = 0.0;
+    double north = 0.0;
+    toLocal(coordinate, east, north);
+    auto innovation = qHypot(east-m_east.position, north-m_north.position);
+    auto innovationSigma = qSqrt(m_east.P00 + m_north.P00 + 2.0*sigma*sigma);
+    if ((innovation > resetDistanceInM) && (innovation > resetSigmas*innovationSigma)) {
+        reset();
+        addMeasurement(info, time_ms);
+        return;
+    }
+
+    // Update horizontal state
+    m_east.updatePosition(east, sigma);
+    m_north.updatePosition(north, sigma);
+    if (hasVelocity) {
+        m_east.updateVelocity(velocityEast, velocityAccuracy);
+        m_north.updateVelocity(velocityNorth, velocityAccuracy);
+    }
+
+    // Update vertical state
+    if (altitude.isFinite()) {
+        if (m_hasAltitude) {
+            m_up.updatePosition(altitude.toM(), sigmaAltitude);
+            if (verticalSpeed.isFinite()) {
+                m_up.updateVelocity(verticalSpeed.toMPS(), velocityAccuracy);
+            }
+        } else {
+            m_hasAltitude = true;
+            if (verticalSpeed.isFinite()) {
+                m_up.initialize(altitude.toM(), sigmaAltitude, verticalSpeed.toMPS(), velocityAccuracy);
+            } else {
+                m_up.initialize(altitude.toM(), sigmaAltitude, 0.0, initialVelocityUncertainty);
+            }
+        }
+    }
+
+    if (qHypot(m_east.position, m_north.position) > recenterDistanceInM) {
+        recenter();
+    }
+}
+
+
+auto Positioning::PositionFilter::estimate(qint64 time_ms) const -> Positioning::PositionInfo
+{
+    if (!m_initialized) {
+        return {};
+    }
+
+    auto east = m_east;
+    auto north = m_north;
+    auto up = m_up;
+    if (time_ms > m_time_ms) {
+        auto dt = static_cast<double>(time_ms-m_time_ms)/1000.0;
+        east.predict(dt, horizontalAccelerationNoise);
+        north.predict(dt, horizontalAccelerationNoise);
+        up.predict(dt, verticalAccelerationNoise);
+    }
+
+    auto coordinate = toCoordinate(east.position, north.position);
+    if (m_hasAltitude) {
+        coordinate.setAltitude(up.position);
+    }
+
+    QGeoPositionInfo result(coordinate, QDateTime::fromMSecsSinceEpoch(time_ms, Qt::UTC));
+    result.setAttribute(QGeoPositionInfo::HorizontalAccuracy, qSqrt(east.P00 + north.P00));
+    result.setAttribute(QGeoPositionInfo::GroundSpeed, qHypot(east.velocity, north.velocity));
+    auto direction = qRadiansToDegrees(qAtan2(east.velocity, north.velocity));
+    if (direction < 0.0) {
+        direction += 360.0;
+    }
+    result.setAttribute(QGeoPositionInfo::Direction, direction);
+    if (m_hasAltitude) {
+        result.setAttribute(QGeoPositionInfo::VerticalAccuracy, qSqrt(up.P00));
+        result.setAttribute(QGeoPositionInfo::VerticalSpeed, up.velocity);
+    }
+    if (qIsFinite(m_magneticVariation)) {
+        result.setAttribute(QGeoPositionInfo::MagneticVariation, m_magneticVariation);
+    }
+    return PositionInfo(result);
+}
+
+
+void Positioning::PositionFilter::reset()
+{
+    m_initialized = false;
+    m_hasAltitude = false;
+    m_time_ms = 0;
+    m_magneticVariation = qQNaN();
+}
+
+
+void Positioning::PositionFilter::recenter()
+{
+    m_origin = toCoordinate(m_east.position, m_north.position);
+    m_metersPerDegreeLongitude = qDegreesToRadians(earthRadiusInM)*qMax(0.01, qCos(qDegreesToRadians(m_origin.latitude())));
+    m_east.position = 0.0;
+    m_north.position = 0.0;
+}
+
+
+void Positioning::PositionFilter::toLocal(const QGeoCoordinate& coordinate, double& east, double& north) const
+{
+    north = (coordinate.latitude()-m_origin.latitude())*qDegreesToRadians(earthRadiusInM);
+    east = std::remainder(coordinate.longitude()-m_origin.longitude(), 360.0)*m_metersPerDegreeLongitude;
+}
+
+
+auto Positioning::PositionFilter::toCoordinate(double east, double north) const -> QGeoCoordinate
+{
+    auto latitude = m_origin.latitude() + north/qDegreesToRadians(earthRadiusInM);
+    auto longitude = m_origin.longitude() + east/m_metersPerDegreeLongitude;
+    return {qBound(-90.0, latitude, 90.0), std::remainder(longitude, 360.0)};
+}
@@ -0,0 +1,163 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QGeoCoordinate>
+#include <QtNumeric>
+
+#include "positioning/PositionInfo.h"
+
+
+namespace Positioning {
+
+/*! \brief Kalman filter for position fusion
+ *
+ *  This class implements a lightweight Kalman filter that fuses position
+ *  fixes from several sources into one smoothed estimate of position and
+ *  velocity. The filter uses a constant-velocity model. Horizontal positions
+ *  are expressed in a local east/north tangent plane whose origin is moved
+ *  along with the aircraft, and the three axes east, north and up are treated
+ *  independently of each other.
+ *
+ *  Each fix is weighted by the accuracy that its source reports. Ground
+ *  speed, track and vertical speed are used as velocity measurements, if
+ *  available. Fixes that are far away from the current estimate reset the
+ *  filter, so that jumps of the source (for instance, when a simulator is
+ *  started) are followed immediately.
+ *
+ *  Times are given in milliseconds since the epoch.
+ */
+
+class PositionFilter
+{
+public:
+    /*! \brief Adds a position fix to the filter
+     *
+     *  Invalid fixes and fixes without coordinate are ignored. Fixes that are
+     *  older than the last fix added are applied at the time of the last fix.
+     *
+     *  @param info Position fix
+     *
+     *  @param time_ms Time at which the fix was taken
+     */
+    void addMeasurement(const Positioning::PositionInfo& info, qint64 time_ms);
+
+    /*! \brief Estimated position at a given time
+     *
+     *  The estimate is extrapolated from the last fix added. The attributes
+     *  HorizontalAccuracy and VerticalAccuracy of the result contain the
+     *  standard deviation of the estimated position, computed from the
+     *  covariance of the filter.
+     *
+     *  @param time_ms Time for which the estimate is computed
+     *
+     *  @returns Estimated position, or an invalid PositionInfo if the filter
+     *  has not been initialized
+     */
+    Positioning::PositionInfo estimate(qint64 time_ms) const;
+
+    /*! \brief Check if the filter has been initialized
+     *
+     *  @returns True if at least one fix has been added since construction
+     *  or since the last call to reset()
+     */
+    bool isInitialized() const
+    {
+        return m_initialized;
+    }
+
+    /*! \brief Time of the last fix added
+     *
+     *  @returns Time, or 0 if the filter has not been initialized
+     */
+    qint64 lastMeasurementTime() const
+    {
+        return m_time_ms;
+    }
+
+    /*! \brief Resets the filter
+     *
+     *  After this, the filter is no longer initialized and the next fix
+     *  added is taken as is.
+     */
+    void reset();
+
+private:
+    // State and covariance of one axis
+    struct Axis
+    {
+        double position {0.0};
+        double velocity {0.0};
+        double P00 {0.0};
+        double P01 {0.0};
+        double P11 {0.0};
+
+        void initialize(double z, double sigma, double v, double sigmaV);
+        void predict(double dt, double accelerationNoise);
+        void updatePosition(double z, double sigma);
+        void updateVelocity(double z, double sigma);
+    };
+
+    // Converts a coordinate to east/north coordinates in the tangent plane
+    void toLocal(const QGeoCoordinate& coordinate, double& east, double& north) const;
+
+    // Converts east/north coordinates in the tangent plane to a coordinate
+    QGeoCoordinate toCoordinate(double east, double north) const;
+
+    // Moves the origin of the tangent plane to the current estimate
+    void recenter();
+
+    // Standard deviation of the acceleration, used as process noise
+    static constexpr double horizontalAccelerationNoise = 2.0;
+    static constexpr double verticalAccelerationNoise = 1.0;
+
+    // Measurement errors assumed if the source does not report them
+    static constexpr double defaultHorizontalAccuracy = 10.0;
+    static constexpr double defaultVerticalAccuracy = 15.0;
+    static constexpr double velocityAccuracy = 1.0;
+
+    // Initial uncertainty of velocities that are not measured
+    static constexpr double initialVelocityUncertainty = 50.0;
+
+    // The filter is reset if a fix is further away than this from the
+    // estimate, and also more than resetSigmas standard deviations
+    static constexpr double resetDistanceInM = 1000.0;
+    static constexpr double resetSigmas = 5.0;
+
+    // The tangent plane is moved if the estimate is further away than this
+    // from its origin
+    static constexpr double recenterDistanceInM = 10000.0;
+
+    // Radius of the earth used for the tangent plane
+    static constexpr double earthRadiusInM = 6371007.2;
+
+    bool m_initialized {false};
+    bool m_hasAltitude {false};
+    qint64 m_time_ms {0};
+    QGeoCoordinate m_origin;
+    double m_metersPerDegreeLongitude {0.0};
+    Axis m_east;
+    Axis m_north;
+    Axis m_up;
+    double m_magneticVariation {qQNaN()};
+};
+
+}
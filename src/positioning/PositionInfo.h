@@ -112,6 +112,16 @@ public:
      */
     Q_INVOKABLE AviationUnits::Angle variation() const;
 
+    /*! \brief Timestamp
+     *
+     *  @returns Time at which the position was measured, or an invalid
+     *  QDateTime if unknown
+     */
+    Q_INVOKABLE QDateTime timestamp() const
+    {
+        return m_positionInfo.timestamp();
+    }
+
     /*! \brief Vertical speed
      *
      *  @returns Vertical speed or NaN if unknown.
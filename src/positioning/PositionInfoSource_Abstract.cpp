@@ -90,6 +90,14 @@ void Positioning::PositionInfoSource_Abstract::setPressureAltitude(AviationUnits
 
     m_pressureAltitude = newPressureAltitude;
     emit pressureAltitudeChanged(m_pressureAltitude);
+
+    auto newReceiving = m_pressureAltitude.isFinite();
+    if (_receivingPressureAltitude == newReceiving) {
+        return;
+    }
+
+    _receivingPressureAltitude = newReceiving;
+    emit receivingPressureAltitudeChanged(_receivingPressureAltitude);
 }
 
 
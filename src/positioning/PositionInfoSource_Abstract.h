@@ -109,6 +109,23 @@ public:
         return _receivingPositionInfo;
     }
 
+    /*! \brief Indicator that pressure altitude is being received
+     *
+     *  Use this property to tell if pressure altitude is being received. Unlike
+     *  pressureAltitude, this property changes only when data starts or stops
+     *  arriving.
+     */
+    Q_PROPERTY(bool receivingPressureAltitude READ receivingPressureAltitude NOTIFY receivingPressureAltitudeChanged)
+
+    /*! \brief Getter method for property with the same name
+     *
+     *  @returns Property receivingPressureAltitude
+     */
+    bool receivingPressureAltitude() const
+    {
+        return _receivingPressureAltitude;
+    }
+
     /*! \brief Source name
      *
      *  This property holds a translated, human-readable string that describes
@@ -153,6 +170,9 @@ signals:
     /*! \brief Notifier signal */
     void receivingPositionInfoChanged(bool);
 
+    /*! \brief Notifier signal */
+    void receivingPressureAltitudeChanged(bool);
+
     /*! \brief Notifier signal */
     void sourceNameChanged(const QString &name);
 
@@ -169,7 +189,8 @@ protected:
 
     // This method must be used by child classes to update the pressure altitude
     // The class uses a timer internally to reset the position info to "invalid"
-    // after the time specified in PositionInfo::lifetime seconds.
+    // after the time specified in PositionInfo::lifetime seconds. It also
+    // updates the property receivingPressureAltitude.
     void setPressureAltitude(AviationUnits::Distance newPressureAltitude);
 
     // This method must be used by child classes to update the source name
@@ -195,6 +216,7 @@ private:
     QString m_statusString {};
 
     bool _receivingPositionInfo {false};
+    bool _receivingPressureAltitude {false};
 };
 
 }
@@ -18,8 +18,13 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QGuiApplication>
+
+#include "Global.h"
+#include "navigation/Navigator.h"
 #include "positioning/Geoid.h"
 #include "positioning/PositionInfoSource_Satellite.h"
+#include "traffic/TrafficDataProvider.h"
 
 
 Positioning::PositionInfoSource_Satellite::PositionInfoSource_Satellite(QObject *parent) : PositionInfoSource_Abstract(parent)
@@ -27,7 +32,6 @@ Positioning::PositionInfoSource_Satellite::PositionInfoSource_Satellite(QObject
     source = QGeoPositionInfoSource::createDefaultSource(this);
     if (source != nullptr) {
         source->setPreferredPositioningMethods(QGeoPositionInfoSource::AllPositioningMethods);
-        source->setUpdateInterval(1000);
 
         QString sName = source->sourceName();
         if (sName.isEmpty()) {
@@ -38,7 +42,13 @@ Positioning::PositionInfoSource_Satellite::PositionInfoSource_Satellite(QObject
 
         connect(source, SIGNAL(error(QGeoPositionInfoSource::Error)), this, SLOT(updateStatusString()));
         connect(source, &QGeoPositionInfoSource::positionUpdated, this, &PositionInfoSource_Satellite::onPositionUpdated);
+
+        // Start with the flight update interval, until the state of the
+        // Navigator and the TrafficDataProvider is known
+        m_updateInterval = static_cast<int>(std::chrono::milliseconds(flightUpdateInterval).count());
+        source->setUpdateInterval(m_updateInterval);
         source->startUpdates();
+        QTimer::singleShot(0, this, &Positioning::PositionInfoSource_Satellite::deferredInitialization);
     } else {
         setSourceName( tr("None") );
     }
@@ -47,6 +57,44 @@ Positioning::PositionInfoSource_Satellite::PositionInfoSource_Satellite(QObject
 }
 
 
+void Positioning::PositionInfoSource_Satellite::deferredInitialization()
+{
+    connect(Global::navigator(), &Navigation::Navigator::isInFlightChanged, this, &Positioning::PositionInfoSource_Satellite::updateUpdateInterval);
+    connect(Global::trafficDataProvider(), &Traffic::TrafficDataProvider::receivingPositionInfoChanged, this, &Positioning::PositionInfoSource_Satellite::updateUpdateInterval);
+    connect(qGuiApp, &QGuiApplication::applicationStateChanged, this, &Positioning::PositionInfoSource_Satellite::updateUpdateInterval);
+    updateUpdateInterval();
+}
+
+
+void Positioning::PositionInfoSource_Satellite::updateUpdateInterval()
+{
+    if (source == nullptr) {
+        return;
+    }
+
+    auto interval = flightUpdateInterval;
+    auto* navigator = Global::navigator();
+    if ((navigator != nullptr) && !navigator->isInFlight()) {
+        interval = (QGuiApplication::applicationState() == Qt::ApplicationActive) ? groundUpdateInterval : backgroundUpdateInterval;
+    }
+    auto* trafficDataProvider = Global::trafficDataProvider();
+    auto externalSourceActive = (trafficDataProvider != nullptr) && trafficDataProvider->receivingPositionInfo();
+    auto newUpdateInterval = externalSourceActive ? 0 : static_cast<int>(std::chrono::milliseconds(interval).count());
+    if (newUpdateInterval == m_updateInterval) {
+        return;
+    }
+    m_updateInterval = newUpdateInterval;
+
+    if (m_updateInterval == 0) {
+        source->stopUpdates();
+    } else {
+        source->setUpdateInterval(m_updateInterval);
+        source->startUpdates();
+    }
+    updateStatusString();
+}
+
+
 void Positioning::PositionInfoSource_Satellite::updateStatusString()
 {
     if (source == nullptr) {
@@ -66,6 +114,11 @@ void Positioning::PositionInfoSource_Satellite::updateStatusString()
         return;
     }
 
+    if (m_updateInterval == 0) {
+        setStatusString( tr("Paused while the traffic receiver provides position data") );
+        return;
+    }
+
     if (!receivingPositionInfo()) {
         setStatusString( tr("Waiting for signal") );
         return;
@@ -33,6 +33,14 @@ namespace Positioning {
  *  This class is a thin wrapper around QGeoPositionInfoSource. It constructs a
  *  default QGeoPositionInfoSource and forwards the data provided by that source
  *  via the PositionInfoSource_Abstract interface that it implements.
+ *
+ *  To save battery, the update interval of the QGeoPositionInfoSource adapts
+ *  to the situation. Positions are requested every flightUpdateInterval while
+ *  the Navigation::Navigator considers the aircraft in flight, and less often
+ *  on the ground, in particular while the app is not in the foreground.
+ *  Updates are stopped altogether while the Traffic::TrafficDataProvider
+ *  receives position information, because traffic receivers have a GNSS
+ *  receiver of their own, with an antenna that is usually better placed.
  */
 
 class PositionInfoSource_Satellite : public PositionInfoSource_Abstract
@@ -47,14 +55,30 @@ public:
     explicit PositionInfoSource_Satellite(QObject *parent = nullptr);
 
 private slots:
+    // Intializations that are moved out of the constructor, in order to avoid
+    // nested uses of globalInstance().
+    void deferredInitialization();
+
     void onPositionUpdated(const QGeoPositionInfo &info);
 
+    // Chooses the update interval, and starts or stops updates as needed
+    void updateUpdateInterval();
+
     void updateStatusString();
 
 private:
     Q_DISABLE_COPY_MOVE(PositionInfoSource_Satellite)
 
+    // Update intervals in flight, on the ground, and on the ground while the
+    // app is not in the foreground
+    static constexpr auto flightUpdateInterval = 1s;
+    static constexpr auto groundUpdateInterval = 5s;
+    static constexpr auto backgroundUpdateInterval = 10s;
+
     QPointer<QGeoPositionInfoSource> source {nullptr};
+
+    // Current update interval in milliseconds, or 0 if updates are stopped
+    int m_updateInterval {0};
 };
 
 }
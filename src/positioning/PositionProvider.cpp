@@ -48,8 +48,16 @@ Positioning::PositionProvider::PositionProvider(QObject *parent) : PositionInfoS
     connect(&satelliteSource, &Positioning::PositionInfoSource_Satellite::positionInfoChanged, this, &PositionProvider::onPositionUpdated);
     connect(&satelliteSource, &Positioning::PositionInfoSource_Satellite::pressureAltitudeChanged, this, &PositionProvider::onPressureAltitudeUpdated);
 
-    // Binding for updateStatusString
+    // Publish filtered positions at a fixed rate
+    m_outputTimer.setInterval(outputInterval);
+    connect(&m_outputTimer, &QTimer::timeout, this, &PositionProvider::emitFilteredPositionInfo);
+
+    // Binding for updateStatusString. The string changes only when data
+    // starts or stops arriving, or when the sources change, but not with
+    // every new fix.
     connect(this, &Positioning::PositionProvider::receivingPositionInfoChanged, this, &Positioning::PositionProvider::updateStatusString);
+    connect(this, &Positioning::PositionProvider::receivingPressureAltitudeChanged, this, &Positioning::PositionProvider::updateStatusString);
+    connect(this, &Positioning::PositionProvider::sourceNameChanged, this, &Positioning::PositionProvider::updateStatusString);
     connect(&satelliteSource, &Positioning::PositionInfoSource_Satellite::statusStringChanged, this, &Positioning::PositionProvider::updateStatusString);
 
     // Wire up traffic data provider source
@@ -98,30 +106,69 @@ auto Positioning::PositionProvider::globalInstance() -> PositionProvider *
 void Positioning::PositionProvider::onPositionUpdated()
 {
     // This method is called if one of our providers has a new position info.
-    // We go through the list of providers in order of preference, to find the first one
-    // that has a valid position info available for us.
-    PositionInfo info;
-    QString source;
+    // All providers with valid position info feed the fusion filter. Each fix
+    // is added only once, because this method is called whenever one of the
+    // providers changes.
+    auto now = QDateTime::currentMSecsSinceEpoch();
+    QStringList sources;
 
-    // Priority #1: Traffic data provider
+    // Traffic data provider
     auto* trafficDataProvider = Global::trafficDataProvider();
     if (trafficDataProvider != nullptr) {
-        info = trafficDataProvider->positionInfo();
-        source = trafficDataProvider->sourceName();
+        auto info = trafficDataProvider->positionInfo();
+        if (info.isValid()) {
+            sources << trafficDataProvider->sourceName();
+            if (!(info == m_lastTrafficInfo)) {
+                m_lastTrafficInfo = info;
+                m_positionFilter.addMeasurement(info, now);
+            }
+        }
     }
 
-    // Priority #2: Built-in sat receiver
-    if (!info.isValid()) {
-        info = satelliteSource.positionInfo();
-        source = satelliteSource.sourceName();
+    // Built-in sat receiver
+    auto info = satelliteSource.positionInfo();
+    if (info.isValid()) {
+        sources << satelliteSource.sourceName();
+        if (!(info == m_lastSatelliteInfo)) {
+            m_lastSatelliteInfo = info;
+            m_positionFilter.addMeasurement(info, now);
+        }
+    }
+
+    // No source has valid data
+    if (sources.isEmpty()) {
+        m_positionFilter.reset();
+        m_outputTimer.stop();
+        setPositionInfo( {} );
+        setSourceName(satelliteSource.sourceName());
+        return;
     }
 
     // Set new info
-    setPositionInfo(info);
+    setSourceName(sources.join(QStringLiteral(" + ")));
+    if (!m_outputTimer.isActive()) {
+        emitFilteredPositionInfo();
+        m_outputTimer.start();
+    }
+}
+
+
+void Positioning::PositionProvider::emitFilteredPositionInfo()
+{
+    if (!m_positionFilter.isInitialized()) {
+        return;
+    }
+    auto now = QDateTime::currentMSecsSinceEpoch();
+    if (now-m_positionFilter.lastMeasurementTime() > std::chrono::milliseconds(maxExtrapolationTime).count()) {
+        return;
+    }
+
+    // Update the last valid coordinate and track first, so that consumers of
+    // positionInfoChanged see consistent values
+    auto info = m_positionFilter.estimate(now);
     setLastValidCoordinate(info.coordinate());
     setLastValidTT(info.trueTrack());
-    setSourceName(source);
-    updateStatusString();
+    setPositionInfo(info);
 }
 
 
@@ -197,10 +244,26 @@ auto Positioning::PositionProvider::lastValidTT() -> AviationUnits::Angle
 
 void Positioning::PositionProvider::updateStatusString()
 {
+    // Return early if the state that the status string depends on did not
+    // change since the string was last computed
+    StatusStringKey key;
+    key.receivingPositionInfo = receivingPositionInfo();
+    if (key.receivingPositionInfo) {
+        key.receivingPressureAltitude = receivingPressureAltitude();
+        key.sourceName = sourceName();
+    } else {
+        key.satelliteSourceName = satelliteSource.sourceName();
+        key.satelliteStatusString = satelliteSource.statusString();
+    }
+    if (m_statusStringKey == key) {
+        return;
+    }
+    m_statusStringKey = key;
+
     if (receivingPositionInfo()) {
         QString result = QString("<p>%1</p><ul style='margin-left:-25px;'>").arg(sourceName());
         result += QString("<li>%1</li>").arg(tr("Receiving position information."));
-        if (pressureAltitude().isFinite()) {
+        if (receivingPressureAltitude()) {
             result += QString("<li>%1</li>").arg(tr("Receiving pressure altitude."));
         }
         result += "</ul>";
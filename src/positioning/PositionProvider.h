@@ -20,8 +20,10 @@
 
 #pragma once
 
+#include "positioning/PositionFilter.h"
 #include "positioning/PositionInfoSource_Abstract.h"
 #include "positioning/PositionInfoSource_Satellite.h"
+#include <optional>
 
 
 namespace Positioning {
@@ -29,8 +31,11 @@ namespace Positioning {
 /*! \brief Central Position Provider
  *
  *  This class collects position data from the various sources (satellite,
- *  network, traffic receiver, …)  chooses the best available source and exposes
- *  the data to QML and other parts of the program.
+ *  network, traffic receiver, …), fuses them with a PositionFilter and exposes
+ *  the data to QML and other parts of the program. The filtered position is
+ *  published at a fixed rate, independently of the rate at which the sources
+ *  deliver data. Its attribute HorizontalAccuracy contains the accuracy
+ *  estimate of the filter.
  *
  *  There exists one static instance of this class, which can be accessed via
  *  the method globalInstance().  No other instance of this class should be
@@ -106,6 +111,9 @@ private slots:
     // Connected to sources, in order to receive new data
     void onPositionUpdated();
 
+    // Connected to m_outputTimer, publishes the filtered position
+    void emitFilteredPositionInfo();
+
     // Connected to sources, in order to receive new data
     void onPressureAltitudeUpdated();
 
@@ -131,8 +139,33 @@ private:
     static constexpr double EDTF_lon = 7.832583;
     static constexpr double EDTF_ele = 244;
 
+    // Interval at which filtered positions are published
+    static constexpr auto outputInterval = 500ms;
+
+    // No filtered positions are published if the last fix is older than this
+    static constexpr auto maxExtrapolationTime = 3s;
+
     PositionInfoSource_Satellite satelliteSource;
 
+    // Fusion filter, and the last fixes that were added to it
+    PositionFilter m_positionFilter;
+    PositionInfo m_lastSatelliteInfo;
+    PositionInfo m_lastTrafficInfo;
+    QTimer m_outputTimer;
+
+    // State that the property statusString was last computed from. The string
+    // is regenerated by updateStatusString() only if this state changes.
+    struct StatusStringKey {
+        bool receivingPositionInfo {false};
+        bool receivingPressureAltitude {false};
+        QString sourceName;
+        QString satelliteSourceName;
+        QString satelliteStatusString;
+
+        bool operator==(const StatusStringKey& other) const = default;
+    };
+    std::optional<StatusStringKey> m_statusStringKey;
+
     QGeoCoordinate m_lastValidCoordinate {EDTF_lat, EDTF_lon, EDTF_ele};
     AviationUnits::Angle m_lastValidTT {};
 };
@@ -37,7 +37,7 @@ Map {
     */
     property real pixelPer10km: 0.0
 
-    /*! \brief Name of a GeoJSON file containing airspace and waypoint information */
+    /*! \brief GeoJSON document containing airspace and waypoint information near the visible region */
     property string geoJSON
     
     /*! \brief Width of thick lines around airspaces, such as class D */
@@ -53,6 +53,8 @@ Map {
         var dx = vec2.x - vec1.x
         var dy = vec2.y - vec1.y
         pixelPer10km = Math.sqrt(dx*dx+dy*dy);
+        global.geoMapProvider().setMapZoomLevel(zoomLevel)
+        global.geoMapProvider().setMapViewport(visibleRegion)
     }
     
     onMapReadyChanged: {
@@ -60,6 +62,16 @@ Map {
         global.mobileAdaptor().hideSplashScreen()
     }
 
+    /*
+    * Handle changes in the visible region, so that aviation data is loaded only
+    * for the region shown on the map
+    */
+
+    onCenterChanged: global.geoMapProvider().setMapViewport(visibleRegion)
+    onBearingChanged: global.geoMapProvider().setMapViewport(visibleRegion)
+    onWidthChanged: global.geoMapProvider().setMapViewport(visibleRegion)
+    onHeightChanged: global.geoMapProvider().setMapViewport(visibleRegion)
+
     maximumZoomLevel: 13
     minimumZoomLevel: 7
     
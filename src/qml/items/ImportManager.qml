@@ -30,6 +30,9 @@ Item {
     property string filePath: ""
     property int fileFunction: MobileAdaptor.UnknownFunction
 
+    // True while a flight route in GeoJSON format is loaded in the background
+    property bool loadingFlightRoute: false
+
     Connections {
         target: global.mobileAdaptor()
         function onOpenFileRequest(fileName, fileFunction) {
@@ -52,6 +55,16 @@ Item {
       }
     } // Connections
 
+    Connections {
+        target: global.navigator().flightRoute
+        function onLoadFinished(errorString) {
+            if (!importManager.loadingFlightRoute)
+                return
+            importManager.loadingFlightRoute = false
+            importDialog.finishImport(errorString)
+        }
+    }
+
 
     Dialog {
         id: importDialog
@@ -84,14 +97,20 @@ Item {
         onAccepted: {
             global.mobileAdaptor().vibrateBrief()
 
-            var errorString = ""
-
-            if (importManager.fileFunction === MobileAdaptor.FlightRoute_GeoJSON)
-                errorString = global.navigator().flightRoute.loadFromGeoJSON(importManager.filePath)
+            // GeoJSON files are parsed in the background; loading finishes
+            // in the Connections above
+            if (importManager.fileFunction === MobileAdaptor.FlightRoute_GeoJSON) {
+                importManager.loadingFlightRoute = true
+                global.navigator().flightRoute.loadFromGeoJSONAsync(importManager.filePath)
+                return
+            }
             if (importManager.fileFunction === MobileAdaptor.FlightRoute_GPX) {
-                errorString = global.navigator().flightRoute.loadFromGpx(importManager.filePath, global.geoMapProvider())
+                var errorString = global.navigator().flightRoute.loadFromGpx(importManager.filePath, global.geoMapProvider())
+                importDialog.finishImport(errorString)
             }
+        }
 
+        function finishImport(errorString) {
             if (errorString !== "") {
                 errLbl.text = errorString
                 errorDialog.open()
@@ -303,13 +303,9 @@ Item {
             opacity: (flightMap.zoomLevel < 11.0) ? 1.0 : 0.3
         }
 
-        MapItemView { // Traffic opponents
-            model: global.trafficDataProvider().trafficObjects4QML
-            delegate: Component {
-                Traffic {
-                    trafficInfo: model.modelData
-                }
-            }
+        TrafficOverlay { // Traffic opponents, all drawn by one scene graph node
+            anchors.fill: parent
+            map: flightMap
         }
 
         MapItemView {
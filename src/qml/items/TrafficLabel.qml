@@ -32,9 +32,9 @@ MapQuickItem {
     property real distFromCenter: 0.5*Math.sqrt(lbl.width*lbl.width + lbl.height*lbl.height) + 28
     property real t: isFinite(trafficInfo.TT) ? 2*Math.PI*(trafficInfo.TT-flightMap.bearing)/360.0 : 0
 
-    coordinate: trafficInfo.coordinate.isValid ? trafficInfo.coordinate : positionProvider.lastValidCoordinate
+    coordinate: trafficInfo.extrapolatedCoordinate.isValid ? trafficInfo.extrapolatedCoordinate : positionProvider.lastValidCoordinate
     Behavior on coordinate {
-        CoordinateAnimation { duration: 1000 }
+        CoordinateAnimation { duration: 200 }
         enabled: trafficInfo.animate
     }
 
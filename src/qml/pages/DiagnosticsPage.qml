@@ -0,0 +1,187 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+import QtQml 2.15
+import QtQuick 2.15
+import QtQuick.Controls 2.15
+import QtQuick.Layouts 1.15
+
+import "../items"
+
+Page {
+    id: diagnosticsPage
+    title: qsTr("Diagnostics")
+
+    header: StandardHeader {}
+
+    // Metrics, as returned by global.metrics(), parsed
+    property var metrics: JSON.parse(global.metrics())
+
+    // Returns the upper bound of the bucket that contains the given quantile
+    function quantile(probe, q) {
+        if (probe.count === 0)
+            return "-"
+        var target = q*probe.count
+        var sum = 0
+        for (var i=0; i<probe.histogram.length; i++) {
+            sum += probe.histogram[i]
+            if (sum >= target)
+                return (i < metrics.bucketBounds_us.length) ? "≤ " + metrics.bucketBounds_us[i] : "> " + metrics.bucketBounds_us[metrics.bucketBounds_us.length-1]
+        }
+        return "-"
+    }
+
+    // Estimated memory usage, as returned by MemoryBudget
+    property var memoryUsage: global.memoryBudget().usageBySubsystem()
+
+    Timer {
+        interval: 2000
+        repeat: true
+        running: true
+        onTriggered: {
+            diagnosticsPage.metrics = JSON.parse(global.metrics())
+            diagnosticsPage.memoryUsage = global.memoryBudget().usageBySubsystem()
+        }
+    }
+
+    ScrollView {
+        id: view
+        clip: true
+        anchors.fill: parent
+        anchors.topMargin: Qt.application.font.pixelSize
+        anchors.bottomMargin: Qt.application.font.pixelSize
+        anchors.leftMargin: Qt.application.font.pixelSize
+        anchors.rightMargin: Qt.application.font.pixelSize
+
+        ScrollBar.horizontal.policy: ScrollBar.AlwaysOff
+
+        ColumnLayout {
+            width: view.width
+
+            GridLayout {
+                columns: 5
+                columnSpacing: 10
+                Layout.fillWidth: true
+
+                Label {
+                    Layout.columnSpan: 5
+                    Layout.fillWidth: true
+                    wrapMode: Text.Wrap
+                    text: qsTr("Durations in µs. The same data is available in JSON format from the built-in tile server, under the path /metrics.json.")
+                }
+
+                Label { text: qsTr("Probe"); font.bold: true; Layout.fillWidth: true }
+                Label { text: qsTr("Calls"); font.bold: true }
+                Label { text: qsTr("Mean"); font.bold: true }
+                Label { text: qsTr("Median"); font.bold: true }
+                Label { text: qsTr("Max"); font.bold: true }
+
+                Repeater {
+                    model: Object.keys(diagnosticsPage.metrics.probes)
+
+                    delegate: Label {
+                        Layout.row: index+2
+                        Layout.column: 0
+                        Layout.fillWidth: true
+                        elide: Text.ElideRight
+                        text: modelData
+                    }
+                }
+                Repeater {
+                    model: Object.keys(diagnosticsPage.metrics.probes)
+
+                    delegate: Label {
+                        Layout.row: index+2
+                        Layout.column: 1
+                        text: diagnosticsPage.metrics.probes[modelData].count
+                    }
+                }
+                Repeater {
+                    model: Object.keys(diagnosticsPage.metrics.probes)
+
+                    delegate: Label {
+                        readonly property var probe: diagnosticsPage.metrics.probes[modelData]
+
+                        Layout.row: index+2
+                        Layout.column: 2
+                        text: (probe.count > 0) ? Math.round(probe.total_us/probe.count) : "-"
+                    }
+                }
+                Repeater {
+                    model: Object.keys(diagnosticsPage.metrics.probes)
+
+                    delegate: Label {
+                        Layout.row: index+2
+                        Layout.column: 3
+                        text: diagnosticsPage.quantile(diagnosticsPage.metrics.probes[modelData], 0.5)
+                    }
+                }
+                Repeater {
+                    model: Object.keys(diagnosticsPage.metrics.probes)
+
+                    delegate: Label {
+                        readonly property var probe: diagnosticsPage.metrics.probes[modelData]
+
+                        Layout.row: index+2
+                        Layout.column: 4
+                        text: (probe.count > 0) ? probe.max_us : "-"
+                    }
+                }
+            }
+
+            GridLayout {
+                columns: 2
+                columnSpacing: 10
+                Layout.fillWidth: true
+                Layout.topMargin: Qt.application.font.pixelSize
+
+                Label {
+                    Layout.columnSpan: 2
+                    Layout.fillWidth: true
+                    wrapMode: Text.Wrap
+                    text: global.memoryBudget().lowMemoryMode ? qsTr("Estimated memory usage in kB. The app runs in low-memory mode.") : qsTr("Estimated memory usage in kB.")
+                }
+
+                Label { text: qsTr("Subsystem"); font.bold: true; Layout.fillWidth: true }
+                Label { text: qsTr("Usage"); font.bold: true }
+
+                Repeater {
+                    model: Object.keys(diagnosticsPage.memoryUsage)
+
+                    delegate: Label {
+                        Layout.row: index+2
+                        Layout.column: 0
+                        Layout.fillWidth: true
+                        text: modelData
+                    }
+                }
+                Repeater {
+                    model: Object.keys(diagnosticsPage.memoryUsage)
+
+                    delegate: Label {
+                        Layout.row: index+2
+                        Layout.column: 1
+                        text: Math.round(diagnosticsPage.memoryUsage[modelData]/1024)
+                    }
+                }
+            }
+        }
+    }
+}
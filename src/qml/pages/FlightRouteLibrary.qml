@@ -130,7 +130,7 @@ Page {
                 id: iDel
                 Layout.fillWidth: true
 
-                text: modelData
+                text: modelData + `<br><font color="#606060" size="2">` + librarian.flightRouteSummary(modelData) + `</font>`
                 icon.source: "/icons/material/ic_directions.svg"
 
                 onClicked: {
@@ -184,7 +184,7 @@ Page {
                                 highlighted = false
                                 parent.highlighted = false
 
-                                var errorString = global.mobileAdaptor().exportContent(librarian.flightRouteGet(modelData).toGeoJSON(), "application/geo+json", librarian.flightRouteGet(modelData).suggestedFilename())
+                                var errorString = global.mobileAdaptor().exportContent(librarian.flightRouteGet(modelData).toGeoJSON(), "application/geo+json", librarian.flightRouteGet(modelData).suggestedFilename(), qsTr("Export flight route"))
                                 if (errorString === "abort") {
                                     toast.doToast(qsTr("Aborted"))
                                     return
@@ -209,7 +209,8 @@ Page {
                                 highlighted = false
                                 parent.highlighted = false
 
-                                var errorString = global.mobileAdaptor().exportContent(librarian.flightRouteGet(modelData).toGpx(), "application/gpx+xml", librarian.flightRouteGet(modelData).suggestedFilename())
+                                var route = librarian.flightRouteGet(modelData)
+                                var errorString = global.mobileAdaptor().exportFlightRouteGpx(route, route.suggestedFilename())
                                 if (errorString === "abort") {
                                     toast.doToast(qsTr("Aborted"))
                                     return
@@ -255,7 +256,8 @@ Page {
                                 highlighted = false
                                 parent.highlighted = false
 
-                                var errorString = global.mobileAdaptor().viewContent(librarian.flightRouteGet(modelData).toGpx(), "application/gpx+xml", "FlightRoute-%1.gpx")
+                                var route = librarian.flightRouteGet(modelData)
+                                var errorString = global.mobileAdaptor().viewFlightRouteGpx(route, "FlightRoute-%1.gpx")
                                 if (errorString !== "") {
                                     shareErrorDialogLabel.text = errorString
                                     shareErrorDialog.open()
@@ -332,14 +334,27 @@ Page {
     // This is the name of the file that openFromLibrary will open
     property string finalFileName;
 
+    // True while openFromLibrary waits for the flight route to load
+    property bool loadingFlightRoute: false
+
     function openFromLibrary() {
-        var errorString = global.navigator().flightRoute.loadFromGeoJSON(librarian.flightRouteFullPath(finalFileName))
-        if (errorString !== "") {
-            lbl.text = errorString
-            fileError.open()
-            return
+        loadingFlightRoute = true
+        global.navigator().flightRoute.loadFromGeoJSONAsync(librarian.flightRouteFullPath(finalFileName))
+    }
+
+    Connections {
+        target: global.navigator().flightRoute
+        function onLoadFinished(errorString) {
+            if (!page.loadingFlightRoute)
+                return
+            page.loadingFlightRoute = false
+            if (errorString !== "") {
+                lbl.text = errorString
+                fileError.open()
+                return
+            }
+            stackView.push("FlightRouteEditor.qml")
         }
-        stackView.push("FlightRouteEditor.qml")
     }
 
     function reloadFlightRouteList() {
@@ -348,6 +363,13 @@ Page {
         textInput.text = cache
     }
 
+    Connections {
+        target: librarian
+        function onFlightRoutesChanged() {
+            page.reloadFlightRouteList()
+        }
+    }
+
     Dialog {
         id: fileError
 
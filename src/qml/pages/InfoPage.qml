@@ -39,7 +39,12 @@ Page {
 
         currentIndex: sv.currentIndex
 
-        TabButton { text: "Enroute" }
+        TabButton {
+            text: "Enroute"
+
+            // Hidden entry to the diagnostics page, for field testers
+            onPressAndHold: stackView.push(Qt.resolvedUrl("DiagnosticsPage.qml"))
+        }
         TabButton { text: qsTr("Authors") }
         TabButton { text: qsTr("License") }
         Material.elevation: 3
@@ -456,11 +456,12 @@ Page {
         width: parent.width
 
         Material.elevation: 3
-        visible: !global.mapManager().geoMaps.downloading && global.mapManager().geoMaps.updatable
+        visible: global.mapManager().geoMaps.downloading || global.mapManager().geoMaps.updatable
 
         ToolButton {
             id: downloadUpdatesActionButton
             anchors.centerIn: parent
+            visible: !global.mapManager().geoMaps.downloading
             text: qsTr("Download all updates…")
             icon.source: "/icons/material/ic_file_download.svg"
 
@@ -469,6 +470,12 @@ Page {
                 global.mapManager().geoMaps.updateAll()
             }
         }
+
+        Label {
+            anchors.centerIn: parent
+            visible: global.mapManager().geoMaps.downloading
+            text: qsTr("Downloading … %1").arg(global.mapManager().geoMaps.throughput)
+        }
     } // Pane (footer)
 
     // Show error when list of maps cannot be downloaded
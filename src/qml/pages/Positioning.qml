@@ -178,11 +178,140 @@ Page {
             Label { text: qsTr("Pressure Altitude") }
             Label { text: positionProvider.pressureAltitude.isFinite() ? Math.round(positionProvider.pressureAltitude.toFeet()) + " ft" : "-" }
 
+            Label {
+                text: qsTr("<h3>Flight Recorder</h3>")
+                Layout.columnSpan: 2
+            }
+
+            SwitchDelegate {
+                id: recordFlightTrack
+                Layout.columnSpan: 2
+                Layout.fillWidth: true
+                text: qsTr("Record Flight Track")
+                      + `<br><font color="#606060" size="2">`
+                      + ( global.settings().recordFlightTrack ?
+                             qsTr("Positions are stored on this device") :
+                             qsTr("Off, no positions are stored") )
+                      + "</font>"
+                Component.onCompleted: recordFlightTrack.checked = global.settings().recordFlightTrack
+                onToggled: {
+                    global.mobileAdaptor().vibrateBrief()
+                    global.settings().recordFlightTrack = recordFlightTrack.checked
+                }
+            }
+
+            Label { text: qsTr("Recorded Positions") }
+            Label { text: global.navigator().flightRecorder.size }
+
+            ToolButton {
+                Layout.columnSpan: 2
+                Layout.alignment: Qt.AlignHCenter
+                enabled: global.navigator().flightRecorder.size > 0
+
+                text: qsTr("Export Flight Track to GPX File")
+                onClicked: {
+                    global.mobileAdaptor().vibrateBrief()
+                    exportFlightTrack(global.mobileAdaptor().exportFlightTrackGpx(global.navigator().flightRecorder, flightTrackFileName()))
+                }
+            }
+
+            ToolButton {
+                Layout.columnSpan: 2
+                Layout.alignment: Qt.AlignHCenter
+                enabled: global.navigator().flightRecorder.size > 0
+
+                text: qsTr("Export Flight Track to IGC File")
+                onClicked: {
+                    global.mobileAdaptor().vibrateBrief()
+                    exportFlightTrack(global.mobileAdaptor().exportFlightTrackIGC(global.navigator().flightRecorder, flightTrackFileName()))
+                }
+            }
+
+            ToolButton {
+                Layout.columnSpan: 2
+                Layout.alignment: Qt.AlignHCenter
+                enabled: global.navigator().flightRecorder.size > 0
+
+                text: qsTr("Clear Flight Track")
+                onClicked: {
+                    global.mobileAdaptor().vibrateBrief()
+                    clearFlightTrackDialog.open()
+                }
+            }
+
 
         } // GridLayout
 
     } // Scrollview
 
+    // File name for exported flight tracks, without suffix
+    function flightTrackFileName() {
+        return "FlightTrack-" + new Date().toISOString().slice(0, 10)
+    }
+
+    // Reports the result of an export of the flight track
+    function exportFlightTrack(errorString) {
+        if (errorString === "abort") {
+            toast.doToast(qsTr("Aborted"))
+            return
+        }
+        if (errorString !== "") {
+            shareErrorDialogLabel.text = errorString
+            shareErrorDialog.open()
+            return
+        }
+        if (Qt.platform.os === "android")
+            toast.doToast(qsTr("Flight track shared"))
+        else
+            toast.doToast(qsTr("Flight track exported"))
+    }
+
+    Dialog {
+        id: shareErrorDialog
+        anchors.centerIn: parent
+        parent: Overlay.overlay
+
+        title: qsTr("Error exporting data…")
+        width: Math.min(parent.width-Qt.application.font.pixelSize, 40*Qt.application.font.pixelSize)
+
+        Label {
+            id: shareErrorDialogLabel
+            width: shareErrorDialog.availableWidth
+            wrapMode: Text.Wrap
+            textFormat: Text.StyledText
+        }
+
+        standardButtons: Dialog.Ok
+        modal: true
+
+    }
+
+    Dialog {
+        id: clearFlightTrackDialog
+        anchors.centerIn: parent
+        parent: Overlay.overlay
+
+        title: qsTr("Clear flight track?")
+        width: Math.min(parent.width-Qt.application.font.pixelSize, 40*Qt.application.font.pixelSize)
+
+        Label {
+            width: clearFlightTrackDialog.availableWidth
+            text: qsTr("Once cleared, the recorded positions cannot be restored.")
+            wrapMode: Text.Wrap
+            textFormat: Text.StyledText
+        }
+
+        standardButtons: Dialog.No | Dialog.Yes
+        modal: true
+
+        onAccepted: {
+            global.mobileAdaptor().vibrateBrief()
+            global.navigator().flightRecorder.clear()
+            toast.doToast(qsTr("Flight track cleared"))
+        }
+        onRejected: global.mobileAdaptor().vibrateBrief()
+    }
+
     LongTextDialog {
         id: trafficHelp
         standardButtons: Dialog.Ok
@@ -74,6 +74,26 @@ Page {
                 }
             }
 
+            SwitchDelegate {
+                id: loadByRegion
+                text: qsTr("Load Aviation Data by Region")
+                      + `<br><font color="#606060" size="2">`
+                      + ( global.settings().loadAviationDataByRegion ?
+                             qsTr("Only near position and route, saves memory") :
+                             qsTr("All installed maps")
+                         )
+                      + "</font>"
+                icon.source: "/icons/material/ic_map.svg"
+                Layout.fillWidth: true
+                Component.onCompleted: {
+                    loadByRegion.checked = global.settings().loadAviationDataByRegion
+                }
+                onToggled: {
+                    global.mobileAdaptor().vibrateBrief()
+                    global.settings().loadAviationDataByRegion = loadByRegion.checked
+                }
+            }
+
             Label {
                 Layout.leftMargin: Qt.application.font.pixelSize
                 text: qsTr("System")
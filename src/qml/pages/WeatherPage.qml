@@ -126,32 +126,32 @@ Page {
             // Background color according to METAR/FAA flight category
             Rectangle {
                 anchors.fill: parent
-                color: model.modelData.hasMETAR ? model.modelData.metar.flightCategoryColor : "transparent"
+                color: model.station.hasMETAR ? model.station.metar.flightCategoryColor : "transparent"
                 opacity: 0.2
             }
 
             WordWrappingItemDelegate {
                 id: idel
                 text: {
-                    var result = model.modelData.twoLineTitle
+                    var result = model.station.twoLineTitle
 
-                    var wayTo  = model.modelData.wayTo(positionProvider.positionInfo.coordinate(), global.settings().useMetricUnits)
+                    var wayTo  = model.station.wayTo(positionProvider.positionInfo.coordinate(), global.settings().useMetricUnits)
                     if (wayTo !== "")
                         result = result + "<br>" + wayTo
 
-                    if (model.modelData.hasMETAR)
-                        result = result + "<br>" + model.modelData.metar.summary
+                    if (model.station.hasMETAR)
+                        result = result + "<br>" + model.station.metar.summary
 
                     return result
                 }
-                icon.source: model.modelData.icon
+                icon.source: model.station.icon
                 icon.color: "transparent"
 
                 width: parent.width
 
                 onClicked: {
                     global.mobileAdaptor().vibrateBrief()
-                    weatherReport.weatherStation = model.modelData
+                    weatherReport.weatherStation = model.station
                     weatherReport.open()
                 }
             }
@@ -169,7 +169,7 @@ Page {
             Layout.fillWidth: true
             clip: true
 
-            model: weatherDownloadManager.weatherStations
+            model: weatherDownloadManager.weatherStationModel
             delegate: stationDelegate
             ScrollIndicator.vertical: ScrollIndicator {}
 
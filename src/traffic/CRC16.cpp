@@ -0,0 +1,120 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <array>
+
+#include "traffic/CRC16.h"
+
+
+// Table for the byte-wise algorithm, as given in the GDL90 interface control
+// document
+const std::array<quint16, 256> Crc16Table =
+{ 0, 4129, 8258, 12387, 16516, 20645, 24774, 28903, 33032, 37161,
+  41290, 45419, 49548, 53677, 57806, 61935, 4657, 528, 12915,
+  8786, 21173, 17044, 29431, 25302, 37689, 33560, 45947, 41818,
+  54205, 50076, 62463, 58334, 9314, 13379, 1056, 5121, 25830,
+  29895, 17572, 21637, 42346, 46411, 34088, 38153, 58862, 62927,
+  50604, 54669, 13907, 9842, 5649, 1584, 30423, 26358, 22165,
+  18100, 46939, 42874, 38681, 34616, 63455, 59390, 55197, 51132,
+  18628, 22757, 26758, 30887, 2112, 6241, 10242, 14371, 51660,
+  55789, 59790, 63919, 35144, 39273, 43274, 47403, 23285, 19156,
+  31415, 27286, 6769, 2640, 14899, 10770, 56317, 52188, 64447,
+  60318, 39801, 35672, 47931, 43802, 27814, 31879, 19684, 23749,
+  11298, 15363, 3168, 7233, 60846, 64911, 52716, 56781, 44330,
+  48395, 36200, 40265, 32407, 28342, 24277, 20212, 15891, 11826,
+  7761, 3696, 65439, 61374, 57309, 53244, 48923, 44858, 40793,
+  36728, 37256, 33193, 45514, 41451, 53516, 49453, 61774, 57711,
+  4224, 161, 12482, 8419, 20484, 16421, 28742, 24679, 33721,
+  37784, 41979, 46042, 49981, 54044, 58239, 62302, 689, 4752,
+  8947, 13010, 16949, 21012, 25207, 29270, 46570, 42443, 38312,
+  34185, 62830, 58703, 54572, 50445, 13538, 9411, 5280, 1153,
+  29798, 25671, 21540, 17413, 42971, 47098, 34713, 38840, 59231,
+  63358, 50973, 55100, 9939, 14066, 1681, 5808, 26199, 30326,
+  17941, 22068, 55628, 51565, 63758, 59695, 39368, 35305, 47498,
+  43435, 22596, 18533, 30726, 26663, 6336, 2273, 14466, 10403,
+  52093, 56156, 60223, 64286, 35833, 39896, 43963, 48026, 19061,
+  23124, 27191, 31254, 2801, 6864, 10931, 14994, 64814, 60687,
+  56684, 52557, 48554, 44427, 40424, 36297, 31782, 27655, 23652,
+  19525, 15522, 11395, 7392, 3265, 61215, 65342, 53085, 57212,
+  44955, 49082, 36825, 40952, 28183, 32310, 20053, 24180, 11923,
+  16050, 3793, 7920 };
+
+// Tables for the slicing-by-8 algorithm. The table sliceTables[k] contains the
+// checksums of all bytes, followed by k zero bytes. The first table coincides
+// with Crc16Table.
+constexpr auto makeSliceTables() -> std::array<std::array<quint16, 256>, 8>
+{
+    std::array<std::array<quint16, 256>, 8> tables {};
+    for(int i=0; i<256; i++) {
+        auto crc = static_cast<quint16>(i << 8U);
+        for(int bit=0; bit<8; bit++) {
+            crc = ((crc & 0x8000U) != 0) ? static_cast<quint16>((crc << 1U) ^ 0x1021U) : static_cast<quint16>(crc << 1U);
+        }
+        tables[0][i] = crc;
+    }
+    for(int k=1; k<8; k++) {
+        for(int i=0; i<256; i++) {
+            auto previous = tables[k-1][i];
+            tables[k][i] = static_cast<quint16>(previous << 8U) ^ tables[0][previous >> 8U];
+        }
+    }
+    return tables;
+}
+
+constexpr auto sliceTables = makeSliceTables();
+
+
+auto Traffic::CRC16::gdl90(const quint8* data, int size) -> quint16
+{
+    // The GDL90 algorithm feeds every byte into the low end of the register,
+    // after the register has been shifted. The result is therefore the
+    // remainder of the message polynomial itself. This equals the common
+    // CRC-CCITT (XMODEM) checksum of all bytes but the last two, combined with
+    // the last two bytes, and the common checksum can be computed eight bytes
+    // at a time.
+    if (size < 2) {
+        return gdl90Reference(data, size);
+    }
+
+    const auto& t = sliceTables;
+    auto bodySize = size-2;
+    quint16 crc = 0;
+    int i = 0;
+    for(; i+8<=bodySize; i+=8) {
+        crc = t[7][(crc >> 8U) ^ data[i]] ^ t[6][(crc & 0xFFU) ^ data[i+1]] ^
+                t[5][data[i+2]] ^ t[4][data[i+3]] ^
+                t[3][data[i+4]] ^ t[2][data[i+5]] ^
+                t[1][data[i+6]] ^ t[0][data[i+7]];
+    }
+    for(; i<bodySize; i++) {
+        crc = static_cast<quint16>(crc << 8U) ^ t[0][(crc >> 8U) ^ data[i]];
+    }
+    return crc ^ static_cast<quint16>((data[size-2] << 8U) | data[size-1]);
+}
+
+
+auto Traffic::CRC16::gdl90Reference(const quint8* data, int size) -> quint16
+{
+    quint16 crc = 0;
+    for(int i=0; i<size; i++) {
+        crc = Crc16Table.at(crc >> 8U) ^ (crc << 8U) ^ data[i];
+    }
+    return crc;
+}
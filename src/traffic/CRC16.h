@@ -0,0 +1,69 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QtGlobal>
+
+
+namespace Traffic {
+
+/*! \brief CRC checksums for GDL90 messages
+ *
+ * GDL90 messages are protected by a CRC-CCITT checksum (polynomial 0x1021,
+ * initial value 0), computed with the algorithm given in the GDL90 interface
+ * control document. The checksum is computed over the unescaped message,
+ * without the flag bytes and without the two checksum bytes.
+ *
+ * The functions in this namespace are reentrant and can be called from
+ * several threads simultaneously.
+ */
+
+namespace CRC16 {
+
+/*! \brief Computes the GDL90 checksum
+ *
+ * This function computes the same checksum as gdl90Reference(), but processes
+ * eight bytes per step, using the slicing-by-8 method.
+ *
+ * @param data Pointer to the data
+ *
+ * @param size Number of bytes
+ *
+ * @returns Checksum
+ */
+quint16 gdl90(const quint8* data, int size);
+
+/*! \brief Computes the GDL90 checksum, one byte at a time
+ *
+ * This is a literal implementation of the algorithm given in the GDL90
+ * interface control document. It serves as a reference for gdl90().
+ *
+ * @param data Pointer to the data
+ *
+ * @param size Number of bytes
+ *
+ * @returns Checksum
+ */
+quint16 gdl90Reference(const quint8* data, int size);
+
+};
+
+};
@@ -0,0 +1,163 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QtMath>
+
+#include "traffic/CollisionRiskEngine.h"
+
+
+auto Traffic::CollisionRiskEngine::mostUrgentWarning(const Positioning::PositionInfo& ownship, const QList<Traffic::TrafficFactor*>& targets) -> Traffic::Warning
+{
+    auto ownCoordinate = ownship.coordinate();
+    if (!ownship.isValid() || !ownCoordinate.isValid()) {
+        return {};
+    }
+
+    // Velocity of the own aircraft
+    auto ownGS = ownship.groundSpeed().toMPS();
+    auto ownTT = ownship.trueTrack();
+    auto ownVS = ownship.verticalSpeed().toMPS();
+    double ownVN = 0.0;
+    double ownVE = 0.0;
+    if (qIsFinite(ownGS) && ownTT.isFinite()) {
+        ownVN = ownGS*qCos(ownTT.toRAD());
+        ownVE = ownGS*qSin(ownTT.toRAD());
+    }
+    if (!qIsFinite(ownVS)) {
+        ownVS = 0.0;
+    }
+
+    // Local frame around the own aircraft
+    const double metersPerDegLat = 6371000.0*M_PI/180.0;
+    const double metersPerDegLon = metersPerDegLat*qCos(qDegreesToRadians(ownCoordinate.latitude()));
+
+    // Fill arrays with relative positions and velocities
+    m_rN.clear();
+    m_rE.clear();
+    m_rU.clear();
+    m_vN.clear();
+    m_vE.clear();
+    m_vU.clear();
+    m_targetIndices.clear();
+    for(int i=0; i<targets.size(); i++) {
+        const auto* target = targets[i];
+        if ((target == nullptr) || !target->valid()) {
+            continue;
+        }
+        auto coordinate = target->extrapolatedCoordinate();
+        if (!coordinate.isValid()) {
+            continue;
+        }
+        auto vDist = target->vDist().toM();
+        if (!qIsFinite(vDist)) {
+            continue;
+        }
+
+        auto GS = target->groundSpeed().toMPS();
+        auto TT = qDegreesToRadians(target->TT());
+        auto VS = target->climbRate().toMPS();
+        if (!qIsFinite(GS) || !qIsFinite(TT)) {
+            GS = 0.0;
+            TT = 0.0;
+        }
+        if (!qIsFinite(VS)) {
+            VS = 0.0;
+        }
+
+        auto deltaLon = coordinate.longitude()-ownCoordinate.longitude();
+        if (deltaLon > 180.0) {
+            deltaLon -= 360.0;
+        }
+        if (deltaLon < -180.0) {
+            deltaLon += 360.0;
+        }
+
+        m_rN.append((coordinate.latitude()-ownCoordinate.latitude())*metersPerDegLat);
+        m_rE.append(deltaLon*metersPerDegLon);
+        m_rU.append(vDist);
+        m_vN.append(GS*qCos(TT)-ownVN);
+        m_vE.append(GS*qSin(TT)-ownVE);
+        m_vU.append(VS-ownVS);
+        m_targetIndices.append(i);
+    }
+    auto size = m_targetIndices.size();
+    if (size == 0) {
+        return {};
+    }
+
+    // Compute time to CPA, clamped to [0, horizonS], and check the protection
+    // volume at that time. This loop is written without branches.
+    m_tcpa.resize(size);
+    m_conflict.resize(size);
+    const double* rN = m_rN.constData();
+    const double* rE = m_rE.constData();
+    const double* rU = m_rU.constData();
+    const double* vN = m_vN.constData();
+    const double* vE = m_vE.constData();
+    const double* vU = m_vU.constData();
+    double* tcpa = m_tcpa.data();
+    int* conflict = m_conflict.data();
+    for(int i=0; i<size; i++) {
+        auto vSquared = vN[i]*vN[i] + vE[i]*vE[i];
+        auto t = -(rN[i]*vN[i] + rE[i]*vE[i])/qMax(vSquared, 1e-6);
+        t = qBound(0.0, t, horizonS);
+        auto dN = rN[i] + t*vN[i];
+        auto dE = rE[i] + t*vE[i];
+        auto dU = rU[i] + t*vU[i];
+        tcpa[i] = t;
+        conflict[i] = static_cast<int>((dN*dN + dE*dE < protectionRadiusM*protectionRadiusM) && (qAbs(dU) < protectionHeightM));
+    }
+
+    // Find the conflict with the shortest time to CPA
+    int best = -1;
+    for(int i=0; i<size; i++) {
+        if ((conflict[i] != 0) && ((best < 0) || (tcpa[i] < tcpa[best]))) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return {};
+    }
+
+    // Construct warning
+    int alarmLevel = 1;
+    if (tcpa[best] <= 12.0) {
+        alarmLevel = 2;
+    }
+    if (tcpa[best] <= 8.0) {
+        alarmLevel = 3;
+    }
+    auto bearing = qRadiansToDegrees(qAtan2(rE[best], rN[best]));
+    if (ownTT.isFinite()) {
+        bearing -= ownTT.toDEG();
+    }
+    while (bearing > 180.0) {
+        bearing -= 360.0;
+    }
+    while (bearing <= -180.0) {
+        bearing += 360.0;
+    }
+    auto hDist = qSqrt(rN[best]*rN[best] + rE[best]*rE[best]);
+    return {alarmLevel,
+                AviationUnits::Angle::fromDEG(bearing),
+                2,
+                AviationUnits::Distance::fromM(rU[best]),
+                AviationUnits::Distance::fromM(hDist)};
+}
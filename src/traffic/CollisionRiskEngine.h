@@ -0,0 +1,97 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QList>
+#include <QVector>
+
+#include "positioning/PositionInfo.h"
+#include "traffic/TrafficFactor.h"
+#include "traffic/Warning.h"
+
+
+namespace Traffic {
+
+/*! \brief Onboard conflict detection
+ *
+ *  This class computes the closest point of approach (CPA) between the own
+ *  aircraft and every traffic factor, assuming that both continue on straight
+ *  lines with constant speed.  If the traffic comes closer than the protection
+ *  distances within the alarm horizon, the class generates a Traffic::Warning,
+ *  with alarm levels as used by FLARM:
+ *
+ *  - 1 = 13-18 seconds to CPA
+ *  - 2 = 9-12 seconds to CPA
+ *  - 3 = 0-8 seconds to CPA
+ *
+ *  This is meant for traffic receivers that report traffic, but do not detect
+ *  conflicts themselves, such as most GDL90 devices.
+ *
+ *  Positions are converted to a local north/east/up frame around the own
+ *  aircraft, which is accurate enough within the range of traffic receivers.
+ *  The data is stored in flat arrays, so that the CPA computation is a single
+ *  loop without branches that the compiler can vectorise.
+ */
+
+class CollisionRiskEngine {
+public:
+    /*! \brief Finds the most urgent conflict
+     *
+     *  @param ownship Position info of the own aircraft. Track, ground speed
+     *  and vertical speed are used if known.
+     *
+     *  @param targets List of traffic factors. Invalid factors and factors
+     *  without valid coordinate are ignored. The extrapolated coordinates are
+     *  used as present positions.
+     *
+     *  @returns Warning for the most urgent conflict, or an invalid warning
+     *  (alarmLevel == -1) if there is no conflict
+     */
+    Traffic::Warning mostUrgentWarning(const Positioning::PositionInfo& ownship, const QList<Traffic::TrafficFactor*>& targets);
+
+    /*! \brief Alarm horizon in seconds */
+    static constexpr double horizonS = 18.0;
+
+    /*! \brief Horizontal protection distance in meters */
+    static constexpr double protectionRadiusM = 300.0;
+
+    /*! \brief Vertical protection distance in meters */
+    static constexpr double protectionHeightM = 150.0;
+
+private:
+    // Relative positions and velocities of the targets, in meters and meters
+    // per second. The vectors are kept between calls to avoid allocations.
+    QVector<double> m_rN;
+    QVector<double> m_rE;
+    QVector<double> m_rU;
+    QVector<double> m_vN;
+    QVector<double> m_vE;
+    QVector<double> m_vU;
+
+    // Results, time to CPA in seconds and a flag for a conflict
+    QVector<double> m_tcpa;
+    QVector<int> m_conflict;
+
+    // Index of the targets in the list passed to mostUrgentWarning
+    QVector<int> m_targetIndices;
+};
+
+};
@@ -0,0 +1,140 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "traffic/GDL90Report.h"
+#include "units/Distance.h"
+#include "units/Speed.h"
+
+static_assert(sizeof(Traffic::GDL90Report) == 32, "GDL90Report is expected to have no padding");
+
+
+Traffic::GDL90Report::GDL90Report(const quint8* payload, int size)
+{
+    // Check message size
+    if (size != 27) {
+        return;
+    }
+
+    statusAndAddressType = payload[0];
+    address = (static_cast<quint32>(payload[1]) << 16U) | (static_cast<quint32>(payload[2]) << 8U) | static_cast<quint32>(payload[3]);
+
+    // Latitude and longitude are 24-bit numbers in two's complement
+    latitude = static_cast<qint32>((static_cast<quint32>(payload[4]) << 16U) | (static_cast<quint32>(payload[5]) << 8U) | payload[6]);
+    if (latitude > 8388607) {
+        latitude -= 16777216;
+    }
+    longitude = static_cast<qint32>((static_cast<quint32>(payload[7]) << 16U) | (static_cast<quint32>(payload[8]) << 8U) | payload[9]);
+    if (longitude > 8388607) {
+        longitude -= 16777216;
+    }
+
+    altitudeCode = static_cast<quint16>((payload[10] << 4U) | (payload[11] >> 4U));
+    miscIndicators = payload[11] & 0x0FU;
+    NACp = payload[12] & 0x0FU;
+    horizontalVelocity = static_cast<quint16>((payload[13] << 4U) | (payload[14] >> 4U));
+    verticalVelocity = static_cast<quint16>(((payload[14] & 0x0FU) << 8U) | payload[15]);
+    track = payload[16];
+    emitterCategory = payload[17];
+    for(std::size_t i=0; i<callSignBytes.size(); i++) {
+        callSignBytes[i] = static_cast<char>(payload[18+i]);
+    }
+
+    m_isValid = coordinate().isValid();
+}
+
+
+auto Traffic::GDL90Report::callSign() const -> QLatin1String
+{
+    int begin = 0;
+    int end = static_cast<int>(callSignBytes.size());
+    while ((begin < end) && ((callSignBytes[begin] == ' ') || (callSignBytes[begin] == '\0'))) {
+        begin++;
+    }
+    while ((end > begin) && ((callSignBytes[end-1] == ' ') || (callSignBytes[end-1] == '\0'))) {
+        end--;
+    }
+    return {callSignBytes.data()+begin, end-begin};
+}
+
+
+auto Traffic::GDL90Report::positionInfo(const QDateTime& timestamp) const -> QGeoPositionInfo
+{
+    if (!m_isValid) {
+        return {};
+    }
+    QGeoPositionInfo pInfo(coordinate(), timestamp);
+
+    // Navigation Accuracy Category for Position
+    switch (NACp) {
+    case 1:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, AviationUnits::Distance::fromNM(10.0).toM() );
+        break;
+    case 2:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, AviationUnits::Distance::fromNM(4.0).toM() );
+        break;
+    case 3:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, AviationUnits::Distance::fromNM(2.0).toM() );
+        break;
+    case 4:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, AviationUnits::Distance::fromNM(1.0).toM() );
+        break;
+    case 5:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, AviationUnits::Distance::fromNM(0.5).toM() );
+        break;
+    case 6:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, AviationUnits::Distance::fromNM(0.3).toM() );
+        break;
+    case 7:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, AviationUnits::Distance::fromNM(0.1).toM() );
+        break;
+    case 8:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, AviationUnits::Distance::fromNM(0.05).toM() );
+        break;
+    case 9:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, 30.0 );
+        break;
+    case 10:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, 10.0 );
+        break;
+    case 11:
+        pInfo.setAttribute(QGeoPositionInfo::HorizontalAccuracy, 3.0 );
+        break;
+    default:
+        break;
+    }
+
+    // Horizontal speed, if available
+    if (horizontalVelocity != 0xFFF) {
+        pInfo.setAttribute(QGeoPositionInfo::GroundSpeed, AviationUnits::Speed::fromKN(horizontalVelocity).toMPS() );
+    }
+
+    // Vertical speed, if available
+    if (verticalVelocity != 0xFFF) {
+        pInfo.setAttribute(QGeoPositionInfo::VerticalSpeed, AviationUnits::Speed::fromFPM(verticalVelocity*64.0).toMPS() );
+    }
+
+    // True track, if available
+    if ((miscIndicators & 0x03U) == 1) {
+        pInfo.setAttribute(QGeoPositionInfo::Direction, track*360.0/256.0 );
+    }
+
+    return pInfo;
+}
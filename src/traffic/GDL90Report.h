@@ -0,0 +1,160 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include <QDateTime>
+#include <QGeoPositionInfo>
+#include <QLatin1String>
+#include <array>
+
+
+namespace Traffic {
+
+/*! \brief Decoded GDL90 ownship or traffic report
+ *
+ *  GDL90 ownship reports (message ID 10) and traffic reports (message ID 20)
+ *  share the same 27-byte layout.  This class decodes such a report directly
+ *  from the bytes of the frame into fixed-size integer fields, in the units
+ *  used by GDL90.  No memory is allocated on the heap, and the frame is not
+ *  referenced after construction.
+ *
+ *  Conversion to Qt types is left to the methods coordinate(),
+ *  positionInfo() and callSign(), so that consumers only pay for the data
+ *  that they actually use.
+ */
+
+class GDL90Report {
+public:
+    /*! \brief Decodes a report
+     *
+     *  @param payload Payload of the message, that is, the bytes between
+     *  message ID and checksum, after escape character decoding
+     *
+     *  @param size Size of the payload, in bytes
+     */
+    GDL90Report(const quint8* payload, int size);
+
+    /*! \brief Validity
+     *
+     *  @returns True if the payload had the correct size and contains a
+     *  valid position
+     */
+    bool isValid() const
+    {
+        return m_isValid;
+    }
+
+    // The fields are ordered by size, so that the structure has no padding
+    // between fields
+
+    /*! \brief Participant address, 24 bits */
+    quint32 address {0};
+
+    /*! \brief Latitude, as a 24-bit signed number in units of 180/2^23 degrees */
+    qint32 latitude {0};
+
+    /*! \brief Longitude, as a 24-bit signed number in units of 180/2^23 degrees */
+    qint32 longitude {0};
+
+    /*! \brief Pressure altitude code, 12 bits, see TrafficDataSource_Abstract::GDLPressureAltitude() */
+    quint16 altitudeCode {0xFFF};
+
+    /*! \brief Horizontal velocity in knots, 12 bits, 0xFFF if unknown */
+    quint16 horizontalVelocity {0xFFF};
+
+    /*! \brief Vertical velocity in units of 64 ft/min, 12 bits, 0xFFF if unknown */
+    quint16 verticalVelocity {0xFFF};
+
+    /*! \brief First byte of the report
+     *
+     *  The upper four bits hold the traffic alert status, the lower four bits
+     *  the address type.  Use the methods alertStatus() and addressType() to
+     *  access them.  The two are kept in one byte, so that the structure
+     *  stays at 32 bytes.
+     */
+    quint8 statusAndAddressType {0};
+
+    /*! \brief Miscellaneous indicators, 4 bits; the lower two bits describe the track */
+    quint8 miscIndicators {0};
+
+    /*! \brief Navigation Accuracy Category for Position, 4 bits */
+    quint8 NACp {0};
+
+    /*! \brief Track, in units of 360/256 degrees */
+    quint8 track {0};
+
+    /*! \brief Emitter category */
+    quint8 emitterCategory {0};
+
+    /*! \brief Call sign, padded with spaces */
+    std::array<char, 8> callSignBytes {};
+
+    /*! \brief Address type
+     *
+     *  @returns Address type, 4 bits; 0 and 2 denote ICAO addresses
+     */
+    quint8 addressType() const
+    {
+        return statusAndAddressType & 0x0FU;
+    }
+
+    /*! \brief Traffic alert status
+     *
+     *  @returns Alert status, 4 bits; 1 if a traffic alert is active
+     */
+    quint8 alertStatus() const
+    {
+        return statusAndAddressType >> 4U;
+    }
+
+    /*! \brief Coordinate of the report
+     *
+     *  @returns Coordinate, without altitude
+     */
+    QGeoCoordinate coordinate() const
+    {
+        return {(180.0/0x800000)*latitude, (180.0/0x800000)*longitude};
+    }
+
+    /*! \brief Call sign, without leading or trailing spaces
+     *
+     *  @returns View into callSignBytes
+     */
+    QLatin1String callSign() const;
+
+    /*! \brief Position info
+     *
+     *  The position info contains coordinate, horizontal accuracy, ground
+     *  speed, vertical speed and direction, as far as they are known.  The
+     *  altitude is not set.
+     *
+     *  @param timestamp Timestamp of the position info
+     *
+     *  @returns Position info
+     */
+    QGeoPositionInfo positionInfo(const QDateTime& timestamp) const;
+
+private:
+    bool m_isValid {false};
+};
+
+}
@@ -0,0 +1,232 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+#include "traffic/NMEASentence.h"
+
+
+Traffic::NMEASentence::NMEASentence(QLatin1String sentence)
+{
+    // Ignore trailing whitespace
+    const char* data = sentence.data();
+    int size = sentence.size();
+    while ((size > 0) && ((data[size-1] == '\r') || (data[size-1] == '\n') || (data[size-1] == ' '))) {
+        size--;
+    }
+
+    // Sentence must start with a dollar sign and end with "*hh"
+    if ((size < 4) || (data[0] != '$') || (data[size-3] != '*')) {
+        return;
+    }
+
+    // Check the NMEA checksum, which is computed over all characters between
+    // the dollar sign and the asterisk
+    bool ok = false;
+    auto checksum = toInt(QLatin1String(data+size-2, 2), &ok, 16);
+    if (!ok) {
+        return;
+    }
+    quint8 myChecksum = 0;
+    for(int i=1; i<size-3; i++) {
+        if (data[i] == '*') {
+            return;
+        }
+        myChecksum ^= static_cast<quint8>(data[i]);
+    }
+    if (checksum != myChecksum) {
+        return;
+    }
+
+    // Split the message into pieces
+    int begin = 1;
+    int end = size-3;
+    bool isType = true;
+    for(int i=begin; i<=end; i++) {
+        if ((i < end) && (data[i] != ',')) {
+            continue;
+        }
+        QLatin1String field(data+begin, i-begin);
+        begin = i+1;
+        if (isType) {
+            m_messageType = field;
+            isType = false;
+            continue;
+        }
+        if (m_size < maxFields) {
+            m_fields[m_size++] = field;
+        }
+    }
+    m_isValid = true;
+}
+
+
+auto Traffic::NMEASentence::toDegrees(QLatin1String field, int degreeDigits, bool* ok) -> double
+{
+    if (ok != nullptr) {
+        *ok = false;
+    }
+
+    const char* data = field.data();
+    int size = field.size();
+    if ((degreeDigits < 1) || (size <= degreeDigits)) {
+        return 0.0;
+    }
+
+    // Degrees
+    int degrees = 0;
+    int i = 0;
+    for(; i < degreeDigits; i++) {
+        if ((data[i] < '0') || (data[i] > '9')) {
+            return 0.0;
+        }
+        degrees = 10*degrees + (data[i]-'0');
+    }
+
+    // Minutes, as a fixed-point number with 'scale' decimals
+    qint64 minutes = 0;
+    qint64 scale = 1;
+    bool hasDigits = false;
+    for(; (i < size) && (data[i] >= '0') && (data[i] <= '9'); i++) {
+        if (minutes > 999999) {
+            return 0.0;
+        }
+        minutes = 10*minutes + (data[i]-'0');
+        hasDigits = true;
+    }
+    if ((i < size) && (data[i] == '.')) {
+        i++;
+        for(; (i < size) && (data[i] >= '0') && (data[i] <= '9'); i++) {
+            if (scale < 1000000000) {
+                minutes = 10*minutes + (data[i]-'0');
+                scale *= 10;
+            }
+            hasDigits = true;
+        }
+    }
+    if (!hasDigits || (i != size)) {
+        return 0.0;
+    }
+
+    if (ok != nullptr) {
+        *ok = true;
+    }
+    return degrees + static_cast<double>(minutes)/static_cast<double>(60*scale);
+}
+
+
+auto Traffic::NMEASentence::toDouble(QLatin1String field, bool* ok) -> double
+{
+    if (ok != nullptr) {
+        *ok = false;
+    }
+
+    const char* data = field.data();
+    int size = field.size();
+    int i = 0;
+
+    bool isNegative = false;
+    if ((i < size) && ((data[i] == '-') || (data[i] == '+'))) {
+        isNegative = (data[i] == '-');
+        i++;
+    }
+
+    // Collect the digits into an integer mantissa, and keep track of the
+    // decimal exponent
+    quint64 mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    for(; (i < size) && (data[i] >= '0') && (data[i] <= '9'); i++) {
+        hasDigits = true;
+        if (significantDigits < maxSignificantDigits) {
+            mantissa = 10*mantissa + static_cast<quint64>(data[i]-'0');
+            if (mantissa != 0) {
+                significantDigits++;
+            }
+        } else {
+            exponent++;
+        }
+    }
+    if ((i < size) && (data[i] == '.')) {
+        i++;
+        for(; (i < size) && (data[i] >= '0') && (data[i] <= '9'); i++) {
+            hasDigits = true;
+            if (significantDigits < maxSignificantDigits) {
+                mantissa = 10*mantissa + static_cast<quint64>(data[i]-'0');
+                if (mantissa != 0) {
+                    significantDigits++;
+                }
+                exponent--;
+            }
+        }
+    }
+    if (!hasDigits || (i != size)) {
+        return 0.0;
+    }
+
+    // Scale the mantissa. If mantissa and power of ten are both exactly
+    // representable as doubles, the result is correctly rounded.
+    auto result = static_cast<double>(mantissa);
+    if ((exponent < 0) && (-exponent < static_cast<int>(powersOfTen.size()))) {
+        result /= powersOfTen[-exponent];
+    } else if ((exponent > 0) && (exponent < static_cast<int>(powersOfTen.size()))) {
+        result *= powersOfTen[exponent];
+    } else if (exponent != 0) {
+        result *= std::pow(10.0, exponent);
+    }
+
+    if (ok != nullptr) {
+        *ok = true;
+    }
+    return isNegative ? -result : result;
+}
+
+
+auto Traffic::NMEASentence::toInt(QLatin1String field, bool* ok, int base) -> int
+{
+    if (ok != nullptr) {
+        *ok = false;
+    }
+
+    const char* data = field.data();
+    const char* end = data+field.size();
+
+    bool isNegative = false;
+    if ((data < end) && ((*data == '-') || (*data == '+'))) {
+        isNegative = (*data == '-');
+        data++;
+    }
+
+    // std::from_chars accepts neither signs nor whitespace for unsigned
+    // numbers, and detects overflow
+    unsigned int result = 0;
+    auto [pointer, error] = std::from_chars(data, end, result, base);
+    if ((error != std::errc()) || (pointer != end) || (data == end) || (result > static_cast<unsigned int>(std::numeric_limits<int>::max()))) {
+        return 0;
+    }
+
+    if (ok != nullptr) {
+        *ok = true;
+    }
+    return isNegative ? -static_cast<int>(result) : static_cast<int>(result);
+}
@@ -0,0 +1,247 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QLatin1String>
+#include <array>
+
+
+namespace Traffic {
+
+/*! \brief Zero-copy tokenizer for FLARM/NMEA sentences
+ *
+ *  This class splits a FLARM/NMEA sentence such as
+ *  "$PFLAA,0,1587,1588,40,1,AA1237,225,,37,-1.6,1*7F" into its message type
+ *  and its comma-separated fields, and verifies the checksum.  The fields are
+ *  views into the original sentence; no data is copied and no memory is
+ *  allocated on the heap.  The caller must therefore ensure that the data
+ *  remains valid for as long as the instance is used.
+ *
+ *  The methods toDouble(), toDegrees() and toInt() convert fields to numbers,
+ *  again without allocating memory.  Unlike QString::toDouble() and
+ *  QString::toInt(), they work on the Latin-1 data directly and ignore the
+ *  locale.
+ */
+
+class NMEASentence {
+public:
+    /*! \brief Tokenizes a sentence
+     *
+     *  @param sentence FLARM/NMEA sentence, starting with '$' and ending with
+     *  the checksum.  Trailing whitespace is ignored.
+     */
+    explicit NMEASentence(QLatin1String sentence);
+
+    /*! \brief Validity
+     *
+     *  @returns True if the sentence is well-formed and the checksum is
+     *  correct
+     */
+    bool isValid() const
+    {
+        return m_isValid;
+    }
+
+    /*! \brief Message type
+     *
+     *  @returns Message type, such as "PFLAA", or an empty string if the
+     *  sentence is invalid
+     */
+    QLatin1String messageType() const
+    {
+        return m_messageType;
+    }
+
+    /*! \brief Number of fields
+     *
+     *  @returns Number of fields following the message type
+     */
+    int size() const
+    {
+        return m_size;
+    }
+
+    /*! \brief Field
+     *
+     *  @param index Index of the field, where 0 is the first field following
+     *  the message type
+     *
+     *  @returns Field, or an empty string if no field with the given index
+     *  exists
+     */
+    QLatin1String operator[](int index) const
+    {
+        if ((index < 0) || (index >= m_size)) {
+            return {};
+        }
+        return m_fields[index];
+    }
+
+    /*! \brief Numerical code for a message type
+     *
+     *  Message types consist of at most eight characters.  This method maps
+     *  each such message type to a unique number, so that code can dispatch
+     *  on message types using a switch statement.
+     *
+     *  @param type Message type
+     *
+     *  @param size Length of the message type
+     *
+     *  @returns Numerical code, or 0 if the message type is too long
+     */
+    static constexpr quint64 typeCode(const char* type, int size)
+    {
+        if (size > 8) {
+            return 0;
+        }
+        quint64 result = 0;
+        for(int i=0; i<size; i++) {
+            result = (result << 8U) | static_cast<quint8>(type[i]);
+        }
+        return result;
+    }
+
+    /*! \brief Numerical code for a message type
+     *
+     *  This is an overloaded method, for use with string literals in case
+     *  labels.
+     *
+     *  @param type Message type
+     *
+     *  @returns Numerical code
+     */
+    template<int N>
+    static constexpr quint64 typeCode(const char (&type)[N])
+    {
+        return typeCode(type, N-1);
+    }
+
+    /*! \brief Numerical code for a message type
+     *
+     *  This is an overloaded method, for use with messageType().
+     *
+     *  @param type Message type
+     *
+     *  @returns Numerical code
+     */
+    static quint64 typeCode(QLatin1String type)
+    {
+        return typeCode(type.data(), type.size());
+    }
+
+    /*! \brief Substring of a field
+     *
+     *  Unlike QLatin1String::mid(), this method accepts positions and lengths
+     *  beyond the end of the field.
+     *
+     *  @param field Field
+     *
+     *  @param position Position of the first character
+     *
+     *  @param length Maximal length of the substring, or -1 for all characters
+     *  up to the end of the field
+     *
+     *  @returns Substring, possibly empty
+     */
+    static QLatin1String mid(QLatin1String field, int position, int length = -1)
+    {
+        if ((position < 0) || (position >= field.size())) {
+            return {};
+        }
+        auto available = field.size()-position;
+        if ((length < 0) || (length > available)) {
+            length = available;
+        }
+        return {field.data()+position, length};
+    }
+
+    /*! \brief Converts a field to a floating point number
+     *
+     *  This method accepts decimal numbers with optional sign and optional
+     *  fractional part, such as "-1.6", in the C locale.  Digits are collected
+     *  into an integer mantissa, which is then scaled by an exact power of
+     *  ten.  For numbers with up to 15 significant digits, which covers
+     *  everything that traffic receivers send, the result is correctly
+     *  rounded.  Digits beyond the 19th significant digit are ignored.
+     *
+     *  @param field Field
+     *
+     *  @param ok If not nullptr, this is set to true on success and to false
+     *  otherwise
+     *
+     *  @returns Number, or 0.0 on failure
+     */
+    static double toDouble(QLatin1String field, bool* ok = nullptr);
+
+    /*! \brief Converts an NMEA latitude or longitude to degrees
+     *
+     *  NMEA sentences give latitudes in the form "ddmm.mmmm" and longitudes in
+     *  the form "dddmm.mmmm", where "d" are degrees and "m" are minutes.  This
+     *  method decodes the field in fixed-point arithmetic and performs a
+     *  single floating-point division.  The hemisphere is not part of the
+     *  field and must be handled by the caller.
+     *
+     *  @param field Field
+     *
+     *  @param degreeDigits Number of digits used for the degrees, typically 2
+     *  for latitudes and 3 for longitudes
+     *
+     *  @param ok If not nullptr, this is set to true on success and to false
+     *  otherwise
+     *
+     *  @returns Angle in degrees, or 0.0 on failure
+     */
+    static double toDegrees(QLatin1String field, int degreeDigits, bool* ok = nullptr);
+
+    /*! \brief Converts a field to an integer
+     *
+     *  This method uses std::from_chars and accepts an optional sign.
+     *
+     *  @param field Field
+     *
+     *  @param ok If not nullptr, this is set to true on success and to false
+     *  otherwise
+     *
+     *  @param base Base, either 10 or 16
+     *
+     *  @returns Number, or 0 on failure
+     */
+    static int toInt(QLatin1String field, bool* ok = nullptr, int base = 10);
+
+private:
+    // Maximal number of fields.  Additional fields are ignored.
+    static constexpr int maxFields = 24;
+
+    // Maximal number of significant digits used by toDouble().  With 19
+    // digits, the mantissa cannot overflow a quint64.
+    static constexpr int maxSignificantDigits = 19;
+
+    // Powers of ten that are exactly representable as doubles
+    static constexpr std::array<double, 23> powersOfTen {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    std::array<QLatin1String, maxFields> m_fields {};
+    QLatin1String m_messageType;
+    int m_size {0};
+    bool m_isValid {false};
+};
+
+};
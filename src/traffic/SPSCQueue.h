@@ -0,0 +1,124 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+
+
+namespace Traffic {
+
+/*! \brief Lock-free single-producer, single-consumer queue
+ *
+ *  This is a ring buffer of fixed capacity, meant to pass data from one
+ *  producer thread to one consumer thread without locks and without
+ *  allocating memory.  The methods push() and requestNotification() must only
+ *  be called from the producer thread, the methods pop() and
+ *  clearNotification() only from the consumer thread.
+ *
+ *  To avoid polling, the queue implements a simple wake-up protocol. After
+ *  pushing data, the producer calls requestNotification() and wakes the
+ *  consumer (for instance, by emitting a signal through a queued connection)
+ *  if the method returns true. The consumer calls clearNotification() before
+ *  it pops all data. This guarantees that no data is left in the queue
+ *  unnoticed, while the consumer is woken at most once per batch.
+ *
+ *  @tparam T Type of the elements. Elements are moved in and out of the
+ *  queue, and slots are default-constructed.
+ *
+ *  @tparam capacity Capacity of the queue, must be a power of two
+ */
+
+template<typename T, int capacity>
+class SPSCQueue {
+    static_assert((capacity > 0) && ((capacity & (capacity-1)) == 0), "capacity must be a power of two");
+
+public:
+    /*! \brief Adds an element at the end of the queue
+     *
+     *  @param value Element
+     *
+     *  @returns False if the queue is full. In that case, the element is not
+     *  added.
+     */
+    bool push(T&& value)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == static_cast<quint32>(capacity)) {
+            return false;
+        }
+        m_buffer[head & mask] = std::move(value);
+        m_head.store(head+1, std::memory_order_release);
+        return true;
+    }
+
+    /*! \brief Removes the first element from the queue
+     *
+     *  @param value If the queue is not empty, the first element is moved
+     *  here
+     *
+     *  @returns False if the queue is empty
+     */
+    bool pop(T& value)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(m_buffer[tail & mask]);
+        m_tail.store(tail+1, std::memory_order_release);
+        return true;
+    }
+
+    /*! \brief Check if the consumer needs to be woken up
+     *
+     *  @returns True if the consumer has not been notified since its last
+     *  call to clearNotification()
+     */
+    bool requestNotification()
+    {
+        return !m_notified.exchange(true, std::memory_order_acq_rel);
+    }
+
+    /*! \brief Marks all notifications as handled
+     *
+     *  The consumer must call this method before it pops the data.
+     */
+    void clearNotification()
+    {
+        // This is a read-modify-write operation, so that all data pushed
+        // before the last notification request is visible to the consumer
+        m_notified.exchange(false, std::memory_order_acq_rel);
+    }
+
+private:
+    static constexpr quint32 mask = capacity-1;
+
+    // Head and tail are kept on separate cache lines, so that producer and
+    // consumer do not compete for the same line
+    alignas(64) std::atomic<quint32> m_head {0};
+    alignas(64) std::atomic<quint32> m_tail {0};
+    alignas(64) std::atomic<bool> m_notified {false};
+    std::array<T, capacity> m_buffer {};
+};
+
+};
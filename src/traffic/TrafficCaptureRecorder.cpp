@@ -0,0 +1,104 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QtEndian>
+#include <array>
+
+#include "traffic/TrafficCaptureRecorder.h"
+
+
+Traffic::TrafficCaptureRecorder::TrafficCaptureRecorder(const QString& fileName, QObject *parent)
+    : QObject(parent), m_fileName(fileName), m_file(fileName)
+{
+    m_pendingFrames.reserve(64*1024);
+    m_writeBuffer.reserve(64*1024);
+
+    if (!m_file.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        return;
+    }
+    if (m_file.write(magic, sizeof magic) != sizeof magic) {
+        m_file.close();
+        return;
+    }
+    m_isOpen = true;
+
+    m_writerThread.setObjectName(QStringLiteral("TrafficCaptureRecorder"));
+    m_file.moveToThread(&m_writerThread);
+    m_writerThread.start(QThread::LowPriority);
+}
+
+
+Traffic::TrafficCaptureRecorder::~TrafficCaptureRecorder()
+{
+    m_writerThread.quit();
+    m_writerThread.wait();
+
+    // The writer thread has finished, so the file can be accessed from here
+    if (m_isOpen) {
+        writePendingFrames();
+        m_file.close();
+    }
+}
+
+
+void Traffic::TrafficCaptureRecorder::record(FrameType type, const char* data, int size)
+{
+    if (!m_isOpen || (size < 0)) {
+        return;
+    }
+
+    std::array<char, frameHeaderSize> header {};
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header.data());
+    header[8] = static_cast<char>(type);
+    qToLittleEndian<quint32>(static_cast<quint32>(size), header.data()+9);
+
+    bool wasEmpty = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_pendingFrames.size() + frameHeaderSize + size > maxPendingBytes) {
+            return;
+        }
+        wasEmpty = m_pendingFrames.isEmpty();
+        m_pendingFrames.append(header.data(), frameHeaderSize);
+        m_pendingFrames.append(data, size);
+    }
+
+    // Wake up the writer thread. If the buffer was not empty, this has
+    // already been done.
+    if (wasEmpty) {
+        QMetaObject::invokeMethod(&m_file, [this]() { writePendingFrames(); }, Qt::QueuedConnection);
+    }
+}
+
+
+void Traffic::TrafficCaptureRecorder::writePendingFrames()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_pendingFrames.swap(m_writeBuffer);
+    }
+    if (!m_writeBuffer.isEmpty()) {
+        m_file.write(m_writeBuffer);
+        m_file.flush();
+    }
+    m_writeBuffer.resize(0);
+}
@@ -0,0 +1,142 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+
+
+namespace Traffic {
+
+/*! \brief Recorder for the raw data received from traffic receivers
+ *
+ *  This class writes the data received by the traffic data sources to a
+ *  capture file, which can later be replayed with TrafficDataSource_File.
+ *  Capture files have the following binary format, with all numbers in
+ *  little-endian byte order.
+ *
+ *  - The file starts with the eight bytes of 'magic'.
+ *
+ *  - A sequence of frames follows. Each frame consists of an eight-byte time
+ *    stamp (qint64, milliseconds since the epoch), a one-byte FrameType, a
+ *    four-byte payload length (quint32) and the payload. The payload is the
+ *    data as passed to TrafficDataSource_Abstract::processFLARMSentence(),
+ *    processGDLMessage() or processXGPSString().
+ *
+ *  The method record() is cheap: it copies the frame into a buffer that is
+ *  kept between calls, so that no memory is allocated in the common case.
+ *  The buffer is written to the file by a separate writer thread.
+ */
+
+class TrafficCaptureRecorder : public QObject {
+    Q_OBJECT
+
+public:
+    /*! \brief Type of the data in a frame */
+    enum FrameType : quint8 {
+        FLARM = 1, /*!< \brief FLARM/NMEA sentence */
+        GDL90 = 2, /*!< \brief GDL90 message, escaped, without the 0x7e flag bytes */
+        XGPS = 3 /*!< \brief XGPS/XTRAFFIC string */
+    };
+
+    /*! \brief Magic bytes at the beginning of every capture file */
+    static constexpr char magic[8] = {'E', 'N', 'R', 'T', 'C', 'A', 'P', '1'};
+
+    /*! \brief Size of the frame header, in bytes */
+    static constexpr int frameHeaderSize = 13;
+
+    /*! \brief Default constructor
+     *
+     *  Creates the capture file and writes the magic bytes. Use isOpen() to
+     *  check if this was successful.
+     *
+     *  @param fileName Name of the capture file. Existing files will be
+     *  overwritten.
+     *
+     *  @param parent The standard QObject parent pointer
+     */
+    explicit TrafficCaptureRecorder(const QString& fileName, QObject *parent = nullptr);
+
+    /*! \brief Destructor
+     *
+     *  Writes all pending frames, closes the file and stops the writer thread.
+     */
+    ~TrafficCaptureRecorder() override;
+
+    /*! \brief Name of the capture file
+     *
+     *  @returns Name of the capture file
+     */
+    QString fileName() const
+    {
+        return m_fileName;
+    }
+
+    /*! \brief Check if the capture file could be created
+     *
+     *  @returns True if the capture file is open for writing
+     */
+    bool isOpen() const
+    {
+        return m_isOpen;
+    }
+
+    /*! \brief Records one frame
+     *
+     *  This method is thread-safe. If the writer thread cannot keep up, and
+     *  more than maxPendingBytes are waiting to be written, the frame is
+     *  silently dropped.
+     *
+     *  @param type Type of the data
+     *
+     *  @param data Pointer to the data
+     *
+     *  @param size Size of the data, in bytes
+     */
+    void record(FrameType type, const char* data, int size);
+
+private:
+    Q_DISABLE_COPY_MOVE(TrafficCaptureRecorder)
+
+    // Writes all pending frames to the file. This method runs in the writer
+    // thread.
+    void writePendingFrames();
+
+    // Maximal size of the pending data, in bytes
+    static constexpr int maxPendingBytes = 16*1024*1024;
+
+    QString m_fileName;
+    bool m_isOpen {false};
+
+    // The file is owned by the writer thread, and only accessed from there
+    // while the thread is running
+    QFile m_file;
+    QThread m_writerThread;
+
+    // Frames that have not yet been written. The writer thread swaps the
+    // buffers, so that both keep their capacity.
+    QMutex m_mutex;
+    QByteArray m_pendingFrames;
+    QByteArray m_writeBuffer;
+};
+
+};
@@ -19,10 +19,17 @@
  ***************************************************************************/
 
 #include <QQmlEngine>
+#include <QRandomGenerator>
+#include <algorithm>
 #include <chrono>
+#include <numeric>
 
+#include "Clock.h"
 #include "Global.h"
 #include "MobileAdaptor.h"
+#include "Settings.h"
+#include "StartupTracer.h"
+#include "positioning/PositionProvider.h"
 #include "traffic/TrafficDataProvider.h"
 #include "traffic/TrafficDataSource_File.h"
 #include "traffic/TrafficDataSource_Tcp.h"
@@ -36,80 +43,184 @@ using namespace std::chrono_literals;
 Traffic::TrafficDataProvider::TrafficDataProvider(QObject *parent) : Positioning::PositionInfoSource_Abstract(parent) {
 
     // Create traffic objects
-    int numTrafficObjects = 20;
-    m_trafficObjects.reserve(numTrafficObjects);
-    for(int i = 0; i<numTrafficObjects; i++) {
-        auto *trafficObject = new Traffic::TrafficFactor(this);
-        QQmlEngine::setObjectOwnership(trafficObject, QQmlEngine::CppOwnership);
-        m_trafficObjects.append( trafficObject );
-    }
+    setTrafficCapacity(50);
     m_trafficObjectWithoutPosition = new Traffic::TrafficFactor(this);
+    m_trafficObjectWithoutPosition->setBatchUpdates(true);
     QQmlEngine::setObjectOwnership(m_trafficObjectWithoutPosition, QQmlEngine::CppOwnership);
 
+    // Setup batch updates of traffic objects, once per frame
+    m_flushTimer.setInterval(16ms);
+    m_flushTimer.setSingleShot(true);
+    connect(&m_flushTimer, &QTimer::timeout, this, &Traffic::TrafficDataProvider::flushTrafficObjects);
+
+    // Setup dead reckoning, at 25 frames per second
+    m_extrapolationTimer.setInterval(40ms);
+    connect(&m_extrapolationTimer, &QTimer::timeout, this, &Traffic::TrafficDataProvider::extrapolateTrafficObjects);
+
     setSourceName(tr("Traffic data receiver"));
 
     // Setup FLARM warning
+    m_fusionClock.start();
     m_WarningTimer.setInterval( Positioning::PositionInfo::lifetime );
     m_WarningTimer.setSingleShot(true);
     connect(&m_WarningTimer, &QTimer::timeout, this, &Traffic::TrafficDataProvider::resetWarning);
 
     // Setup ForeFlight Broadcases
-    foreFlightBroadcastTimer.setInterval(5s);
+    foreFlightBroadcastTimer.setSingleShot(true);
     connect(&foreFlightBroadcastTimer, &QTimer::timeout, this, &Traffic::TrafficDataProvider::foreFlightBroadcast);
-    foreFlightBroadcastTimer.start();
+    foreFlightBroadcastTimer.start(minForeFlightBroadcastIntervalMS);
 
-    // Real data sources in order of preference, preferred sources first
-    addDataSource( new Traffic::TrafficDataSource_Tcp("192.168.1.1", 2000, this));
-    addDataSource( new Traffic::TrafficDataSource_Tcp("192.168.10.1", 2000, this) );
-    addDataSource( new Traffic::TrafficDataSource_Udp(4000, this) );
-    addDataSource( new Traffic::TrafficDataSource_Udp(49002, this));
+    // Setup ingest thread. Traffic reports are collected once per frame.
+    m_ingestFactor.setBatchUpdates(true);
+    m_ingestTimer.setInterval(16ms);
+    m_ingestTimer.setSingleShot(true);
+    connect(&m_ingestTimer, &QTimer::timeout, this, &Traffic::TrafficDataProvider::processIngestQueues);
+    m_ingestThread.setObjectName(QStringLiteral("Traffic ingest"));
 
-    // Bindings for status string
-    connect(this, &Traffic::TrafficDataProvider::positionInfoChanged, this, &Traffic::TrafficDataProvider::updateStatusString);
-    connect(this, &Traffic::TrafficDataProvider::pressureAltitudeChanged, this, &Traffic::TrafficDataProvider::updateStatusString);
+    // Real data sources are created in deferredInitialization(), from the
+    // setting trafficDataSources
+    m_ingestThread.start();
+
+    // Bindings for status string. The string changes only when data starts
+    // or stops arriving, not with every new fix.
+    connect(this, &Traffic::TrafficDataProvider::receivingPositionInfoChanged, this, &Traffic::TrafficDataProvider::updateStatusString);
+    connect(this, &Traffic::TrafficDataProvider::receivingPressureAltitudeChanged, this, &Traffic::TrafficDataProvider::updateStatusString);
     connect(this, &Traffic::TrafficDataProvider::receivingHeartbeatChanged, this, &Traffic::TrafficDataProvider::updateStatusString);
 
-    // Connect timer. Try to (re)connect after 2s, and then again every five minutes.
-    QTimer::singleShot(2s, this, &Traffic::TrafficDataProvider::connectToTrafficReceiver);
-    connect(&reconnectionTimer, &QTimer::timeout, this, &Traffic::TrafficDataProvider::connectToTrafficReceiver);
-    reconnectionTimer.setInterval(5min);
-    reconnectionTimer.setSingleShot(false);
-    reconnectionTimer.start();
+    // Probe timer. The first probe takes place after 2s, and uses the source
+    // that last worked in the present Wi-Fi network.
+    m_probeTimer.setSingleShot(true);
+    connect(&m_probeTimer, &Scheduler::Timer::timeout, this, &Traffic::TrafficDataProvider::probeTrafficReceivers);
+    m_probePreferredSource = true;
+    m_probeTimer.start(2s);
 
     // Try to (re)connect whenever the network situation changes
     QTimer::singleShot(0, this, &Traffic::TrafficDataProvider::deferredInitialization);
 }
 
 
+Traffic::TrafficDataProvider::~TrafficDataProvider()
+{
+    m_ingestThread.quit();
+    m_ingestThread.wait();
+}
+
+
 void Traffic::TrafficDataProvider::addDataSource(Traffic::TrafficDataSource_Abstract* source)
 {
     Q_ASSERT( source != nullptr );
 
-    source->setParent(this);
+    if (source->thread() == thread()) {
+        source->setParent(this);
+    }
     m_dataSources << source;
+
+    // Keep a copy of the source's properties. These connections must be set
+    // up before all others, so that the copy is up to date when the other
+    // slots are called. Since m_dataSources can be reordered, the index of
+    // the source is looked up whenever a property changes.
+    m_dataSourceStates.append({{}, source->sourceName(), source->connectivityStatus(), source->errorString(), source->receivingHeartbeat()});
+    connect(source, &Traffic::TrafficDataSource_Abstract::connectivityStatusChanged, this, [this, source](const QString& newStatus) {
+        auto index = sourcePriority(source);
+        if (index < m_dataSourceStates.size()) {
+            m_dataSourceStates[index].connectivityStatus = newStatus;
+        }
+    });
+    connect(source, &Traffic::TrafficDataSource_Abstract::errorStringChanged, this, [this, source](const QString& newError) {
+        auto index = sourcePriority(source);
+        if (index < m_dataSourceStates.size()) {
+            m_dataSourceStates[index].errorString = newError;
+        }
+    });
+    connect(source, &Traffic::TrafficDataSource_Abstract::receivingHeartbeatChanged, this, [this, source](bool newReceivingHeartbeat) {
+        auto index = sourcePriority(source);
+        if (index < m_dataSourceStates.size()) {
+            m_dataSourceStates[index].receivingHeartbeat = newReceivingHeartbeat;
+        }
+    });
+
     connect(source, &Traffic::TrafficDataSource_Abstract::connectivityStatusChanged, this, &Traffic::TrafficDataProvider::updateStatusString);
     connect(source, &Traffic::TrafficDataSource_Abstract::errorStringChanged, this, &Traffic::TrafficDataProvider::updateStatusString);
     connect(source, &Traffic::TrafficDataSource_Abstract::receivingHeartbeatChanged, this, &Traffic::TrafficDataProvider::updateStatusString);
     connect(source, &Traffic::TrafficDataSource_Abstract::receivingHeartbeatChanged, this, &Traffic::TrafficDataProvider::onSourceHeartbeatChanged);
+    connect(source, &Traffic::TrafficDataSource_Abstract::factorWithoutPosition, this, &Traffic::TrafficDataProvider::onTrafficFactorWithoutPosition);
+    connect(source, &Traffic::TrafficDataSource_Abstract::factorWithPosition, this, &Traffic::TrafficDataProvider::onTrafficFactorWithPosition);
+    connect(source, &Traffic::TrafficDataSource_Abstract::warning, this, &Traffic::TrafficDataProvider::onSourceWarning);
+    connect(source, &Traffic::TrafficDataSource_Abstract::trafficReportsAvailable, this, &Traffic::TrafficDataProvider::onTrafficReportsAvailable);
+    source->setCaptureRecorder(m_captureRecorder);
+
+}
+
+
+void Traffic::TrafficDataProvider::addIngestDataSource(Traffic::TrafficDataSource_Abstract* source, const QString& descriptor)
+{
+    Q_ASSERT( source != nullptr );
 
+    source->enableIngestQueue();
+    source->moveToThread(&m_ingestThread);
+    connect(&m_ingestThread, &QThread::finished, source, &QObject::deleteLater);
+    addDataSource(source);
+    m_dataSourceStates.last().descriptor = descriptor;
 }
 
 
 void Traffic::TrafficDataProvider::connectToTrafficReceiver()
 {
-    foreach(auto dataSource, m_dataSources) {
-        if (dataSource.isNull()) {
-            continue;
+    restartProbing();
+}
+
+
+auto Traffic::TrafficDataProvider::createDataSource(const QString& descriptor) -> Traffic::TrafficDataSource_Abstract*
+{
+    // Descriptors are of the form "tcp:host:port" or "udp:port". The port is
+    // taken from the end, so that IPv6 addresses can be used as host names.
+    auto scheme = descriptor.section(':', 0, 0).toLower();
+    bool ok = false;
+    auto port = descriptor.section(':', -1).toUShort(&ok);
+    if (!ok || (port == 0)) {
+        return nullptr;
+    }
+
+    if (scheme == u"tcp") {
+        auto hostName = descriptor.section(':', 1, -2);
+        if (hostName.startsWith('[') && hostName.endsWith(']')) {
+            hostName = hostName.mid(1, hostName.size()-2);
         }
-        dataSource->connectToTrafficReceiver();
+        if (hostName.isEmpty()) {
+            return nullptr;
+        }
+        return new Traffic::TrafficDataSource_Tcp(hostName, port);
+    }
+    if ((scheme == u"udp") && (descriptor.count(':') == 1)) {
+        return new Traffic::TrafficDataSource_Udp(port);
     }
+    return nullptr;
 }
 
 
-void Traffic::TrafficDataProvider::deferredInitialization() const
+void Traffic::TrafficDataProvider::deferredInitialization()
 {
+    StartupTracer::Phase phase("TrafficDataProvider initialization");
+
+    // Create data sources, and follow changes of the setting
+    connect(Global::settings(), &Settings::trafficDataSourcesChanged, this, &Traffic::TrafficDataProvider::updateDataSources);
+    updateDataSources();
+
     // Try to (re)connect whenever the network situation changes
-    connect(Global::mobileAdaptor(), &MobileAdaptor::wifiConnected, this, &Traffic::TrafficDataProvider::connectToTrafficReceiver);
+    connect(Global::mobileAdaptor(), &MobileAdaptor::wifiConnected, this, [this]() { restartProbing(true); });
+
+    // Follow the setting for traffic data fusion
+    connect(Global::settings(), &Settings::trafficDataFusionChanged, this, &Traffic::TrafficDataProvider::updateTrafficDataFusion);
+    updateTrafficDataFusion();
+
+    // Provide the position of the own aircraft to the sources in the ingest
+    // thread
+    auto* positionProvider = Positioning::PositionProvider::globalInstance();
+    auto updateOwnshipPosition = [positionProvider]() {
+        Traffic::TrafficDataSource_Abstract::setOwnshipPosition(positionProvider->positionInfo(), Positioning::PositionProvider::lastValidCoordinate());
+    };
+    connect(positionProvider, &Positioning::PositionProvider::positionInfoChanged, this, updateOwnshipPosition);
+    updateOwnshipPosition();
 }
 
 
@@ -119,14 +230,84 @@ void Traffic::TrafficDataProvider::disconnectFromTrafficReceiver()
         if (dataSource.isNull()) {
             continue;
         }
-        dataSource->disconnectFromTrafficReceiver();
+        auto* source = dataSource.data();
+        QMetaObject::invokeMethod(source, [source]() { source->disconnectFromTrafficReceiver(); });
+    }
+}
+
+
+void Traffic::TrafficDataProvider::extrapolateTrafficObjects()
+{
+    if (m_heap.isEmpty()) {
+        m_extrapolationTimer.stop();
+        return;
+    }
+
+    auto now = Clock::currentDateTimeUtc();
+    foreach(auto slot, m_heap) {
+        m_trafficObjects[slot]->extrapolate(now);
+    }
+    m_flushTimer.stop();
+    flushTrafficObjects();
+
+    // Run conflict detection on the extrapolated positions
+    if (!m_collisionRiskClock.isValid() || (m_collisionRiskClock.elapsed() >= collisionRiskIntervalMS)) {
+        m_collisionRiskClock.start();
+        auto warning = m_collisionRiskEngine.mostUrgentWarning(Positioning::PositionProvider::globalInstance()->positionInfo(), m_trafficObjects);
+        if (warning.alarmLevel() > qMax(0, m_Warning.alarmLevel())) {
+            setWarning(warning);
+        }
     }
 }
 
 
+void Traffic::TrafficDataProvider::flushTrafficObjects()
+{
+    foreach(auto trafficObject, m_trafficObjects) {
+        trafficObject->flushChanges();
+    }
+    if (!m_trafficObjectWithoutPosition.isNull()) {
+        m_trafficObjectWithoutPosition->flushChanges();
+    }
+    emit trafficObjectsChanged();
+}
+
+
 void Traffic::TrafficDataProvider::foreFlightBroadcast()
 {
+    // If the broadcast is not needed, pause. The broadcast is resumed by
+    // updateForeFlightBroadcast().
+    if (!foreFlightBroadcastNeeded()) {
+        return;
+    }
+
     foreFlightBroadcastSocket.writeDatagram(foreFlightBroadcastDatagram);
+    foreFlightBroadcastTimer.start( jittered(m_foreFlightBroadcastIntervalMS) );
+    m_foreFlightBroadcastIntervalMS = qMin(2*m_foreFlightBroadcastIntervalMS, maxForeFlightBroadcastIntervalMS);
+}
+
+
+auto Traffic::TrafficDataProvider::foreFlightBroadcastNeeded() const -> bool
+{
+    // Only UDP receivers react to the broadcast. Having a current source, or
+    // a UDP source that is not receiving heartbeats, is not enough.
+    for(int i=0; i<m_dataSources.size(); i++) {
+        if ((qobject_cast<Traffic::TrafficDataSource_Udp*>(m_dataSources[i]) != nullptr) && m_dataSourceStates[i].receivingHeartbeat) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+auto Traffic::TrafficDataProvider::memoryUsage() const -> qint64
+{
+    qint64 result = sizeof(*this);
+    result += m_trafficObjects.size()*static_cast<qint64>(sizeof(Traffic::TrafficFactor));
+    result += m_dataSources.size()*static_cast<qint64>(sizeof(Traffic::TrafficDataSource_Abstract));
+    result += m_slotsByID.size()*static_cast<qint64>(sizeof(quint32)+sizeof(int));
+    result += (m_freeSlots.size()+m_heap.size()+m_heapPositions.size())*static_cast<qint64>(sizeof(int));
+    return result;
 }
 
 
@@ -134,7 +315,7 @@ void Traffic::TrafficDataProvider::onSourceHeartbeatChanged()
 {
     // If we have a current source, if the current source has a heartbeat and if the current source is a TCP source, then we simply stick with it.
     if ((qobject_cast<Traffic::TrafficDataSource_Tcp*>(m_currentSource) != nullptr)
-            && m_currentSource->receivingHeartbeat() ) {
+            && sourceReceivingHeartbeat(m_currentSource) ) {
         emit setReceivingHeartbeat(true);
         return;
     }
@@ -146,7 +327,7 @@ void Traffic::TrafficDataProvider::onSourceHeartbeatChanged()
             continue;
         }
 
-        if (source->receivingHeartbeat()) {
+        if (sourceReceivingHeartbeat(source)) {
             heartbeatDataSource = source;
             break;
         }
@@ -158,27 +339,34 @@ void Traffic::TrafficDataProvider::onSourceHeartbeatChanged()
         // Disconnect old m_currentSource
         if (!m_currentSource.isNull()) {
             disconnect(m_currentSource, &Traffic::TrafficDataSource_Abstract::pressureAltitudeUpdated, this, &Traffic::TrafficDataProvider::setPressureAltitude);
-            disconnect(m_currentSource, &Traffic::TrafficDataSource_Abstract::factorWithoutPosition, this, &Traffic::TrafficDataProvider::onTrafficFactorWithoutPosition);
-            disconnect(m_currentSource, &Traffic::TrafficDataSource_Abstract::factorWithPosition, this, &Traffic::TrafficDataProvider::onTrafficFactorWithPosition);
             disconnect(m_currentSource, &Traffic::TrafficDataSource_Abstract::positionUpdated, this, &Traffic::TrafficDataProvider::setPositionInfo);
-            disconnect(m_currentSource, &Traffic::TrafficDataSource_Abstract::warning, this, &Traffic::TrafficDataProvider::setWarning);
         }
 
         // Update m_currentsource
         m_currentSource = heartbeatDataSource;
 
         if (!m_currentSource.isNull()) {
+            // Remember the source for the present Wi-Fi network, and probe
+            // for sources of higher priority only occasionally
+            Global::settings()->setLastTrafficDataSource(MobileAdaptor::getSSID(), m_dataSourceStates[sourcePriority(m_currentSource)].sourceName);
+            m_probeIntervalMS = maxProbeIntervalMS;
+            scheduleProbe();
+
             // If there is a new m_currentSource, then setup Qt connections and
-            // disconnect all sources of lower priority from the traffic receivers.
+            // disconnect all sources of lower priority from the traffic
+            // receivers. Traffic factors and warnings are connected for all
+            // sources, and filtered in the slots. Position info and pressure
+            // altitude are only taken from m_currentSource, also in fusion
+            // mode.
             connect(m_currentSource, &Traffic::TrafficDataSource_Abstract::pressureAltitudeUpdated, this, &Traffic::TrafficDataProvider::setPressureAltitude);
-            connect(m_currentSource, &Traffic::TrafficDataSource_Abstract::factorWithoutPosition, this, &Traffic::TrafficDataProvider::onTrafficFactorWithoutPosition);
-            connect(m_currentSource, &Traffic::TrafficDataSource_Abstract::factorWithPosition, this, &Traffic::TrafficDataProvider::onTrafficFactorWithPosition);
             connect(m_currentSource, &Traffic::TrafficDataSource_Abstract::positionUpdated, this, &Traffic::TrafficDataProvider::setPositionInfo);
-            connect(m_currentSource, &Traffic::TrafficDataSource_Abstract::warning, this, &Traffic::TrafficDataProvider::setWarning);
 
-            // Disconnect from traffic receiver
+            // Disconnect from traffic receiver, unless in fusion mode
             bool doDisconnect = false;
             foreach(auto source, m_dataSources) {
+                if (m_trafficDataFusion) {
+                    break;
+                }
                 if ( source.isNull() ) {
                     continue;
                 }
@@ -187,14 +375,15 @@ void Traffic::TrafficDataProvider::onSourceHeartbeatChanged()
                     continue;
                 }
                 if (doDisconnect) {
-                    source->disconnectFromTrafficReceiver();
+                    auto* lowerPrioritySource = source.data();
+                    QMetaObject::invokeMethod(lowerPrioritySource, [lowerPrioritySource]() { lowerPrioritySource->disconnectFromTrafficReceiver(); });
                 }
             }
 
         } else {
-            // If there is no m_currentSource, then try in 1sek to (re)connect to any
+            // If there is no m_currentSource, then try to (re)connect to any
             // traffic receiver out there.
-            QTimer::singleShot(1s, this, &Traffic::TrafficDataProvider::connectToTrafficReceiver);
+            restartProbing();
         }
 
 
@@ -204,21 +393,98 @@ void Traffic::TrafficDataProvider::onSourceHeartbeatChanged()
     if (m_currentSource.isNull()) {
         setReceivingHeartbeat(false);
     } else {
-        setReceivingHeartbeat(m_currentSource->receivingHeartbeat());
+        setReceivingHeartbeat(sourceReceivingHeartbeat(m_currentSource));
     }
+
+    // Pause or resume ForeFlight broadcast
+    updateForeFlightBroadcast(false);
+}
+
+
+void Traffic::TrafficDataProvider::onSourceWarning(const Traffic::Warning& warning)
+{
+    if (!acceptsTrafficFrom(sender())) {
+        return;
+    }
+
+    // In fusion mode, other sources can only make the warning more urgent
+    if ((sender() != nullptr) && (sender() != m_currentSource) && (warning.alarmLevel() <= qMax(0, m_Warning.alarmLevel()))) {
+        return;
+    }
+    setWarning(warning);
 }
 
 
 void Traffic::TrafficDataProvider::onTrafficFactorWithoutPosition(const Traffic::TrafficFactor &factor)
 {
-    if ((factor.ID() == m_trafficObjectWithoutPosition->ID()) || factor.hasHigherPriorityThan(*m_trafficObjectWithoutPosition)) {
+    processTrafficFactorWithoutPosition(sender(), factor);
+}
+
+
+void Traffic::TrafficDataProvider::onTrafficFactorWithPosition(const Traffic::TrafficFactor &factor)
+{
+    processTrafficFactorWithPosition(sender(), factor);
+}
+
+
+void Traffic::TrafficDataProvider::onTrafficReportsAvailable()
+{
+    if (!m_ingestTimer.isActive()) {
+        m_ingestTimer.start();
+    }
+}
+
+
+void Traffic::TrafficDataProvider::processIngestQueues()
+{
+    Traffic::TrafficDataSource_Abstract::TrafficReport report;
+    foreach(auto dataSource, m_dataSources) {
+        if (dataSource.isNull()) {
+            continue;
+        }
+        auto* queue = dataSource->ingestQueue();
+        if (queue == nullptr) {
+            continue;
+        }
+
+        // Clear the notification flag before popping, so that data pushed
+        // while the queue is drained triggers a new notification
+        queue->clearNotification();
+        while (queue->pop(report)) {
+            m_ingestFactor.setData(report.alarmLevel, report.ID, report.hDist, report.vDist, report.type, report.positionInfo, report.callSign);
+            if (report.hasPosition) {
+                processTrafficFactorWithPosition(dataSource, m_ingestFactor);
+            } else {
+                processTrafficFactorWithoutPosition(dataSource, m_ingestFactor);
+            }
+        }
+    }
+    m_flushTimer.stop();
+    flushTrafficObjects();
+}
+
+
+void Traffic::TrafficDataProvider::processTrafficFactorWithoutPosition(QObject* source, const Traffic::TrafficFactor &factor)
+{
+    if (!acceptsTrafficFrom(source)) {
+        return;
+    }
+
+    if ((factor.numericID() == m_trafficObjectWithoutPosition->numericID()) || factor.hasHigherPriorityThan(*m_trafficObjectWithoutPosition)) {
         m_trafficObjectWithoutPosition->copyFrom(factor);
+        scheduleFlush();
     }
 }
 
 
-void Traffic::TrafficDataProvider::onTrafficFactorWithPosition(const Traffic::TrafficFactor &factor)
+void Traffic::TrafficDataProvider::processTrafficFactorWithPosition(QObject* source, const Traffic::TrafficFactor &factor)
 {
+    if (!acceptsTrafficFrom(source)) {
+        return;
+    }
+    auto priority = sourcePriority(source);
+    auto now = m_fusionClock.elapsed();
+
     // Check if traffic is too far away to be shown
     bool farAway = false;
     if (factor.vDist().isFinite() && (factor.vDist() > maxVerticalDistance)) {
@@ -230,33 +496,274 @@ void Traffic::TrafficDataProvider::onTrafficFactorWithPosition(const Traffic::Tr
 
 
     // Check if the traffic is one of the known factors.
-    foreach(auto target, m_trafficObjects) {
-        if (factor.ID() == target->ID()) {
-            // If traffic is too far away, delete the entry. Otherwise, replace the entry by the factor.
-            if (farAway) {
-                target->copyFrom( TrafficFactor() );
-            } else {
-                target->copyFrom(factor);
-            }
+    auto slot = m_slotsByID.value(factor.numericID(), -1);
+    if (slot >= 0) {
+        // In fusion mode, ignore reports from sources of lower priority,
+        // unless the data in use is stale
+        if ((priority > m_slotSourcePriorities[slot]) && (now-m_slotUpdateTimes[slot] < fusionHoldMS)) {
+            return;
+        }
+        m_slotSourcePriorities[slot] = priority;
+        m_slotUpdateTimes[slot] = now;
+
+        auto* target = m_trafficObjects[slot];
+        // If traffic is too far away, delete the entry. Otherwise, replace the entry by the factor.
+        scheduleFlush();
+        if (farAway) {
+            releaseSlot(slot);
+            target->copyFrom( TrafficFactor() );
             return;
         }
+        target->copyFrom(factor);
+        if (!target->valid()) {
+            releaseSlot(slot);
+            return;
+        }
+        if (m_heapPositions[slot] >= 0) {
+            heapUpdate(m_heapPositions[slot]);
+        }
+        return;
     }
 
-    // If traffic is too far away, ignore the factor.
-    if (farAway) {
+    // If traffic is too far away or invalid, ignore the factor.
+    if (farAway || !factor.valid()) {
         return;
     }
 
-    auto *lowestPriObject = m_trafficObjects.at(0);
-    foreach(auto target, m_trafficObjects) {
-        if (lowestPriObject->hasHigherPriorityThan(*target)) {
-            lowestPriObject = target;
+    // If all slots are in use, replace the traffic with the lowest priority,
+    // provided that the new factor is more relevant
+    if (m_freeSlots.isEmpty()) {
+        if (m_heap.isEmpty()) {
+            return;
         }
+        auto lowestPriSlot = m_heap[0];
+        if (!factor.hasHigherPriorityThan(*m_trafficObjects[lowestPriSlot])) {
+            return;
+        }
+        releaseSlot(lowestPriSlot);
+    }
+
+    slot = m_freeSlots.takeLast();
+    m_trafficObjects[slot]->copyFrom(factor);
+    scheduleFlush();
+    if (!m_trafficObjects[slot]->valid()) {
+        m_freeSlots.append(slot);
+        return;
     }
-    if (factor.hasHigherPriorityThan(*lowestPriObject)) {
-        lowestPriObject->copyFrom(factor);
+    m_slotsByID.insert(factor.numericID(), slot);
+    m_slotSourcePriorities[slot] = priority;
+    m_slotUpdateTimes[slot] = now;
+    heapInsert(slot);
+    if (!m_extrapolationTimer.isActive()) {
+        m_extrapolationTimer.start();
     }
+}
 
+
+void Traffic::TrafficDataProvider::onTrafficObjectValidChanged(int slot)
+{
+    if ((slot < 0) || (slot >= m_trafficObjects.size())) {
+        return;
+    }
+    if (!m_trafficObjects[slot]->valid()) {
+        releaseSlot(slot);
+    }
+}
+
+
+void Traffic::TrafficDataProvider::probeTrafficReceivers()
+{
+    // On the first probe after startup or after a change of the Wi-Fi
+    // network, try only the source that worked last time in this network
+    auto preferredSourceIndex = -1;
+    if (m_probePreferredSource && m_currentSource.isNull()) {
+        auto preferredSourceName = Global::settings()->lastTrafficDataSource(MobileAdaptor::getSSID());
+        for(int i=0; i<m_dataSourceStates.size(); i++) {
+            if (!preferredSourceName.isEmpty() && (m_dataSourceStates[i].sourceName == preferredSourceName)) {
+                preferredSourceIndex = i;
+                break;
+            }
+        }
+    }
+    m_probePreferredSource = false;
+
+    // Probe all sources in parallel. Sources that receive heartbeat messages
+    // are left alone. Unless in fusion mode, sources of lower priority than
+    // m_currentSource are not used and need not be probed.
+    auto currentSourceIndex = m_currentSource.isNull() ? m_dataSources.size() : sourcePriority(m_currentSource);
+    for(int i=0; i<m_dataSources.size(); i++) {
+        if (m_dataSources[i].isNull() || m_dataSourceStates[i].receivingHeartbeat) {
+            continue;
+        }
+        if ((preferredSourceIndex >= 0) && (i != preferredSourceIndex)) {
+            continue;
+        }
+        if (!m_trafficDataFusion && (i > currentSourceIndex)) {
+            continue;
+        }
+        auto* source = m_dataSources[i].data();
+        QMetaObject::invokeMethod(source, [source]() { source->connectToTrafficReceiver(); });
+    }
+
+    scheduleProbe();
+    m_probeIntervalMS = qMin(2*m_probeIntervalMS, maxProbeIntervalMS);
+}
+
+
+void Traffic::TrafficDataProvider::restartProbing(bool usePreferredSource)
+{
+    m_probeIntervalMS = m_currentSource.isNull() ? minProbeIntervalMS : maxProbeIntervalMS;
+    m_probePreferredSource = usePreferredSource;
+    probeTrafficReceivers();
+    updateForeFlightBroadcast(true);
+}
+
+
+void Traffic::TrafficDataProvider::scheduleProbe()
+{
+    m_probeTimer.start( jittered(m_probeIntervalMS) );
+}
+
+
+auto Traffic::TrafficDataProvider::jittered(qint64 intervalMS) -> int
+{
+    auto jitter = 1.0 + probeJitter*(2.0*QRandomGenerator::global()->generateDouble() - 1.0);
+    return qRound(static_cast<double>(intervalMS)*jitter);
+}
+
+
+void Traffic::TrafficDataProvider::updateForeFlightBroadcast(bool restart)
+{
+    if (!foreFlightBroadcastNeeded()) {
+        foreFlightBroadcastTimer.stop();
+        return;
+    }
+    if (restart || !foreFlightBroadcastTimer.isActive()) {
+        m_foreFlightBroadcastIntervalMS = minForeFlightBroadcastIntervalMS;
+        foreFlightBroadcast();
+    }
+}
+
+
+auto Traffic::TrafficDataProvider::acceptsTrafficFrom(QObject* source) const -> bool
+{
+    if (source == nullptr) {
+        return true;
+    }
+    if (source == m_currentSource) {
+        return true;
+    }
+    if (!m_trafficDataFusion) {
+        return false;
+    }
+    return sourceReceivingHeartbeat(source);
+}
+
+
+auto Traffic::TrafficDataProvider::hasLowerPriority(int slotA, int slotB) const -> bool
+{
+    return m_trafficObjects[slotB]->hasHigherPriorityThan(*m_trafficObjects[slotA]);
+}
+
+
+void Traffic::TrafficDataProvider::heapInsert(int slot)
+{
+    m_heapPositions[slot] = m_heap.size();
+    m_heap.append(slot);
+    heapUpdate(m_heap.size()-1);
+}
+
+
+void Traffic::TrafficDataProvider::heapRemove(int slot)
+{
+    auto position = m_heapPositions[slot];
+    if (position < 0) {
+        return;
+    }
+
+    auto last = m_heap.size()-1;
+    heapSwap(position, last);
+    m_heap.removeLast();
+    m_heapPositions[slot] = -1;
+    if (position < m_heap.size()) {
+        heapUpdate(position);
+    }
+}
+
+
+void Traffic::TrafficDataProvider::heapSwap(int positionA, int positionB)
+{
+    std::swap(m_heap[positionA], m_heap[positionB]);
+    m_heapPositions[m_heap[positionA]] = positionA;
+    m_heapPositions[m_heap[positionB]] = positionB;
+}
+
+
+void Traffic::TrafficDataProvider::heapUpdate(int position)
+{
+    // Move up, as long as the slot has lower priority than its parent
+    while (position > 0) {
+        auto parent = (position-1)/2;
+        if (!hasLowerPriority(m_heap[position], m_heap[parent])) {
+            break;
+        }
+        heapSwap(position, parent);
+        position = parent;
+    }
+
+    // Move down, as long as one of the children has lower priority
+    while (true) {
+        auto lowest = position;
+        auto left = 2*position+1;
+        auto right = 2*position+2;
+        if ((left < m_heap.size()) && hasLowerPriority(m_heap[left], m_heap[lowest])) {
+            lowest = left;
+        }
+        if ((right < m_heap.size()) && hasLowerPriority(m_heap[right], m_heap[lowest])) {
+            lowest = right;
+        }
+        if (lowest == position) {
+            break;
+        }
+        heapSwap(position, lowest);
+        position = lowest;
+    }
+}
+
+
+auto Traffic::TrafficDataProvider::sourcePriority(QObject* source) const -> int
+{
+    for(int i=0; i<m_dataSources.size(); i++) {
+        if (m_dataSources[i] == source) {
+            return i;
+        }
+    }
+    return m_dataSources.size();
+}
+
+
+auto Traffic::TrafficDataProvider::sourceReceivingHeartbeat(QObject* source) const -> bool
+{
+    auto index = sourcePriority(source);
+    if (index >= m_dataSourceStates.size()) {
+        return false;
+    }
+    return m_dataSourceStates[index].receivingHeartbeat;
+}
+
+
+void Traffic::TrafficDataProvider::releaseSlot(int slot)
+{
+    if (m_heapPositions[slot] < 0) {
+        return;
+    }
+
+    auto iterator = m_slotsByID.find(m_trafficObjects[slot]->numericID());
+    if ((iterator != m_slotsByID.end()) && (iterator.value() == slot)) {
+        m_slotsByID.erase(iterator);
+    }
+    heapRemove(slot);
+    m_freeSlots.append(slot);
 }
 
 
@@ -276,6 +783,56 @@ void Traffic::TrafficDataProvider::setReceivingHeartbeat(bool newReceivingHeartb
 }
 
 
+void Traffic::TrafficDataProvider::setTrafficCapacity(int newTrafficCapacity)
+{
+    if ((newTrafficCapacity < 1) || (newTrafficCapacity == m_trafficObjects.size())) {
+        return;
+    }
+
+    // Delete old traffic objects
+    foreach(auto trafficObject, m_trafficObjects) {
+        trafficObject->disconnect(this);
+        trafficObject->deleteLater();
+    }
+    m_trafficObjects.clear();
+    m_slotsByID.clear();
+    m_heap.clear();
+
+    // Create new traffic objects, all of them unused
+    m_trafficObjects.reserve(newTrafficCapacity);
+    m_freeSlots.resize(newTrafficCapacity);
+    m_heapPositions.fill(-1, newTrafficCapacity);
+    m_slotSourcePriorities.fill(0, newTrafficCapacity);
+    m_slotUpdateTimes.fill(0, newTrafficCapacity);
+    m_heap.reserve(newTrafficCapacity);
+    for(int slot=0; slot<newTrafficCapacity; slot++) {
+        auto *trafficObject = new Traffic::TrafficFactor(this);
+        trafficObject->setBatchUpdates(true);
+        QQmlEngine::setObjectOwnership(trafficObject, QQmlEngine::CppOwnership);
+        trafficObject->setTimeoutMS(qRound64(m_trafficTimeout.toS()*1000.0));
+        connect(trafficObject, &Traffic::TrafficFactor::validChanged, this, [this, slot]() { onTrafficObjectValidChanged(slot); });
+        m_trafficObjects.append( trafficObject );
+        m_freeSlots[slot] = newTrafficCapacity-1-slot;
+    }
+
+    emit trafficCapacityChanged();
+}
+
+
+void Traffic::TrafficDataProvider::setTrafficTimeout(AviationUnits::Time newTrafficTimeout)
+{
+    if (!newTrafficTimeout.isFinite() || (newTrafficTimeout.toS() <= 0.0) || qFuzzyCompare(newTrafficTimeout.toS(), m_trafficTimeout.toS())) {
+        return;
+    }
+
+    m_trafficTimeout = newTrafficTimeout;
+    foreach(auto trafficObject, m_trafficObjects) {
+        trafficObject->setTimeoutMS(qRound64(m_trafficTimeout.toS()*1000.0));
+    }
+    emit trafficTimeoutChanged();
+}
+
+
 void Traffic::TrafficDataProvider::setWarning(const Traffic::Warning& warning)
 {
     if (warning.alarmLevel() > -1) {
@@ -291,18 +848,220 @@ void Traffic::TrafficDataProvider::setWarning(const Traffic::Warning& warning)
 }
 
 
+auto Traffic::TrafficDataProvider::startRecording(const QString& fileName) -> bool
+{
+    stopRecording();
+
+    auto* recorder = new Traffic::TrafficCaptureRecorder(fileName, this);
+    if (!recorder->isOpen()) {
+        delete recorder;
+        return false;
+    }
+    m_captureRecorder = recorder;
+    foreach(auto dataSource, m_dataSources) {
+        if (dataSource.isNull()) {
+            continue;
+        }
+        auto* source = dataSource.data();
+        QMetaObject::invokeMethod(source, [source, recorder]() { source->setCaptureRecorder(recorder); });
+    }
+    emit recordingChanged();
+    return true;
+}
+
+
+void Traffic::TrafficDataProvider::stopRecording()
+{
+    if (m_captureRecorder.isNull()) {
+        return;
+    }
+
+    // Sources in the ingest thread must have let go of the recorder before it
+    // is deleted, so wait for them
+    foreach(auto dataSource, m_dataSources) {
+        if (dataSource.isNull()) {
+            continue;
+        }
+        auto* source = dataSource.data();
+        auto connectionType = (source->thread() == thread()) ? Qt::DirectConnection : Qt::BlockingQueuedConnection;
+        QMetaObject::invokeMethod(source, [source]() { source->setCaptureRecorder(nullptr); }, connectionType);
+    }
+    delete m_captureRecorder;
+    emit recordingChanged();
+}
+
+
+auto Traffic::TrafficDataProvider::registerTrafficDataSource(const QString& descriptor, int priority) -> bool
+{
+    auto* source = createDataSource(descriptor);
+    if (source == nullptr) {
+        return false;
+    }
+    delete source;
+
+    auto descriptors = Global::settings()->trafficDataSources();
+    descriptors.removeAll(descriptor);
+    if ((priority < 0) || (priority > descriptors.size())) {
+        priority = descriptors.size();
+    }
+    descriptors.insert(priority, descriptor);
+    Global::settings()->setTrafficDataSources(descriptors);
+    return true;
+}
+
+
+void Traffic::TrafficDataProvider::unregisterTrafficDataSource(const QString& descriptor)
+{
+    auto descriptors = Global::settings()->trafficDataSources();
+    descriptors.removeAll(descriptor);
+    Global::settings()->setTrafficDataSources(descriptors);
+}
+
+
+void Traffic::TrafficDataProvider::updateDataSources()
+{
+    auto descriptors = Global::settings()->trafficDataSources();
+
+    // Priorities stored for the slots refer to the indices in this list
+    auto previousDataSources = m_dataSources;
+
+    // Delete sources that are no longer registered. Sources without
+    // descriptor have been added via addDataSource() and are kept.
+    for(int i=m_dataSources.size()-1; i>=0; i--) {
+        const auto& descriptor = m_dataSourceStates[i].descriptor;
+        if (descriptor.isEmpty() || descriptors.contains(descriptor)) {
+            continue;
+        }
+        auto source = m_dataSources.takeAt(i);
+        m_dataSourceStates.removeAt(i);
+        if (!source.isNull()) {
+            source->disconnect(this);
+            source->deleteLater();
+        }
+    }
+
+    // Create sources that are registered, but do not yet exist
+    bool hasNewSources = false;
+    foreach(auto descriptor, descriptors) {
+        auto exists = std::any_of(m_dataSourceStates.cbegin(), m_dataSourceStates.cend(), [&descriptor](const DataSourceState& state) { return state.descriptor == descriptor; });
+        if (exists) {
+            continue;
+        }
+        auto* source = createDataSource(descriptor);
+        if (source == nullptr) {
+            continue;
+        }
+        addIngestDataSource(source, descriptor);
+        hasNewSources = true;
+    }
+
+    // Sort sources in the order of the descriptors. Sources without
+    // descriptor go last, in the order in which they were added.
+    QVector<int> order(m_dataSources.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto rank = [&](int index) {
+        auto position = descriptors.indexOf(m_dataSourceStates[index].descriptor);
+        return (position < 0) ? descriptors.size() : position;
+    };
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return rank(a) < rank(b); });
+    QList<QPointer<Traffic::TrafficDataSource_Abstract>> sortedDataSources;
+    QVector<DataSourceState> sortedDataSourceStates;
+    foreach(auto index, order) {
+        sortedDataSources << m_dataSources[index];
+        sortedDataSourceStates << m_dataSourceStates[index];
+    }
+    m_dataSources = sortedDataSources;
+    m_dataSourceStates = sortedDataSourceStates;
+
+    // Renumber the priorities stored for the slots, so that fusion follows the
+    // new order. Data from deleted sources gets the lowest priority.
+    for(auto& slotPriority : m_slotSourcePriorities) {
+        if ((slotPriority >= 0) && (slotPriority < previousDataSources.size()) && !previousDataSources[slotPriority].isNull()) {
+            slotPriority = sourcePriority(previousDataSources[slotPriority]);
+        } else {
+            slotPriority = m_dataSources.size();
+        }
+    }
+
+    // Re-evaluate the choice of the current source. If sources have been
+    // added, or if the current source has been deleted, probe soon.
+    bool currentSourceDeleted = false;
+    if (!m_currentSource.isNull() && !m_dataSources.contains(m_currentSource)) {
+        m_currentSource = nullptr;
+        currentSourceDeleted = true;
+    }
+    onSourceHeartbeatChanged();
+    updateStatusString();
+    if (hasNewSources || currentSourceDeleted) {
+        m_probeIntervalMS = minProbeIntervalMS;
+        scheduleProbe();
+    }
+}
+
+
+void Traffic::TrafficDataProvider::updateTrafficDataFusion()
+{
+    auto newTrafficDataFusion = Global::settings()->trafficDataFusion();
+    if (newTrafficDataFusion == m_trafficDataFusion) {
+        return;
+    }
+    m_trafficDataFusion = newTrafficDataFusion;
+
+    // When fusion is switched on, reconnect the sources that were disconnected
+    // in favour of m_currentSource. When it is switched off, disconnect the
+    // superfluous sources again.
+    if (m_trafficDataFusion) {
+        connectToTrafficReceiver();
+    } else {
+        auto currentSource = m_currentSource;
+        m_currentSource = nullptr;
+        if (!currentSource.isNull()) {
+            disconnect(currentSource, &Traffic::TrafficDataSource_Abstract::pressureAltitudeUpdated, this, &Traffic::TrafficDataProvider::setPressureAltitude);
+            disconnect(currentSource, &Traffic::TrafficDataSource_Abstract::positionUpdated, this, &Traffic::TrafficDataProvider::setPositionInfo);
+        }
+        onSourceHeartbeatChanged();
+    }
+}
+
+
 void Traffic::TrafficDataProvider::updateStatusString()
 {
+    // Collect the state that the status string depends on, and return early
+    // if it did not change since the string was last computed. This method
+    // is called for every change of every source, which happens frequently
+    // while traffic data is received.
+    StatusStringKey key;
+    key.receivingHeartbeat = receivingHeartbeat();
+    if (key.receivingHeartbeat) {
+        key.receivingPositionInfo = receivingPositionInfo();
+        key.receivingPressureAltitude = receivingPressureAltitude();
+        if (!m_currentSource.isNull()) {
+            key.sourceStates << m_dataSourceStates[sourcePriority(m_currentSource)].sourceName;
+        }
+    } else {
+        for(int i=0; i<m_dataSources.size(); i++) {
+            if (m_dataSources[i].isNull()) {
+                continue;
+            }
+            const auto& state = m_dataSourceStates[i];
+            key.sourceStates << state.sourceName << state.connectivityStatus << state.errorString;
+        }
+    }
+    if (m_statusStringKey == key) {
+        return;
+    }
+    m_statusStringKey = key;
+
     if (receivingHeartbeat()) {
         QString result;
         if (!m_currentSource.isNull()) {
-            result += QString("<p>%1</p><ul style='margin-left:-25px;'>").arg(m_currentSource->sourceName());
+            result += QString("<p>%1</p><ul style='margin-left:-25px;'>").arg(m_dataSourceStates[sourcePriority(m_currentSource)].sourceName);
         }
         result += QString("<li>%1</li>").arg(tr("Receiving traffic data."));
-        if (positionInfo().isValid()) {
+        if (receivingPositionInfo()) {
             result += QString("<li>%1</li>").arg(tr("Receiving position info."));
         }
-        if (pressureAltitude().isFinite()) {
+        if (receivingPressureAltitude()) {
             result += QString("<li>%1</li>").arg(tr("Receiving barometric altitude info."));
         }
         result += "</ul>";
@@ -311,15 +1070,16 @@ void Traffic::TrafficDataProvider::updateStatusString()
     }
 
     QString result = "<p>" + tr("Not receiving traffic data.") + "<p><ul style='margin-left:-25px;'>";
-    foreach(auto source, m_dataSources) {
-        if (source.isNull()) {
+    for(int i=0; i<m_dataSources.size(); i++) {
+        if (m_dataSources[i].isNull()) {
             continue;
         }
+        const auto& state = m_dataSourceStates[i];
 
         result += "<li>";
-        result += source->sourceName() + ": " + source->connectivityStatus();
-        if (!source->errorString().isEmpty()) {
-            result += " " + source->errorString();
+        result += state.sourceName + ": " + state.connectivityStatus;
+        if (!state.errorString.isEmpty()) {
+            result += " " + state.errorString;
         }
         result += "</li>";
     }
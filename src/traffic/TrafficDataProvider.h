@@ -20,13 +20,20 @@
 
 #pragma once
 
+#include <QElapsedTimer>
 #include <QNetworkDatagram>
 #include <QQmlListProperty>
+#include <QThread>
 #include <QUdpSocket>
+#include <optional>
 
+#include "Scheduler.h"
 #include "positioning/PositionInfoSource_Abstract.h"
+#include "traffic/CollisionRiskEngine.h"
+#include "traffic/TrafficCaptureRecorder.h"
 #include "traffic/Warning.h"
 #include "traffic/TrafficFactor.h"
+#include "units/Time.h"
 
 
 namespace Traffic {
@@ -37,18 +44,29 @@ namespace Traffic {
  *  streams, and passes data from the most relevant (if any) traffic data source
  *  on to the consumers of this class.
  *
- *  By default, it watches the following data channels:
+ *  The network endpoints that it watches are taken from the setting
+ *  Settings::trafficDataSources, and can be changed at runtime. By default, it
+ *  watches the following data channels:
  *
  *  - TCP connection to 192.168.1.1, port 2000
  *  - TCP connection to 192.168.10.1, port 2000
+ *  - UDP port 4000
+ *  - UDP port 49002
  *
  *  This class also acts as a PositionInfoSource, and passes position data (that
  *  some traffic receivers provide) on to the the consumers of this class.
  *
  *  Following the standards established by the app ForeFlight, this classEnroute
- *  broadcasts a UDP message on port 63093 every 5 seconds while the app is
- *  running in the foreground. This message allows devices to discover
- *  Enroute’s IP address, which can be used as the target of UDP unicast messages.
+ *  broadcasts a UDP message on port 63093 while the app is running in the
+ *  foreground. This message allows devices to discover Enroute’s IP address,
+ *  which can be used as the target of UDP unicast messages. The broadcast is
+ *  sent every second at startup and after a change of the Wi-Fi network,
+ *  slowing down to every 5 seconds. It pauses while traffic data is received
+ *  and no further devices are needed.
+ *
+ *  The TCP and UDP data sources live in a dedicated ingest thread, where
+ *  socket I/O and parsing take place. Traffic reports are passed to the GUI
+ *  thread through lock-free queues, which are drained once per frame.
  */
 class TrafficDataProvider : public Positioning::PositionInfoSource_Abstract {
     Q_OBJECT
@@ -60,8 +78,8 @@ public:
      */
     explicit TrafficDataProvider(QObject *parent = nullptr);
 
-    // Standard destructor
-    ~TrafficDataProvider() = default;
+    // Destructor
+    ~TrafficDataProvider() override;
 
 
     //
@@ -77,6 +95,52 @@ public:
      */
     void addDataSource(Traffic::TrafficDataSource_Abstract* source);
 
+    /*! \brief Start recording the data received from traffic receivers
+     *
+     *  This method creates a capture file and records all data received by
+     *  the data sources, until stopRecording() is called. The file can be
+     *  replayed with TrafficDataSource_File. If a recording is already
+     *  running, it is stopped first.
+     *
+     *  @param fileName Name of the capture file. Existing files will be
+     *  overwritten.
+     *
+     *  @returns True if the capture file could be created
+     */
+    Q_INVOKABLE bool startRecording(const QString& fileName);
+
+    /*! \brief Stop recording
+     *
+     *  All pending data is written and the capture file is closed. If no
+     *  recording is running, this method does nothing.
+     */
+    Q_INVOKABLE void stopRecording();
+
+    /*! \brief Register a network endpoint as a traffic data source
+     *
+     *  This method adds the endpoint to the setting
+     *  Settings::trafficDataSources, with the given priority. If the endpoint
+     *  is already registered, its priority is changed.
+     *
+     *  @param descriptor Endpoint, of the form "tcp:host:port" or "udp:port"
+     *
+     *  @param priority Position of the endpoint in the list of endpoints, where
+     *  0 is the most preferred. If negative or out of range, the endpoint is
+     *  added with lowest priority.
+     *
+     *  @returns True if the descriptor is valid
+     */
+    Q_INVOKABLE bool registerTrafficDataSource(const QString& descriptor, int priority=-1);
+
+    /*! \brief Remove a network endpoint from the traffic data sources
+     *
+     *  This method removes the endpoint from the setting
+     *  Settings::trafficDataSources.
+     *
+     *  @param descriptor Endpoint, of the form "tcp:host:port" or "udp:port"
+     */
+    Q_INVOKABLE void unregisterTrafficDataSource(const QString& descriptor);
+
 
     //
     // Properties
@@ -91,6 +155,22 @@ public:
      */
     Q_PROPERTY(bool receivingHeartbeat READ receivingHeartbeat WRITE setReceivingHeartbeat NOTIFY receivingHeartbeatChanged)
 
+    /*! \brief Recording indicator
+     *
+     *  This property indicates if the data received from traffic receivers is
+     *  currently being recorded, see startRecording().
+     */
+    Q_PROPERTY(bool recording READ recording NOTIFY recordingChanged)
+
+    /*! \brief Getter method for property with the same name
+     *
+     *  @returns Property recording
+     */
+    bool recording() const
+    {
+        return !m_captureRecorder.isNull();
+    }
+
     /*! \brief Getter method for property with the same name
      *
      *  @returns Property receiving
@@ -100,6 +180,30 @@ public:
         return m_receivingHeartbeat;
     }
 
+    /*! \brief Maximal number of traffic objects whose position is known
+     *
+     *  This property holds the number of items in the list trafficObjects4QML.
+     *  If more traffic is reported, only the most relevant traffic objects are
+     *  kept. Changing this property clears the list.
+     */
+    Q_PROPERTY(int trafficCapacity READ trafficCapacity WRITE setTrafficCapacity NOTIFY trafficCapacityChanged)
+
+    /*! \brief Getter method for property with the same name
+     *
+     *  @returns Property trafficCapacity
+     */
+    int trafficCapacity() const
+    {
+        return m_trafficObjects.size();
+    }
+
+    /*! \brief Setter method for property with the same name
+     *
+     *  @param newTrafficCapacity Property trafficCapacity. Numbers smaller than
+     *  one are ignored.
+     */
+    void setTrafficCapacity(int newTrafficCapacity);
+
     /*! \brief Traffic objects whose position is known
      *
      *  This property holds a list of the most relevant traffic objects, as a
@@ -108,7 +212,7 @@ public:
      *  be ignored. The list is not sorted in any way. The items themselves are
      *  owned by this class.
      */
-    Q_PROPERTY(QQmlListProperty<Traffic::TrafficFactor> trafficObjects4QML READ trafficObjects4QML CONSTANT)
+    Q_PROPERTY(QQmlListProperty<Traffic::TrafficFactor> trafficObjects4QML READ trafficObjects4QML NOTIFY trafficCapacityChanged)
 
     /*! \brief Getter method for property with the same name
      *
@@ -119,6 +223,20 @@ public:
         return QQmlListProperty(this, &m_trafficObjects);
     }
 
+    /*! \brief Traffic objects whose position is known
+     *
+     *  This method gives C++ code direct access to the list that is exposed to
+     *  QML as trafficObjects4QML. The same caveats apply: only the valid items
+     *  pertain to actual traffic. The signal trafficObjectsChanged() is emitted
+     *  whenever the items might have changed.
+     *
+     *  @returns List of traffic objects
+     */
+    const QList<Traffic::TrafficFactor *>& trafficObjects() const
+    {
+        return m_trafficObjects;
+    }
+
     /*! \brief Most relevant traffic object whose position is not known
      *
      *  This property holds a pointer to the most relevant traffic object whose
@@ -136,6 +254,30 @@ public:
         return m_trafficObjectWithoutPosition;
     }
 
+    /*! \brief Expiry time for traffic objects
+     *
+     *  Traffic objects whose data has not been refreshed for this period of
+     *  time become invalid and free their slot in the list
+     *  trafficObjects4QML.
+     */
+    Q_PROPERTY(AviationUnits::Time trafficTimeout READ trafficTimeout WRITE setTrafficTimeout NOTIFY trafficTimeoutChanged)
+
+    /*! \brief Getter method for property with the same name
+     *
+     *  @returns Property trafficTimeout
+     */
+    AviationUnits::Time trafficTimeout() const
+    {
+        return m_trafficTimeout;
+    }
+
+    /*! \brief Setter method for property with the same name
+     *
+     *  @param newTrafficTimeout Property trafficTimeout. Invalid or
+     *  non-positive times are ignored.
+     */
+    void setTrafficTimeout(AviationUnits::Time newTrafficTimeout);
+
     /*! \brief Current traffic warning
      *
      *  This property holds the current traffic warning.  The traffic warning is
@@ -165,10 +307,37 @@ public:
      */
     static constexpr AviationUnits::Distance maxHorizontalDistance = AviationUnits::Distance::fromKM(20.0);
 
+    /*! \brief Estimated memory used by traffic factors and data sources
+     *
+     * This method is used by MemoryBudget.
+     *
+     * @returns Estimated memory usage in bytes
+     */
+    qint64 memoryUsage() const;
+
 signals:
     /*! \brief Notifier signal */
     void receivingHeartbeatChanged(bool);
 
+    /*! \brief Notifier signal */
+    void recordingChanged();
+
+    /*! \brief Notifier signal */
+    void trafficCapacityChanged();
+
+    /*! \brief Notifier signal */
+    void trafficTimeoutChanged();
+
+    /*! \brief Emitted after pending changes of the traffic objects have been published
+     *
+     *  This signal is emitted once per batch of updates, after the traffic
+     *  objects have emitted their own notifier signals. Renderers that draw all
+     *  traffic objects at once can use it instead of connecting to every
+     *  single object. Note that changes of the property valid that are caused
+     *  by timeouts are only reported by the objects themselves.
+     */
+    void trafficObjectsChanged();
+
     /*! \brief Notifier signal */
     void warningChanged(const Traffic::Warning&);
 
@@ -178,7 +347,8 @@ public slots:
      * If this class is connected to a traffic receiver, this method does
      * nothing.  Otherwise, it stops any ongoing connection attempt and starts a
      * new attempt to connect to a potential receiver, via all available
-     * channels simultaneously.
+     * channels simultaneously.  If the attempt fails, further attempts are
+     * made with exponentially increasing intervals.
      */
     void connectToTrafficReceiver();
 
@@ -191,7 +361,14 @@ public slots:
 private slots:   
     // Intializations that are moved out of the constructor, in order to avoid
     // nested uses of globalInstance().
-    void deferredInitialization() const;
+    void deferredInitialization();
+
+    // Extrapolates the positions of all traffic objects in use to the
+    // present time, and emits the pending notifier signals
+    void extrapolateTrafficObjects();
+
+    // Emits the pending notifier signals of all traffic objects
+    void flushTrafficObjects();
 
     // Sends out foreflight broadcast message
     // See https://www.foreflight.com/connect/spec/
@@ -200,12 +377,36 @@ private slots:
     // Called if one of the sources indicates a heartbeat change
     void onSourceHeartbeatChanged();
 
+    // Called if one of the sources issues a traffic warning
+    void onSourceWarning(const Traffic::Warning& warning);
+
     // Called if one of the sources reports traffic (position unknown)
     void onTrafficFactorWithPosition(const Traffic::TrafficFactor &factor);
 
     // Called if one of the sources reports traffic (position known)
     void onTrafficFactorWithoutPosition(const Traffic::TrafficFactor &factor);
 
+    // Called if one of the sources in the ingest thread has pushed data into
+    // its ingest queue
+    void onTrafficReportsAvailable();
+
+    // Pops all traffic reports from the ingest queues and processes them
+    void processIngestQueues();
+
+    // Called if the traffic object in the given slot changes validity
+    void onTrafficObjectValidChanged(int slot);
+
+    // Connects the sources that might yield traffic data, and schedules the
+    // next probe
+    void probeTrafficReceivers();
+
+    // Resets the backoff, probes the sources immediately and restarts the
+    // ForeFlight broadcast at the fastest rate, if needed. If
+    // usePreferredSource is true, the first probe is restricted to the source
+    // that last worked in the present Wi-Fi network, if such a source is
+    // known.
+    void restartProbing(bool usePreferredSource=false);
+
     // Resetter method
     void resetWarning();
 
@@ -215,6 +416,13 @@ private slots:
     // Setter method
     void setWarning(const Traffic::Warning& warning);
 
+    // Reads the setting trafficDataSources, creates and deletes sources as
+    // required, and sorts m_dataSources accordingly
+    void updateDataSources();
+
+    // Reads the setting trafficDataFusion and updates the sources
+    void updateTrafficDataFusion();
+
     // Updates the property statusString that is inherited from
     // Positioning::PositionInfoSource_Abstract
     void updateStatusString();
@@ -225,21 +433,168 @@ private:
     QNetworkDatagram foreFlightBroadcastDatagram {R"({"App":"Enroute Flight Navigation","GDL90":{"port":4000}})", QHostAddress::Broadcast, 63093};
     QUdpSocket foreFlightBroadcastSocket;
     QTimer foreFlightBroadcastTimer;
+    qint64 m_foreFlightBroadcastIntervalMS {minForeFlightBroadcastIntervalMS};
+    static constexpr qint64 minForeFlightBroadcastIntervalMS = 1000;
+    static constexpr qint64 maxForeFlightBroadcastIntervalMS = 5000;
+
+    // Check if the ForeFlight broadcast is needed. This is the case unless a
+    // UDP source receives heartbeat messages, independent of fusion mode.
+    bool foreFlightBroadcastNeeded() const;
+
+    // Restarts the ForeFlight broadcast at the fastest rate if it is needed,
+    // and pauses it otherwise
+    void updateForeFlightBroadcast(bool restart);
 
-    // Targets
+    // Targets. The traffic objects in m_trafficObjects are called "slots". A
+    // slot is in use if it holds valid traffic.
     QList<Traffic::TrafficFactor *> m_trafficObjects;
     QPointer<Traffic::TrafficFactor> m_trafficObjectWithoutPosition;
+    AviationUnits::Time m_trafficTimeout {AviationUnits::Time::fromS(10.0)};
+
+    // Traffic objects are updated in batches. Signals are emitted once per
+    // frame, when the timer times out
+    QTimer m_flushTimer;
+    void scheduleFlush()
+    {
+        if (!m_flushTimer.isActive()) {
+            m_flushTimer.start();
+        }
+    }
+
+    // Dead reckoning. While traffic is known, positions are extrapolated
+    // whenever the timer times out. Consumers that need the present position
+    // of the traffic, such as the GUI, should use the extrapolated coordinate.
+    QTimer m_extrapolationTimer;
+
+    // Onboard conflict detection, run at 10 Hz as part of the dead reckoning.
+    // Warnings generated here supplement those reported by the traffic
+    // receiver, and never replace a more urgent warning.
+    Traffic::CollisionRiskEngine m_collisionRiskEngine;
+    QElapsedTimer m_collisionRiskClock;
+    static constexpr qint64 collisionRiskIntervalMS = 100;
+
+    // Index of the slots in use, by numeric traffic ID
+    QHash<quint32, int> m_slotsByID;
+
+    // Slots not in use
+    QVector<int> m_freeSlots;
+
+    // Binary heap of the slots in use, where every slot has lower or equal
+    // priority than its children. The slot with the lowest priority is
+    // therefore found in m_heap[0]. The vector m_heapPositions holds the
+    // position of every slot in m_heap, or -1 if the slot is not in use.
+    QVector<int> m_heap;
+    QVector<int> m_heapPositions;
+
+    // Heap operations
+    bool hasLowerPriority(int slotA, int slotB) const;
+    void heapInsert(int slot);
+    void heapRemove(int slot);
+    void heapSwap(int positionA, int positionB);
+    void heapUpdate(int position);
+
+    // Marks the slot as not in use
+    void releaseSlot(int slot);
+
+    // Adds a data source, like addDataSource(), and moves it to the ingest
+    // thread. The descriptor is the entry of Settings::trafficDataSources
+    // that describes the source.
+    void addIngestDataSource(Traffic::TrafficDataSource_Abstract* source, const QString& descriptor);
+
+    // Creates a data source described by an entry of
+    // Settings::trafficDataSources. Returns nullptr if the descriptor is
+    // invalid.
+    static Traffic::TrafficDataSource_Abstract* createDataSource(const QString& descriptor);
+
+    // Process traffic reported by the source
+    void processTrafficFactorWithoutPosition(QObject* source, const Traffic::TrafficFactor &factor);
+    void processTrafficFactorWithPosition(QObject* source, const Traffic::TrafficFactor &factor);
+
+    // Check if traffic data reported by the source shall be used. This is the
+    // case for m_currentSource and, in fusion mode, for every source that
+    // receives heartbeat messages. Data that does not come from a data
+    // source (source == nullptr) is always used.
+    bool acceptsTrafficFrom(QObject* source) const;
+
+    // Priority of the source. This is the index in m_dataSources, so that
+    // smaller numbers mean higher priority. Unknown sources have the lowest
+    // priority.
+    int sourcePriority(QObject* source) const;
 
     // TrafficData Sources
     QList<QPointer<Traffic::TrafficDataSource_Abstract>> m_dataSources;
+
+    // State of the data sources, with the same indices as m_dataSources.
+    // Sources in the ingest thread must not be accessed directly from the GUI
+    // thread. Instead, this copy of their properties is updated via the
+    // notifier signals.
+    struct DataSourceState {
+        QString descriptor;
+        QString sourceName;
+        QString connectivityStatus;
+        QString errorString;
+        bool receivingHeartbeat {false};
+    };
+    QVector<DataSourceState> m_dataSourceStates;
+
+    // State that the property statusString was last computed from. The string
+    // is regenerated by updateStatusString() only if this state changes.
+    struct StatusStringKey {
+        bool receivingHeartbeat {false};
+        bool receivingPositionInfo {false};
+        bool receivingPressureAltitude {false};
+        QStringList sourceStates;
+
+        bool operator==(const StatusStringKey& other) const = default;
+    };
+    std::optional<StatusStringKey> m_statusStringKey;
+
+    // Returns true if the source receives heartbeat messages
+    bool sourceReceivingHeartbeat(QObject* source) const;
+
+    // Ingest thread. Traffic reports from sources in this thread are collected
+    // in their ingest queues. The queues are drained once per frame, when
+    // m_ingestTimer times out. The traffic factor m_ingestFactor is used to
+    // hold the reports while they are processed.
+    QThread m_ingestThread;
+    QTimer m_ingestTimer;
+    Traffic::TrafficFactor m_ingestFactor;
+
     QPointer<Traffic::TrafficDataSource_Abstract> m_currentSource;
 
+    // Capture recorder, if recording
+    QPointer<Traffic::TrafficCaptureRecorder> m_captureRecorder;
+
+    // Fusion mode. If several sources report the same traffic, the report of
+    // the source with highest priority is used, unless it is older than
+    // fusionHoldMS. For every slot, we store the priority of the source that
+    // reported the data in use, and the time of the report, as measured by
+    // m_fusionClock.
+    bool m_trafficDataFusion {false};
+    QVector<int> m_slotSourcePriorities;
+    QVector<qint64> m_slotUpdateTimes;
+    QElapsedTimer m_fusionClock;
+    static constexpr qint64 fusionHoldMS = 2000;
+
     // Property cache
     Traffic::Warning m_Warning;
     QTimer m_WarningTimer;
 
-    // Reconnect
-    QTimer reconnectionTimer;
+    // Probing. While no source receives heartbeat messages, the sources are
+    // probed in parallel, with exponential backoff and random jitter. While a
+    // source receives heartbeat messages, sources of higher priority are
+    // probed every maxProbeIntervalMS.
+    Scheduler::Timer m_probeTimer {Scheduler::Traffic};
+    qint64 m_probeIntervalMS {minProbeIntervalMS};
+    bool m_probePreferredSource {false};
+    static constexpr qint64 minProbeIntervalMS = 2000;
+    static constexpr qint64 maxProbeIntervalMS = 5*60*1000;
+    static constexpr double probeJitter = 0.2;
+    void scheduleProbe();
+
+    // Interval with random jitter. Random jitter avoids that probes and
+    // broadcasts of several devices fall into step.
+    static int jittered(qint64 intervalMS);
 
     // Property Cache
     bool m_receivingHeartbeat {false};
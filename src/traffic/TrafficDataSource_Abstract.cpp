@@ -18,17 +18,48 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QQmlEngine>
+#include <QThread>
 
+#include "positioning/PositionProvider.h"
 #include "traffic/TrafficDataSource_Abstract.h"
 
 
+// Copy of the own aircraft's position, for sources that run outside of the
+// GUI thread
+namespace {
+QMutex ownshipMutex;
+Positioning::PositionInfo ownshipPositionInfoCopy;
+QGeoCoordinate ownshipLastValidCoordinateCopy;
+
+auto isGUIThread() -> bool
+{
+    auto* application = QCoreApplication::instance();
+    return (application != nullptr) && (QThread::currentThread() == application->thread());
+}
+}
+
+
 // Member functions
 
 Traffic::TrafficDataSource_Abstract::TrafficDataSource_Abstract(QObject *parent) : QObject(parent) {
 
     QQmlEngine::setObjectOwnership(&m_factor, QQmlEngine::CppOwnership);
 
+    // Member objects are made children of this object, so that they move
+    // along when the source is moved to another thread
+    m_factor.setParent(this);
+    m_heartbeatTimer.setParent(this);
+    m_pressureAltitudeTimer.setParent(this);
+    m_trueAltitudeTimer.setParent(this);
+
+    // The factor is only used to pass data to the TrafficDataProvider, and
+    // nobody watches its properties. Signals are therefore never emitted.
+    m_factor.setBatchUpdates(true);
+
     // Setup heartbeat timer
     m_heartbeatTimer.setSingleShot(true);
     m_heartbeatTimer.setInterval(5s);
@@ -43,6 +74,60 @@ Traffic::TrafficDataSource_Abstract::TrafficDataSource_Abstract(QObject *parent)
 }
 
 
+auto Traffic::TrafficDataSource_Abstract::ownshipLastValidCoordinate() -> QGeoCoordinate
+{
+    if (isGUIThread()) {
+        return Positioning::PositionProvider::lastValidCoordinate();
+    }
+    QMutexLocker locker(&ownshipMutex);
+    return ownshipLastValidCoordinateCopy;
+}
+
+
+auto Traffic::TrafficDataSource_Abstract::ownshipPositionInfo() -> Positioning::PositionInfo
+{
+    if (isGUIThread()) {
+        auto* positionProviderPtr = Positioning::PositionProvider::globalInstance();
+        if (positionProviderPtr == nullptr) {
+            return {};
+        }
+        return positionProviderPtr->positionInfo();
+    }
+    QMutexLocker locker(&ownshipMutex);
+    return ownshipPositionInfoCopy;
+}
+
+
+void Traffic::TrafficDataSource_Abstract::reportTraffic(bool hasPosition,
+                                                        int alarmLevel,
+                                                        quint32 ID,
+                                                        AviationUnits::Distance hDist,
+                                                        AviationUnits::Distance vDist,
+                                                        Traffic::TrafficFactor::AircraftType type,
+                                                        const QGeoPositionInfo& positionInfo,
+                                                        const QString& callSign)
+{
+    if (m_ingestQueue == nullptr) {
+        m_factor.setData(alarmLevel, ID, hDist, vDist, type, positionInfo, callSign);
+        if (hasPosition) {
+            emit factorWithPosition(m_factor);
+        } else {
+            emit factorWithoutPosition(m_factor);
+        }
+        return;
+    }
+
+    // If the queue is full, the consumer is far behind and the report is
+    // dropped. Traffic receivers repeat their reports every second.
+    if (!m_ingestQueue->push({hasPosition, alarmLevel, ID, hDist, vDist, type, positionInfo, callSign})) {
+        return;
+    }
+    if (m_ingestQueue->requestNotification()) {
+        emit trafficReportsAvailable();
+    }
+}
+
+
 void Traffic::TrafficDataSource_Abstract::setConnectivityStatus(const QString& newConnectivityStatus)
 {
     if (m_connectivityStatus == newConnectivityStatus) {
@@ -65,6 +150,14 @@ void Traffic::TrafficDataSource_Abstract::setErrorString(const QString& newError
 }
 
 
+void Traffic::TrafficDataSource_Abstract::setOwnshipPosition(const Positioning::PositionInfo& positionInfo, const QGeoCoordinate& lastValidCoordinate)
+{
+    QMutexLocker locker(&ownshipMutex);
+    ownshipPositionInfoCopy = positionInfo;
+    ownshipLastValidCoordinateCopy = lastValidCoordinate;
+}
+
+
 void Traffic::TrafficDataSource_Abstract::setReceivingHeartbeat(bool newReceivingHeartbeat)
 {
     if (newReceivingHeartbeat) {
@@ -20,7 +20,14 @@
 
 #pragma once
 
+#include <QHash>
+#include <QPointer>
+#include <memory>
+
 #include "positioning/PositionInfo.h"
+#include "traffic/GDL90Report.h"
+#include "traffic/SPSCQueue.h"
+#include "traffic/TrafficCaptureRecorder.h"
 #include "traffic/TrafficFactor.h"
 #include "traffic/Warning.h"
 
@@ -34,6 +41,12 @@ namespace Traffic {
  *  imporant data via the signals barometricAltitudeUpdated,
  *  factorWithoutPosition, factorWithPosition and warning. It contains methods
  *  to interpret FLARM and GDL90 data streams.
+ *
+ *  Data sources can run in a thread other than the GUI thread. In that case,
+ *  enableIngestQueue() must be called before the source is moved to its
+ *  thread. Traffic factors are then not emitted via the signals
+ *  factorWithoutPosition and factorWithPosition, but passed as
+ *  TrafficReport through a lock-free queue, see ingestQueue().
  */
 class TrafficDataSource_Abstract : public QObject {
     Q_OBJECT
@@ -126,6 +139,101 @@ public:
      */
     virtual QString sourceName() const = 0;
 
+
+    //
+    // Methods
+    //
+
+    /*! \brief Traffic factor, as passed through the ingest queue
+     *
+     *  The members are the arguments of TrafficFactor::setData(), together
+     *  with a flag that indicates which of the signals factorWithoutPosition
+     *  and factorWithPosition would have been emitted.
+     */
+    struct TrafficReport {
+        /*! \brief True if the position of the traffic is known */
+        bool hasPosition {false};
+
+        /*! \brief Alarm level */
+        int alarmLevel {0};
+
+        /*! \brief Traffic ID, as in TrafficFactor::numericID() */
+        quint32 ID {0};
+
+        /*! \brief Horizontal distance */
+        AviationUnits::Distance hDist;
+
+        /*! \brief Vertical distance */
+        AviationUnits::Distance vDist;
+
+        /*! \brief Aircraft type */
+        Traffic::TrafficFactor::AircraftType type {Traffic::TrafficFactor::unknown};
+
+        /*! \brief Position info */
+        QGeoPositionInfo positionInfo;
+
+        /*! \brief Call sign */
+        QString callSign;
+    };
+
+    /*! \brief Queue used to pass traffic reports to the GUI thread */
+    using IngestQueue = Traffic::SPSCQueue<TrafficReport, 256>;
+
+    /*! \brief Pass traffic factors through a lock-free queue
+     *
+     *  After this method has been called, traffic factors are pushed into the
+     *  ingestQueue() and the signal trafficReportsAvailable is emitted when
+     *  the consumer needs to be woken up. This method must be called before
+     *  the source is moved to another thread.
+     */
+    void enableIngestQueue()
+    {
+        if (m_ingestQueue == nullptr) {
+            m_ingestQueue = std::make_unique<IngestQueue>();
+        }
+    }
+
+    /*! \brief Ingest queue
+     *
+     *  The source pushes data into this queue from its own thread. The
+     *  consumer can pop data from any other, single thread.
+     *
+     *  @returns Pointer to the ingest queue, or nullptr if
+     *  enableIngestQueue() has not been called
+     */
+    IngestQueue* ingestQueue() const
+    {
+        return m_ingestQueue.get();
+    }
+
+    /*! \brief Set position of the own aircraft
+     *
+     *  Data sources use the position of the own aircraft, for instance to
+     *  compute the horizontal distance to traffic. Sources that live in the
+     *  GUI thread ask the Positioning::PositionProvider directly. Sources
+     *  running in other threads use a copy of the data, protected by a mutex,
+     *  that is set by this method.
+     *
+     *  @param positionInfo Position info of the own aircraft
+     *
+     *  @param lastValidCoordinate Last valid coordinate of the own aircraft
+     */
+    static void setOwnshipPosition(const Positioning::PositionInfo& positionInfo, const QGeoCoordinate& lastValidCoordinate);
+
+    /*! \brief Set capture recorder
+     *
+     *  If a recorder is set, all data passed to processFLARMSentence(),
+     *  processGDLMessage() and processXGPSString() is recorded, before it is
+     *  interpreted.
+     *
+     *  @param recorder Capture recorder, or nullptr to stop recording. This
+     *  class does not take ownership.
+     */
+    void setCaptureRecorder(Traffic::TrafficCaptureRecorder* recorder)
+    {
+        m_captureRecorder = recorder;
+    }
+
 signals:
     /*! \brief Pressure altitude
      *
@@ -174,6 +282,13 @@ signals:
     /*! \brief Notifier signal */
     void receivingHeartbeatChanged(bool);
 
+    /*! \brief Traffic reports available
+     *
+     *  If the ingest queue is enabled, this signal is emitted when new data has
+     *  been pushed into the queue and the consumer needs to be woken up.
+     */
+    void trafficReportsAvailable();
+
     /*! \brief Position info
      *
      *  If this class received position information from a connected traffic
@@ -239,6 +354,22 @@ public slots:
 
 
 protected:
+    /*! \brief Position info of the own aircraft
+     *
+     *  This method can be called from any thread.
+     *
+     *  @returns Position info of the own aircraft
+     */
+    static Positioning::PositionInfo ownshipPositionInfo();
+
+    /*! \brief Last valid coordinate of the own aircraft
+     *
+     *  This method can be called from any thread.
+     *
+     *  @returns Last valid coordinate of the own aircraft
+     */
+    static QGeoCoordinate ownshipLastValidCoordinate();
+
     /*! \brief Process one FLARM/NMEA sentence
      *
      *  This method expects exactly one line containing a valid FLARM/NMEA
@@ -249,7 +380,17 @@ protected:
      *
      *  @param sentence A QString containing a FLARM/NMEA sentence.
      */
-    void processFLARMSentence(QString sentence);
+    void processFLARMSentence(const QString& sentence);
+
+    /*! \brief Process one FLARM/NMEA sentence
+     *
+     *  This is an overloaded method that reads the sentence from a buffer with
+     *  Latin-1 encoded text.  The sentence is tokenized in place, using
+     *  NMEASentence, without copying the data.
+     *
+     *  @param sentence A FLARM/NMEA sentence
+     */
+    void processFLARMSentence(QLatin1String sentence);
 
     /*! \brief Process one GDL90 message
      *
@@ -262,6 +403,36 @@ protected:
      */
     void processGDLMessage(const QByteArray& message);
 
+    /*! \brief Process one GDL90 message
+     *
+     *  This is an overloaded method that reads the message from a buffer,
+     *  without copying it into a QByteArray. Messages are decoded in place,
+     *  without allocating memory on the heap.
+     *
+     *  @param message Pointer to the message
+     *
+     *  @param size Size of the message, in bytes
+     */
+    void processGDLMessage(const char *message, int size);
+
+    /*! \brief Pressure altitude as encoded in GDL90 messages
+     *
+     *  GDL90 ownship and traffic reports encode the pressure altitude as a
+     *  12-bit number, in steps of 25 ft, with an offset of -1000 ft. The
+     *  value 0xFFF means that the altitude is unknown.
+     *
+     *  @param code 12-bit altitude code
+     *
+     *  @returns Pressure altitude, or NaN if the code is 0xFFF
+     */
+    static constexpr AviationUnits::Distance GDLPressureAltitude(quint32 code)
+    {
+        if (code == 0xFFF) {
+            return {};
+        }
+        return AviationUnits::Distance::fromFT(25.0*code - 1000.0);
+    }
+
     /*! \brief Process one XGPS string
      *
      *  This method expects exactly XGPS/XTRAFFIC string, as specified in
@@ -276,6 +447,24 @@ protected:
      */
     void processXGPSString(const QByteArray& data);
 
+    /*! \brief Report traffic
+     *
+     *  This method sets the data of an internal traffic factor and emits it
+     *  via factorWithPosition or factorWithoutPosition. If the ingest queue is
+     *  enabled, the data is pushed into the queue instead. The arguments are
+     *  those of TrafficFactor::setData().
+     *
+     *  @param hasPosition True if the position of the traffic is known
+     */
+    void reportTraffic(bool hasPosition,
+                       int alarmLevel,
+                       quint32 ID,
+                       AviationUnits::Distance hDist,
+                       AviationUnits::Distance vDist,
+                       Traffic::TrafficFactor::AircraftType type,
+                       const QGeoPositionInfo& positionInfo,
+                       const QString& callSign);
+
     /*! \brief Resetter method for the property with the same name
      *
      *  This is equivalent to calling setReceivingHeartbeat(false)
@@ -305,6 +494,10 @@ protected:
 
 
 private:
+    // Maximal size of a GDL90 message, after escape character decoding. The
+    // largest messages are uplink messages with 436 bytes of payload.
+    static constexpr int maxGDLMessageSize = 440;
+
     // Property caches
     QString m_connectivityStatus {};
     QString m_errorString {};
@@ -330,6 +523,27 @@ private:
 
     // Targets
     Traffic::TrafficFactor m_factor;
+
+    // Call signs of GDL90 traffic, by participant address. The strings are
+    // constructed when a target is first seen, or when its call sign changes,
+    // and are then shared by all reports of the target. The cache is cleared
+    // when it holds maxGDLNames entries.
+    struct GDLNamesEntry {
+        std::array<char, 8> callSignBytes {};
+        QString callSign;
+    };
+    QHash<quint32, GDLNamesEntry> m_GDLNames;
+    static constexpr int maxGDLNames = 512;
+
+    // Returns the cache entry for the target of the report, creating or
+    // updating it as needed. The reference is valid until the next call.
+    const GDLNamesEntry& GDLNames(const Traffic::GDL90Report& report);
+
+    // Capture recorder, if recording
+    QPointer<Traffic::TrafficCaptureRecorder> m_captureRecorder;
+
+    // Ingest queue, if enabled
+    std::unique_ptr<IngestQueue> m_ingestQueue;
 };
 
 }
@@ -18,38 +18,38 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
-#include "positioning/PositionProvider.h"
+#include "Clock.h"
+#include "Metrics.h"
+#include "traffic/NMEASentence.h"
 #include "traffic/TrafficDataSource_Abstract.h"
 
 
 // Static Helper functions
 
-auto interpretNMEALatLong(const QString& A, const QString& B) -> qreal
+auto interpretNMEALatLong(QLatin1String A, QLatin1String B, int degreeDigits) -> qreal
 {
-    bool ok1 = false;
-    bool ok2 = false;
-    qreal result = A.leftRef(2).toDouble(&ok1) + A.midRef(2).toDouble(&ok2)/60.0;
-    if (!ok1 || !ok2) {
+    bool ok = false;
+    qreal result = Traffic::NMEASentence::toDegrees(A, degreeDigits, &ok);
+    if (!ok) {
         return qQNaN();
     }
 
-    if ((B == u"S") || (B == u"W")) {
+    if ((B == QLatin1String("S")) || (B == QLatin1String("W"))) {
         result *= -1.0;
     }
     return result;
 }
 
-auto interpretNMEATime(const QString& timeString) -> QDateTime
+auto interpretNMEATime(QLatin1String timeString) -> QDateTime
 {
-    auto HH = timeString.mid(0,2);
-    auto MM = timeString.mid(2,2);
-    auto SS = timeString.mid(4,2);
-    auto MS = timeString.mid(6);
-    QTime time(HH.toInt(), MM.toInt(), SS.toInt());
-    if (MS.isEmpty()) {
-        time = time.addMSecs(qRound(MS.toDouble()*1000.0));
+    auto HH = Traffic::NMEASentence::toInt(Traffic::NMEASentence::mid(timeString, 0, 2));
+    auto MM = Traffic::NMEASentence::toInt(Traffic::NMEASentence::mid(timeString, 2, 2));
+    auto SS = Traffic::NMEASentence::toInt(Traffic::NMEASentence::mid(timeString, 4, 2));
+    QTime time(HH, MM, SS);
+    if (timeString.size() > 6) {
+        time = time.addMSecs(qRound(Traffic::NMEASentence::toDouble(Traffic::NMEASentence::mid(timeString, 6))*1000.0));
     }
-    auto dateTime = QDateTime::currentDateTimeUtc();
+    auto dateTime = Clock::currentDateTimeUtc();
     dateTime.setTime(time);
     return dateTime;
 }
@@ -57,51 +57,38 @@ auto interpretNMEATime(const QString& timeString) -> QDateTime
 
 // Member functions
 
-void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
+void Traffic::TrafficDataSource_Abstract::processFLARMSentence(const QString& sentence)
 {
-    if (sentence.isEmpty()) {
-        return;
-    }
+    auto latin1 = sentence.toLatin1();
+    processFLARMSentence(QLatin1String(latin1));
+}
 
-    // Check that line starts with a dollar sign
-    if (sentence.isEmpty()) {
-        return;
-    }
-    if (sentence[0] != QStringLiteral("$")) {
-        return;
-    }
-    sentence = sentence.mid(1);
 
-    // Check the NMEA checksum
-    auto pieces = sentence.split(QStringLiteral("*"));
-    if (pieces.length() != 2) {
-        return;
-    }
-    sentence = pieces[0];
-    auto checksum = pieces[1].toInt(nullptr, 16);
-    quint8 myChecksum = 0;
-    for(auto && i : sentence) {
-        myChecksum ^= static_cast<quint8>(i.toLatin1());
-    }
-    if (checksum != myChecksum) {
-        return;
+void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QLatin1String sentence)
+{
+    Metrics::Timer timer(Metrics::FLARMSentence);
+
+    if (!m_captureRecorder.isNull()) {
+        m_captureRecorder->record(Traffic::TrafficCaptureRecorder::FLARM, sentence.data(), sentence.size());
     }
 
-    // Split the message into pieces
-    auto arguments = sentence.split(QStringLiteral(","));
-    if (arguments.isEmpty()) {
+    // Check the NMEA checksum and split the message into pieces
+    NMEASentence arguments(sentence);
+    if (!arguments.isValid()) {
         return;
     }
-    auto messageType = arguments.takeFirst();
+
+    switch(NMEASentence::typeCode(arguments.messageType())) {
 
     // NMEA GPS 3D-fix data
-    if (messageType == u"GPGGA") {
-        if (arguments.length() < 9) {
+    case NMEASentence::typeCode("GPGGA"):
+    {
+        if (arguments.size() < 9) {
             return;
         }
 
         // Quality check
-        if (arguments[5] == u"0") {
+        if (arguments[5] == QLatin1String("0")) {
             return;
         }
 
@@ -113,7 +100,7 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
 
         // Get coordinate
         bool ok = false;
-        auto alt = arguments[8].toDouble(&ok);
+        auto alt = NMEASentence::toDouble(arguments[8], &ok);
         if (!ok) {
             m_trueAltitude = {};
             m_trueAltitudeFOM = {};
@@ -128,13 +115,14 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
     }
 
     // Recommended minimum specific GPS/Transit data
-    if (messageType == u"GPRMC") {
-        if (arguments.length() < 8) {
+    case NMEASentence::typeCode("GPRMC"):
+    {
+        if (arguments.size() < 8) {
             return;
         }
 
         // Quality check
-        if (arguments[1] != u"A") {
+        if (arguments[1] != QLatin1String("A")) {
             return;
         }
 
@@ -145,24 +133,8 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
         }
 
         // Get coordinate
-        bool ok1 = false;
-        bool ok2 = false;
-        auto lat = arguments[2].leftRef(2).toDouble(&ok1) + arguments[2].midRef(2).toDouble(&ok2)/60.0;
-        if (!ok1 || !ok2) {
-            return;
-        }
-        if (arguments[3] == u"S") {
-            lat *= -1.0;
-        }
-
-        auto lon = arguments[4].leftRef(3).toDouble(&ok1) + arguments[4].midRef(3).toDouble(&ok2)/60.0;
-        if (!ok1 || !ok2) {
-            return;
-        }
-        if (arguments[5] == u"W") {
-            lon *= -1.0;
-        }
-
+        auto lat = interpretNMEALatLong(arguments[2], arguments[3], 2);
+        auto lon = interpretNMEALatLong(arguments[4], arguments[5], 3);
         QGeoCoordinate coordinate(lat, lon);
         if (!coordinate.isValid()) {
             return;
@@ -170,11 +142,11 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
         if (m_trueAltitudeTimer.isActive()) {
             coordinate.setAltitude(m_trueAltitude.toM());
         }
-        QGeoPositionInfo pInfo(coordinate, QDateTime::currentDateTimeUtc());
+        QGeoPositionInfo pInfo(coordinate, Clock::currentDateTimeUtc());
 
         // Ground speed
         bool ok = false;
-        auto groundSpeed = AviationUnits::Speed::fromKN(arguments[6].toDouble(&ok));
+        auto groundSpeed = AviationUnits::Speed::fromKN(NMEASentence::toDouble(arguments[6], &ok));
         if (!ok) {
             groundSpeed = AviationUnits::Speed::fromKN(qQNaN());
         }
@@ -183,11 +155,8 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
         }
 
         // Track
-        auto TT = arguments[7].toDouble(&ok);
-        if (!ok) {
-            TT = qQNaN();
-        }
-        if (TT != qQNaN()) {
+        auto TT = NMEASentence::toDouble(arguments[7], &ok);
+        if (ok) {
             pInfo.setAttribute(QGeoPositionInfo::Direction, TT );
         }
 
@@ -196,8 +165,8 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
     }
 
     // Data on other proximate aircraft
-    if (messageType == u"PFLAA") {
-
+    case NMEASentence::typeCode("PFLAA"):
+    {
         // Helper variable
         bool ok = false;
 
@@ -206,7 +175,7 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
         //
 
         // Alarm level is mandatory
-        auto alarmLevel = arguments[0].toInt(&ok);
+        auto alarmLevel = NMEASentence::toInt(arguments[0], &ok);
         if (!ok) {
             return;
         }
@@ -216,59 +185,63 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
 
         // Relative vertical information is optional
         // Vertical distance is optional
-        auto vDist = AviationUnits::Distance::fromM(arguments[3].toDouble(&ok));
+        auto vDist = AviationUnits::Distance::fromM(NMEASentence::toDouble(arguments[3], &ok));
         if (!ok) {
             vDist = AviationUnits::Distance::fromM(qQNaN());
         }
 
         // Target type is optional
         Traffic::TrafficFactor::AircraftType type = Traffic::TrafficFactor::unknown;
-        {
-            auto targetType = arguments[10];
-            if (targetType == u"1") {
+        auto targetType = arguments[10];
+        if (targetType.size() == 1) {
+            switch(targetType.at(0).toLatin1()) {
+            case '1':
                 type = Traffic::TrafficFactor::Glider;
-            }
-            if (targetType == u"2") {
+                break;
+            case '2':
                 type = Traffic::TrafficFactor::TowPlane;
-            }
-            if (targetType == u"3") {
+                break;
+            case '3':
                 type = Traffic::TrafficFactor::Copter;
-            }
-            if (targetType == u"4") {
+                break;
+            case '4':
                 type = Traffic::TrafficFactor::Skydiver;
-            }
-            if (targetType == u"5") {
+                break;
+            case '5':
                 type = Traffic::TrafficFactor::Aircraft;
-            }
-            if (targetType == u"6") {
+                break;
+            case '6':
                 type = Traffic::TrafficFactor::HangGlider;
-            }
-            if (targetType == u"7") {
+                break;
+            case '7':
                 type = Traffic::TrafficFactor::Paraglider;
-            }
-            if (targetType == u"8") {
+                break;
+            case '8':
                 type = Traffic::TrafficFactor::Aircraft;
-            }
-            if (targetType == u"9") {
+                break;
+            case '9':
                 type = Traffic::TrafficFactor::Jet;
-            }
-            if (targetType == u"B") {
+                break;
+            case 'B':
                 type = Traffic::TrafficFactor::Balloon;
-            }
-            if (targetType == u"C") {
+                break;
+            case 'C':
                 type = Traffic::TrafficFactor::Airship;
-            }
-            if (targetType == u"D") {
+                break;
+            case 'D':
                 type = Traffic::TrafficFactor::Drone;
-            }
-            if (targetType == u"F") {
+                break;
+            case 'F':
                 type = Traffic::TrafficFactor::StaticObstacle;
+                break;
+            default:
+                break;
             }
         }
 
         // Ground speed it optimal. If ground speed is zero that means:
         // target is on the ground. Ignore these targets, unless they are known static obstacles!
-        auto groundSpeedInMPS = arguments[8].toDouble(&ok);
+        auto groundSpeedInMPS = NMEASentence::toDouble(arguments[8], &ok);
         if (!ok) {
             groundSpeedInMPS = qQNaN();
         }
@@ -277,33 +250,39 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
         }
 
 
-        // Target ID is optional
-        auto targetID = arguments[5];
+        // Target ID is optional. The ID type is 1 for ICAO addresses, 2 for
+        // FLARM IDs and 0 for random IDs.
+        auto addressType = Traffic::TrafficID::OtherAddress;
+        if (arguments[4] == QLatin1String("1")) {
+            addressType = Traffic::TrafficID::ICAOAddress;
+        } else if (arguments[4] == QLatin1String("2")) {
+            addressType = Traffic::TrafficID::FLARMAddress;
+        }
+        auto targetID = Traffic::TrafficID::fromString(arguments[5], addressType);
 
 
         //
         // Handle non-directional targets
         //
-        if (arguments[2] == u"") {
+        if (arguments[2].isEmpty()) {
             // Horizontal distance is mandatory
-            auto hDist = AviationUnits::Distance::fromM(arguments[1].toDouble(&ok));
+            auto hDist = AviationUnits::Distance::fromM(NMEASentence::toDouble(arguments[1], &ok));
             if (!ok) {
                 return;
             }
 
             // Construct a PositionInfo object that contains additional information (such as ground speed, if available)
-            QGeoPositionInfo pInfo(QGeoCoordinate(), QDateTime::currentDateTimeUtc());
-            auto targetGS = arguments[8].toDouble(&ok);
+            QGeoPositionInfo pInfo(QGeoCoordinate(), Clock::currentDateTimeUtc());
+            auto targetGS = NMEASentence::toDouble(arguments[8], &ok);
             if (ok) {
                 pInfo.setAttribute(QGeoPositionInfo::GroundSpeed, targetGS);
             }
-            auto targetVS = arguments[9].toDouble(&ok);
+            auto targetVS = NMEASentence::toDouble(arguments[9], &ok);
             if (ok) {
                 pInfo.setAttribute(QGeoPositionInfo::VerticalSpeed, targetVS);
             }
 
-            m_factor.setData(alarmLevel, targetID, hDist, vDist, type, pInfo, {});
-            emit factorWithoutPosition(m_factor);
+            reportTraffic(false, alarmLevel, targetID, hDist, vDist, type, pInfo, {});
             return;
         }
 
@@ -312,16 +291,16 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
         //
 
         // As a first step, we obtain the target's coordinate. We take our own coordinate as a starting point.
-        auto targetCoordinate = Positioning::PositionProvider::lastValidCoordinate();
+        auto targetCoordinate = ownshipLastValidCoordinate();
         if (!targetCoordinate.isValid()) {
             return;
         }
-        auto relativeNorth = arguments[1].toDouble(&ok);
+        auto relativeNorth = NMEASentence::toDouble(arguments[1], &ok);
         if (!ok) {
             return;
         }
         targetCoordinate = targetCoordinate.atDistanceAndAzimuth(relativeNorth, 0);
-        auto relativeEast = arguments[2].toDouble(&ok);
+        auto relativeEast = NMEASentence::toDouble(arguments[2], &ok);
         if (!ok) {
             return;
         }
@@ -332,34 +311,34 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
         auto hDist = AviationUnits::Distance::fromM(sqrt(relativeNorth*relativeNorth+relativeEast*relativeEast));
 
         // Construct a PositionInfo object that contains additional information (such as ground speed, if available)
-        QGeoPositionInfo pInfo(targetCoordinate, QDateTime::currentDateTimeUtc());
-        auto targetTT = arguments[6].toInt(&ok);
+        QGeoPositionInfo pInfo(targetCoordinate, Clock::currentDateTimeUtc());
+        auto targetTT = NMEASentence::toInt(arguments[6], &ok);
         if (ok) {
             pInfo.setAttribute(QGeoPositionInfo::Direction, targetTT);
         }
-        auto targetGS = arguments[8].toDouble(&ok);
+        auto targetGS = NMEASentence::toDouble(arguments[8], &ok);
         if (ok) {
             pInfo.setAttribute(QGeoPositionInfo::GroundSpeed, targetGS);
         }
-        auto targetVS = arguments[9].toDouble(&ok);
+        auto targetVS = NMEASentence::toDouble(arguments[9], &ok);
         if (ok) {
             pInfo.setAttribute(QGeoPositionInfo::VerticalSpeed, targetVS);
         }
 
         // Construct a traffic object
-        m_factor.setData(alarmLevel, targetID, hDist, vDist, type, pInfo, {});
-        emit factorWithPosition(m_factor);
+        reportTraffic(true, alarmLevel, targetID, hDist, vDist, type, pInfo, {});
         return;
     }
 
     // Self-test result and errors codes
-    if (messageType == u"PFLAE") {
-        if (arguments.length() < 3) {
+    case NMEASentence::typeCode("PFLAE"):
+    {
+        if (arguments.size() < 3) {
             return;
         }
 
-        auto severity = arguments[1];
-        auto errorCode = arguments[2];
+        QString severity = arguments[1];
+        QString errorCode = arguments[2];
 
         QStringList results;
         if (severity == u"0") {
@@ -503,16 +482,16 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
     }
 
     // Debug Information -- Ignore
-    if (messageType == u"PFLAS") {
+    case NMEASentence::typeCode("PFLAS"):
         return;
-    }
 
     // FLARM Heartbeat
-    if (messageType == u"PFLAU") {
+    case NMEASentence::typeCode("PFLAU"):
+    {
         // Heartbeat received.
         setReceivingHeartbeat(true);
 
-        if (arguments.length() < 9) {
+        if (arguments.size() < 9) {
             return;
         }
 
@@ -522,11 +501,11 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
         auto GPS = arguments[2];
         auto Power = arguments[3];
         */
-        auto AlarmLevel = arguments[4];
-        auto RelativeBearing = arguments[5];
-        auto AlarmType = arguments[6];
-        auto RelativeVertical = arguments[7];
-        auto RelativeDistance = arguments[8];
+        QString AlarmLevel = arguments[4];
+        QString RelativeBearing = arguments[5];
+        QString AlarmType = arguments[6];
+        QString RelativeVertical = arguments[7];
+        QString RelativeDistance = arguments[8];
 
         auto wrning = Traffic::Warning(AlarmLevel, RelativeBearing, AlarmType, RelativeVertical, RelativeDistance);
         emit warning(wrning);
@@ -535,32 +514,34 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
     }
 
     // Version information
-    if (messageType == u"PFLAV") {
-        if (arguments.length() < 4) {
+    case NMEASentence::typeCode("PFLAV"):
+    {
+        if (arguments.size() < 4) {
             return;
         }
 
-        emit trafficReceiverHwVersion(arguments[1]);
-        emit trafficReceiverSwVersion(arguments[2]);
-        emit trafficReceiverObVersion(arguments[3]);
+        emit trafficReceiverHwVersion(QString(arguments[1]));
+        emit trafficReceiverSwVersion(QString(arguments[2]));
+        emit trafficReceiverObVersion(QString(arguments[3]));
 
 
         return;
     }
 
     // Garmin's barometric altitude
-    if (messageType == u"PGRMZ") {
-        if (arguments.length() < 2) {
+    case NMEASentence::typeCode("PGRMZ"):
+    {
+        if (arguments.size() < 2) {
             return;
         }
 
         // Quality check
-        if (arguments[1] != u"F") {
+        if (arguments[1] != QLatin1String("F")) {
             return;
         }
 
         bool ok = false;
-        auto barometricAlt = AviationUnits::Distance::fromFT(arguments[0].toDouble(&ok));
+        auto barometricAlt = AviationUnits::Distance::fromFT(NMEASentence::toDouble(arguments[0], &ok));
         if (!ok) {
             return;
         }
@@ -571,4 +552,8 @@ void Traffic::TrafficDataSource_Abstract::processFLARMSentence(QString sentence)
         emit pressureAltitudeUpdated(barometricAlt);
         return;
     }
+
+    default:
+        return;
+    }
 }
@@ -18,14 +18,53 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
-#include "positioning/PositionProvider.h"
+#include <array>
+
+#include "Clock.h"
+#include "traffic/NMEASentence.h"
 #include "traffic/TrafficDataSource_Abstract.h"
 
 
+// Static Helper functions
+
+// Splits an XGPS string at the commas, into views of the original data.
+// Leading and trailing whitespace of the fields is removed. Returns the number of fields found, which might be larger than the size of
+// the array. Fields that do not fit into the array are ignored.
+template<std::size_t N>
+auto splitXGPSString(const QByteArray& data, std::array<QLatin1String, N>& fields) -> int
+{
+    const char* begin = data.constData();
+    int size = data.size();
+    int count = 0;
+    int fieldStart = 0;
+    for(int i=0; i<=size; i++) {
+        if ((i < size) && (begin[i] != ',')) {
+            continue;
+        }
+        if (count < static_cast<int>(N)) {
+            int fieldEnd = i;
+            while ((fieldStart < fieldEnd) && (static_cast<quint8>(begin[fieldStart]) <= ' ')) {
+                fieldStart++;
+            }
+            while ((fieldStart < fieldEnd) && (static_cast<quint8>(begin[fieldEnd-1]) <= ' ')) {
+                fieldEnd--;
+            }
+            fields[count] = QLatin1String(begin+fieldStart, fieldEnd-fieldStart);
+        }
+        count++;
+        fieldStart = i+1;
+    }
+    return count;
+}
+
+
 // Member functions
 
 void Traffic::TrafficDataSource_Abstract::processXGPSString(const QByteArray& data)
 {
+    if (!m_captureRecorder.isNull()) {
+        m_captureRecorder->record(Traffic::TrafficCaptureRecorder::XGPS, data.constData(), data.size());
+    }
 
     //
     // Handle the various message types
@@ -34,35 +73,34 @@ void Traffic::TrafficDataSource_Abstract::processXGPSString(const QByteArray& da
     // Ownship report, serves also as heartbeat message
     if (data.startsWith("XGPS")) {
 
-        QString str = QString::fromLatin1(data);
-        QStringList list = str.split(QLatin1Char(','));
-        if (list.size() != 6) {
+        std::array<QLatin1String, 6> list;
+        if (splitXGPSString(data, list) != 6) {
             return;
         }
 
         bool ok = false;
-        double lon = list[1].toDouble(&ok);
+        double lon = Traffic::NMEASentence::toDouble(list[1], &ok);
         if (!ok) {
             return;
         }
-        double lat = list[2].toDouble(&ok);
+        double lat = Traffic::NMEASentence::toDouble(list[2], &ok);
         if (!ok) {
             return;
         }
-        double alt = list[3].toDouble(&ok);
+        double alt = Traffic::NMEASentence::toDouble(list[3], &ok);
         if (!ok) {
             return;
         }
-        double tt = list[4].toDouble(&ok);
+        double tt = Traffic::NMEASentence::toDouble(list[4], &ok);
         if (!ok) {
             return;
         }
-        double gs = list[5].toDouble(&ok);
+        double gs = Traffic::NMEASentence::toDouble(list[5], &ok);
         if (!ok) {
             return;
         }
 
-        QGeoPositionInfo _geoPos(QGeoCoordinate(lat, lon, alt), QDateTime::currentDateTimeUtc());
+        QGeoPositionInfo _geoPos(QGeoCoordinate(lat, lon, alt), Clock::currentDateTimeUtc());
         _geoPos.setAttribute(QGeoPositionInfo::Direction, tt);
         _geoPos.setAttribute(QGeoPositionInfo::GroundSpeed, gs);
 
@@ -79,45 +117,47 @@ void Traffic::TrafficDataSource_Abstract::processXGPSString(const QByteArray& da
     // Traffic report
     if (data.startsWith("XTRA")) {
 
-        QString str = QString::fromLatin1(data);
-        QStringList list = str.split(QLatin1Char(','));
-        if (list.size() != 10) {
+        std::array<QLatin1String, 10> list;
+        if (splitXGPSString(data, list) != 10) {
             return;
         }
 
+        // The XTRAFFIC specification has the ICAO address in this field.
+        // Using the ICAO type, the target can be fused with reports of other
+        // receivers.
         bool ok = false;
-        QString targetID = list[1];
-        double lat = list[2].toDouble(&ok);
+        auto targetID = Traffic::TrafficID::fromString(list[1], Traffic::TrafficID::ICAOAddress);
+        double lat = Traffic::NMEASentence::toDouble(list[2], &ok);
         if (!ok) {
             return;
         }
-        double lon = list[3].toDouble(&ok);
+        double lon = Traffic::NMEASentence::toDouble(list[3], &ok);
         if (!ok) {
             return;
         }
-        auto alt = AviationUnits::Distance::fromFT(list[4].toDouble(&ok));
+        auto alt = AviationUnits::Distance::fromFT(Traffic::NMEASentence::toDouble(list[4], &ok));
         if (!ok) {
             return;
         }
-        auto vSpeed = AviationUnits::Speed::fromFPM(list[5].toDouble(&ok));
+        auto vSpeed = AviationUnits::Speed::fromFPM(Traffic::NMEASentence::toDouble(list[5], &ok));
         if (!ok) {
             return;
         }
-        double tt = list[7].toDouble(&ok);
+        double tt = Traffic::NMEASentence::toDouble(list[7], &ok);
         if (!ok) {
             return;
         }
-        auto hSpeed = AviationUnits::Speed::fromKN(list[8].toDouble(&ok));
+        auto hSpeed = AviationUnits::Speed::fromKN(Traffic::NMEASentence::toDouble(list[8], &ok));
         if (!ok) {
             return;
         }
-        auto callsign = list[9].simplified();
+        auto callsign = QString::fromLatin1(list[9].data(), list[9].size()).simplified();
 
         auto trafficCoordinate = QGeoCoordinate(lat, lon, alt.toM());
         if (!trafficCoordinate.isValid()) {
             return;
         }
-        QGeoPositionInfo geoPositionInfo(trafficCoordinate, QDateTime::currentDateTimeUtc());
+        QGeoPositionInfo geoPositionInfo(trafficCoordinate, Clock::currentDateTimeUtc());
         geoPositionInfo.setAttribute(QGeoPositionInfo::VerticalSpeed, vSpeed.toMPS());
         geoPositionInfo.setAttribute(QGeoPositionInfo::Direction, tt);
         geoPositionInfo.setAttribute(QGeoPositionInfo::GroundSpeed, hSpeed.toMPS());
@@ -129,17 +169,13 @@ void Traffic::TrafficDataSource_Abstract::processXGPSString(const QByteArray& da
         // is known.
         AviationUnits::Distance hDist {};
         AviationUnits::Distance vDist {};
-        auto* positionProviderPtr = Positioning::PositionProvider::globalInstance();
-        if (positionProviderPtr != nullptr) {
-            auto ownShipCoordinate = positionProviderPtr->positionInfo().coordinate();
-            if (ownShipCoordinate.isValid()) {
-                hDist = AviationUnits::Distance::fromM( ownShipCoordinate.distanceTo(trafficCoordinate) );
-                vDist = alt - AviationUnits::Distance::fromM(ownShipCoordinate.altitude());
-            }
+        auto ownShipCoordinate = ownshipPositionInfo().coordinate();
+        if (ownShipCoordinate.isValid()) {
+            hDist = AviationUnits::Distance::fromM( ownShipCoordinate.distanceTo(trafficCoordinate) );
+            vDist = alt - AviationUnits::Distance::fromM(ownShipCoordinate.altitude());
         }
 
-        m_factor.setData(0 /* Alert Level */, targetID, hDist, vDist, Traffic::TrafficFactor::unknown, geoPositionInfo, callsign);
-        emit factorWithPosition(m_factor);
+        reportTraffic(true, 0 /* Alert Level */, targetID, hDist, vDist, Traffic::TrafficFactor::unknown, geoPositionInfo, callsign);
         return;
     }
 
@@ -18,6 +18,10 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QtEndian>
+#include <QtMath>
+#include <cstring>
+
 #include "traffic/TrafficDataSource_File.h"
 
 
@@ -26,6 +30,7 @@
 Traffic::TrafficDataSource_File::TrafficDataSource_File(const QString& fileName, QObject *parent) :
     TrafficDataSource_Abstract(parent), simulatorFile(fileName) {
 
+    simulatorTimer.setSingleShot(true);
     connect(&simulatorTimer, &QTimer::timeout, this, &Traffic::TrafficDataSource_File::readFromSimulatorStream);
 
     // Initially, set properties
@@ -46,10 +51,55 @@ void Traffic::TrafficDataSource_File::connectToTrafficReceiver()
     // Open the file
     simulatorFile.unsetError();
     if (simulatorFile.open(QIODevice::ReadOnly)) {
-        simulatorTextStream.setDevice(&simulatorFile);
-        simulatorTextStream.setCodec("ISO 8859-1");
-        lastPayload = QString();
+        auto size = simulatorFile.size();
+        data = reinterpret_cast<const char*>(simulatorFile.map(0, size));
+        if (data == nullptr) {
+            fileContent = simulatorFile.readAll();
+            data = fileContent.constData();
+            size = fileContent.size();
+        }
+
+        // Index line offsets. Line i occupies the bytes from lineOffsets[i]
+        // to lineOffsets[i+1]. For capture files, index the frames in the
+        // same way, and ignore a truncated frame at the end of the file.
+        lineOffsets.clear();
+        isCaptureFile = (size >= static_cast<qint64>(sizeof Traffic::TrafficCaptureRecorder::magic))
+                && (memcmp(data, Traffic::TrafficCaptureRecorder::magic, sizeof Traffic::TrafficCaptureRecorder::magic) == 0);
+        if (isCaptureFile) {
+            qint64 position = sizeof Traffic::TrafficCaptureRecorder::magic;
+            lineOffsets.append(position);
+            while (position+Traffic::TrafficCaptureRecorder::frameHeaderSize <= size) {
+                auto frameSize = Traffic::TrafficCaptureRecorder::frameHeaderSize + static_cast<qint64>(qFromLittleEndian<quint32>(data+position+9));
+                if (position+frameSize > size) {
+                    break;
+                }
+                position += frameSize;
+                lineOffsets.append(position);
+            }
+        } else {
+            lineOffsets.append(0);
+            const char* position = data;
+            const char* end = data+size;
+            while (position < end) {
+                auto* newline = static_cast<const char*>(memchr(position, '\n', end-position));
+                if (newline == nullptr) {
+                    break;
+                }
+                position = newline+1;
+                lineOffsets.append(position-data);
+            }
+            if (lineOffsets.last() != size) {
+                lineOffsets.append(size);
+            }
+        }
+
+        nextLine = 0;
+        firstTime = -1;
         lastTime = 0;
+        lastPayload = nullptr;
+        m_processedSentences = 0;
+        m_processingTimeNS = 0;
+        replayClock.start();
         readFromSimulatorStream();
     }
 
@@ -61,8 +111,15 @@ void Traffic::TrafficDataSource_File::connectToTrafficReceiver()
 void Traffic::TrafficDataSource_File::disconnectFromTrafficReceiver()
 {
     // Stop any simulation that might be running
-    simulatorFile.close();
     simulatorTimer.stop();
+    lastPayload = nullptr;
+    lineOffsets.clear();
+    if ((data != nullptr) && fileContent.isEmpty()) {
+        simulatorFile.unmap(reinterpret_cast<uchar*>(const_cast<char*>(data)));
+    }
+    data = nullptr;
+    fileContent.clear();
+    simulatorFile.close();
 
     // Update properties
     setReceivingHeartbeat(false);
@@ -70,39 +127,132 @@ void Traffic::TrafficDataSource_File::disconnectFromTrafficReceiver()
 }
 
 
-void Traffic::TrafficDataSource_File::readFromSimulatorStream()
+auto Traffic::TrafficDataSource_File::parseThroughput() const -> double
 {
-    if ((simulatorFile.error() != QFileDevice::NoError) || simulatorTextStream.atEnd()) {
-        disconnectFromTrafficReceiver();
-        return;
+    if (m_processedSentences == 0) {
+        return qQNaN();
     }
+    return static_cast<double>(m_processedSentences)*1.0e9/static_cast<double>(qMax(m_processingTimeNS, static_cast<qint64>(1)));
+}
 
-    if (!lastPayload.isEmpty()) {
-        processFLARMSentence(lastPayload);
-    }
 
-    // Read line
-    QString line;
-    if (!simulatorTextStream.readLineInto(&line)) {
+void Traffic::TrafficDataSource_File::readFromSimulatorStream()
+{
+    if ((simulatorFile.error() != QFileDevice::NoError) || (data == nullptr)) {
         disconnectFromTrafficReceiver();
         return;
     }
 
-    // Set lastPayload, set timer
-    auto tuple = line.split(QStringLiteral(" "));
-    if (tuple.length() < 2) {
-        return;
+    QElapsedTimer batchTimer;
+    batchTimer.start();
+    QElapsedTimer processingTimer;
+    do {
+        if (lastPayload != nullptr) {
+            processingTimer.start();
+            switch(lastPayloadType) {
+            case Traffic::TrafficCaptureRecorder::FLARM:
+                processFLARMSentence(QLatin1String(lastPayload, lastPayloadSize));
+                break;
+            case Traffic::TrafficCaptureRecorder::GDL90:
+                processGDLMessage(lastPayload, lastPayloadSize);
+                break;
+            case Traffic::TrafficCaptureRecorder::XGPS:
+                processXGPSString(QByteArray::fromRawData(lastPayload, lastPayloadSize));
+                break;
+            }
+            m_processingTimeNS += processingTimer.nsecsElapsed();
+            m_processedSentences++;
+            lastPayload = nullptr;
+        }
+
+        // Read line, stop at the end of the file
+        if (!readNextLine()) {
+            disconnectFromTrafficReceiver();
+            emit replayFinished();
+            return;
+        }
+
+        // Unless we replay as fast as possible, wait until the line is due.
+        // Deadlines are computed from the start of the replay, so that
+        // rounding errors do not accumulate.
+        if (m_replaySpeed > 0.0) {
+            auto dueMS = qRound64(static_cast<double>(lastTime-firstTime)/m_replaySpeed) - replayClock.elapsed();
+            if (dueMS > 0) {
+                simulatorTimer.start(static_cast<int>(dueMS));
+                return;
+            }
+        }
+    } while (batchTimer.elapsed() < maxBatchDurationMS);
+
+    // Give the event loop a chance to run before continuing
+    simulatorTimer.start(0);
+}
+
+
+auto Traffic::TrafficDataSource_File::readNextLine() -> bool
+{
+    while (nextLine+1 < lineOffsets.size()) {
+        const char* line = data+lineOffsets[nextLine];
+        auto length = static_cast<int>(lineOffsets[nextLine+1]-lineOffsets[nextLine]);
+        nextLine++;
+
+        // Frames of capture files, see TrafficCaptureRecorder for the format.
+        // Frames of unknown type are skipped.
+        if (isCaptureFile) {
+            auto type = static_cast<quint8>(line[8]);
+            if ((type != Traffic::TrafficCaptureRecorder::FLARM) && (type != Traffic::TrafficCaptureRecorder::GDL90) && (type != Traffic::TrafficCaptureRecorder::XGPS)) {
+                continue;
+            }
+            lastPayload = line+Traffic::TrafficCaptureRecorder::frameHeaderSize;
+            lastPayloadSize = length-Traffic::TrafficCaptureRecorder::frameHeaderSize;
+            lastPayloadType = static_cast<Traffic::TrafficCaptureRecorder::FrameType>(type);
+            lastTime = qFromLittleEndian<qint64>(line);
+            if (firstTime < 0) {
+                firstTime = lastTime;
+            }
+            return true;
+        }
+
+        // Lines have the form "<time in ms> <sentence>"
+        int pos = 0;
+        qint64 time = 0;
+        while ((pos < length) && (line[pos] >= '0') && (line[pos] <= '9')) {
+            time = 10*time + (line[pos]-'0');
+            pos++;
+        }
+        if ((pos == 0) || (pos >= length) || (line[pos] != ' ')) {
+            continue;
+        }
+        pos++;
+        int payloadLength = 0;
+        while ((pos+payloadLength < length) && (line[pos+payloadLength] != ' ')
+               && (line[pos+payloadLength] != '\r') && (line[pos+payloadLength] != '\n')) {
+            payloadLength++;
+        }
+        if (payloadLength == 0) {
+            continue;
+        }
+
+        lastPayload = line+pos;
+        lastPayloadSize = payloadLength;
+        lastPayloadType = Traffic::TrafficCaptureRecorder::FLARM;
+        lastTime = time;
+        if (firstTime < 0) {
+            firstTime = time;
+        }
+        return true;
     }
-    auto time = tuple[0].toInt();
-    lastPayload = tuple[1];
+    return false;
+}
 
-    if (lastTime == 0) {
-        simulatorTimer.setInterval(0);
-    } else {
-        simulatorTimer.setInterval(time-lastTime);
+
+void Traffic::TrafficDataSource_File::setReplaySpeed(double newReplaySpeed)
+{
+    if (qFuzzyCompare(newReplaySpeed, m_replaySpeed)) {
+        return;
     }
-    simulatorTimer.start();
-    lastTime = time;
+    m_replaySpeed = newReplaySpeed;
+    emit replaySpeedChanged();
 }
 
 
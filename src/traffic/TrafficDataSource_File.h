@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <QElapsedTimer>
 #include <QFile>
 
 #include "traffic/TrafficDataSource_Abstract.h"
@@ -30,7 +31,18 @@ namespace Traffic {
 /*! \brief Traffic receiver: Simulator file with FLARM/NMEA sentences
  *
  *  For testing purposes, this class connects to a simulator file with time
- *  stamps and FLARM/NMEA sentences, as provided by FLARM Inc.
+ *  stamps and FLARM/NMEA sentences, as provided by FLARM Inc.  Alternatively,
+ *  the class replays capture files written by TrafficCaptureRecorder, which
+ *  may contain GDL90, XGPS and FLARM data.  The file format is detected
+ *  automatically.
+ *
+ *  The file is memory-mapped when the connection is established, and the
+ *  offsets of all lines (or frames) are indexed once. The sentences are then passed on to
+ *  processFLARMSentence() directly from the mapped memory, without copying.
+ *  The file can be replayed in real time, accelerated, or as fast as
+ *  possible, see the property replaySpeed. The class counts the sentences and
+ *  measures the time spent to process them, so that the parser throughput can
+ *  be inspected after a replay.
  */
 class TrafficDataSource_File : public TrafficDataSource_Abstract {
     Q_OBJECT
@@ -48,6 +60,38 @@ public:
     ~TrafficDataSource_File() override = default;
 
 
+    //
+    // Properties
+    //
+
+    /*! \brief Replay speed
+     *
+     *  This property holds the factor by which the replay is accelerated. A
+     *  value of 1.0, which is the default, replays the file in real time.
+     *  Values of 10.0 or 100.0 replay the file ten or a hundred times faster.
+     *  A value of 0.0 (or any other non-positive value) replays the file as
+     *  fast as possible, ignoring the time stamps. In that case, sentences are
+     *  processed in batches, so that the event loop remains responsive.
+     *
+     *  Changes take effect with the next call to connectToTrafficReceiver().
+     */
+    Q_PROPERTY(double replaySpeed READ replaySpeed WRITE setReplaySpeed NOTIFY replaySpeedChanged)
+
+    /*! \brief Getter function for the property with the same name
+     *
+     *  @returns Property replaySpeed
+     */
+    double replaySpeed() const
+    {
+        return m_replaySpeed;
+    }
+
+    /*! \brief Setter function for the property with the same name
+     *
+     *  @param newReplaySpeed Property replaySpeed
+     */
+    void setReplaySpeed(double newReplaySpeed);
+
     /*! \brief Getter function for the property with the same name
      *
      *  This method implements the pure virtual method declared by its
@@ -61,6 +105,36 @@ public:
     }
 
 
+    //
+    // Methods
+    //
+
+    /*! \brief Number of sentences processed
+     *
+     *  @returns Number of sentences or messages passed on to the process...()
+     *  methods since the last call to connectToTrafficReceiver()
+     */
+    qint64 processedSentences() const
+    {
+        return m_processedSentences;
+    }
+
+    /*! \brief Parser throughput
+     *
+     *  @returns Mean number of sentences processed per second of processing
+     *  time, since the last call to connectToTrafficReceiver(). Time spent
+     *  waiting for the next time stamp is not counted. Returns NaN if no
+     *  sentence has been processed yet.
+     */
+    double parseThroughput() const;
+
+signals:
+    /*! \brief Notifier signal */
+    void replaySpeedChanged();
+
+    /*! \brief Emitted when the end of the file has been reached */
+    void replayFinished();
+
 public slots:
     /*! \brief Start attempt to connect to traffic receiver
      *
@@ -77,23 +151,47 @@ public slots:
     void disconnectFromTrafficReceiver() override;
 
 private slots:
-    // Read one line from the simulator file's text stream and passes the string
-    // on to processFLARMMessage.  Sets up a timer to read the next line in due
-    // time.
+    // Passes lastPayload on to processFLARMSentence, processGDLMessage or
+    // processXGPSString, as appropriate, and reads the next lines
+    // from the index. Sets up a timer to process the next line in due time.
     void readFromSimulatorStream();
 
     // Update the properties "errorString" and "connectivityStatus".
     void updateProperties();
 
 private:
-    QTextStream textStream;
+    // Reads the next valid line or frame from the index and sets lastPayload,
+    // lastPayloadSize, lastPayloadType and lastTime. Returns false at the end
+    // of the file.
+    bool readNextLine();
+
+    // Maximal time spent in one call to readFromSimulatorStream() when the
+    // file is replayed as fast as possible, in milliseconds
+    static constexpr qint64 maxBatchDurationMS = 20;
+
+    // Property cache
+    double m_replaySpeed {1.0};
 
-    // Simulator related members
+    // Simulator related members. The pointer data points to the mapped file,
+    // or to fileContent if the file could not be mapped. For capture files,
+    // lineOffsets holds the offsets of the frames.
     QFile simulatorFile;
-    QTextStream simulatorTextStream;
+    QByteArray fileContent;
+    const char* data {nullptr};
+    bool isCaptureFile {false};
+    QVector<qint64> lineOffsets;
+    int nextLine {0};
     QTimer simulatorTimer;
-    int lastTime {0};
-    QString lastPayload;
+    QElapsedTimer replayClock;
+    qint64 firstTime {-1};
+    qint64 lastTime {0};
+    const char* lastPayload {nullptr};
+    int lastPayloadSize {0};
+    Traffic::TrafficCaptureRecorder::FrameType lastPayloadType {Traffic::TrafficCaptureRecorder::FLARM};
+
+    // Statistics
+    qint64 m_processedSentences {0};
+    qint64 m_processingTimeNS {0};
 };
 
 }
@@ -18,9 +18,62 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QtMath>
+#include <array>
+#include <cmath>
+
+#include "Clock.h"
+#include "traffic/CRC16.h"
 #include "traffic/TrafficDataSource_Simulate.h"
 
 
+// Static Helper functions
+
+namespace {
+
+// Kinds of simulated aircraft, with FLARM aircraft type, GDL90 emitter
+// category and typical speed
+struct AircraftKind {
+    char FLARMType;
+    quint8 GDLEmitterCategory;
+    double speedInMPS;
+};
+constexpr std::array<AircraftKind, 5> aircraftKinds {{
+    {'1', 9, 28.0},
+    {'2', 1, 40.0},
+    {'3', 7, 50.0},
+    {'8', 1, 60.0},
+    {'9', 6, 120.0}
+}};
+
+// Maximal vertical distance of simulated targets from ownship, in meters
+constexpr double maxVerticalDistanceInM = 300.0;
+
+// Targets that get closer to ownship are placed anew, in meters
+constexpr double minHorizontalDistanceInM = 50.0;
+
+// Appends a signed number to a GDL90 message, as big-endian two's complement
+// with the given number of bytes
+void appendGDLNumber(QByteArray& message, qint64 value, int bytes)
+{
+    for(int i=bytes-1; i>=0; i--) {
+        message.append(static_cast<char>((static_cast<quint64>(value) >> (8U*static_cast<unsigned>(i))) & 0xFFU));
+    }
+}
+
+// GDL90 pressure altitude code, the inverse of
+// TrafficDataSource_Abstract::GDLPressureAltitude()
+auto GDLAltitudeCode(AviationUnits::Distance pressureAltitude) -> quint32
+{
+    if (!pressureAltitude.isFinite()) {
+        return 0xFFF;
+    }
+    return static_cast<quint32>(qBound(0LL, qRound64((pressureAltitude.toFeet()+1000.0)/25.0), 0xFFELL));
+}
+
+}
+
+
 // Member functions
 
 Traffic::TrafficDataSource_Simulate::TrafficDataSource_Simulate(QObject *parent) :
@@ -30,6 +83,9 @@ Traffic::TrafficDataSource_Simulate::TrafficDataSource_Simulate(QObject *parent)
     simulatorTimer.setSingleShot(false);
     connect(&simulatorTimer, &QTimer::timeout, this, &Traffic::TrafficDataSource_Simulate::sendSimulatorData);
 
+    m_trafficTimer.setSingleShot(false);
+    connect(&m_trafficTimer, &QTimer::timeout, this, &Traffic::TrafficDataSource_Simulate::sendSimulatedTraffic);
+
     // Initially, set properties
     TrafficDataSource_Simulate::disconnectFromTrafficReceiver();
 }
@@ -39,6 +95,10 @@ void Traffic::TrafficDataSource_Simulate::connectToTrafficReceiver()
 {
     setConnectivityStatus( tr("Connected.") );
     simulatorTimer.start();
+    if (!m_targets.isEmpty()) {
+        m_trafficClock.start();
+        m_trafficTimer.start();
+    }
 }
 
 
@@ -47,13 +107,314 @@ void Traffic::TrafficDataSource_Simulate::disconnectFromTrafficReceiver()
     setConnectivityStatus( tr("Not connected.") );
     setReceivingHeartbeat(false);
     simulatorTimer.stop();
+    m_trafficTimer.stop();
+}
+
+
+auto Traffic::TrafficDataSource_Simulate::parseScenario(const QString& specification, Traffic::TrafficDataSource_Simulate::Scenario& scenario) -> bool
+{
+    Scenario result;
+    foreach(auto entry, specification.split(',', Qt::SkipEmptyParts)) {
+        auto keyAndValue = entry.split('=');
+        if (keyAndValue.size() != 2) {
+            return false;
+        }
+        auto key = keyAndValue[0].trimmed().toLower();
+        auto value = keyAndValue[1].trimmed().toLower();
+
+        bool ok = true;
+        if (key == u"targets") {
+            result.numberOfTargets = value.toInt(&ok);
+            ok = ok && (result.numberOfTargets >= 0);
+        } else if (key == u"radius") {
+            result.radius = AviationUnits::Distance::fromNM(value.toDouble(&ok));
+            ok = ok && (result.radius.toM() > minHorizontalDistanceInM);
+        } else if (key == u"rate") {
+            result.messagesPerSecond = value.toInt(&ok);
+            ok = ok && (result.messagesPerSecond >= 1) && (result.messagesPerSecond <= 1000);
+        } else if (key == u"seed") {
+            result.seed = value.toUInt(&ok);
+        } else if (key == u"pattern") {
+            if (value == u"straight") {
+                result.motionPattern = Straight;
+            } else if (value == u"circling") {
+                result.motionPattern = Circling;
+            } else if (value == u"converging") {
+                result.motionPattern = Converging;
+            } else {
+                ok = false;
+            }
+        } else if (key == u"protocol") {
+            if (value == u"flarm") {
+                result.protocol = FLARM;
+            } else if (value == u"gdl90") {
+                result.protocol = GDL90;
+            } else if (value == u"xgps") {
+                result.protocol = XGPS;
+            } else {
+                ok = false;
+            }
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+
+    scenario = result;
+    return true;
+}
+
+
+void Traffic::TrafficDataSource_Simulate::placeTarget(SimulatedTarget& target, bool atBorder)
+{
+    const auto& kind = aircraftKinds[target.kind];
+
+    auto bearing = m_randomGenerator.bounded(360.0);
+    auto distance = m_scenario.radius.toM();
+    if (!atBorder) {
+        // Uniform distribution on the disk
+        distance *= sqrt(m_randomGenerator.generateDouble());
+    }
+    target.north = distance*cos(qDegreesToRadians(bearing));
+    target.east = distance*sin(qDegreesToRadians(bearing));
+    target.up = m_randomGenerator.bounded(2.0*maxVerticalDistanceInM)-maxVerticalDistanceInM;
+    target.speedInMPS = kind.speedInMPS*(0.8+m_randomGenerator.bounded(0.4));
+
+    switch(m_scenario.motionPattern) {
+    case Straight:
+        // Targets placed at the border fly into the scenario
+        if (atBorder) {
+            target.trackInDEG = bearing+180.0+m_randomGenerator.bounded(120.0)-60.0;
+        } else {
+            target.trackInDEG = m_randomGenerator.bounded(360.0);
+        }
+        target.turnRateInDEGPS = 0.0;
+        target.climbRateInMPS = m_randomGenerator.bounded(4.0)-2.0;
+        break;
+    case Circling:
+        target.trackInDEG = m_randomGenerator.bounded(360.0);
+        target.turnRateInDEGPS = 10.0+m_randomGenerator.bounded(5.0);
+        if (m_randomGenerator.bounded(2) == 0) {
+            target.turnRateInDEGPS *= -1.0;
+        }
+        target.climbRateInMPS = 0.5+m_randomGenerator.bounded(2.5);
+        break;
+    case Converging:
+        target.trackInDEG = bearing+180.0+m_randomGenerator.bounded(20.0)-10.0;
+        target.turnRateInDEGPS = 0.0;
+        target.climbRateInMPS = -target.up/(distance/target.speedInMPS+1.0);
+        break;
+    }
+    target.trackInDEG = fmod(target.trackInDEG+360.0, 360.0);
+}
+
+
+void Traffic::TrafficDataSource_Simulate::moveTarget(SimulatedTarget& target, double seconds)
+{
+    target.trackInDEG = fmod(target.trackInDEG+target.turnRateInDEGPS*seconds+360.0, 360.0);
+    target.north += target.speedInMPS*cos(qDegreesToRadians(target.trackInDEG))*seconds;
+    target.east += target.speedInMPS*sin(qDegreesToRadians(target.trackInDEG))*seconds;
+    target.up += target.climbRateInMPS*seconds;
+
+    // Keep targets in the vertical range of the scenario. Circling targets
+    // start anew at the bottom, like gliders joining a thermal.
+    if (qAbs(target.up) > maxVerticalDistanceInM) {
+        if (m_scenario.motionPattern == Circling) {
+            target.up = -maxVerticalDistanceInM;
+        } else {
+            target.up = qBound(-maxVerticalDistanceInM, target.up, maxVerticalDistanceInM);
+            target.climbRateInMPS *= -1.0;
+        }
+    }
+
+    // Targets that leave the scenario, or that reach ownship, are placed
+    // anew at the border
+    auto distance = sqrt(target.north*target.north+target.east*target.east);
+    if ((distance > m_scenario.radius.toM()) || (distance < minHorizontalDistanceInM)) {
+        placeTarget(target, true);
+    }
+}
+
+
+void Traffic::TrafficDataSource_Simulate::sendGDLMessage(QByteArray message)
+{
+    auto crc = Traffic::CRC16::gdl90(reinterpret_cast<const quint8*>(message.constData()), message.size());
+    message.append(static_cast<char>(crc & 0xFFU));
+    message.append(static_cast<char>(crc >> 8U));
+
+    QByteArray escapedMessage;
+    escapedMessage.reserve(2*message.size());
+    foreach(auto byte, message) {
+        if ((byte == 0x7d) || (byte == 0x7e)) {
+            escapedMessage.append(0x7d);
+            escapedMessage.append(static_cast<char>(byte ^ 0x20));
+            continue;
+        }
+        escapedMessage.append(byte);
+    }
+    processGDLMessage(escapedMessage);
+}
+
+
+void Traffic::TrafficDataSource_Simulate::sendGDLOwnship()
+{
+    auto coordinate = geoInfo.coordinate();
+
+    // Heartbeat, with "GPS position valid" and "UAT initialized" set
+    QByteArray heartbeat(7, 0);
+    heartbeat[1] = static_cast<char>(0x81);
+    sendGDLMessage(heartbeat);
+
+    // Geometric altitude, in units of 5 ft, with a vertical figure of merit
+    // of 10m
+    if (std::isfinite(coordinate.altitude())) {
+        QByteArray altitude(1, 11);
+        appendGDLNumber(altitude, qRound64(AviationUnits::Distance::fromM(coordinate.altitude()).toFeet()/5.0), 2);
+        appendGDLNumber(altitude, 10, 2);
+        sendGDLMessage(altitude);
+    }
+
+    // Ownship report
+    QByteArray report(1, 10);
+    report.append('\0');
+    appendGDLNumber(report, 0, 3);
+    appendGDLNumber(report, qRound64(coordinate.latitude()*0x800000/180.0), 3);
+    appendGDLNumber(report, qRound64(coordinate.longitude()*0x800000/180.0), 3);
+    auto altitudeCode = GDLAltitudeCode(barometricHeight);
+    report.append(static_cast<char>(altitudeCode >> 4U));
+    report.append(static_cast<char>(((altitudeCode & 0x0FU) << 4U) | 0x09U));
+    report.append(static_cast<char>(0xAA));
+    auto GS = qBound(0LL, qRound64(AviationUnits::Speed::fromMPS(geoInfo.attribute(QGeoPositionInfo::GroundSpeed)).toKN()), 0xFFELL);
+    if (!geoInfo.hasAttribute(QGeoPositionInfo::GroundSpeed)) {
+        GS = 0xFFF;
+    }
+    report.append(static_cast<char>(GS >> 4U));
+    report.append(static_cast<char>(((GS & 0x0FU) << 4U) | 0x00U));
+    report.append('\0');
+    report.append(static_cast<char>(qRound(geoInfo.attribute(QGeoPositionInfo::Direction)*256.0/360.0) & 0xFF));
+    report.append(1);
+    report.append("OWNSHIP ", 8);
+    report.append('\0');
+    sendGDLMessage(report);
+}
+
+
+void Traffic::TrafficDataSource_Simulate::sendTarget(const SimulatedTarget& target)
+{
+    const auto& kind = aircraftKinds[target.kind];
+    auto distance = sqrt(target.north*target.north+target.east*target.east);
+    auto callSign = QStringLiteral("SIM%1").arg(target.address & 0xFFFFU, 4, 10, QChar('0')).toLatin1();
+
+    // Alarm levels, as a FLARM device might issue them
+    int alarmLevel = 0;
+    if (qAbs(target.up) < 150.0) {
+        if (distance < 200.0) {
+            alarmLevel = 3;
+        } else if (distance < 400.0) {
+            alarmLevel = 2;
+        } else if (distance < 800.0) {
+            alarmLevel = 1;
+        }
+    }
+
+    switch(m_scenario.protocol) {
+    case FLARM:
+    {
+        QByteArray sentence = "PFLAA,";
+        sentence += QByteArray::number(alarmLevel) + ',';
+        sentence += QByteArray::number(qRound(target.north)) + ',';
+        sentence += QByteArray::number(qRound(target.east)) + ',';
+        sentence += QByteArray::number(qRound(target.up)) + ",2,";
+        sentence += QByteArray::number(target.address, 16).toUpper().rightJustified(6, '0') + ',';
+        sentence += QByteArray::number(qRound(target.trackInDEG) % 360) + ',';
+        sentence += QByteArray::number(target.turnRateInDEGPS, 'f', 1) + ',';
+        sentence += QByteArray::number(qRound(target.speedInMPS)) + ',';
+        sentence += QByteArray::number(target.climbRateInMPS, 'f', 1) + ',';
+        sentence += kind.FLARMType;
+
+        quint8 checksum = 0;
+        foreach(auto byte, sentence) {
+            checksum ^= static_cast<quint8>(byte);
+        }
+        sentence = '$' + sentence + '*' + QByteArray::number(checksum, 16).toUpper().rightJustified(2, '0');
+        processFLARMSentence(QLatin1String(sentence.constData(), sentence.size()));
+        return;
+    }
+
+    case GDL90:
+    case XGPS:
+        break;
+    }
+
+    // GDL90 and XGPS transmit absolute positions
+    auto ownshipCoordinate = geoInfo.coordinate();
+    auto coordinate = ownshipCoordinate.atDistanceAndAzimuth(target.north, 0).atDistanceAndAzimuth(target.east, 90);
+    auto altitudeInM = std::isfinite(ownshipCoordinate.altitude()) ? ownshipCoordinate.altitude()+target.up : target.up;
+
+    if (m_scenario.protocol == GDL90) {
+        QByteArray report(1, 20);
+        report.append(static_cast<char>(alarmLevel > 0 ? 0x10 : 0x00));
+        appendGDLNumber(report, target.address, 3);
+        appendGDLNumber(report, qRound64(coordinate.latitude()*0x800000/180.0), 3);
+        appendGDLNumber(report, qRound64(coordinate.longitude()*0x800000/180.0), 3);
+        auto altitudeCode = GDLAltitudeCode(barometricHeight+AviationUnits::Distance::fromM(target.up));
+        report.append(static_cast<char>(altitudeCode >> 4U));
+        report.append(static_cast<char>(((altitudeCode & 0x0FU) << 4U) | 0x09U));
+        report.append(static_cast<char>(0xAA));
+        auto GS = qBound(0LL, qRound64(AviationUnits::Speed::fromMPS(target.speedInMPS).toKN()), 0xFFELL);
+        auto VS = qBound(-510LL, qRound64(AviationUnits::Speed::fromMPS(target.climbRateInMPS).toFPM()/64.0), 510LL) & 0xFFF;
+        report.append(static_cast<char>(GS >> 4U));
+        report.append(static_cast<char>(((GS & 0x0FU) << 4U) | (VS >> 8U)));
+        report.append(static_cast<char>(VS & 0xFF));
+        report.append(static_cast<char>(qRound(target.trackInDEG*256.0/360.0) & 0xFF));
+        report.append(static_cast<char>(kind.GDLEmitterCategory));
+        report.append(callSign.leftJustified(8, ' ', true));
+        report.append('\0');
+        sendGDLMessage(report);
+        return;
+    }
+
+    QByteArray string = "XTRA";
+    string += ',' + QByteArray::number(target.address, 16).toUpper().rightJustified(6, '0');
+    string += ',' + QByteArray::number(coordinate.latitude(), 'f', 6);
+    string += ',' + QByteArray::number(coordinate.longitude(), 'f', 6);
+    string += ',' + QByteArray::number(qRound(AviationUnits::Distance::fromM(altitudeInM).toFeet()));
+    string += ',' + QByteArray::number(qRound(AviationUnits::Speed::fromMPS(target.climbRateInMPS).toFPM()));
+    string += ",1";
+    string += ',' + QByteArray::number(qRound(target.trackInDEG) % 360);
+    string += ',' + QByteArray::number(qRound(AviationUnits::Speed::fromMPS(target.speedInMPS).toKN()));
+    string += ',' + callSign;
+    processXGPSString(string);
+}
+
+
+void Traffic::TrafficDataSource_Simulate::sendSimulatedTraffic()
+{
+    auto seconds = static_cast<double>(m_trafficClock.restart())/1000.0;
+    if (!geoInfo.coordinate().isValid()) {
+        return;
+    }
+    for(auto& target : m_targets) {
+        moveTarget(target, seconds);
+        sendTarget(target);
+    }
 }
 
 
 void Traffic::TrafficDataSource_Simulate::sendSimulatorData()
 {
 
-    geoInfo.setTimestamp( QDateTime::currentDateTimeUtc() );
+    geoInfo.setTimestamp( Clock::currentDateTimeUtc() );
+
+    // In GDL90 scenarios, ownship data is sent through the GDL90 parser, so
+    // that the parser knows the pressure altitude of ownship
+    if (!m_targets.isEmpty() && (m_scenario.protocol == GDL90) && geoInfo.isValid()) {
+        sendGDLOwnship();
+        return;
+    }
+
     if (geoInfo.isValid()) {
         emit positionUpdated( Positioning::PositionInfo(geoInfo) );
         setReceivingHeartbeat(true);
@@ -64,3 +425,29 @@ void Traffic::TrafficDataSource_Simulate::sendSimulatorData()
     pressureAltitudeUpdated(barometricHeight);
 }
 
+
+void Traffic::TrafficDataSource_Simulate::setScenario(const Traffic::TrafficDataSource_Simulate::Scenario& scenario)
+{
+    m_scenario = scenario;
+    m_randomGenerator.seed(scenario.seed);
+
+    m_targets.clear();
+    m_targets.reserve(scenario.numberOfTargets);
+    for(int i=0; i<scenario.numberOfTargets; i++) {
+        SimulatedTarget target;
+        target.address = 0xDD0000U + static_cast<quint32>(i);
+        target.kind = static_cast<int>(m_randomGenerator.bounded(static_cast<quint32>(aircraftKinds.size())));
+        placeTarget(target, false);
+        m_targets.append(target);
+    }
+
+    m_trafficTimer.setInterval(1000/scenario.messagesPerSecond);
+    if (m_targets.isEmpty()) {
+        m_trafficTimer.stop();
+        return;
+    }
+    if (simulatorTimer.isActive()) {
+        m_trafficClock.start();
+        m_trafficTimer.start();
+    }
+}
@@ -20,7 +20,9 @@
 
 #pragma once
 
+#include <QElapsedTimer>
 #include <QGeoPositionInfo>
+#include <QRandomGenerator>
 
 #include "traffic/TrafficDataSource_Abstract.h"
 
@@ -29,12 +31,62 @@ namespace Traffic {
 
 /*! \brief Traffic receiver: Simulator that provides constant data
  *
- *  For testing purposes, this class provides constant traffic data.
+ *  For testing purposes, this class provides constant ownship data.  In
+ *  addition, it can simulate a scenario with a large number of traffic
+ *  targets, in order to load-test the traffic pipeline, the GUI and the
+ *  generation of warnings.  The simulated targets are encoded as FLARM, GDL90
+ *  or XGPS data and fed through the parsers of TrafficDataSource_Abstract, so
+ *  that the data takes the same path as data from a real traffic receiver.
  */
 class TrafficDataSource_Simulate : public TrafficDataSource_Abstract {
     Q_OBJECT
 
 public:
+    /*! \brief Protocol used to transmit simulated traffic */
+    enum Protocol
+    {
+        FLARM,
+        GDL90,
+        XGPS
+    };
+    Q_ENUM(Protocol)
+
+    /*! \brief Motion of simulated traffic */
+    enum MotionPattern
+    {
+        /*! \brief Targets fly straight lines and re-enter the scenario at its border */
+        Straight,
+
+        /*! \brief Targets circle and climb, as gliders in a thermal */
+        Circling,
+
+        /*! \brief Targets fly towards ownship */
+        Converging
+    };
+    Q_ENUM(MotionPattern)
+
+    /*! \brief Scenario of simulated traffic */
+    struct Scenario
+    {
+        /*! \brief Number of traffic targets */
+        int numberOfTargets {0};
+
+        /*! \brief Radius of the disk around ownship that contains the targets */
+        AviationUnits::Distance radius {AviationUnits::Distance::fromNM(5.0)};
+
+        /*! \brief Motion of the targets */
+        MotionPattern motionPattern {Straight};
+
+        /*! \brief Protocol used to transmit the targets */
+        Protocol protocol {FLARM};
+
+        /*! \brief Number of reports per target and second */
+        int messagesPerSecond {1};
+
+        /*! \brief Seed for the random generator, so that scenarios are reproducible */
+        quint32 seed {1};
+    };
+
     /*! \brief Default constructor
      *
      *  @param parent The standard QObject parent pointer
@@ -108,16 +160,87 @@ public slots:
         barometricHeight = barAlt;
     }
 
+    /*! \brief Set scenario of simulated traffic
+     *
+     *  The targets are placed at random positions around ownship.  If the
+     *  simulator is connected, traffic is sent immediately.
+     *
+     *  @param scenario Scenario.  If the number of targets is zero, no traffic
+     *  is simulated.
+     */
+    void setScenario(const Traffic::TrafficDataSource_Simulate::Scenario& scenario);
+
+    /*! \brief Read scenario from a string
+     *
+     *  The string is a comma-separated list of entries of the form
+     *  "key=value", such as "targets=200,protocol=gdl90,pattern=circling".
+     *  The following keys are recognized: "targets", "radius" (in nautical
+     *  miles), "pattern" ("straight", "circling" or "converging"),
+     *  "protocol" ("flarm", "gdl90" or "xgps"), "rate" (messages per target
+     *  and second) and "seed".  Keys that are not present keep their default
+     *  values.
+     *
+     *  @param specification String describing the scenario
+     *
+     *  @param scenario Scenario, set if the string is well-formed
+     *
+     *  @returns True if the string is well-formed
+     */
+    static bool parseScenario(const QString& specification, Traffic::TrafficDataSource_Simulate::Scenario& scenario);
+
 private slots:
     // Send out simulated data. This slot will be called once per second once connectToTrafficReceiver() has been called
     void sendSimulatorData();
 
+    // Move the simulated targets and send one report for each. This slot is
+    // called scenario.messagesPerSecond times per second while connected.
+    void sendSimulatedTraffic();
+
 private:
+    // Simulated traffic target. Position and altitude are relative to
+    // ownship, in meters.
+    struct SimulatedTarget {
+        double north {0.0};
+        double east {0.0};
+        double up {0.0};
+        double trackInDEG {0.0};
+        double speedInMPS {0.0};
+        double turnRateInDEGPS {0.0};
+        double climbRateInMPS {0.0};
+        quint32 address {0};
+        int kind {0};
+    };
+
+    // Places a target at a random position, either anywhere in the scenario
+    // or at its border
+    void placeTarget(SimulatedTarget& target, bool atBorder);
+
+    // Moves a target
+    void moveTarget(SimulatedTarget& target, double seconds);
+
+    // Encodes a target in the protocol of the scenario and feeds it to the
+    // parser
+    void sendTarget(const SimulatedTarget& target);
+
+    // Encodes ownship as GDL90 heartbeat, geometric altitude and ownship
+    // report, and feeds these messages to the parser
+    void sendGDLOwnship();
+
+    // Adds checksum and escape characters to a GDL90 message and feeds it to
+    // the parser
+    void sendGDLMessage(QByteArray message);
 
     // Simulator related members
     QTimer simulatorTimer;
     QGeoPositionInfo geoInfo;
     AviationUnits::Distance barometricHeight;
+
+    // Traffic scenario
+    Scenario m_scenario;
+    QVector<SimulatedTarget> m_targets;
+    QRandomGenerator m_randomGenerator;
+    QTimer m_trafficTimer;
+    QElapsedTimer m_trafficClock;
 };
 
 }
@@ -26,14 +26,15 @@
 Traffic::TrafficDataSource_Tcp::TrafficDataSource_Tcp(QString hostName, quint16 port, QObject *parent) :
     Traffic::TrafficDataSource_AbstractSocket(parent), m_hostName(std::move(hostName)), m_port(port) {
 
-    // Create socket
+    // Create socket. The socket is made a child of this object, so that it
+    // moves along when the source is moved to another thread.
+    m_socket.setParent(this);
     connect(&m_socket, &QTcpSocket::errorOccurred, this, &Traffic::TrafficDataSource_Tcp::onErrorOccurred);
     connect(&m_socket, &QTcpSocket::readyRead, this, &Traffic::TrafficDataSource_Tcp::onReadyRead);
     connect(&m_socket, &QTcpSocket::stateChanged, this, &Traffic::TrafficDataSource_Tcp::onStateChanged);
 
-    // Set up text stream
-    m_textStream.setDevice(&m_socket);
-    m_textStream.setCodec("ISO 8859-1");
+    // Set up buffer
+    m_buffer.reserve(maxLineLength);
 
     //
     // Initialize properties
@@ -57,8 +58,8 @@ void Traffic::TrafficDataSource_Tcp::connectToTrafficReceiver()
 
     m_socket.abort();
     setErrorString();
+    m_buffer.clear();
     m_socket.connectToHost(m_hostName, m_port);
-    m_textStream.setDevice(&m_socket);
 
     // Update properties
     onStateChanged(m_socket.state());
@@ -81,9 +82,32 @@ void Traffic::TrafficDataSource_Tcp::disconnectFromTrafficReceiver()
 void Traffic::TrafficDataSource_Tcp::onReadyRead()
 {
 
-    QString sentence;
-    while( m_textStream.readLineInto(&sentence) ) {
-        processFLARMSentence(sentence);
+    // Append all available data to the buffer
+    auto available = m_socket.bytesAvailable();
+    if (available <= 0) {
+        return;
+    }
+    auto oldSize = m_buffer.size();
+    m_buffer.resize(oldSize+static_cast<int>(available));
+    auto bytesRead = m_socket.read(m_buffer.data()+oldSize, available);
+    m_buffer.resize(oldSize+static_cast<int>(qMax(bytesRead, static_cast<qint64>(0))));
+
+    // Process all complete lines. The sentences are Latin-1 text and can be
+    // passed on without conversion.
+    const char* data = m_buffer.constData();
+    int begin = 0;
+    for(int i=oldSize; i<m_buffer.size(); i++) {
+        if (data[i] != '\n') {
+            continue;
+        }
+        processFLARMSentence(QLatin1String(data+begin, i-begin));
+        begin = i+1;
+    }
+
+    // Keep the incomplete last line, unless it is unreasonably long
+    m_buffer.remove(0, begin);
+    if (m_buffer.size() > maxLineLength) {
+        m_buffer.clear();
     }
 
 }
@@ -81,13 +81,21 @@ public slots:
     void disconnectFromTrafficReceiver() override;
 
 private slots:
-    // Read lines from the socket's text stream and passes the string on to
-    // processFLARMMessage.
+    // Reads data from the socket, splits it into lines and passes the lines
+    // on to processFLARMSentence, as views into m_buffer.
     void onReadyRead();
 
 private:
+    // Maximal length of a line. NMEA sentences are much shorter; data without
+    // line breaks is discarded once the buffer exceeds this size.
+    static constexpr int maxLineLength = 4096;
+
     QTcpSocket m_socket;
-    QTextStream m_textStream;
+
+    // Bytes received, but not yet processed. This is always an incomplete
+    // line.
+    QByteArray m_buffer;
+
     QString m_hostName;
     quint16 m_port;
 };
@@ -18,8 +18,6 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
-#include <QNetworkDatagram>
-
 #include "positioning/PositionProvider.h"
 #include "traffic/TrafficDataSource_Udp.h"
 
@@ -30,6 +28,7 @@ Traffic::TrafficDataSource_Udp::TrafficDataSource_Udp(quint16 port, QObject *par
     Traffic::TrafficDataSource_AbstractSocket(parent), m_port(port) {
 
     // Initialize timers
+    m_trueAltitudeTimer.setParent(this);
     m_trueAltitudeTimer.setInterval(5s);
     m_trueAltitudeTimer.setSingleShot(true);
 
@@ -84,38 +83,68 @@ void Traffic::TrafficDataSource_Udp::disconnectFromTrafficReceiver()
 }
 
 
-void Traffic::TrafficDataSource_Udp::onReadyRead()
+auto Traffic::TrafficDataSource_Udp::isDuplicate(uint datagramHash) -> bool
 {
-    // Paranoid safety checks
-    if (m_socket.isNull()) {
-        return;
+    if (receivedDatagramHashSet.contains(datagramHash)) {
+        return true;
+    }
+
+    if (receivedDatagramHashes.size() < maxDatagramHashes) {
+        receivedDatagramHashes.append(datagramHash);
+    } else {
+        receivedDatagramHashSet.remove(receivedDatagramHashes[nextHashIndex]);
+        receivedDatagramHashes[nextHashIndex] = datagramHash;
     }
+    receivedDatagramHashSet.insert(datagramHash);
+    nextHashIndex = (nextHashIndex+1) % maxDatagramHashes;
+    return false;
+}
 
-    // Read datagrams
-    while (m_socket->hasPendingDatagrams()) {
-        QByteArray data = m_socket->receiveDatagram().data();
 
-        // Return immediately if the datagram has already been received.
-        auto currentDatagramHash = qHash(data);
-        foreach(auto hash, receivedDatagramHashes) {
-            if (hash == currentDatagramHash) {
-                return;
-            }
+void Traffic::TrafficDataSource_Udp::onReadyRead()
+{
+    // Read all pending datagrams. Each datagram is read into the same buffer,
+    // so that no memory is allocated in the common case.
+    while (!m_socket.isNull() && m_socket->hasPendingDatagrams()) {
+        auto datagramSize = m_socket->pendingDatagramSize();
+        if (datagramSize < 0) {
+            break;
+        }
+        if (m_datagramBuffer.size() < datagramSize) {
+            m_datagramBuffer.resize(static_cast<int>(datagramSize));
+        }
+        // A negative size indicates an error. Stop reading, because the
+        // datagram might remain pending and the loop would never end.
+        auto size = m_socket->readDatagram(m_datagramBuffer.data(), m_datagramBuffer.size());
+        if (size < 0) {
+            break;
+        }
+        if (size == 0) {
+            continue;
+        }
+        auto data = QByteArray::fromRawData(m_datagramBuffer.constData(), static_cast<int>(size));
+
+        // Skip the datagram if it has already been received.
+        if (isDuplicate(qHash(data))) {
+            continue;
         }
-        receivedDatagramHashes[nextHashIndex] = currentDatagramHash;
-        nextHashIndex = (nextHashIndex+1) % receivedDatagramHashes.size();
 
         // Process datagrams, depending on content type
         if (data.startsWith("XGPS") || data.startsWith("XTRA")) {
             processXGPSString(data);
         } else {
-            // Split data into raw messages
-            foreach(auto rawMessage, data.split(0x7e)) {
-                if (!rawMessage.isEmpty()) {
-                    processGDLMessage(rawMessage);
+            // Split data into raw messages, and process them in place
+            const char* rawData = data.constData();
+            int begin = 0;
+            for(int i=0; i<=data.size(); i++) {
+                if ((i < data.size()) && (rawData[i] != 0x7e)) {
+                    continue;
                 }
+                if (i > begin) {
+                    processGDLMessage(rawData+begin, i-begin);
+                }
+                begin = i+1;
             }
-
         }
     }
 
@@ -22,6 +22,7 @@
 
 
 #include <QPointer>
+#include <QSet>
 #include <QUdpSocket>
 
 #include "traffic/TrafficDataSource_AbstractSocket.h"
@@ -90,12 +91,23 @@ private:
     QPointer<QUdpSocket> m_socket;
     quint16 m_port;
 
-    // We use this vector to store the last 512 datatgram hashes in a circular array.
-    // This is used to sort out doubly sent datagrams. The nextHashIndex points to
-    // the next vector entry that will be re-written.
-    QVector<uint> receivedDatagramHashes {512, 0};
+    // Checks if a datagram with the given hash has been received recently.
+    // If not, the hash is recorded and the method returns false.
+    bool isDuplicate(uint datagramHash);
+
+    // We store the hashes of the last 512 datagrams, in order to sort out
+    // doubly sent datagrams. The vector receivedDatagramHashes is used as a
+    // circular array, where nextHashIndex points to the next vector entry that
+    // will be re-written. The set receivedDatagramHashSet contains the same
+    // hashes, for lookup in constant time.
+    static constexpr int maxDatagramHashes = 512;
+    QVector<uint> receivedDatagramHashes;
+    QSet<uint> receivedDatagramHashSet;
     int nextHashIndex {0};
 
+    // Buffer for reading datagrams, reused to avoid allocations
+    QByteArray m_datagramBuffer;
+
     // GPS altitude of owncraft
     AviationUnits::Distance m_trueAltitude;
     AviationUnits::Distance m_trueAltitude_FOM;
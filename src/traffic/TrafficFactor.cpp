@@ -19,33 +19,126 @@
  ***************************************************************************/
 
 
+#include "Clock.h"
 #include "Settings.h"
 #include "traffic/TrafficFactor.h"
 
 
 Traffic::TrafficFactor::TrafficFactor(QObject *parent) : QObject(parent)
 {  
+    timeoutCounter.setParent(this);
     timeoutCounter.setSingleShot(true);
 
-    // Compute derived properties and set bindings
-    connect(this, &Traffic::TrafficFactor::alarmLevelChanged, this, &Traffic::TrafficFactor::setColor);
+    // Compute derived properties. These are updated in flushChanges(),
+    // whenever the properties they depend on change.
     setColor();
-
-    connect(this, &Traffic::TrafficFactor::coordinateChanged, this, &Traffic::TrafficFactor::setDescription);
-    connect(this, &Traffic::TrafficFactor::typeChanged, this, &Traffic::TrafficFactor::setDescription);
-    connect(this, &Traffic::TrafficFactor::vDistChanged, this, &Traffic::TrafficFactor::setDescription);
     setDescription();
-
-    connect(this, &Traffic::TrafficFactor::colorChanged, this, &Traffic::TrafficFactor::setIcon);
-    connect(this, &Traffic::TrafficFactor::positionInfoChanged, this, &Traffic::TrafficFactor::setIcon);
     setIcon();
 
-    connect(this, &Traffic::TrafficFactor::positionInfoChanged, this, &Traffic::TrafficFactor::setValid);
     connect(&timeoutCounter, &QTimer::timeout, this, &Traffic::TrafficFactor::setValid);
     setValid();
 }
 
 
+void Traffic::TrafficFactor::extrapolate(const QDateTime& time)
+{
+    auto newCoordinate = _positionInfo.coordinate();
+
+    if (newCoordinate.isValid()
+            && _positionInfo.hasAttribute(QGeoPositionInfo::Direction)
+            && _positionInfo.hasAttribute(QGeoPositionInfo::GroundSpeed)) {
+        auto dt = qBound(0.0, static_cast<double>(_positionInfo.timestamp().msecsTo(time))/1000.0, static_cast<double>(timeoutMS)/1000.0);
+        auto TT = _positionInfo.attribute(QGeoPositionInfo::Direction);
+        auto GS = _positionInfo.attribute(QGeoPositionInfo::GroundSpeed);
+        auto VS = 0.0;
+        if (_positionInfo.hasAttribute(QGeoPositionInfo::VerticalSpeed)) {
+            VS = _positionInfo.attribute(QGeoPositionInfo::VerticalSpeed);
+        }
+        if (qIsFinite(TT) && qIsFinite(GS) && (GS > 0.0)) {
+            newCoordinate = newCoordinate.atDistanceAndAzimuth(GS*dt, TT, qIsFinite(VS) ? VS*dt : 0.0);
+        }
+    }
+
+    if (newCoordinate == m_extrapolatedCoordinate) {
+        return;
+    }
+    m_extrapolatedCoordinate = newCoordinate;
+    m_pendingChanges |= ExtrapolatedCoordinateChange;
+    if (!m_batchUpdates) {
+        flushChanges();
+    }
+}
+
+
+void Traffic::TrafficFactor::flushChanges()
+{
+    auto changes = m_pendingChanges;
+    m_pendingChanges = 0;
+    if (changes == 0) {
+        return;
+    }
+
+    // If the ID changed, do not animate property changes in the GUI.
+    if ((changes & IDChange) != 0U) {
+        setAnimate(false);
+    }
+
+    // Emit notifier signals as appropriate
+    if ((changes & AlarmLevelChange) != 0U) {
+        emit alarmLevelChanged();
+    }
+    if ((changes & CoordinateChange) != 0U) {
+        emit coordinateChanged();
+    }
+    if ((changes & ExtrapolatedCoordinateChange) != 0U) {
+        emit extrapolatedCoordinateChanged();
+    }
+    if ((changes & HDistChange) != 0U) {
+        emit hDistChanged();
+    }
+    if ((changes & IDChange) != 0U) {
+        emit IDChanged();
+    }
+    if ((changes & PositionInfoChange) != 0U)  {
+        emit positionInfoChanged();
+    }
+    if ((changes & TTChange) != 0U) {
+        emit ttChanged();
+    }
+    if ((changes & GroundSpeedChange) != 0U) {
+        emit groundSpeedChanged();
+    }
+    if ((changes & ClimbRateChange) != 0U) {
+        emit climbRateChanged();
+    }
+    if ((changes & TypeChange) != 0U) {
+        emit typeChanged();
+    }
+    if ((changes & VDistChange) != 0U) {
+        emit vDistChanged();
+    }
+    if ((changes & CallSignChange) != 0U) {
+        emit callSignChanged();
+    }
+
+    // Update derived properties, once for all changes
+    if ((changes & AlarmLevelChange) != 0U) {
+        setColor();
+    }
+    if ((changes & (CoordinateChange|TypeChange|VDistChange|ClimbRateChange|CallSignChange)) != 0U) {
+        setDescription();
+    }
+    if ((changes & (AlarmLevelChange|PositionInfoChange)) != 0U) {
+        setIcon();
+    }
+    if ((changes & ValidChange) != 0U) {
+        emit validChanged();
+    }
+
+    setAnimate(true);
+}
+
+
 auto Traffic::TrafficFactor::hasHigherPriorityThan(const TrafficFactor &rhs) const -> bool
 {
     // Criterion 1: Valid instances have higher priority than invalid ones
@@ -82,6 +175,15 @@ void Traffic::TrafficFactor::setAnimate(bool a)
 }
 
 
+void Traffic::TrafficFactor::setBatchUpdates(bool batchUpdates)
+{
+    m_batchUpdates = batchUpdates;
+    if (!m_batchUpdates) {
+        flushChanges();
+    }
+}
+
+
 void Traffic::TrafficFactor::setColor()
 {
     QString newColor = QStringLiteral("red");
@@ -101,90 +203,99 @@ void Traffic::TrafficFactor::setColor()
 }
 
 
-void Traffic::TrafficFactor::setData(int newAlarmLevel, const QString& newID, AviationUnits::Distance newHDist, AviationUnits::Distance newVDist, AircraftType newType, const QGeoPositionInfo& newPositionInfo, const QString & newCallSign)
+void Traffic::TrafficFactor::setData(int newAlarmLevel, quint32 newID, AviationUnits::Distance newHDist, AviationUnits::Distance newVDist, AircraftType newType, const QGeoPositionInfo& newPositionInfo, const QString & newCallSign)
 {
-    // Set properties
-    bool hasAlarmLevelChanged = (_alarmLevel != newAlarmLevel);
+    // Set properties, and record the changes
+    quint32 changes = 0;
+    if (_alarmLevel != newAlarmLevel) {
+        changes |= AlarmLevelChange;
+    }
     _alarmLevel = newAlarmLevel;
 
-    bool hasIDChanged = (_ID != newID);
-    _ID = newID;
+    if (m_numericID != newID) {
+        changes |= IDChange;
+    }
+    m_numericID = newID;
 
-    bool hasCoordinateChanged = (coordinate() != newPositionInfo.coordinate());
-    bool hasTTChanged = false;
-    if (_positionInfo.hasAttribute(QGeoPositionInfo::Direction) != newPositionInfo.hasAttribute(QGeoPositionInfo::Direction)) {
-        hasTTChanged = true;
-    } else {
-        if (_positionInfo.attribute(QGeoPositionInfo::Direction) != newPositionInfo.attribute(QGeoPositionInfo::Direction)) {
-            hasTTChanged = true;
-        }
+    if (coordinate() != newPositionInfo.coordinate()) {
+        changes |= CoordinateChange;
+    }
+    if (m_extrapolatedCoordinate != newPositionInfo.coordinate()) {
+        m_extrapolatedCoordinate = newPositionInfo.coordinate();
+        changes |= ExtrapolatedCoordinateChange;
+    }
+    if ((_positionInfo.hasAttribute(QGeoPositionInfo::Direction) != newPositionInfo.hasAttribute(QGeoPositionInfo::Direction))
+            || (_positionInfo.attribute(QGeoPositionInfo::Direction) != newPositionInfo.attribute(QGeoPositionInfo::Direction))) {
+        changes |= TTChange;
+    }
+    if (_positionInfo.attribute(QGeoPositionInfo::VerticalSpeed) != newPositionInfo.attribute(QGeoPositionInfo::VerticalSpeed)) {
+        changes |= ClimbRateChange;
+    }
+    if (_positionInfo.attribute(QGeoPositionInfo::GroundSpeed) != newPositionInfo.attribute(QGeoPositionInfo::GroundSpeed)) {
+        changes |= GroundSpeedChange;
+    }
+    if (_positionInfo != newPositionInfo) {
+        changes |= PositionInfoChange;
     }
-    bool _positionInfoChanged = (_positionInfo != newPositionInfo);
     _positionInfo = newPositionInfo;
 
-    bool hasTypeChanged = (_type != newType);
+    if (_type != newType) {
+        changes |= TypeChange;
+    }
     _type = newType;
 
-    bool hasVDistChanged = (_vDist != newVDist);
+    if (_vDist != newVDist) {
+        changes |= VDistChange;
+    }
     _vDist = newVDist;
 
-    bool hasHDistChanged = (_hDist != newHDist);
+    if (_hDist != newHDist) {
+        changes |= HDistChange;
+    }
     _hDist = newHDist;
 
-    bool hasClimbRateChanged = (_positionInfo.attribute(QGeoPositionInfo::VerticalSpeed) != newPositionInfo.attribute(QGeoPositionInfo::VerticalSpeed));
-
-    bool hasGroundSpeedChanged = (_positionInfo.attribute(QGeoPositionInfo::GroundSpeed) != newPositionInfo.attribute(QGeoPositionInfo::GroundSpeed));
-
-    // If the ID changed, do not animate property changes in the GUI.
-    if (hasIDChanged) {
-        setAnimate(false);
+    if (m_callSign != newCallSign) {
+        changes |= CallSignChange;
     }
-
-    bool hasCallSignChanged = (m_callSign != newCallSign);
     m_callSign = newCallSign;
 
-    // Emit notifier signals as appropriate
-    if (hasAlarmLevelChanged) {
-        emit alarmLevelChanged();
-    }
-    if (hasCoordinateChanged) {
-        emit coordinateChanged();
-    }
-    if (hasHDistChanged) {
-        emit hDistChanged();
-    }
-    if (hasIDChanged) {
-        emit IDChanged();
-        setAnimate(false);
-    }
-    if (_positionInfoChanged)  {
-        emit positionInfoChanged();
-    }
-    if (hasTTChanged) {
-        emit ttChanged();
-    }
-    if (hasGroundSpeedChanged) {
-        emit groundSpeedChanged();
-    }
-    if (hasClimbRateChanged) {
-        emit climbRateChanged();
-    }
-    if (hasTypeChanged) {
-        emit typeChanged();
-    }
-    if (hasVDistChanged) {
-        emit vDistChanged();
-    }
-    if (hasCallSignChanged) {
-        emit callSignChanged();
+    // Validity is updated immediately, because it is used to compare
+    // priorities
+    if (((changes & PositionInfoChange) != 0U) && updateValid()) {
+        changes |= ValidChange;
     }
 
-    setAnimate(true);
+    m_pendingChanges |= changes;
+    if (!m_batchUpdates) {
+        flushChanges();
+    }
 }
 
 
 void Traffic::TrafficFactor::setDescription()
 {
+    // Return early if the description would not change. During traffic
+    // bursts, this method is called for nearly every traffic report, while
+    // the description changes only rarely.
+    DescriptionKey key;
+    key.callSign = m_callSign;
+    key.type = _type;
+    key.positionKnown = _positionInfo.coordinate().isValid();
+    key.useMetricUnits = Settings::useMetricUnitsStatic();
+    if (_vDist.isFinite()) {
+        key.roundedVDist = qRound64(key.useMetricUnits ? _vDist.toM() : _vDist.toFeet());
+        auto climbRateMPS = climbRate().toMPS();
+        if ( qIsFinite(climbRateMPS) ) {
+            key.climbTrend = (climbRateMPS < -1.0) ? 1 : (climbRateMPS > 1.0) ? 3 : 2;
+        }
+    } else {
+        key.climbTrend = -1;
+    }
+    if (m_descriptionKey == key) {
+        return;
+    }
+    m_descriptionKey = key;
+
     QStringList results;
 
     if (!m_callSign.isEmpty()) {
@@ -288,6 +399,14 @@ void Traffic::TrafficFactor::setIcon()
 
 
 void Traffic::TrafficFactor::setValid()
+{
+    if (updateValid()) {
+        emit validChanged();
+    }
+}
+
+
+auto Traffic::TrafficFactor::updateValid() -> bool
 {
 
     // Compute validity
@@ -296,7 +415,7 @@ void Traffic::TrafficFactor::setValid()
         newValid = false;
     } else {
         // If this traffic object it not invalid for trivial reasons, check the age and set the timer.
-        auto delta = QDateTime::currentDateTimeUtc().msecsTo( _positionInfo.timestamp().addMSecs(timeoutMS) );
+        auto delta = Clock::currentDateTimeUtc().msecsTo( _positionInfo.timestamp().addMSecs(timeoutMS) );
         if (delta <= 0) {
             newValid = false;
         } else {
@@ -306,11 +425,11 @@ void Traffic::TrafficFactor::setValid()
 
     }
 
-    // Set value and emit signal, if appropriate
+    // Set value
     if (_valid == newValid) {
-        return;
+        return false;
     }
     _valid = newValid;
-    emit validChanged();
+    return true;
 
 }
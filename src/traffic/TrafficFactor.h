@@ -22,7 +22,9 @@
 
 #include <QGeoPositionInfo>
 #include <QTimer>
+#include <optional>
 
+#include "traffic/TrafficID.h"
 #include "units/Distance.h"
 #include "units/Speed.h"
 
@@ -222,6 +224,25 @@ public:
         return _description;
     }
 
+    /*! \brief Extrapolated coordinate of the traffic
+     *
+     *  This property contains the coordinate of the traffic, extrapolated from
+     *  the last report to the present time, using track, ground speed and
+     *  vertical speed if these are known. The TrafficDataProvider updates the
+     *  property at regular intervals. If track or ground speed are unknown,
+     *  the property equals the coordinate.
+     */
+    Q_PROPERTY(QGeoCoordinate extrapolatedCoordinate READ extrapolatedCoordinate NOTIFY extrapolatedCoordinateChanged)
+
+    /*! \brief Getter method for property with the same name
+     *
+     *  @returns Property extrapolatedCoordinate
+     */
+    QGeoCoordinate extrapolatedCoordinate() const
+    {
+        return m_extrapolatedCoordinate;
+    }
+
     /*! \brief Ground speed the time of report
      *
      *  If known, this property holds the ground speed of the traffic
@@ -293,7 +314,8 @@ public:
      *
      *  This property holds an identifier string for the traffic, as assigned by
      *  the FLARM device that reported the traffic. This can be the FLARM ID, or
-     *  an empty string if no meaningful ID can be assigned.
+     *  an empty string if no meaningful ID can be assigned. The string is
+     *  computed from numericID() whenever the property is read.
      */
     Q_PROPERTY(QString ID READ ID NOTIFY IDChanged)
 
@@ -303,7 +325,20 @@ public:
      */
     QString ID() const
     {
-        return _ID;
+        return Traffic::TrafficID::toString(m_numericID);
+    }
+
+    /*! \brief Numeric identifier of the traffic
+     *
+     *  This is the identifier used to match reports of the same traffic, in
+     *  the format described in Traffic::TrafficID. It is 0 if no meaningful ID
+     *  can be assigned.
+     *
+     *  @returns Numeric ID
+     */
+    quint32 numericID() const
+    {
+        return m_numericID;
     }
 
     /*! \brief Type of aircraft, as reported by FLARM */
@@ -394,6 +429,9 @@ signals:
     /*! \brief Notifier signal */
     void descriptionChanged();
 
+    /*! \brief Notifier signal */
+    void extrapolatedCoordinateChanged();
+
     /*! \brief Notifier signal */
     void groundSpeedChanged();
 
@@ -435,21 +473,42 @@ private slots:
     void setIcon();
 
     // Setter function for the property valid. This slot is bound to the
-    // notifier signals of all the properties that color depends on.  This
-    // method will also set the timer, to ensure that it is called again once
-    // the object times out.
+    // timeout of the timer. It calls updateValid() and emits the notifier
+    // signal if appropriate.
     void setValid();
 
 private:
     // Copy data from other object
     void copyFrom(const TrafficFactor & other)
     {
-        setData(other._alarmLevel, other._ID, other._hDist, other._vDist, other._type, other._positionInfo, other.m_callSign);
+        setData(other._alarmLevel, other.m_numericID, other._hDist, other._vDist, other._type, other._positionInfo, other.m_callSign);
+    }
+
+    // Emits the notifier signals for all changes made by setData() since the
+    // last call, and updates the derived properties color, description and
+    // icon. Each signal is emitted at most once.
+    void flushChanges();
+
+    // Batch updates. If true, setData() does not emit any notifier signals.
+    // The signals are emitted when flushChanges() is called, so that several
+    // reports of the same traffic can be combined into one update of the GUI.
+    void setBatchUpdates(bool batchUpdates);
+
+    // Extrapolates the position of the traffic to the given time and updates
+    // the property extrapolatedCoordinate. Extrapolation covers at most
+    // timeoutMS milliseconds.
+    void extrapolate(const QDateTime& time);
+
+    // Set timeout, in milliseconds
+    void setTimeoutMS(qint64 newTimeoutMS)
+    {
+        timeoutMS = newTimeoutMS;
+        setValid();
     }
 
     // Set data
     void setData(int newAlarmLevel,
-                 const QString & newID,
+                 quint32 newID,
                  AviationUnits::Distance newHDist,
                  AviationUnits::Distance newVDist,
                  AircraftType newType,
@@ -460,6 +519,47 @@ private:
     // Setter function for property animate
     void setAnimate(bool a);
 
+    // Computes the property valid, and sets the timer to ensure that
+    // setValid() is called again once the object times out.  Returns true if
+    // the property has changed. Does not emit any signal.
+    bool updateValid();
+
+    // Changes recorded by setData(), but not yet signalled
+    enum Change : quint32 {
+        AlarmLevelChange = 1U << 0U,
+        CallSignChange = 1U << 1U,
+        ClimbRateChange = 1U << 2U,
+        CoordinateChange = 1U << 3U,
+        ExtrapolatedCoordinateChange = 1U << 4U,
+        GroundSpeedChange = 1U << 5U,
+        HDistChange = 1U << 6U,
+        IDChange = 1U << 7U,
+        PositionInfoChange = 1U << 8U,
+        TTChange = 1U << 9U,
+        TypeChange = 1U << 10U,
+        ValidChange = 1U << 11U,
+        VDistChange = 1U << 12U
+    };
+    quint32 m_pendingChanges {0};
+    bool m_batchUpdates {false};
+
+    // State that the property description was last computed from, with all
+    // numbers rounded as they are shown to the user. The description is
+    // regenerated by setDescription() only if this state changes.
+    struct DescriptionKey {
+        QString callSign;
+        AircraftType type {AircraftType::unknown};
+        bool positionKnown {false};
+        bool useMetricUnits {false};
+        qint64 roundedVDist {0};
+        // -1: vDist unknown, 0: climb rate unknown, 1: descending, 2: level,
+        // 3: climbing
+        int climbTrend {0};
+
+        bool operator==(const DescriptionKey& other) const = default;
+    };
+    std::optional<DescriptionKey> m_descriptionKey;
+
     //
     // Property values
     //
@@ -468,9 +568,10 @@ private:
     QString m_callSign {};
     QString _color {QStringLiteral("red")};
     QString _description;
+    QGeoCoordinate m_extrapolatedCoordinate;
     AviationUnits::Distance _hDist;
     QString _icon;
-    QString _ID;
+    quint32 m_numericID {0};
     QGeoPositionInfo _positionInfo;
     AircraftType _type {AircraftType::unknown};
     bool _valid {false};
@@ -479,7 +580,7 @@ private:
     // Timer for timeout. Traffic objects become invalid if their data has not been
     // refreshed for timeoutMS milliseconds
     QTimer timeoutCounter;
-    static constexpr qint64 timeoutMS = 10*1000;
+    qint64 timeoutMS {10*1000};
 };
 
 }
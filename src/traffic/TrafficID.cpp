@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <QHash>
+#include <array>
+
+#include "traffic/TrafficID.h"
+
+
+auto Traffic::TrafficID::fromString(QLatin1String string, AddressType type) -> quint32
+{
+    if (string.isEmpty()) {
+        return 0;
+    }
+
+    if (string.size() <= 6) {
+        quint32 address = 0;
+        bool isHex = true;
+        for(int i=0; i<string.size(); i++) {
+            auto latin1 = string.at(i).toLatin1();
+            if ((latin1 >= '0') && (latin1 <= '9')) {
+                address = (address << 4U) + static_cast<quint32>(latin1 - '0');
+                continue;
+            }
+            if ((latin1 >= 'A') && (latin1 <= 'F')) {
+                address = (address << 4U) + static_cast<quint32>(latin1 - 'A' + 10);
+                continue;
+            }
+            if ((latin1 >= 'a') && (latin1 <= 'f')) {
+                address = (address << 4U) + static_cast<quint32>(latin1 - 'a' + 10);
+                continue;
+            }
+            isHex = false;
+            break;
+        }
+        if (isHex) {
+            return fromAddress(type, address);
+        }
+    }
+
+    return fromAddress(HashedAddress, static_cast<quint32>(qHash(string)));
+}
+
+
+auto Traffic::TrafficID::toString(quint32 ID) -> QString
+{
+    if (ID == 0) {
+        return {};
+    }
+
+    std::array<char, 6> hexDigits {};
+    for(int i=0; i<6; i++) {
+        hexDigits[5-i] = "0123456789ABCDEF"[(ID >> (4U*i)) & 0x0FU];
+    }
+    return QString::fromLatin1(hexDigits.data(), static_cast<int>(hexDigits.size()));
+}
@@ -0,0 +1,111 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include <QLatin1String>
+#include <QString>
+
+
+namespace Traffic {
+
+/*! \brief Numeric identifiers for traffic
+ *
+ * Traffic receivers identify targets by an address of 24 bits, together with
+ * the type of the address. Traffic data is matched by a numeric ID of 32
+ * bits, whose upper byte is the type of the address and whose lower 24 bits
+ * are the address itself. ICAO addresses have the same type, regardless of
+ * whether they are reported by FLARM or by GDL90 receivers, so that traffic
+ * reported by both kinds of receivers can be identified. The ID 0 means that
+ * no meaningful ID can be assigned.
+ *
+ * The functions in this namespace are reentrant and can be called from
+ * several threads simultaneously.
+ */
+
+namespace TrafficID {
+
+/*! \brief Type of address */
+enum AddressType : quint32 {
+    /*! \brief No address known */
+    NoAddress = 0,
+
+    /*! \brief ICAO 24-bit aircraft address */
+    ICAOAddress = 1,
+
+    /*! \brief FLARM ID */
+    FLARMAddress = 2,
+
+    /*! \brief Any other address, such as random, self-assigned or track IDs */
+    OtherAddress = 3,
+
+    /*! \brief Hash of an identifier string that is not an address
+     *
+     * These IDs have their own type, so that they never coincide with the ID
+     * of a real address.
+     */
+    HashedAddress = 4
+};
+
+/*! \brief Constructs an ID from an address
+ *
+ * @param type Type of the address. For NoAddress, the ID 0 is returned.
+ *
+ * @param address Address. Only the lower 24 bits are used.
+ *
+ * @returns ID
+ */
+constexpr quint32 fromAddress(AddressType type, quint32 address)
+{
+    if (type == NoAddress) {
+        return 0;
+    }
+    return (static_cast<quint32>(type) << 24U) | (address & 0xFFFFFFU);
+}
+
+/*! \brief Constructs an ID from a string
+ *
+ * If the string consists of at most six hexadecimal digits, it is read as an
+ * address of the given type. Other strings, which are used by some receivers
+ * to identify targets, are mapped to an address of type HashedAddress by
+ * hashing. Different strings may then lead to the same ID, but this is rare
+ * for the small number of targets seen by one receiver.
+ *
+ * @param string String, as reported by the traffic receiver
+ *
+ * @param type Type of the address
+ *
+ * @returns ID, or 0 if the string is empty
+ */
+quint32 fromString(QLatin1String string, AddressType type);
+
+/*! \brief String representation of an ID
+ *
+ * @param ID ID
+ *
+ * @returns Address as six upper-case hex digits, or an empty string if the ID
+ * is 0
+ */
+QString toString(quint32 ID);
+
+};
+
+};
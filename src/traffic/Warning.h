@@ -25,6 +25,7 @@
 
 namespace Traffic {
 
+class CollisionRiskEngine;
 class TrafficDataSource_Abstract;
 
 
@@ -41,6 +42,7 @@ class TrafficDataSource_Abstract;
 class Warning {
     Q_GADGET
 
+    friend CollisionRiskEngine;
     friend TrafficDataSource_Abstract;
 
 public:
@@ -146,6 +148,16 @@ private:
                           const QString& RelativeVertical,
                           const QString& RelativeDistance);
 
+    // Private constructor, only to be used by CollisionRiskEngine
+    Warning(int alarmLevel,
+            AviationUnits::Angle relativeBearing,
+            int alarmType,
+            AviationUnits::Distance vDist,
+            AviationUnits::Distance hDist)
+        : m_alarmLevel(alarmLevel), m_alarmType(alarmType), m_hDist(hDist), m_relativeBearing(relativeBearing), m_vDist(vDist)
+    {
+    }
+
     // Property values
     int m_alarmLevel {-1};
     int m_alarmType {-1};
@@ -18,7 +18,14 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <QGuiApplication>
 #include <QPainter>
+#include <QQuickWindow>
+#include <QSGFlatColorMaterial>
+#include <QSGGeometryNode>
+#include <QSGSimpleRectNode>
+#include <QSGSimpleTextureNode>
+#include <QtMath>
 #include <cmath>
 
 #include "Global.h"
@@ -26,21 +33,103 @@
 #include "Settings.h"
 
 
-Ui::ScaleQuickItem::ScaleQuickItem(QQuickItem *parent)
-    : QQuickPaintedItem(parent)
+namespace {
+
+// Root node of the scale. The children are created once and reused: the
+// background, the white and the black part of the scale, and the label.
+class ScaleNode : public QSGNode
 {
+public:
+    ScaleNode()
+    {
+        appendChildNode(background);
+        appendChildNode(whiteLines);
+        appendChildNode(blackLines);
+        appendChildNode(label);
+
+        background->setColor(QColor(0xff, 0xff, 0xff, 0xe0));
+        for(auto* node : {whiteLines, blackLines}) {
+            node->setGeometry(new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), 0));
+            node->setFlag(QSGNode::OwnsGeometry);
+            node->setMaterial(new QSGFlatColorMaterial());
+            node->setFlag(QSGNode::OwnsMaterial);
+        }
+        static_cast<QSGFlatColorMaterial*>(whiteLines->material())->setColor(Qt::white);
+        static_cast<QSGFlatColorMaterial*>(blackLines->material())->setColor(Qt::black);
+        label->setOwnsTexture(true);
+    }
+
+    // Replaces the geometry of node by rectangles of the given width, centered
+    // on the lines. All lines are horizontal or vertical.
+    static void setLines(QSGGeometryNode* node, const QVector<QLineF>& lines, qreal width, qreal offset)
+    {
+        auto* geometry = node->geometry();
+        geometry->setDrawingMode(QSGGeometry::DrawTriangles);
+        geometry->allocate(6*lines.size());
+        auto* vertices = geometry->vertexDataAsPoint2D();
+        for(const auto& line : lines) {
+            auto left = qMin(line.x1(), line.x2())+offset;
+            auto right = qMax(line.x1(), line.x2())+offset;
+            auto top = qMin(line.y1(), line.y2())+offset;
+            auto bottom = qMax(line.y1(), line.y2())+offset;
+            if (qFuzzyCompare(left, right)) {
+                left -= width/2.0;
+                right += width/2.0;
+            } else {
+                top -= width/2.0;
+                bottom += width/2.0;
+            }
+            vertices[0].set(static_cast<float>(left), static_cast<float>(top));
+            vertices[1].set(static_cast<float>(right), static_cast<float>(top));
+            vertices[2].set(static_cast<float>(left), static_cast<float>(bottom));
+            vertices[3].set(static_cast<float>(right), static_cast<float>(top));
+            vertices[4].set(static_cast<float>(right), static_cast<float>(bottom));
+            vertices[5].set(static_cast<float>(left), static_cast<float>(bottom));
+            vertices += 6;
+        }
+        node->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    // Children, owned by this node
+    QSGSimpleRectNode* background {new QSGSimpleRectNode()};
+    QSGGeometryNode* whiteLines {new QSGGeometryNode()};
+    QSGGeometryNode* blackLines {new QSGGeometryNode()};
+    QSGSimpleTextureNode* label {new QSGSimpleTextureNode()};
 
+    // Text and orientation shown in the texture of label
+    QString labelText;
+    bool labelVertical {false};
+    qreal labelDevicePixelRatio {0.0};
+};
+
+}
+
+
+Ui::ScaleQuickItem::ScaleQuickItem(QQuickItem *parent)
+    : QQuickItem(parent)
+{
+    setFlag(QQuickItem::ItemHasContents, true);
     connect(Global::settings(), &Settings::useMetricUnitsChanged, this, &QQuickItem::update);
-    setRenderTarget(QQuickPaintedItem::FramebufferObject);
 
+    // Set font to somewhat smaller than standard size
+    _font = QGuiApplication::font();
+    if (_font.pointSizeF() > 0.0) {
+        _font.setPointSizeF(_font.pointSizeF()*0.8);
+    } else {
+        _font.setPixelSize(qRound(_font.pixelSize()*0.8));
+    }
+    _fontMetrics = QFontMetricsF(_font);
 }
 
 
-void Ui::ScaleQuickItem::paint(QPainter *painter)
+auto Ui::ScaleQuickItem::updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* /*data*/) -> QSGNode*
 {
+    auto* node = static_cast<ScaleNode*>(oldNode);
+
     // Safety check. Continue only if data provided is sane
-    if (_pixelPer10km < 20) {
-        return;
+    if ((_pixelPer10km < 20) || (window() == nullptr)) {
+        delete node;
+        return nullptr;
     }
 
     // Pre-compute a few numbers that will be used when drawing
@@ -52,79 +141,93 @@ void Ui::ScaleQuickItem::paint(QPainter *painter)
     qreal sizeOfScaleInUnit   = floor(scaleSizeInUnit/ScaleUnitInUnit)*ScaleUnitInUnit;
     int   sizeOfScaleInPix    = qRound(sizeOfScaleInUnit*pixelPerUnit);
 
-    // Compute size of text. Set font to somewhat smaller than standard size.
-    QFont font = painter->font();
-    if (font.pointSizeF() > 0.0) {
-        font.setPointSizeF(font.pointSizeF()*0.8);
-    } else {
-        font.setPixelSize(qRound(font.pixelSize()*0.8));
-    }
-    painter->setFont(font);
+    // Compute size of text
     QString text = QString(_useMetricUnits ? QString("%1 km") : QString("%1 nm")).arg(sizeOfScaleInUnit);
-    int textWidth  = painter->fontMetrics().horizontalAdvance(text);
-    int textHeight = painter->fontMetrics().height();
+    int textWidth  = qCeil(_fontMetrics.horizontalAdvance(text));
+    int textHeight = qCeil(_fontMetrics.height());
 
     // Draw only if width() or height() is large enough
     if (_vertical) {
         if (height() < textWidth*1.5) {
-            return;
+            delete node;
+            return nullptr;
         }
     } else {
         if (width() < textWidth*1.5) {
-            return;
+            delete node;
+            return nullptr;
         }
     }
 
+    if (node == nullptr) {
+        node = new ScaleNode();
+    }
+
     // Coordinates for the left/top point of the scale
     int baseX = _vertical ? 8 : qRound((width()-sizeOfScaleInPix)/2.0);
     int baseY = _vertical ? qRound((height()-sizeOfScaleInPix)/2.0) : qRound(height()) - 8 ;
 
-    // Draw underlying white, slightly tranparent rectangle
-    painter->fillRect(0, 0, static_cast<int>(width()), static_cast<int>(height()), QColor(0xff, 0xff, 0xff, 0xe0));
+    // Underlying white, slightly tranparent rectangle
+    node->background->setRect(boundingRect());
 
-    // Draw scale
+    // Scale
+    QVector<QLineF> lines;
     if (_vertical) {
-        painter->setPen(QPen(Qt::white, 2));
-        painter->drawLine(baseX, baseY, baseX, baseY+sizeOfScaleInPix);
-        painter->drawLine(baseX+3, baseY, baseX-3, baseY);
-        painter->drawLine(baseX+3, baseY+sizeOfScaleInPix, baseX-3, baseY+sizeOfScaleInPix);
+        lines.append(QLineF(baseX, baseY, baseX, baseY+sizeOfScaleInPix));
+        lines.append(QLineF(baseX+3, baseY, baseX-3, baseY));
+        lines.append(QLineF(baseX+3, baseY+sizeOfScaleInPix, baseX-3, baseY+sizeOfScaleInPix));
         for(int i=1; i*ScaleUnitInUnit<sizeOfScaleInUnit; i+= 1) {
-            painter->drawLine(baseX, baseY + i*sizeOfUnitInPix, baseX-3, baseY + i*sizeOfUnitInPix);
+            lines.append(QLineF(baseX, baseY + i*sizeOfUnitInPix, baseX-3, baseY + i*sizeOfUnitInPix));
         }
-
-        painter->setPen(QPen(Qt::black, 1));
-        painter->drawLine(baseX, baseY, baseX, baseY+sizeOfScaleInPix);
-        painter->drawLine(baseX+3, baseY, baseX-3, baseY);
-        painter->drawLine(baseX+3, baseY+sizeOfScaleInPix, baseX-3, baseY+sizeOfScaleInPix);
-        for(int i=1; i*ScaleUnitInUnit<sizeOfScaleInUnit; i+= 1) {
-            painter->drawLine(baseX, baseY + i*sizeOfUnitInPix, baseX-3, baseY + i*sizeOfUnitInPix);
-        }
-
-        // Draw text
-        painter->rotate(-90.0);
-        painter->drawText(-qRound(height()/2.0)-textWidth/2, baseX+textHeight, text);
     } else {
-        painter->setPen(QPen(Qt::white, 2));
-        painter->drawLine(baseX, baseY, baseX+sizeOfScaleInPix, baseY);
-        painter->drawLine(baseX, baseY+3, baseX, baseY-3);
-        painter->drawLine(baseX+sizeOfScaleInPix, baseY+3, baseX+sizeOfScaleInPix, baseY-3);
+        lines.append(QLineF(baseX, baseY, baseX+sizeOfScaleInPix, baseY));
+        lines.append(QLineF(baseX, baseY+3, baseX, baseY-3));
+        lines.append(QLineF(baseX+sizeOfScaleInPix, baseY+3, baseX+sizeOfScaleInPix, baseY-3));
         for(int i=1; i*ScaleUnitInUnit<sizeOfScaleInUnit; i+= 1) {
-            painter->drawLine(baseX + i*sizeOfUnitInPix, baseY, baseX + i*sizeOfUnitInPix, baseY+3);
+            lines.append(QLineF(baseX + i*sizeOfUnitInPix, baseY, baseX + i*sizeOfUnitInPix, baseY+3));
         }
-
-        painter->setPen(QPen(Qt::black, 1));
-        painter->drawLine(baseX, baseY, baseX+sizeOfScaleInPix, baseY);
-        painter->drawLine(baseX, baseY+3, baseX, baseY-3);
-        painter->drawLine(baseX+sizeOfScaleInPix, baseY+3, baseX+sizeOfScaleInPix, baseY-3);
-        for(int i=1; i*ScaleUnitInUnit<sizeOfScaleInUnit; i+= 1) {
-            painter->drawLine(baseX + i*sizeOfUnitInPix, baseY, baseX + i*sizeOfUnitInPix, baseY+3);
+    }
+    ScaleNode::setLines(node->whiteLines, lines, 2.0, 0.0);
+    ScaleNode::setLines(node->blackLines, lines, 1.0, 0.5);
+
+    // Render the label into a texture, but only if the text has changed
+    auto devicePixelRatio = window()->effectiveDevicePixelRatio();
+    if ((text != node->labelText) || (_vertical != node->labelVertical) || !qFuzzyCompare(devicePixelRatio, node->labelDevicePixelRatio)) {
+        QImage image(qCeil(textWidth*devicePixelRatio), qCeil(textHeight*devicePixelRatio), QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        {
+            QPainter painter(&image);
+            painter.scale(devicePixelRatio, devicePixelRatio);
+            painter.setFont(_font);
+            painter.setPen(Qt::black);
+            painter.drawText(QPointF(0.0, _fontMetrics.ascent()), text);
+        }
+        if (_vertical) {
+            image = image.transformed(QTransform().rotate(-90.0));
         }
+        node->label->setTexture(window()->createTextureFromImage(image));
+        node->labelText = text;
+        node->labelVertical = _vertical;
+        node->labelDevicePixelRatio = devicePixelRatio;
+    }
 
-        // Draw text
-        painter->drawText(baseX+sizeOfScaleInPix/2-textWidth/2, baseY-5, text);
+    // Position the label
+    if (_vertical) {
+        node->label->setRect(baseX+textHeight-_fontMetrics.ascent(), height()/2.0-textWidth/2.0, textHeight, textWidth);
+    } else {
+        node->label->setRect(baseX+sizeOfScaleInPix/2-textWidth/2, baseY-5-_fontMetrics.ascent(), textWidth, textHeight);
     }
 
+    return node;
+}
+
 
+void Ui::ScaleQuickItem::geometryChanged(const QRectF& newGeometry, const QRectF& oldGeometry)
+{
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size()) {
+        update();
+    }
 }
 
 
@@ -20,7 +20,9 @@
 
 #pragma once
 
-#include <QtQuick/QQuickPaintedItem>
+#include <QFont>
+#include <QFontMetricsF>
+#include <QtQuick/QQuickItem>
 
 namespace Ui {
 
@@ -31,10 +33,15 @@ namespace Ui {
  *  map.  To use this class, export it to QML, add it to your view and make sure
  *  that the property pixelPer10km get set accordingly.
  *
+ *  The scale is drawn with the Qt Quick scene graph. When pixelPer10km changes,
+ *  which happens in every frame of a zoom animation, only the geometry of the
+ *  scale is updated. The label is rendered into a texture, which is only
+ *  regenerated when the text of the label changes.
+ *
  *  The methods of this class are re-entrant, but not thread safe.
  */
 
-class ScaleQuickItem : public QQuickPaintedItem
+class ScaleQuickItem : public QQuickItem
 {
   Q_OBJECT
 
@@ -60,13 +67,15 @@ public:
   */
   void setPixelPer10km(qreal _pxp10k);
 
-  /*! \brief Determines whether the scale should use km or nm */
-
-  /*! \brief Re-implemented from QQuickPaintedItem to implement painting
+  /*! \brief Re-implemented from QQuickItem to implement painting
+   *
+   *  @param oldNode Node returned by the previous call, or nullptr
    *
-   *  @param painter Pointer to the QPainter used for painting
+   *  @param data Unused
+   *
+   *  @returns Root node of the scale, or nullptr if nothing is to be drawn
    */
-  void paint(QPainter *painter) override;
+  QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data) override;
 
   /*! \brief Determines whether the scale should be drawn vertically or horizontally
    *
@@ -96,11 +105,25 @@ signals:
   /*! \brief Notification signal for property with the same name */
   void verticalChanged();
 
+protected:
+  /*! \brief Re-implemented from QQuickItem to redraw the scale when the size changes
+   *
+   *  @param newGeometry New geometry of the item
+   *
+   *  @param oldGeometry Old geometry of the item
+   */
+  void geometryChanged(const QRectF& newGeometry, const QRectF& oldGeometry) override;
+
 private:
   Q_DISABLE_COPY_MOVE(ScaleQuickItem)
 
   qreal _pixelPer10km {0.0};
   bool _vertical {false};
+
+  // Font of the label, somewhat smaller than standard size, and its metrics.
+  // Both are computed once, in the constructor.
+  QFont _font;
+  QFontMetricsF _fontMetrics {QFont()};
 };
 
 }
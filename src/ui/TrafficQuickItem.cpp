@@ -0,0 +1,249 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <QGeoCoordinate>
+#include <QPainter>
+#include <QQuickWindow>
+#include <QSGGeometryNode>
+#include <QSGTextureMaterial>
+#include <QSvgRenderer>
+#include <QtMath>
+
+#include "Global.h"
+#include "TrafficQuickItem.h"
+#include "traffic/TrafficDataProvider.h"
+#include "traffic/TrafficFactor.h"
+
+
+namespace {
+
+// Icons that can appear in the property icon of a TrafficFactor, in the
+// order in which they appear in the texture atlas
+const QStringList iconNames = {
+    QStringLiteral("/icons/traffic-noDirection-green.svg"),
+    QStringLiteral("/icons/traffic-noDirection-red.svg"),
+    QStringLiteral("/icons/traffic-noDirection-yellow.svg"),
+    QStringLiteral("/icons/traffic-withDirection-green.svg"),
+    QStringLiteral("/icons/traffic-withDirection-red.svg"),
+    QStringLiteral("/icons/traffic-withDirection-yellow.svg"),
+};
+
+// Node that draws all traffic icons. The geometry contains two triangles per
+// icon. All icons are taken from one texture, the atlas, where they are
+// arranged side by side, separated by a transparent border of one pixel so
+// that linear filtering does not mix neighbouring icons.
+class TrafficNode : public QSGGeometryNode
+{
+public:
+    TrafficNode()
+    {
+        auto* geometry = new QSGGeometry(QSGGeometry::defaultAttributes_TexturedPoint2D(), 0);
+        geometry->setDrawingMode(QSGGeometry::DrawTriangles);
+        setGeometry(geometry);
+        setFlag(QSGNode::OwnsGeometry);
+        setMaterial(new QSGTextureMaterial());
+        setFlag(QSGNode::OwnsMaterial);
+    }
+
+    ~TrafficNode() override
+    {
+        delete atlas;
+    }
+
+    Q_DISABLE_COPY_MOVE(TrafficNode)
+
+    // Renders the atlas for the given device pixel ratio, unless this has
+    // already been done
+    void updateAtlas(QQuickWindow* window, qreal devicePixelRatio)
+    {
+        if ((atlas != nullptr) && qFuzzyCompare(devicePixelRatio, atlasDevicePixelRatio)) {
+            return;
+        }
+
+        auto iconPixels = qCeil(Ui::TrafficQuickItem::iconSize*devicePixelRatio);
+        cellPixels = iconPixels+2;
+        QImage image(cellPixels*iconNames.size(), cellPixels, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        for(int i=0; i<iconNames.size(); i++) {
+            QSvgRenderer renderer(":"+iconNames[i]);
+            renderer.render(&painter, QRectF(i*cellPixels+1, 1, iconPixels, iconPixels));
+        }
+        painter.end();
+
+        delete atlas;
+        atlas = window->createTextureFromImage(image);
+        atlas->setFiltering(QSGTexture::Linear);
+        atlasDevicePixelRatio = devicePixelRatio;
+        auto* textureMaterial = static_cast<QSGTextureMaterial*>(material());
+        textureMaterial->setTexture(atlas);
+        textureMaterial->setFiltering(QSGTexture::Linear);
+        markDirty(QSGNode::DirtyMaterial);
+    }
+
+    // Texture coordinates of the icon with the given index, excluding the border
+    QRectF iconRect(int index) const
+    {
+        auto width = static_cast<qreal>(cellPixels*iconNames.size());
+        auto height = static_cast<qreal>(cellPixels);
+        return {(index*cellPixels+1)/width, 1/height, (cellPixels-2)/width, (cellPixels-2)/height};
+    }
+
+    QSGTexture* atlas {nullptr};
+    qreal atlasDevicePixelRatio {0.0};
+    int cellPixels {0};
+};
+
+}
+
+
+Ui::TrafficQuickItem::TrafficQuickItem(QQuickItem *parent)
+    : QQuickItem(parent)
+{
+    setFlag(QQuickItem::ItemHasContents, true);
+
+    auto* trafficDataProvider = Global::trafficDataProvider();
+    connect(trafficDataProvider, &Traffic::TrafficDataProvider::trafficObjectsChanged, this, &Ui::TrafficQuickItem::scheduleUpdate);
+    connect(trafficDataProvider, &Traffic::TrafficDataProvider::trafficCapacityChanged, this, &Ui::TrafficQuickItem::connectTrafficObjects);
+    connectTrafficObjects();
+}
+
+
+void Ui::TrafficQuickItem::connectTrafficObjects()
+{
+    foreach(auto* trafficObject, Global::trafficDataProvider()->trafficObjects()) {
+        connect(trafficObject, &Traffic::TrafficFactor::validChanged, this, &Ui::TrafficQuickItem::scheduleUpdate, Qt::UniqueConnection);
+    }
+    scheduleUpdate();
+}
+
+
+void Ui::TrafficQuickItem::scheduleUpdate()
+{
+    polish();
+    update();
+}
+
+
+void Ui::TrafficQuickItem::setMap(QQuickItem* newMap)
+{
+    if (newMap == _map) {
+        return;
+    }
+
+    if (!_map.isNull()) {
+        disconnect(_map, nullptr, this, nullptr);
+    }
+    _map = newMap;
+    if (!_map.isNull()) {
+        // The map is a QDeclarativeGeoMap, which is not part of the public
+        // API. We therefore connect by name.
+        connect(_map, SIGNAL(centerChanged(QGeoCoordinate)), this, SLOT(scheduleUpdate()));
+        connect(_map, SIGNAL(zoomLevelChanged(qreal)), this, SLOT(scheduleUpdate()));
+        connect(_map, SIGNAL(bearingChanged(qreal)), this, SLOT(scheduleUpdate()));
+        connect(_map, SIGNAL(tiltChanged(qreal)), this, SLOT(scheduleUpdate()));
+        connect(_map, &QQuickItem::widthChanged, this, &Ui::TrafficQuickItem::scheduleUpdate);
+        connect(_map, &QQuickItem::heightChanged, this, &Ui::TrafficQuickItem::scheduleUpdate);
+    }
+    scheduleUpdate();
+    emit mapChanged();
+}
+
+
+void Ui::TrafficQuickItem::updatePolish()
+{
+    // Collect the visible traffic objects: position in item coordinates,
+    // rotation and icon. This runs on the GUI thread, where the traffic
+    // objects and the map can be accessed.
+    _icons.clear();
+    if (_map.isNull()) {
+        return;
+    }
+    auto bearing = _map->property("bearing").toReal();
+    auto visibleRect = boundingRect().adjusted(-iconSize, -iconSize, iconSize, iconSize);
+    foreach(auto* trafficObject, Global::trafficDataProvider()->trafficObjects()) {
+        if (!trafficObject->valid()) {
+            continue;
+        }
+        auto coordinate = trafficObject->extrapolatedCoordinate();
+        if (!coordinate.isValid()) {
+            continue;
+        }
+        auto index = iconNames.indexOf(trafficObject->icon());
+        if (index < 0) {
+            continue;
+        }
+        QPointF mapPoint;
+        QMetaObject::invokeMethod(_map, "fromCoordinate", Qt::DirectConnection, Q_RETURN_ARG(QPointF, mapPoint), Q_ARG(QGeoCoordinate, coordinate), Q_ARG(bool, false));
+        auto center = mapFromItem(_map, mapPoint);
+        if (!qIsFinite(center.x()) || !qIsFinite(center.y()) || !visibleRect.contains(center)) {
+            continue;
+        }
+        auto TT = trafficObject->TT();
+        _icons.append({center, qIsFinite(TT) ? TT-bearing : 0.0, index});
+    }
+}
+
+
+auto Ui::TrafficQuickItem::updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* /*data*/) -> QSGNode*
+{
+    auto* node = static_cast<TrafficNode*>(oldNode);
+
+    // Safety check. Continue only if data provided is sane
+    if (_map.isNull() || (window() == nullptr)) {
+        delete node;
+        return nullptr;
+    }
+
+    // The icons were computed by updatePolish(). The GUI thread is blocked
+    // while this method runs, so that they can be read here.
+    const auto& icons = _icons;
+
+    if (node == nullptr) {
+        node = new TrafficNode();
+    }
+    node->updateAtlas(window(), window()->effectiveDevicePixelRatio());
+
+    // Fill geometry, two triangles per icon
+    auto* geometry = node->geometry();
+    geometry->allocate(6*icons.size());
+    auto* vertices = geometry->vertexDataAsTexturedPoint2D();
+    for(const auto& icon : icons) {
+        auto textureRect = node->iconRect(icon.index);
+        auto cosine = qCos(qDegreesToRadians(icon.rotation))*iconSize/2.0;
+        auto sine = qSin(qDegreesToRadians(icon.rotation))*iconSize/2.0;
+        auto corner = [&](qreal x, qreal y, qreal tx, qreal ty, QSGGeometry::TexturedPoint2D& vertex) {
+            vertex.set(static_cast<float>(icon.center.x() + x*cosine - y*sine),
+                       static_cast<float>(icon.center.y() + x*sine + y*cosine),
+                       static_cast<float>(tx), static_cast<float>(ty));
+        };
+        corner(-1, -1, textureRect.left(), textureRect.top(), vertices[0]);
+        corner( 1, -1, textureRect.right(), textureRect.top(), vertices[1]);
+        corner(-1,  1, textureRect.left(), textureRect.bottom(), vertices[2]);
+        corner( 1, -1, textureRect.right(), textureRect.top(), vertices[3]);
+        corner( 1,  1, textureRect.right(), textureRect.bottom(), vertices[4]);
+        corner(-1,  1, textureRect.left(), textureRect.bottom(), vertices[5]);
+        vertices += 6;
+    }
+    node->markDirty(QSGNode::DirtyGeometry);
+
+    return node;
+}
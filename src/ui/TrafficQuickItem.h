@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include <QPointer>
+#include <QVector>
+#include <QtQuick/QQuickItem>
+
+namespace Ui {
+
+/*! \brief QML Class that draws all traffic opponents on a map
+ *
+ *  This class implements a QML item that draws the icons of all traffic
+ *  objects listed in Traffic::TrafficDataProvider::trafficObjects(). To use
+ *  it, export it to QML, add it on top of a QtLocation map, make it fill the
+ *  map and set the property map.
+ *
+ *  Unlike one delegate per traffic object, this item does not rely on
+ *  property bindings. It reads the traffic objects directly, whenever the
+ *  TrafficDataProvider reports a batch of changes or the map moves, and draws
+ *  all icons in one scene graph node with one texture that holds all icons.
+ *  The scene graph renders the icons with a single draw call, regardless of
+ *  the number of traffic objects.
+ *
+ *  The methods of this class are re-entrant, but not thread safe.
+ */
+
+class TrafficQuickItem : public QQuickItem
+{
+  Q_OBJECT
+
+public:
+  /*! \brief Standard constructor
+   *
+   *  @param parent The standard QObject parent pointer
+   */
+  explicit TrafficQuickItem(QQuickItem *parent = nullptr);
+
+  /*! \brief Map on which the traffic is shown
+   *
+   *  This property holds a QtLocation map. The positions of the traffic
+   *  objects are computed with the method fromCoordinate() of the map, and
+   *  the icons are rotated according to the property bearing of the map.
+   *  Nothing is drawn if the property is not set.
+   */
+  Q_PROPERTY(QQuickItem* map READ map WRITE setMap NOTIFY mapChanged)
+
+  /*! \brief Getter function for the property with the same name
+   *
+   *  @returns Property map
+   */
+  QQuickItem* map() const {return _map;}
+
+  /*! \brief Setter function for the property with the same name
+   *
+   *  @param newMap Property map
+   */
+  void setMap(QQuickItem* newMap);
+
+  /*! \brief Re-implemented from QQuickItem to implement painting
+   *
+   *  @param oldNode Node returned by the previous call, or nullptr
+   *
+   *  @param data Unused
+   *
+   *  @returns Node that holds the icons, or nullptr if nothing is to be drawn
+   */
+  QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data) override;
+
+  /*! \brief Re-implemented from QQuickItem to compute the icon positions
+   *
+   *  This method runs on the GUI thread, before the scene graph is
+   *  synchronized. It maps the coordinates of the traffic objects to item
+   *  coordinates, so that updatePaintNode() does not need to access the map.
+   */
+  void updatePolish() override;
+
+  /*! \brief Size of the traffic icons, in logical pixels */
+  static constexpr qreal iconSize = 30.0;
+
+signals:
+  /*! \brief Notification signal for property with the same name */
+  void mapChanged();
+
+private slots:
+  // Connects the signal validChanged() of all traffic objects to update().
+  // This method is called whenever the list of traffic objects changes.
+  void connectTrafficObjects();
+
+  // Schedules updatePolish() and updatePaintNode()
+  void scheduleUpdate();
+
+private:
+  Q_DISABLE_COPY_MOVE(TrafficQuickItem)
+
+  QPointer<QQuickItem> _map;
+
+  // Visible traffic objects, as computed by updatePolish(): position in item
+  // coordinates, rotation and index of the icon in the texture atlas
+  struct Icon {
+    QPointF center;
+    qreal rotation;
+    int index;
+  };
+  QVector<Icon> _icons;
+};
+
+}
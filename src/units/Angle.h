@@ -47,7 +47,7 @@ namespace AviationUnits {
          *
          * @returns Angle
          */
-        static Angle fromRAD(double angleInRAD)
+        static constexpr Angle fromRAD(double angleInRAD)
         {
             Angle result;
             result.m_angleInRAD = angleInRAD;
@@ -60,7 +60,7 @@ namespace AviationUnits {
          *
          * @returns Angle
          */
-        static Angle fromDEG(double angleInDEG)
+        static constexpr Angle fromDEG(double angleInDEG)
         {
             Angle result;
             result.m_angleInRAD = qDegreesToRadians(angleInDEG);
@@ -82,7 +82,7 @@ namespace AviationUnits {
          *
          * @returns Sum of the two angles
          */
-        Q_INVOKABLE AviationUnits::Angle operator+(AviationUnits::Angle rhs)
+        Q_INVOKABLE AviationUnits::Angle operator+(AviationUnits::Angle rhs) const
         {
             Angle result;
             result.m_angleInRAD = m_angleInRAD + rhs.m_angleInRAD;
@@ -95,7 +95,7 @@ namespace AviationUnits {
          *
          * @returns Difference of the two angles
          */
-        Q_INVOKABLE AviationUnits::Angle operator-(AviationUnits::Angle rhs)
+        Q_INVOKABLE AviationUnits::Angle operator-(AviationUnits::Angle rhs) const
         {
             Angle result;
             result.m_angleInRAD = m_angleInRAD - rhs.m_angleInRAD;
@@ -187,7 +187,7 @@ namespace AviationUnits {
 
     private:
         // Angle in Radians
-        double m_angleInRAD{qQNaN()};
+        double m_angleInRAD{ NAN };
     };
 };
 
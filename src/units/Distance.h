@@ -67,7 +67,7 @@ namespace AviationUnits {
          *
          * @returns distance
          */
-        static Distance fromNM(double distanceInNM)
+        static constexpr Distance fromNM(double distanceInNM)
         {
             Distance result;
             result.m_distanceInM = distanceInNM*MetersPerNauticalMile;
@@ -80,7 +80,7 @@ namespace AviationUnits {
          *
          * @returns distance
          */
-        static Distance fromFT(double distanceInFT)
+        static constexpr Distance fromFT(double distanceInFT)
         {
             Distance result;
             result.m_distanceInM = distanceInFT * MetersPerFeet;
@@ -41,7 +41,7 @@ namespace AviationUnits {
          *
          * @returns speed
          */
-        static Speed fromFPM(double speedInFPM)
+        static constexpr Speed fromFPM(double speedInFPM)
         {
             Speed result;
             result._speedInMPS = speedInFPM/FPM_per_MPS;
@@ -54,7 +54,7 @@ namespace AviationUnits {
          *
          * @returns speed
          */
-        static Speed fromMPS(double speedInMPS)
+        static constexpr Speed fromMPS(double speedInMPS)
         {
             Speed result;
             result._speedInMPS = speedInMPS;
@@ -67,7 +67,7 @@ namespace AviationUnits {
          *
          * @returns speed
          */
-        static Speed fromKN(double speedInKT)
+        static constexpr Speed fromKN(double speedInKT)
         {
             Speed result;
             result._speedInMPS = speedInKT / KN_per_MPS;
@@ -80,7 +80,7 @@ namespace AviationUnits {
          *
          * @returns speed
          */
-        static Speed fromKMH(double speedInKMH)
+        static constexpr Speed fromKMH(double speedInKMH)
         {
             Speed result;
             result._speedInMPS = speedInKMH / KMH_per_MPS;
@@ -111,7 +111,7 @@ namespace AviationUnits {
          *
          * @returns Quotient as a dimension-less number
          */
-        Q_INVOKABLE double operator/(AviationUnits::Speed rhs)
+        Q_INVOKABLE double operator/(AviationUnits::Speed rhs) const
         {
             if (qFuzzyIsNull(rhs._speedInMPS))
                 return qQNaN();
@@ -200,7 +200,7 @@ namespace AviationUnits {
 
     private:
         // Speed in meters per second
-        double _speedInMPS{qQNaN()};
+        double _speedInMPS{ NAN };
     };
 
 };
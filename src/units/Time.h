@@ -44,7 +44,7 @@ namespace AviationUnits {
          *
          * @returns time
          */
-        static Time fromS(double timeInS) {
+        static constexpr Time fromS(double timeInS) {
             Time result;
             result._timeInS = timeInS;
             return result;
@@ -118,7 +118,7 @@ namespace AviationUnits {
         static constexpr double Seconds_per_Hour = 60.0 * 60.0;
 
         // Speed in meters per second
-        double _timeInS{qQNaN()};
+        double _timeInS{ NAN };
     };
 };
 
@@ -131,7 +131,7 @@ namespace AviationUnits {
  *
  * @returns quotient of numerator and denominator as time
  */
-[[maybe_unused]]  static AviationUnits::Time operator/(AviationUnits::Distance dist,
+inline AviationUnits::Time operator/(AviationUnits::Distance dist,
                                                       AviationUnits::Speed speed) {
     if ((!dist.isFinite()) || (!speed.isFinite()) || (qFuzzyIsNull(speed.toMPS())))
         return {};
@@ -37,11 +37,11 @@
 Weather::Decoder::Decoder(QObject *parent)
     : QObject(parent)
 {
-    // Re-parse the text whenever the date changes
-    connect(Clock::globalInstance(), &Clock::dateChanged, this, &Weather::Decoder::parse);
+    // Re-decode the text whenever the date changes
+    connect(Clock::globalInstance(), &Clock::dateChanged, this, &Weather::Decoder::invalidateDecodedText);
 
-    // Re-parse whenever the preferred unit system changes
-    connect(Global::settings(), &Settings::useMetricUnitsChanged, this, &Weather::Decoder::parse);
+    // Re-decode whenever the preferred unit system changes
+    connect(Global::settings(), &Settings::useMetricUnitsChanged, this, &Weather::Decoder::invalidateDecodedText);
 }
 
 
@@ -67,18 +67,79 @@ void Weather::Decoder::setRawText(const QString& rawText, QDate referenceDate)
         return;
     }
 
+    setRawText(rawText, referenceDate, metaf::Parser::parse(rawText.toStdString()));
+}
+
+
+void Weather::Decoder::setRawText(const QString& rawText, QDate referenceDate, const metaf::ParseResult& result)
+{
+    if ((_rawText == rawText) && (_referenceDate == referenceDate)) {
+        return;
+    }
+
     _referenceDate = referenceDate;
     _rawText = rawText;
+    parseResult = result;
+    readCurrentWeather();
     emit rawTextChanged();
-    parse();
+    invalidateDecodedText();
+}
+
+
+auto Weather::Decoder::decodedText() -> QString
+{
+    if (!_decodedTextValid) {
+        decode();
+    }
+    return _decodedText;
+}
+
+
+void Weather::Decoder::invalidateDecodedText()
+{
+    if (!_decodedTextValid) {
+        return;
+    }
+    _decodedTextValid = false;
+    _decodedText.clear();
+    emit decodedTextChanged();
+}
+
+
+auto Weather::Decoder::memoryUsage() const -> qint64
+{
+    qint64 result = sizeof(*this);
+    result += (_rawText.size()+_decodedText.size()+_currentWeather.size())*static_cast<qint64>(sizeof(QChar));
+    for (const auto &groupInfo : parseResult.groups) {
+        result += sizeof(groupInfo) + groupInfo.rawString.size();
+    }
+    return result;
 }
 
 
-void Weather::Decoder::parse()
+void Weather::Decoder::readCurrentWeather()
 {
-    auto oldDecodedText = _decodedText;
+    // If the METAR contains several weather groups, the last one counts
+    _currentWeather.clear();
+    for (const auto &groupInfo : parseResult.groups) {
+        if (groupInfo.reportPart != ReportPart::METAR) {
+            continue;
+        }
+        const auto *group = std::get_if<metaf::WeatherGroup>(&groupInfo.group);
+        if ((group == nullptr) || !group->isValid()) {
+            continue;
+        }
+        QStringList phenomenaList;
+        for (const auto p : group->weatherPhenomena()) {
+            phenomenaList << explainWeatherPhenomena(p);
+        }
+        _currentWeather = phenomenaList.join(" • ");
+    }
+}
+
 
-    parseResult = metaf::Parser::parse(_rawText.toStdString());
+void Weather::Decoder::decode()
+{
     QStringList decodedStrings;
     decodedStrings.reserve(64);
     QString listStart = "<ul style=\"margin-left:-25px;\">";
@@ -93,10 +154,7 @@ void Weather::Decoder::parse()
         }
     }
     _decodedText = listStart+decodedStrings.join("\n")+listEnd+"<br>";
-
-    if (_decodedText != oldDecodedText) {
-        emit decodedTextChanged();
-    }
+    _decodedTextValid = true;
 }
 
 
@@ -2953,7 +3011,7 @@ auto Weather::Decoder::visitVisibilityGroup(const VisibilityGroup & group, Repor
     return QString();
 }
 
-auto Weather::Decoder::visitWeatherGroup(const WeatherGroup & group, ReportPart part, const std::string & /*rawString*/) -> QString
+auto Weather::Decoder::visitWeatherGroup(const WeatherGroup & group, ReportPart /*part*/, const std::string & /*rawString*/) -> QString
 {
     if (!group.isValid()) {
         return tr("Invalid data");
@@ -2967,11 +3025,6 @@ auto Weather::Decoder::visitWeatherGroup(const WeatherGroup & group, ReportPart
     }
     auto phenomenaString = phenomenaList.join(" • ");
 
-    // If this is a METAR, then save the current weather
-    if (part == ReportPart::METAR) {
-        _currentWeather = phenomenaString;
-    }
-
     switch (group.type()) {
     case metaf::WeatherGroup::Type::CURRENT:
         return phenomenaString; // tr("Current weather: %1").arg(phenomenaString);
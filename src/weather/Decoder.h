@@ -67,17 +67,19 @@ public:
      * rich text string.  The text might change in responde to changes in
      * user settings, and might also change by midnight (the text uses words such
      * as 'tomorrow' whose meaning changes at the end of the day).
+     *
+     * The text is generated when the property is first read, and kept until
+     * the raw text, the date or the user settings change.
      */
     Q_PROPERTY(QString decodedText READ decodedText NOTIFY decodedTextChanged)
 
     /*! \brief Getter function for property with the same name
+     *
+     * This method is not const, because it generates the text on first use.
      *
      * @returns Property decodedText
      */
-    QString decodedText() const
-    {
-        return _decodedText;
-    }
+    QString decodedText();
 
     /*! \brief Message Type
      *
@@ -103,6 +105,22 @@ public:
         return _rawText;
     }
 
+    /*! \brief Estimated memory usage
+     *
+     * @returns Estimated size of this object in memory, including texts and
+     * parser result, in bytes
+     */
+    qint64 memoryUsage() const;
+
+public slots:
+    /*! \brief Discards the decoded text
+     *
+     * The decoded text is generated again on the next call to decodedText().
+     * This slot is called when the raw text is set, whenever the date or the
+     * preferred unit system changes, and when memory is low.
+     */
+    void invalidateDecodedText();
+
 signals:
     /*! \brief  Notifier signal */
     void decodedTextChanged();
@@ -118,6 +136,10 @@ protected:
     // the decoder needs to know the month and year. Set this reference date to any date between in the interval [issue date, issue date + 28 days]
     void setRawText(const QString& rawText, QDate referenceDate);
 
+    // Same as above, but uses a result of metaf::Parser::parse() that has
+    // already been computed for rawText, for instance in a worker thread
+    void setRawText(const QString& rawText, QDate referenceDate, const metaf::ParseResult& result);
+
     // Indicates if the parser was able to read the text without error. If an error occurs, the decoded will
     // still be available, but is probably incomplete
     bool hasParseError() const
@@ -125,11 +147,14 @@ protected:
         return (parseResult.reportMetadata.error != metaf::ReportError::NONE);
     }
 
-private slots:
-    // This slot does the actual parsing
-    void parse();
-
 private:
+    // Generates the decoded text from the parser result
+    void decode();
+
+    // Finds the current weather in the parser result. This is much cheaper
+    // than decode(), and done whenever the raw text is set.
+    void readCurrentWeather();
+
     // Explanation functions
     static QString explainCloudType(const metaf::CloudType ct);
     static QString explainDirection(metaf::Direction direction, bool trueCardinalDirections=true);
@@ -197,8 +222,10 @@ private:
 
     // Cached data
 
-    // Decoded text generated by last run of parser
+    // Decoded text generated by last run of decode(), and flag indicating if
+    // it is up to date
     QString _decodedText;
+    bool _decodedTextValid {false};
 
     // Raw text, as set with setRawText(…)
     QString _rawText;
@@ -31,9 +31,26 @@ Weather::METAR::METAR(QObject *parent)
 }
 
 
-Weather::METAR::METAR(QXmlStreamReader &xml, QObject *parent)
-    : Weather::Decoder(parent)
+Weather::METAR::METAR(const Data &data, QObject *parent)
+    : Weather::Decoder(parent),
+      _flightCategory(data.flightCategory),
+      _gust(data.gust),
+      _ICAOCode(data.ICAOCode),
+      _location(data.location),
+      _observationTime(data.observationTime),
+      _qnh(data.qnh),
+      _raw_text(data.rawText),
+      _wind(data.wind)
+{
+    // Interpret the METAR message
+    setRawText(_raw_text, _observationTime.date(), data.parseResult);
+    setupSignals();
+}
+
+
+auto Weather::METAR::readData(QXmlStreamReader &xml) -> Data
 {
+    Data data;
 
     while (true) {
         xml.readNextStartElement();
@@ -41,36 +58,36 @@ Weather::METAR::METAR(QXmlStreamReader &xml, QObject *parent)
 
         // Read Station_ID
         if (xml.isStartElement() && name == "station_id") {
-            _ICAOCode = xml.readElementText();
+            data.ICAOCode = xml.readElementText();
             continue;
         }
 
         // Read location
         if (xml.isStartElement() && name == "latitude") {
-            _location.setLatitude(xml.readElementText().toDouble());
+            data.location.setLatitude(xml.readElementText().toDouble());
             continue;
         }
         if (xml.isStartElement() && name == "longitude") {
-            _location.setLongitude(xml.readElementText().toDouble());
+            data.location.setLongitude(xml.readElementText().toDouble());
             continue;
         }
         if (xml.isStartElement() && name == "elevation_m") {
-            _location.setAltitude(xml.readElementText().toDouble());
+            data.location.setAltitude(xml.readElementText().toDouble());
             continue;
         }
 
         // Read raw text
         if (xml.isStartElement() && name == "raw_text") {
-            _raw_text = xml.readElementText();
+            data.rawText = xml.readElementText();
             continue;
         }
 
         // QNH
         if (xml.isStartElement() && name == "altim_in_hg") {
             auto content = xml.readElementText();
-            _qnh = qRound(content.toDouble() * 33.86);
-            if ((_qnh < 800) || (_qnh > 1200)) {
-                _qnh = 0;
+            data.qnh = qRound(content.toDouble() * 33.86);
+            if ((data.qnh < 800) || (data.qnh > 1200)) {
+                data.qnh = 0;
             }
             continue;
         }
@@ -78,23 +95,23 @@ Weather::METAR::METAR(QXmlStreamReader &xml, QObject *parent)
         // Wind
         if (xml.isStartElement() && name == "wind_speed_kt") {
             auto content = xml.readElementText();
-            _wind = AviationUnits::Speed::fromKN(content.toDouble());
+            data.wind = AviationUnits::Speed::fromKN(content.toDouble());
             continue;
         }
 
         // Gust
         if (xml.isStartElement() && name == "wind_gust_kt") {
             auto content = xml.readElementText();
-            _gust = AviationUnits::Speed::fromKN(content.toDouble());
+            data.gust = AviationUnits::Speed::fromKN(content.toDouble());
             continue;
         }
 
         // QNH
         if (xml.isStartElement() && name == "altim_in_hg") {
             auto content = xml.readElementText();
-            _qnh = qRound(content.toDouble() * 33.86);
-            if ((_qnh < 800) || (_qnh > 1200)) {
-                _qnh = 0;
+            data.qnh = qRound(content.toDouble() * 33.86);
+            if ((data.qnh < 800) || (data.qnh > 1200)) {
+                data.qnh = 0;
             }
             continue;
         }
@@ -102,7 +119,7 @@ Weather::METAR::METAR(QXmlStreamReader &xml, QObject *parent)
         // Observation Time
         if (xml.isStartElement() && name == "observation_time") {
             auto content = xml.readElementText();
-            _observationTime = QDateTime::fromString(content, Qt::ISODate);
+            data.observationTime = QDateTime::fromString(content, Qt::ISODate);
             continue;
         }
 
@@ -110,48 +127,43 @@ Weather::METAR::METAR(QXmlStreamReader &xml, QObject *parent)
         if (xml.isStartElement() && name == "flight_category") {
             auto content = xml.readElementText();
             if (content == "VFR") {
-                _flightCategory = VFR;
+                data.flightCategory = VFR;
             }
             if (content == "MVFR") {
-                _flightCategory = MVFR;
+                data.flightCategory = MVFR;
             }
             if (content == "IFR") {
-                _flightCategory = IFR;
+                data.flightCategory = IFR;
             }
             if (content == "LIFR") {
-                _flightCategory = LIFR;
+                data.flightCategory = LIFR;
             }
             continue;
         }
 
-        if (xml.isEndElement() && name == "METAR") {
+        if ((xml.isEndElement() && name == "METAR") || xml.atEnd() || xml.hasError()) {
             break;
         }
 
         xml.skipCurrentElement();
     }
 
-    // Interpret the METAR message
-    setRawText(_raw_text, _observationTime.date());
-    setupSignals();
+    return data;
 }
 
 
-Weather::METAR::METAR(QDataStream &inputStream, QObject *parent)
-    : Weather::Decoder(parent)
+auto Weather::METAR::readData(QDataStream &inputStream) -> Data
 {
-    inputStream >> _flightCategory;
-    inputStream >> _ICAOCode;
-    inputStream >> _location;
-    inputStream >> _observationTime;
-    inputStream >> _qnh;
-    inputStream >> _raw_text;
-    inputStream >> _wind;
-    inputStream >> _gust;
-
-    // Interpret the METAR message
-    setRawText(_raw_text, _observationTime.date());
-    setupSignals();
+    Data data;
+    inputStream >> data.flightCategory;
+    inputStream >> data.ICAOCode;
+    inputStream >> data.location;
+    inputStream >> data.observationTime;
+    inputStream >> data.qnh;
+    inputStream >> data.rawText;
+    inputStream >> data.wind;
+    inputStream >> data.gust;
+    return data;
 }
 
 
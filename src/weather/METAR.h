@@ -70,6 +70,43 @@ public:
     };
     Q_ENUM(FlightCategory)
 
+    /*! \brief Content of a METAR report
+     *
+     * This is a plain value structure, which can be filled in any thread. The
+     * WeatherDataProvider reads the data delivered by the Aviation Weather
+     * Center in a worker thread and constructs METAR objects from the results
+     * in the GUI thread.
+     */
+    struct Data
+    {
+        /*! \brief Flight category, as returned by the Aviation Weather Center */
+        FlightCategory flightCategory {unknown};
+
+        /*! \brief Gust speed, as returned by the Aviation Weather Center */
+        AviationUnits::Speed gust;
+
+        /*! \brief Station ID, as returned by the Aviation Weather Center */
+        QString ICAOCode;
+
+        /*! \brief Station coordinate, as returned by the Aviation Weather Center */
+        QGeoCoordinate location;
+
+        /*! \brief Observation time, as returned by the Aviation Weather Center */
+        QDateTime observationTime;
+
+        /*! \brief QNH in hPa, as returned by the Aviation Weather Center */
+        quint16 qnh {0};
+
+        /*! \brief Raw METAR text, as returned by the Aviation Weather Center */
+        QString rawText;
+
+        /*! \brief Wind speed, as returned by the Aviation Weather Center */
+        AviationUnits::Speed wind;
+
+        /*! \brief Result of metaf::Parser::parse() for rawText */
+        metaf::ParseResult parseResult;
+    };
+
     /*! \brief Geographical coordinate of the station reporting this METAR
      *
      * If the station coordinate is unknown, the property contains an invalid
@@ -242,12 +279,17 @@ signals:
     void relativeObservationTimeChanged();
 
 protected:
-    // This constructor reads a XML stream, as provided by the Aviation Weather
-    // Center's Text Data Server, https://www.aviationweather.gov/dataserver
-    explicit METAR(QXmlStreamReader &xml, QObject *parent = nullptr);
+    // This constructor creates a METAR from data read by readData()
+    explicit METAR(const Data &data, QObject *parent = nullptr);
+
+    // Reads a METAR from a XML stream, as provided by the Aviation Weather
+    // Center's Text Data Server, https://www.aviationweather.gov/dataserver.
+    // This method is reentrant and does not parse the raw text.
+    static Data readData(QXmlStreamReader &xml);
 
-    // This constructor reads a serialized METAR from a QDataStream
-    explicit METAR(QDataStream &inputStream, QObject *parent = nullptr);
+    // Reads a METAR serialized by write() from a QDataStream. This method is
+    // reentrant and does not parse the raw text.
+    static Data readData(QDataStream &inputStream);
 
 private:
     // Connects signals; this method is used internally from the constructor(s)
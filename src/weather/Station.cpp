@@ -38,24 +38,21 @@ Weather::Station::Station(QString id, GeoMaps::GeoMapProvider *geoMapProvider, Q
     _extendedName = _ICAOCode;
     _twoLineTitle = _ICAOCode;
 
-    // Wire up with GeoMapProvider, in order to learn about future changes in waypoints
-    connect(_geoMapProvider, &GeoMaps::GeoMapProvider::geoJSONChanged, this, &Weather::Station::readDataFromWaypoint);
-    readDataFromWaypoint();
+    // Read data from matching waypoint, if one is known. Otherwise, the
+    // WeatherDataProvider will retry whenever the GeoMapProvider has new data.
+    if (!_geoMapProvider.isNull()) {
+        readDataFromWaypoint(_geoMapProvider->findByID(_ICAOCode));
+    }
 }
 
 
-void Weather::Station::readDataFromWaypoint()
+void Weather::Station::readDataFromWaypoint(const GeoMaps::Waypoint& waypoint)
 {
-    // Paranoid safety checks
-    if (_geoMapProvider.isNull()) {
-        return;
-}
     // Immediately quit if we already have the necessary data
     if (hasWaypointData) {
         return;
-}
+    }
 
-    auto waypoint = _geoMapProvider->findByID(_ICAOCode);
     if (!waypoint.isValid()) {
         return;
     }
@@ -85,8 +82,6 @@ void Weather::Station::readDataFromWaypoint()
     if (_twoLineTitle != cacheTwoLineTitle) {
         emit twoLineTitleChanged();
 }
-
-    disconnect(_geoMapProvider, nullptr, this, nullptr);
 }
 
 
@@ -27,6 +27,7 @@
 
 namespace GeoMaps {
 class GeoMapProvider;
+class Waypoint;
 }
 
 
@@ -263,15 +264,15 @@ signals:
     /* \brief Notifier signal */
     void twoLineTitleChanged();
 
-private slots:
-    // This method attempts to find a waypoint matchting this weather station,
-    // in order to learn additional data about the station. This method is
-    // called automaticall whenever the GeoMapProvider has new data.
-    void readDataFromWaypoint();
-
 private:
     Q_DISABLE_COPY_MOVE(Station)
 
+    // This method reads additional data about the station from a waypoint
+    // matching this weather station. Invalid waypoints are ignored. The method
+    // is called by the constructor and by the WeatherDataProvider, whenever
+    // the GeoMapProvider has new data.
+    void readDataFromWaypoint(const GeoMaps::Waypoint& waypoint);
+
     // This constructor is only meant to be called by instances of the
     // WeatherDataProvider class
     explicit Station(QString id, GeoMaps::GeoMapProvider *geoMapProvider, QObject *parent);
@@ -25,9 +25,22 @@
 #include "weather/TAF.h"
 
 
-Weather::TAF::TAF(QXmlStreamReader &xml, QObject *parent)
-    : Weather::Decoder(parent)
+Weather::TAF::TAF(const Data &data, QObject *parent)
+    : Weather::Decoder(parent),
+      _expirationTime(data.expirationTime),
+      _ICAOCode(data.ICAOCode),
+      _issueTime(data.issueTime),
+      _location(data.location),
+      _raw_text(data.rawText)
 {
+    setRawText(_raw_text, _issueTime.date().addDays(5), data.parseResult);
+    setupSignals();
+}
+
+
+auto Weather::TAF::readData(QXmlStreamReader &xml) -> Data
+{
+    Data data;
 
     while (true) {
         xml.readNextStartElement();
@@ -35,65 +48,62 @@ Weather::TAF::TAF(QXmlStreamReader &xml, QObject *parent)
 
         // Read Station_ID
         if (xml.isStartElement() && name == "station_id") {
-            _ICAOCode = xml.readElementText();
+            data.ICAOCode = xml.readElementText();
             continue;
         }
 
         // Read location
         if (xml.isStartElement() && name == "latitude") {
-            _location.setLatitude(xml.readElementText().toDouble());
+            data.location.setLatitude(xml.readElementText().toDouble());
             continue;
         }
         if (xml.isStartElement() && name == "longitude") {
-            _location.setLongitude(xml.readElementText().toDouble());
+            data.location.setLongitude(xml.readElementText().toDouble());
             continue;
         }
         if (xml.isStartElement() && name == "elevation_m") {
-            _location.setAltitude(xml.readElementText().toDouble());
+            data.location.setAltitude(xml.readElementText().toDouble());
             continue;
         }
 
         // Read raw text
         if (xml.isStartElement() && name == "raw_text") {
-            _raw_text = xml.readElementText();
+            data.rawText = xml.readElementText();
             continue;
         }
 
         // Read issue time
         if (xml.isStartElement() && name == "issue_time") {
-            _issueTime = QDateTime::fromString(xml.readElementText(), Qt::ISODate);
+            data.issueTime = QDateTime::fromString(xml.readElementText(), Qt::ISODate);
             continue;
         }
 
         // Read expiration date
         if (xml.isStartElement() && name == "valid_time_to") {
-            _expirationTime = QDateTime::fromString(xml.readElementText(), Qt::ISODate);
+            data.expirationTime = QDateTime::fromString(xml.readElementText(), Qt::ISODate);
             continue;
         }
 
-        if (xml.isEndElement() && name == "TAF") {
+        if ((xml.isEndElement() && name == "TAF") || xml.atEnd() || xml.hasError()) {
             break;
 }
 
         xml.skipCurrentElement();
     }
 
-    setRawText(_raw_text, _issueTime.date().addDays(5));
-    setupSignals();
+    return data;
 }
 
 
-Weather::TAF::TAF(QDataStream &inputStream, QObject *parent)
-    : Weather::Decoder(parent)
+auto Weather::TAF::readData(QDataStream &inputStream) -> Data
 {
-    inputStream >> _expirationTime;
-    inputStream >> _ICAOCode;
-    inputStream >> _issueTime;
-    inputStream >> _location;
-    inputStream >> _raw_text;
-
-    setRawText(_raw_text, _issueTime.date().addDays(5));
-    setupSignals();
+    Data data;
+    inputStream >> data.expirationTime;
+    inputStream >> data.ICAOCode;
+    inputStream >> data.issueTime;
+    inputStream >> data.location;
+    inputStream >> data.rawText;
+    return data;
 }
 
 
@@ -56,6 +56,34 @@ public:
     // Standard destructor
     ~TAF() override = default;
 
+    /*! \brief Content of a TAF report
+     *
+     * This is a plain value structure, which can be filled in any thread. The
+     * WeatherDataProvider reads the data delivered by the Aviation Weather
+     * Center in a worker thread and constructs TAF objects from the results in
+     * the GUI thread.
+     */
+    struct Data
+    {
+        /*! \brief Expiration time, as returned by the Aviation Weather Center */
+        QDateTime expirationTime;
+
+        /*! \brief Station ID, as returned by the Aviation Weather Center */
+        QString ICAOCode;
+
+        /*! \brief Issue time, as returned by the Aviation Weather Center */
+        QDateTime issueTime;
+
+        /*! \brief Station coordinate, as returned by the Aviation Weather Center */
+        QGeoCoordinate location;
+
+        /*! \brief Raw TAF text, as returned by the Aviation Weather Center */
+        QString rawText;
+
+        /*! \brief Result of metaf::Parser::parse() for rawText */
+        metaf::ParseResult parseResult;
+    };
+
     /*! \brief Geographical coordinate of the station reporting this TAF
      *
      * If the station coordinate is unknown, the property contains an invalid coordinate.
@@ -162,12 +190,16 @@ signals:
     void relativeIssueTimeChanged();
 
 private:
-    // This constructor reads a XML stream, as provided by the Aviation Weather Center's Text Data Server,
-    // https://www.aviationweather.gov/dataserver
-    explicit TAF(QXmlStreamReader &xml, QObject *parent = nullptr);
+    // This constructor creates a TAF from data read by readData()
+    explicit TAF(const Data &data, QObject *parent = nullptr);
+
+    // Reads a TAF from a XML stream, as provided by the Aviation Weather Center's Text Data Server,
+    // https://www.aviationweather.gov/dataserver. This method is reentrant and does not parse the raw text.
+    static Data readData(QXmlStreamReader &xml);
 
-    // This constructor reads a serialized TAF from a QDataStream
-    explicit TAF(QDataStream &inputStream, QObject *parent = nullptr);
+    // Reads a TAF serialized by write() from a QDataStream. This method is
+    // reentrant and does not parse the raw text.
+    static Data readData(QDataStream &inputStream);
 
     // Connects signals; this method is used internally from the constructor(s)
     void setupSignals() const;
@@ -26,19 +26,26 @@
 #include <QSaveFile>
 #include <QStandardPaths>
 #include <QXmlStreamReader>
+#include <QtConcurrent>
 #include <QtGlobal>
+#include <QtMath>
 
 #include "sunset.h"
 
 #include "Clock.h"
 #include "Global.h"
+#include "MemoryBudget.h"
+#include "Metrics.h"
 #include "Settings.h"
+#include "StartupTracer.h"
 #include "geomaps/GeoMapProvider.h"
 #include "navigation/FlightRoute.h"
 #include "navigation/Navigator.h"
 #include "positioning/PositionProvider.h"
 #include "weather/METAR.h"
 #include "weather/WeatherDataProvider.h"
+#include "weather/WeatherDataProvider_Model.h"
+#include <algorithm>
 #include <chrono>
 
 using namespace std::chrono_literals;
@@ -52,44 +59,71 @@ QPointer<Weather::WeatherDataProvider> WeatherDataProviderStatic {};
 
 Weather::WeatherDataProvider::WeatherDataProvider(QObject *parent) : QObject(parent)
 {
+    _fileWriterPool.setMaxThreadCount(1);
+
     // Connect the timer to the update method. This will set backgroundUpdate to the default value,
     // which is true. So these updates happen in the background.
     // Schedule the first update in 1 seconds from now
-    connect(&_updateTimer, &QTimer::timeout, [=, this](){ this->update(); });
+    connect(&_updateTimer, &Scheduler::Timer::timeout, [=, this](){ this->update(); });
     _updateTimer.setInterval(updateIntervalNormal_ms);
     _updateTimer.start();
 
-    // Connect the timer to check for expired messages
-    connect(&_deleteExiredMessagesTimer, &QTimer::timeout, this, &Weather::WeatherDataProvider::deleteExpiredMesages);
-    _deleteExiredMessagesTimer.setInterval(10min);
-    _deleteExiredMessagesTimer.start();
+    // Connect the timer to delete expired messages. The timer is started by
+    // scheduleExpiration() and fires only when a report expires.
+    _deleteExpiredMessagesTimer.setSingleShot(true);
+    connect(&_deleteExpiredMessagesTimer, &Scheduler::Timer::timeout, this, &Weather::WeatherDataProvider::deleteExpiredMesages);
 
     // Update the description text when needed
+    connect(this, &Weather::WeatherDataProvider::weatherStationsChanged, this, &Weather::WeatherDataProvider::invalidateStationIndex);
     connect(this, &Weather::WeatherDataProvider::weatherStationsChanged, this, &Weather::WeatherDataProvider::QNHInfoChanged);
 
+    // The model is constructed after the connections above, so that the list
+    // of weather stations is up to date when the model reads it
+    _model = new Model(this);
+
     // Set up connections to other static objects, but do so with a little lag to avoid conflicts in the initialisation
     QTimer::singleShot(0, this, &Weather::WeatherDataProvider::setupConnections);
 
-    // Read METAR/TAF from "weather.dat"
-    bool success = load();
-
-    // Compute time for next update
-    int remainingTime = QDateTime::currentDateTimeUtc().msecsTo( _lastUpdate.addMSecs(updateIntervalNormal_ms) );
-    if (!success || !_lastUpdate.isValid() || (remainingTime < 0)) {
-        update();
-    } else {
-        _updateTimer.setInterval(remainingTime);
-    }
+    // Read METAR/TAF from "weather.dat" in the background. This also
+    // schedules the next update.
+    load();
 }
 
 
 void Weather::WeatherDataProvider::setupConnections() const
 {
     connect(Positioning::PositionProvider::globalInstance(), &Positioning::PositionProvider::receivingPositionInfoChanged, this, &Weather::WeatherDataProvider::QNHInfoChanged);
-    connect(Positioning::PositionProvider::globalInstance(), &Positioning::PositionProvider::receivingPositionInfoChanged, this, &Weather::WeatherDataProvider::sunInfoChanged);
+    connect(Positioning::PositionProvider::globalInstance(), &Positioning::PositionProvider::receivingPositionInfoChanged, this, &Weather::WeatherDataProvider::updateSunInfo);
+    connect(Positioning::PositionProvider::globalInstance(), &Positioning::PositionProvider::lastValidCoordinateChanged, this, &Weather::WeatherDataProvider::onLastValidCoordinateChanged);
 
     connect(Clock::globalInstance(), &Clock::timeChanged, this, &Weather::WeatherDataProvider::QNHInfoChanged);
-    connect(Clock::globalInstance(), &Clock::timeChanged, this, &Weather::WeatherDataProvider::sunInfoChanged);
+    connect(Clock::globalInstance(), &Clock::timeChanged, this, &Weather::WeatherDataProvider::updateSunInfo);
+
+    connect(Global::geoMapProvider(), &GeoMaps::GeoMapProvider::geoJSONChanged, this, &Weather::WeatherDataProvider::readWaypointDataForStations);
+
+    connect(Global::memoryBudget(), &MemoryBudget::trimCaches, this, &Weather::WeatherDataProvider::trimCaches);
+}
+
+
+void Weather::WeatherDataProvider::readWaypointDataForStations()
+{
+    QStringList ICAOCodes;
+    QVector<Weather::Station*> stations;
+    foreach(auto weatherStation, _weatherStationsByICAOCode) {
+        if (weatherStation.isNull() || weatherStation->hasWaypointData) {
+            continue;
+        }
+        ICAOCodes << weatherStation->ICAOCode();
+        stations << weatherStation;
+    }
+    if (stations.isEmpty()) {
+        return;
+    }
+
+    auto waypoints = Global::geoMapProvider()->findByIDs(ICAOCodes);
+    for(int i=0; i<stations.size(); i++) {
+        stations[i]->readDataFromWaypoint(waypoints[i]);
+    }
 }
 
 
@@ -98,39 +132,83 @@ Weather::WeatherDataProvider::~WeatherDataProvider() = default;
 
 void Weather::WeatherDataProvider::deleteExpiredMesages()
 {
-    QVector<QString> ICAOCodesToDelete;
-
-    foreach(auto weatherStation, _weatherStationsByICAOCode) {
-        if (weatherStation->hasMETAR()) {
-            if (weatherStation->metar()->expiration() < QDateTime::currentDateTime()) {
-                weatherStation->setMETAR(nullptr);
-            }
+    // Take all expirations that are due from the heap. Entries whose report
+    // has since been replaced or deleted are simply dropped.
+    auto now = QDateTime::currentMSecsSinceEpoch();
+    bool hasChanges = false;
+    while (!_expirations.isEmpty() && (_expirations.first().expiration_ms <= now)) {
+        std::pop_heap(_expirations.begin(), _expirations.end(), Expiration::later);
+        auto expiration = _expirations.takeLast();
+        if (expiration.station.isNull() || expiration.report.isNull()) {
+            continue;
         }
-        if (weatherStation->hasTAF()) {
-            if (weatherStation->taf()->expiration() < QDateTime::currentDateTime()) {
-                weatherStation->setTAF(nullptr);
-            }
+        if (static_cast<QObject*>(expiration.station->metar()) == expiration.report) {
+            expiration.station->setMETAR(nullptr);
+            hasChanges = true;
         }
-
-        if (!weatherStation->hasMETAR() && !weatherStation->hasTAF()) {
-            ICAOCodesToDelete << weatherStation->ICAOCode();
-            weatherStation->deleteLater();
+        if (static_cast<QObject*>(expiration.station->taf()) == expiration.report) {
+            expiration.station->setTAF(nullptr);
+            hasChanges = true;
         }
+        hasChanges |= deleteStationIfUnused(expiration.station);
     }
+    startExpirationTimer();
 
-    // If there is nothing to delete, wonderful
-    if (ICAOCodesToDelete.isEmpty()) {
+    // If there is nothing to delete, wonderful. Otherwise, let the world
+    // know, once for all reports that expired.
+    if (!hasChanges) {
         return;
     }
-
-    // Otherwiese, remove the weather stations from the list, and let the world know
-    foreach(auto ICAOCodeToDelete, ICAOCodesToDelete)
-        _weatherStationsByICAOCode.remove(ICAOCodeToDelete);
     emit weatherStationsChanged();
     save();
 }
 
 
+auto Weather::WeatherDataProvider::deleteStationIfUnused(Weather::Station *weatherStation) -> bool
+{
+    if (weatherStation->hasMETAR() || weatherStation->hasTAF()) {
+        return false;
+    }
+    if (_weatherStationsByICAOCode.value(weatherStation->ICAOCode()) == weatherStation) {
+        _weatherStationsByICAOCode.remove(weatherStation->ICAOCode());
+    }
+    invalidateStationIndex();
+    weatherStation->deleteLater();
+    return true;
+}
+
+
+void Weather::WeatherDataProvider::scheduleExpiration(Weather::Station *weatherStation, QObject *report, const QDateTime& expiration)
+{
+    // Reports without expiration time never expire
+    if (!expiration.isValid()) {
+        return;
+    }
+
+    _expirations.append({expiration.toMSecsSinceEpoch(), weatherStation, report});
+    std::push_heap(_expirations.begin(), _expirations.end(), Expiration::later);
+
+    // Restart the timer if the new report is the first to expire
+    if (_expirations.first().report == report) {
+        startExpirationTimer();
+    }
+}
+
+
+void Weather::WeatherDataProvider::startExpirationTimer()
+{
+    if (_expirations.isEmpty()) {
+        _deleteExpiredMessagesTimer.stop();
+        return;
+    }
+
+    // QTimer cannot handle very long intervals. If the first report expires
+    // in the far future, check again after a day.
+    qint64 remainingTime_ms = _expirations.first().expiration_ms-QDateTime::currentMSecsSinceEpoch();
+    _deleteExpiredMessagesTimer.start(static_cast<int>(qBound(static_cast<qint64>(0), remainingTime_ms, maxExpirationInterval_ms)));
+}
+
+
 auto Weather::WeatherDataProvider::downloading() const -> bool
 {
     foreach(auto networkReply, _networkReplies) {
@@ -141,6 +219,11 @@ auto Weather::WeatherDataProvider::downloading() const -> bool
             return true;
         }
     }
+    foreach(auto reportReader, _reportReaders) {
+        if (!reportReader.isNull()) {
+            return true;
+        }
+    }
 
     return false;
 }
@@ -148,47 +231,15 @@ auto Weather::WeatherDataProvider::downloading() const -> bool
 
 void Weather::WeatherDataProvider::downloadFinished() {
 
-    // Start to process the data only once ALL replies have been received. So, we check here if there are any running
-    // download processes and abort if indeed there are some.
+    // Finish only once ALL replies have been received and read. So, we check here if there are any running
+    // download processes or readers and abort if indeed there are some.
     if (downloading()) {
         return;
     }
-
-    // Update flag
-    emit downloadingChanged();
-
-    // Read all replies and store the data in respective maps
-    bool hasError = false;
-    foreach(auto networkReply, _networkReplies) {
-        // Paranoid safety checks
-        if (networkReply.isNull()) {
-            continue;
-        }
-        if (networkReply->error() != QNetworkReply::NoError) {
-            hasError = true;
-            emit error(networkReply->errorString());
-            continue;
-        }
-
-        // Decode XML
-        QXmlStreamReader xml(networkReply);
-        while (!xml.atEnd() && !xml.hasError())
-        {
-            xml.readNext();
-
-            // Read METAR
-            if (xml.isStartElement() && (xml.name() == "METAR")) {
-                auto *metar = new Weather::METAR(xml, this);
-                findOrConstructWeatherStation(metar->ICAOCode())->setMETAR(metar);
-            }
-
-            // Read TAF
-            if (xml.isStartElement() && (xml.name() == "TAF")) {
-                auto *taf = new Weather::TAF(xml, this);
-                findOrConstructWeatherStation(taf->ICAOCode())->setTAF(taf);
-            }
-
-        }
+    Metrics::Timer timer(Metrics::WeatherDownloadFinished);
+    if (_downloadTimer.isValid()) {
+        Metrics::record(Metrics::WeatherDownload, _downloadTimer.nsecsElapsed());
+        _downloadTimer.invalidate();
     }
 
     // Clear replies container
@@ -196,10 +247,11 @@ void Weather::WeatherDataProvider::downloadFinished() {
     _networkReplies.clear();
 
     // Update flag and signals
+    emit downloadingChanged();
     emit weatherStationsChanged();
     emit QNHInfoChanged();
 
-    if (hasError) {
+    if (_downloadHasError) {
         _updateTimer.setInterval(updateIntervalOnError_ms);
     } else {
         _lastUpdate = QDateTime::currentDateTimeUtc();
@@ -209,6 +261,184 @@ void Weather::WeatherDataProvider::downloadFinished() {
 }
 
 
+void Weather::WeatherDataProvider::replyFinished(QNetworkReply* reply, const std::shared_ptr<ReplyReader>& reader)
+{
+    // Paranoid safety checks
+    if (!_networkReplies.contains(reply)) {
+        return;
+    }
+    _networkReplies.removeAll(reply);
+    reply->deleteLater();
+
+    if (reply->error() != QNetworkReply::NoError) {
+        _replyValidators.remove(reply->request().url());
+        _downloadHasError = true;
+        emit error(reply->errorString());
+        downloadFinished();
+        return;
+    }
+
+    // Remember the validators of the reply for the next conditional request.
+    // If the data has not changed since the last request, there is nothing to
+    // read.
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304) {
+        downloadFinished();
+        return;
+    }
+    if (reply->hasRawHeader("ETag") || reply->hasRawHeader("Last-Modified")) {
+        _replyValidators.insert(reply->request().url(), {reply->rawHeader("ETag"), reply->rawHeader("Last-Modified")});
+    } else {
+        _replyValidators.remove(reply->request().url());
+    }
+
+    // Read the rest of the reply
+    reader->pendingData += reply->readAll();
+    reader->replyFinished = true;
+    startReportReader(reader);
+}
+
+
+void Weather::WeatherDataProvider::readReplyData(QNetworkReply* reply, const std::shared_ptr<ReplyReader>& reader)
+{
+    if ((reply == nullptr) || (reply->error() != QNetworkReply::NoError)) {
+        return;
+    }
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) {
+        return;
+    }
+    reader->pendingData += reply->readAll();
+    startReportReader(reader);
+}
+
+
+void Weather::WeatherDataProvider::startReportReader(const std::shared_ptr<ReplyReader>& reader)
+{
+    if (reader->busy) {
+        return;
+    }
+
+    // Find the data that can be read now. Unless the reply is finished, this
+    // is the data up to the end of the last complete METAR or TAF element.
+    auto size = reader->pendingData.size();
+    if (!reader->replyFinished) {
+        auto endOfMETAR = reader->pendingData.lastIndexOf("</METAR>");
+        auto endOfTAF = reader->pendingData.lastIndexOf("</TAF>");
+        size = qMax((endOfMETAR < 0) ? 0 : endOfMETAR+8, (endOfTAF < 0) ? 0 : endOfTAF+6);
+    }
+    if (size == 0) {
+        if (reader->replyFinished) {
+            downloadFinished();
+        }
+        return;
+    }
+    auto data = reader->pendingData.left(size);
+    reader->pendingData.remove(0, size);
+
+    // Read the data in a worker thread, and hand the results over to the
+    // weather stations once they are ready
+    reader->busy = true;
+    auto* reportReader = new QFutureWatcher<Reports>(this);
+    _reportReaders.append(reportReader);
+    connect(reportReader, &QFutureWatcher<Reports>::finished, this, [this, reportReader, reader]() {
+        _reportReaders.removeAll(reportReader);
+        reportReader->deleteLater();
+        reader->busy = false;
+        addReports(reportReader->result());
+        startReportReader(reader);
+    });
+    reportReader->setFuture(QtConcurrent::run(&Weather::WeatherDataProvider::readReports, reader, data));
+}
+
+
+auto Weather::WeatherDataProvider::readReports(const std::shared_ptr<ReplyReader>& reader, const QByteArray& data) -> Reports
+{
+    Reports reports;
+
+    // If the previous data ended prematurely, the next call to readNext()
+    // continues where reading stopped
+    auto& xml = reader->xml;
+    xml.addData(data);
+    forever {
+        xml.readNext();
+        if (xml.atEnd()) {
+            break;
+        }
+
+        // Read METAR
+        if (xml.isStartElement() && (xml.name() == "METAR")) {
+            auto metar = Weather::METAR::readData(xml);
+            if (reader->knownMETARs.value(metar.ICAOCode) == metar.rawText) {
+                continue;
+            }
+            metar.parseResult = metaf::Parser::parse(metar.rawText.toStdString());
+            reports.METARs.append(metar);
+        }
+
+        // Read TAF
+        if (xml.isStartElement() && (xml.name() == "TAF")) {
+            auto taf = Weather::TAF::readData(xml);
+            if (reader->knownTAFs.value(taf.ICAOCode) == taf.rawText) {
+                continue;
+            }
+            taf.parseResult = metaf::Parser::parse(taf.rawText.toStdString());
+            reports.TAFs.append(taf);
+        }
+    }
+
+    return reports;
+}
+
+
+void Weather::WeatherDataProvider::addReports(const Reports& reports, bool isNew)
+{
+    if (reports.METARs.isEmpty() && reports.TAFs.isEmpty()) {
+        return;
+    }
+
+    // Reports that are older than the ones known for the station are ignored.
+    // New reports are remembered for the next call to save().
+    foreach(auto data, reports.METARs) {
+        auto *weatherStation = findOrConstructWeatherStation(data.ICAOCode);
+        if (weatherStation->hasMETAR() && (weatherStation->metar()->observationTime() > data.observationTime)) {
+            continue;
+        }
+        auto *metar = new Weather::METAR(data, this);
+        weatherStation->setMETAR(metar);
+        if (weatherStation->metar() != metar) {
+            // The METAR was invalid or expired. Do not keep stations that
+            // were constructed for it alone.
+            deleteStationIfUnused(weatherStation);
+            continue;
+        }
+        scheduleExpiration(weatherStation, metar, metar->expiration());
+        if (isNew) {
+            _unsavedRecords += reportRecord('M', metar->ICAOCode(), [metar](QDataStream& out) { metar->write(out); });
+            _unsavedRecordCount++;
+        }
+    }
+    foreach(auto data, reports.TAFs) {
+        auto *weatherStation = findOrConstructWeatherStation(data.ICAOCode);
+        if (weatherStation->hasTAF() && (weatherStation->taf()->issueTime() > data.issueTime)) {
+            continue;
+        }
+        auto *taf = new Weather::TAF(data, this);
+        weatherStation->setTAF(taf);
+        if (weatherStation->taf() != taf) {
+            deleteStationIfUnused(weatherStation);
+            continue;
+        }
+        scheduleExpiration(weatherStation, taf, taf->expiration());
+        if (isNew) {
+            _unsavedRecords += reportRecord('T', taf->ICAOCode(), [taf](QDataStream& out) { taf->write(out); });
+            _unsavedRecordCount++;
+        }
+    }
+
+    emit weatherStationsChanged();
+    emit QNHInfoChanged();
+}
+
+
 auto Weather::WeatherDataProvider::findOrConstructWeatherStation(const QString &ICAOCode) -> Weather::Station *
 {
     auto weatherStationPtr = _weatherStationsByICAOCode.value(ICAOCode, nullptr);
@@ -218,11 +448,102 @@ auto Weather::WeatherDataProvider::findOrConstructWeatherStation(const QString &
     }
 
     auto *newWeatherStation = new Weather::Station(ICAOCode, Global::geoMapProvider(), this);
+    connect(newWeatherStation, &Weather::Station::coordinateChanged, this, &Weather::WeatherDataProvider::invalidateStationIndex);
     _weatherStationsByICAOCode.insert(ICAOCode, newWeatherStation);
+    invalidateStationIndex();
     return newWeatherStation;
 }
 
 
+void Weather::WeatherDataProvider::invalidateStationIndex()
+{
+    _stationIndexValid = false;
+    _sortedStationsValid = false;
+}
+
+
+auto Weather::WeatherDataProvider::memoryUsage() const -> qint64
+{
+    qint64 result = sizeof(*this);
+    foreach(auto station, _weatherStationsByICAOCode) {
+        if (station.isNull()) {
+            continue;
+        }
+        result += sizeof(Weather::Station);
+        if (station->metar() != nullptr) {
+            result += station->metar()->memoryUsage();
+        }
+        if (station->taf() != nullptr) {
+            result += station->taf()->memoryUsage();
+        }
+    }
+    result += (_indexedStations.size()+_sortedStations.size())*static_cast<qint64>(sizeof(QPointer<Weather::Station>));
+    return result;
+}
+
+
+void Weather::WeatherDataProvider::trimCaches()
+{
+    foreach(auto station, _weatherStationsByICAOCode) {
+        if (station.isNull()) {
+            continue;
+        }
+        if (station->metar() != nullptr) {
+            station->metar()->invalidateDecodedText();
+        }
+        if (station->taf() != nullptr) {
+            station->taf()->invalidateDecodedText();
+        }
+    }
+
+    _sortedStations.clear();
+    _sortedStationsValid = false;
+}
+
+
+void Weather::WeatherDataProvider::onLastValidCoordinateChanged(const QGeoCoordinate& coordinate)
+{
+    if (_notifiedPosition.isValid() && (coordinate.distanceTo(_notifiedPosition) <= resortDistance_m)) {
+        return;
+    }
+
+    _notifiedPosition = coordinate;
+    emit QNHInfoChanged();
+    updateSunInfo();
+}
+
+
+void Weather::WeatherDataProvider::updateSunInfo()
+{
+    auto newSunInfo = sunInfo();
+    if (newSunInfo == _sunInfo) {
+        return;
+    }
+    _sunInfo = newSunInfo;
+    emit sunInfoChanged();
+}
+
+
+void Weather::WeatherDataProvider::updateStationIndex() const
+{
+    if (_stationIndexValid) {
+        return;
+    }
+
+    QVector<GeoMaps::Waypoint> waypoints;
+    _indexedStations.clear();
+    foreach(auto weatherStation, _weatherStationsByICAOCode) {
+        if (weatherStation.isNull() || !weatherStation->coordinate().isValid()) {
+            continue;
+        }
+        waypoints.append(GeoMaps::Waypoint(weatherStation->coordinate()));
+        _indexedStations.append(weatherStation);
+    }
+    _stationIndex = GeoMaps::WaypointIndex(GeoMaps::WaypointTable(waypoints));
+    _stationIndexValid = true;
+}
+
+
 auto Weather::WeatherDataProvider::globalInstance() -> Weather::WeatherDataProvider*
 {
 #ifndef __clang_analyzer__
@@ -236,131 +557,222 @@ auto Weather::WeatherDataProvider::globalInstance() -> Weather::WeatherDataProvi
 }
 
 
-auto Weather::WeatherDataProvider::load() -> bool
+void Weather::WeatherDataProvider::load()
 {
-    auto stdFileName = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+"/weather.dat";
+    auto* fileReader = new QFutureWatcher<Reports>(this);
+    connect(fileReader, &QFutureWatcher<Reports>::finished, this, [this, fileReader]() {
+        fileReader->deleteLater();
+        auto reports = fileReader->result();
+        if (reports.lastUpdate.isValid()) {
+            _lastUpdate = reports.lastUpdate;
+        }
+        _savedLastUpdate = _lastUpdate;
+        _recordsInFile += reports.recordsRead;
+        addReports(reports, false);
+
+        // Compute time for next update
+        auto remainingTime = QDateTime::currentDateTimeUtc().msecsTo( _lastUpdate.addMSecs(updateIntervalNormal_ms) );
+        if (!reports.headerRead || !_lastUpdate.isValid() || (remainingTime < 0)) {
+            update();
+        } else {
+            _updateTimer.setInterval(static_cast<int>(remainingTime));
+        }
+    });
+    fileReader->setFuture(QtConcurrent::run(&Weather::WeatherDataProvider::readReportFile, reportFileName()));
+}
 
-    // Use LockFile. If lock could not be obtained, do nothing.
-    QLockFile lockFile(stdFileName+".lock");
-    if (!lockFile.tryLock()) {
-        return false;
-    }
 
-    // Open file
-    auto inputFile = QFile(stdFileName);
-    if (!inputFile.open(QIODevice::ReadOnly)) {
-        lockFile.unlock();
-        return false;
+auto Weather::WeatherDataProvider::readReportFile(const QString& fileName) -> Reports
+{
+    StartupTracer::Phase phase("Weather reports");
+
+    Reports reports;
+
+    QLockFile lockFile(fileName+".lock");
+    lockFile.lock();
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || (file.size() < reportFileHeaderSize)) {
+        return reports;
     }
+    auto* data = file.map(0, file.size());
+    if (data == nullptr) {
+        return reports;
+    }
+    auto buffer = QByteArray::fromRawData(reinterpret_cast<const char*>(data), static_cast<int>(file.size()));
 
-    // Generate input stream
-    QDataStream inputStream(&inputFile);
-    inputStream.setVersion(QDataStream::Qt_4_0);
-    // Check magic number and version
+    // Read the file header
+    QDataStream scanner(buffer);
+    scanner.setVersion(QDataStream::Qt_5_15);
     quint32 magic = 0;
-    inputStream >> magic;
-    if (magic != static_cast<quint32>(0x31415)) {
-        lockFile.unlock();
-        return false;
-    }
     quint32 version = 0;
-    inputStream >> version;
-    if (version != static_cast<quint32>(1)) {
-        lockFile.unlock();
-        return false;
+    qint64 lastUpdateMSecs = -1;
+    scanner >> magic >> version >> lastUpdateMSecs;
+    if ((scanner.status() != QDataStream::Ok) || (magic != reportFileMagic) || (version != reportFileVersion)) {
+        file.unmap(data);
+        return reports;
+    }
+    reports.headerRead = true;
+    if (lastUpdateMSecs >= 0) {
+        reports.lastUpdate = QDateTime::fromMSecsSinceEpoch(lastUpdateMSecs, Qt::UTC);
     }
 
-    // Read time of last update
-    inputStream >> _lastUpdate;
-
-    // Read file
-    bool hasError = false;
-    while (!inputStream.atEnd() && (inputStream.status() == QDataStream::Ok)) {
-        QChar type;
-        inputStream >> type;
+    // Go through the record headers and build an index of the last record
+    // for every ICAO code and type. Records that are overwritten by later
+    // ones are skipped without reading them. A record that was cut off,
+    // perhaps because the app was killed while writing, ends the scan.
+    QHash<QPair<quint8, QByteArray>, QPair<int, int>> index;
+    while (!scanner.atEnd()) {
+        quint8 type = 0;
+        QByteArray ICAOCode;
+        quint32 length = 0;
+        scanner >> type >> ICAOCode >> length;
+        auto offset = static_cast<int>(scanner.device()->pos());
+        if ((scanner.status() != QDataStream::Ok) || (scanner.skipRawData(static_cast<int>(length)) != static_cast<int>(length))) {
+            break;
+        }
+        index.insert({type, ICAOCode}, {offset, static_cast<int>(length)});
+        reports.recordsRead++;
+    }
 
-        if (type == 'M') {
-            // Read METAR
-            auto *metar = new Weather::METAR(inputStream, this);
-            findOrConstructWeatherStation(metar->ICAOCode())->setMETAR(metar);
-            continue;
+    // Read the records found in the index
+    foreach(auto key, index.keys()) {
+        auto position = index.value(key);
+        QDataStream inputStream(QByteArray::fromRawData(buffer.constData()+position.first, position.second));
+        inputStream.setVersion(QDataStream::Qt_5_15);
+        if (key.first == 'M') {
+            auto metar = Weather::METAR::readData(inputStream);
+            metar.parseResult = metaf::Parser::parse(metar.rawText.toStdString());
+            reports.METARs.append(metar);
         }
-        if (type == 'T') {
-            // Read TAF
-            auto *taf = new Weather::TAF(inputStream, this);
-            findOrConstructWeatherStation(taf->ICAOCode())->setTAF(taf);
-            continue;
+        if (key.first == 'T') {
+            auto taf = Weather::TAF::readData(inputStream);
+            taf.parseResult = metaf::Parser::parse(taf.rawText.toStdString());
+            reports.TAFs.append(taf);
         }
-
-        // Other type? That's bad! Quit immediately!
-        hasError = true;
-        break;
     }
 
-    // Ok, done
-    lockFile.unlock();
-    deleteExpiredMesages();
-    emit weatherStationsChanged();
-
-    return !hasError && (inputStream.status() == QDataStream::Ok);
+    file.unmap(data);
+    return reports;
 }
 
 
-void Weather::WeatherDataProvider::save()
+auto Weather::WeatherDataProvider::reportFileName() -> QString
 {
-    auto stdFileName = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+"/weather.dat";
-
-    // Use LockFile. If lock could not be obtained, do nothing.
-    QLockFile lockFile(stdFileName+".lock");
-    if (!lockFile.tryLock()) {
-        return;
-    }
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+"/weather.dat";
+}
 
-    // Open file
-    auto outputFile = QSaveFile(stdFileName);
-    if (!outputFile.open(QIODevice::WriteOnly)) {
-        lockFile.unlock();
-        return;
-    }
 
-    // Generate output stream
-    QDataStream outputStream(&outputFile);
-    outputStream.setVersion(QDataStream::Qt_4_0);
+auto Weather::WeatherDataProvider::reportRecord(quint8 type, const QString& ICAOCode, const std::function<void(QDataStream&)>& writer) -> QByteArray
+{
+    QByteArray payload;
+    QDataStream payloadStream(&payload, QIODevice::WriteOnly);
+    payloadStream.setVersion(QDataStream::Qt_5_15);
+    writer(payloadStream);
+
+    QByteArray record;
+    QDataStream recordStream(&record, QIODevice::WriteOnly);
+    recordStream.setVersion(QDataStream::Qt_5_15);
+    recordStream << type << ICAOCode.toLatin1() << static_cast<quint32>(payload.size());
+    recordStream.writeRawData(payload.constData(), payload.size());
+    return record;
+}
 
-    // Write magic number and version
-    outputStream << static_cast<quint32>(0x31415);
-    outputStream << static_cast<quint32>(1);
-    outputStream << _lastUpdate;
 
-    // Write data
+void Weather::WeatherDataProvider::save()
+{
+    // Count the reports that are worth saving
+    int validReports = 0;
     foreach(auto weatherStation, _weatherStationsByICAOCode) {
         if (weatherStation.isNull()) {
             continue;
         }
+        if (weatherStation->hasMETAR() && weatherStation->metar()->isValid() && !weatherStation->metar()->isExpired()) {
+            validReports++;
+        }
+        if (weatherStation->hasTAF() && weatherStation->taf()->isValid() && !weatherStation->taf()->isExpired()) {
+            validReports++;
+        }
+    }
 
-        if (weatherStation->hasMETAR()) {
-            // Save only valid METARs that are not yet expired
-            if (weatherStation->metar()->isValid() && !weatherStation->metar()->isExpired()) {
-                outputStream << QChar('M');
-                weatherStation->metar()->write(outputStream);
+    // As long as the file does not contain too many outdated records, append
+    // the new records. Otherwise, write a new file with the valid reports only.
+    bool replace = (_recordsInFile > 2*validReports+minRecordsBeforeCompaction);
+    if (replace) {
+        _unsavedRecords.clear();
+        _unsavedRecordCount = 0;
+        _recordsInFile = 0;
+        foreach(auto weatherStation, _weatherStationsByICAOCode) {
+            if (weatherStation.isNull()) {
+                continue;
+            }
+            if (weatherStation->hasMETAR() && weatherStation->metar()->isValid() && !weatherStation->metar()->isExpired()) {
+                auto *metar = weatherStation->metar();
+                _unsavedRecords += reportRecord('M', metar->ICAOCode(), [metar](QDataStream& out) { metar->write(out); });
+                _unsavedRecordCount++;
+            }
+            if (weatherStation->hasTAF() && weatherStation->taf()->isValid() && !weatherStation->taf()->isExpired()) {
+                auto *taf = weatherStation->taf();
+                _unsavedRecords += reportRecord('T', taf->ICAOCode(), [taf](QDataStream& out) { taf->write(out); });
+                _unsavedRecordCount++;
             }
         }
+    }
 
-        if (weatherStation->hasTAF()) {
-            // Save only valid TAFs that are not yet expired
-            if (weatherStation->taf()->isValid() && !weatherStation->taf()->isExpired()) {
-                outputStream << QChar('T');
-                weatherStation->taf()->write(outputStream);
+    // Write in the background, if there is anything to write. The pool has
+    // only one thread, so that writes happen in order.
+    if (!replace && _unsavedRecords.isEmpty() && (_lastUpdate == _savedLastUpdate)) {
+        return;
+    }
+    _savedLastUpdate = _lastUpdate;
+    _recordsInFile += _unsavedRecordCount;
+    QtConcurrent::run(&_fileWriterPool, &Weather::WeatherDataProvider::writeReportFile, reportFileName(), _lastUpdate, _unsavedRecords, replace);
+    _unsavedRecords.clear();
+    _unsavedRecordCount = 0;
+}
+
+
+void Weather::WeatherDataProvider::writeReportFile(const QString& fileName, const QDateTime& lastUpdate, const QByteArray& records, bool replace)
+{
+    QLockFile lockFile(fileName+".lock");
+    lockFile.lock();
+
+    QByteArray header;
+    QDataStream headerStream(&header, QIODevice::WriteOnly);
+    headerStream.setVersion(QDataStream::Qt_5_15);
+    headerStream << reportFileMagic << reportFileVersion << (lastUpdate.isValid() ? lastUpdate.toMSecsSinceEpoch() : qint64(-1));
+
+    // Append the records, and update the header in place
+    if (!replace) {
+        QFile file(fileName);
+        if (file.open(QIODevice::ReadWrite) && (file.size() >= reportFileHeaderSize)) {
+            QDataStream inputStream(&file);
+            inputStream.setVersion(QDataStream::Qt_5_15);
+            quint32 magic = 0;
+            quint32 version = 0;
+            inputStream >> magic >> version;
+            if ((magic == reportFileMagic) && (version == reportFileVersion)) {
+                file.seek(0);
+                file.write(header);
+                file.seek(file.size());
+                file.write(records);
+                return;
             }
         }
     }
 
-    outputFile.commit();
-    lockFile.unlock();
+    // Write a new file. This also happens if the old file is missing or has
+    // the wrong format.
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    file.write(header);
+    file.write(records);
+    file.commit();
 }
 
 
-auto Weather::WeatherDataProvider::sunInfo() -> QString
+auto Weather::WeatherDataProvider::sunInfo() const -> QString
 {
     // Paranoid safety checks
     auto *positionProvider = Positioning::PositionProvider::globalInstance();
@@ -371,57 +783,66 @@ auto Weather::WeatherDataProvider::sunInfo() -> QString
         return tr("Waiting for precise position…");
     }
 
-    // Describe next sunset/sunrise
-    QDateTime sunrise;
-    QDateTime sunset;
-    QDateTime sunriseTomorrow;
-
-    SunSet sun;
+    // Round the position, so that small movements do not require to compute
+    // sunrise and sunset again
     auto coord = positionProvider->positionInfo().coordinate();
-    auto timeZone = qRound(coord.longitude()/15.0);
+    auto latitude = qRound(coord.latitude()/sunTimesResolution_deg);
+    auto longitude = qRound(coord.longitude()/sunTimesResolution_deg);
+    auto timeZone = qRound(longitude*sunTimesResolution_deg/15.0);
 
     auto currentTime = QDateTime::currentDateTimeUtc();
     auto localTime = currentTime.toOffsetFromUtc(timeZone*60*60);
     auto localDate = localTime.date();
 
-    sun.setPosition(coord.latitude(), coord.longitude(), timeZone);
-    sun.setCurrentDate(localDate.year(), localDate.month(), localDate.day());
-
-    auto sunriseTimeInMin = sun.calcSunrise();
-    if (qIsFinite(sunriseTimeInMin)) {
-        sunrise = localTime;
-        sunrise.setTime(QTime::fromMSecsSinceStartOfDay(qRound(sunriseTimeInMin*60*1000)));
-        sunrise = sunrise.toOffsetFromUtc(0);
-        sunrise.setTimeSpec(Qt::UTC);
-    }
+    // Describe next sunset/sunrise
+    if ((latitude != _sunTimesLatitude) || (longitude != _sunTimesLongitude) || (localDate != _sunTimesDate)) {
+        _sunTimesLatitude = latitude;
+        _sunTimesLongitude = longitude;
+        _sunTimesDate = localDate;
+        _sunrise = QDateTime();
+        _sunset = QDateTime();
+        _sunriseTomorrow = QDateTime();
+
+        SunSet sun;
+        sun.setPosition(latitude*sunTimesResolution_deg, longitude*sunTimesResolution_deg, timeZone);
+        sun.setCurrentDate(localDate.year(), localDate.month(), localDate.day());
+
+        auto sunriseTimeInMin = sun.calcSunrise();
+        if (qIsFinite(sunriseTimeInMin)) {
+            _sunrise = localTime;
+            _sunrise.setTime(QTime::fromMSecsSinceStartOfDay(qRound(sunriseTimeInMin*60*1000)));
+            _sunrise = _sunrise.toOffsetFromUtc(0);
+            _sunrise.setTimeSpec(Qt::UTC);
+        }
 
-    auto sunsetTimeInMin = sun.calcSunset();
-    if (qIsFinite(sunsetTimeInMin)) {
-        sunset = localTime;
-        sunset.setTime(QTime::fromMSecsSinceStartOfDay(qRound(sunsetTimeInMin*60*1000)));
-        sunset = sunset.toOffsetFromUtc(0);
-        sunset.setTimeSpec(Qt::UTC);
-    }
+        auto sunsetTimeInMin = sun.calcSunset();
+        if (qIsFinite(sunsetTimeInMin)) {
+            _sunset = localTime;
+            _sunset.setTime(QTime::fromMSecsSinceStartOfDay(qRound(sunsetTimeInMin*60*1000)));
+            _sunset = _sunset.toOffsetFromUtc(0);
+            _sunset.setTimeSpec(Qt::UTC);
+        }
 
-    localTime = localTime.addDays(1);
-    localDate = localTime.date();
-    sun.setCurrentDate(localDate.year(), localDate.month(), localDate.day());
-    auto sunriseTomorrowTimeInMin = sun.calcSunrise();
-    if (qIsFinite(sunriseTomorrowTimeInMin)) {
-        sunriseTomorrow = localTime;
-        sunriseTomorrow.setTime(QTime::fromMSecsSinceStartOfDay(qRound(sunriseTomorrowTimeInMin*60*1000)));
-        sunriseTomorrow = sunriseTomorrow.toOffsetFromUtc(0);
-        sunriseTomorrow.setTimeSpec(Qt::UTC);
+        auto localTimeTomorrow = localTime.addDays(1);
+        auto localDateTomorrow = localTimeTomorrow.date();
+        sun.setCurrentDate(localDateTomorrow.year(), localDateTomorrow.month(), localDateTomorrow.day());
+        auto sunriseTomorrowTimeInMin = sun.calcSunrise();
+        if (qIsFinite(sunriseTomorrowTimeInMin)) {
+            _sunriseTomorrow = localTimeTomorrow;
+            _sunriseTomorrow.setTime(QTime::fromMSecsSinceStartOfDay(qRound(sunriseTomorrowTimeInMin*60*1000)));
+            _sunriseTomorrow = _sunriseTomorrow.toOffsetFromUtc(0);
+            _sunriseTomorrow.setTimeSpec(Qt::UTC);
+        }
     }
 
-    if (sunrise.isValid() && sunset.isValid() && sunriseTomorrow.isValid()) {
-        if (currentTime < sunrise) {
-            return tr("SR %1, %2").arg(Clock::describePointInTime(sunrise), Clock::describeTimeDifference(sunrise));
+    if (_sunrise.isValid() && _sunset.isValid() && _sunriseTomorrow.isValid()) {
+        if (currentTime < _sunrise) {
+            return tr("SR %1, %2").arg(Clock::describePointInTime(_sunrise), Clock::describeTimeDifference(_sunrise));
         }
-        if (currentTime < sunset.addSecs(40*60)) {
-            return tr("SS %1, %2").arg(Clock::describePointInTime(sunset), Clock::describeTimeDifference(sunset));
+        if (currentTime < _sunset.addSecs(40*60)) {
+            return tr("SS %1, %2").arg(Clock::describePointInTime(_sunset), Clock::describeTimeDifference(_sunset));
         }
-        return tr("SR %1, %2").arg(Clock::describePointInTime(sunriseTomorrow), Clock::describeTimeDifference(sunriseTomorrow));
+        return tr("SR %1, %2").arg(Clock::describePointInTime(_sunriseTomorrow), Clock::describeTimeDifference(_sunriseTomorrow));
     }
     return QString();
 }
@@ -435,31 +856,25 @@ auto Weather::WeatherDataProvider::QNHInfo() const -> QString
         return QString();
     }
 
-    // Find QNH of nearest airfield
+    // Find QNH of nearest airfield. Look at the nearest few stations first,
+    // and at more stations only if none of them reports a QNH.
+    updateStationIndex();
+    QGeoCoordinate here = Positioning::PositionProvider::lastValidCoordinate();
     Weather::Station *closestReportWithQNH = nullptr;
-    int QNH = 0;
-    foreach(auto weatherStationPtr, _weatherStationsByICAOCode) {
-        if (weatherStationPtr.isNull()) {
-            continue;
-        }
-        if (weatherStationPtr->metar() == nullptr) {
-            continue;
-        }
-        QNH = weatherStationPtr->metar()->QNH();
-        if (QNH == 0) {
-            continue;
-        }
-        if (!weatherStationPtr->coordinate().isValid()) {
-            continue;
-        }
-        if (closestReportWithQNH == nullptr) {
-            closestReportWithQNH = weatherStationPtr;
-            continue;
+    for(int k=8; closestReportWithQNH == nullptr; k *= 4) {
+        auto indices = _stationIndex.nearest(here, k);
+        foreach(auto index, indices) {
+            auto weatherStationPtr = _indexedStations[index];
+            if (weatherStationPtr.isNull() || (weatherStationPtr->metar() == nullptr)) {
+                continue;
+            }
+            if (weatherStationPtr->metar()->QNH() != 0) {
+                closestReportWithQNH = weatherStationPtr;
+                break;
+            }
         }
-
-        QGeoCoordinate here = Positioning::PositionProvider::lastValidCoordinate();
-        if (here.distanceTo(weatherStationPtr->coordinate()) < here.distanceTo(closestReportWithQNH->coordinate())) {
-            closestReportWithQNH = weatherStationPtr;
+        if (indices.size() < k) {
+            break;
         }
     }
     if (closestReportWithQNH != nullptr) {
@@ -496,33 +911,77 @@ void Weather::WeatherDataProvider::update(bool isBackgroundUpdate) {
     // Clear old replies, if any
     qDeleteAll(_networkReplies);
     _networkReplies.clear();
+    _downloadHasError = false;
+    _downloadTimer.start();
+
+    // Generate one corridor that covers the current position and the flight
+    // route. The corridor is widened by the tolerance of the simplification,
+    // so that it still contains all points within corridorRadius_nm of the
+    // original path.
+    QVector<QGeoCoordinate> path;
+    const QGeoCoordinate& position = Positioning::PositionProvider::lastValidCoordinate();
+    if (position.isValid()) {
+        path.append(position);
+    }
+    path += Global::navigator()->flightRoute()->coordinates();
+    path = simplifyPath(path, corridorTolerance_nm*1852.0);
 
     // Generate queries
-    const QGeoCoordinate& position = Positioning::PositionProvider::lastValidCoordinate();
-    const QVariantList& steerpts = Global::navigator()->flightRoute()->geoPath();
+    QString area;
+    if (path.size() == 1) {
+        area = QString("radialDistance=%1;%2,%3").arg(corridorRadius_nm).arg(path[0].longitude()).arg(path[0].latitude());
+    }
+    if (path.size() > 1) {
+        area = QString("flightPath=%1").arg(corridorRadius_nm+corridorTolerance_nm);
+        foreach(auto coordinate, path) {
+            area += ";" + QString::number(coordinate.longitude()) + "," + QString::number(coordinate.latitude());
+        }
+    }
     QList<QString> queries;
-    if (position.isValid()) {
-        queries.push_back(QString("dataSource=metars&radialDistance=85;%1,%2").arg(position.longitude()).arg(position.latitude()));
-        queries.push_back(QString("dataSource=tafs&radialDistance=85;%1,%2").arg(position.longitude()).arg(position.latitude()));
+    if (!area.isEmpty()) {
+        queries.push_back(QString("dataSource=metars&%1").arg(area));
+        queries.push_back(QString("dataSource=tafs&%1").arg(area));
     }
-    if (!steerpts.empty()) {
-        QString qpos;
-        foreach(auto var, steerpts) {
-            auto posit = var.value<QGeoCoordinate>();
-            qpos += ";" + QString::number(posit.longitude()) + "," + QString::number(posit.latitude());
+
+    // Collect the raw texts of the known reports, so that the readers can skip
+    // reports that have not changed
+    QHash<QString, QString> knownMETARs;
+    QHash<QString, QString> knownTAFs;
+    foreach(auto weatherStation, _weatherStationsByICAOCode) {
+        if (weatherStation.isNull()) {
+            continue;
+        }
+        if (weatherStation->hasMETAR()) {
+            knownMETARs.insert(weatherStation->ICAOCode(), weatherStation->metar()->rawText());
+        }
+        if (weatherStation->hasTAF()) {
+            knownTAFs.insert(weatherStation->ICAOCode(), weatherStation->taf()->rawText());
         }
-        queries.push_back(QString("dataSource=metars&flightPath=85%1").arg(qpos));
-        queries.push_back(QString("dataSource=tafs&flightPath=85%1").arg(qpos));
     }
 
-    // Fetch data
+    // Fetch data. If the same query has been answered before, ask the server
+    // to send data only if it has changed in the meantime. The replies are
+    // read while data arrives, so that the first reports become available
+    // before the download is complete.
     foreach(auto query, queries) {
         QUrl url = QUrl(QString("https://www.aviationweather.gov/adds/dataserver_current/httpparam?requestType=retrieve&format=xml&hoursBeforeNow=1&mostRecentForEachStation=true&%1").arg(query));
-        QNetworkRequest request(url);
+        auto request = Global::networkRequest(url);
+        if (_replyValidators.contains(url)) {
+            const auto& validator = _replyValidators[url];
+            if (!validator.first.isEmpty()) {
+                request.setRawHeader("If-None-Match", validator.first);
+            }
+            if (!validator.second.isEmpty()) {
+                request.setRawHeader("If-Modified-Since", validator.second);
+            }
+        }
         QPointer<QNetworkReply> reply = Global::networkAccessManager()->get(request);
         _networkReplies.push_back(reply);
-        connect(reply, &QNetworkReply::finished, this, &Weather::WeatherDataProvider::downloadFinished);
-        connect(reply, &QNetworkReply::errorOccurred, this, &Weather::WeatherDataProvider::downloadFinished);
+        auto reader = std::make_shared<ReplyReader>();
+        reader->knownMETARs = knownMETARs;
+        reader->knownTAFs = knownTAFs;
+        connect(reply, &QNetworkReply::readyRead, this, [this, reply, reader]() { readReplyData(reply, reader); });
+        connect(reply, &QNetworkReply::finished, this, [this, reply, reader]() { replyFinished(reply, reader); });
     }
 
     // Emit "downloading" and handle the case if none of the requests have started (e.g. because
@@ -531,22 +990,103 @@ void Weather::WeatherDataProvider::update(bool isBackgroundUpdate) {
 }
 
 
+auto Weather::WeatherDataProvider::simplifyPath(const QVector<QGeoCoordinate>& path, double tolerance_m) -> QVector<QGeoCoordinate>
+{
+    if (path.size() < 3) {
+        return path;
+    }
+
+    // Distance of a point from the segment between two other points. The
+    // cross-track distance is used if the point lies alongside the segment,
+    // the distance to the nearer end point otherwise.
+    auto distanceToSegment = [](const QGeoCoordinate& point, const QGeoCoordinate& start, const QGeoCoordinate& end) {
+        const double earthRadius_m = 6371000.0;
+        auto distanceFromStart_m = start.distanceTo(point);
+        auto angle = qDegreesToRadians(start.azimuthTo(point)-start.azimuthTo(end));
+        auto crossTrack_m = qAbs(qAsin(qSin(distanceFromStart_m/earthRadius_m)*qSin(angle))*earthRadius_m);
+        auto alongTrack_m = distanceFromStart_m*qCos(angle);
+        if ((alongTrack_m < 0.0) || (alongTrack_m > start.distanceTo(end))) {
+            return qMin(distanceFromStart_m, end.distanceTo(point));
+        }
+        return crossTrack_m;
+    };
+
+    // Douglas-Peucker simplification. Segments are split at the point that
+    // is farthest away, for as long as this point is not within tolerance.
+    QVector<bool> keep(path.size(), false);
+    keep.first() = true;
+    keep.last() = true;
+    QVector<QPair<int,int>> segments = {{0, path.size()-1}};
+    while (!segments.isEmpty()) {
+        auto segment = segments.takeLast();
+        int farthestIndex = -1;
+        double farthestDistance_m = tolerance_m;
+        for(int i=segment.first+1; i<segment.second; i++) {
+            auto distance_m = distanceToSegment(path[i], path[segment.first], path[segment.second]);
+            if (distance_m > farthestDistance_m) {
+                farthestIndex = i;
+                farthestDistance_m = distance_m;
+            }
+        }
+        if (farthestIndex < 0) {
+            continue;
+        }
+        keep[farthestIndex] = true;
+        segments.append({segment.first, farthestIndex});
+        segments.append({farthestIndex, segment.second});
+    }
+
+    QVector<QGeoCoordinate> result;
+    for(int i=0; i<path.size(); i++) {
+        if (keep[i]) {
+            result.append(path[i]);
+        }
+    }
+    return result;
+}
+
+
+auto Weather::WeatherDataProvider::weatherStationModel() const -> QAbstractListModel*
+{
+    return _model;
+}
+
+
 auto Weather::WeatherDataProvider::weatherStations() const -> QList<Weather::Station *> {
 
-    // Produce a list of reports, without nullpointers
-    QList<Weather::Station *> sortedReports;
-    foreach(auto stations, _weatherStationsByICAOCode)
-        if (!stations.isNull()) {
-            sortedReports += stations;
+    // Sort the list again only if the stations have changed, or if the
+    // position has moved considerably since the list was last sorted
+    QGeoCoordinate here = Positioning::PositionProvider::lastValidCoordinate();
+    if (!_sortedStationsValid
+            || (here.isValid() != _sortedStationsPosition.isValid())
+            || (here.distanceTo(_sortedStationsPosition) > resortDistance_m)) {
+        updateStationIndex();
+        _sortedStations.clear();
+        if (here.isValid()) {
+            foreach(auto index, _stationIndex.nearest(here, _indexedStations.size())) {
+                _sortedStations += _indexedStations[index];
+            }
+        } else {
+            _sortedStations += _indexedStations.toList();
         }
 
-    // Sort list
-    auto compare = [&](const Weather::Station *a, const Weather::Station *b) {
-        QGeoCoordinate here = Positioning::PositionProvider::lastValidCoordinate();
-        return here.distanceTo(a->coordinate()) < here.distanceTo(b->coordinate());
-    };
-    std::sort(sortedReports.begin(), sortedReports.end(), compare);
+        // Stations without coordinate come last
+        foreach(auto weatherStation, _weatherStationsByICAOCode) {
+            if (!weatherStation.isNull() && !weatherStation->coordinate().isValid()) {
+                _sortedStations += weatherStation;
+            }
+        }
+        _sortedStationsPosition = here;
+        _sortedStationsValid = true;
+    }
 
+    // Produce a list of reports, without nullpointers
+    QList<Weather::Station *> sortedReports;
+    foreach(auto weatherStation, _sortedStations) {
+        if (!weatherStation.isNull()) {
+            sortedReports += weatherStation;
+        }
+    }
     return sortedReports;
 }
 
@@ -20,15 +20,28 @@
 
 #pragma once
 
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
 #include <QMap>
 #include <QPointer>
+#include <QThreadPool>
 #include <QTimer>
+#include <QUrl>
+#include <QXmlStreamReader>
+#include <functional>
+#include <memory>
 
 class QNetworkAccessManager;
 class QNetworkReply;
 
+#include "Scheduler.h"
+#include "geomaps/WaypointIndex.h"
 #include "positioning/PositionProvider.h"
+#include "weather/METAR.h"
 #include "weather/Station.h"
+#include "weather/TAF.h"
 
 class Clock;
 class FlightRoute;
@@ -64,6 +77,8 @@ namespace Weather {
 class WeatherDataProvider : public QObject {
     Q_OBJECT
 
+    class Model;
+
 public:
     class WeatherStation;
 
@@ -154,7 +169,7 @@ public:
      * This property holds a human-readable, translated, rich-text string with 
      * information about the next sunset or sunrise at the current position. This
      * could typically read like "SS 17:01, in 3h and 5min" or "Waiting for exact
-     * position …"
+     * position …". The notifier signal is emitted only if the string changes.
      */
     Q_PROPERTY(QString sunInfo READ sunInfo NOTIFY sunInfoChanged)
 
@@ -162,7 +177,7 @@ public:
      *
      * @returns Property infoString
      */
-    static QString sunInfo() ;
+    QString sunInfo() const;
 
     /*! \brief Update method
      *
@@ -204,6 +219,30 @@ public:
      */
     QList<Weather::Station *> weatherStations() const;
 
+    /*! \brief List model of the weather stations
+     *
+     * This property holds a list model with one row per weather station, in
+     * the order of the property weatherStations. The role "station" gives the
+     * weather station. Unlike weatherStations, the model changes row by row
+     * when the weather data is updated, so that QML views need not rebuild
+     * all their delegates. The model is owned by this class.
+     */
+    Q_PROPERTY(QAbstractListModel* weatherStationModel READ weatherStationModel CONSTANT)
+
+    /*! \brief Getter method for property of the same name
+     *
+     * @returns Property weatherStationModel
+     */
+    QAbstractListModel* weatherStationModel() const;
+
+    /*! \brief Estimated memory used by the weather stations and their reports
+     *
+     * This method is used by MemoryBudget.
+     *
+     * @returns Estimated memory usage in bytes
+     */
+    qint64 memoryUsage() const;
+
 signals:
     /*! \brief Notifier signal */
     void backgroundUpdateChanged();
@@ -230,10 +269,12 @@ signals:
     void weatherStationsChanged();
 
 private slots:
-    // Called when a download is finished
+    // Called when all replies have been received and read. If there are
+    // still replies or readers running, this method does nothing.
     void downloadFinished();
 
-    // Check for expired METARs and TAFs and delete them.
+    // Delete the METARs and TAFs that have expired, as scheduled by
+    // scheduleExpiration(), and restart the timer for the next expiration.
     // This also deletes weather stations if they are no longer in use.
     void deleteExpiredMesages();
 
@@ -242,6 +283,30 @@ private slots:
     // static objects.
     void setupConnections() const;
 
+    // Marks the spatial index and the sorted list of weather stations as
+    // outdated. This method is called whenever the list of weather stations
+    // or the coordinate of a station changes.
+    void invalidateStationIndex();
+
+    // Emits QNHInfoChanged and updates sunInfo if the last valid coordinate
+    // has moved by more than resortDistance_m since this was last done for a
+    // position change.
+    void onLastValidCoordinateChanged(const QGeoCoordinate& coordinate);
+
+    // Emits sunInfoChanged if the value of sunInfo() differs from the value
+    // last seen by this method
+    void updateSunInfo();
+
+    // This slot is connected to MemoryBudget::trimCaches(). It discards the
+    // decoded texts of all METARs and TAFs, which are generated again when
+    // needed, and the sorted list of stations.
+    void trimCaches();
+
+    // Finds waypoints for all weather stations that do not have waypoint data
+    // yet, and passes them on to the stations. This method is called whenever
+    // the GeoMapProvider has new data.
+    void readWaypointDataForStations();
+
 private:
     Q_DISABLE_COPY_MOVE(WeatherDataProvider)
 
@@ -253,33 +318,225 @@ private:
     // station with the given code is known
     Weather::Station *findOrConstructWeatherStation(const QString &ICAOCode);
 
-    // This method loads METAR/TAFs from a file "weather.dat" in
-    // QStandardPaths::AppDataLocation.  There is locking to ensure that no two
-    // processes access the file. The method will fail silently on error.
-    // Returns true on success and false on failure.
-    bool load();
+    // Reports read from a reply of aviationweather.com or from the report
+    // file, and number of records read from the report file. If the reports
+    // were read from the report file, headerRead indicates that the file
+    // header could be read, and lastUpdate holds the time of the last update
+    // found there.
+    struct Reports {
+        QVector<Weather::METAR::Data> METARs;
+        QVector<Weather::TAF::Data> TAFs;
+        int recordsRead {0};
+        bool headerRead {false};
+        QDateTime lastUpdate;
+    };
+
+    // Incremental reader for one reply of aviationweather.com. The data of the
+    // reply is appended to pendingData as it arrives. Whenever pendingData
+    // contains complete METAR or TAF elements, they are removed from
+    // pendingData and handed over to readReports() in a worker thread, which
+    // feeds them to xml. At most one worker runs per reply, so that the data
+    // reaches xml in order. Only xml is accessed by the worker; all other
+    // members are accessed from the GUI thread only.
+    struct ReplyReader {
+        QXmlStreamReader xml;
+        QByteArray pendingData;
+        QHash<QString, QString> knownMETARs;
+        QHash<QString, QString> knownTAFs;
+        bool busy {false};
+        bool replyFinished {false};
+    };
+
+    // Called when a single reply is finished. This method hands the
+    // remaining data over to the reader of the reply.
+    void replyFinished(QNetworkReply* reply, const std::shared_ptr<ReplyReader>& reader);
+
+    // Called when new data of a reply is available. This method appends the
+    // data to the reader and starts reading, if the reply has been successful
+    // so far.
+    void readReplyData(QNetworkReply* reply, const std::shared_ptr<ReplyReader>& reader);
+
+    // Hands complete elements in pendingData, or all of pendingData if the
+    // reply is finished, over to a worker thread. When the worker is done, the
+    // reports are added and the method calls itself again. Once the reply is
+    // finished and all data is read, downloadFinished() is called.
+    void startReportReader(const std::shared_ptr<ReplyReader>& reader);
+
+    // Feeds data to the XML stream reader of the reply reader, reads the
+    // reports contained in all complete elements, and parses their raw text.
+    // Reports whose raw text agrees with the text known for the station are
+    // skipped. This method runs in a worker thread.
+    static Reports readReports(const std::shared_ptr<ReplyReader>& reader, const QByteArray& data);
+
+    // Hands reports over to the weather stations. Reports that are older than
+    // those known for the station are ignored. If isNew is true, the reports
+    // that were accepted are written to the report file on the next call to
+    // save().
+    void addReports(const Reports& reports, bool isNew=true);
+
+    // Reports are requested for a corridor of corridorRadius_nm nautical
+    // miles around the current position and the flight route. The path is
+    // simplified with a tolerance of corridorTolerance_nm nautical miles
+    // before it is sent to the server.
+    static constexpr int corridorRadius_nm = 85;
+    static constexpr int corridorTolerance_nm = 5;
+
+    // Simplifies the path with the Douglas-Peucker algorithm. The simplified
+    // path deviates by at most tolerance_m meters from the original one.
+    static QVector<QGeoCoordinate> simplifyPath(const QVector<QGeoCoordinate>& path, double tolerance_m);
+
+    // ETag and Last-Modified headers of the last successful reply, by URL.
+    // They are sent along with the next request for the same URL, so that the
+    // server can answer "304 Not Modified" if nothing has changed.
+    QHash<QUrl, QPair<QByteArray, QByteArray>> _replyValidators;
+
+    // List of replies from aviationweather.com that have not been read yet
+    QList<QPointer<QNetworkReply>> _networkReplies;
 
-    // This method saves all METAR/TAFs that are valid and not yet expired to a
-    // file "weather.dat" in QStandardPaths::AppDataLocation.  There is locking
-    // to ensure that no two processes access the file. The method will fail
-    // silently on error.
+    // Readers that are currently running in worker threads
+    QList<QPointer<QFutureWatcher<Reports>>> _reportReaders;
+
+    // Indicates that a reply of the current download reported an error
+    bool _downloadHasError {false};
+
+    // Measures the duration of the current download, for Metrics
+    QElapsedTimer _downloadTimer;
+
+    // The file "weather.dat" in QStandardPaths::AppDataLocation stores the
+    // METAR/TAFs. It begins with a header of reportFileHeaderSize bytes
+    // (magic number, version, time of last update in milliseconds since the
+    // epoch or -1), followed by a sequence of records. Every record consists
+    // of a type ('M' or 'T'), the ICAO code, the length of the payload and the
+    // payload, which is written by METAR::write() or TAF::write(). New reports
+    // are appended; if there are several records for the same station and
+    // type, the last one counts. All data is written with QDataStream, format
+    // Qt_5_15. There is locking to ensure that no two processes access the
+    // file.
+    static QString reportFileName();
+    static constexpr quint32 reportFileMagic = 0x31415;
+    static constexpr quint32 reportFileVersion = 2;
+    static constexpr qint64 reportFileHeaderSize = 16;
+
+    // This method starts a worker thread that reads the report file. Once the
+    // file has been read, the reports are added and the next update is
+    // scheduled, so that the first download does not start before the time
+    // of the last update is known. The method will fail silently on error.
+    void load();
+
+    // Reads the header and the reports from the report file, which is mapped
+    // into memory. Only the last record for every station and type is
+    // decoded. This method is reentrant; it runs in a worker thread.
+    static Reports readReportFile(const QString& fileName);
+
+    // This method saves the METAR/TAFs received since the last call, and the
+    // time of the last update, to the report file. Writing is done by a worker
+    // thread. If the file contains too many outdated records, it is replaced
+    // by a file that holds only the METAR/TAFs that are valid and not yet
+    // expired. The method will fail silently on error.
     void save();
 
-    // List of replies from aviationweather.com
-    QList<QPointer<QNetworkReply>> _networkReplies;
+    // Writes to the report file, either by appending records and updating the
+    // header, or, if replace is true or the file cannot be appended to, by
+    // writing a new file. This method runs in a worker thread.
+    static void writeReportFile(const QString& fileName, const QDateTime& lastUpdate, const QByteArray& records, bool replace);
+
+    // Generates a record of the report file. The writer is called to write
+    // the payload.
+    static QByteArray reportRecord(quint8 type, const QString& ICAOCode, const std::function<void(QDataStream&)>& writer);
+
+    // Records not yet written to the report file, and their number
+    QByteArray _unsavedRecords;
+    int _unsavedRecordCount {0};
+
+    // Number of records in the report file, including outdated ones, and
+    // number of records that the file may contain in addition to twice the
+    // number of valid reports before it is replaced
+    int _recordsInFile {0};
+    static constexpr int minRecordsBeforeCompaction = 64;
+
+    // Time of last update, as last handed over to the writer
+    QDateTime _savedLastUpdate;
+
+    // Thread pool for writing the report file. It has a single thread, so that
+    // writes happen in order. The destructor of the pool waits until all data
+    // is written.
+    QThreadPool _fileWriterPool;
 
     // A timer used for auto-updating the weather reports every 30 minutes
-    QTimer _updateTimer;
+    Scheduler::Timer _updateTimer {Scheduler::Weather};
 
-    // A timer used for deleting expired weather reports ever 11 minutes
-    QTimer _deleteExiredMessagesTimer;
+    // Expiration times of the METARs and TAFs, kept as a min-heap with the
+    // report that expires first at the front. Entries are not removed when a
+    // report is replaced; deleteExpiredMesages() ignores them once they come
+    // due.
+    struct Expiration {
+        qint64 expiration_ms {0};
+        QPointer<Weather::Station> station;
+        QPointer<QObject> report;
+
+        // Comparison for the std heap functions, which build max-heaps
+        static bool later(const Expiration& a, const Expiration& b) { return a.expiration_ms > b.expiration_ms; }
+    };
+    QVector<Expiration> _expirations;
+
+    // Adds the report of the weather station to the heap of expirations
+    void scheduleExpiration(Weather::Station *weatherStation, QObject *report, const QDateTime& expiration);
+
+    // Starts the timer so that it fires when the first report expires, but
+    // no later than maxExpirationInterval_ms from now
+    void startExpirationTimer();
+    static constexpr qint64 maxExpirationInterval_ms = 24*60*60*1000;
+
+    // Removes the weather station from the list and deletes it if it has
+    // neither METAR nor TAF. Returns true if the station was deleted.
+    bool deleteStationIfUnused(Weather::Station *weatherStation);
+
+    // A single-shot timer used for deleting weather reports when they expire
+    Scheduler::Timer _deleteExpiredMessagesTimer {Scheduler::Weather};
 
     // Flag, as set by the update() method
     bool _backgroundUpdate {true};
 
+    // List model of the weather stations
+    QPointer<Model> _model;
+
     // List of weather stations, accessible by ICAO code
     QMap<QString, QPointer<Weather::Station>> _weatherStationsByICAOCode;
 
+    // Spatial index of the weather stations with valid coordinate. The index
+    // refers to the positions in _indexedStations. Both are computed by
+    // updateStationIndex() when needed.
+    void updateStationIndex() const;
+    mutable GeoMaps::WaypointIndex _stationIndex;
+    mutable QVector<QPointer<Weather::Station>> _indexedStations;
+    mutable bool _stationIndexValid {false};
+
+    // Weather stations, as returned by weatherStations(), and the position
+    // for which they were sorted. The list is sorted again only if the
+    // position moves by more than resortDistance_m. The same threshold
+    // applies to position-dependent notifications.
+    mutable QList<QPointer<Weather::Station>> _sortedStations;
+    mutable QGeoCoordinate _sortedStationsPosition;
+    mutable bool _sortedStationsValid {false};
+    static constexpr double resortDistance_m = 1000.0;
+
+    // Position for which QNHInfoChanged and sunInfoChanged were last emitted
+    QGeoCoordinate _notifiedPosition;
+
+    // Sunrise and sunset, as computed by sunInfo(). The times are computed
+    // again only if the position, rounded to sunTimesResolution_deg, or the
+    // local date changes.
+    mutable QDateTime _sunrise;
+    mutable QDateTime _sunset;
+    mutable QDateTime _sunriseTomorrow;
+    mutable int _sunTimesLatitude {0};
+    mutable int _sunTimesLongitude {0};
+    mutable QDate _sunTimesDate;
+    static constexpr double sunTimesResolution_deg = 0.1;
+
+    // Value of sunInfo() last seen by updateSunInfo()
+    QString _sunInfo;
+
     // Date and Time of last update
     QDateTime _lastUpdate;
 };
@@ -0,0 +1,116 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <QSet>
+
+#include "weather/WeatherDataProvider_Model.h"
+
+
+Weather::WeatherDataProvider::Model::Model(WeatherDataProvider* provider)
+    : QAbstractListModel(provider), m_provider(provider)
+{
+    // The provider has no weather stations yet when the model is constructed
+    connect(m_provider, &WeatherDataProvider::weatherStationsChanged, this, &Weather::WeatherDataProvider::Model::updateRows);
+}
+
+
+auto Weather::WeatherDataProvider::Model::rowCount(const QModelIndex& parent) const -> int
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return m_rows.size();
+}
+
+
+auto Weather::WeatherDataProvider::Model::data(const QModelIndex& index, int role) const -> QVariant
+{
+    // Paranoid safety checks
+    if (!index.isValid() || (index.row() >= m_rows.size())) {
+        return {};
+    }
+
+    const auto& row = m_rows.at(index.row());
+    if (role == StationRole) {
+        return QVariant::fromValue(row.station.data());
+    }
+    if (role == ICAOCodeRole) {
+        return row.ICAOCode;
+    }
+    return {};
+}
+
+
+auto Weather::WeatherDataProvider::Model::roleNames() const -> QHash<int, QByteArray>
+{
+    return {{StationRole, "station"}, {ICAOCodeRole, "ICAOCode"}};
+}
+
+
+void Weather::WeatherDataProvider::Model::updateRows()
+{
+    if (m_provider.isNull()) {
+        return;
+    }
+
+    // Compute the new rows
+    QVector<Row> newRows;
+    QSet<QString> newICAOCodes;
+    foreach(auto weatherStation, m_provider->weatherStations()) {
+        newRows.append({weatherStation->ICAOCode(), weatherStation, weatherStation->metar(), weatherStation->taf(), weatherStation->twoLineTitle(), weatherStation->icon()});
+        newICAOCodes.insert(weatherStation->ICAOCode());
+    }
+
+    // Remove the rows of stations that have disappeared
+    for(int i=m_rows.size()-1; i>=0; i--) {
+        if (!newICAOCodes.contains(m_rows[i].ICAOCode)) {
+            beginRemoveRows(QModelIndex(), i, i);
+            m_rows.remove(i);
+            endRemoveRows();
+        }
+    }
+
+    // Go through the new rows in order. Rows of stations that are already
+    // known are moved into place and updated, other rows are inserted. Once
+    // the first i rows agree with the new rows, all remaining old rows come
+    // after position i.
+    for(int i=0; i<newRows.size(); i++) {
+        int j = i;
+        while ((j < m_rows.size()) && (m_rows[j].ICAOCode != newRows[i].ICAOCode)) {
+            j++;
+        }
+        if (j == m_rows.size()) {
+            beginInsertRows(QModelIndex(), i, i);
+            m_rows.insert(i, newRows[i]);
+            endInsertRows();
+            continue;
+        }
+        if (j != i) {
+            beginMoveRows(QModelIndex(), j, j, QModelIndex(), i);
+            m_rows.move(j, i);
+            endMoveRows();
+        }
+        if (!(m_rows[i] == newRows[i])) {
+            m_rows[i] = newRows[i];
+            emit dataChanged(index(i), index(i));
+        }
+    }
+}
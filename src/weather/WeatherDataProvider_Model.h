@@ -0,0 +1,110 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Stefan Kebekus                                  *
+ *   stefan.kebekus@gmail.com                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include <QAbstractListModel>
+
+#include "weather/WeatherDataProvider.h"
+
+namespace Weather {
+
+/*! \brief List model of the weather stations
+ *
+ * This model has one row per weather station, in the order of
+ * WeatherDataProvider::weatherStations(). Each row is a small value that
+ * records the station together with its current METAR and TAF. Whenever the
+ * weather stations change, the model compares the new list against these
+ * values and emits row-level signals: rows of stations that have disappeared
+ * are removed, rows of new stations are inserted, rows are moved if the order
+ * has changed, and dataChanged() is emitted for rows whose reports or
+ * description have changed. QML views can therefore keep their delegates
+ * across a weather update.
+ */
+
+class WeatherDataProvider::Model : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    /*! \brief Roles of the model */
+    enum Roles {
+        StationRole = Qt::UserRole+1, /*!< Weather station, as a Weather::Station* */
+        ICAOCodeRole /*!< ICAO code of the weather station */
+    };
+
+    /*! \brief Constructs a model
+     *
+     * @param provider WeatherDataProvider, which is also the parent of the model
+     */
+    explicit Model(WeatherDataProvider* provider);
+
+    // Standard destructor
+    ~Model() override = default;
+
+    /*! \brief Implementation of pure virtual method from QAbstractListModel
+     *
+     * @param parent Parent index, must be invalid
+     *
+     * @returns Number of weather stations
+     */
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+
+    /*! \brief Implementation of pure virtual method from QAbstractListModel
+     *
+     * @param index Index of a weather station
+     *
+     * @param role Role, one of the values in Roles
+     *
+     * @returns Data
+     */
+    QVariant data(const QModelIndex& index, int role) const override;
+
+    /*! \brief Implementation of virtual method from QAbstractListModel
+     *
+     * @returns Role names "station" and "ICAOCode"
+     */
+    QHash<int, QByteArray> roleNames() const override;
+
+private slots:
+    // Brings the rows in line with the current list of weather stations
+    void updateRows();
+
+private:
+    Q_DISABLE_COPY_MOVE(Model)
+
+    // Content of one row. Rows are identified by the ICAO code.
+    struct Row {
+        QString ICAOCode;
+        QPointer<Weather::Station> station;
+        QPointer<Weather::METAR> metar;
+        QPointer<Weather::TAF> taf;
+        QString twoLineTitle;
+        QString icon;
+
+        bool operator==(const Row& other) const = default;
+    };
+
+    QPointer<WeatherDataProvider> m_provider;
+    QVector<Row> m_rows;
+};
+
+}